@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file           : can_bus.h
+  * @brief          : Header for can_bus.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   CAN bus layer (CAN1 only, or CAN1 + CAN2 in dual-bus mode).
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __CAN_BUS_H
+#define __CAN_BUS_H
+
+
+// Includes
+#include "main.h"
+
+
+// Defines
+#define CAN_BUS_COUNT			2		// CAN1 and CAN2
+#define CAN_BUS_IN_USE			((DUAL_CAN_MODE == DUAL_CAN_OFF) ? 1 : CAN_BUS_COUNT)
+#define CAN_BUS_HOLDOFF_MS		1000	// A bus that recovered from bus-off must stay healthy this long before it is used again
+#define CAN_MIRROR_WINDOW_MS	50		// Copies of a mirrored frame arrive on both buses within this window
+#define CAN_MIRROR_HISTORY		4		// Frames remembered per bus to drop mirrored copies
+#define CAN2_FILTER_BANK_START	14		// Filter banks 0-13 belong to CAN1 and 14-27 to CAN2
+
+
+// Typedefs
+// Health metrics kept per bus. Index 0/1 is CAN1/CAN2
+typedef struct
+{
+	uint32_t tx_frames;			// Frames handed to a Tx mailbox
+	uint32_t rx_frames;			// Frames released from the Rx FIFOs
+	uint16_t tx_errors;			// Frames refused by the bus (no free mailbox or bus not started)
+	uint16_t busoff_events;		// Times the bus went bus-off
+	uint16_t failovers;			// Frames moved to the other bus because this one was down or full
+	uint16_t dup_dropped;		// Mirrored copies dropped because the other bus delivered them first
+	uint8_t up;					// TRUE while the bus can be used for transmission
+	uint32_t down_tick;			// HAL tick of the last bus-off event
+} CAN_BusHealth_t;
+
+
+// Function prototypes
+void CAN2_Init(void);
+HAL_StatusTypeDef CAN_Bus_Tx(CAN_TxHeaderTypeDef *pHeader, uint8_t aData[]);
+void CAN_Bus_Error(CAN_HandleTypeDef *hcan, uint32_t err);
+void CAN_Bus_RxCount(CAN_HandleTypeDef *hcan);
+uint8_t CAN_Bus_IsDuplicate(CAN_HandleTypeDef *hcan, CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[]);
+void CAN_Bus_Report(char *buf);
+
+
+#endif /* __CAN_BUS_H */
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file           : fenwick.h
+  * @brief          : Header for fenwick.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   range-query index over the game results (Fenwick trees) and
+  *                   of its CAN query frames.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __FENWICK_H
+#define __FENWICK_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define FENWICK_SLOT_ROUNDS		16		// Rounds per tree leaf: one 32-bit word of 2-bit results
+#define FENWICK_SLOTS			1024	// Leaves. The index covers the last 16384 rounds
+#define FENWICK_ROUNDS			(FENWICK_SLOTS * FENWICK_SLOT_ROUNDS)
+#define FENWICK_MINUTES			128		// Minutes whose first round is kept for time queries
+#define FENWICK_COUNTERS		4		// Counters, indexed by game result - 1
+#define FENWICK_NUCLEO_WINS		0
+#define FENWICK_DISC_WINS		1
+#define FENWICK_TIES			2
+#define FENWICK_ERRORS			3
+
+#define FENWICK_QUERY_ID		0x6A2	// Range query to Nucleo. Byte 0: FENWICK_BY_xxx, then the range
+#define FENWICK_REPLY_ID		0x6A3	// Reply: Nucleo wins, Disc wins, ties, errors (uint16_t each, LSB first)
+#define FENWICK_BY_ROUNDS		0		// Bytes 1-4: first round, bytes 5-6: round count (LSB first)
+#define FENWICK_BY_MINUTES		1		// Bytes 1-2: last minutes, the current one included (LSB first)
+
+
+// Typedefs
+// Index state (about 12.5 KB). Rounds are numbered like the round history (history.c)
+typedef struct
+{
+	uint16_t tree[FENWICK_SLOTS][FENWICK_COUNTERS];	// Fenwick trees of the per-slot counts, all counters per node
+	uint32_t results[FENWICK_SLOTS];		// 2 bits per round (game result - 1), round r at bits 2*(r % 16)
+	uint32_t first_round;					// Oldest round still indexed
+	uint32_t next_round;					// Number of the next round
+	uint32_t minute_round[FENWICK_MINUTES];	// First round of minute m at m % FENWICK_MINUTES
+	uint32_t first_minute;					// First minute with a known first round
+	uint32_t last_minute;					// Newest minute seen by Fenwick_Tick()
+	uint8_t clock;							// 0 until the first Fenwick_Tick()
+} Fenwick_Index_t;
+
+
+// Function prototypes
+void Fenwick_Init(Fenwick_Index_t *ix, uint32_t first_round);
+void Fenwick_Tick(Fenwick_Index_t *ix, uint32_t minute);
+void Fenwick_Add(Fenwick_Index_t *ix, uint8_t result);
+uint32_t Fenwick_Query(const Fenwick_Index_t *ix, uint32_t first, uint32_t count, uint32_t sums[FENWICK_COUNTERS]);
+uint32_t Fenwick_QueryMinutes(const Fenwick_Index_t *ix, uint32_t minutes, uint32_t now, uint32_t sums[FENWICK_COUNTERS]);
+
+
+#endif /* __FENWICK_H */
@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file           : led_pattern.h
+  * @brief          : Header for led_pattern.c file.
+  *                   This file contains the defines and prototypes of the timer
+  *                   driven LED pattern engine used by Disc.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __LED_PATTERN_H
+#define __LED_PATTERN_H
+
+
+// Includes
+#include "main.h"
+
+
+// Defines
+// Disc's 4x LEDs are all on GPIOD. LED1 (G)--> PD12, LED2 (O) --> PD13, LED3 (R) --> PD14, LED4 (B) --> PD15
+#define LED_GREEN				GPIO_PIN_12
+#define LED_ORANGE				GPIO_PIN_13
+#define LED_RED					GPIO_PIN_14
+#define LED_BLUE				GPIO_PIN_15
+#define LED_ALL					(LED_GREEN | LED_ORANGE | LED_RED | LED_BLUE)
+
+// BSRR word that turns on the LEDs in mask and turns off the rest of the 4x LEDs in one write
+// Lower half of BSRR sets pins and upper half resets pins
+#define LED_BSRR_ONLY(mask)		((uint32_t)(mask) | ((uint32_t)(LED_ALL & ~(mask)) << 16))
+
+// TIM1 ticks every 100 us. Frame durations are given in ticks
+#define LED_TICK_US				100
+#define LED_FRAME_100MS			1000
+#define LED_FRAME_1MS			10
+
+#define LED_FRAME_BUF_LEN		512		// Max number of BSRR frames a pattern can hold
+
+// Error codes shown as a number of blue LED blinks followed by a pause
+#define LED_ERR_GAME_RESULT		1		// Disc could not decide the game result
+#define LED_ERR_CAN				2		// CAN error callback was entered
+#define LED_ERR_TRAP			3		// Error_handler() was entered
+
+#define LED_STREAK_MIN			3		// Number of same results in a row before a streak is shown
+
+
+// Function prototypes
+void LED_Pattern_Init(void);
+uint8_t LED_Pattern_Stop(void);
+void LED_Pattern_Error(uint8_t err_code);
+void LED_Pattern_Streak(uint16_t led_mask, uint8_t streak_len);
+void LED_Pattern_Fade(uint16_t led_mask);
+void LED_Pattern_SleepCountdown(void (*on_done)(void));
+uint8_t LED_Pattern_IsReady(void);
+
+
+#endif /* __LED_PATTERN_H */
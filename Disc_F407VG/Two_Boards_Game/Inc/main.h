@@ -27,6 +27,79 @@
 #define SYSCLK_FREQ_84MHZ		84
 #define SYSCLK_FREQ_120MHZ		120
 #define SYSCLK_FREQ_180MHZ		180
+// CAN Rx FIFO management
+#define CAN_QUIET_DRAINS		32		// IRQ entries in a row with no backlog before leaving burst mode
+// Dual CAN (CAN1 + CAN2) operation
+#define DUAL_CAN_OFF			0		// CAN1 only
+#define DUAL_CAN_SHARE			1		// Frames alternate between the healthy buses (load sharing)
+#define DUAL_CAN_MIRROR			2		// Every frame is sent on both healthy buses (redundancy)
+#ifndef DUAL_CAN_MODE
+#define DUAL_CAN_MODE			DUAL_CAN_OFF
+#endif
+// CAN frame authentication. Must be the same on both boards
+#define SECURE_CAN				FALSE	// TRUE: hand, result and sleep frames carry a counter and a truncated MAC
+// Disc's hand selection: one of the STRATEGY_xxx IDs of strategy.h
+#define DISC_STRATEGY			STRATEGY_RANDOM
+
+#define STATS_INDEX_MINUTES		60		// Last minutes of Nucleo's round index (fenwick.c) queried after its game stats
+// CAN bridge: Disc stops refereeing and becomes a Lawicel/slcan USB-serial CAN adapter on USART2 (slcan.c)
+#define SLCAN_BRIDGE			FALSE	// TRUE: CAN1 frames are bridged to and from the PC (Linux slcand), no game
+#define SLCAN_BAUD				1000000	// USART2 rate in bridge mode. 25 MHz / (16 * 1.5625), exact
+// Time-triggered CAN (tt_sched.c): Disc is the referee. Host_Tools builds simulation boards with it TRUE
+#ifndef TT_CAN
+#define TT_CAN					FALSE	// TRUE: a reference frame starts every basic cycle, results and hands go in their windows only
+#endif
+#define TT_CYCLE_MS				20		// Basic cycle. Above Disc's UART lines for a hand (about 10 ms), 65 ms at most (TIM6)
+#define TT_PLAYERS				1		// Hand windows of the schedule. Nucleo plays in window 0
+#define TT_BIT_NS				2000	// CAN1 bit time, see CAN1_Init()
+#define TIM6_PERIOD_MS			((TT_CAN == TRUE) ? TT_CYCLE_MS : 1)	// Button sampling (100 ms debounce), and the cycle with TT_CAN
+#if TT_CAN == TRUE && (DUAL_CAN_MODE != DUAL_CAN_OFF || SLCAN_BRIDGE == TRUE)
+#error "TT_CAN runs the game on CAN1 alone"
+#endif
+// Passive spectator (spectator.c): Disc stops refereeing and watches the game bus from CAN silent mode.
+// Host_Tools builds a simulation board with it TRUE
+#ifndef SPECTATOR
+#define SPECTATOR				FALSE	// TRUE: nothing goes on CAN1, rounds, latency and anomalies stream out of USART2 by DMA
+#endif
+#define SPEC_BIT_NS				2000	// CAN1 bit time, see CAN1_Init()
+#if SPECTATOR == TRUE && (DUAL_CAN_MODE != DUAL_CAN_OFF || SLCAN_BRIDGE == TRUE || TT_CAN == TRUE)
+#error "The spectator watches CAN1 and sends nothing"
+#endif
+// Referee sessions (session.c): Disc referees up to SESSION_MAX player nodes at once, node n with hand ID
+// 0x49F + n and result ID 0x111 + n (PLAYER_NODE in Nucleo's main.h). Node 0 is the Nucleo of the two board game
+#ifndef REFEREE_SESSIONS
+#define REFEREE_SESSIONS		FALSE	// TRUE: a session per player node, with its own counters and strategy state
+#endif
+#define SESSION_IDLE_MS			60000	// Session of a node with no hand for that long is closed, its place freed
+#if REFEREE_SESSIONS == TRUE && (SECURE_CAN == TRUE || TT_CAN == TRUE || SPECTATOR == TRUE || SLCAN_BRIDGE == TRUE)
+#error "Referee sessions need plain event-triggered game frames: the secured IDs and the schedule are node 0's alone"
+#endif
+// Tournament (tourney.c): Disc stops playing and referees matches between player nodes 0 to TOURNEY_PLAYERS - 1,
+// pairings and results on each node's result ID. Standings are kept in backup SRAM after the rollups
+#ifndef TOURNAMENT
+#define TOURNAMENT				FALSE	// TRUE: round robin or Swiss tournament between the player nodes
+#endif
+#define TOURNEY_MODE			TOURNEY_SWISS	// TOURNEY_ROUND_ROBIN or TOURNEY_SWISS of tourney.h
+#define TOURNEY_PLAYERS			64		// 2 to TOURNEY_MAX
+#define TOURNEY_GAMES			5		// Games of a match
+#define TOURNEY_MAX_OPEN		32		// Matches under way at once: a whole round of 64 players
+#define TOURNEY_OVERLAP			TRUE	// Round robin: a match starts once both players are free (TOURNEY_LEAD), not at the end of the round
+#define TOURNEY_RETRY_MS		250		// Match with no hand for that long: pairing sent again
+#if TOURNAMENT == TRUE && (REFEREE_SESSIONS == TRUE || SECURE_CAN == TRUE || TT_CAN == TRUE || SPECTATOR == TRUE || SLCAN_BRIDGE == TRUE)
+#error "The tournament takes the hands of all player nodes and needs plain event-triggered game frames"
+#endif
+
+
+// Typedefs
+// Counters kept by the CAN Rx path. Index 0/1 of the arrays is FIFO0/FIFO1
+typedef struct
+{
+	uint32_t rx_frames;			// Frames released from both Rx FIFOs
+	uint16_t fifo_full[2];		// FIFO full events (3 frames waiting)
+	uint16_t fifo_overrun[2];	// FIFO overrun events. Each one is a lost frame
+	uint16_t burst_switches;	// Times the catch-all filter was moved to FIFO1 because of a burst
+	uint8_t max_backlog;		// Most frames drained in a single IRQ entry
+} CAN_RxStats_t;
 
 
 #endif /* __MAIN_H */
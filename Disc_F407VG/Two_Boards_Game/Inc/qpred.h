@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file           : qpred.h
+  * @brief          : Header for qpred.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   int8 quantized linear hand predictor.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __QPRED_H
+#define __QPRED_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define QPRED_HISTORY			6		// Rounds in the feature window
+#define QPRED_WORDS				(QPRED_HISTORY + 2)		// Feature words: rounds, window sum, own last hand + bias
+#define QPRED_FEATURES			(4 * QPRED_WORDS)		// int8 features, 4 per 32-bit word
+#define QPRED_OUTPUTS			3		// One score per possible next opponent hand
+#define QPRED_ONE				16		// Value of a set one-hot feature. The window sum stays within int8
+#define QPRED_NO_HAND			0xFF
+
+
+// Typedefs
+// Predictor state. Each round is one word: bytes 0-2 one-hot opponent hand, byte 3 own result (+1/0/-1)
+typedef struct
+{
+	uint32_t rounds[QPRED_HISTORY];		// Newest first
+	uint8_t last_own;					// Own hand of the last round, QPRED_NO_HAND before the first round
+	uint8_t predicted;					// Hand predicted by the last pick
+	uint32_t predictions;				// Rounds played on a prediction
+	uint32_t hits;						// Predictions that matched the opponent's hand
+} Qpred_State_t;
+
+
+// Global variables
+extern const int8_t qpred_weights[QPRED_OUTPUTS][QPRED_FEATURES];	// Generated by Host_Tools/qpred_train (qpred_table.c)
+
+
+// Function prototypes
+void Qpred_Init(Qpred_State_t *st);
+void Qpred_Features(const Qpred_State_t *st, uint32_t x[QPRED_WORDS]);
+void Qpred_Scores(const int8_t w[QPRED_OUTPUTS][QPRED_FEATURES], const uint32_t x[QPRED_WORDS], int32_t scores[QPRED_OUTPUTS]);
+uint8_t Qpred_Pick(Qpred_State_t *st);
+void Qpred_Observe(Qpred_State_t *st, uint8_t own, uint8_t opp);
+
+
+#endif /* __QPRED_H */
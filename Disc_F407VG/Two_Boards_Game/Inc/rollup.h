@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file           : rollup.h
+  * @brief          : Header for rollup.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   minute/hour/day game history rollups kept in backup SRAM.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __ROLLUP_H
+#define __ROLLUP_H
+
+
+// Includes
+#include "main.h"
+
+
+// Defines
+#define ROLLUP_MINUTE			0		// Levels of the rollup
+#define ROLLUP_HOUR				1
+#define ROLLUP_DAY				2
+#define ROLLUP_LEVELS			3
+#define ROLLUP_MINUTES			60		// Last hour in minute buckets
+#define ROLLUP_HOURS			48		// Last 2 days in hour buckets
+#define ROLLUP_DAYS				31		// Last month in day buckets
+#define ROLLUP_EMPTY			0xFFFFFFFF	// Key of a bucket never used
+#define ROLLUP_MAGIC			0x524F4C31	// "ROL1". Marks backup SRAM content as valid rollups
+#define ROLLUP_QUERY_ID			0x6A0	// Range query: level, buckets back from the newest, bucket count
+#define ROLLUP_REPLY_ID			0x6A1	// Reply: rounds, Nucleo wins, Disc wins, ties (uint16_t each, LSB first)
+
+
+// Typedefs
+// Results of the games played within one minute, hour or day
+typedef struct
+{
+	uint32_t key;				// Minutes, hours or days since 2000-01-01 00:00. ROLLUP_EMPTY if unused
+	uint32_t rounds;
+	uint32_t nucleo_wins;
+	uint32_t disc_wins;
+	uint32_t ties;
+	uint32_t errors;
+} Rollup_Bucket_t;
+
+// Layout of the rollups in backup SRAM (3340 of 4096 bytes)
+typedef struct
+{
+	uint32_t magic;
+	Rollup_Bucket_t minute[ROLLUP_MINUTES];
+	Rollup_Bucket_t hour[ROLLUP_HOURS];
+	Rollup_Bucket_t day[ROLLUP_DAYS];
+} Rollup_Store_t;
+
+
+// Function prototypes
+void Rollup_Init(void);
+void Rollup_Record(uint8_t winner);
+uint8_t Rollup_Query(uint8_t level, uint8_t back, uint8_t count, Rollup_Bucket_t *sum);
+void Rollup_Report(char *buf);
+
+
+#endif /* __ROLLUP_H */
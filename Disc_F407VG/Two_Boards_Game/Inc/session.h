@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file           : session.h
+  * @brief          : Header for session.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   referee's session table (REFEREE_SESSIONS): the state Disc keeps
+  *                   for each player node it referees, found by node ID in an
+  *                   open-addressed hash index.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __SESSION_H
+#define __SESSION_H
+
+
+// Includes
+#include <stdint.h>
+#include "strategy.h"
+
+
+// Defines
+#define SESSION_MAX				256		// Players refereed at once
+#define SESSION_SLOT_BITS		9
+#define SESSION_SLOTS			(1U << SESSION_SLOT_BITS)	// Hash slots: the index is half full at most
+#define SESSION_NONE			0xFFFF	// No player, free slot. Not a node ID
+#define SESSION_RESULTS			4		// Counters, indexed by game result - 1
+
+// Player node n sends its hand on SESSION_HAND_ID + n and gets its result on SESSION_RESULT_ID + n,
+// as in Host_Tools/fleet_sim. Node 0 is the Nucleo of the two board game
+#define SESSION_HAND_ID			0x49F
+#define SESSION_RESULT_ID		0x111
+#define SESSION_NODES			256		// Hand IDs stay below the stats frame (0x633)
+
+
+// Typedefs
+// Players are kept packed at indexes 0 to count - 1, one array per field, so a scan over
+// one field (idle time, pending results) reads that field only
+typedef struct
+{
+	// Hash index: linear probing from the hash of the node ID, no tombstones
+	uint16_t slot_node[SESSION_SLOTS];		// Node ID held by the slot, SESSION_NONE if free
+	uint16_t slot_player[SESSION_SLOTS];	// Its player index
+	// Players
+	uint16_t node[SESSION_MAX];
+	uint16_t seq[SESSION_MAX];				// Rounds refereed with the player, wraps
+	uint8_t hand[SESSION_MAX];				// Its last hand
+	uint8_t pending[SESSION_MAX];			// Result of its last hand not sent yet (no Tx mailbox free), 0 if none
+	uint32_t last_tick[SESSION_MAX];		// HAL tick of its last hand
+	uint16_t results[SESSION_RESULTS][SESSION_MAX];	// Nucleo (player) wins, Disc wins, ties, errors
+	Strategy_Player_t strategy[SESSION_MAX];		// Disc's hands against the player, from their own history
+	uint16_t count;
+	uint16_t pending_count;
+	// Counters
+	uint32_t opened, expired, refused;
+} Session_Table_t;
+
+// 42512 bytes on the board with SESSION_MAX 256 (43536 on a 64-bit host: 8-byte strategy pointers)
+_Static_assert(sizeof(Session_Table_t) <= 43 * 1024, "Session_Table_t over 43 KB: lower SESSION_MAX");
+
+
+// Function prototypes
+void Session_Init(Session_Table_t *t);
+uint16_t Session_Find(const Session_Table_t *t, uint16_t node);
+uint16_t Session_Open(Session_Table_t *t, uint16_t node, uint32_t tick, uint8_t strategy, uint32_t seed);
+void Session_Close(Session_Table_t *t, uint16_t player);
+uint16_t Session_Expire(Session_Table_t *t, uint32_t tick, uint32_t idle_ms);
+void Session_Result(Session_Table_t *t, uint16_t player, uint8_t hand, uint8_t result, uint32_t tick);
+void Session_Sent(Session_Table_t *t, uint16_t player);
+uint16_t Session_NextPending(const Session_Table_t *t);
+void Session_Report(const Session_Table_t *t, char *buf);
+
+
+#endif /* __SESSION_H */
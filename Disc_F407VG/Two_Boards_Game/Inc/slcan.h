@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file           : slcan.h
+  * @brief          : Header for slcan.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   Lawicel/slcan ASCII protocol spoken by Disc in bridge mode
+  *                   (SLCAN_BRIDGE), so Linux slcand can attach it as slcan0.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __SLCAN_H
+#define __SLCAN_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define SLCAN_LINE_MAX			32		// Longest command line: T, 8 ID digits, DLC, 16 data digits, CR
+#define SLCAN_FRAME_MAX			31		// Longest line to the PC: T, 8 ID digits, DLC, 16 data digits, 4 timestamp digits, CR
+#define SLCAN_REPLY_MAX			8		// Longest reply to a command ("V1013\r")
+#define SLCAN_BITRATES			9		// S0 to S8: 10, 20, 50, 100, 125, 250, 500, 800, 1000 kbit/s
+#define SLCAN_DEFAULT_BITRATE	6		// 500 kbit/s, the game bus
+// Buffers of the bridge (main_.c)
+#define SLCAN_RX_DMA			256		// USART2 Rx, written in circles by DMA
+#define SLCAN_TX_RING			2048	// Lines to the PC waiting for the Tx DMA (about 80 frames)
+#define SLCAN_CAN_QUEUE			16		// Frames from the PC waiting for a Tx mailbox
+
+// Action asked by a command line
+#define SLCAN_NONE				0		// Line incomplete, or nothing for the board to do (reply only)
+#define SLCAN_SEND				1		// Send the frame on the bus (t, T, r, R)
+#define SLCAN_OPEN				2		// Open the bus at the selected bit rate (O)
+#define SLCAN_LISTEN			3		// Open the bus in listen-only mode (L)
+#define SLCAN_CLOSE				4		// Close the bus (C)
+#define SLCAN_BITRATE			5		// Bit rate selected (Sn), applied at the next open
+
+// Status flags (F command), cleared once read
+#define SLCAN_FLAG_RX_FULL		0x01	// A CAN Rx FIFO was full
+#define SLCAN_FLAG_TX_FULL		0x02	// A frame from the PC was refused: Tx queue full
+#define SLCAN_FLAG_ERR_WARNING	0x04
+#define SLCAN_FLAG_OVERRUN		0x08	// A received frame was lost (Rx FIFO overrun, or no room towards the PC)
+#define SLCAN_FLAG_ERR_PASSIVE	0x20
+#define SLCAN_FLAG_ARB_LOST		0x40
+#define SLCAN_FLAG_BUS_ERROR	0x80
+
+
+// Typedefs
+// CAN frame as carried by slcan
+typedef struct
+{
+	uint32_t id;				// 11-bit or 29-bit identifier
+	uint8_t ext;				// 1 for an extended (29-bit) identifier
+	uint8_t rtr;				// 1 for a remote frame
+	uint8_t dlc;				// 0 to 8
+	uint8_t data[8];
+} Slcan_Frame_t;
+
+// Protocol state
+typedef struct
+{
+	char line[SLCAN_LINE_MAX];	// Command line being received
+	uint8_t len;
+	uint8_t overflow;			// Line too long: refused at its CR
+	uint8_t open;				// SLCAN_OPEN, SLCAN_LISTEN, or 0 while closed
+	uint8_t bitrate;			// S code, 0 to 8
+	uint8_t timestamps;			// 1: frames to the PC end with a 16-bit ms timestamp (Z1)
+	uint8_t flags;				// SLCAN_FLAG_xxx, set by the board
+	uint32_t commands;			// Command lines received
+	uint32_t refused;			// Command lines answered with BELL
+	uint32_t dropped;			// Received frames not forwarded (no room towards the PC)
+} Slcan_t;
+
+
+// Function prototypes
+void Slcan_Init(Slcan_t *s);
+uint8_t Slcan_RxByte(Slcan_t *s, uint8_t byte, Slcan_Frame_t *frame, char reply[SLCAN_REPLY_MAX], uint8_t *reply_len);
+uint8_t Slcan_Encode(const Slcan_Frame_t *f, uint8_t timestamps, uint16_t ms, char out[SLCAN_FRAME_MAX]);
+uint8_t Slcan_Refuse(Slcan_t *s, char reply[SLCAN_REPLY_MAX]);
+
+
+#endif /* __SLCAN_H */
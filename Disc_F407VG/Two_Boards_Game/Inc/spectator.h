@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file           : spectator.h
+  * @brief          : Header for spectator.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   passive spectator (SPECTATOR): game frames decoded off a
+  *                   silent CAN node, stats, latency, anomalies and the lines
+  *                   queued for the UART DMA.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __SPECTATOR_H
+#define __SPECTATOR_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define SPEC_TX_RING			2048	// Bytes of lines waiting for the UART DMA
+#define SPEC_LINE_MAX			240		// Longest line
+#define SPEC_LAT_BINS			16		// Hand to result histogram, SPEC_LAT_BIN_US wide bins, last one open
+#define SPEC_LAT_BIN_US			2000
+#define SPEC_SLOW_US			50000	// Hand to result above it: anomaly
+#define SPEC_HANDS_IN_FLIGHT	4		// Hands waiting for their result: the round rate controller sends the next one early
+#define SPEC_RESULT_TIMEOUT_MS	2000	// Hand with no result by then: lost result
+#define SPEC_REPLY_TIMEOUT_MS	500		// Stats or index query with no reply by then
+#define SPEC_QUIET_MS			10000	// No frame at all for that long: anomaly, once per silence
+#define SPEC_REPORT_MS			10000	// Totals sent every 10 s
+
+// Identifiers of the game, as sent by both main_.c files
+#define SPEC_ID_HAND			0x49F
+#define SPEC_ID_RESULT			0x111
+#define SPEC_ID_STATS			0x633	// Remote frame from Disc, data frame from Nucleo
+#define SPEC_ID_SLEEP			0x77B
+#define SPEC_ID_ROLLUP_QUERY	0x6A0	// As in rollup.h (not included: it pulls in the HAL)
+#define SPEC_ID_ROLLUP_REPLY	0x6A1
+
+// Anomalies
+#define SPEC_ANOM_LOST_RESULT	0		// Hand with no result within SPEC_RESULT_TIMEOUT_MS, or pushed out by later ones
+#define SPEC_ANOM_ORPHAN_RESULT	1		// Result with no hand before it
+#define SPEC_ANOM_BAD_FRAME		2		// Game frame with a DLC or a payload the firmware never sends
+#define SPEC_ANOM_SLOW_RESULT	3		// Hand to result over SPEC_SLOW_US
+#define SPEC_ANOM_NO_REPLY		4		// Stats or index query left unanswered
+#define SPEC_ANOM_STATS_DRIFT	5		// Nucleo's counters moved by other than the results seen
+#define SPEC_ANOM_UNKNOWN_ID	6		// Identifier the game does not use
+#define SPEC_ANOM_BUS_ERROR		7		// Error frame or stuck bus seen by the controller
+#define SPEC_ANOM_OVERRUN		8		// Frame lost in a full Rx FIFO
+#define SPEC_ANOM_QUIET			9		// Nothing on the bus for SPEC_QUIET_MS
+#define SPEC_ANOMALIES			10
+
+
+// Typedefs
+typedef struct
+{
+	uint32_t bit_ns;			// CAN bit time: time stamps are in bit times
+	// Time base: 16-bit TTCM time stamps unwrapped with the HAL tick
+	uint64_t now_bits;			// Time of the last frame, bits since the first one
+	uint16_t stamp;				// Its TTCM time stamp
+	uint32_t tick;				// Its HAL tick
+	uint8_t started;
+	// Game
+	uint64_t hand_at[SPEC_HANDS_IN_FLIGHT];	// SOF of the hands waiting for their result, oldest at hand_first
+	uint32_t hand_tick[SPEC_HANDS_IN_FLIGHT];
+	uint8_t hand_first;
+	uint8_t hand_open;			// Hands waiting
+	uint8_t query_open;			// Stats, index or rollup query not answered yet
+	uint32_t query_tick;
+	uint8_t stats_valid;		// stats[] holds Nucleo's last counters
+	uint8_t stats[4];			// Nucleo wins, Disc wins, ties, errors of Nucleo's last stats reply
+	uint32_t stats_results[4];	// Results of each kind seen since that reply
+	uint8_t quiet;				// SPEC_ANOM_QUIET reported for the current silence
+	uint32_t report_tick;		// HAL tick of the last totals
+	// Counters
+	uint32_t frames, rounds, refs, events;
+	uint32_t hands[3];			// Rock, paper, scissors
+	uint32_t results[4];		// Nucleo wins, Disc wins, tie, error
+	uint32_t anomalies[SPEC_ANOMALIES];
+	uint32_t lat_hist[SPEC_LAT_BINS];
+	uint32_t lat_min, lat_max;	// us
+	uint64_t lat_sum;
+	// Lines for the UART, sent from tail by DMA
+	char ring[SPEC_TX_RING];
+	uint16_t head, tail;
+	uint32_t dropped;			// Lines the ring had no room for
+} Spectator_t;
+
+
+// Function prototypes
+void Spec_Init(Spectator_t *s, uint32_t bit_ns);
+void Spec_Frame(Spectator_t *s, uint32_t tick, uint16_t stamp, uint16_t id, uint8_t rtr, uint8_t dlc, const uint8_t data[]);
+void Spec_Tick(Spectator_t *s, uint32_t tick);
+void Spec_Anomaly(Spectator_t *s, uint8_t kind, uint32_t tick);
+void Spec_Report(Spectator_t *s, uint32_t tick);
+uint16_t Spec_TxChunk(const Spectator_t *s, const char **chunk);
+void Spec_TxDone(Spectator_t *s, uint16_t len);
+
+
+#endif /* __SPECTATOR_H */
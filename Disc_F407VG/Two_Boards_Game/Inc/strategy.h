@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file           : strategy.h
+  * @brief          : Header for strategy.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   player strategies (hand selection) shared by both boards.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __STRATEGY_H
+#define __STRATEGY_H
+
+
+// Includes
+#include <stdint.h>
+#include "markov.h"
+#include "qpred.h"
+#include "evolved.h"
+
+
+// Defines
+// Strategy IDs. Index of the strategy in strategy_table[]
+#define STRATEGY_RANDOM			0		// Uniform random hand
+#define STRATEGY_CYCLE			1		// Rock, Paper, Scissors, Rock, ...
+#define STRATEGY_FREQUENCY		2		// Beats the opponent's most played hand
+#define STRATEGY_WSLS			3		// Win-stay, lose-shift
+#define STRATEGY_MARKOV			4		// Beats the hand predicted by order-k Markov counts (markov.c)
+#define STRATEGY_QPRED			5		// Beats the hand predicted by the int8 linear model (qpred.c)
+#define STRATEGY_EVOLVED		6		// Lookup table evolved offline (evolved.c)
+#define STRATEGY_COUNT			7
+#define STRATEGY_NO_HAND		0xFF	// Opponent's hand is unknown (game error)
+
+
+// Typedefs
+// State of the simple strategies
+typedef struct
+{
+	uint32_t rng;				// xorshift32 state
+	uint16_t opp_counts[3];		// Times the opponent played each hand
+	uint8_t step;				// Position in the cycle
+	uint8_t last_own;			// Own hand of the previous round
+	uint8_t last_opp;			// Opponent's hand of the previous round, STRATEGY_NO_HAND if unknown
+} Strategy_Basic_t;
+
+// Fixed-size state shared by all strategies. No dynamic memory
+typedef union
+{
+	Strategy_Basic_t basic;
+	Markov_State_t markov;
+	Qpred_State_t qpred;
+	Evolved_State_t evolved;
+} Strategy_State_t;
+
+// A strategy: three functions over the fixed state
+typedef struct
+{
+	const char *name;
+	void (*init)(Strategy_State_t *st, uint32_t seed);
+	uint8_t (*pick)(Strategy_State_t *st);								// Hand to play, from the history only
+	void (*observe)(Strategy_State_t *st, uint8_t own, uint8_t opp);	// Adds the hands of the round played
+} Strategy_t;
+
+// A player: the strategy it runs and its state
+typedef struct
+{
+	const Strategy_t *strategy;
+	Strategy_State_t state;
+} Strategy_Player_t;
+
+
+// Function prototypes
+void Strategy_Init(Strategy_Player_t *player, uint8_t id, uint32_t seed);
+uint8_t Strategy_Pick(Strategy_Player_t *player);
+void Strategy_Observe(Strategy_Player_t *player, uint8_t own, uint8_t opp);
+uint8_t Strategy_OppHand(uint8_t own, uint8_t result);
+const char* Strategy_Name(uint8_t id);
+
+
+#endif /* __STRATEGY_H */
@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file           : tourney.h
+  * @brief          : Header for tourney.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   tournament scheduler (TOURNAMENT): round robin and Swiss
+  *                   pairings between player nodes, matches refereed by Disc,
+  *                   standings kept in backup SRAM.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __TOURNEY_H
+#define __TOURNEY_H
+
+
+// Includes
+#include <stdint.h>
+#include "session.h"
+
+
+// Defines
+#define TOURNEY_MAX				64		// Players of a tournament
+#define TOURNEY_SWISS_ROUNDS	6		// Swiss rounds at most: log2(TOURNEY_MAX), one player left unbeaten
+#define TOURNEY_ROUND_ROBIN		0		// Every player meets every other once (circle method)
+#define TOURNEY_SWISS			1		// Neighbours in the standings meet, nobody twice
+#define TOURNEY_NONE			0xFF	// No player: not playing, not a node of the tournament
+#define TOURNEY_BYE				0xFE	// Opponent of the player left out of a round (odd number of players)
+#define TOURNEY_MAGIC			0x544F5531	// "TOU1". Marks backup SRAM content as valid standings
+#define TOURNEY_SWISS_STEPS		1024	// Players placed by a Swiss pairing, backtracking included, before rematches are let in
+#define TOURNEY_LEAD			1		// Overlapped round robin: rounds a player may run ahead of the slowest one
+#define TOURNEY_TX_PAIRING		0x80	// tx[]: pairing waiting for a Tx mailbox, results in the low bits
+
+// Frames go on the result ID of the player (SESSION_RESULT_ID + node), hands come on its hand ID:
+// - pairing: TOURNEY_PAIRING, round, opponent's node, games left (DLC 4)
+// - result:  1 = the player wins, 2 = its opponent wins, 3 = a tie, 4 = error, then games left (DLC 2)
+// A player answers either one with its next hand while games are left
+#define TOURNEY_PAIRING			0		// First byte of a pairing: no game result is 0
+
+
+// Typedefs
+// Standings, in backup SRAM on the board right after the rollups (716 bytes, 4056 of 4096 used).
+// Written at each pairing and at the end of each match, so a reset loses the matches being played only
+typedef struct
+{
+	uint32_t magic;
+	uint8_t mode;							// TOURNEY_ROUND_ROBIN or TOURNEY_SWISS
+	uint8_t players, games, rounds;			// Games of a match, rounds of the tournament
+	uint8_t paired;							// Swiss: rounds paired so far
+	uint8_t overlap;						// Round robin: a match starts as soon as both players are free
+	uint8_t max_open;						// Matches played at once
+	uint8_t done;
+	uint8_t node[TOURNEY_MAX];				// Node of each player, in seeding order
+	uint8_t played[TOURNEY_MAX];			// Rounds over for the player, bye included
+	uint8_t points[TOURNEY_MAX];			// Half points: 2 for a match won or a Swiss bye, 1 for a drawn match
+	uint16_t game_points[TOURNEY_MAX];		// Half points of the games: tie-break
+	uint8_t opp[TOURNEY_MAX][TOURNEY_SWISS_ROUNDS];	// Swiss: opponent of each round, TOURNEY_BYE
+} Tourney_Store_t;
+
+// Matches under way, in RAM. A match is kept by both its players
+typedef struct
+{
+	Tourney_Store_t *store;
+	uint8_t by_node[SESSION_NODES];			// Player of a node, TOURNEY_NONE
+	uint8_t opp[TOURNEY_MAX];				// Opponent in the match being played, TOURNEY_NONE if none
+	uint8_t hand[TOURNEY_MAX];				// Hand of the game being played, TOURNEY_NONE until it comes
+	uint8_t game[TOURNEY_MAX];				// Games of the match played
+	uint8_t score[TOURNEY_MAX];				// Half points of those games
+	uint8_t tx[TOURNEY_MAX];				// Frames to the player waiting for a Tx mailbox
+	uint8_t left[TOURNEY_MAX];				// Games left, sent with the result waiting
+	uint32_t tick[TOURNEY_MAX];				// HAL tick of the last hand or pairing of the match
+	uint8_t round;							// Lowest round some player has not played yet
+	uint8_t open;							// Matches being played
+	uint8_t tx_count;						// Frames waiting
+	// Counters
+	uint32_t matches, games, strays, retries, rematches;
+} Tourney_t;
+
+// Frame for the player's result ID
+typedef struct
+{
+	uint16_t id;
+	uint8_t dlc;
+	uint8_t data[4];
+	uint8_t player;
+} Tourney_Frame_t;
+
+
+// Function prototypes
+void Tourney_Start(Tourney_t *t, Tourney_Store_t *store, uint8_t mode, const uint8_t node[], uint8_t players, \
+				   uint8_t games, uint8_t max_open, uint8_t overlap, uint32_t tick);
+uint8_t Tourney_Resume(Tourney_t *t, Tourney_Store_t *store, uint32_t tick);
+uint8_t Tourney_Hand(Tourney_t *t, uint16_t node, uint8_t hand, uint32_t tick);
+void Tourney_Tick(Tourney_t *t, uint32_t tick, uint32_t retry_ms);
+uint8_t Tourney_NextTx(const Tourney_t *t, Tourney_Frame_t *f);
+void Tourney_Sent(Tourney_t *t, const Tourney_Frame_t *f);
+uint8_t Tourney_Opponent(uint8_t players, uint8_t round, uint8_t player);
+uint16_t Tourney_Matches(const Tourney_Store_t *s);
+uint8_t Tourney_Ranking(const Tourney_t *t, uint8_t rank[]);
+void Tourney_Report(const Tourney_t *t, char *buf);
+void Tourney_Standing(const Tourney_t *t, uint8_t place, uint8_t player, char *buf);
+
+
+#endif /* __TOURNEY_H */
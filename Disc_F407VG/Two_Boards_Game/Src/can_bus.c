@@ -0,0 +1,317 @@
+/**
+  ******************************************************************************
+  * @file    can_bus.c
+  * @author  Moe2Code
+  * @brief   CAN bus layer shared by all frame transmissions of the board. With DUAL_CAN_MODE
+  *          set to DUAL_CAN_OFF, frames go out on CAN1 only. Otherwise CAN2 is brought up as a
+  *          second bus and frames are either spread across both buses (DUAL_CAN_SHARE) or sent
+  *          on both (DUAL_CAN_MIRROR). The following is conducted in source file:
+  *          + Initialization of CAN2
+  *          + Bus selection for each frame, with failover when a bus is bus-off or full
+  *          + Recovery of a bus once it left bus-off and stayed healthy for CAN_BUS_HOLDOFF_MS
+  *          + Dropping of the second copy of mirrored frames
+  *          + Health metrics per bus
+  */
+
+// Includes
+#include "can_bus.h"
+#include "secure_msg.h"
+
+
+// Global variables
+extern CAN_HandleTypeDef hcan1;
+CAN_HandleTypeDef hcan2 = {0};					// CAN2 peripheral handle. Only initialized in dual-bus mode
+CAN_BusHealth_t can_bus_health[CAN_BUS_COUNT] = {{0, 0, 0, 0, 0, 0, TRUE, 0}, {0, 0, 0, 0, 0, 0, TRUE, 0}};
+uint8_t can_next_bus = 0;						// Bus to use for the next frame in load sharing mode
+
+// Frames recently received per bus. Used to drop the copy of a mirrored frame arriving on the other bus
+struct
+{
+	uint32_t key;				// StdId, with bit 11 set for remote frames. 0 = empty entry
+	uint8_t dlc;
+	uint8_t data[8];
+	uint32_t tick;
+} can_mirror_hist[CAN_BUS_COUNT][CAN_MIRROR_HISTORY] = {0};
+uint8_t can_mirror_pos[CAN_BUS_COUNT] = {0};
+
+
+// Function prototypes
+extern void Error_handler(void);
+static uint8_t CAN_Bus_Index(CAN_HandleTypeDef *hcan);
+static HAL_StatusTypeDef CAN_Bus_TxOn(uint8_t bus, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[]);
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+static void CAN_Bus_Poll(void);
+#endif
+
+
+/**
+  * @brief	Selects CAN2, configures its properties, and initializes it. Same bit timing as CAN1
+  * @param	None
+  * @note	CAN2 is a slave of CAN1: CAN1's clock must be on and the filter banks are shared
+  * @retval None
+  */
+
+void CAN2_Init(void)
+{
+	// CAN2 is hanging on APB1 as well. Settings to Tx/Rx at 500 kbit/s, see CAN1_Init()
+	hcan2.Instance = CAN2;
+	hcan2.Init.Mode = CAN_MODE_NORMAL;
+	hcan2.Init.AutoBusOff = ENABLE;				// Leave bus-off by hardware so the bus can come back after a failover
+	hcan2.Init.AutoRetransmission = ENABLE;		// Retransmit message until it is successfully received
+	hcan2.Init.AutoWakeUp = DISABLE;
+	hcan2.Init.ReceiveFifoLocked = DISABLE;
+	hcan2.Init.TimeTriggeredMode = DISABLE;
+	hcan2.Init.TransmitFifoPriority = DISABLE;
+
+	hcan2.Init.Prescaler = 5;
+	hcan2.Init.SyncJumpWidth = CAN_SJW_1TQ;
+	hcan2.Init.TimeSeg1 = CAN_BS1_8TQ;
+	hcan2.Init.TimeSeg2 = CAN_BS2_1TQ;
+
+	if(HAL_CAN_Init(&hcan2) != HAL_OK)
+	{
+		Error_handler();
+	}
+}
+
+
+/**
+  * @brief	Sends a frame on the bus(es) picked by DUAL_CAN_MODE. With SECURE_CAN, frames of
+  * 		secured IDs get their counter and tag appended first (caller's copy is untouched)
+  * @param	pHeader pointer to the header of the frame to send
+  * @param	aData payload of the frame
+  * @retval HAL_OK if at least one bus accepted the frame, HAL_ERROR otherwise
+  */
+
+HAL_StatusTypeDef CAN_Bus_Tx(CAN_TxHeaderTypeDef *pHeader, uint8_t aData[])
+{
+#if SECURE_CAN == TRUE
+	CAN_TxHeaderTypeDef sealed_header = *pHeader;
+	uint8_t sealed_data[8] = {0};
+
+	memcpy(sealed_data, aData, (pHeader->DLC < 8) ? pHeader->DLC : 8);
+
+	if(Secure_Seal(&sealed_header, sealed_data) == FALSE)
+	{
+		return HAL_ERROR;
+	}
+
+	pHeader = &sealed_header;
+	aData = sealed_data;
+#endif
+
+#if DUAL_CAN_MODE == DUAL_CAN_OFF
+
+	return CAN_Bus_TxOn(0, pHeader, aData);
+
+#elif DUAL_CAN_MODE == DUAL_CAN_MIRROR
+
+	uint8_t sent = 0;
+
+	CAN_Bus_Poll();
+
+	for(uint8_t bus = 0; bus < CAN_BUS_COUNT; bus++)
+	{
+		if(can_bus_health[bus].up == TRUE && CAN_Bus_TxOn(bus, pHeader, aData) == HAL_OK)
+		{
+			sent++;
+		}
+	}
+
+	if(sent == 0)	// Both buses down; CAN1 still gets a chance as in single-bus mode
+	{
+		return CAN_Bus_TxOn(0, pHeader, aData);
+	}
+
+	return HAL_OK;
+
+#else	// DUAL_CAN_SHARE
+
+	uint8_t first = can_next_bus;
+	uint8_t other = first ^ 1;
+
+	CAN_Bus_Poll();
+
+	can_next_bus = other;		// Round robin between the buses
+
+	if(can_bus_health[first].up == TRUE && CAN_Bus_TxOn(first, pHeader, aData) == HAL_OK)
+	{
+		return HAL_OK;
+	}
+
+	can_bus_health[first].failovers++;
+
+	if(can_bus_health[other].up == TRUE || can_bus_health[first].up == FALSE)
+	{
+		return CAN_Bus_TxOn(other, pHeader, aData);
+	}
+
+	return HAL_ERROR;
+
+#endif
+}
+
+
+/**
+  * @brief	Updates the bus health on a CAN error. A bus-off bus is no longer used for transmission
+  * @param	hcan pointer to the CAN handle that reported the error
+  * @param	err HAL error code of the CAN handle
+  * @retval None
+  */
+
+void CAN_Bus_Error(CAN_HandleTypeDef *hcan, uint32_t err)
+{
+	uint8_t bus = CAN_Bus_Index(hcan);
+
+	if(err & HAL_CAN_ERROR_BOF)
+	{
+		can_bus_health[bus].busoff_events++;
+		can_bus_health[bus].up = FALSE;
+		can_bus_health[bus].down_tick = HAL_GetTick();
+	}
+}
+
+
+/**
+  * @brief	Counts a frame released from the Rx FIFOs of the given bus
+  * @param	hcan pointer to the CAN handle the frame was received on
+  * @retval None
+  */
+
+void CAN_Bus_RxCount(CAN_HandleTypeDef *hcan)
+{
+	can_bus_health[CAN_Bus_Index(hcan)].rx_frames++;
+}
+
+
+/**
+  * @brief	In mirror mode, tells whether a received frame is the copy of a frame already
+  * 		received on the other bus within CAN_MIRROR_WINDOW_MS
+  * @param	hcan pointer to the CAN handle the frame was received on
+  * @param	pHeader pointer to the header of the received frame
+  * @param	rcvd_msg payload of the received frame
+  * @retval TRUE if the frame must be dropped, FALSE otherwise
+  */
+
+uint8_t CAN_Bus_IsDuplicate(CAN_HandleTypeDef *hcan, CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[])
+{
+#if DUAL_CAN_MODE == DUAL_CAN_MIRROR
+
+	uint8_t bus = CAN_Bus_Index(hcan);
+	uint8_t other = bus ^ 1;
+	uint32_t key = pHeader->StdId | ((pHeader->RTR == CAN_RTR_REMOTE) ? 0x800 : 0);
+	uint32_t now = HAL_GetTick();
+	uint8_t pos;
+
+	for(uint8_t i = 0; i < CAN_MIRROR_HISTORY; i++)
+	{
+		if(can_mirror_hist[other][i].key == key && can_mirror_hist[other][i].dlc == pHeader->DLC && \
+		   (now - can_mirror_hist[other][i].tick) <= CAN_MIRROR_WINDOW_MS && \
+		   memcmp(can_mirror_hist[other][i].data, rcvd_msg, pHeader->DLC) == 0)
+		{
+			can_mirror_hist[other][i].key = 0;		// Copy consumed; a later resend is a new frame
+			can_bus_health[bus].dup_dropped++;
+			return TRUE;
+		}
+	}
+
+	pos = can_mirror_pos[bus];
+	can_mirror_hist[bus][pos].key = key;
+	can_mirror_hist[bus][pos].dlc = pHeader->DLC;
+	memcpy(can_mirror_hist[bus][pos].data, rcvd_msg, 8);
+	can_mirror_hist[bus][pos].tick = now;
+	can_mirror_pos[bus] = (pos + 1) % CAN_MIRROR_HISTORY;
+
+#endif
+
+	return FALSE;
+}
+
+
+/**
+  * @brief	Prints the health of the bus(es) in use into buf
+  * @param	buf destination string. Must hold at least 200 characters
+  * @retval None
+  */
+
+void CAN_Bus_Report(char *buf)
+{
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
+	uint32_t esr;
+
+	buf[0] = '\0';
+
+	for(uint8_t bus = 0; bus < CAN_BUS_IN_USE; bus++)
+	{
+		esr = hcan[bus]->Instance->ESR;		// Transmit/receive error counters live in ESR
+
+		sprintf(buf + strlen(buf), "CAN%d %s tx:%lu rx:%lu txerr:%u busoff:%u failover:%u dup:%u tec:%u rec:%u\r\n", \
+				bus + 1, (can_bus_health[bus].up == TRUE) ? "up" : "down", \
+				(unsigned long)can_bus_health[bus].tx_frames, (unsigned long)can_bus_health[bus].rx_frames, \
+				can_bus_health[bus].tx_errors, can_bus_health[bus].busoff_events, can_bus_health[bus].failovers, \
+				can_bus_health[bus].dup_dropped, (unsigned int)((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos), \
+				(unsigned int)((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos));
+	}
+}
+
+
+/**
+  * @brief	Returns the index of the bus of a CAN handle: 0 = CAN1, 1 = CAN2
+  * @param	hcan pointer to a CAN handle
+  * @retval Bus index
+  */
+
+static uint8_t CAN_Bus_Index(CAN_HandleTypeDef *hcan)
+{
+	return (hcan->Instance == CAN2) ? 1 : 0;
+}
+
+
+/**
+  * @brief	Adds the frame to a free Tx mailbox of the given bus and counts the outcome
+  * @param	bus 0 = CAN1, 1 = CAN2
+  * @param	pHeader pointer to the header of the frame to send
+  * @param	aData payload of the frame
+  * @retval HAL status of HAL_CAN_AddTxMessage()
+  */
+
+static HAL_StatusTypeDef CAN_Bus_TxOn(uint8_t bus, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[])
+{
+	uint32_t TxMailbox;		// ID for the selected Tx mailbox will be stored in this variable
+	HAL_StatusTypeDef status;
+
+	status = HAL_CAN_AddTxMessage((bus == 0) ? &hcan1 : &hcan2, pHeader, aData, &TxMailbox);
+
+	if(status == HAL_OK)
+	{
+		can_bus_health[bus].tx_frames++;
+	}else
+	{
+		can_bus_health[bus].tx_errors++;
+	}
+
+	return status;
+}
+
+
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+/**
+  * @brief	Brings back a bus that left bus-off (AutoBusOff) and stayed healthy for CAN_BUS_HOLDOFF_MS
+  * @param	None
+  * @retval None
+  */
+
+static void CAN_Bus_Poll(void)
+{
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
+
+	for(uint8_t bus = 0; bus < CAN_BUS_COUNT; bus++)
+	{
+		if(can_bus_health[bus].up == FALSE && (hcan[bus]->Instance->ESR & CAN_ESR_BOFF) == 0 && \
+		   (HAL_GetTick() - can_bus_health[bus].down_tick) >= CAN_BUS_HOLDOFF_MS)
+		{
+			can_bus_health[bus].up = TRUE;
+		}
+	}
+}
+#endif
@@ -0,0 +1,301 @@
+/**
+  ******************************************************************************
+  * @file    fenwick.c
+  * @author  Moe2Code
+  * @brief   Range-query index over the game results: Nucleo wins, Disc wins, ties and
+  *          errors between any two rounds, or over the last minutes, without scanning the
+  *          history. The following is conducted in source file:
+  *          + Fenwick (binary indexed) trees over slots of 16 rounds, O(log n) per round
+  *            and per query
+  *          + Exact counts in the partial slots at both ends of a range, from the 2-bit
+  *            results of the slot (one 32-bit word)
+  *          + Sliding window: the oldest slot is taken out of the trees when its leaf is reused
+  *          + Minute to round mapping for time queries
+  * @note    RAM is fixed: the window is the last FENWICK_ROUNDS rounds. Older rounds and
+  *          rounds before Fenwick_Init() are clipped from a query
+  */
+
+// Includes
+#include "fenwick.h"
+
+
+// Function prototypes
+static void Fenwick_Update(Fenwick_Index_t *ix, uint16_t slot, uint8_t counter, int16_t delta);
+static void Fenwick_Prefix(const Fenwick_Index_t *ix, uint16_t slot, uint32_t sums[FENWICK_COUNTERS], int8_t sign);
+static void Fenwick_CountWord(uint32_t word, uint8_t lo, uint8_t hi, uint32_t sums[FENWICK_COUNTERS], int8_t sign);
+
+
+/**
+  * @brief  Clears the index. Rounds are then added from first_round on
+  * @param  ix pointer to the index
+  * @param  first_round number of the first round to be added
+  * @retval None
+  */
+
+void Fenwick_Init(Fenwick_Index_t *ix, uint32_t first_round)
+{
+	for(uint16_t s = 0; s < FENWICK_SLOTS; s++)
+	{
+		for(uint8_t c = 0; c < FENWICK_COUNTERS; c++)
+		{
+			ix->tree[s][c] = 0;
+		}
+
+		ix->results[s] = 0;
+	}
+
+	ix->first_round = first_round;
+	ix->next_round = first_round;
+	ix->first_minute = 0;
+	ix->last_minute = 0;
+	ix->clock = 0;
+}
+
+
+/**
+  * @brief  Tells the index the current minute. Call it before adding the rounds played in it
+  * @param  ix pointer to the index
+  * @param  minute current time in minutes (any origin, increasing)
+  * @retval None
+  */
+
+void Fenwick_Tick(Fenwick_Index_t *ix, uint32_t minute)
+{
+	if(ix->clock == 0 || minute < ix->last_minute || minute - ix->last_minute >= FENWICK_MINUTES)
+	{
+		if(ix->clock == 0 || minute < ix->last_minute)		// First tick, or the clock went back (restart)
+		{
+			ix->first_minute = minute;
+		}else
+		{
+			ix->first_minute = minute - FENWICK_MINUTES + 1;	// Every kept minute had no rounds
+		}
+
+		for(uint8_t m = 0; m < FENWICK_MINUTES; m++)
+		{
+			ix->minute_round[m] = ix->next_round;
+		}
+
+		ix->last_minute = minute;
+		ix->clock = 1;
+		return;
+	}
+
+	while(ix->last_minute != minute)
+	{
+		ix->last_minute++;
+		ix->minute_round[ix->last_minute % FENWICK_MINUTES] = ix->next_round;
+	}
+
+	if(minute - ix->first_minute >= FENWICK_MINUTES)
+	{
+		ix->first_minute = minute - FENWICK_MINUTES + 1;
+	}
+}
+
+
+/**
+  * @brief  Adds the next round
+  * @param  ix pointer to the index
+  * @param  result game result: 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error. Others count as errors
+  * @retval None
+  */
+
+void Fenwick_Add(Fenwick_Index_t *ix, uint8_t result)
+{
+	uint32_t r = ix->next_round, old[FENWICK_COUNTERS] = {0};
+	uint16_t slot = (r / FENWICK_SLOT_ROUNDS) % FENWICK_SLOTS;
+	uint8_t field = r % FENWICK_SLOT_ROUNDS, counter;
+	uint32_t evicted;
+
+	counter = (result >= 1 && result <= FENWICK_COUNTERS) ? result - 1 : FENWICK_ERRORS;
+
+	if(field == 0 && r / FENWICK_SLOT_ROUNDS >= FENWICK_SLOTS)		// Leaf reused: take its old slot out
+	{
+		evicted = r - FENWICK_ROUNDS;		// First round of the old slot
+
+		if(evicted + FENWICK_SLOT_ROUNDS > ix->first_round)
+		{
+			Fenwick_CountWord(ix->results[slot], (ix->first_round > evicted) ? ix->first_round - evicted : 0, \
+							  FENWICK_SLOT_ROUNDS, old, 1);
+
+			for(uint8_t c = 0; c < FENWICK_COUNTERS; c++)
+			{
+				if(old[c] != 0)
+				{
+					Fenwick_Update(ix, slot, c, -(int16_t)old[c]);
+				}
+			}
+
+			ix->first_round = evicted + FENWICK_SLOT_ROUNDS;
+		}
+
+		ix->results[slot] = 0;
+	}else if(field == 0)
+	{
+		ix->results[slot] = 0;
+	}
+
+	ix->results[slot] |= (uint32_t)counter << (2 * field);
+	Fenwick_Update(ix, slot, counter, 1);
+	ix->next_round++;
+}
+
+
+/**
+  * @brief  Counts the results of a range of rounds. The range is clipped to the rounds indexed
+  * @param  ix pointer to the index
+  * @param  first number of the first round of the range
+  * @param  count number of rounds in the range
+  * @param  sums receives the count of each result (index FENWICK_xxx)
+  * @retval Rounds counted after clipping
+  */
+
+uint32_t Fenwick_Query(const Fenwick_Index_t *ix, uint32_t first, uint32_t count, uint32_t sums[FENWICK_COUNTERS])
+{
+	uint32_t a = first, b = first + count, sa, sb;
+
+	for(uint8_t c = 0; c < FENWICK_COUNTERS; c++)
+	{
+		sums[c] = 0;
+	}
+
+	if(b < a || b > ix->next_round)		// Past the newest round (or wrapped around)
+	{
+		b = ix->next_round;
+	}
+
+	if(a < ix->first_round)
+	{
+		a = ix->first_round;
+	}
+
+	if(a >= b)
+	{
+		return 0;
+	}
+
+	sa = a / FENWICK_SLOT_ROUNDS;
+	sb = (b - 1) / FENWICK_SLOT_ROUNDS;
+
+	if(sa == sb)
+	{
+		Fenwick_CountWord(ix->results[sa % FENWICK_SLOTS], a % FENWICK_SLOT_ROUNDS, (b - 1) % FENWICK_SLOT_ROUNDS + 1, sums, 1);
+		return b - a;
+	}
+
+	Fenwick_CountWord(ix->results[sa % FENWICK_SLOTS], a % FENWICK_SLOT_ROUNDS, FENWICK_SLOT_ROUNDS, sums, 1);
+	Fenwick_CountWord(ix->results[sb % FENWICK_SLOTS], 0, (b - 1) % FENWICK_SLOT_ROUNDS + 1, sums, 1);
+
+	if(sb - sa >= 2)		// Whole slots in between, from the trees. The ring may wrap between them
+	{
+		uint16_t lo = (sa + 1) % FENWICK_SLOTS, hi = (sb - 1) % FENWICK_SLOTS;
+
+		Fenwick_Prefix(ix, hi, sums, 1);
+
+		if(lo > hi)
+		{
+			Fenwick_Prefix(ix, FENWICK_SLOTS - 1, sums, 1);
+		}
+
+		if(lo > 0)
+		{
+			Fenwick_Prefix(ix, lo - 1, sums, -1);
+		}
+	}
+
+	return b - a;
+}
+
+
+/**
+  * @brief  Counts the results of the rounds played in the last minutes
+  * @param  ix pointer to the index
+  * @param  minutes number of minutes, the current one included (60 = last hour)
+  * @param  now current time in minutes, as given to Fenwick_Tick()
+  * @param  sums receives the count of each result (index FENWICK_xxx)
+  * @retval Rounds counted. Minutes before the first tick or older than FENWICK_MINUTES are clipped
+  */
+
+uint32_t Fenwick_QueryMinutes(const Fenwick_Index_t *ix, uint32_t minutes, uint32_t now, uint32_t sums[FENWICK_COUNTERS])
+{
+	uint32_t start, first;
+
+	if(ix->clock == 0 || minutes == 0 || now < ix->first_minute)
+	{
+		return Fenwick_Query(ix, ix->next_round, 0, sums);
+	}
+
+	start = (minutes > now - ix->first_minute) ? ix->first_minute : now - minutes + 1;
+
+	if(now - start >= FENWICK_MINUTES)
+	{
+		start = now - FENWICK_MINUTES + 1;
+	}
+
+	first = (start > ix->last_minute) ? ix->next_round : ix->minute_round[start % FENWICK_MINUTES];
+
+	return Fenwick_Query(ix, first, ix->next_round - first, sums);
+}
+
+
+/**
+  * @brief  Adds a count to a leaf of a tree
+  * @param  ix pointer to the index
+  * @param  slot leaf (0 to FENWICK_SLOTS - 1)
+  * @param  counter counter (FENWICK_xxx)
+  * @param  delta value added
+  * @retval None
+  */
+
+static void Fenwick_Update(Fenwick_Index_t *ix, uint16_t slot, uint8_t counter, int16_t delta)
+{
+	for(uint16_t i = slot + 1; i <= FENWICK_SLOTS; i += i & -i)		// Nodes are 1-based, stored at i - 1
+	{
+		ix->tree[i - 1][counter] += delta;
+	}
+}
+
+
+/**
+  * @brief  Adds (or subtracts) the counts of leaves 0 to slot, all counters at once
+  * @param  ix pointer to the index
+  * @param  slot last leaf of the prefix
+  * @param  sums counts to add to
+  * @param  sign 1 to add, -1 to subtract
+  * @retval None
+  */
+
+static void Fenwick_Prefix(const Fenwick_Index_t *ix, uint16_t slot, uint32_t sums[FENWICK_COUNTERS], int8_t sign)
+{
+	for(uint16_t i = slot + 1; i > 0; i -= i & -i)
+	{
+		for(uint8_t c = 0; c < FENWICK_COUNTERS; c++)
+		{
+			sums[c] += sign * ix->tree[i - 1][c];
+		}
+	}
+}
+
+
+/**
+  * @brief  Counts each result in the fields lo to hi - 1 of a slot word (SWAR, no loop over rounds)
+  * @param  word 16 results of 2 bits
+  * @param  lo first field
+  * @param  hi field after the last one (1 to 16)
+  * @param  sums counts to add to
+  * @param  sign 1 to add, -1 to subtract
+  * @retval None
+  */
+
+static void Fenwick_CountWord(uint32_t word, uint8_t lo, uint8_t hi, uint32_t sums[FENWICK_COUNTERS], int8_t sign)
+{
+	uint32_t mask = ((hi >= 16) ? 0xFFFFFFFF : ((1u << (2 * hi)) - 1)) & ~((1u << (2 * lo)) - 1) & 0x55555555;
+	uint32_t x;
+
+	for(uint8_t c = 0; c < FENWICK_COUNTERS; c++)
+	{
+		x = word ^ (0x55555555u * c);		// Fields equal to c become 00
+		sums[c] += sign * __builtin_popcount(~(x | (x >> 1)) & mask);
+	}
+}
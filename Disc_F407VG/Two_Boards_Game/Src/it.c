@@ -12,7 +12,13 @@
 
 // Global variables shared with other modules
 extern CAN_HandleTypeDef hcan1;
+extern CAN_HandleTypeDef hcan2;
 extern TIM_HandleTypeDef htimer6;
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern UART_HandleTypeDef huart2;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern void slcan_rx_poll(void);
 
 
 /**
@@ -70,6 +76,50 @@ void CAN1_SCE_IRQHandler(void)
 }
 
 
+/**
+  * @brief This function handles interrupt request specifically for
+  * message transmission via CAN2 peripheral (dual-bus mode)
+  */
+
+void CAN2_TX_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * messages received in CAN2 FIFO0 (dual-bus mode)
+  */
+
+void CAN2_RX0_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * messages received in CAN2 FIFO1 (dual-bus mode)
+  */
+
+void CAN2_RX1_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * status changes and errors (SCE) on CAN2 (dual-bus mode)
+  */
+
+void CAN2_SCE_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
 /**
   * @brief This function handles interrupt request specifically for
   * the basic timer, TIM6
@@ -80,3 +130,53 @@ void TIM6_DAC_IRQHandler(void)
 	HAL_TIM_IRQHandler(&htimer6);
 }
 
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * DMA2 Stream 5, which feeds the LED pattern frames to GPIOD on TIM1 update
+  */
+
+void DMA2_Stream5_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_tim1_up);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * USART2: in slcan bridge mode an idle line ends a burst of bytes from the PC,
+  * which the Rx DMA has written, and the end of each DMA transmission
+  */
+
+void USART2_IRQHandler(void)
+{
+	if(__HAL_UART_GET_FLAG(&huart2, UART_FLAG_IDLE) && __HAL_UART_GET_IT_SOURCE(&huart2, UART_IT_IDLE))
+	{
+		__HAL_UART_CLEAR_IDLEFLAG(&huart2);
+		slcan_rx_poll();
+	}
+
+	HAL_UART_IRQHandler(&huart2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * DMA1 Stream 5, which writes the bytes from the PC in circles (slcan bridge)
+  */
+
+void DMA1_Stream5_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart2_rx);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * DMA1 Stream 6, which sends the slcan lines to the PC
+  */
+
+void DMA1_Stream6_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
@@ -0,0 +1,326 @@
+/**
+  ******************************************************************************
+  * @file    led_pattern.c
+  * @author  Moe2Code
+  * @brief   Timer driven LED pattern engine for Disc's 4x LEDs. A pattern is a table of
+  *          GPIOD BSRR words (frames). TIM1 update events trigger DMA2 Stream 5 which copies
+  *          the next frame into GPIOD->BSRR, so animations run without any CPU per frame.
+  *          The following is conducted in source file:
+  *          + Initialization of TIM1 (frame clock) and its update DMA request
+  *          + Generation of blink patterns for error codes, result streaks and sleep countdown
+  *          + Generation of a fade (breathing) pattern using DMA driven software PWM
+  * @note    DMA1 cannot reach the AHB1 GPIO ports on STM32F4, thus TIM1 (served by DMA2) is used
+  */
+
+// Includes
+#include "led_pattern.h"
+
+
+// Global variables
+TIM_HandleTypeDef htimer1 = {0};			// Timer 1 (TIM1) peripheral handle. Clocks the LED frames
+DMA_HandleTypeDef hdma_tim1_up = {0};		// DMA2 Stream 5 handle. Moves LED frames to GPIOD->BSRR on TIM1 update
+uint32_t led_frames[LED_FRAME_BUF_LEN] = {0};	// BSRR frames of the pattern currently playing
+uint8_t led_engine_ready = FALSE;			// Set once TIM1 and its DMA stream are initialized
+void (*led_done_cb)(void) = NULL;			// Called once a one-shot pattern has played its last frame. Set while it plays
+
+
+// Function prototypes
+extern void Error_handler(void);
+static void LED_Pattern_Halt(void);
+static void LED_Pattern_Play(uint16_t n_frames, uint16_t frame_ticks, uint32_t dma_mode, void (*on_done)(void));
+static void LED_Pattern_XferCplt(DMA_HandleTypeDef *hdma);
+
+
+/**
+  * @brief  Selects TIM1 and configures it to tick every 100 us. The period (frame duration)
+  * 		is set per pattern. The DMA stream is linked to TIM1 in HAL_TIM_Base_MspInit()
+  * @param  None
+  * @retval None
+  */
+
+void LED_Pattern_Init(void)
+{
+	// TIM1 is hanging on APB2. PCLK2 = SYSCLK/2 = 25 MHz, TIM1_CLK = PCLK2 * 2 = SYSCLK = 50 MHz
+	// Prescalar reduces the rate to 50M/5000 = 10 kHz (100 us tick)
+	htimer1.Instance = TIM1;
+	htimer1.Init.Prescaler = 4999;
+	htimer1.Init.Period = LED_FRAME_100MS-1;
+	htimer1.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htimer1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htimer1.Init.RepetitionCounter = 0;
+
+	if(HAL_TIM_Base_Init(&htimer1) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	led_engine_ready = TRUE;
+}
+
+
+/**
+  * @brief  Returns whether the LED pattern engine can be used
+  * @param  None
+  * @retval TRUE if LED_Pattern_Init() completed, FALSE otherwise
+  */
+
+uint8_t LED_Pattern_IsReady(void)
+{
+	return led_engine_ready;
+}
+
+
+/**
+  * @brief  Stops the pattern currently playing. LEDs keep the state of the last frame written.
+  * 		A one-shot pattern (sleep countdown) is not stopped: what follows it, Standby, must
+  * 		not be lost to a game result or an error shown meanwhile
+  * @param  None
+  * @retval TRUE if the LEDs are free, FALSE if a one-shot pattern keeps playing
+  */
+
+uint8_t LED_Pattern_Stop(void)
+{
+	if(led_engine_ready == FALSE)
+	{
+		return TRUE;
+	}
+
+	if(led_done_cb != NULL)
+	{
+		return FALSE;
+	}
+
+	LED_Pattern_Halt();
+
+	return TRUE;
+}
+
+
+/**
+  * @brief  Blinks the blue LED err_code times followed by a pause. Repeats until stopped
+  * @param  err_code number of blinks (LED_ERR_xxx)
+  * @retval None
+  */
+
+void LED_Pattern_Error(uint8_t err_code)
+{
+	uint16_t n = 0;
+
+	for(uint8_t i = 0; i < err_code && n < LED_FRAME_BUF_LEN - 14; i++)
+	{
+		led_frames[n++] = LED_BSRR_ONLY(LED_BLUE);		// 200 ms on
+		led_frames[n++] = LED_BSRR_ONLY(LED_BLUE);
+		led_frames[n++] = LED_BSRR_ONLY(0);				// 200 ms off
+		led_frames[n++] = LED_BSRR_ONLY(0);
+	}
+
+	for(uint8_t i = 0; i < 10; i++)						// 1 s pause before the code repeats
+	{
+		led_frames[n++] = LED_BSRR_ONLY(0);
+	}
+
+	LED_Pattern_Play(n, LED_FRAME_100MS, DMA_CIRCULAR, NULL);
+}
+
+
+/**
+  * @brief  Flashes the result LED once per game of the current streak, then holds it on
+  * 		for a second. Repeats until stopped (next game result)
+  * @param  led_mask LED(s) of the result that is on a streak
+  * @param  streak_len number of same results in a row
+  * @retval None
+  */
+
+void LED_Pattern_Streak(uint16_t led_mask, uint8_t streak_len)
+{
+	uint16_t n = 0;
+
+	if(streak_len > 8)		// Cap flashes so the pattern stays readable
+	{
+		streak_len = 8;
+	}
+
+	for(uint8_t i = 0; i < streak_len; i++)
+	{
+		led_frames[n++] = LED_BSRR_ONLY(led_mask);		// 100 ms on
+		led_frames[n++] = LED_BSRR_ONLY(0);				// 100 ms off
+	}
+
+	for(uint8_t i = 0; i < 10; i++)						// Hold result LED on for 1 s
+	{
+		led_frames[n++] = LED_BSRR_ONLY(led_mask);
+	}
+
+	LED_Pattern_Play(n, LED_FRAME_100MS, DMA_CIRCULAR, NULL);
+}
+
+
+/**
+  * @brief  Breathing effect on the given LED(s). Each 1 ms frame is a slot of an 8-slot software
+  * 		PWM period (125 Hz). The duty steps up 0/8 to 7/8 then down 8/8 to 1/8, holding each
+  * 		level for 4 PWM periods. One breath lasts 512 ms. Repeats until stopped
+  * @param  led_mask LED(s) to fade
+  * @retval None
+  */
+
+void LED_Pattern_Fade(uint16_t led_mask)
+{
+	const uint8_t levels = 8, slots = 8, hold = 4;	// levels * slots * hold * 2 = LED_FRAME_BUF_LEN
+	uint16_t n = 0;
+	uint8_t duty;
+
+	for(uint8_t ramp = 0; ramp < 2; ramp++)			// 0: fade in, 1: fade out
+	{
+		for(uint8_t lvl = 0; lvl < levels; lvl++)
+		{
+			duty = (ramp == 0) ? lvl : (levels - lvl);
+
+			for(uint8_t h = 0; h < hold; h++)
+			{
+				for(uint8_t s = 0; s < slots; s++)
+				{
+					led_frames[n++] = (s < duty) ? LED_BSRR_ONLY(led_mask) : LED_BSRR_ONLY(0);
+				}
+			}
+		}
+	}
+
+	LED_Pattern_Play(n, LED_FRAME_1MS, DMA_CIRCULAR, NULL);
+}
+
+
+/**
+  * @brief  Blinks the red LED three times with a shrinking gap, then turns all LEDs off.
+  * 		Plays once and cannot be stopped or replaced. on_done is called from the DMA
+  * 		transfer complete interrupt once the last frame is out, or right away if the
+  * 		engine cannot play the countdown
+  * @param  on_done function to call once the countdown ends (e.g. enter Standby mode)
+  * @retval None
+  */
+
+void LED_Pattern_SleepCountdown(void (*on_done)(void))
+{
+	uint16_t n = 0;
+
+	for(uint8_t i = 3; i > 0; i--)
+	{
+		for(uint8_t j = 0; j < 2; j++)
+		{
+			led_frames[n++] = LED_BSRR_ONLY(LED_RED);	// 200 ms on
+		}
+
+		for(uint8_t j = 0; j < i; j++)
+		{
+			led_frames[n++] = LED_BSRR_ONLY(0);			// 300, 200, 100 ms off
+		}
+	}
+
+	led_frames[n++] = LED_BSRR_ONLY(0);
+
+	LED_Pattern_Play(n, LED_FRAME_100MS, DMA_NORMAL, on_done);
+
+	if(led_engine_ready == FALSE)
+	{
+		on_done();
+	}
+}
+
+
+/**
+  * @brief  Stops TIM1 and DMA2 Stream 5, whatever pattern is playing
+  * @param  None
+  * @retval None
+  */
+
+static void LED_Pattern_Halt(void)
+{
+	HAL_TIM_Base_Stop(&htimer1);
+	__HAL_TIM_DISABLE_DMA(&htimer1, TIM_DMA_UPDATE);
+
+	if(hdma_tim1_up.State == HAL_DMA_STATE_BUSY)
+	{
+		HAL_DMA_Abort(&hdma_tim1_up);
+	}
+
+	led_done_cb = NULL;
+}
+
+
+/**
+  * @brief  Starts TIM1 and DMA2 Stream 5 to push n_frames frames from led_frames[] to GPIOD->BSRR.
+  * 		Circular patterns run without interrupts. One-shot (normal mode) patterns use the
+  * 		transfer complete interrupt to report the end of the pattern. Nothing is started
+  * 		while a one-shot pattern plays
+  * @param  n_frames number of frames in led_frames[]
+  * @param  frame_ticks frame duration in 100 us ticks
+  * @param  dma_mode DMA_CIRCULAR or DMA_NORMAL
+  * @param  on_done one-shot patterns: called once the last frame is out. NULL otherwise
+  * @retval None
+  */
+
+static void LED_Pattern_Play(uint16_t n_frames, uint16_t frame_ticks, uint32_t dma_mode, void (*on_done)(void))
+{
+	HAL_StatusTypeDef status;
+
+	if(led_engine_ready == FALSE || led_done_cb != NULL)
+	{
+		return;
+	}
+
+	LED_Pattern_Halt();
+
+	// DMA mode can only be changed while the stream is disabled
+	hdma_tim1_up.Init.Mode = dma_mode;
+
+	if(HAL_DMA_Init(&hdma_tim1_up) != HAL_OK)
+	{
+		led_engine_ready = FALSE;	// Prevents Error_handler() from re-entering the engine
+		Error_handler();
+	}
+
+	__HAL_TIM_SET_AUTORELOAD(&htimer1, frame_ticks-1);
+	__HAL_TIM_SET_COUNTER(&htimer1, 0);
+
+	if(dma_mode == DMA_NORMAL)
+	{
+		led_done_cb = on_done;		// Before the stream starts: its transfer complete interrupt reads it
+		hdma_tim1_up.XferCpltCallback = LED_Pattern_XferCplt;
+		status = HAL_DMA_Start_IT(&hdma_tim1_up, (uint32_t)led_frames, (uint32_t)&GPIOD->BSRR, n_frames);
+	}
+	else
+	{
+		status = HAL_DMA_Start(&hdma_tim1_up, (uint32_t)led_frames, (uint32_t)&GPIOD->BSRR, n_frames);
+	}
+
+	if(status != HAL_OK)
+	{
+		led_engine_ready = FALSE;
+		Error_handler();
+	}
+
+	GPIOD->BSRR = led_frames[0];	// Show the first frame now rather than one frame later
+
+	__HAL_TIM_ENABLE_DMA(&htimer1, TIM_DMA_UPDATE);
+	HAL_TIM_Base_Start(&htimer1);
+}
+
+
+/**
+  * @brief  DMA transfer complete callback for one-shot patterns
+  * @param  hdma pointer to the DMA handle of TIM1 update (DMA2 Stream 5)
+  * @retval None
+  */
+
+static void LED_Pattern_XferCplt(DMA_HandleTypeDef *hdma)
+{
+	void (*cb)(void) = led_done_cb;
+
+	HAL_TIM_Base_Stop(&htimer1);
+	__HAL_TIM_DISABLE_DMA(&htimer1, TIM_DMA_UPDATE);
+	led_done_cb = NULL;
+
+	if(cb != NULL)
+	{
+		cb();
+	}
+}
@@ -12,11 +12,33 @@
   *            time and date. The time and date will be acquired from the RTC peripheral
   *          + Low power management of board via CAN messages
   *          + Energization of different LED based on whether the game is a win, loss, or a tie
+  *          + LED patterns (error codes, result streaks, sleep countdown) via the LED pattern engine
   *          + Error handling when errors occur
+  *          + slcan bridge mode (SLCAN_BRIDGE): CAN1 to and from the PC over USART2, DMA on
+  *            both UART directions, interrupt-driven CAN, no game
+  *          + Time-triggered CAN (TT_CAN): reference frame every basic cycle, game results in
+  *            the referee window, jitter of the results and hands against the schedule
+  *          + Passive spectator mode (SPECTATOR): CAN1 silent, the game frames go to
+  *            spectator.c and its lines out of USART2 by DMA, no game
+  *          + Referee sessions (REFEREE_SESSIONS): hands of many player nodes, each refereed
+  *            with its own session of session.c, results pending until a Tx mailbox is free
+  *          + Tournament (TOURNAMENT): round robin or Swiss matches between player nodes,
+  *            paired and refereed by tourney.c, standings in backup SRAM after the rollups
   */
 
 // Includes
 #include "main.h"
+#include "can_bus.h"
+#include "secure_msg.h"
+#include "rollup.h"
+#include "fenwick.h"
+#include "strategy.h"
+#include "led_pattern.h"
+#include "slcan.h"
+#include "tt_sched.h"
+#include "spectator.h"
+#include "session.h"
+#include "tourney.h"
 
 
 // Global variables
@@ -26,7 +48,49 @@ TIM_HandleTypeDef htimer6 = {0};		// Timer 6 (TIM6) peripheral handle. TIM6 is a
 RTC_HandleTypeDef hrtc = {0};			// RTC peripheral handle
 CAN_RxHeaderTypeDef RxHeader = {0};		// Stores the header of CAN Rx frame
 uint8_t debounce_cnt = 0;				// Counter to ensure we have a stable button input before we send a CAN message
-char DateTime_Info[100] = {0};          // Char array used to hold time and date details when requested
+char DateTime_Info[200] = {0};          // Char array used to hold time and date details when requested. Stats line is appended to it
+uint8_t last_winner = 0;				// Result of the previous game. Used to detect streaks
+uint8_t streak_cnt = 0;					// Number of same results in a row
+CAN_RxStats_t can_rx_stats = {0};		// Counters kept by the CAN Rx path (FIFO full/overrun, backlog)
+uint8_t can_burst_mode = FALSE;			// TRUE while the catch-all filter feeds FIFO1 to absorb a burst
+uint8_t can_quiet_drains = 0;			// IRQ entries in a row that found no backlog
+Strategy_Player_t disc_player = {0};	// Picks Disc's hands with the strategy set by DISC_STRATEGY
+uint32_t strategy_max_cycles = 0;		// Worst pick + observe time of the strategy seen so far (DWT cycles)
+DMA_HandleTypeDef hdma_usart2_rx = {0};	// USART2 Rx, circular (slcan bridge)
+DMA_HandleTypeDef hdma_usart2_tx = {0};	// USART2 Tx (slcan bridge, spectator)
+Slcan_t slcan = {0};					// slcan protocol state (bridge mode)
+uint8_t slcan_rx_dma[SLCAN_RX_DMA];		// Bytes from the PC, written in circles by DMA1 Stream 5
+uint16_t slcan_rx_pos = 0;				// Next byte of slcan_rx_dma to parse
+char slcan_tx_ring[SLCAN_TX_RING];		// Lines to the PC. DMA1 Stream 6 sends from tail, lines are added at head
+uint16_t slcan_tx_head = 0;
+uint16_t slcan_tx_tail = 0;
+uint16_t slcan_tx_busy = 0;				// Length of the DMA transfer under way, 0 if none
+Slcan_Frame_t slcan_can_queue[SLCAN_CAN_QUEUE];	// Frames from the PC waiting for a Tx mailbox
+uint8_t slcan_queue_head = 0;
+uint8_t slcan_queue_tail = 0;
+// CAN1 bit timing of the slcan bit rates S0 to S8 (PCLK1 = 25 MHz). 10 TQ per bit, 5 TQ for 1 Mbit/s. 800 kbit/s cannot be reached
+const uint16_t slcan_prescaler[SLCAN_BITRATES] = {250, 125, 50, 25, 20, 10, 5, 0, 5};
+Tt_Sched_t tt_sched = {0};				// Windows of the basic cycle (TT_CAN). Built once CAN1 is on the bus
+Tt_Jitter_t tt_jitter;					// Reference period, results and hands against their windows
+uint16_t tt_cycle = 0;					// Cycle count of the last reference
+uint32_t tt_tick = 0;					// HAL tick the last cycle was due at, on the TIM6 grid
+uint32_t tt_missed = 0;					// References not sent since the last one went out
+uint8_t tt_result = 0;					// Game result waiting for the referee window, 0 if none
+uint8_t tt_result_sent = FALSE;			// A result went out this cycle: its time stamp is read at the next cycle start
+uint16_t tt_result_stamp = 0;
+Spectator_t spectator;					// Game seen from CAN silent mode (SPECTATOR)
+uint16_t spec_tx_busy = 0;				// Length of the spectator's DMA transfer under way, 0 if none
+#if REFEREE_SESSIONS == TRUE
+Session_Table_t sessions;				// Player nodes refereed at once (about 42 KB, see session.h)
+uint32_t session_scan_tick = 0;			// HAL tick of the last idle scan
+#endif
+#if TOURNAMENT == TRUE
+Tourney_t tourney;						// Matches under way
+Tourney_Store_t *tourney_store = (Tourney_Store_t*)(BKPSRAM_BASE + sizeof(Rollup_Store_t));	// Standings, after the rollups
+uint32_t tourney_scan_tick = 0;			// HAL tick of the last scan for quiet matches
+#endif
+
+extern CAN_HandleTypeDef hcan2;		// CAN2 peripheral handle (can_bus.c). Used in dual-bus mode only
 
 
 // Function prototypes
@@ -37,15 +101,37 @@ void CAN1_Init(void);
 void GPIO_Init(void);
 void CAN1_Tx(void);
 void CAN_Filter_Config(void);
+void CAN_Set_Burst_Mode(uint8_t burst);
+void drain_rx_fifos(CAN_HandleTypeDef *hcan);
+void process_rx_msg(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[]);
 void Timer6_Init(void);
 void manage_LED_output(uint8_t LED_ID);
 uint8_t UART_Msg_Tx(char msg[]);
 uint8_t Determine_Win(uint8_t player1, uint8_t player2);
 void send_game_result(uint8_t winner);
+void send_rollup_reply(uint8_t level, uint8_t back, uint8_t count);
+void send_index_query(uint16_t minutes);
 void RTC_Init(void);
 void RTC_CalendarConfig(void);
 char* get_date_time(void);
 void clear_sleep_flags(void);
+void enter_standby(void);
+void slcan_start(void);
+void slcan_rx_poll(void);
+uint8_t slcan_act(uint8_t action, Slcan_Frame_t *frame);
+void slcan_forward(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[]);
+uint8_t slcan_put(const char *line, uint8_t len);
+void slcan_tx_next(void);
+void slcan_can_pump(void);
+void tt_cycle_start(void);
+void tt_tx_done(CAN_HandleTypeDef *hcan, uint32_t TxMailbox);
+void spec_tx_next(void);
+void referee_hand(uint16_t node, uint8_t hand);
+void session_tx_pending(void);
+void tourney_start(void);
+void tourney_hand(uint16_t node, uint8_t hand);
+void tourney_tx_pending(void);
+void tourney_standings(void);
 
 
 /**
@@ -71,31 +157,100 @@ int main(void)
 
 	GPIO_Init();
 
+	LED_Pattern_Init();		// TIM1 + DMA2 drive LED animations straight to GPIOD
+
 	RTC_Init();
 
-	RTC_CalendarConfig();
+	if((hrtc.Instance->ISR & RTC_ISR_INITS) == 0)	// Calendar only set after a backup domain reset, so time
+	{												// keeps running through Standby and keys the rollups
+		RTC_CalendarConfig();
+	}
+
+	Rollup_Init();			// Minute/hour/day game history in backup SRAM
 
 	CAN1_Init();	// Moves CAN peripheral from sleep to initialization state
 
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+	CAN2_Init();			// Second bus. Must be initialized before its filter banks are configured
+#endif
+
 	CAN_Filter_Config();	// Filter config for CAN Rx must be done in initialization state
 
-	uint32_t active_IT = CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_BUSOFF;	  // Interrupts to activate for CAN
+	Secure_Init();			// MAC subkeys and access to the frame counters (used when SECURE_CAN is TRUE)
+
+	Spec_Init(&spectator, SPEC_BIT_NS);	// Follows the frames from the start of the bus (used when SPECTATOR is TRUE)
+
+	uint32_t active_IT = CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING | \
+						 CAN_IT_RX_FIFO0_FULL | CAN_IT_RX_FIFO1_FULL | CAN_IT_RX_FIFO0_OVERRUN | \
+						 CAN_IT_RX_FIFO1_OVERRUN | CAN_IT_ERROR | CAN_IT_BUSOFF;	  // Interrupts to activate for CAN
+
+	if(SLCAN_BRIDGE == TRUE)
+	{
+		active_IT |= CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_LAST_ERROR_CODE;	// Raise the F status flags too
+	}
 
 	if( HAL_CAN_ActivateNotification(&hcan1, active_IT) != HAL_OK)   // Activates the CAN interrupts needed
 	{
 		Error_handler();   // Go to error handler if the activation of interrupts was not successful
 	}
 
-	if(HAL_CAN_Start(&hcan1) != HAL_OK)		// Moves CAN from initialization to normal state
+	// Moves CAN from initialization to normal state. In bridge mode the PC opens the bus (slcan O or L)
+	if(SLCAN_BRIDGE == FALSE && HAL_CAN_Start(&hcan1) != HAL_OK)
 	{
 		Error_handler();   // Go to error handler if the transfer to normal state was not successful
 	}
 
-	srand(time(NULL));   	// Initialize random seed into rand(); should be called once only
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+	if(HAL_CAN_ActivateNotification(&hcan2, active_IT) != HAL_OK || HAL_CAN_Start(&hcan2) != HAL_OK)
+	{
+		Error_handler();
+	}
+#endif
+
+#if TT_CAN == TRUE
+	Tt_Jitter_Init(&tt_jitter);
+
+	if(Tt_Build(&tt_sched, TT_PLAYERS, TT_BIT_NS, TT_CYCLE_MS * 1000) == 0)	// References start at the next TIM6 update
+	{
+		Error_handler();
+	}
+#endif
+
+	// Initialize random seed into rand() from the 96-bit unique device ID; should be called once only.
+	// No clock on target (time() returns -1): both boards would draw the same hands and always tie
+	srand(HAL_GetUIDw0() ^ (HAL_GetUIDw1() * 0x9E3779B1U) ^ (HAL_GetUIDw2() * 0x85EBCA6BU));
+
+	Strategy_Init(&disc_player, DISC_STRATEGY, rand() + 1);
+
+#if REFEREE_SESSIONS == TRUE
+	Session_Init(&sessions);		// Each session seeds its own strategy when its node first plays
+#endif
+
+#if TOURNAMENT == TRUE
+	tourney_start();				// Or picks up the one the backup SRAM kept
+#endif
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;		// DWT cycle counter times the strategy
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 
 	UART_Msg_Tx("Disc initialization successful\r\n");
 
-	while(1);
+	LED_Pattern_Fade(LED_ALL);	// Breathes until the first game result, see manage_LED_output()
+
+	if(SLCAN_BRIDGE == TRUE)
+	{
+		slcan_start();		// USART2 now speaks slcan only
+	}
+
+	HAL_DBGMCU_EnableDBGSleepMode();	// Keeps the debug clocks, so SWD stays connected while the core sleeps
+
+	HAL_PWR_EnableSleepOnExit();	// Everything runs in interrupts: the core goes back to sleep after each one
+
+	while(1)
+	{
+		HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+	}
 
 	return 0;
 }
@@ -139,13 +294,13 @@ void CAN1_Init(void)
 	// Check CAN timing calc table to see if a certain CAN bit rate can be achieved
 
 	hcan1.Instance = CAN1;
-	hcan1.Init.Mode = CAN_MODE_NORMAL;
-	hcan1.Init.AutoBusOff = DISABLE;
-	hcan1.Init.AutoRetransmission = ENABLE;		// Retransmit message until it is successfully received
+	hcan1.Init.Mode = (SPECTATOR == TRUE) ? CAN_MODE_SILENT : CAN_MODE_NORMAL;	// Silent: receives without driving a single bit, ACK included
+	hcan1.Init.AutoBusOff = (DUAL_CAN_MODE == DUAL_CAN_OFF) ? DISABLE : ENABLE;	// In dual-bus mode a bus-off bus recovers by hardware
+	hcan1.Init.AutoRetransmission = (TT_CAN == TRUE) ? DISABLE : ENABLE;	// Retransmit message until it is successfully received. A retry would miss its window in TT_CAN
 	hcan1.Init.AutoWakeUp = DISABLE;			// During message reception, sleep mode is left on software request
-	hcan1.Init.ReceiveFifoLocked = DISABLE;  	// Allow message overwrite if receive FIFO is full
-	hcan1.Init.TimeTriggeredMode = DISABLE;
-	hcan1.Init.TransmitFifoPriority = DISABLE;	// Priority configured to be driven by the identifier of the message
+	hcan1.Init.ReceiveFifoLocked = DISABLE;  	// Allow message overwrite if receive FIFO is full. Overruns are counted in HAL_CAN_ErrorCallback()
+	hcan1.Init.TimeTriggeredMode = (TT_CAN == TRUE || SPECTATOR == TRUE) ? ENABLE : DISABLE;	// Frames time stamped at their SOF, in bit times
+	hcan1.Init.TransmitFifoPriority = (TOURNAMENT == TRUE) ? ENABLE : DISABLE;	// Priority driven by the identifier, or the order of the requests: a player's pairing after its last result
 
 	// Settings related to CAN bit timing
 	// Settings to Tx/Rx at 500 kbit/s
@@ -162,19 +317,62 @@ void CAN1_Init(void)
 
 
 /**
-  * @brief	Selects a filter bank (FB0) for hcan1 (CAN1) and sets its properties
+  * @brief	Configures two filter banks per bus in use (FB0/FB1 for CAN1, FB14/FB15 for CAN2). FB0 is an ID list holding the game
+  * 		frames this board acts on and always feeds FIFO0. FB1 accepts everything else
+  * 		(no mask) and feeds FIFO0 until a burst is detected, see CAN_Set_Burst_Mode()
   * @param	None
-  * @note	No filter mask applied
+  * @note	An ID list filter has priority over a mask filter of the same scale, so game
+  * 		frames always land in FB0
   * @retval None
   */
 
 void CAN_Filter_Config(void)
 {
 	CAN_FilterTypeDef can1_filter_init = {0};
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
 
 	can1_filter_init.FilterActivation = ENABLE;
-	can1_filter_init.FilterBank = 0;
+	can1_filter_init.SlaveStartFilterBank = CAN2_FILTER_BANK_START;	// Banks 0-13 for CAN1, 14-27 for CAN2
 	can1_filter_init.FilterFIFOAssignment = CAN_RX_FIFO0;
+	// Game traffic Disc acts on: Nucleo's hand (0x49F) and the sleep message (0x77B)
+	can1_filter_init.FilterIdHigh = 0x49F << 5;			// STDID sits in bits 31:21 of a 32-bit filter
+	can1_filter_init.FilterIdLow = 0x0000;				// IDE = 0, RTR = 0 (data frame)
+	can1_filter_init.FilterMaskIdHigh = 0x77B << 5;		// Second ID of the list
+	can1_filter_init.FilterMaskIdLow = 0x0000;
+	can1_filter_init.FilterMode = CAN_FILTERMODE_IDLIST;
+	can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
+
+	for(uint8_t bus = 0; bus < CAN_BUS_IN_USE; bus++)
+	{
+		can1_filter_init.FilterBank = bus * CAN2_FILTER_BANK_START;
+
+		if(HAL_CAN_ConfigFilter(hcan[bus], &can1_filter_init) != HAL_OK)
+		{
+			Error_handler();
+		}
+	}
+
+	CAN_Set_Burst_Mode(FALSE);	// FB1 (catch-all) starts on FIFO0
+}
+
+
+/**
+  * @brief	Moves the catch-all filter bank (FB1, and FB15 in dual-bus mode) between the Rx FIFOs. In burst mode the
+  * 		other bus traffic goes to FIFO1 so the game frames have FIFO0 (3 frames deep) to
+  * 		themselves
+  * @param	burst TRUE to feed FB1 into FIFO1, FALSE to feed it into FIFO0
+  * @note	Reception is briefly halted by the filter init mode while FB1 is rewritten
+  * @retval None
+  */
+
+void CAN_Set_Burst_Mode(uint8_t burst)
+{
+	CAN_FilterTypeDef can1_filter_init = {0};
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
+
+	can1_filter_init.FilterActivation = ENABLE;
+	can1_filter_init.SlaveStartFilterBank = CAN2_FILTER_BANK_START;
+	can1_filter_init.FilterFIFOAssignment = (burst == TRUE) ? CAN_RX_FIFO1 : CAN_RX_FIFO0;
 	can1_filter_init.FilterIdHigh = 0x0000;
 	can1_filter_init.FilterIdLow = 0x0000;
 	can1_filter_init.FilterMaskIdHigh = 0x0000;
@@ -182,10 +380,23 @@ void CAN_Filter_Config(void)
 	can1_filter_init.FilterMode = CAN_FILTERMODE_IDMASK;
 	can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
 
-	if(HAL_CAN_ConfigFilter(&hcan1, &can1_filter_init) != HAL_OK)
+	for(uint8_t bus = 0; bus < CAN_BUS_IN_USE; bus++)
 	{
-		Error_handler();
+		can1_filter_init.FilterBank = bus * CAN2_FILTER_BANK_START + 1;
+
+		if(HAL_CAN_ConfigFilter(hcan[bus], &can1_filter_init) != HAL_OK)
+		{
+			Error_handler();
+		}
+	}
+
+	if(burst == TRUE && can_burst_mode == FALSE)
+	{
+		can_rx_stats.burst_switches++;
 	}
+
+	can_burst_mode = burst;
+	can_quiet_drains = 0;
 }
 
 
@@ -198,7 +409,6 @@ void CAN_Filter_Config(void)
 void CAN1_Tx(void)
 {
 	CAN_TxHeaderTypeDef TxHeader = {0};
-	uint32_t TxMailbox;					// ID for the selected Tx mailbox will be stored in this variable.
 	uint8_t can_msg;
 
 	TxHeader.DLC = 4; 					// Length of message to request (4 bytes)
@@ -206,7 +416,7 @@ void CAN1_Tx(void)
 	TxHeader.IDE = CAN_ID_STD;			// Is ID for standard or extended CAN?
 	TxHeader.RTR = CAN_RTR_REMOTE;  	// Request to transmit data frame or remote frame?
 
-	if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, &can_msg, &TxMailbox) != HAL_OK)	 // Add a message to the first free Tx mailbox and activate the corresponding transmission request
+	if(CAN_Bus_Tx(&TxHeader, &can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
 		Error_handler();
 	}
@@ -262,16 +472,19 @@ uint8_t Determine_Win(uint8_t player1, uint8_t player2)
 void send_game_result(uint8_t winner)
 {
 	CAN_TxHeaderTypeDef TxHeader = {0};
-	uint32_t TxMailbox;						// ID for selected mailbox will be stored in this variable.
 	char *game_result[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
 	char uart_msg[100];
+	uint8_t result[2] = {winner, 0};	// DLC is 2: the second byte is sent as 0, not read past winner
 
 	TxHeader.DLC = 2; 				// Length of message to transmit in bytes
 	TxHeader.StdId = 0x111;
 	TxHeader.IDE = CAN_ID_STD;		// Is ID for standard or extended CAN?
 	TxHeader.RTR = CAN_RTR_DATA;  	// Request to transmit data frame or remote frame?
 
-	if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, &winner, &TxMailbox) != HAL_OK)	// Add a message to the first free Tx mailbox and activate the corresponding transmission request
+	if(TT_CAN == TRUE)				// Goes out in the referee window of the next cycle, see tt_cycle_start()
+	{
+		tt_result = winner;
+	}else if(CAN_Bus_Tx(&TxHeader, result) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
 		UART_Msg_Tx("send_game_result HAL_CAN_AddTxMessage Tx error\r\n");
 		Error_handler();
@@ -283,334 +496,1096 @@ void send_game_result(uint8_t winner)
 
 
 /**
-  * @brief	Rx FIFO 0 message pending callback.
-  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
-  *         the configuration information for the specified CAN
+  * @brief	Referees the hand of a player node (REFEREE_SESSIONS): Disc plays it with the
+  * 		strategy state of the node's session, opened at its first hand, and sends the
+  * 		result on the node's result ID
+  * @param	node player node, 0 to SESSION_NODES - 1
+  * @param	hand the node's hand
+  * @note	A node that finds the table full gets no result until an idle session is closed
   * @retval None
   */
 
-void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
+void referee_hand(uint16_t node, uint8_t hand)
 {
-	uint8_t rcvd_msg[8] = {0};				// CAN frame can contain 8 bytes
+#if REFEREE_SESSIONS == TRUE
 	char uart_msg[100];
-	char game_stats[100] = {0};
 	char *playerspick[3] = {"Rock", "Paper", "Scissors"};
-	uint8_t Disc_pick = 0;
-	uint8_t winner = 0;
-
-	// Release a message from Rx FIFO0
-	if(HAL_CAN_GetRxMessage(&hcan1, CAN_RX_FIFO0, &RxHeader, rcvd_msg) != HAL_OK)
-	{
-		Error_handler();
-	}
+	uint16_t p = Session_Find(&sessions, node);		// One or two probes: the index is half full at most
+	uint8_t Disc_pick, winner;
+	uint32_t cycles;
 
-	if(RxHeader.StdId == 0x49F && RxHeader.RTR == CAN_RTR_DATA)				// Nucleo sent its hand to Disc
+	if(p == SESSION_NONE)
 	{
-		sprintf(uart_msg, "Message received. Nucleo's hand is %s\r\n", playerspick[rcvd_msg[0]]);
+		p = Session_Open(&sessions, node, HAL_GetTick(), DISC_STRATEGY, rand() + 1);
 
-		UART_Msg_Tx(uart_msg);
+		if(p == SESSION_NONE)
+		{
+			sprintf(uart_msg, "Player %u refused: %u sessions open\r\n", node, SESSION_MAX);
+			UART_Msg_Tx(uart_msg);
+			return;
+		}
+	}
 
-		Disc_pick = rand() % 3;				// To generate a random integer between 0 to 2 and act as Discovery's pick of rock, paper, scissors
-		Disc_pick = rand() % 3;				// Called again to prevent the same hand as Nucleo's to be picked
+	sprintf(uart_msg, "Message received. Player %u's hand is %s\r\n", node, (hand <= 2) ? playerspick[hand] : "unknown");
+	UART_Msg_Tx(uart_msg);
 
-		sprintf(uart_msg, "Disc's hand is %s\r\n", playerspick[Disc_pick]);
+	cycles = DWT->CYCCNT;
 
-		UART_Msg_Tx(uart_msg);
+	Disc_pick = Strategy_Pick(&sessions.strategy[p]);				// The node's own history, as disc_player has Nucleo's
+	Strategy_Observe(&sessions.strategy[p], Disc_pick, (hand <= 2) ? hand : STRATEGY_NO_HAND);
 
-		winner = Determine_Win(rcvd_msg[0], Disc_pick);		// To determine winner of Rock, Paper, Scissors
+	cycles = DWT->CYCCNT - cycles;
 
-		manage_LED_output(winner);			// Turn on the appropriate LED to indicate game result
+	if(cycles > strategy_max_cycles)
+	{
+		strategy_max_cycles = cycles;
+	}
 
-		send_game_result(winner);			// Disc to send game result to Nucleo
+	winner = Determine_Win(hand, Disc_pick);
 
-	// StdId cannot be a value beyond 0x7FF
-	}else if(RxHeader.StdId == 0x633 && RxHeader.RTR == CAN_RTR_DATA)		// Game stats sent from Nucleo to Disc
-	{
-		sprintf(game_stats, "STATS: Nucleo Wins: %d, Disc Wins: %d, Ties: %d, Game Error: %d\r\n", rcvd_msg[0], rcvd_msg[1], rcvd_msg[2], rcvd_msg[3]);
+	manage_LED_output(winner);
 
-		// get_date_time() uses RTC to get current time and return it as a pointer to a string
-		UART_Msg_Tx(strcat(get_date_time(), game_stats));					// strcat() returns dest, the pointer to the destination string.
+	Rollup_Record(winner);				// All players add to the minute/hour/day history
 
-	}else if(RxHeader.StdId == 0x77B && RxHeader.RTR == CAN_RTR_DATA)		// Message from Nucleo to go to sleep
-	{
-		UART_Msg_Tx("Light lost; gone to sleep\r\n");
+	Session_Result(&sessions, p, hand, winner, HAL_GetTick());
 
-		// Configure WAKEUP_PIN1 (PA0) as a wakeup pin in order to exit Standby mode
-		// PA0 will be pulled down to ground when configured as WAKEUP_PIN1
-		// Thus a rising edge signal to PA0 will wake up the MCU from Standby mode
-		HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
+	sprintf(uart_msg, "Disc's hand is %s, result for player %u: %u\r\n", playerspick[Disc_pick], node, winner);
+	UART_Msg_Tx(uart_msg);
 
-		HAL_PWR_EnterSTANDBYMode();		// Enters Standby mode using WFI
-	}
+	session_tx_pending();				// This result, and any other still waiting
+#else
+	(void)node;
+	(void)hand;
+#endif
 }
 
 
 /**
-  * @brief	Returns current date and time from RTC
+  * @brief	Sends the results of the sessions that wait for a Tx mailbox, as long as one is
+  * 		free (REFEREE_SESSIONS). Called after each hand and when a mailbox completes
   * @param	None
-  * @retval Pointer to the start of the string carrying date and time info
+  * @retval None
   */
 
-char* get_date_time(void)
+void session_tx_pending(void)
 {
-	RTC_TimeTypeDef RTC_TimeRead = {0};
-	RTC_DateTypeDef RTC_DateRead = {0};
-	char *TimeFormat[] = {"AM", "PM"};
+#if REFEREE_SESSIONS == TRUE
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	uint16_t p;
 
-	if( HAL_RTC_GetTime(&hrtc, &RTC_TimeRead, RTC_FORMAT_BIN) != HAL_OK)
-	{
-		Error_handler();
-	}
+	TxHeader.DLC = 2;
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
 
-	if( HAL_RTC_GetDate(&hrtc, &RTC_DateRead, RTC_FORMAT_BIN) != HAL_OK)
+	while((p = Session_NextPending(&sessions)) != SESSION_NONE)
 	{
-		Error_handler();
-	}
+		uint8_t result[2] = {sessions.pending[p], 0};
 
-	sprintf(DateTime_Info, "20%02d-%02d-%02d %02d:%02d:%02d %s - ", RTC_DateRead.Year, RTC_DateRead.Month, RTC_DateRead.Date, \
-			RTC_TimeRead.Hours, RTC_TimeRead.Minutes, RTC_TimeRead.Seconds, TimeFormat[RTC_TimeRead.TimeFormat/0x40]);
+		TxHeader.StdId = SESSION_RESULT_ID + sessions.node[p];
 
-	return DateTime_Info;
+		if(CAN_Bus_Tx(&TxHeader, result) != HAL_OK)		// Mailboxes full: the next one to complete calls again
+		{
+			break;
+		}
+
+		Session_Sent(&sessions, p);
+	}
+#endif
 }
 
 
 /**
-  * @brief  Error CAN callback.
-  * @param  hcan pointer to a CAN_HandleTypeDef structure that contains
-  *         the configuration information for the specified CAN.
+  * @brief	Starts the tournament (TOURNAMENT), or picks up the one the backup SRAM kept. A
+  * 		tournament found over has its standings printed before a new one starts. Nothing
+  * 		is sent from here: the CAN IRQs and TIM6 would re-enter tourney_tx_pending()
+  * @param	None
+  * @note	Backup SRAM is on: Rollup_Init() comes first
   * @retval None
   */
 
-void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
+void tourney_start(void)
 {
-	UART_Msg_Tx("CAN Error Occurred\r\n");
+#if TOURNAMENT == TRUE
+	char uart_msg[170];
+	uint8_t node[TOURNEY_PLAYERS];
+
+	if(Tourney_Resume(&tourney, tourney_store, HAL_GetTick()) == 1 && tourney_store->done == 0 && \
+	   tourney_store->mode == TOURNEY_MODE && tourney_store->players == TOURNEY_PLAYERS && tourney_store->games == TOURNEY_GAMES)
+	{
+		UART_Msg_Tx("Tournament resumed\r\n");
+	}else
+	{
+		if(tourney_store->magic == TOURNEY_MAGIC && tourney_store->done == 1)
+		{
+			tourney_standings();		// The last one, before it is written over
+		}
+
+		for(uint8_t p = 0; p < TOURNEY_PLAYERS; p++)
+		{
+			node[p] = p;
+		}
+
+		Tourney_Start(&tourney, tourney_store, TOURNEY_MODE, node, TOURNEY_PLAYERS, TOURNEY_GAMES, TOURNEY_MAX_OPEN, \
+					  TOURNEY_OVERLAP, HAL_GetTick());
+	}
+
+	Tourney_Report(&tourney, uart_msg);
+	UART_Msg_Tx(uart_msg);				// The first pairings go out with the next TIM6 scan
+#endif
 }
 
 
 /**
-  * @brief  Selects TIM6, configures its properties, and initializes it. This API also
-  * 		starts time base generation in interrupt mode using the initialized TIM6
-  * @param  None
+  * @brief	Referees the hand of a player node in its match (TOURNAMENT). Nothing is printed
+  * 		while matches are under way: a blocking UART line would let hands pile up in
+  * 		the Rx FIFOs. The standings are printed once the tournament is over, and the
+  * 		TOURNEY line between Swiss rounds, when the bus is quiet
+  * @param	node player node
+  * @param	hand the node's hand
   * @retval None
   */
 
-void Timer6_Init(void)
+void tourney_hand(uint16_t node, uint8_t hand)
 {
-	// Timer period will change if SYSCLK changes
-	// TIM6_CLK =  PCLK1 * 2 = SYSCLK
-	// To select TIM6 and configure its period for 1 ms
-	htimer6.Instance = TIM6;
-	htimer6.Init.Prescaler = 49;
-	htimer6.Init.Period = 1000-1;  // Subtract one to ensure an update event is generated at exactly the time base needed
-
-	// CounterMode is not configured b/c TIM6 (basic timer) can only count up which is the default mode
+#if TOURNAMENT == TRUE
+	char uart_msg[170];
+	uint8_t round = tourney.round;
+	uint8_t done = tourney_store->done;
+	uint8_t result = Tourney_Hand(&tourney, node, hand, HAL_GetTick());
 
-	if(HAL_TIM_Base_Init(&htimer6) != HAL_OK)
+	if(result != 0)
 	{
-		Error_handler();
+		manage_LED_output(result);		// Result of the game for the node whose hand came last
 	}
 
-	// Start the timer base generation in interrupt mode
-	HAL_TIM_Base_Start_IT(&htimer6);
+	tourney_tx_pending();				// Results of the game, pairings of the matches it let start
+
+	if(tourney_store->done != done)		// Last match over: its results are in the mailboxes
+	{
+		tourney_standings();
+	}else if(tourney.round != round && TOURNEY_MODE == TOURNEY_SWISS)
+	{
+		Tourney_Report(&tourney, uart_msg);
+		UART_Msg_Tx(uart_msg);
+	}
+#else
+	(void)node;
+	(void)hand;
+#endif
 }
 
 
 /**
-  * @brief  Period elapsed callback for TIM6 in non-blocking mode. This callback
-  * 		will execute every 1ms to check if the user button is pressed. If
-  * 		the new button state persists (pressed) then CAN1_Tx() is called.
-  * 		This is a way to resolve button debouncing problem.
-  * @param  htim pointer to a TIM_HandleTypeDef structure that contains
-  *         the configuration information for the specified TIM (TIM6)
+  * @brief	Sends the pairings and results that wait for a Tx mailbox, as long as one is free
+  * 		(TOURNAMENT). Called after each hand, from TIM6 and when a mailbox completes
+  * @param	None
   * @retval None
   */
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+void tourney_tx_pending(void)
 {
-	uint8_t btn_state;		// State of user button that is connected to PA0
+#if TOURNAMENT == TRUE
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	Tourney_Frame_t frame;
 
-	btn_state = HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_0);
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
 
-	if(btn_state == GPIO_PIN_SET)	// Button pressed; PA0 is high
-	{
-		debounce_cnt++;
-	}else
+	while(Tourney_NextTx(&tourney, &frame) == 1)
 	{
-		debounce_cnt = 0;
-	}
-
-	// Once pin reading stabilizes at high then transmit CAN message
+		TxHeader.StdId = frame.id;
+		TxHeader.DLC = frame.dlc;
 
-	if(debounce_cnt == 100)			// 100 consecutive milliseconds passed and btn_state is still pressed
-	{
-		debounce_cnt = 0;
+		if(CAN_Bus_Tx(&TxHeader, frame.data) != HAL_OK)		// Mailboxes full: the next one to complete calls again
+		{
+			break;
+		}
 
-		CAN1_Tx();
+		Tourney_Sent(&tourney, &frame);
 	}
+#endif
 }
 
 
 /**
-  * @brief  Selects RTC, configures its properties, and initializes it.
-  * @param  None
+  * @brief	Prints the TOURNEY line and the standings of the tournament (TOURNAMENT)
+  * @param	None
   * @retval None
   */
 
-void RTC_Init(void)
+void tourney_standings(void)
 {
-	char uart_msg[100] = {0};
-
-	hrtc.Instance = RTC;
-	hrtc.Init.HourFormat = RTC_HOURFORMAT_12;
-	hrtc.Init.AsynchPrediv = 0x7F;  			// 127
-	hrtc.Init.SynchPrediv = 0xFF;	    		// 255
-	hrtc.Init.OutPut = RTC_OUTPUT_DISABLE;
-	hrtc.Init.OutPutPolarity = RTC_OUTPUT_POLARITY_HIGH;		// Does not matter b/c output is disabled
-	hrtc.Init.OutPutType = RTC_OUTPUT_TYPE_OPENDRAIN;			// Does not matter b/c output is disabled
+#if TOURNAMENT == TRUE
+	char uart_msg[170];
+	uint8_t rank[TOURNEY_MAX];
+	uint8_t players = Tourney_Ranking(&tourney, rank);
 
-	uint8_t rtc_status = HAL_RTC_Init(&hrtc);
+	Tourney_Report(&tourney, uart_msg);
+	UART_Msg_Tx(uart_msg);
 
-	if( rtc_status != HAL_OK)
+	for(uint8_t place = 0; place < players; place++)
 	{
-		sprintf(uart_msg,"RTC init error: %d\r\n",hrtc.State);
+		Tourney_Standing(&tourney, place + 1, rank[place], uart_msg);
 		UART_Msg_Tx(uart_msg);
-
-		Error_handler();
 	}
+#endif
 }
 
 
 /**
-  * @brief  Configure the RTC calendar for the following: 4:02:00 PM, 01 Feb 2020 Saturday
-  * @param  None
+  * @brief	Answers a range query on the game history with a data frame (ROLLUP_REPLY_ID)
+  * 		and prints the totals via UART
+  * @param	level ROLLUP_MINUTE, ROLLUP_HOUR or ROLLUP_DAY
+  * @param	back number of buckets between the newest bucket of the range and the current one
+  * @param	count number of buckets in the range
   * @retval None
   */
 
-void RTC_CalendarConfig(void)
+void send_rollup_reply(uint8_t level, uint8_t back, uint8_t count)
 {
-	RTC_TimeTypeDef	RTC_TimeInit = {0};
-	RTC_DateTypeDef RTC_DateInit = {0};
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	Rollup_Bucket_t sum;
+	uint32_t totals[4];
+	uint8_t can_msg[8];
+	char uart_msg[150];
+	char *level_name[ROLLUP_LEVELS] = {"min", "h", "d"};
+	uint8_t found;
 
-	RTC_TimeInit.Hours = 4;
-	RTC_TimeInit.Minutes = 02;
-	RTC_TimeInit.Seconds = 00;
-	RTC_TimeInit.TimeFormat = RTC_HOURFORMAT12_PM;
+	found = Rollup_Query(level, back, count, &sum);
 
-	if( HAL_RTC_SetTime(&hrtc, &RTC_TimeInit, RTC_FORMAT_BIN) != HAL_OK)
+	totals[0] = sum.rounds;
+	totals[1] = sum.nucleo_wins;
+	totals[2] = sum.disc_wins;
+	totals[3] = sum.ties;			// Errors = rounds - wins - ties
+
+	for(uint8_t i = 0; i < 4; i++)	// Saturated to 16 bits, LSB first
 	{
-		UART_Msg_Tx("RTC SetTime error\r\n");
+		uint16_t val = (totals[i] > 0xFFFF) ? 0xFFFF : totals[i];
 
-		Error_handler();
+		can_msg[2*i] = (uint8_t)val;
+		can_msg[2*i+1] = (uint8_t)(val >> 8);
 	}
 
-	RTC_DateInit.Date = 1;
-	RTC_DateInit.Month = RTC_MONTH_FEBRUARY;
-	RTC_DateInit.WeekDay = RTC_WEEKDAY_SATURDAY;
-	RTC_DateInit.Year = 20;
+	TxHeader.DLC = 8;
+	TxHeader.StdId = ROLLUP_REPLY_ID;
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
 
-	if( HAL_RTC_SetDate(&hrtc, &RTC_DateInit, RTC_FORMAT_BIN) != HAL_OK)
+	if(CAN_Bus_Tx(&TxHeader, can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
-		UART_Msg_Tx("RTC SetDate error\r\n");
-
+		UART_Msg_Tx("send_rollup_reply HAL_CAN_AddTxMessage Tx error\r\n");
 		Error_handler();
 	}
+
+	sprintf(uart_msg, "ROLLUP query %d x %s, %d back: %d buckets, rounds %lu N %lu D %lu T %lu E %lu\r\n", \
+			count, level_name[(level < ROLLUP_LEVELS) ? level : 0], back, found, (unsigned long)sum.rounds, \
+			(unsigned long)sum.nucleo_wins, (unsigned long)sum.disc_wins, (unsigned long)sum.ties, (unsigned long)sum.errors);
+	UART_Msg_Tx(uart_msg);
 }
 
 
 /**
-  * @brief  Configures and initializes GPIOs for Disc's user button and 4x LEDs
-  * @param  None
+  * @brief	Asks Nucleo for its results over the last minutes (FENWICK_QUERY_ID). Nucleo
+  * 		answers from its round index with a FENWICK_REPLY_ID frame
+  * @param	minutes number of minutes, the current one included
   * @retval None
   */
 
-void GPIO_Init(void)
+void send_index_query(uint16_t minutes)
 {
-	GPIO_InitTypeDef btn_gpio = {0};
-	GPIO_InitTypeDef led_gpio = {0};
-
-	__HAL_RCC_GPIOA_CLK_ENABLE();			// GPIO clock must be enabled before configuring GPIO parameters
-	__HAL_RCC_GPIOD_CLK_ENABLE();
-
-	// User Button (Request game stats) --> PA0
-	btn_gpio.Pin = GPIO_PIN_0;
-	btn_gpio.Mode = GPIO_MODE_INPUT;	// PA0 is pulled down when button is not pressed
-	btn_gpio.Pull = GPIO_NOPULL;
-	HAL_GPIO_Init(GPIOA, &btn_gpio);
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	uint8_t can_msg[3] = {FENWICK_BY_MINUTES, (uint8_t)minutes, (uint8_t)(minutes >> 8)};
 
-	// Configure GPIOs for the LEDs on Node 2
-	// LED1 (G)--> PD12, LED2 (O) --> PD13, LED3 (R) --> PD14, LED4 (B) --> PD15
-	led_gpio.Mode = GPIO_MODE_OUTPUT_PP;
-	led_gpio.Pull = GPIO_NOPULL;
+	TxHeader.DLC = 3;
+	TxHeader.StdId = FENWICK_QUERY_ID;
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
 
-	led_gpio.Pin = GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15;
-	HAL_GPIO_Init(GPIOD, &led_gpio);
+	if(CAN_Bus_Tx(&TxHeader, can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
+	{
+		UART_Msg_Tx("send_index_query HAL_CAN_AddTxMessage Tx error\r\n");
+		Error_handler();
+	}
 }
 
 
 /**
-  * @brief  Turn on the appropriate LED to indicate game result
-  * @param  Unsigned integer with the LED ID for the appropriate switch case
+  * @brief	Rx FIFO 0 message pending callback. Both FIFOs are drained on every IRQ entry
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
   * @retval None
   */
 
-void manage_LED_output(uint8_t LED_ID)
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 {
-	switch(LED_ID)
-	{
-		case 1:	// Turn on LED1 (G); rest is off
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_12, GPIO_PIN_SET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_13, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_14, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_15, GPIO_PIN_RESET);
-			break;
-
-		case 2:	// Turn on LED2 (O); rest is off
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_12, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_13, GPIO_PIN_SET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_14, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_15, GPIO_PIN_RESET);
-			break;
+	drain_rx_fifos(hcan);
+}
 
-		case 3:	// Turn on LED3 (R); rest is off
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_12, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_13, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_14, GPIO_PIN_SET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_15, GPIO_PIN_RESET);
-			break;
 
-		case 4:	// Turn on LED4 (B); rest is off
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_12, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_13, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_14, GPIO_PIN_RESET);
-			HAL_GPIO_WritePin(GPIOD, GPIO_PIN_15, GPIO_PIN_SET);
-			break;
+/**
+  * @brief	Rx FIFO 1 message pending callback. Both FIFOs are drained on every IRQ entry
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval None
+  */
 
-		default:
-			break;
-	}
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+	drain_rx_fifos(hcan);
 }
 
 
 /**
-  * @brief  Selects UART2, configures its properties, and initializes it
-  * @param  None
+  * @brief	Rx FIFO 0 full callback. FIFO0 holds 3 frames; the next one would overwrite
+  * 		the oldest. Moves the other bus traffic to FIFO1
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
   * @retval None
   */
 
-void UART2_Init(void)
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan)
 {
-	huart2.Instance = USART2;
-	huart2.Init.BaudRate = 115200;
-	huart2.Init.WordLength = UART_WORDLENGTH_8B;
-	huart2.Init.StopBits = UART_STOPBITS_1;
-	huart2.Init.Parity = UART_PARITY_NONE;
-	huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-	huart2.Init.Mode = UART_MODE_TX_RX;
+	can_rx_stats.fifo_full[0]++;
 
-	if(HAL_UART_Init(&huart2) != HAL_OK)
+	if(can_burst_mode == FALSE)
 	{
-		//There is a problem. You can blink a red LED or trap in error handler
-		Error_handler();
+		CAN_Set_Burst_Mode(TRUE);
+	}
+}
+
+
+/**
+  * @brief	Rx FIFO 1 full callback
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval None
+  */
+
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan)
+{
+	can_rx_stats.fifo_full[1]++;
+}
+
+
+/**
+  * @brief	Releases every frame waiting in FIFO0 and FIFO1, FIFO0 (game traffic) first.
+  * 		Leaves burst mode once CAN_QUIET_DRAINS entries in a row found at most one frame
+  * @param	hcan pointer to the CAN handle (CAN1 or CAN2) whose FIFOs are drained
+  * @retval None
+  */
+
+void drain_rx_fifos(CAN_HandleTypeDef *hcan)
+{
+	uint8_t rcvd_msg[8];					// CAN frame can contain 8 bytes
+	uint32_t fifo;
+	uint8_t drained = 0;
+
+	while(1)
+	{
+		if(HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0)
+		{
+			fifo = CAN_RX_FIFO0;
+		}else if(HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO1) > 0)
+		{
+			fifo = CAN_RX_FIFO1;
+		}else
+		{
+			break;
+		}
+
+		memset(rcvd_msg, 0, sizeof(rcvd_msg));
+
+		// Release a message from the Rx FIFO
+		if(HAL_CAN_GetRxMessage(hcan, fifo, &RxHeader, rcvd_msg) != HAL_OK)
+		{
+			Error_handler();
+		}
+
+		drained++;
+		CAN_Bus_RxCount(hcan);
+
+		if(SLCAN_BRIDGE == TRUE)			// Every frame goes to the PC as it is
+		{
+			slcan_forward(&RxHeader, rcvd_msg);
+			continue;
+		}
+
+		if(SPECTATOR == TRUE)				// Watched, never answered. Extended frames are no game frames
+		{
+			Spec_Frame(&spectator, HAL_GetTick(), RxHeader.Timestamp, (RxHeader.IDE == CAN_ID_STD) ? RxHeader.StdId : 0xFFFF, \
+					   RxHeader.RTR == CAN_RTR_REMOTE, RxHeader.DLC, rcvd_msg);
+			continue;
+		}
+
+		// Mirrored copy from the other bus is dropped, so are forged or replayed secured frames
+		if(CAN_Bus_IsDuplicate(hcan, &RxHeader, rcvd_msg) == FALSE && \
+		   (SECURE_CAN == FALSE || Secure_Open(&RxHeader, rcvd_msg) == TRUE))
+		{
+			process_rx_msg(&RxHeader, rcvd_msg);
+		}
+	}
+
+	can_rx_stats.rx_frames += drained;
+
+	if(SPECTATOR == TRUE)
+	{
+		spec_tx_next();
+	}
+
+	if(drained > can_rx_stats.max_backlog)
+	{
+		can_rx_stats.max_backlog = drained;
+	}
+
+	if(drained > 1)
+	{
+		can_quiet_drains = 0;
+	}else if(can_burst_mode == TRUE && ++can_quiet_drains >= CAN_QUIET_DRAINS)
+	{
+		CAN_Set_Burst_Mode(FALSE);
+	}
+}
+
+
+/**
+  * @brief	Acts on a single received CAN frame
+  * @param	pHeader pointer to the header of the received frame
+  * @param	rcvd_msg payload of the received frame (8 bytes, zero padded)
+  * @retval None
+  */
+
+void process_rx_msg(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[])
+{
+	char uart_msg[100];
+	char game_stats[150] = {0};
+	char bus_report[250];					// CAN bus health, then rollup totals
+	char *playerspick[3] = {"Rock", "Paper", "Scissors"};
+	uint8_t Disc_pick = 0;
+	uint8_t winner = 0;
+
+#if REFEREE_SESSIONS == TRUE
+	// Hand of a player node: lookup of its session in the hash index. Other nodes than 0 come through the catch-all bank
+	if(pHeader->StdId >= SESSION_HAND_ID && pHeader->StdId < SESSION_HAND_ID + SESSION_NODES && pHeader->RTR == CAN_RTR_DATA)
+	{
+		referee_hand(pHeader->StdId - SESSION_HAND_ID, rcvd_msg[0]);
+		return;
+	}
+#endif
+
+#if TOURNAMENT == TRUE
+	// Hand of a player node, for its match under way
+	if(pHeader->StdId >= SESSION_HAND_ID && pHeader->StdId < SESSION_HAND_ID + SESSION_NODES && pHeader->RTR == CAN_RTR_DATA)
+	{
+		tourney_hand(pHeader->StdId - SESSION_HAND_ID, rcvd_msg[0]);
+		return;
+	}
+#endif
+
+	if(pHeader->StdId == 0x49F && pHeader->RTR == CAN_RTR_DATA)				// Nucleo sent its hand to Disc
+	{
+		uint8_t Nucleo_pick = (rcvd_msg[0] <= 2) ? rcvd_msg[0] : STRATEGY_NO_HAND;	// Anything else is a game error
+
+		if(TT_CAN == TRUE)
+		{
+			Tt_Jitter_Hand(&tt_jitter, &tt_sched, 0, pHeader->Timestamp);		// Nucleo plays in hand window 0
+		}
+
+		sprintf(uart_msg, "Message received. Nucleo's hand is %s\r\n", (Nucleo_pick <= 2) ? playerspick[Nucleo_pick] : "unknown");
+
+		UART_Msg_Tx(uart_msg);
+
+		uint32_t cycles = DWT->CYCCNT;
+
+		Disc_pick = Strategy_Pick(&disc_player);					// From the history only; Nucleo's hand above is not used
+		Strategy_Observe(&disc_player, Disc_pick, Nucleo_pick);		// Then both hands are added to the history
+
+		cycles = DWT->CYCCNT - cycles;
+
+		if(cycles > strategy_max_cycles)
+		{
+			strategy_max_cycles = cycles;
+		}
+
+		sprintf(uart_msg, "Disc's hand is %s\r\n", playerspick[Disc_pick]);
+
+		UART_Msg_Tx(uart_msg);
+
+		winner = (Nucleo_pick <= 2) ? Determine_Win(Nucleo_pick, Disc_pick) : 4;		// To determine winner of Rock, Paper, Scissors
+
+		manage_LED_output(winner);			// Turn on the appropriate LED to indicate game result
+
+		if(winner == last_winner)
+		{
+			streak_cnt++;
+		}else
+		{
+			last_winner = winner;
+			streak_cnt = 1;
+		}
+
+		if(winner == 4)
+		{
+			LED_Pattern_Error(LED_ERR_GAME_RESULT);
+		}else if(streak_cnt >= LED_STREAK_MIN)
+		{
+			LED_Pattern_Streak(LED_GREEN << (winner-1), streak_cnt);	// Same LED mapping as manage_LED_output()
+		}
+
+		Rollup_Record(winner);				// Add result to the minute/hour/day history
+
+		send_game_result(winner);			// Disc to send game result to Nucleo
+
+	// StdId cannot be a value beyond 0x7FF
+	}else if(pHeader->StdId == 0x633 && pHeader->RTR == CAN_RTR_DATA)		// Game stats sent from Nucleo to Disc
+	{
+		// Bytes 4 and 5 carry the results Nucleo never received and Nucleo's Rx FIFO overruns
+		sprintf(game_stats, "STATS: Nucleo Wins: %d, Disc Wins: %d, Ties: %d, Game Error: %d, Lost Results: %d, Nucleo Rx Overruns: %d, Disc Rx Overruns: %d\r\n", \
+				rcvd_msg[0], rcvd_msg[1], rcvd_msg[2], rcvd_msg[3], rcvd_msg[4], rcvd_msg[5], \
+				can_rx_stats.fifo_overrun[0] + can_rx_stats.fifo_overrun[1]);
+
+		// get_date_time() uses RTC to get current time and return it as a pointer to a string
+		UART_Msg_Tx(strcat(get_date_time(), game_stats));					// strcat() returns dest, the pointer to the destination string.
+
+		CAN_Bus_Report(bus_report);											// Health of the CAN bus(es) in use
+		UART_Msg_Tx(bus_report);
+
+		Rollup_Report(bus_report);											// Totals of the last hour, day and week
+		UART_Msg_Tx(bus_report);
+
+#if SECURE_CAN == TRUE
+		Secure_Report(bus_report);				// Forged/replayed frames dropped so far
+		UART_Msg_Tx(bus_report);
+#endif
+
+		sprintf(bus_report, "STRATEGY %s max cycles: %lu\r\n", Strategy_Name(DISC_STRATEGY), (unsigned long)strategy_max_cycles);
+		UART_Msg_Tx(bus_report);
+
+#if REFEREE_SESSIONS == TRUE
+		Session_Report(&sessions, bus_report);		// Players refereed, sessions refused and results pending
+		UART_Msg_Tx(bus_report);
+#endif
+
+#if TOURNAMENT == TRUE
+		Tourney_Report(&tourney, bus_report);		// Round, matches played and under way, leader
+		UART_Msg_Tx(bus_report);
+#endif
+
+#if TT_CAN == TRUE
+		Tt_Report(&tt_jitter, &tt_sched, bus_report);	// Jitter of the references, results and hands so far
+		UART_Msg_Tx(bus_report);
+#endif
+
+#if DISC_STRATEGY == STRATEGY_MARKOV
+		sprintf(bus_report, "PREDICTOR hits: %lu/%lu (%lu%%)\r\n", (unsigned long)disc_player.state.markov.hits, \
+				(unsigned long)disc_player.state.markov.predictions, (unsigned long)(disc_player.state.markov.predictions ? \
+				(100 * disc_player.state.markov.hits) / disc_player.state.markov.predictions : 0));
+		UART_Msg_Tx(bus_report);
+#endif
+
+#if DISC_STRATEGY == STRATEGY_QPRED
+		sprintf(bus_report, "PREDICTOR hits: %lu/%lu (%lu%%)\r\n", (unsigned long)disc_player.state.qpred.hits, \
+				(unsigned long)disc_player.state.qpred.predictions, (unsigned long)(disc_player.state.qpred.predictions ? \
+				(100 * disc_player.state.qpred.hits) / disc_player.state.qpred.predictions : 0));
+		UART_Msg_Tx(bus_report);
+#endif
+
+		send_index_query(STATS_INDEX_MINUTES);		// Recent results from Nucleo's round index
+
+	}else if(pHeader->StdId == FENWICK_REPLY_ID && pHeader->RTR == CAN_RTR_DATA)	// Results from Nucleo's round index
+	{
+		sprintf(bus_report, "INDEX last %d min: Nucleo Wins: %u, Disc Wins: %u, Ties: %u, Game Error: %u\r\n", \
+				STATS_INDEX_MINUTES, rcvd_msg[0] | (rcvd_msg[1] << 8), rcvd_msg[2] | (rcvd_msg[3] << 8), \
+				rcvd_msg[4] | (rcvd_msg[5] << 8), rcvd_msg[6] | (rcvd_msg[7] << 8));
+		UART_Msg_Tx(bus_report);
+
+	}else if(pHeader->StdId == ROLLUP_QUERY_ID && pHeader->RTR == CAN_RTR_DATA)	// Range query on the game history
+	{
+		send_rollup_reply(rcvd_msg[0], rcvd_msg[1], rcvd_msg[2]);
+
+	}else if(pHeader->StdId == 0x77B && pHeader->RTR == CAN_RTR_DATA)		// Message from Nucleo to go to sleep
+	{
+		UART_Msg_Tx("Light lost; gone to sleep\r\n");
+
+		// Configure WAKEUP_PIN1 (PA0) as a wakeup pin in order to exit Standby mode
+		// PA0 will be pulled down to ground when configured as WAKEUP_PIN1
+		// Thus a rising edge signal to PA0 will wake up the MCU from Standby mode
+		HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
+
+		if(LED_Pattern_IsReady() == TRUE)
+		{
+			LED_Pattern_SleepCountdown(enter_standby);	// Standby is entered once the countdown has played
+		}else
+		{
+			enter_standby();
+		}
+	}
+}
+
+
+/**
+  * @brief	Puts Disc in Standby mode. Called directly or once the sleep countdown pattern ends
+  * @param	None
+  * @note	MCU will not resume here when waking up. A reset will occur instead
+  * @retval None
+  */
+
+void enter_standby(void)
+{
+	HAL_PWR_EnterSTANDBYMode();		// Enters Standby mode using WFI
+}
+
+
+/**
+  * @brief	Returns current date and time from RTC
+  * @param	None
+  * @retval Pointer to the start of the string carrying date and time info
+  */
+
+char* get_date_time(void)
+{
+	RTC_TimeTypeDef RTC_TimeRead = {0};
+	RTC_DateTypeDef RTC_DateRead = {0};
+	char *TimeFormat[] = {"AM", "PM"};
+
+	if( HAL_RTC_GetTime(&hrtc, &RTC_TimeRead, RTC_FORMAT_BIN) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	if( HAL_RTC_GetDate(&hrtc, &RTC_DateRead, RTC_FORMAT_BIN) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	sprintf(DateTime_Info, "20%02d-%02d-%02d %02d:%02d:%02d %s - ", RTC_DateRead.Year, RTC_DateRead.Month, RTC_DateRead.Date, \
+			RTC_TimeRead.Hours, RTC_TimeRead.Minutes, RTC_TimeRead.Seconds, TimeFormat[RTC_TimeRead.TimeFormat/0x40]);
+
+	return DateTime_Info;
+}
+
+
+/**
+  * @brief  Error CAN callback. Rx FIFO overruns are counted and trigger burst mode, with no
+  * 		UART line that would hold back the draining of the FIFOs (the STATS line has the
+  * 		counts). Other errors are reported via UART and the LED error code
+  * @param  hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN.
+  * @retval None
+  */
+
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
+{
+	uint32_t err = HAL_CAN_GetError(hcan);
+
+	HAL_CAN_ResetError(hcan);		// Error code accumulates; clear it so each event is counted once
+
+	CAN_Bus_Error(hcan, err);		// Bus-off takes the bus out of use until it recovers
+
+	if(err & HAL_CAN_ERROR_RX_FOV0)
+	{
+		can_rx_stats.fifo_overrun[0]++;
+
+		if(can_burst_mode == FALSE)
+		{
+			CAN_Set_Burst_Mode(TRUE);
+		}
+	}
+
+	if(err & HAL_CAN_ERROR_RX_FOV1)
+	{
+		can_rx_stats.fifo_overrun[1]++;
+	}
+
+	if(SPECTATOR == TRUE)			// Streamed with the other lines: a blocking line would hold the Rx path back
+	{
+		if(err & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1))
+		{
+			Spec_Anomaly(&spectator, SPEC_ANOM_OVERRUN, HAL_GetTick());
+		}
+
+		if(err & (HAL_CAN_ERROR_BOF | HAL_CAN_ERROR_STF | HAL_CAN_ERROR_FOR | HAL_CAN_ERROR_BR | HAL_CAN_ERROR_BD | HAL_CAN_ERROR_CRC))
+		{
+			Spec_Anomaly(&spectator, SPEC_ANOM_BUS_ERROR, HAL_GetTick());
+		}
+
+		spec_tx_next();
+
+		return;
+	}
+
+	// Status flags of the slcan bridge, read by the PC with the F command
+	slcan.flags |= ((err & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1)) ? SLCAN_FLAG_OVERRUN : 0) | \
+				   ((err & HAL_CAN_ERROR_EWG) ? SLCAN_FLAG_ERR_WARNING : 0) | ((err & HAL_CAN_ERROR_EPV) ? SLCAN_FLAG_ERR_PASSIVE : 0) | \
+				   ((err & (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_ALST2)) ? SLCAN_FLAG_ARB_LOST : 0) | \
+				   ((err & (HAL_CAN_ERROR_BOF | HAL_CAN_ERROR_STF | HAL_CAN_ERROR_FOR | HAL_CAN_ERROR_ACK | HAL_CAN_ERROR_BR | \
+							HAL_CAN_ERROR_BD | HAL_CAN_ERROR_CRC)) ? SLCAN_FLAG_BUS_ERROR : 0);
+
+	if(err & ~(HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1))
+	{
+		UART_Msg_Tx("CAN Error Occurred\r\n");
+
+		LED_Pattern_Error(LED_ERR_CAN);
+	}
+}
+
+
+/**
+  * @brief  Selects TIM6, configures its properties, and initializes it. This API also
+  * 		starts time base generation in interrupt mode using the initialized TIM6
+  * @param  None
+  * @retval None
+  */
+
+void Timer6_Init(void)
+{
+	// Timer period will change if SYSCLK changes
+	// TIM6_CLK =  PCLK1 * 2 = SYSCLK
+	// To select TIM6 and configure its period for 1 ms (the basic cycle with TT_CAN)
+	htimer6.Instance = TIM6;
+	htimer6.Init.Prescaler = 49;
+	htimer6.Init.Period = TIM6_PERIOD_MS * 1000 - 1;  // Subtract one to ensure an update event is generated at exactly the time base needed
+
+	// CounterMode is not configured b/c TIM6 (basic timer) can only count up which is the default mode
+
+	if(HAL_TIM_Base_Init(&htimer6) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	// Start the timer base generation in interrupt mode
+	HAL_TIM_Base_Start_IT(&htimer6);
+}
+
+
+/**
+  * @brief  Period elapsed callback for TIM6 in non-blocking mode. This callback
+  * 		will execute every 1ms (every basic cycle with TT_CAN) to check if the user
+  * 		button is pressed. If the new button state persists (pressed) then CAN1_Tx()
+  * 		is called. This is a way to resolve button debouncing problem.
+  * @param  htim pointer to a TIM_HandleTypeDef structure that contains
+  *         the configuration information for the specified TIM (TIM6)
+  * @retval None
+  */
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	uint8_t btn_state;		// State of user button that is connected to PA0
+
+	if(TT_CAN == TRUE)
+	{
+		tt_cycle_start();	// The reference goes first, before anything this update may send
+	}
+
+	if(SPECTATOR == TRUE)
+	{
+		Spec_Tick(&spectator, HAL_GetTick());
+		spec_tx_next();
+	}
+
+#if REFEREE_SESSIONS == TRUE
+	if(HAL_GetTick() - session_scan_tick >= 1000)		// Once a second: sessions of the nodes gone quiet are closed
+	{
+		session_scan_tick = HAL_GetTick();
+		Session_Expire(&sessions, session_scan_tick, SESSION_IDLE_MS);
+	}
+#endif
+
+#if TOURNAMENT == TRUE
+	if(HAL_GetTick() - tourney_scan_tick >= 50)		// Matches gone quiet get their pairing again
+	{
+		tourney_scan_tick = HAL_GetTick();
+		Tourney_Tick(&tourney, tourney_scan_tick, TOURNEY_RETRY_MS);
+		tourney_tx_pending();
+	}
+#endif
+
+	btn_state = HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_0);
+
+	if(btn_state == GPIO_PIN_SET)	// Button pressed; PA0 is high
+	{
+		debounce_cnt++;
+	}else
+	{
+		debounce_cnt = 0;
+	}
+
+	// Once pin reading stabilizes at high then transmit CAN message
+
+	if(debounce_cnt == 100 / TIM6_PERIOD_MS)	// 100 consecutive milliseconds passed and btn_state is still pressed
+	{
+		debounce_cnt = 0;
+
+		if(SPECTATOR == TRUE)		// A spectator never asks: it shows its totals now
+		{
+			Spec_Report(&spectator, HAL_GetTick());
+			spec_tx_next();
+		}else if(SLCAN_BRIDGE == FALSE)	// An adapter only sends what the PC asks for
+		{
+			CAN1_Tx();
+		}
+	}
+}
+
+
+/**
+  * @brief	Starts a basic cycle (TT_CAN): the time stamp of the last cycle's result goes to
+  * 		the jitter figures, then the reference and the result of the last hand are
+  * 		queued. Called from the TIM6 update, every TT_CYCLE_MS
+  * @param	None
+  * @note	Updates lost while Disc was busy (UART lines of the stats) are counted as late
+  * 		references, and so is an update served late: its reference would shift the
+  * 		windows and meet the event frames queued meanwhile. The cycle count goes on with
+  * 		the time, not with the references sent
+  * @retval None
+  */
+
+void tt_cycle_start(void)
+{
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	uint8_t data[8] = {0};
+	uint32_t now = HAL_GetTick();		// SysTick preempts every other interrupt: still right after a long one
+	uint32_t cycles;
+	int32_t late;
+
+	if(tt_sched.cycle_us == 0)			// CAN1 not on the bus yet
+	{
+		return;
+	}
+
+	if(tt_cycle == 0)					// First update (or the count wrapped): sets the phase of the grid
+	{
+		tt_tick = now - TT_CYCLE_MS;
+	}
+
+	cycles = (now - tt_tick + TT_CYCLE_MS / 2) / TT_CYCLE_MS;
+	late = (int32_t)(now - tt_tick - cycles * TT_CYCLE_MS);
+
+	if(tt_result_sent == TRUE)
+	{
+		Tt_Jitter_Result(&tt_jitter, &tt_sched, tt_result_stamp);
+		tt_result_sent = FALSE;
+	}
+
+	cycles = (cycles > 0) ? cycles : 1;
+	tt_missed += cycles - 1;
+	tt_cycle += cycles;
+	tt_tick += cycles * TT_CYCLE_MS;
+
+	if(late > 0)						// SysTick and TIM6 share a clock: an update on time is on the grid
+	{
+		tt_missed++;
+
+		return;
+	}
+
+	data[0] = tt_cycle & 0xFF;			// Cycle count, LSB first
+	data[1] = tt_cycle >> 8;
+	data[2] = TT_CYCLE_MS;				// Players build the same schedule from these
+	data[3] = TT_PLAYERS;
+
+	TxHeader.DLC = TT_REF_DLC;
+	TxHeader.StdId = TT_REF_ID;			// Outranks every game frame
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
+
+	if(CAN_Bus_Tx(&TxHeader, data) != HAL_OK)	// Bus-off: no cycle
+	{
+		tt_missed++;
+
+		return;
+	}
+
+	if(tt_result != 0)					// Back to back with the reference, in the referee window
+	{
+		data[0] = tt_result;
+		data[1] = 0;
+		TxHeader.DLC = 2;
+		TxHeader.StdId = 0x111;
+
+		if(CAN_Bus_Tx(&TxHeader, data) != HAL_OK)
+		{
+			UART_Msg_Tx("tt_cycle_start HAL_CAN_AddTxMessage Tx error\r\n");
+		}
+
+		tt_result = 0;
+	}
+}
+
+
+/**
+  * @brief	Takes the time stamp of a reference or a result that went out (TT_CAN). The
+  * 		frame is told by the identifier left in its mailbox
+  * @param	hcan pointer to the CAN handle
+  * @param	TxMailbox CAN_TX_MAILBOXx
+  * @retval None
+  */
+
+void tt_tx_done(CAN_HandleTypeDef *hcan, uint32_t TxMailbox)
+{
+	uint8_t mb = (TxMailbox == CAN_TX_MAILBOX0) ? 0 : ((TxMailbox == CAN_TX_MAILBOX1) ? 1 : 2);
+	uint32_t id = (hcan->Instance->sTxMailBox[mb].TIR & CAN_TI0R_STID) >> CAN_TI0R_STID_Pos;
+
+	if(TT_CAN == FALSE || tt_sched.cycle_us == 0)
+	{
+		return;
+	}
+
+	if(id == TT_REF_ID)
+	{
+		Tt_Jitter_Ref(&tt_jitter, &tt_sched, HAL_CAN_GetTxTimestamp(hcan, TxMailbox), tt_missed);
+		tt_missed = 0;
+	}else if(id == 0x111)			// Its reference may be stamped after it in this interrupt: judged at the next cycle start
+	{
+		tt_result_stamp = HAL_CAN_GetTxTimestamp(hcan, TxMailbox);
+		tt_result_sent = TRUE;
+	}
+}
+
+
+/**
+  * @brief  Selects RTC, configures its properties, and initializes it.
+  * @param  None
+  * @retval None
+  */
+
+void RTC_Init(void)
+{
+	char uart_msg[100] = {0};
+
+	hrtc.Instance = RTC;
+	hrtc.Init.HourFormat = RTC_HOURFORMAT_12;
+	hrtc.Init.AsynchPrediv = 0x7F;  			// 127
+	hrtc.Init.SynchPrediv = 0xFF;	    		// 255
+	hrtc.Init.OutPut = RTC_OUTPUT_DISABLE;
+	hrtc.Init.OutPutPolarity = RTC_OUTPUT_POLARITY_HIGH;		// Does not matter b/c output is disabled
+	hrtc.Init.OutPutType = RTC_OUTPUT_TYPE_OPENDRAIN;			// Does not matter b/c output is disabled
+
+	uint8_t rtc_status = HAL_RTC_Init(&hrtc);
+
+	if( rtc_status != HAL_OK)
+	{
+		sprintf(uart_msg,"RTC init error: %d\r\n",hrtc.State);
+		UART_Msg_Tx(uart_msg);
+
+		Error_handler();
+	}
+}
+
+
+/**
+  * @brief  Configure the RTC calendar for the following: 4:02:00 PM, 01 Feb 2020 Saturday
+  * @param  None
+  * @retval None
+  */
+
+void RTC_CalendarConfig(void)
+{
+	RTC_TimeTypeDef	RTC_TimeInit = {0};
+	RTC_DateTypeDef RTC_DateInit = {0};
+
+	RTC_TimeInit.Hours = 4;
+	RTC_TimeInit.Minutes = 02;
+	RTC_TimeInit.Seconds = 00;
+	RTC_TimeInit.TimeFormat = RTC_HOURFORMAT12_PM;
+
+	if( HAL_RTC_SetTime(&hrtc, &RTC_TimeInit, RTC_FORMAT_BIN) != HAL_OK)
+	{
+		UART_Msg_Tx("RTC SetTime error\r\n");
+
+		Error_handler();
+	}
+
+	RTC_DateInit.Date = 1;
+	RTC_DateInit.Month = RTC_MONTH_FEBRUARY;
+	RTC_DateInit.WeekDay = RTC_WEEKDAY_SATURDAY;
+	RTC_DateInit.Year = 20;
+
+	if( HAL_RTC_SetDate(&hrtc, &RTC_DateInit, RTC_FORMAT_BIN) != HAL_OK)
+	{
+		UART_Msg_Tx("RTC SetDate error\r\n");
+
+		Error_handler();
+	}
+}
+
+
+/**
+  * @brief  Configures and initializes GPIOs for Disc's user button and 4x LEDs
+  * @param  None
+  * @retval None
+  */
+
+void GPIO_Init(void)
+{
+	GPIO_InitTypeDef btn_gpio = {0};
+	GPIO_InitTypeDef led_gpio = {0};
+
+	__HAL_RCC_GPIOA_CLK_ENABLE();			// GPIO clock must be enabled before configuring GPIO parameters
+	__HAL_RCC_GPIOD_CLK_ENABLE();
+
+	// User Button (Request game stats) --> PA0
+	btn_gpio.Pin = GPIO_PIN_0;
+	btn_gpio.Mode = GPIO_MODE_INPUT;	// PA0 is pulled down when button is not pressed
+	btn_gpio.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(GPIOA, &btn_gpio);
+
+	// Configure GPIOs for the LEDs on Node 2
+	// LED1 (G)--> PD12, LED2 (O) --> PD13, LED3 (R) --> PD14, LED4 (B) --> PD15
+	led_gpio.Mode = GPIO_MODE_OUTPUT_PP;
+	led_gpio.Pull = GPIO_NOPULL;
+
+	led_gpio.Pin = GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15;
+	HAL_GPIO_Init(GPIOD, &led_gpio);
+}
+
+
+/**
+  * @brief  Turn on the appropriate LED to indicate game result. All 4x LEDs are updated with
+  * 		a single BSRR write so there is no window where two LEDs are on
+  * @param  Unsigned integer with the LED ID: 1 = LED1 (G), 2 = LED2 (O), 3 = LED3 (R), 4 = LED4 (B)
+  * @retval None
+  */
+
+void manage_LED_output(uint8_t LED_ID)
+{
+	// BSRR word per LED ID; the selected LED is set and the rest is reset. Index 0 is unused
+	static const uint32_t led_bsrr[5] = {0, LED_BSRR_ONLY(LED_GREEN), LED_BSRR_ONLY(LED_ORANGE), \
+										 LED_BSRR_ONLY(LED_RED), LED_BSRR_ONLY(LED_BLUE)};
+
+	if(LED_ID < 1 || LED_ID > 4)
+	{
+		return;
+	}
+
+	if(LED_Pattern_Stop() == FALSE)		// A running pattern would overwrite the result with its next frame
+	{
+		return;							// Sleep countdown: Standby follows, the result is not shown
+	}
+
+	GPIOD->BSRR = led_bsrr[LED_ID];
+}
+
+
+/**
+  * @brief  Selects UART2, configures its properties, and initializes it
+  * @param  None
+  * @retval None
+  */
+
+void UART2_Init(void)
+{
+	huart2.Instance = USART2;
+	huart2.Init.BaudRate = (SLCAN_BRIDGE == TRUE) ? SLCAN_BAUD : 115200;
+	huart2.Init.WordLength = UART_WORDLENGTH_8B;
+	huart2.Init.StopBits = UART_STOPBITS_1;
+	huart2.Init.Parity = UART_PARITY_NONE;
+	huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+	huart2.Init.Mode = UART_MODE_TX_RX;
+
+	if(HAL_UART_Init(&huart2) != HAL_OK)
+	{
+		//There is a problem. You can blink a red LED or trap in error handler
+		Error_handler();
 	}
 }
 
@@ -618,6 +1593,7 @@ void UART2_Init(void)
 /**
   * @brief  Sending UART message in blocking mode
   * @param  msg[] message string
+  * @note	Nothing is sent in bridge mode: USART2 carries slcan lines only
   * @retval HAL status
   */
 
@@ -625,11 +1601,381 @@ uint8_t UART_Msg_Tx(char msg[])
 {
 	uint8_t Tx_Status = 0;
 
+	if(SLCAN_BRIDGE == TRUE)
+	{
+		return HAL_BUSY;
+	}
+
 	Tx_Status = HAL_UART_Transmit(&huart2, (uint8_t*)msg, (uint16_t)(strlen(msg)), HAL_MAX_DELAY);
 	return Tx_Status;
 }
 
 
+/**
+  * @brief	Starts the slcan bridge: USART2 Rx into a circular DMA buffer, read at every idle
+  * 		line and every half buffer. The bus stays closed until the PC opens it
+  * @param	None
+  * @retval None
+  */
+
+void slcan_start(void)
+{
+	Slcan_Init(&slcan);
+
+	if(HAL_UART_Receive_DMA(&huart2, slcan_rx_dma, SLCAN_RX_DMA) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	__HAL_UART_CLEAR_IDLEFLAG(&huart2);
+	__HAL_UART_ENABLE_IT(&huart2, UART_IT_IDLE);
+}
+
+
+/**
+  * @brief	Parses the bytes the Rx DMA wrote since the last call and acts on the complete
+  * 		command lines. Called from the USART2 and DMA1 Stream 5 interrupts only
+  * @param	None
+  * @retval None
+  */
+
+void slcan_rx_poll(void)
+{
+	uint16_t pos = (SLCAN_RX_DMA - __HAL_DMA_GET_COUNTER(huart2.hdmarx)) % SLCAN_RX_DMA;	// Next byte the DMA writes
+	Slcan_Frame_t frame;
+	char reply[SLCAN_REPLY_MAX];
+	uint8_t reply_len, action;
+
+	while(slcan_rx_pos != pos)
+	{
+		action = Slcan_RxByte(&slcan, slcan_rx_dma[slcan_rx_pos], &frame, reply, &reply_len);
+		slcan_rx_pos = (slcan_rx_pos + 1) % SLCAN_RX_DMA;
+
+		if(action != SLCAN_NONE && slcan_act(action, &frame) == FALSE)
+		{
+			reply_len = Slcan_Refuse(&slcan, reply);
+		}
+
+		if(reply_len > 0)
+		{
+			slcan_put(reply, reply_len);
+		}
+	}
+
+	slcan_tx_next();
+}
+
+
+/**
+  * @brief	Carries out a command of the PC on CAN1
+  * @param	action SLCAN_xxx action returned by Slcan_RxByte()
+  * @param	frame frame to send (SLCAN_SEND)
+  * @retval TRUE if done, FALSE if it must be refused
+  */
+
+uint8_t slcan_act(uint8_t action, Slcan_Frame_t *frame)
+{
+	uint8_t next = (slcan_queue_head + 1) % SLCAN_CAN_QUEUE;
+
+	switch(action)
+	{
+		case SLCAN_SEND:
+			if(next == slcan_queue_tail)		// Queue full: the PC sends faster than the bus carries
+			{
+				slcan.flags |= SLCAN_FLAG_TX_FULL;
+				return FALSE;
+			}
+
+			slcan_can_queue[slcan_queue_head] = *frame;
+			slcan_queue_head = next;
+			slcan_can_pump();
+			return TRUE;
+
+		case SLCAN_BITRATE:
+			return (slcan_prescaler[slcan.bitrate] != 0) ? TRUE : FALSE;
+
+		case SLCAN_OPEN:
+		case SLCAN_LISTEN:
+			hcan1.Init.Mode = (action == SLCAN_LISTEN) ? CAN_MODE_SILENT : CAN_MODE_NORMAL;
+			hcan1.Init.Prescaler = slcan_prescaler[slcan.bitrate];
+			hcan1.Init.TimeSeg1 = (slcan.bitrate == 8) ? CAN_BS1_3TQ : CAN_BS1_8TQ;
+			hcan1.Init.TimeSeg2 = CAN_BS2_1TQ;
+
+			// HAL_CAN_Init() from the ready state rewrites the bit timing. Filters and interrupts are kept
+			if(hcan1.Init.Prescaler == 0 || HAL_CAN_Init(&hcan1) != HAL_OK || HAL_CAN_Start(&hcan1) != HAL_OK)
+			{
+				slcan.open = 0;
+				return FALSE;
+			}
+
+			return TRUE;
+
+		case SLCAN_CLOSE:
+			HAL_CAN_AbortTxRequest(&hcan1, CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2);
+			slcan_queue_tail = slcan_queue_head;
+			return (HAL_CAN_Stop(&hcan1) == HAL_OK) ? TRUE : FALSE;
+
+		default:
+			return TRUE;
+	}
+}
+
+
+/**
+  * @brief	Sends a received CAN frame to the PC as an slcan line. Dropped (and flagged) when
+  * 		the Tx ring has no room for it
+  * @param	pHeader pointer to the header of the received frame
+  * @param	rcvd_msg payload of the received frame
+  * @retval None
+  */
+
+void slcan_forward(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[])
+{
+	Slcan_Frame_t frame;
+	char line[SLCAN_FRAME_MAX];
+
+	frame.ext = (pHeader->IDE == CAN_ID_EXT);
+	frame.id = (frame.ext) ? pHeader->ExtId : pHeader->StdId;
+	frame.rtr = (pHeader->RTR == CAN_RTR_REMOTE);
+	frame.dlc = pHeader->DLC;
+	memcpy(frame.data, rcvd_msg, 8);
+
+	if(slcan_put(line, Slcan_Encode(&frame, slcan.timestamps, HAL_GetTick() % 60000, line)) == FALSE)
+	{
+		slcan.dropped++;
+		slcan.flags |= SLCAN_FLAG_OVERRUN;
+	}
+
+	slcan_tx_next();
+}
+
+
+/**
+  * @brief	Adds a line to the Tx ring
+  * @param	line line to send
+  * @param	len its length
+  * @retval TRUE if added, FALSE if the ring has no room for it
+  */
+
+uint8_t slcan_put(const char *line, uint8_t len)
+{
+	uint16_t room = (slcan_tx_tail + SLCAN_TX_RING - slcan_tx_head - 1) % SLCAN_TX_RING;
+
+	if(len > room)
+	{
+		return FALSE;
+	}
+
+	for(uint8_t i = 0; i < len; i++)
+	{
+		slcan_tx_ring[slcan_tx_head] = line[i];
+		slcan_tx_head = (slcan_tx_head + 1) % SLCAN_TX_RING;
+	}
+
+	return TRUE;
+}
+
+
+/**
+  * @brief	Starts the DMA transmission of the Tx ring, up to its end or to its head, if
+  * 		USART2 is free
+  * @param	None
+  * @retval None
+  */
+
+void slcan_tx_next(void)
+{
+	uint16_t len;
+
+	if(slcan_tx_busy != 0 || slcan_tx_head == slcan_tx_tail || huart2.gState != HAL_UART_STATE_READY)
+	{
+		return;
+	}
+
+	len = (slcan_tx_head > slcan_tx_tail) ? slcan_tx_head - slcan_tx_tail : SLCAN_TX_RING - slcan_tx_tail;
+
+	if(HAL_UART_Transmit_DMA(&huart2, (uint8_t*)&slcan_tx_ring[slcan_tx_tail], len) == HAL_OK)
+	{
+		slcan_tx_busy = len;
+	}
+}
+
+
+/**
+  * @brief	Moves frames from the PC to the free Tx mailboxes of CAN1. Frames go out raw: no
+  * 		secured-message tag, no second bus
+  * @param	None
+  * @retval None
+  */
+
+void slcan_can_pump(void)
+{
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	uint32_t TxMailbox;
+	Slcan_Frame_t *frame;
+
+	while(slcan_queue_tail != slcan_queue_head && HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) > 0)
+	{
+		frame = &slcan_can_queue[slcan_queue_tail];
+		TxHeader.IDE = (frame->ext) ? CAN_ID_EXT : CAN_ID_STD;
+		TxHeader.StdId = (frame->ext) ? 0 : frame->id;
+		TxHeader.ExtId = (frame->ext) ? frame->id : 0;
+		TxHeader.RTR = (frame->rtr) ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+		TxHeader.DLC = frame->dlc;
+
+		if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, frame->data, &TxMailbox) != HAL_OK)	// Bus closed
+		{
+			break;
+		}
+
+		slcan_queue_tail = (slcan_queue_tail + 1) % SLCAN_CAN_QUEUE;
+	}
+}
+
+
+/**
+  * @brief	Starts the DMA transmission of the spectator's lines, up to the end of its ring
+  * 		or to its head, if USART2 is free
+  * @param	None
+  * @retval None
+  */
+
+void spec_tx_next(void)
+{
+	const char *chunk;
+	uint16_t len;
+
+	if(spec_tx_busy != 0 || huart2.gState != HAL_UART_STATE_READY)
+	{
+		return;
+	}
+
+	len = Spec_TxChunk(&spectator, &chunk);
+
+	if(len != 0 && HAL_UART_Transmit_DMA(&huart2, (uint8_t*)chunk, len) == HAL_OK)
+	{
+		spec_tx_busy = len;
+	}
+}
+
+
+/**
+  * @brief	Tx mailbox 0 complete callback. A mailbox is free for the next frame from the PC
+  * 		or the next pending session result, and the frame's time stamp may be wanted (TT_CAN)
+  * @param	hcan pointer to the CAN handle
+  * @retval None
+  */
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+	slcan_can_pump();
+	tt_tx_done(hcan, CAN_TX_MAILBOX0);
+	session_tx_pending();
+	tourney_tx_pending();
+}
+
+
+/**
+  * @brief	Tx mailbox 1 complete callback, see HAL_CAN_TxMailbox0CompleteCallback()
+  * @param	hcan pointer to the CAN handle
+  * @retval None
+  */
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+	slcan_can_pump();
+	tt_tx_done(hcan, CAN_TX_MAILBOX1);
+	session_tx_pending();
+	tourney_tx_pending();
+}
+
+
+/**
+  * @brief	Tx mailbox 2 complete callback, see HAL_CAN_TxMailbox0CompleteCallback()
+  * @param	hcan pointer to the CAN handle
+  * @retval None
+  */
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+	slcan_can_pump();
+	tt_tx_done(hcan, CAN_TX_MAILBOX2);
+	session_tx_pending();
+	tourney_tx_pending();
+}
+
+
+/**
+  * @brief	UART Tx complete callback. The DMA is done with a stretch of the Tx ring (slcan
+  * 		bridge or spectator): the next one follows
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if(SPECTATOR == TRUE)
+	{
+		Spec_TxDone(&spectator, spec_tx_busy);
+		spec_tx_busy = 0;
+		spec_tx_next();
+
+		return;
+	}
+
+	slcan_tx_tail = (slcan_tx_tail + slcan_tx_busy) % SLCAN_TX_RING;
+	slcan_tx_busy = 0;
+	slcan_tx_next();
+}
+
+
+/**
+  * @brief	UART Rx half complete callback. The Rx DMA filled half of its buffer
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+	slcan_rx_poll();
+}
+
+
+/**
+  * @brief	UART Rx complete callback. The Rx DMA wrapped around its buffer
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+	slcan_rx_poll();
+}
+
+
+/**
+  * @brief	UART error callback. In bridge mode an Rx overrun stops the Rx DMA: it is restarted,
+  * 		and the line being received is refused at its CR. A failed Tx DMA stretch is given up
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if(SLCAN_BRIDGE == TRUE && huart->RxState == HAL_UART_STATE_READY)
+	{
+		slcan.overflow = 1;
+		slcan_rx_pos = 0;
+		HAL_UART_Receive_DMA(&huart2, slcan_rx_dma, SLCAN_RX_DMA);
+	}
+
+	if(huart->gState == HAL_UART_STATE_READY && (slcan_tx_busy != 0 || spec_tx_busy != 0))
+	{
+		HAL_UART_TxCpltCallback(huart);
+	}
+}
+
+
 /**
   * @brief  Enables HSE clock and PLL engine. Configures PLL clock source, multiplication and division factors.
   * 		Selects PLL as SYSCLK source, sets latency, and configures prescalars of HCLK, PCLK1, and PCLK2.
@@ -719,13 +2065,20 @@ void SysClockConfig_HSE(uint8_t ClkFreq)
 
 /**
   * @brief  Trap for all error occurred in this app. Disc's blue LED will also  illuminate
-  * 		periodically whenever this API is entered.
+  * 		periodically whenever this API is entered. The LED pattern engine blinks the
+  * 		trap error code if it is up, otherwise the blue LED is toggled in software
   * @param  None
   * @retval None
   */
 
 void Error_handler(void)
 {
+	if(LED_Pattern_IsReady() == TRUE)
+	{
+		LED_Pattern_Error(LED_ERR_TRAP);
+		while(1);
+	}
+
 	while(1)
 	{
 		HAL_GPIO_TogglePin(GPIOD, GPIO_PIN_15);
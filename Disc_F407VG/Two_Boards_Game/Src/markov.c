@@ -0,0 +1,153 @@
+/**
+  ******************************************************************************
+  * @file    markov.c
+  * @author  Moe2Code
+  * @brief   Order-k Markov hand predictor. For every order 0 to MARKOV_ORDER, counts how often
+  *          each hand followed each context (the opponent's last hands). The pick plays the
+  *          hand that beats the most likely next hand of the longest trusted context.
+  *          The following is conducted in source file:
+  *          + Prediction of the opponent's next hand and choice of the counter hand
+  *          + O(1) update of the counts once the opponent's hand is known
+  *          + Tracking of the prediction hit rate
+  * @note    Both calls run a fixed number of loop iterations (MARKOV_ORDER + 1 rows of 3
+  *          counts) with no data dependent loop, so their cost is bounded: about 150 cycles
+  *          each on the M4 with MARKOV_ORDER = 3
+  * @note    Hands: 0 = Rock, 1 = Paper, 2 = Scissors. Hand (h + 1) % 3 beats hand h
+  */
+
+// Includes
+#include "markov.h"
+
+
+// Global variables
+static const uint8_t markov_pow3[MARKOV_ORDER + 1] = {1, 3, 9, 27};			// Contexts per order
+static const uint8_t markov_offset[MARKOV_ORDER + 1] = {0, 1, 4, 13};		// First row of each order
+
+
+// Function prototypes
+static uint8_t Markov_Random(Markov_State_t *st);
+
+
+/**
+  * @brief  Clears the counts, the history and the hit rate
+  * @param  st pointer to the predictor state
+  * @param  seed seed of the fallback random picks. Must not be 0
+  * @retval None
+  */
+
+void Markov_Init(Markov_State_t *st, uint32_t seed)
+{
+	for(uint8_t i = 0; i < MARKOV_CONTEXTS; i++)
+	{
+		st->counts[i][0] = st->counts[i][1] = st->counts[i][2] = 0;
+	}
+
+	st->history = 0;
+	st->seen = 0;
+	st->predicted = MARKOV_NO_PREDICTION;
+	st->rng = (seed != 0) ? seed : 0x2545F491;
+	st->predictions = 0;
+	st->hits = 0;
+}
+
+
+/**
+  * @brief  Picks the hand to play. Must be called before the opponent's hand of the round is
+  * 		known to the caller's logic, i.e. only the history is used
+  * @param  st pointer to the predictor state
+  * @retval Hand to play: 0 = Rock, 1 = Paper, 2 = Scissors
+  */
+
+uint8_t Markov_Pick(Markov_State_t *st)
+{
+	const uint8_t *row;
+	uint16_t total;
+	uint8_t best;
+
+	st->predicted = MARKOV_NO_PREDICTION;
+
+	for(int8_t order = MARKOV_ORDER; order >= 0; order--)	// Longest trusted context wins
+	{
+		if(order > st->seen)
+		{
+			continue;
+		}
+
+		row = st->counts[markov_offset[order] + st->history % markov_pow3[order]];
+		total = row[0] + row[1] + row[2];
+
+		if(total >= MARKOV_MIN_SAMPLES)
+		{
+			best = (row[1] > row[0]) ? 1 : 0;
+			best = (row[2] > row[best]) ? 2 : best;
+			st->predicted = best;
+			break;
+		}
+	}
+
+	if(st->predicted == MARKOV_NO_PREDICTION)
+	{
+		return Markov_Random(st);
+	}
+
+	return (st->predicted + 1) % 3;
+}
+
+
+/**
+  * @brief  Adds the opponent's hand of the round to the counts of every order and to the history
+  * @param  st pointer to the predictor state
+  * @param  opp_hand opponent's hand: 0 = Rock, 1 = Paper, 2 = Scissors
+  * @retval None
+  */
+
+void Markov_Observe(Markov_State_t *st, uint8_t opp_hand)
+{
+	uint8_t *row;
+
+	if(opp_hand > 2)
+	{
+		return;
+	}
+
+	if(st->predicted != MARKOV_NO_PREDICTION)
+	{
+		st->predictions++;
+		st->hits += (st->predicted == opp_hand);
+	}
+
+	for(uint8_t order = 0; order <= MARKOV_ORDER && order <= st->seen; order++)
+	{
+		row = st->counts[markov_offset[order] + st->history % markov_pow3[order]];
+
+		if(++row[opp_hand] == MARKOV_COUNT_MAX)		// Halve the row so the counts follow changes of habit
+		{
+			row[0] >>= 1;
+			row[1] >>= 1;
+			row[2] >>= 1;
+		}
+	}
+
+	st->history = (st->history * 3 + opp_hand) % markov_pow3[MARKOV_ORDER];
+
+	if(st->seen < MARKOV_ORDER)
+	{
+		st->seen++;
+	}
+}
+
+
+/**
+  * @brief  Returns a random hand (xorshift32)
+  * @param  st pointer to the predictor state
+  * @retval Hand: 0 = Rock, 1 = Paper, 2 = Scissors
+  */
+
+static uint8_t Markov_Random(Markov_State_t *st)
+{
+	st->rng ^= st->rng << 13;
+	st->rng ^= st->rng >> 17;
+	st->rng ^= st->rng << 5;
+
+	return st->rng % 3;
+}
@@ -12,6 +12,9 @@
 
 extern void Error_handler(void);
 extern uint8_t UART_Msg_Tx(char msg[]);
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
 
 
 char uart_msg[100] = {0};
@@ -41,7 +44,7 @@ void HAL_MspInit(void)
 
 
 /**
-  * @brief  Initializes the CAN MSP. Low level inits of CAN1 peripheral are done here.
+  * @brief  Initializes the CAN MSP. Low level inits of CAN1 and CAN2 peripherals are done here.
   * @param  hcan pointer to a CAN_HandleTypeDef structure that contains
   *         the configuration information for the specified CAN.
   * @retval None
@@ -49,31 +52,61 @@ void HAL_MspInit(void)
 
 void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan)
 {
-	GPIO_InitTypeDef gpios_can1 = {0};
-
-	// Enable the clock for CAN1 and GPIOA peripherals
-	__HAL_RCC_CAN1_CLK_ENABLE();
-	__HAL_RCC_GPIOB_CLK_ENABLE();
-
-	// Configure GPIO pins to act as CAN1 Tx and Rx
-	gpios_can1.Pin = GPIO_PIN_8 | GPIO_PIN_9;  // PB8 --> CAN1_RX and PB9 --> CAN1_TX
-	gpios_can1.Mode = GPIO_MODE_AF_PP;
-	gpios_can1.Pull = GPIO_NOPULL;
-	gpios_can1.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	gpios_can1.Alternate = GPIO_AF9_CAN1;
-
-	HAL_GPIO_Init(GPIOB, &gpios_can1);
-
-	// Enable the IRQ and set the priority (NVIC settings)
-	HAL_NVIC_SetPriority(CAN1_TX_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_SCE_IRQn, 15, 0);
-
-	HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
+	GPIO_InitTypeDef gpios_can = {0};
+
+	if(hcan->Instance == CAN1)
+	{
+		// Enable the clock for CAN1 and GPIOA peripherals
+		__HAL_RCC_CAN1_CLK_ENABLE();
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+
+		// Configure GPIO pins to act as CAN1 Tx and Rx
+		gpios_can.Pin = GPIO_PIN_8 | GPIO_PIN_9;  // PB8 --> CAN1_RX and PB9 --> CAN1_TX
+		gpios_can.Mode = GPIO_MODE_AF_PP;
+		gpios_can.Pull = GPIO_NOPULL;
+		gpios_can.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		gpios_can.Alternate = GPIO_AF9_CAN1;
+
+		HAL_GPIO_Init(GPIOB, &gpios_can);
+
+		// Enable the IRQ and set the priority (NVIC settings)
+		HAL_NVIC_SetPriority(CAN1_TX_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_SCE_IRQn, 15, 0);
+
+		HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
+	}
+	else if(hcan->Instance == CAN2)
+	{
+		// CAN2 is a slave of CAN1. CAN1 clock must be on to reach the shared filter banks
+		__HAL_RCC_CAN1_CLK_ENABLE();
+		__HAL_RCC_CAN2_CLK_ENABLE();
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+
+		// Configure GPIO pins to act as CAN2 Tx and Rx
+		gpios_can.Pin = GPIO_PIN_12 | GPIO_PIN_13;  // PB12 --> CAN2_RX and PB13 --> CAN2_TX
+		gpios_can.Mode = GPIO_MODE_AF_PP;
+		gpios_can.Pull = GPIO_NOPULL;
+		gpios_can.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		gpios_can.Alternate = GPIO_AF9_CAN2;
+
+		HAL_GPIO_Init(GPIOB, &gpios_can);
+
+		// Enable the IRQ and set the priority (NVIC settings)
+		HAL_NVIC_SetPriority(CAN2_TX_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_RX0_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_RX1_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_SCE_IRQn, 15, 0);
+
+		HAL_NVIC_EnableIRQ(CAN2_TX_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_RX0_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_RX1_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_SCE_IRQn);
+	}
 }
 
 
@@ -85,14 +118,49 @@ void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan)
 
 void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htimer)
 {
-	// 1. Enable the clock for the timer peripheral (TIM6)
-	__HAL_RCC_TIM6_CLK_ENABLE();
+	if(htimer->Instance == TIM6)
+	{
+		// 1. Enable the clock for the timer peripheral (TIM6)
+		__HAL_RCC_TIM6_CLK_ENABLE();
 
-	// 2. Enable the IRQ of TIM6
-	HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
+		// 2. Enable the IRQ of TIM6
+		HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
 
-	// 3. Setup the priority for TIM6_DAC_IRQn
-	HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 15, 0);
+		// 3. Setup the priority for TIM6_DAC_IRQn
+		HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 15, 0);
+	}
+	else if(htimer->Instance == TIM1)
+	{
+		// TIM1 clocks the LED pattern frames. Its update event requests DMA2 Stream 5 Channel 6
+		// which writes the next frame to GPIOD->BSRR. No TIM1 interrupt is needed
+
+		// 1. Enable the clock for TIM1 and DMA2
+		__HAL_RCC_TIM1_CLK_ENABLE();
+		__HAL_RCC_DMA2_CLK_ENABLE();
+
+		// 2. Configure the DMA stream. Mode (circular/normal) is set per pattern in led_pattern.c
+		hdma_tim1_up.Instance = DMA2_Stream5;
+		hdma_tim1_up.Init.Channel = DMA_CHANNEL_6;
+		hdma_tim1_up.Init.Direction = DMA_MEMORY_TO_PERIPH;
+		hdma_tim1_up.Init.PeriphInc = DMA_PINC_DISABLE;			// Always GPIOD->BSRR
+		hdma_tim1_up.Init.MemInc = DMA_MINC_ENABLE;				// Walk through the frames
+		hdma_tim1_up.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma_tim1_up.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+		hdma_tim1_up.Init.Mode = DMA_CIRCULAR;
+		hdma_tim1_up.Init.Priority = DMA_PRIORITY_LOW;
+		hdma_tim1_up.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+		if(HAL_DMA_Init(&hdma_tim1_up) != HAL_OK)
+		{
+			Error_handler();
+		}
+
+		__HAL_LINKDMA(htimer, hdma[TIM_DMA_ID_UPDATE], hdma_tim1_up);
+
+		// 3. Enable the IRQ of DMA2 Stream 5. Only used by one-shot patterns (transfer complete)
+		HAL_NVIC_SetPriority(DMA2_Stream5_IRQn, 15, 0);
+		HAL_NVIC_EnableIRQ(DMA2_Stream5_IRQn);
+	}
 }
 
 
@@ -169,7 +237,45 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
 	gpios_uart2.Pin = GPIO_PIN_3;
 	HAL_GPIO_Init(GPIOA, &gpios_uart2);		// PA3 --> UART2_RX
 
-	// 3. Enable the IRQ and set the priority (NVIC settings)
+	// 3. DMA1 for the slcan bridge and the spectator: Stream 5 Channel 4 writes USART2 Rx in circles, Stream 6 Channel 4 feeds USART2 Tx
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	hdma_usart2_rx.Instance = DMA1_Stream5;
+	hdma_usart2_rx.Init.Channel = DMA_CHANNEL_4;
+	hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;			// Always USART2->DR
+	hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_usart2_rx.Init.Priority = DMA_PRIORITY_HIGH;			// A late Rx byte is lost, a late Tx byte only waits
+	hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+	hdma_usart2_tx.Instance = DMA1_Stream6;
+	hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+	hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+	hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+	if(HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK || HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	__HAL_LINKDMA(huart, hdmarx, hdma_usart2_rx);
+	__HAL_LINKDMA(huart, hdmatx, hdma_usart2_tx);
+
+	// 4. Enable the IRQs and set the priority (NVIC settings). Same priority as CAN: the bridge callbacks never preempt each other
 	HAL_NVIC_EnableIRQ(USART2_IRQn);
 	HAL_NVIC_SetPriority(USART2_IRQn, 15, 0);   // Interrupt priority set to 15
+
+	HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 15, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 15, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
 }
@@ -0,0 +1,219 @@
+/**
+  ******************************************************************************
+  * @file    qpred.c
+  * @author  Moe2Code
+  * @brief   int8 quantized linear predictor of the opponent's next hand. 32 int8 features
+  *          (last rounds, their sum over the window, own last hand) are scored against one
+  *          row of int8 weights per hand. The pick plays the hand that beats the best score.
+  *          The following is conducted in source file:
+  *          + Packing of the round history into feature words
+  *          + Scoring with the M4 DSP SIMD instructions, or a scalar loop on other targets
+  *          + Tracking of the prediction hit rate
+  * @note    On the M4 each word of features takes 2 __SMLAD (two 16-bit MACs each) after
+  *          __SXTB16 unpacking, and the window sum is 6 __SADD8. A prediction is about
+  *          150 cycles (3 us at 50 MHz). Host builds use the scalar path, which gives the
+  *          same scores
+  * @note    Weights live in flash (qpred_table.c), generated by Host_Tools/qpred_train
+  */
+
+// Includes
+#include "qpred.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "stm32f4xx.h"			// Core header brings the SIMD intrinsics of cmsis_gcc.h
+#define QPRED_SIMD				1
+#else
+#define QPRED_SIMD				0
+#endif
+
+
+// Function prototypes
+#if QPRED_SIMD == 0
+static uint32_t Qpred_Sadd8(uint32_t a, uint32_t b);
+#endif
+
+
+/**
+  * @brief  Clears the history and the hit rate
+  * @param  st pointer to the predictor state
+  * @retval None
+  */
+
+void Qpred_Init(Qpred_State_t *st)
+{
+	for(uint8_t i = 0; i < QPRED_HISTORY; i++)
+	{
+		st->rounds[i] = 0;
+	}
+
+	st->last_own = QPRED_NO_HAND;
+	st->predicted = QPRED_NO_HAND;
+	st->predictions = 0;
+	st->hits = 0;
+}
+
+
+/**
+  * @brief  Builds the feature words: QPRED_HISTORY rounds (newest first), their byte-wise sum,
+  * 		then own last hand one-hot with a constant bias byte
+  * @param  st pointer to the predictor state
+  * @param  x receives QPRED_WORDS words of 4 int8 features (byte i at bits 8i to 8i+7)
+  * @retval None
+  */
+
+void Qpred_Features(const Qpred_State_t *st, uint32_t x[QPRED_WORDS])
+{
+	uint32_t sum = 0;
+
+	for(uint8_t i = 0; i < QPRED_HISTORY; i++)
+	{
+		x[i] = st->rounds[i];
+
+#if QPRED_SIMD == 1
+		sum = __SADD8(sum, st->rounds[i]);		// 4 saturating int8 adds at once
+#else
+		sum = Qpred_Sadd8(sum, st->rounds[i]);
+#endif
+	}
+
+	x[QPRED_HISTORY] = sum;
+	x[QPRED_HISTORY + 1] = ((st->last_own < 3) ? (uint32_t)QPRED_ONE << (8 * st->last_own) : 0) | \
+						   ((uint32_t)QPRED_ONE << 24);
+}
+
+
+/**
+  * @brief  Scores each possible next hand: dot product of the features with its weight row
+  * @param  w weight table, word aligned (qpred_weights on the boards)
+  * @param  x feature words from Qpred_Features()
+  * @param  scores receives one score per hand (Rock, Paper, Scissors)
+  * @retval None
+  */
+
+void Qpred_Scores(const int8_t w[QPRED_OUTPUTS][QPRED_FEATURES], const uint32_t x[QPRED_WORDS], int32_t scores[QPRED_OUTPUTS])
+{
+#if QPRED_SIMD == 1
+
+	uint32_t x_even[QPRED_WORDS], x_odd[QPRED_WORDS];
+	const uint32_t *row;
+	uint32_t acc;
+
+	for(uint8_t i = 0; i < QPRED_WORDS; i++)		// Unpack once: bytes 0,2 and bytes 1,3 as int16 pairs
+	{
+		x_even[i] = __SXTB16(x[i]);
+		x_odd[i] = __SXTB16(__ROR(x[i], 8));
+	}
+
+	for(uint8_t o = 0; o < QPRED_OUTPUTS; o++)
+	{
+		row = (const uint32_t*)w[o];		// Rows are 32 bytes, so word aligned too
+		acc = 0;
+
+		for(uint8_t i = 0; i < QPRED_WORDS; i++)
+		{
+			acc = __SMLAD(x_even[i], __SXTB16(row[i]), acc);
+			acc = __SMLAD(x_odd[i], __SXTB16(__ROR(row[i], 8)), acc);
+		}
+
+		scores[o] = (int32_t)acc;
+	}
+
+#else
+
+	for(uint8_t o = 0; o < QPRED_OUTPUTS; o++)
+	{
+		int32_t acc = 0;
+
+		for(uint8_t i = 0; i < QPRED_FEATURES; i++)
+		{
+			acc += (int8_t)(x[i / 4] >> (8 * (i % 4))) * w[o][i];
+		}
+
+		scores[o] = acc;
+	}
+
+#endif
+}
+
+
+/**
+  * @brief  Predicts the opponent's next hand and returns the hand that beats it
+  * @param  st pointer to the predictor state
+  * @retval Hand to play: 0 = Rock, 1 = Paper, 2 = Scissors
+  */
+
+uint8_t Qpred_Pick(Qpred_State_t *st)
+{
+	uint32_t x[QPRED_WORDS];
+	int32_t scores[QPRED_OUTPUTS];
+	uint8_t best;
+
+	Qpred_Features(st, x);
+	Qpred_Scores(qpred_weights, x, scores);
+
+	best = (scores[1] > scores[0]) ? 1 : 0;
+	best = (scores[2] > scores[best]) ? 2 : best;
+	st->predicted = best;
+
+	return (best + 1) % 3;
+}
+
+
+/**
+  * @brief  Adds the round just played to the history
+  * @param  st pointer to the predictor state
+  * @param  own hand played
+  * @param  opp opponent's hand. Rounds with an unknown hand (> 2) are skipped
+  * @retval None
+  */
+
+void Qpred_Observe(Qpred_State_t *st, uint8_t own, uint8_t opp)
+{
+	int8_t result;
+
+	if(opp > 2 || own > 2)
+	{
+		return;
+	}
+
+	if(st->predicted != QPRED_NO_HAND)
+	{
+		st->predictions++;
+		st->hits += (st->predicted == opp);
+	}
+
+	result = (own == opp) ? 0 : ((own == (opp + 1) % 3) ? QPRED_ONE : -QPRED_ONE);
+
+	for(uint8_t i = QPRED_HISTORY - 1; i > 0; i--)
+	{
+		st->rounds[i] = st->rounds[i-1];
+	}
+
+	st->rounds[0] = ((uint32_t)QPRED_ONE << (8 * opp)) | ((uint32_t)(uint8_t)result << 24);
+	st->last_own = own;
+}
+
+
+#if QPRED_SIMD == 0
+/**
+  * @brief  Portable __SADD8: byte-wise signed saturating add
+  * @param  a 4 packed int8
+  * @param  b 4 packed int8
+  * @retval 4 packed int8 sums
+  */
+
+static uint32_t Qpred_Sadd8(uint32_t a, uint32_t b)
+{
+	uint32_t r = 0;
+	int16_t s;
+
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		s = (int8_t)(a >> (8 * i)) + (int8_t)(b >> (8 * i));
+		s = (s > 127) ? 127 : ((s < -128) ? -128 : s);
+		r |= (uint32_t)(uint8_t)s << (8 * i);
+	}
+
+	return r;
+}
+#endif
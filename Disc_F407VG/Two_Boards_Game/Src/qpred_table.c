@@ -0,0 +1,30 @@
+/**
+  ******************************************************************************
+  * @file    qpred_table.c
+  * @author  Moe2Code
+  * @brief   int8 weights of the hand predictor (qpred.c), kept in flash.
+  *          Generated by Host_Tools/qpred_train from 1000000 rounds; do not edit.
+  *          Quantized prediction accuracy on the training rounds: 65.66%
+  */
+
+// Includes
+#include "qpred.h"
+
+
+// Global variables
+// Row o scores the opponent playing hand o next. Word aligned for 32-bit SIMD loads
+const int8_t qpred_weights[QPRED_OUTPUTS][QPRED_FEATURES] __attribute__((aligned(4))) =
+{
+	{ -26, -58,  -1,  -7, -31,  50, -34,   3,
+	   64, -27,   4,  13, -16, -41,  39,   1,
+	  -28,  49, -29,  -5,  73,  -4, -16,   4,
+	   36, -31, -37,  10, -84, -80,  79,  52},
+	{  59,   8, -16,   9, -37, -23,  41,  -5,
+	  -27,  67, -27, -12,  56, -11,  -7,   3,
+	  -25, -28,  36,  12, -31,  40, -33,  -1,
+	   -6,  51,  -5,   6, 127, -47, -29, -18},
+	{ -33,  50,  16,  -2,  68, -27,  -7,   3,
+	  -37, -39,  22,  -1, -40,  52, -32,  -5,
+	   53, -21,  -7,  -7, -42, -35,  49,  -3,
+	  -30, -20,  42, -16, -43, 127, -50, -34},
+};
@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    rollup.c
+  * @author  Moe2Code
+  * @brief   Game history rollups kept in Disc's backup SRAM. Every game result is added to
+  *          the bucket of the current minute, hour and day (RTC time), so long running
+  *          sessions keep their history without storing each round. The following is
+  *          conducted in source file:
+  *          + Initialization of the backup SRAM and of the rollup tables
+  *          + Incremental update of the three levels per game result
+  *          + Range queries over the last buckets of a level, in one pass over its table
+  * @note    Each level is a fixed-size circular table indexed by key % size. A slot still
+  *          holding an older key is reset when its new bucket starts, and queries only sum
+  *          slots whose key falls in the requested range, so stale slots are never counted
+  */
+
+// Includes
+#include "rollup.h"
+
+
+// Global variables
+extern RTC_HandleTypeDef hrtc;
+Rollup_Store_t *rollup_store = (Rollup_Store_t*)BKPSRAM_BASE;	// Rollups live at the base of the backup SRAM
+static const uint16_t rollup_sizes[ROLLUP_LEVELS] = {ROLLUP_MINUTES, ROLLUP_HOURS, ROLLUP_DAYS};
+static const uint16_t rollup_minutes[ROLLUP_LEVELS] = {1, 60, 1440};	// Bucket length of each level in minutes
+
+
+// Function prototypes
+extern void Error_handler(void);
+static uint32_t Rollup_Now(void);
+static Rollup_Bucket_t* Rollup_Table(uint8_t level);
+
+
+/**
+  * @brief	Turns on the backup SRAM and its regulator (content kept in Standby), then
+  * 		clears the rollups unless they survived from a previous run
+  * @param	None
+  * @retval None
+  */
+
+void Rollup_Init(void)
+{
+	Rollup_Bucket_t *table;
+
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();		// Backup SRAM is part of the write-protected backup domain
+	__HAL_RCC_BKPSRAM_CLK_ENABLE();
+
+	if(HAL_PWREx_EnableBkUpReg() != HAL_OK)		// Without the backup regulator the SRAM is lost in Standby
+	{
+		Error_handler();
+	}
+
+	if(rollup_store->magic == ROLLUP_MAGIC)
+	{
+		return;
+	}
+
+	for(uint8_t level = 0; level < ROLLUP_LEVELS; level++)
+	{
+		table = Rollup_Table(level);
+
+		for(uint16_t i = 0; i < rollup_sizes[level]; i++)
+		{
+			memset(&table[i], 0, sizeof(Rollup_Bucket_t));
+			table[i].key = ROLLUP_EMPTY;
+		}
+	}
+
+	rollup_store->magic = ROLLUP_MAGIC;
+}
+
+
+/**
+  * @brief	Adds a game result to the current minute, hour and day buckets
+  * @param	winner game result: 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error
+  * @retval None
+  */
+
+void Rollup_Record(uint8_t winner)
+{
+	uint32_t now = Rollup_Now();
+	Rollup_Bucket_t *bucket;
+	uint32_t key;
+
+	for(uint8_t level = 0; level < ROLLUP_LEVELS; level++)
+	{
+		key = now / rollup_minutes[level];
+		bucket = &Rollup_Table(level)[key % rollup_sizes[level]];
+
+		if(bucket->key != key)		// Slot still holds a bucket one lap older; start it over
+		{
+			memset(bucket, 0, sizeof(Rollup_Bucket_t));
+			bucket->key = key;
+		}
+
+		bucket->rounds++;
+
+		switch(winner)
+		{
+			case 1:
+				bucket->nucleo_wins++;
+				break;
+			case 2:
+				bucket->disc_wins++;
+				break;
+			case 3:
+				bucket->ties++;
+				break;
+			default:
+				bucket->errors++;
+				break;
+		}
+	}
+}
+
+
+/**
+  * @brief	Sums count buckets of a level, ending back buckets before the current one
+  * 		(back = 0, count = 60 on ROLLUP_MINUTE is the last hour)
+  * @param	level ROLLUP_MINUTE, ROLLUP_HOUR or ROLLUP_DAY
+  * @param	back number of buckets between the newest bucket of the range and the current one
+  * @param	count number of buckets in the range
+  * @param	sum receives the totals. sum->key is set to the oldest key of the range
+  * @retval Number of buckets of the range that hold games
+  */
+
+uint8_t Rollup_Query(uint8_t level, uint8_t back, uint8_t count, Rollup_Bucket_t *sum)
+{
+	Rollup_Bucket_t *table;
+	uint32_t hi, lo;
+	uint8_t found = 0;
+
+	memset(sum, 0, sizeof(Rollup_Bucket_t));
+
+	if(level >= ROLLUP_LEVELS || count == 0)
+	{
+		return 0;
+	}
+
+	table = Rollup_Table(level);
+	hi = Rollup_Now() / rollup_minutes[level] - back;
+	lo = (hi >= count - 1U) ? hi - (count - 1U) : 0;		// count is 1 at least
+	sum->key = lo;
+
+	for(uint16_t i = 0; i < rollup_sizes[level]; i++)
+	{
+		if(table[i].key != ROLLUP_EMPTY && table[i].key >= lo && table[i].key <= hi)
+		{
+			sum->rounds += table[i].rounds;
+			sum->nucleo_wins += table[i].nucleo_wins;
+			sum->disc_wins += table[i].disc_wins;
+			sum->ties += table[i].ties;
+			sum->errors += table[i].errors;
+			found++;
+		}
+	}
+
+	return found;
+}
+
+
+/**
+  * @brief	Prints the totals of the last hour, day and week into buf
+  * @param	buf destination string. Must hold at least 250 characters
+  * @retval None
+  */
+
+void Rollup_Report(char *buf)
+{
+	const uint8_t levels[3] = {ROLLUP_MINUTE, ROLLUP_HOUR, ROLLUP_DAY};
+	const uint8_t counts[3] = {60, 24, 7};
+	const char *names[3] = {"1h", "24h", "7d"};
+	Rollup_Bucket_t sum;
+
+	strcpy(buf, "ROLLUP");
+
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		Rollup_Query(levels[i], 0, counts[i], &sum);
+
+		sprintf(buf + strlen(buf), " %s: rounds %lu N %lu D %lu T %lu E %lu;", names[i], \
+				(unsigned long)sum.rounds, (unsigned long)sum.nucleo_wins, (unsigned long)sum.disc_wins, \
+				(unsigned long)sum.ties, (unsigned long)sum.errors);
+	}
+
+	strcat(buf, "\r\n");
+}
+
+
+/**
+  * @brief	Reads the RTC and converts it to minutes since 2000-01-01 00:00
+  * @param	None
+  * @note	Date must be read after time to unlock the RTC shadow registers
+  * @retval Minutes since 2000-01-01 00:00
+  */
+
+static uint32_t Rollup_Now(void)
+{
+	static const uint16_t days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+	RTC_TimeTypeDef time = {0};
+	RTC_DateTypeDef date = {0};
+	uint32_t days;
+	uint8_t hours;
+
+	if(HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN) != HAL_OK || HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	// Years 2000 to 2099: every 4th year is a leap year, 2000 included
+	days = date.Year * 365UL + (date.Year + 3) / 4 + days_before_month[(date.Month - 1) % 12] + (date.Date - 1);
+
+	if(date.Month > 2 && (date.Year % 4) == 0)
+	{
+		days++;
+	}
+
+	hours = time.Hours % 12;		// RTC runs in 12-hour format: 12 AM is 0h, 12 PM is 12h
+
+	if(time.TimeFormat == RTC_HOURFORMAT12_PM)
+	{
+		hours += 12;
+	}
+
+	return (days * 24 + hours) * 60 + time.Minutes;
+}
+
+
+/**
+  * @brief	Returns the table of a level
+  * @param	level ROLLUP_MINUTE, ROLLUP_HOUR or ROLLUP_DAY
+  * @retval Pointer to the first bucket of the level
+  */
+
+static Rollup_Bucket_t* Rollup_Table(uint8_t level)
+{
+	if(level == ROLLUP_MINUTE)
+	{
+		return rollup_store->minute;
+	}else if(level == ROLLUP_HOUR)
+	{
+		return rollup_store->hour;
+	}
+
+	return rollup_store->day;
+}
@@ -0,0 +1,311 @@
+/**
+  ******************************************************************************
+  * @file    session.c
+  * @author  Moe2Code
+  * @brief   Referee's session table (REFEREE_SESSIONS): what Disc keeps for each player
+  *          node it referees at once. The following is conducted in source file:
+  *          + Hash index from node ID to player: open addressing with linear probing,
+  *            a Fibonacci hash, half full at most, so a lookup in the Rx path takes one
+  *            or two probes
+  *          + Removal by backward shift: no tombstones, lookups stay short however long
+  *            players come and go
+  *          + Players packed in arrays of one field each (structure of arrays): rounds,
+  *            last hand, result waiting for a Tx mailbox, result counters, Disc's strategy
+  *            state against that player
+  *          + Scans over one field: idle sessions closed, pending results found
+  * @note    RAM is fixed (about 42 KB on the board): SESSION_MAX players, hands from more
+  *          are refused until an idle session is closed
+  */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "session.h"
+
+
+// Function prototypes
+static uint16_t Session_Hash(uint16_t node);
+static uint16_t Session_Slot(const Session_Table_t *t, uint16_t node);
+
+
+/**
+  * @brief  Clears the table
+  * @param  t pointer to the table
+  * @retval None
+  */
+
+void Session_Init(Session_Table_t *t)
+{
+	memset(t, 0, sizeof(*t));
+
+	for(uint16_t s = 0; s < SESSION_SLOTS; s++)
+	{
+		t->slot_node[s] = SESSION_NONE;
+	}
+}
+
+
+/**
+  * @brief  Returns the home slot of a node ID: Fibonacci hashing, the top bits of the
+  * 		16-bit product with 2^16 / golden ratio. Consecutive IDs land far apart
+  */
+
+static uint16_t Session_Hash(uint16_t node)
+{
+	return (uint16_t)(node * 40503U) >> (16 - SESSION_SLOT_BITS);
+}
+
+
+/**
+  * @brief  Returns the slot holding a node ID, or the free slot its probe ends on
+  */
+
+static uint16_t Session_Slot(const Session_Table_t *t, uint16_t node)
+{
+	uint16_t s = Session_Hash(node);
+
+	while(t->slot_node[s] != node && t->slot_node[s] != SESSION_NONE)		// Never full: there is a free slot
+	{
+		s = (s + 1) & (SESSION_SLOTS - 1);
+	}
+
+	return s;
+}
+
+
+/**
+  * @brief  Looks up a player
+  * @param  t pointer to the table
+  * @param  node node ID
+  * @retval Player index, SESSION_NONE if the node has no session
+  */
+
+uint16_t Session_Find(const Session_Table_t *t, uint16_t node)
+{
+	uint16_t s = Session_Slot(t, node);
+
+	return (t->slot_node[s] == SESSION_NONE) ? SESSION_NONE : t->slot_player[s];
+}
+
+
+/**
+  * @brief  Returns the player of a node, opening a session for it if it has none
+  * @param  t pointer to the table
+  * @param  node node ID, below SESSION_NONE
+  * @param  tick HAL tick
+  * @param  strategy STRATEGY_xxx Disc plays the new player with
+  * @param  seed random seed of that strategy
+  * @retval Player index, SESSION_NONE if the table is full (refused)
+  */
+
+uint16_t Session_Open(Session_Table_t *t, uint16_t node, uint32_t tick, uint8_t strategy, uint32_t seed)
+{
+	uint16_t s = Session_Slot(t, node);
+	uint16_t p = t->count;
+
+	if(t->slot_node[s] != SESSION_NONE)
+	{
+		return t->slot_player[s];
+	}
+
+	if(p == SESSION_MAX || node == SESSION_NONE)
+	{
+		t->refused++;
+		return SESSION_NONE;
+	}
+
+	t->slot_node[s] = node;
+	t->slot_player[s] = p;
+	t->node[p] = node;
+	t->seq[p] = 0;
+	t->hand[p] = STRATEGY_NO_HAND;
+	t->pending[p] = 0;
+	t->last_tick[p] = tick;
+
+	for(uint8_t r = 0; r < SESSION_RESULTS; r++)
+	{
+		t->results[r][p] = 0;
+	}
+
+	Strategy_Init(&t->strategy[p], strategy, seed);
+	t->count++;
+	t->opened++;
+
+	return p;
+}
+
+
+/**
+  * @brief  Closes a session. The last player takes the index of the one closed
+  * @param  t pointer to the table
+  * @param  player player index
+  * @retval None
+  */
+
+void Session_Close(Session_Table_t *t, uint16_t player)
+{
+	uint16_t hole = Session_Slot(t, t->node[player]);
+	uint16_t last = t->count - 1;
+	uint16_t s = hole;
+
+	// Backward shift: an entry further down the probe sequence moves into the hole unless
+	// its home slot lies cyclically within (hole, s]
+	while(1)
+	{
+		uint16_t home;
+
+		s = (s + 1) & (SESSION_SLOTS - 1);
+
+		if(t->slot_node[s] == SESSION_NONE)
+		{
+			break;
+		}
+
+		home = Session_Hash(t->slot_node[s]);
+
+		if(((s - home) & (SESSION_SLOTS - 1)) >= ((s - hole) & (SESSION_SLOTS - 1)))
+		{
+			t->slot_node[hole] = t->slot_node[s];
+			t->slot_player[hole] = t->slot_player[s];
+			hole = s;
+		}
+	}
+
+	t->slot_node[hole] = SESSION_NONE;
+	t->pending_count -= (t->pending[player] != 0);
+
+	if(player != last)
+	{
+		t->slot_player[Session_Slot(t, t->node[last])] = player;
+		t->node[player] = t->node[last];
+		t->seq[player] = t->seq[last];
+		t->hand[player] = t->hand[last];
+		t->pending[player] = t->pending[last];
+		t->last_tick[player] = t->last_tick[last];
+
+		for(uint8_t r = 0; r < SESSION_RESULTS; r++)
+		{
+			t->results[r][player] = t->results[r][last];
+		}
+
+		t->strategy[player] = t->strategy[last];
+	}
+
+	t->count--;
+}
+
+
+/**
+  * @brief  Closes the sessions with no hand for idle_ms, unless a result is still to be
+  * 		sent to them
+  * @param  t pointer to the table
+  * @param  tick HAL tick
+  * @param  idle_ms idle time
+  * @retval Sessions closed
+  */
+
+uint16_t Session_Expire(Session_Table_t *t, uint32_t tick, uint32_t idle_ms)
+{
+	uint16_t closed = 0;
+	uint16_t p = 0;
+
+	while(p < t->count)
+	{
+		if(tick - t->last_tick[p] >= idle_ms && t->pending[p] == 0)
+		{
+			Session_Close(t, p);		// The last player moves to p: looked at next
+			closed++;
+		}else
+		{
+			p++;
+		}
+	}
+
+	t->expired += closed;
+
+	return closed;
+}
+
+
+/**
+  * @brief  Records a round refereed with a player. Its result is pending until
+  * 		Session_Sent()
+  * @param  t pointer to the table
+  * @param  player player index
+  * @param  hand the player's hand
+  * @param  result game result, 1 to 4
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+void Session_Result(Session_Table_t *t, uint16_t player, uint8_t hand, uint8_t result, uint32_t tick)
+{
+	t->seq[player]++;
+	t->hand[player] = hand;
+	t->results[(result - 1) & (SESSION_RESULTS - 1)][player]++;
+	t->pending_count += (t->pending[player] == 0);
+	t->pending[player] = result;		// A result still unsent is overtaken by the new one
+	t->last_tick[player] = tick;
+}
+
+
+/**
+  * @brief  The result of a player is in a Tx mailbox
+  * @param  t pointer to the table
+  * @param  player player index
+  * @retval None
+  */
+
+void Session_Sent(Session_Table_t *t, uint16_t player)
+{
+	t->pending_count -= (t->pending[player] != 0);
+	t->pending[player] = 0;
+}
+
+
+/**
+  * @brief  Returns a player whose result is still to be sent
+  * @param  t pointer to the table
+  * @retval Player index, SESSION_NONE if none
+  */
+
+uint16_t Session_NextPending(const Session_Table_t *t)
+{
+	for(uint16_t p = 0; t->pending_count > 0 && p < t->count; p++)
+	{
+		if(t->pending[p] != 0)
+		{
+			return p;
+		}
+	}
+
+	return SESSION_NONE;
+}
+
+
+/**
+  * @brief  Writes the SESSIONS line: players, sessions opened, closed idle, refused,
+  * 		results pending, and the longest probe of the index
+  * @param  t pointer to the table
+  * @param  buf receives the line (120 bytes at most)
+  * @retval None
+  */
+
+void Session_Report(const Session_Table_t *t, char *buf)
+{
+	uint16_t probe_max = 0;
+
+	for(uint16_t s = 0; s < SESSION_SLOTS; s++)
+	{
+		uint16_t probe = (s - Session_Hash(t->slot_node[s])) & (SESSION_SLOTS - 1);
+
+		if(t->slot_node[s] != SESSION_NONE && probe + 1 > probe_max)
+		{
+			probe_max = probe + 1;
+		}
+	}
+
+	sprintf(buf, "SESSIONS players: %u/%u, opened: %lu, idle closed: %lu, refused: %lu, pending: %u, longest probe: %u\r\n", \
+			t->count, SESSION_MAX, (unsigned long)t->opened, (unsigned long)t->expired, (unsigned long)t->refused, \
+			t->pending_count, probe_max);
+}
@@ -0,0 +1,379 @@
+/**
+  ******************************************************************************
+  * @file    slcan.c
+  * @author  Moe2Code
+  * @brief   Lawicel/slcan ASCII protocol of the CAN bridge mode. The following is conducted
+  *          in source file:
+  *          + Command lines from the PC (CR terminated): S, O, L, C, t, T, r, R, F, V, N, Z,
+  *            M, m. Each line gets its reply: CR, BELL on error, z/Z after a frame
+  *          + Received frames to the PC as t/T/r/R lines, with the optional timestamp
+  * @note    The module only decodes and encodes. The board acts on the returned action
+  *          (opens the bus, queues the frame) and calls Slcan_Refuse() if it cannot.
+  *          The acceptance code and mask (M, m) are acknowledged but not applied: every
+  *          frame on the bus is forwarded
+  */
+
+// Includes
+#include "slcan.h"
+
+
+// Defines
+#define SLCAN_OK				'\r'
+#define SLCAN_ERROR				'\a'	// BELL
+
+
+// Function prototypes
+static int8_t Slcan_Hex(char c);
+static uint8_t Slcan_ParseHex(const char *s, uint8_t digits, uint32_t *value);
+static uint8_t Slcan_Command(Slcan_t *s, Slcan_Frame_t *frame, char reply[SLCAN_REPLY_MAX], uint8_t *reply_len);
+
+
+// Global variables
+static const char slcan_digits[16] = "0123456789ABCDEF";
+
+
+/**
+  * @brief  Resets the protocol state: bus closed, 500 kbit/s, no timestamps
+  * @param  s pointer to the protocol state
+  * @retval None
+  */
+
+void Slcan_Init(Slcan_t *s)
+{
+	s->len = 0;
+	s->overflow = 0;
+	s->open = 0;
+	s->bitrate = SLCAN_DEFAULT_BITRATE;
+	s->timestamps = 0;
+	s->flags = 0;
+	s->commands = 0;
+	s->refused = 0;
+	s->dropped = 0;
+}
+
+
+/**
+  * @brief  Feeds a byte from the PC. A CR completes the command line, LF is ignored
+  * @param  s pointer to the protocol state
+  * @param  byte byte received
+  * @param  frame receives the frame to send (SLCAN_SEND)
+  * @param  reply receives the reply to the command once the line is complete
+  * @param  reply_len receives the length of the reply, 0 while the line is incomplete
+  * @retval SLCAN_xxx action for the board
+  */
+
+uint8_t Slcan_RxByte(Slcan_t *s, uint8_t byte, Slcan_Frame_t *frame, char reply[SLCAN_REPLY_MAX], uint8_t *reply_len)
+{
+	uint8_t action;
+
+	*reply_len = 0;
+
+	if(byte == '\n')
+	{
+		return SLCAN_NONE;
+	}
+
+	if(byte != '\r')
+	{
+		if(s->len < SLCAN_LINE_MAX)
+		{
+			s->line[s->len++] = (char)byte;
+		}else
+		{
+			s->overflow = 1;
+		}
+
+		return SLCAN_NONE;
+	}
+
+	s->commands++;
+	action = (s->overflow) ? SLCAN_NONE : Slcan_Command(s, frame, reply, reply_len);
+
+	if(s->overflow)
+	{
+		*reply_len = Slcan_Refuse(s, reply);
+	}
+
+	s->len = 0;
+	s->overflow = 0;
+
+	return action;
+}
+
+
+/**
+  * @brief  Writes a received frame as an slcan line: t/T/r/R, identifier, DLC, data,
+  * 		optional timestamp, CR
+  * @param  f pointer to the frame
+  * @param  timestamps 1 to append the timestamp
+  * @param  ms timestamp in ms, 0 to 59999
+  * @param  out receives the line (not NUL terminated)
+  * @retval Length of the line
+  */
+
+uint8_t Slcan_Encode(const Slcan_Frame_t *f, uint8_t timestamps, uint16_t ms, char out[SLCAN_FRAME_MAX])
+{
+	uint8_t digits = (f->ext) ? 8 : 3;
+	uint8_t dlc = (f->dlc > 8) ? 8 : f->dlc;
+	uint8_t n = 0;
+
+	out[n++] = (f->rtr) ? ((f->ext) ? 'R' : 'r') : ((f->ext) ? 'T' : 't');
+
+	for(int8_t i = digits - 1; i >= 0; i--)
+	{
+		out[n++] = slcan_digits[(f->id >> (4 * i)) & 0xF];
+	}
+
+	out[n++] = '0' + dlc;
+
+	for(uint8_t i = 0; !f->rtr && i < dlc; i++)
+	{
+		out[n++] = slcan_digits[f->data[i] >> 4];
+		out[n++] = slcan_digits[f->data[i] & 0xF];
+	}
+
+	if(timestamps)
+	{
+		for(int8_t i = 3; i >= 0; i--)
+		{
+			out[n++] = slcan_digits[(ms >> (4 * i)) & 0xF];
+		}
+	}
+
+	out[n++] = '\r';
+
+	return n;
+}
+
+
+/**
+  * @brief  Turns the reply of the last command into an error (BELL), for a command the
+  * 		board could not carry out
+  * @param  s pointer to the protocol state
+  * @param  reply receives the reply
+  * @retval Length of the reply
+  */
+
+uint8_t Slcan_Refuse(Slcan_t *s, char reply[SLCAN_REPLY_MAX])
+{
+	s->refused++;
+	reply[0] = SLCAN_ERROR;
+
+	return 1;
+}
+
+
+/**
+  * @brief  Returns the value of a hex digit
+  * @param  c character
+  * @retval 0 to 15, -1 if c is not a hex digit
+  */
+
+static int8_t Slcan_Hex(char c)
+{
+	if(c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+
+	if(c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+
+	if(c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+
+/**
+  * @brief  Parses a fixed number of hex digits
+  * @param  s digits
+  * @param  digits number of digits
+  * @param  value receives the value
+  * @retval 1 if all digits are valid, 0 otherwise
+  */
+
+static uint8_t Slcan_ParseHex(const char *s, uint8_t digits, uint32_t *value)
+{
+	*value = 0;
+
+	for(uint8_t i = 0; i < digits; i++)
+	{
+		int8_t d = Slcan_Hex(s[i]);
+
+		if(d < 0)
+		{
+			return 0;
+		}
+
+		*value = (*value << 4) | (uint32_t)d;
+	}
+
+	return 1;
+}
+
+
+/**
+  * @brief  Carries out a complete command line
+  * @param  s pointer to the protocol state
+  * @param  frame receives the frame to send (SLCAN_SEND)
+  * @param  reply receives the reply
+  * @param  reply_len receives the length of the reply
+  * @retval SLCAN_xxx action for the board
+  */
+
+static uint8_t Slcan_Command(Slcan_t *s, Slcan_Frame_t *frame, char reply[SLCAN_REPLY_MAX], uint8_t *reply_len)
+{
+	const char *line = s->line;
+	uint32_t value;
+	uint8_t digits, i, len = s->len;
+
+	reply[0] = SLCAN_OK;
+	*reply_len = 1;
+
+	if(len == 0)						// Empty line, sent to flush the adapter's buffer
+	{
+		return SLCAN_NONE;
+	}
+
+	switch(line[0])
+	{
+		case 't':
+		case 'T':
+		case 'r':
+		case 'R':
+			digits = (line[0] == 'T' || line[0] == 'R') ? 8 : 3;
+			frame->ext = (digits == 8);
+			frame->rtr = (line[0] == 'r' || line[0] == 'R');
+
+			if(s->open != SLCAN_OPEN || len < digits + 2 || !Slcan_ParseHex(&line[1], digits, &frame->id) \
+				|| frame->id > ((frame->ext) ? 0x1FFFFFFF : 0x7FF) || line[digits + 1] < '0' || line[digits + 1] > '8')
+			{
+				break;
+			}
+
+			frame->dlc = line[digits + 1] - '0';
+
+			if(len != digits + 2 + ((frame->rtr) ? 0 : 2 * frame->dlc))
+			{
+				break;
+			}
+
+			for(i = 0; i < 8; i++)
+			{
+				frame->data[i] = 0;
+			}
+
+			for(i = 0; !frame->rtr && i < frame->dlc && Slcan_ParseHex(&line[digits + 2 + 2 * i], 2, &value); i++)
+			{
+				frame->data[i] = (uint8_t)value;
+			}
+
+			if(!frame->rtr && i < frame->dlc)		// Not a hex byte
+			{
+				break;
+			}
+
+			reply[0] = (frame->ext) ? 'Z' : 'z';
+			reply[1] = SLCAN_OK;
+			*reply_len = 2;
+
+			return SLCAN_SEND;
+
+		case 'S':
+			if(s->open || len != 2 || line[1] < '0' || line[1] >= '0' + SLCAN_BITRATES)
+			{
+				break;
+			}
+
+			s->bitrate = line[1] - '0';
+
+			return SLCAN_BITRATE;
+
+		case 'O':
+		case 'L':
+			if(s->open || len != 1)
+			{
+				break;
+			}
+
+			s->open = (line[0] == 'O') ? SLCAN_OPEN : SLCAN_LISTEN;
+			s->flags = 0;
+
+			return s->open;
+
+		case 'C':
+			if(!s->open || len != 1)
+			{
+				break;
+			}
+
+			s->open = 0;
+
+			return SLCAN_CLOSE;
+
+		case 'F':
+			reply[0] = 'F';
+			reply[1] = slcan_digits[s->flags >> 4];
+			reply[2] = slcan_digits[s->flags & 0xF];
+			reply[3] = SLCAN_OK;
+			*reply_len = 4;
+			s->flags = 0;
+
+			return SLCAN_NONE;
+
+		case 'V':
+		case 'v':
+			reply[0] = line[0];
+			reply[1] = '1';
+			reply[2] = '0';
+			reply[3] = '1';
+			reply[4] = '3';
+			reply[5] = SLCAN_OK;
+			*reply_len = 6;
+
+			return SLCAN_NONE;
+
+		case 'N':							// Serial number
+			reply[0] = 'N';
+			reply[1] = 'R';
+			reply[2] = 'P';
+			reply[3] = 'S';
+			reply[4] = '1';
+			reply[5] = SLCAN_OK;
+			*reply_len = 6;
+
+			return SLCAN_NONE;
+
+		case 'Z':
+			if(s->open || len != 2 || (line[1] != '0' && line[1] != '1'))
+			{
+				break;
+			}
+
+			s->timestamps = line[1] - '0';
+
+			return SLCAN_NONE;
+
+		case 'M':							// Acceptance code and mask: acknowledged, every frame is forwarded
+		case 'm':
+			if(len != 9 || !Slcan_ParseHex(&line[1], 8, &value))
+			{
+				break;
+			}
+
+			return SLCAN_NONE;
+
+		default:
+			break;
+	}
+
+	*reply_len = Slcan_Refuse(s, reply);
+
+	return SLCAN_NONE;
+}
@@ -0,0 +1,681 @@
+/**
+  ******************************************************************************
+  * @file    tourney.c
+  * @author  Moe2Code
+  * @brief   Tournament scheduler (TOURNAMENT): Disc decides who plays whom and when, and
+  *          referees the matches between player nodes. The following is conducted in
+  *          source file:
+  *          + Round robin by the circle method, in closed form: the opponent of a player
+  *            in a round is computed, never stored
+  *          + Swiss pairing: players ranked by points, each paired with the next one in
+  *            the ranking they have not met yet, with backtracking (Monrad). Odd numbers
+  *            of players: the lowest ranked player with no bye yet sits the round out
+  *          + Matches overlapped: every match whose players are free is under way at once,
+  *            up to max_open. In round robin a match of a later round starts as soon as
+  *            both its players are done with the earlier ones (overlap), no waiting for
+  *            the slowest match of the round. Swiss rounds need the standings of the
+  *            round before
+  *          + Games of a match refereed from both players' hands, pairings and results
+  *            queued for the Tx mailboxes, pairings sent again to a match gone quiet
+  *          + Standings in a store the board keeps in backup SRAM: a reset resumes the
+  *            tournament, the matches under way are played again from their first game
+  * @note    Pairings and results of a player go out in the order they were queued only if
+  *          the Tx mailboxes send in request order (TXFP): a player acts on each frame on
+  *          its own, so an out of order frame costs a hand played twice at most
+  */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "tourney.h"
+
+
+// Function prototypes
+static uint8_t Tourney_Game(uint8_t a, uint8_t b);
+static uint8_t Tourney_Ahead(const Tourney_Store_t *s, uint8_t a, uint8_t b);
+static uint8_t Tourney_Met(const Tourney_Store_t *s, uint8_t a, uint8_t b, uint8_t rounds);
+static void Tourney_PairSwiss(Tourney_t *t, uint8_t round);
+static uint8_t Tourney_Next(const Tourney_t *t, uint8_t p);
+static void Tourney_Begin(Tourney_t *t, uint8_t a, uint8_t b, uint32_t tick);
+static void Tourney_Result(Tourney_t *t, uint8_t p, uint8_t result);
+static void Tourney_End(Tourney_t *t, uint8_t a, uint8_t b, uint32_t tick);
+static void Tourney_Schedule(Tourney_t *t, uint32_t tick);
+
+
+/**
+  * @brief  Starts a tournament, over the one the store held
+  * @param  t pointer to the tournament
+  * @param  store pointer to the standings (backup SRAM on the board)
+  * @param  mode TOURNEY_ROUND_ROBIN or TOURNEY_SWISS
+  * @param  node node IDs of the players, in seeding order
+  * @param  players 2 to TOURNEY_MAX
+  * @param  games games of a match
+  * @param  max_open matches played at once, 1 to play them one after the other
+  * @param  overlap round robin: a match starts once both its players are free, FALSE to
+  * 		wait for the end of each round
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+void Tourney_Start(Tourney_t *t, Tourney_Store_t *store, uint8_t mode, const uint8_t node[], uint8_t players, \
+				   uint8_t games, uint8_t max_open, uint8_t overlap, uint32_t tick)
+{
+	memset(store, 0, sizeof(*store));
+	store->mode = mode;
+	store->players = players;
+	store->games = games;
+	store->max_open = max_open;
+	store->overlap = overlap;
+	memcpy(store->node, node, players);
+
+	if(mode == TOURNEY_ROUND_ROBIN)
+	{
+		store->rounds = players - 1 + (players & 1);		// An odd number of players: each sits one round out
+	}else
+	{
+		while(store->rounds < TOURNEY_SWISS_ROUNDS && (1U << store->rounds) < players)
+		{
+			store->rounds++;
+		}
+	}
+
+	store->magic = TOURNEY_MAGIC;
+
+	Tourney_Resume(t, store, tick);
+}
+
+
+/**
+  * @brief  Picks up the tournament of a store: standings as they are, the matches that
+  * 		were under way started again
+  * @param  t pointer to the tournament
+  * @param  store pointer to the standings
+  * @param  tick HAL tick
+  * @retval 1 if the store holds a tournament (over or not), 0 if not
+  */
+
+uint8_t Tourney_Resume(Tourney_t *t, Tourney_Store_t *store, uint32_t tick)
+{
+	if(store->magic != TOURNEY_MAGIC || store->mode > TOURNEY_SWISS || store->players < 2 || \
+	   store->players > TOURNEY_MAX || store->games == 0 || store->max_open == 0)
+	{
+		return 0;
+	}
+
+	memset(t, 0, sizeof(*t));
+	memset(t->by_node, TOURNEY_NONE, sizeof(t->by_node));
+	memset(t->opp, TOURNEY_NONE, sizeof(t->opp));
+	t->store = store;
+	t->round = TOURNEY_NONE;
+
+	for(uint8_t p = 0; p < store->players; p++)
+	{
+		t->by_node[store->node[p]] = p;
+	}
+
+	Tourney_Schedule(t, tick);
+
+	return 1;
+}
+
+
+/**
+  * @brief  Returns the result of a game for its first player
+  * @param  a, b hands of the players
+  * @retval 1 = a wins, 2 = b wins, 3 = a tie, 4 = error (a hand that is not rock, paper or scissors)
+  */
+
+static uint8_t Tourney_Game(uint8_t a, uint8_t b)
+{
+	if(a > 2 || b > 2)
+	{
+		return 4;
+	}
+
+	if(a == b)
+	{
+		return 3;
+	}
+
+	return ((a + 3 - b) % 3 == 1) ? 1 : 2;		// Paper beats rock, scissors paper, rock scissors
+}
+
+
+/**
+  * @brief  Order of the standings: points, then game points, then seeding
+  * @retval 1 if player a ranks above player b
+  */
+
+static uint8_t Tourney_Ahead(const Tourney_Store_t *s, uint8_t a, uint8_t b)
+{
+	if(s->points[a] != s->points[b])
+	{
+		return s->points[a] > s->points[b];
+	}
+
+	if(s->game_points[a] != s->game_points[b])
+	{
+		return s->game_points[a] > s->game_points[b];
+	}
+
+	return a < b;
+}
+
+
+/**
+  * @brief  Returns 1 if two players met in the first rounds of a Swiss tournament
+  */
+
+static uint8_t Tourney_Met(const Tourney_Store_t *s, uint8_t a, uint8_t b, uint8_t rounds)
+{
+	for(uint8_t r = 0; r < rounds; r++)
+	{
+		if(s->opp[a][r] == b)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Pairs a Swiss round: down the ranking, each player with the first one below it
+  * 		they have not met. A dead end takes back the last pair and tries its next
+  * 		candidate. After TOURNEY_SWISS_STEPS tries, rematches are let in
+  * @param  t pointer to the tournament
+  * @param  round round to pair, all players have played the ones before
+  * @retval None
+  */
+
+static void Tourney_PairSwiss(Tourney_t *t, uint8_t round)
+{
+	Tourney_Store_t *s = t->store;
+	uint8_t rank[TOURNEY_MAX], taken[TOURNEY_MAX] = {0};
+	uint8_t first[TOURNEY_MAX / 2], second[TOURNEY_MAX / 2];	// Positions in rank[] of each pair
+	uint8_t n = Tourney_Ranking(t, rank);
+	uint8_t depth = 0, from = 0, rematch = 0;
+	uint16_t steps = 0;						// Players placed, backtracking included
+
+	if(n & 1)		// Bye: the lowest ranked player who has not had one
+	{
+		uint8_t bye = n - 1;
+
+		for(uint8_t i = n; i-- > 0; )
+		{
+			if(!Tourney_Met(s, rank[i], TOURNEY_BYE, round))
+			{
+				bye = i;
+				break;
+			}
+		}
+
+		taken[bye] = 1;
+		s->opp[rank[bye]][round] = TOURNEY_BYE;
+	}
+
+	while(depth < n / 2)
+	{
+		uint8_t u = 0, v;
+
+		while(taken[u])			// Highest ranked player still to pair
+		{
+			u++;
+		}
+
+		for(v = (from > u) ? from : u + 1; v < n; v++)
+		{
+			if(!taken[v] && (rematch || !Tourney_Met(s, rank[u], rank[v], round)))
+			{
+				break;
+			}
+		}
+
+		if(++steps >= TOURNEY_SWISS_STEPS)
+		{
+			rematch = 1;
+		}
+
+		if(v < n)
+		{
+			taken[u] = taken[v] = 1;
+			first[depth] = u;
+			second[depth++] = v;
+			from = 0;
+		}else if(depth == 0)	// No pairing without a rematch
+		{
+			rematch = 1;
+			from = 0;
+		}else
+		{
+			depth--;
+			taken[first[depth]] = taken[second[depth]] = 0;
+			from = second[depth] + 1;
+		}
+	}
+
+	for(uint8_t i = 0; i < depth; i++)
+	{
+		uint8_t a = rank[first[i]], b = rank[second[i]];
+
+		t->rematches += Tourney_Met(s, a, b, round);
+		s->opp[a][round] = b;
+		s->opp[b][round] = a;
+	}
+
+	s->paired = round + 1;
+}
+
+
+/**
+  * @brief  Returns the opponent of a player in a round robin round, by the circle method:
+  * 		players 0 to m - 1 on a circle, m at its centre (m odd), i meets j in round
+  * 		(i + j) mod m and m meets the i with 2i = round mod m
+  * @param  players number of players
+  * @param  round round, 0 to the number of rounds - 1
+  * @param  player player
+  * @retval Opponent, TOURNEY_BYE if the player sits the round out
+  */
+
+uint8_t Tourney_Opponent(uint8_t players, uint8_t round, uint8_t player)
+{
+	uint8_t m = players - 1 + (players & 1);		// With an odd number of players, the centre is the bye
+	uint8_t o;
+
+	if(player == m)
+	{
+		return (round * ((m + 1) / 2)) % m;			// (m + 1) / 2 is the inverse of 2 mod m
+	}
+
+	o = (round + m - player) % m;
+
+	if(o == player)
+	{
+		o = m;
+	}
+
+	return (o < players) ? o : TOURNEY_BYE;
+}
+
+
+/**
+  * @brief  Returns the opponent a player meets next, once both are free
+  * @retval Opponent, TOURNEY_BYE, TOURNEY_NONE if the player has no match to play yet
+  */
+
+static uint8_t Tourney_Next(const Tourney_t *t, uint8_t p)
+{
+	const Tourney_Store_t *s = t->store;
+	uint8_t r = s->played[p];
+
+	if(r >= s->rounds)
+	{
+		return TOURNEY_NONE;
+	}
+
+	if(s->mode == TOURNEY_SWISS)
+	{
+		return (r < s->paired) ? s->opp[p][r] : TOURNEY_NONE;
+	}
+
+	// A round at a time: the round before is not over. Overlapped: not too far ahead of the slowest player,
+	// the hands of the low nodes would keep the bus from the others (lowest ID wins)
+	if(t->round == TOURNEY_NONE || r > t->round + ((s->overlap != 0) ? TOURNEY_LEAD : 0))
+	{
+		return TOURNEY_NONE;
+	}
+
+	return Tourney_Opponent(s->players, r, p);
+}
+
+
+/**
+  * @brief  Starts a match: the pairing goes to both players
+  */
+
+static void Tourney_Begin(Tourney_t *t, uint8_t a, uint8_t b, uint32_t tick)
+{
+	uint8_t p[2] = {a, b};
+
+	t->opp[a] = b;
+	t->opp[b] = a;
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		t->hand[p[i]] = TOURNEY_NONE;
+		t->game[p[i]] = 0;
+		t->score[p[i]] = 0;
+		t->tick[p[i]] = tick;
+		t->tx_count += ((t->tx[p[i]] & TOURNEY_TX_PAIRING) == 0);
+		t->tx[p[i]] |= TOURNEY_TX_PAIRING;
+	}
+
+	t->open++;
+}
+
+
+/**
+  * @brief  Queues the result of a game for a player, with the games left
+  */
+
+static void Tourney_Result(Tourney_t *t, uint8_t p, uint8_t result)
+{
+	t->game[p]++;
+	t->score[p] += (result == 1) ? 2 : (result == 3);
+	t->hand[p] = TOURNEY_NONE;
+	t->tx_count += ((t->tx[p] & ~TOURNEY_TX_PAIRING) == 0);
+	t->tx[p] = (t->tx[p] & TOURNEY_TX_PAIRING) | result;		// A result still unsent is overtaken by the new one
+	t->left[p] = t->store->games - t->game[p];
+}
+
+
+/**
+  * @brief  Ends a match: standings written, then the matches its players can now play
+  */
+
+static void Tourney_End(Tourney_t *t, uint8_t a, uint8_t b, uint32_t tick)
+{
+	Tourney_Store_t *s = t->store;
+	uint8_t p[2] = {a, b};
+
+	s->points[a] += (t->score[a] > t->score[b]) ? 2 : (t->score[a] == t->score[b]);
+	s->points[b] += (t->score[b] > t->score[a]) ? 2 : (t->score[a] == t->score[b]);
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		s->game_points[p[i]] += t->score[p[i]];
+		s->played[p[i]]++;
+		t->opp[p[i]] = TOURNEY_NONE;
+
+		if(t->tx[p[i]] & TOURNEY_TX_PAIRING)		// Pairing sent again after the last game: too late
+		{
+			t->tx[p[i]] &= ~TOURNEY_TX_PAIRING;
+			t->tx_count--;
+		}
+	}
+
+	t->open--;
+	t->matches++;
+
+	Tourney_Schedule(t, tick);
+}
+
+
+/**
+  * @brief  Starts every match whose players are free, up to max_open. Once all players
+  * 		are done with a round, the next Swiss round is paired
+  * @param  t pointer to the tournament
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+static void Tourney_Schedule(Tourney_t *t, uint32_t tick)
+{
+	Tourney_Store_t *s = t->store;
+
+	while(1)
+	{
+		uint8_t low = TOURNEY_NONE;
+
+		for(uint8_t p = 0; p < s->players; p++)
+		{
+			uint8_t o = TOURNEY_NONE;
+
+			if(t->opp[p] == TOURNEY_NONE)
+			{
+				while((o = Tourney_Next(t, p)) == TOURNEY_BYE)
+				{
+					s->points[p] += (s->mode == TOURNEY_SWISS) ? 2 : 0;		// All sit a round robin round out once
+					s->played[p]++;
+				}
+			}
+
+			if(o < TOURNEY_MAX && t->opp[o] == TOURNEY_NONE && s->played[o] == s->played[p] && t->open < s->max_open)
+			{
+				Tourney_Begin(t, p, o, tick);
+			}
+
+			low = (s->played[p] < low) ? s->played[p] : low;
+		}
+
+		if(low == s->rounds)
+		{
+			s->done = 1;
+			return;
+		}
+
+		if(s->mode == TOURNEY_SWISS && s->paired == low)
+		{
+			Tourney_PairSwiss(t, low);
+		}else if(low == t->round)
+		{
+			return;
+		}
+
+		t->round = low;			// Next round paired, or round robin round over: another pass
+	}
+}
+
+
+/**
+  * @brief  Referees the hand of a player node: once its opponent's hand is in, the result
+  * 		goes to both. The last game ends the match
+  * @param  t pointer to the tournament
+  * @param  node player node
+  * @param  hand its hand
+  * @param  tick HAL tick
+  * @retval Result of the game for the node, 0 if it waits for its opponent's hand or the
+  * 		node has no match under way
+  */
+
+uint8_t Tourney_Hand(Tourney_t *t, uint16_t node, uint8_t hand, uint32_t tick)
+{
+	uint8_t p = (node < SESSION_NODES) ? t->by_node[node] : TOURNEY_NONE;
+	uint8_t o, result;
+
+	if(p == TOURNEY_NONE || t->opp[p] == TOURNEY_NONE)
+	{
+		t->strays++;
+		return 0;
+	}
+
+	o = t->opp[p];
+	t->hand[p] = hand;					// A hand sent twice for the same game: the last one counts
+	t->tick[p] = t->tick[o] = tick;
+
+	if(t->hand[o] == TOURNEY_NONE)
+	{
+		return 0;
+	}
+
+	result = Tourney_Game(hand, t->hand[o]);
+	Tourney_Result(t, p, result);
+	Tourney_Result(t, o, (result == 1 || result == 2) ? 3 - result : result);
+	t->games++;
+
+	if(t->game[p] == t->store->games)
+	{
+		Tourney_End(t, p, o, tick);
+	}
+
+	return result;
+}
+
+
+/**
+  * @brief  Sends the pairing again to both players of a match with no hand for retry_ms:
+  * 		a lost hand, result or pairing leaves both players waiting otherwise. The quiet
+  * 		time starts over while a frame of the match waits for a Tx mailbox: the bus is
+  * 		busy, not the match lost
+  * @param  t pointer to the tournament
+  * @param  tick HAL tick
+  * @param  retry_ms quiet time
+  * @retval None
+  */
+
+void Tourney_Tick(Tourney_t *t, uint32_t tick, uint32_t retry_ms)
+{
+	for(uint8_t p = 0; p < t->store->players; p++)
+	{
+		uint8_t o = t->opp[p];
+
+		if(o == TOURNEY_NONE || o < p || tick - t->tick[p] < retry_ms)
+		{
+			continue;
+		}
+
+		if(t->tx[p] != 0 || t->tx[o] != 0)
+		{
+			t->tick[p] = t->tick[o] = tick;
+			continue;
+		}
+
+		for(uint8_t i = 0; i < 2; i++, o = p)
+		{
+			t->tick[o] = tick;
+			t->tx_count += ((t->tx[o] & TOURNEY_TX_PAIRING) == 0);
+			t->tx[o] |= TOURNEY_TX_PAIRING;
+		}
+
+		t->retries++;
+	}
+}
+
+
+/**
+  * @brief  Returns the next frame waiting for a Tx mailbox: results first, they let a
+  * 		match go on
+  * @param  t pointer to the tournament
+  * @param  f receives the frame
+  * @retval 1 if there is one, 0 if not
+  */
+
+uint8_t Tourney_NextTx(const Tourney_t *t, Tourney_Frame_t *f)
+{
+	const Tourney_Store_t *s = t->store;
+
+	for(uint8_t pass = 0; pass < 2 && t->tx_count > 0; pass++)
+	{
+		for(uint8_t p = 0; p < s->players; p++)
+		{
+			uint8_t result = t->tx[p] & ~TOURNEY_TX_PAIRING;
+
+			if(pass == 0 && result != 0)
+			{
+				*f = (Tourney_Frame_t){SESSION_RESULT_ID + s->node[p], 2, {result, t->left[p]}, p};
+				return 1;
+			}
+
+			if(pass == 1 && (t->tx[p] & TOURNEY_TX_PAIRING))
+			{
+				*f = (Tourney_Frame_t){SESSION_RESULT_ID + s->node[p], 4, {TOURNEY_PAIRING, s->played[p], \
+									   s->node[t->opp[p]], s->games - t->game[p]}, p};
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  A frame of Tourney_NextTx() is in a Tx mailbox
+  * @param  t pointer to the tournament
+  * @param  f the frame
+  * @retval None
+  */
+
+void Tourney_Sent(Tourney_t *t, const Tourney_Frame_t *f)
+{
+	uint8_t kind = (f->data[0] == TOURNEY_PAIRING) ? TOURNEY_TX_PAIRING : (uint8_t)~TOURNEY_TX_PAIRING;
+
+	t->tx_count -= ((t->tx[f->player] & kind) != 0);
+	t->tx[f->player] &= ~kind;
+}
+
+
+/**
+  * @brief  Returns the number of matches of the whole tournament
+  */
+
+uint16_t Tourney_Matches(const Tourney_Store_t *s)
+{
+	if(s->mode == TOURNEY_ROUND_ROBIN)
+	{
+		return s->players * (s->players - 1) / 2;
+	}
+
+	return s->rounds * (s->players / 2);
+}
+
+
+/**
+  * @brief  Ranks the players
+  * @param  t pointer to the tournament
+  * @param  rank receives the players, first place first
+  * @retval Number of players
+  */
+
+uint8_t Tourney_Ranking(const Tourney_t *t, uint8_t rank[])
+{
+	const Tourney_Store_t *s = t->store;
+
+	for(uint8_t i = 0; i < s->players; i++)		// Insertion sort: 64 players at most
+	{
+		uint8_t j = i;
+
+		while(j > 0 && Tourney_Ahead(s, i, rank[j - 1]))
+		{
+			rank[j] = rank[j - 1];
+			j--;
+		}
+
+		rank[j] = i;
+	}
+
+	return s->players;
+}
+
+
+/**
+  * @brief  Writes the TOURNEY line: mode, round, matches played and under way, games,
+  * 		leader, hands from nodes with no match, pairings sent again, Swiss rematches
+  * @param  t pointer to the tournament
+  * @param  buf receives the line (160 bytes at most)
+  * @retval None
+  */
+
+void Tourney_Report(const Tourney_t *t, char *buf)
+{
+	const Tourney_Store_t *s = t->store;
+	uint8_t rank[TOURNEY_MAX];
+
+	Tourney_Ranking(t, rank);
+
+	sprintf(buf, "TOURNEY %s round: %u/%u, matches: %lu/%u, open: %u, games: %lu, leader: node %u (%u.%u), strays: %lu, " \
+			"retries: %lu, rematches: %lu%s\r\n", (s->mode == TOURNEY_SWISS) ? "swiss" : "round robin", \
+			(s->done) ? s->rounds : t->round + 1, s->rounds, (unsigned long)t->matches, Tourney_Matches(s), t->open, \
+			(unsigned long)t->games, s->node[rank[0]], s->points[rank[0]] / 2, 5 * (s->points[rank[0]] & 1), \
+			(unsigned long)t->strays, (unsigned long)t->retries, (unsigned long)t->rematches, (s->done) ? ", over" : "");
+}
+
+
+/**
+  * @brief  Writes the line of a player in the standings
+  * @param  t pointer to the tournament
+  * @param  place place, from 1
+  * @param  player player
+  * @param  buf receives the line (60 bytes at most)
+  * @retval None
+  */
+
+void Tourney_Standing(const Tourney_t *t, uint8_t place, uint8_t player, char *buf)
+{
+	const Tourney_Store_t *s = t->store;
+
+	sprintf(buf, "%2u. node %3u  points %2u.%u  games %3u.%u  played %u\r\n", place, s->node[player], \
+			s->points[player] / 2, 5 * (s->points[player] & 1), s->game_points[player] / 2, \
+			5 * (s->game_points[player] & 1), s->played[player]);
+}
@@ -0,0 +1,707 @@
+/**
+  ******************************************************************************
+  * @file    archive_tool.c
+  * @author  Moe2Code
+  * @brief   Builds and queries columnar round archives (round_archive.c).
+  *          import: appends the rounds of Nucleo history dumps (4096 bytes of backup SRAM or
+  *                  the history region saved by export_rx) and of Disc UART captures
+  *                  ("Nucleo's hand is" / "Disc's hand is" lines) under a node number.
+  *                  Rounds are 4 s apart. Captures take their times from the RTC stamps of
+  *                  their lines (spread over the rounds in between), dumps end at the file
+  *                  modification time
+  *          info:   prints the chunks of an archive
+  *          count:  result counts of a node (or all) over a time range. Times are Unix seconds
+  *                  or YYYY-MM-DD[THH:MM[:SS]] (UTC)
+  *          dump:   prints the rounds as CSV (time, node, Nucleo's hand, Disc's hand, result)
+  *          bench:  appends synthetic rounds of 32 nodes to a scratch archive, times aggregate
+  *                  queries and checks them against a plain scan of the rounds
+  *          Usage: ./archive_tool import archive.rpa node file...
+  *                 ./archive_tool info archive.rpa
+  *                 ./archive_tool count archive.rpa [node|all] [from] [to]
+  *                 ./archive_tool dump archive.rpa
+  *                 ./archive_tool bench [millions of rounds per node] [scratch file]
+  */
+
+// Includes
+#define _GNU_SOURCE				// timegm()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "round_archive.h"
+#include "history.h"
+
+
+// Defines
+#define BSRAM_SIZE			4096
+#define ROUND_SECONDS		4			// TIM6 period: one round every 4 s
+#define BENCH_NODES			32
+#define BENCH_QUERIES		5
+
+
+// Typedefs
+// Rounds being collected for an import
+typedef struct
+{
+	Arc_Row_t *row;
+	uint64_t n, max;
+} Rows_t;
+
+// RTC stamp of a capture: time of the round that follows it
+typedef struct
+{
+	uint64_t row;
+	int64_t time;
+} Stamp_t;
+
+
+// Global variables
+static Rows_t collected;
+static uint32_t import_node;
+
+
+// Function prototypes
+static void add_row(uint8_t code);
+static int64_t parse_time(const char *s);
+static int parse_stamp(const char *line, int64_t *t);
+static uint8_t parse_hand(const char *line, const char *marker);
+static int import_dump(const char *path, const uint8_t *data, size_t size, int64_t end);
+static int import_capture(const char *path, FILE *f, int64_t end);
+static int cmd_import(int argc, char *argv[]);
+static int cmd_info(const char *path);
+static int cmd_count(int argc, char *argv[]);
+static int cmd_dump(const char *path);
+static int cmd_bench(int argc, char *argv[]);
+static double now_s(void);
+
+
+/**
+  * @brief  Appends a round (history code) to the rounds being imported. The time is set later
+  * @param  code Nucleo's hand * 3 + Disc's hand, or HISTORY_ERROR
+  * @retval None
+  */
+
+static void add_row(uint8_t code)
+{
+	if(collected.n == collected.max)
+	{
+		collected.max = collected.max ? 2 * collected.max : 4096;
+		collected.row = realloc(collected.row, collected.max * sizeof(Arc_Row_t));
+
+		if(collected.row == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+
+	collected.row[collected.n].time = 0;
+	collected.row[collected.n].node = import_node;
+	collected.row[collected.n].hands = code;
+	collected.row[collected.n].result = History_Result(code);
+	collected.n++;
+}
+
+
+/**
+  * @brief  Parses a command line time
+  * @param  s Unix seconds or YYYY-MM-DD[THH:MM[:SS]] (UTC)
+  * @retval Unix time, exits on a bad time
+  */
+
+static int64_t parse_time(const char *s)
+{
+	struct tm tm = {0};
+	char *end;
+	long long v = strtoll(s, &end, 10);
+
+	if(*end == '\0')
+	{
+		return v;
+	}
+
+	if(sscanf(s, "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3)
+	{
+		fprintf(stderr, "Bad time %s\n", s);
+		exit(1);
+	}
+
+	if(strchr(s, 'T') != NULL)
+	{
+		sscanf(strchr(s, 'T') + 1, "%d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+	}
+
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+
+	return timegm(&tm);
+}
+
+
+/**
+  * @brief  Finds the RTC stamp get_date_time() puts before Disc's stats lines
+  * 		("20YY-MM-DD hh:mm:ss AM - ", 12-hour clock)
+  * @param  line capture line
+  * @param  t receives the Unix time (RTC time taken as UTC)
+  * @retval 1 if the line holds a stamp, 0 otherwise
+  */
+
+static int parse_stamp(const char *line, int64_t *t)
+{
+	struct tm tm = {0};
+	char ampm[3];
+
+	for(const char *p = strstr(line, "20"); p != NULL; p = strstr(p + 1, "20"))
+	{
+		if(sscanf(p, "%4d-%2d-%2d %2d:%2d:%2d %2[AP]M", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, \
+				  &tm.tm_hour, &tm.tm_min, &tm.tm_sec, ampm) == 7)
+		{
+			tm.tm_year -= 1900;
+			tm.tm_mon -= 1;
+			tm.tm_hour = tm.tm_hour % 12 + ((ampm[0] == 'P') ? 12 : 0);
+			*t = timegm(&tm);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Returns the hand named in a capture line after the given marker
+  * @param  line capture line
+  * @param  marker text right before the hand name
+  * @retval Hand 0 to 2, 0xFF if the line does not hold the marker
+  */
+
+static uint8_t parse_hand(const char *line, const char *marker)
+{
+	const char *names[3] = {"Rock", "Paper", "Scissors"};
+	const char *p = strstr(line, marker);
+
+	if(p == NULL)
+	{
+		return 0xFF;
+	}
+
+	p += strlen(marker);
+
+	for(uint8_t h = 0; h < 3; h++)
+	{
+		if(strncmp(p, names[h], strlen(names[h])) == 0)
+		{
+			return h;
+		}
+	}
+
+	return 0xFF;
+}
+
+
+/**
+  * @brief  Collects the rounds of a Nucleo history dump, the last one at the given time
+  * @param  path dump file (for messages)
+  * @param  data file contents
+  * @param  size BSRAM_SIZE or HISTORY_SIZE
+  * @param  end time of the last round
+  * @retval Rounds collected
+  */
+
+static int import_dump(const char *path, const uint8_t *data, size_t size, int64_t end)
+{
+	History_t h = {0};
+	History_Anchor_t a, newest = {0};
+	uint64_t first = collected.n;
+	uint8_t found = 0;
+
+	h.mem = (uint8_t *)data + ((size == BSRAM_SIZE) ? HISTORY_OFFSET : 0);
+
+	for(uint8_t b = 0; b < HISTORY_BLOCKS; b++)		// History_Replay() goes oldest to newest from the newest block
+	{
+		if(History_ReadAnchor(h.mem, b, &a) && (!found || a.round >= newest.round))
+		{
+			newest = a;
+			h.block = b;
+			found = 1;
+		}
+	}
+
+	if(!found)
+	{
+		fprintf(stderr, "%s: no valid history block\n", path);
+		return 0;
+	}
+
+	History_Replay(&h, add_row);
+
+	for(uint64_t i = first; i < collected.n; i++)
+	{
+		collected.row[i].time = end - (int64_t)(collected.n - 1 - i) * ROUND_SECONDS;
+	}
+
+	return collected.n - first;
+}
+
+
+/**
+  * @brief  Collects the rounds of a Disc UART capture and times them from its RTC stamps.
+  * 		Between two stamps the rounds are spread evenly, before the first and after the
+  * 		last they are ROUND_SECONDS apart. A capture without stamps ends at the given time
+  * @param  path capture file (for messages)
+  * @param  f open capture
+  * @param  end time of the last round if the capture has no stamp
+  * @retval Rounds collected
+  */
+
+static int import_capture(const char *path, FILE *f, int64_t end)
+{
+	Stamp_t *stamps = NULL;
+	uint64_t first = collected.n, n, s = 0, count = 0, max = 0;
+	uint8_t nucleo = 0xFF, disc;
+	char line[512];
+	int64_t t;
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		if((disc = parse_hand(line, "Nucleo's hand is ")) != 0xFF)
+		{
+			nucleo = disc;
+		}else if((disc = parse_hand(line, "Disc's hand is ")) != 0xFF && nucleo != 0xFF)
+		{
+			add_row(nucleo * 3 + disc);
+			nucleo = 0xFF;
+		}else if(parse_stamp(line, &t))
+		{
+			if(count == max)
+			{
+				max = max ? 2 * max : 64;
+				stamps = realloc(stamps, max * sizeof(Stamp_t));
+			}
+
+			stamps[count].row = collected.n - first;
+			stamps[count].time = t;
+			count++;
+		}
+	}
+
+	n = collected.n - first;
+
+	if(n == 0)
+	{
+		fprintf(stderr, "%s: no rounds\n", path);
+	}
+
+	for(uint64_t i = 0; i < n; i++)
+	{
+		Arc_Row_t *row = &collected.row[first + i];
+
+		while(s + 1 < count && stamps[s + 1].row <= i)
+		{
+			s++;
+		}
+
+		if(count == 0)
+		{
+			row->time = end - (int64_t)(n - 1 - i) * ROUND_SECONDS;
+		}else if(i < stamps[0].row)
+		{
+			row->time = stamps[0].time - (int64_t)(stamps[0].row - i) * ROUND_SECONDS;
+		}else if(s + 1 < count && stamps[s + 1].row > stamps[s].row)
+		{
+			row->time = stamps[s].time + (stamps[s + 1].time - stamps[s].time) * (int64_t)(i - stamps[s].row) / \
+						(int64_t)(stamps[s + 1].row - stamps[s].row);
+		}else
+		{
+			row->time = stamps[s].time + (int64_t)(i - stamps[s].row) * ROUND_SECONDS;
+		}
+	}
+
+	free(stamps);
+
+	return n;
+}
+
+
+/**
+  * @brief  Imports dumps and captures into an archive
+  * @param  argc, argv archive, node and files
+  * @retval Exit code
+  */
+
+static int cmd_import(int argc, char *argv[])
+{
+	static uint8_t dump[BSRAM_SIZE + 1];
+	struct stat st;
+	size_t size;
+	FILE *f;
+	int n;
+
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage: ./archive_tool import archive.rpa node file...\n");
+		return 1;
+	}
+
+	import_node = strtoul(argv[1], NULL, 0);
+
+	for(int i = 2; i < argc; i++)
+	{
+		if((f = fopen(argv[i], "rb")) == NULL || fstat(fileno(f), &st) != 0)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+
+		size = fread(dump, 1, sizeof(dump), f);
+
+		if(size == BSRAM_SIZE || size == HISTORY_SIZE)
+		{
+			n = import_dump(argv[i], dump, size, st.st_mtime);
+		}else
+		{
+			rewind(f);
+			n = import_capture(argv[i], f, st.st_mtime);
+		}
+
+		fclose(f);
+		printf("%s: %d rounds\n", argv[i], n);
+	}
+
+	if(collected.n > 0 && Arc_Append(argv[0], collected.row, collected.n) != 0)
+	{
+		return 1;
+	}
+
+	printf("%llu rounds appended to %s as node %u\n", (unsigned long long)collected.n, argv[0], import_node);
+	free(collected.row);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Prints the chunks of an archive
+  * @param  path archive file
+  * @retval Exit code
+  */
+
+static int cmd_info(const char *path)
+{
+	Arc_Reader_t r;
+	uint64_t bytes = 0;
+
+	if(Arc_Open(path, &r) != 0)
+	{
+		return 1;
+	}
+
+	printf("chunk,rounds,nodes,from,to,nucleo_wins,disc_wins,ties,errors,bytes\n");
+
+	for(uint32_t c = 0; c < r.chunks; c++)
+	{
+		const Arc_Chunk_t *e = &r.chunk[c];
+		uint32_t size = e->size[0] + e->size[1] + e->size[2] + e->size[3];
+
+		printf("%u,%u,%u-%u,%lld,%lld,%u,%u,%u,%u,%u\n", c, e->rows, e->node_min, e->node_max, (long long)e->time_min, \
+			   (long long)e->time_max, e->results[0], e->results[1], e->results[2], e->results[3], size);
+		bytes += size;
+	}
+
+	printf("%u chunks, %llu rounds, %llu column bytes (%.2f per round), file %zu bytes\n", r.chunks, \
+		   (unsigned long long)r.rows, (unsigned long long)bytes, r.rows ? (double)bytes / r.rows : 0.0, r.size);
+	Arc_Close(&r);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Prints the result counts of a node (or all) over a time range
+  * @param  argc, argv archive, then optional node ("all"), from and to
+  * @retval Exit code
+  */
+
+static int cmd_count(int argc, char *argv[])
+{
+	Arc_Query_t q = {INT64_MIN, INT64_MAX, ARC_ANY_NODE};
+	Arc_Reader_t r;
+	uint64_t counts[ARC_RESULTS];
+
+	if(argc > 1 && strcmp(argv[1], "all") != 0)
+	{
+		q.node = strtoul(argv[1], NULL, 0);
+	}
+
+	q.from = (argc > 2) ? parse_time(argv[2]) : q.from;
+	q.to = (argc > 3) ? parse_time(argv[3]) : q.to;
+
+	if(Arc_Open(argv[0], &r) != 0)
+	{
+		return 1;
+	}
+
+	Arc_Count(&r, &q, counts);
+	printf("Nucleo Wins: %llu, Disc Wins: %llu, Ties: %llu, Game Error: %llu\n", (unsigned long long)counts[0], \
+		   (unsigned long long)counts[1], (unsigned long long)counts[2], (unsigned long long)counts[3]);
+	Arc_Close(&r);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Prints the rounds of an archive as CSV
+  * @param  path archive file
+  * @retval Exit code
+  */
+
+static int cmd_dump(const char *path)
+{
+	const char *hand[3] = {"Rock", "Paper", "Scissors"};
+	const char *result[ARC_RESULTS] = {"Nucleo", "Disc", "Tie", "Error"};
+	Arc_Row_t *rows = malloc(ARC_CHUNK_ROWS * sizeof(Arc_Row_t));
+	Arc_Reader_t r;
+
+	if(rows == NULL || Arc_Open(path, &r) != 0)
+	{
+		free(rows);
+		return 1;
+	}
+
+	printf("time,node,nucleo,disc,winner\n");
+
+	for(uint32_t c = 0; c < r.chunks; c++)
+	{
+		uint32_t n = Arc_ReadChunk(&r, c, rows);
+
+		for(uint32_t i = 0; i < n; i++)
+		{
+			uint8_t error = (rows[i].hands == HISTORY_ERROR);
+
+			printf("%lld,%u,%s,%s,%s\n", (long long)rows[i].time, rows[i].node, error ? "-" : hand[rows[i].hands / 3], \
+				   error ? "-" : hand[rows[i].hands % 3], result[rows[i].result - 1]);
+		}
+	}
+
+	Arc_Close(&r);
+	free(rows);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Returns a monotonic time in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Appends synthetic rounds (one node per append, each node playing over the same
+  * 		weeks with pauses) and times aggregate queries, checking each against a scan of
+  * 		the rounds kept in memory. Rates are of the rounds and column bytes a query reads:
+  * 		queries the footer settles are lookups and get no rate
+  * @param  argc, argv optional millions of rounds per node and scratch file
+  * @retval Exit code
+  */
+
+static int cmd_bench(int argc, char *argv[])
+{
+	uint64_t per_node = (argc > 0) ? (uint64_t)(atof(argv[0]) * 1e6) : 1000000;
+	const char *path = (argc > 1) ? argv[1] : "archive_bench.rpa";
+	uint64_t total = per_node * BENCH_NODES, counts[ARC_RESULTS], expect[ARC_RESULTS], bytes = 0, seed = 88;
+	uint64_t scan_rows, scan_bytes;
+	const int64_t start = 1767225600;		// 2026-01-01
+	Arc_Row_t *rows = malloc(total * sizeof(Arc_Row_t));
+	Arc_Query_t q[BENCH_QUERIES];
+	const char *what[BENCH_QUERIES] = {"all rounds (footer counts)", "one node (footer counts)", \
+									   "last week, all nodes (time scan)", "last week, one node (time scan)", \
+									   "every node, one by one"};
+	Arc_Reader_t r;
+	double t0, best;
+	char rate[80];
+	int fail = 0;
+
+	if(rows == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	remove(path);
+	t0 = now_s();
+
+	for(uint32_t node = 0; node < BENCH_NODES; node++)
+	{
+		Arc_Row_t *row = &rows[node * per_node];
+		int64_t t = start + node * 60;
+
+		for(uint64_t i = 0; i < per_node; i++)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			t += ((seed >> 20) % 1000 == 0) ? (int64_t)((seed >> 40) % 3600) : ROUND_SECONDS;	// Now and then a pause
+			row[i].time = t;
+			row[i].node = node;
+			row[i].hands = ((seed >> 33) % 100 == 0) ? HISTORY_ERROR : (seed >> 36) % 9;
+			row[i].result = History_Result(row[i].hands);
+		}
+
+		if(Arc_Append(path, row, per_node) != 0)
+		{
+			return 1;
+		}
+	}
+
+	printf("Appended %llu rounds in %.2f s\n", (unsigned long long)total, now_s() - t0);
+
+	if(Arc_Open(path, &r) != 0)
+	{
+		return 1;
+	}
+
+	for(uint32_t c = 0; c < r.chunks; c++)
+	{
+		bytes += r.chunk[c].size[0] + r.chunk[c].size[1] + r.chunk[c].size[2] + r.chunk[c].size[3];
+	}
+
+	printf("%u chunks, %.2f column bytes per round, file %.1f MB\n", r.chunks, (double)bytes / total, r.size / 1e6);
+
+	q[0] = (Arc_Query_t){INT64_MIN, INT64_MAX, ARC_ANY_NODE};
+	q[1] = (Arc_Query_t){INT64_MIN, INT64_MAX, 7};
+	q[2] = (Arc_Query_t){rows[per_node - 1].time - 7 * 86400, rows[per_node - 1].time, ARC_ANY_NODE};
+	q[3] = (Arc_Query_t){q[2].from, q[2].to, 7};
+	q[4] = q[2];
+
+	for(int k = 0; k < BENCH_QUERIES; k++)
+	{
+		best = 1e9;
+
+		for(int rep = 0; rep < 5; rep++)
+		{
+			t0 = now_s();
+
+			if(k < BENCH_QUERIES - 1)
+			{
+				Arc_Count(&r, &q[k], counts);
+			}else
+			{
+				uint64_t node_counts[ARC_RESULTS];
+
+				memset(counts, 0, sizeof(counts));
+
+				for(uint32_t node = 0; node < BENCH_NODES; node++)
+				{
+					Arc_Query_t qn = {q[k].from, q[k].to, node};
+
+					Arc_Count(&r, &qn, node_counts);
+
+					for(int i = 0; i < ARC_RESULTS; i++)
+					{
+						counts[i] += node_counts[i];
+					}
+				}
+			}
+
+			best = (now_s() - t0 < best) ? now_s() - t0 : best;
+		}
+
+		if(k < BENCH_QUERIES - 1)
+		{
+			Arc_Scanned(&r, &q[k], &scan_rows, &scan_bytes);
+		}else
+		{
+			scan_rows = scan_bytes = 0;
+
+			for(uint32_t node = 0; node < BENCH_NODES; node++)
+			{
+				Arc_Query_t qn = {q[k].from, q[k].to, node};
+				uint64_t n_rows, n_bytes;
+
+				Arc_Scanned(&r, &qn, &n_rows, &n_bytes);
+				scan_rows += n_rows;
+				scan_bytes += n_bytes;
+			}
+		}
+
+		if(scan_rows == 0)		// Settled by the footer: a lookup, no rounds read
+		{
+			snprintf(rate, sizeof(rate), "footer lookup, no column read");
+		}else
+		{
+			snprintf(rate, sizeof(rate), "%5.1f M rounds  %6.1f MB  %5.0f M rounds/s  %5.2f GB/s", scan_rows / 1e6, \
+					 scan_bytes / 1e6, scan_rows / best / 1e6, scan_bytes / best / 1e9);
+		}
+
+		memset(expect, 0, sizeof(expect));
+
+		for(uint64_t i = 0; i < total; i++)
+		{
+			if(rows[i].time >= q[k].from && rows[i].time < q[k].to && (q[k].node == ARC_ANY_NODE || rows[i].node == q[k].node))
+			{
+				expect[rows[i].result - 1]++;
+			}
+		}
+
+		printf("%-34s %9.1f us  %-56s %llu/%llu/%llu/%llu", what[k], best * 1e6, rate, \
+			   (unsigned long long)counts[0], (unsigned long long)counts[1], \
+			   (unsigned long long)counts[2], (unsigned long long)counts[3]);
+
+		if(memcmp(counts, expect, sizeof(counts)) != 0)
+		{
+			printf("  FAIL, expected %llu/%llu/%llu/%llu\n", (unsigned long long)expect[0], (unsigned long long)expect[1], \
+				   (unsigned long long)expect[2], (unsigned long long)expect[3]);
+			fail = 1;
+		}else
+		{
+			printf("\n");
+		}
+	}
+
+	Arc_Close(&r);
+	free(rows);
+	remove(path);
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && strcmp(argv[1], "import") == 0)
+	{
+		return cmd_import(argc - 2, &argv[2]);
+	}else if(argc == 3 && strcmp(argv[1], "info") == 0)
+	{
+		return cmd_info(argv[2]);
+	}else if(argc >= 3 && strcmp(argv[1], "count") == 0)
+	{
+		return cmd_count(argc - 2, &argv[2]);
+	}else if(argc == 3 && strcmp(argv[1], "dump") == 0)
+	{
+		return cmd_dump(argv[2]);
+	}else if(argc >= 2 && strcmp(argv[1], "bench") == 0)
+	{
+		return cmd_bench(argc - 2, &argv[2]);
+	}
+
+	fprintf(stderr, "Usage: %s import archive.rpa node file...\n"
+					"       %s info archive.rpa\n"
+					"       %s count archive.rpa [node|all] [from] [to]\n"
+					"       %s dump archive.rpa\n"
+					"       %s bench [millions of rounds per node] [scratch file]\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+
+	return 1;
+}
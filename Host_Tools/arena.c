@@ -0,0 +1,216 @@
+/**
+  ******************************************************************************
+  * @file    arena.c
+  * @author  Moe2Code
+  * @brief   Host arena for the player strategies (strategy.c, the same code the boards run).
+  *          Every pair of strategies plays sessions of rounds, spread over all CPU cores.
+  *          Reports per pair the win/loss/tie rates of the first strategy and its edge
+  *          (wins - losses per round) with a 95% confidence interval, then the mean edge of
+  *          each strategy against the others.
+  *          Usage: ./arena [-r rounds_per_session] [-s sessions_per_pair] [-t threads] [-S seed]
+  * @note    Strategies adapt within a session, so rounds are not independent. The interval
+  *          is computed from the spread of the session means (batch means) instead
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "strategy.h"
+
+
+// Typedefs
+// One session: a fresh pair of players plays a number of rounds
+typedef struct
+{
+	uint8_t a, b;				// Strategy IDs
+	uint32_t seed;
+	uint64_t wins, losses, ties;	// From a's point of view
+} Session_t;
+
+
+// Global variables
+static Session_t *sessions;
+static uint32_t n_sessions;
+static uint32_t rounds_per_session = 65536;
+static atomic_uint next_session;
+
+
+/**
+  * @brief  Plays one session between strategies a and b
+  * @param  s pointer to the session
+  * @retval None
+  */
+
+static void play_session(Session_t *s)
+{
+	Strategy_Player_t pa, pb;
+	uint8_t ha, hb;
+
+	Strategy_Init(&pa, s->a, s->seed);
+	Strategy_Init(&pb, s->b, s->seed * 2654435761u + 1);
+
+	for(uint32_t i = 0; i < rounds_per_session; i++)
+	{
+		ha = Strategy_Pick(&pa);
+		hb = Strategy_Pick(&pb);
+
+		if(ha == hb)
+		{
+			s->ties++;
+		}else if(ha == (hb + 1) % 3)
+		{
+			s->wins++;
+		}else
+		{
+			s->losses++;
+		}
+
+		Strategy_Observe(&pa, ha, hb);
+		Strategy_Observe(&pb, hb, ha);
+	}
+}
+
+
+/**
+  * @brief  Worker thread: plays sessions until none is left
+  * @param  arg unused
+  * @retval NULL
+  */
+
+static void* worker(void *arg)
+{
+	uint32_t i;
+
+	(void)arg;
+
+	while((i = atomic_fetch_add(&next_session, 1)) < n_sessions)
+	{
+		play_session(&sessions[i]);
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	uint32_t sessions_per_pair = 16, seed = 1;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double edge_sum[STRATEGY_COUNT] = {0};
+	pthread_t *tid;
+	uint32_t k = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "r:s:t:S:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': rounds_per_session = strtoul(optarg, NULL, 0); break;
+			case 's': sessions_per_pair = strtoul(optarg, NULL, 0); break;
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			case 'S': seed = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-r rounds_per_session] [-s sessions_per_pair] [-t threads] [-S seed]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(threads < 1 || sessions_per_pair < 2 || rounds_per_session < 1)
+	{
+		fprintf(stderr, "Need at least 1 thread, 2 sessions per pair and 1 round per session\n");
+		return 1;
+	}
+
+	n_sessions = STRATEGY_COUNT * (STRATEGY_COUNT + 1) / 2 * sessions_per_pair;
+	sessions = calloc(n_sessions, sizeof(Session_t));
+	tid = calloc(threads, sizeof(pthread_t));
+
+	if(sessions == NULL || tid == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for(uint8_t a = 0; a < STRATEGY_COUNT; a++)		// Every pair, including each strategy against itself
+	{
+		for(uint8_t b = a; b < STRATEGY_COUNT; b++)
+		{
+			for(uint32_t i = 0; i < sessions_per_pair; i++, k++)
+			{
+				sessions[k].a = a;
+				sessions[k].b = b;
+				sessions[k].seed = seed + k * 0x9E3779B9u;
+				if(sessions[k].seed == 0)
+				{
+					sessions[k].seed = 1;
+				}
+			}
+		}
+	}
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_create(&tid[t], NULL, worker, NULL);
+	}
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_join(tid[t], NULL);
+	}
+
+	printf("%u sessions x %u rounds per pair, %ld threads\n\n", sessions_per_pair, rounds_per_session, threads);
+	printf("%-10s %-10s %7s %7s %7s %9s %9s\n", "A", "B", "win%", "loss%", "tie%", "edge", "+/-95%");
+
+	for(k = 0; k < n_sessions; k += sessions_per_pair)
+	{
+		uint64_t w = 0, l = 0, t = 0;
+		double mean = 0, var = 0, e, ci, n;
+		uint8_t a = sessions[k].a, b = sessions[k].b;
+
+		for(uint32_t i = 0; i < sessions_per_pair; i++)
+		{
+			w += sessions[k+i].wins;
+			l += sessions[k+i].losses;
+			t += sessions[k+i].ties;
+			mean += ((double)sessions[k+i].wins - (double)sessions[k+i].losses) / rounds_per_session;
+		}
+
+		mean /= sessions_per_pair;
+
+		for(uint32_t i = 0; i < sessions_per_pair; i++)
+		{
+			e = ((double)sessions[k+i].wins - (double)sessions[k+i].losses) / rounds_per_session - mean;
+			var += e * e;
+		}
+
+		var /= (sessions_per_pair - 1);
+		ci = 1.96 * sqrt(var / sessions_per_pair);
+		n = (double)(w + l + t);
+
+		printf("%-10s %-10s %7.2f %7.2f %7.2f %+9.4f %9.4f\n", Strategy_Name(a), Strategy_Name(b), \
+			   100.0 * w / n, 100.0 * l / n, 100.0 * t / n, mean, ci);
+
+		if(a != b)
+		{
+			edge_sum[a] += mean;
+			edge_sum[b] -= mean;
+		}
+	}
+
+	printf("\nMean edge against the other strategies\n");
+
+	for(uint8_t a = 0; a < STRATEGY_COUNT; a++)
+	{
+		printf("%-10s %+9.4f\n", Strategy_Name(a), edge_sum[a] / (STRATEGY_COUNT - 1));
+	}
+
+	free(sessions);
+	free(tid);
+
+	return 0;
+}
@@ -0,0 +1,2217 @@
+/**
+  ******************************************************************************
+  * @file    board_sim.c
+  * @author  Moe2Code
+  * @brief   Discrete-event simulation of both boards in virtual time. Each board runs its
+  *          own firmware, built for the host on sim_hal.c (sim_disc.so, sim_nucleo.so and
+  *          their dual-bus variants, see the Makefile), in memory this program maps at the
+  *          register addresses. The following is conducted in source file:
+  *          + Event queue of the wires and the buses, merged in time order with the events
+  *            of the boards (timers, UART lines, waits)
+  *          + Wires: Nucleo's button (PC13) and light sensor (PC4), Disc's button (PA0),
+  *            Nucleo PC5 driving Disc PA0 to wake it up
+  *          + Two virtual CAN buses, CAN1 and CAN2 of both boards: arbitration, bit exact
+  *            frame lengths (can_bits.c), ACK, error counters, bus-off and its recovery,
+  *            filter banks and Rx FIFOs
+  *          + Standby: Nucleo wakes up on its reset line, Disc on a rising edge of PA0
+  *          + Days of play: the game is started in the morning, stats are asked for every
+  *            two hours, the light goes at night and Nucleo is reset the next morning
+  *          + Background traffic on bus 0 from a third node: Poisson arrivals of 8 byte
+  *            frames that outrank the game frames, at a share of the bus over a window
+  *          + Time-triggered CAN: SOF of the results and hands against their windows of the
+  *            schedule (tt_sched.c) the reference frames carry, period of the references
+  *          + Spectator: a third board on bus 0, Nucleo built with SPECTATOR, in CAN silent
+  *            mode. Its UART lines stay out of the digest, so a run with it must give the
+  *            digest of the run without it
+  *          Usage: ./board_sim [-d days] [-m off|mirror|share] [-f bus:from_s:to_s]
+  *                             [-l percent:from_s:to_s] [-i ms] [-a] [-t] [-s] [-v]
+  *                 ./board_sim check
+  *          -f disturbs a bus (0 or 1) over a time window: every frame then ends in an
+  *          error frame. -l loads bus 0 with background traffic over a window. -i fixes
+  *          Nucleo's TIM6 period: a hand every ms milliseconds (not with -a or -t). -a runs
+  *          Nucleo with ROUND_RATE_CTL (sim_nucleo_rate.so, single bus only). -t runs both
+  *          boards with TT_CAN (sim_disc_tt.so, sim_nucleo_tt.so, single bus only). -s adds
+  *          the spectator (sim_nucleo_spec.so, single bus only). -v prints the UART lines of
+  *          the boards and the frames.
+  *          check: a day and the next morning (rounds played, no result lost, both boards
+  *          asleep at night and awake again), the same hours twice (same digest), mirror
+  *          mode through 5 minutes of a dead bus 0, share mode on both buses, the round
+  *          rate controller with a free bus and under 70 % background load against the
+  *          fastest fixed interval within its target under the same load, time-triggered
+  *          CAN through a stats request, the spectator over the same hour as without it
+  * @note    Boards compute in no time (see sim_hal.c), so a run is exact and repeatable: the
+  *          digest covers every frame, UART line and LED change with its time in ns
+  */
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "board_sim.h"
+#include "tt_sched.h"
+
+
+// Defines
+#define DISC				0
+#define NUCLEO				1
+#define SPECTATOR			2			// Loaded with -s only
+#define BOARDS				3
+#define BUSES				2
+#define DAY					(86400ULL * SIM_S)
+#define HOUR				(3600ULL * SIM_S)
+
+// Wiring
+#define PORT_A				0
+#define PORT_C				2
+#define PORT_D				3
+#define PIN_DISC_WKUP		0x0001		// Disc PA0: user button and WKUP pin
+#define PIN_NUCLEO_LIGHT	0x0010		// Nucleo PC4: high when dark
+#define PIN_NUCLEO_WAKE		0x0020		// Nucleo PC5: drives Disc PA0
+#define PIN_NUCLEO_BUTTON	0x2000		// Nucleo PC13: low while pressed
+#define PIN_DISC_LEDS		0xF000		// Disc PD12 to PD15
+
+// Registers the simulation reads from a board's Sim_Io_t
+#define PWR_CSR_WUF			0x00000001U
+#define PWR_CSR_BRE			0x00000200U
+#define PWR_CSR_EWUP		0x00000100U
+#define CAN_IER_EWGIE		0x00000100U
+#define CAN_IER_EPVIE		0x00000200U
+#define CAN_IER_BOFIE		0x00000400U
+#define CAN_IER_LECIE		0x00000800U
+#define CAN_TSR_RQCP		0x1U
+#define CAN_TSR_TXOK		0x2U
+#define CAN_TSR_ALST		0x4U
+#define CAN_TSR_TERR		0x8U
+#define CAN_LEC_STUFF		1
+#define CAN_LEC_ACK			3
+#define CAN_LEC_BIT_DOMINANT	5
+
+#define FAULT_BIT			20			// Bit of a frame a disturbed bus destroys
+#define UART_LINE_MAX			256
+#define HUNG_TICKS			2			// Watchdog ticks (s of wall time) without progress
+
+// Board state
+#define BOARD_OFF			0			// Not powered yet
+#define BOARD_RUN			1
+#define BOARD_STANDBY		2
+#define BOARD_HUNG			3
+
+// Events of the queue
+#define EV_BOOT				0			// Reset of a board: a = board, c = boot flags
+#define EV_STANDBY			1			// A board entered Standby: outputs released, controllers off
+#define EV_PINS				2			// Outputs of a board changed: a = board, b = port, c = levels
+#define EV_KICK				3			// A bus may start a frame: a = bus
+#define EV_FRAME_END		4			// a = bus, id = frame
+#define EV_RECOVER			5			// End of a bus-off recovery: a = board, b = controller
+#define EV_ACT				6			// Scenario: a = ACT_xxx
+#define EV_BACKGROUND		7			// A background frame is queued on bus 0
+
+// Scenario actions
+#define ACT_NUCLEO_PRESS	0
+#define ACT_NUCLEO_RELEASE	1
+#define ACT_DISC_PRESS		2
+#define ACT_DISC_RELEASE	3
+#define ACT_DARK			4
+#define ACT_LIGHT			5
+#define ACT_NUCLEO_RESET	6
+
+// Frames the report looks at
+#define ID_HAND				0x49F
+#define ID_RESULT			0x111
+#define ID_BACKGROUND		0x080		// Outranks every game frame
+#define BG_BIT_NS			2000		// Background node at 500 kbit/s, as both boards
+#define LAT_BINS			1000		// Hand to result histogram: 0.1 ms bins, the last one open
+#define RTT_TARGET			(15 * SIM_MS)	// RATE_RTT_TARGET_MS of Nucleo's rate controller
+
+
+// Typedefs
+typedef struct
+{
+	uint64_t t;
+	uint64_t seq;				// Order of push: events at the same time run in that order
+	uint64_t id;
+	uint32_t epoch;				// Board epoch the event belongs to
+	uint16_t c;
+	uint8_t type, a, b;
+} Event_t;
+
+typedef struct
+{
+	const char *name;
+	const char *lib;
+	char path[PATH_MAX];
+	void *dl;
+	const Sim_Board_t *api;
+	Sim_Io_t io;
+	int fd[2];					// Peripheral and core windows
+	uint8_t state;				// BOARD_xxx
+	uint8_t powered;			// Until its Standby event: pins driven, controllers on the bus
+	uint32_t epoch;				// Bumped at every reset and Standby
+	uint64_t run_until;
+	uint64_t mb_seq[BUSES][3];	// Tx request last seen in each mailbox, and when
+	uint64_t mb_at[BUSES][3];
+	uint8_t can_mode[BUSES];	// Controller mode last seen, and since when
+	uint64_t can_at[BUSES];
+	uint64_t hold[BUSES];		// Suspend transmission of an error-passive transmitter
+	uint16_t driven[SIM_PORTS];	// Output levels as applied by the queue
+	uint16_t idr[SIM_PORTS];
+	char line[UART_LINE_MAX];
+	uint16_t line_len;
+	// Report
+	uint32_t boots, wakes, standbys, lines;
+	uint64_t awake_ns, up_at;
+	uint64_t progress_seen;
+} Board_t;
+
+typedef struct
+{
+	uint8_t busy;
+	uint64_t idle_at;			// End of the intermission after the last frame
+	uint64_t frame;				// Frame id of the one on the wire
+	Board_t *tx;
+	uint32_t tx_epoch;
+	uint8_t tx_mb;
+	uint8_t outcome;			// Error code (CAN_LEC_xxx) it ends with, 0 if it goes through
+	Can_Bits_Frame_t f;
+	uint64_t start, end, bit_ns;
+	// Report
+	uint64_t frames, errors, lost_arbitration, busy_ns;
+} Bus_t;
+
+typedef struct
+{
+	double days;
+	const char *mode;			// Board library suffix: "", "_mirror" or "_share"
+	int fault_bus;
+	uint64_t fault_from, fault_to;
+	double bg_load;				// Share of bus 0 the background node asks for, 0 for none
+	uint64_t bg_from, bg_to;
+	uint8_t rate_ctl;			// Nucleo built with ROUND_RATE_CTL
+	uint32_t interval_ms;		// Nonzero: Nucleo's TIM6 forced to that period, a hand every interval_ms
+	uint8_t tt;					// Both boards built with TT_CAN
+	uint8_t spectator;			// Third board in CAN silent mode on bus 0
+	uint8_t verbose;
+} Config_t;
+
+// Third node on bus 0. Its frames queue up and go one after the other
+typedef struct
+{
+	uint32_t pending;
+	uint64_t rng;
+	Can_Bits_Frame_t f;			// Head of the queue
+	uint64_t queued, sent;
+} Background_t;
+
+typedef struct
+{
+	uint64_t rounds, lost, results[5];
+	uint64_t lat_min, lat_max, lat_sum;
+	uint64_t lat_hist[LAT_BINS];
+	uint64_t rounds_in_fault;
+	uint64_t rounds_bg[3];		// Before, during and after the background window
+	uint64_t hands_bg;			// Hands during the background window, and the latency of their result:
+	uint64_t lat_hist_bg[LAT_BINS];	// last bin if none came before the next hand
+	uint64_t digest;
+	uint8_t round_open;
+	uint64_t hand_t;
+	// Time-triggered CAN, offsets from the SOF of the reference in ns
+	Tt_Sched_t tt;				// Schedule the last reference carried
+	uint64_t tt_ref;			// SOF of the last reference, SIM_NEVER before the first
+	uint64_t tt_refs, tt_gaps;	// References, and cycles without one
+	int64_t tt_period_min, tt_period_max;
+	uint64_t tt_result_min, tt_result_max, tt_hand_min, tt_hand_max;
+	uint64_t tt_outside;		// Results and hands not wholly within their window
+	uint64_t tt_intrusions;		// Other frames within the referee or a hand window
+	// Spectator, from its last totals
+	uint64_t spec_reports;
+	uint64_t spec_frames, spec_rounds, spec_lat_avg, spec_lat_max;	// us
+	uint64_t spec_anomalies;
+	uint64_t spec_frames_seen, spec_rounds_seen;	// Frames and rounds of the buses when its totals came out
+	char spec_line[UART_LINE_MAX];				// Its last ANOMALIES line
+} Report_t;
+
+
+// Function prototypes
+static void host_uart_tx(Sim_Io_t *io, uint64_t t, const uint8_t *data, uint16_t len, uint64_t char_ps);
+static void host_pin_out(Sim_Io_t *io, uint64_t t, uint8_t port, uint16_t pins, uint16_t levels);
+static void host_can_kick(Sim_Io_t *io, uint64_t t, uint8_t ctrl);
+
+
+// Global variables
+static const Sim_Host_t host = {host_uart_tx, host_pin_out, host_can_kick};
+static const uintptr_t window_base[2] = {SIM_PERIPH_BASE, SIM_CORE_BASE};
+static const size_t window_size[2] = {SIM_PERIPH_SIZE, SIM_CORE_SIZE};
+static Board_t boards[BOARDS];
+static Board_t *mapped;
+static Bus_t buses[BUSES];
+static Event_t *queue;
+static size_t queue_len, queue_cap;
+static uint64_t queue_seq;
+static uint64_t now;
+static Config_t cfg;
+static Report_t rep;
+static Background_t bg;
+static uint8_t disc_button, nucleo_button, dark;
+static Board_t *volatile running;
+static volatile uint64_t steps;
+
+
+/**************************** Event queue ****************************/
+
+static int ev_before(const Event_t *x, const Event_t *y)
+{
+	return (x->t != y->t) ? (x->t < y->t) : (x->seq < y->seq);
+}
+
+
+/**
+  * @brief  Adds an event to the queue (binary heap on time, then order of push)
+  * @param  t virtual time
+  * @param  type EV_xxx
+  * @param  a, b, c arguments of the event
+  * @param  id frame id (EV_FRAME_END) or 0
+  * @param  epoch board epoch, for the events of a board
+  * @retval None
+  */
+
+static void ev_push(uint64_t t, uint8_t type, uint8_t a, uint8_t b, uint16_t c, uint64_t id, uint32_t epoch)
+{
+	Event_t e = {t, queue_seq++, id, epoch, c, type, a, b};
+	size_t i;
+
+	if(queue_len == queue_cap)
+	{
+		queue_cap = (queue_cap) ? 2 * queue_cap : 1024;
+		queue = realloc(queue, queue_cap * sizeof(Event_t));
+
+		if(queue == NULL)
+		{
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	for(i = queue_len++; i > 0 && ev_before(&e, &queue[(i - 1) / 2]); i = (i - 1) / 2)
+	{
+		queue[i] = queue[(i - 1) / 2];
+	}
+
+	queue[i] = e;
+}
+
+
+static Event_t ev_pop(void)
+{
+	Event_t top = queue[0], last = queue[--queue_len];
+	size_t i = 0;
+
+	while(2 * i + 1 < queue_len)
+	{
+		size_t c = 2 * i + 1;
+
+		if(c + 1 < queue_len && ev_before(&queue[c + 1], &queue[c]))
+		{
+			c++;
+		}
+
+		if(!ev_before(&queue[c], &last))
+		{
+			break;
+		}
+
+		queue[i] = queue[c];
+		i = c;
+	}
+
+	queue[i] = last;
+
+	return top;
+}
+
+
+/**************************** Report ****************************/
+
+static void digest(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		rep.digest = (rep.digest ^ p[i]) * 0x100000001B3ULL;		// FNV-1a
+	}
+}
+
+
+static void digest_time(uint64_t t)
+{
+	digest(&t, sizeof(t));
+}
+
+
+/**
+  * @brief  Follows the rounds on the buses: a hand opens one, the result closes it. The
+  * 		copy a mirrored bus carries is not counted twice
+  */
+
+static void round_frame(const Can_Bits_Frame_t *f, uint64_t t)
+{
+	if(f->rtr || f->ext)
+	{
+		return;
+	}
+
+	if(f->id == ID_HAND && t >= cfg.bg_from && t < cfg.bg_to && (!rep.round_open || t - rep.hand_t > SIM_MS))
+	{
+		rep.hands_bg++;			// Not the copy of the open one on the other bus
+
+		if(rep.round_open)		// Its result is lost to Nucleo (RATE_RTT_LOST)
+		{
+			rep.lat_hist_bg[LAT_BINS - 1]++;
+		}
+	}
+
+	if(f->id == ID_HAND && (!rep.round_open || t - rep.hand_t > SIM_S))
+	{
+		rep.lost += rep.round_open;
+		rep.round_open = 1;
+		rep.hand_t = t;
+	}else if(f->id == ID_RESULT && rep.round_open)
+	{
+		uint64_t lat = t - rep.hand_t;
+
+		rep.round_open = 0;
+		rep.rounds++;
+		rep.results[(f->data[0] <= 4) ? f->data[0] : 0]++;
+		rep.lat_sum += lat;
+		rep.lat_min = (lat < rep.lat_min) ? lat : rep.lat_min;
+		rep.lat_max = (lat > rep.lat_max) ? lat : rep.lat_max;
+		rep.lat_hist[(lat / 100000 < LAT_BINS) ? lat / 100000 : LAT_BINS - 1]++;
+		rep.rounds_in_fault += (t >= cfg.fault_from && t < cfg.fault_to);
+		rep.rounds_bg[(t >= cfg.bg_from) + (t >= cfg.bg_to)]++;
+
+		if(rep.hand_t >= cfg.bg_from && rep.hand_t < cfg.bg_to)
+		{
+			rep.lat_hist_bg[(lat / 100000 < LAT_BINS) ? lat / 100000 : LAT_BINS - 1]++;
+		}
+	}
+}
+
+
+/**
+  * @brief  Follows the basic cycles of time-triggered CAN: the reference sets the schedule
+  * 		and the time base, results and hands must start and end within their window
+  */
+
+static void tt_frame(const Can_Bits_Frame_t *f, uint64_t start, uint64_t end, uint32_t bit_ns)
+{
+	const Tt_Window_t *w = NULL;
+	uint64_t off = start - rep.tt_ref;
+
+	if(f->ext || f->rtr)
+	{
+		return;
+	}
+
+	if(f->id == TT_REF_ID && f->dlc >= TT_REF_DLC)
+	{
+		if(f->data[2] * 1000U != rep.tt.cycle_us || f->data[3] != rep.tt.players)
+		{
+			Tt_Build(&rep.tt, f->data[3], bit_ns, f->data[2] * 1000U);
+			rep.tt_ref = SIM_NEVER;
+		}
+
+		if(rep.tt_ref != SIM_NEVER && rep.tt.cycle_us > 0)
+		{
+			int64_t cycle = rep.tt.cycle_us * 1000LL;
+			int64_t period = (int64_t)(start - rep.tt_ref) - cycle;
+
+			if(period < cycle / 2)
+			{
+				rep.tt_period_min = (period < rep.tt_period_min) ? period : rep.tt_period_min;
+				rep.tt_period_max = (period > rep.tt_period_max) ? period : rep.tt_period_max;
+			}else
+			{
+				rep.tt_gaps += (period + cycle / 2) / cycle;
+			}
+		}
+
+		rep.tt_refs++;
+		rep.tt_ref = start;
+
+		return;
+	}
+
+	if(rep.tt_ref == SIM_NEVER || rep.tt.cycle_us == 0 || off >= rep.tt.cycle_us * 1000ULL)
+	{
+		return;
+	}
+
+	if(f->id == ID_RESULT)
+	{
+		w = Tt_Window(&rep.tt, TT_WIN_REF, 0);
+		rep.tt_result_min = (off < rep.tt_result_min) ? off : rep.tt_result_min;
+		rep.tt_result_max = (off > rep.tt_result_max) ? off : rep.tt_result_max;
+	}else if(f->id == ID_HAND)
+	{
+		w = Tt_Window(&rep.tt, TT_WIN_HAND, 0);
+		rep.tt_hand_min = (off < rep.tt_hand_min) ? off : rep.tt_hand_min;
+		rep.tt_hand_max = (off > rep.tt_hand_max) ? off : rep.tt_hand_max;
+	}else
+	{
+		rep.tt_intrusions += (off < Tt_Window(&rep.tt, TT_WIN_FREE, 0)->start_us * 1000ULL);
+
+		return;
+	}
+
+	rep.tt_outside += (w == NULL || off < w->start_us * 1000ULL || end - rep.tt_ref > (w->start_us + w->len_us) * 1000ULL);
+}
+
+
+/**************************** Boards ****************************/
+
+/**
+  * @brief  Maps a board's register memory at the register addresses. Only done when the
+  * 		board that runs changes
+  */
+
+static void board_map(Board_t *b)
+{
+	if(mapped == b)
+	{
+		return;
+	}
+
+	for(uint8_t w = 0; w < 2; w++)
+	{
+		if(mmap((void *)window_base[w], window_size[w], PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, b->fd[w], 0) == MAP_FAILED)
+		{
+			perror("mmap");
+			exit(1);
+		}
+	}
+
+	mapped = b;
+}
+
+
+/**
+  * @brief  Opens the board library afresh: its data and bss as after the startup code
+  * @param  b the board
+  * @retval 0 on success, -1 otherwise
+  */
+
+static int board_open(Board_t *b)
+{
+	if(b->dl != NULL)
+	{
+		dlclose(b->dl);
+	}
+
+	b->dl = dlopen(b->path, RTLD_NOW | RTLD_LOCAL);
+	b->api = (b->dl != NULL) ? dlsym(b->dl, SIM_BOARD_SYMBOL) : NULL;
+
+	if(b->api == NULL || b->api->version != SIM_API_VERSION)
+	{
+		fprintf(stderr, "board_sim: %s: %s (make builds the board libraries)\n", b->path, (b->dl == NULL) ? dlerror() : "not a board library");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Loads a board library and gives it its register memory
+  * @param  b the board
+  * @param  dir directory of the libraries
+  * @retval 0 on success, -1 otherwise
+  */
+
+static int board_load(Board_t *b, const char *dir)
+{
+	snprintf(b->path, sizeof(b->path), "%s/%s%s.so", dir, b->lib, cfg.mode);
+
+	if(board_open(b) != 0)
+	{
+		return -1;
+	}
+
+	for(uint8_t w = 0; w < 2; w++)
+	{
+		b->fd[w] = memfd_create(b->name, 0);
+
+		if(b->fd[w] < 0 || ftruncate(b->fd[w], window_size[w]) != 0)
+		{
+			perror("memfd_create");
+
+			return -1;
+		}
+	}
+
+	b->io.index = b - boards;		// Unique device ID of the board (sim_hal.c)
+	b->io.host = &host;
+	b->io.user = b;
+	b->io.irq_at = SIM_NEVER;
+	b->io.next = SIM_NEVER;
+	b->io.tim6_arr = (b == &boards[NUCLEO] && cfg.interval_ms) ? cfg.interval_ms * 10 - 1 : 0;	// TIM6 counts at 10 kHz
+
+	return 0;
+}
+
+
+/**
+  * @brief  Tells a board that something it can see changed at t
+  */
+
+static void board_poke(Board_t *b, uint64_t t)
+{
+	Sim_Io_t *io = &b->io;
+
+	if(b->state != BOARD_RUN)
+	{
+		return;
+	}
+
+	io->irq_at = (t < io->irq_at) ? t : io->irq_at;
+	t = (t < io->now) ? io->now : t;
+	io->next = (t < io->next) ? t : io->next;
+}
+
+
+/**
+  * @brief  Applies the wires at t: input levels of both boards, EXTI edges, Disc's wakeup
+  * 		pin in Standby
+  */
+
+static void pins_update(uint64_t t)
+{
+	Board_t *nucleo = &boards[NUCLEO];
+	uint16_t in[BOARDS][SIM_PORTS];
+
+	memset(in, 0, sizeof(in));
+
+	if(disc_button || (nucleo->powered && (nucleo->driven[PORT_C] & PIN_NUCLEO_WAKE)))
+	{
+		in[DISC][PORT_A] |= PIN_DISC_WKUP;
+	}
+
+	in[NUCLEO][PORT_C] |= (nucleo_button) ? 0 : PIN_NUCLEO_BUTTON;
+	in[NUCLEO][PORT_C] |= (dark) ? PIN_NUCLEO_LIGHT : 0;
+	in[SPECTATOR][PORT_C] |= PIN_NUCLEO_BUTTON;			// Its button left alone, in the light
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		Board_t *b = &boards[i];
+		uint8_t changed = 0;
+
+		for(uint8_t p = 0; p < SIM_PORTS; p++)
+		{
+			uint16_t rise = in[i][p] & ~b->idr[p], fall = b->idr[p] & ~in[i][p];
+
+			if(!(rise | fall))
+			{
+				continue;
+			}
+
+			changed = 1;
+
+			for(uint8_t line = 0; b->state == BOARD_RUN && line < 16; line++)
+			{
+				uint16_t bit = 1U << line;
+
+				if(b->io.exti_port[line] == p && (((rise & bit) && (b->io.exti_rtsr & bit)) || ((fall & bit) && (b->io.exti_ftsr & bit))))
+				{
+					b->io.exti_pr |= bit;
+				}
+			}
+
+			if(i == DISC && p == PORT_A && (rise & PIN_DISC_WKUP) && b->state == BOARD_STANDBY && (b->io.pwr_csr & PWR_CSR_EWUP))
+			{
+				b->io.pwr_csr |= PWR_CSR_WUF;		// Rising edge on WKUP: out of Standby
+				ev_push(t, EV_BOOT, DISC, 0, 0, 0, b->epoch);
+			}
+
+			b->idr[p] = in[i][p];
+			b->io.idr[p] = in[i][p];
+		}
+
+		if(changed)
+		{
+			board_poke(b, t);
+		}
+	}
+}
+
+
+/**
+  * @brief  Resets a board: main() starts at t
+  * @param  b the board
+  * @param  t virtual time
+  * @param  flags SIM_BOOT_xxx
+  * @retval None
+  */
+
+static void board_boot(Board_t *b, uint64_t t, uint32_t flags)
+{
+	if(b->state == BOARD_STANDBY)
+	{
+		b->wakes++;
+	}
+
+	if(b->state != BOARD_RUN)
+	{
+		b->up_at = t;
+	}
+
+	if(b->boots > 0 && board_open(b) != 0)		// RAM is lost through a reset
+	{
+		exit(1);
+	}
+
+	board_map(b);
+	b->api->boot(&b->io, t, flags);
+	b->state = BOARD_RUN;
+	b->powered = 1;
+	b->epoch++;
+	b->boots++;
+	b->line_len = 0;
+	memset(b->mb_seq, 0, sizeof(b->mb_seq));
+	memset(b->can_mode, 0, sizeof(b->can_mode));
+	memset(b->hold, 0, sizeof(b->hold));
+	memset(b->driven, 0, sizeof(b->driven));
+	pins_update(t);
+}
+
+
+static void bus_kick(uint8_t bus, uint64_t t);
+static void bus_cut(Board_t *b, uint64_t t);
+static void bg_frame(void);
+
+
+/**
+  * @brief  The board stops at t (Standby or reset): its pins are released and its
+  * 		controllers leave the buses, cutting the frame it may have on the wire
+  */
+
+static void board_release(Board_t *b, uint64_t t)
+{
+	b->powered = 0;
+	b->epoch++;
+	memset(b->driven, 0, sizeof(b->driven));
+	bus_cut(b, t);
+
+	for(uint8_t c = 0; c < BUSES; c++)
+	{
+		memset(b->io.can[c].mb, 0, sizeof(b->io.can[c].mb));
+		b->io.can[c].mode = SIM_CAN_SLEEP;
+	}
+
+	pins_update(t);
+}
+
+
+/**
+  * @brief  Standby reached. A wakeup event already pending wakes the board up at once
+  */
+
+static void board_standby(Board_t *b, uint64_t t)
+{
+	b->standbys++;
+	b->awake_ns += t - b->up_at;
+	board_release(b, t);
+	digest_time(t);
+	digest(b->name, strlen(b->name));
+
+	if(b->io.pwr_csr & PWR_CSR_WUF)
+	{
+		ev_push(t, EV_BOOT, b - boards, 0, 0, 0, b->epoch);
+	}
+}
+
+
+/**************************** Host side of a board ****************************/
+
+static void host_yield(Board_t *b, uint64_t t)
+{
+	if(t < b->run_until)
+	{
+		b->io.yield = 1;
+	}
+}
+
+
+/**
+  * @brief  Takes the totals out of the spectator's lines, with the frames and rounds the
+  * 		buses carried when they came out
+  */
+
+static void spec_line(const char *line)
+{
+	unsigned long a, b, c, d, e;
+
+	if(sscanf(line, "SPEC %*u.%*u STATS frames %lu, rounds %lu", &a, &b) == 2)
+	{
+		rep.spec_reports++;
+		rep.spec_frames = a;
+		rep.spec_rounds = b;
+		rep.spec_frames_seen = buses[0].frames;
+		rep.spec_rounds_seen = rep.rounds;
+	}else if(sscanf(line, "SPEC %*u.%*u LATENCY min %*u avg %lu p50 %*u p99 %*u max %lu", &a, &b) == 2)
+	{
+		rep.spec_lat_avg = a;
+		rep.spec_lat_max = b;
+	}else if(sscanf(line, "SPEC %*u.%*u ANOMALIES lost %lu orphan %lu bad %lu slow %lu unanswered %lu", &a, &b, &c, &d, &e) == 5)
+	{
+		const char *p = strstr(line, "ANOMALIES");
+		unsigned long n;
+		int used;
+
+		rep.spec_anomalies = 0;
+
+		for(p = strchr(p, ' '); p != NULL && sscanf(p, " %*s %lu%n", &n, &used) == 1; p += used)
+		{
+			rep.spec_anomalies += n;
+		}
+
+		snprintf(rep.spec_line, sizeof(rep.spec_line), "%s", line);
+	}
+}
+
+
+/**
+  * @brief  Collects the bytes of a USART Tx line into text lines, timed by their last byte.
+  * 		The spectator's lines are read, not digested
+  */
+
+static void host_uart_tx(Sim_Io_t *io, uint64_t t, const uint8_t *data, uint16_t len, uint64_t char_ps)
+{
+	Board_t *b = io->user;
+
+	for(uint16_t i = 0; i < len; i++)
+	{
+		uint64_t end = t + (i + 1) * char_ps / 1000;
+
+		if(data[i] == '\n' || b->line_len == UART_LINE_MAX - 1)
+		{
+			while(b->line_len > 0 && b->line[b->line_len - 1] == '\r')
+			{
+				b->line_len--;
+			}
+
+			b->line[b->line_len] = '\0';
+			b->lines++;
+
+			if(b == &boards[SPECTATOR])
+			{
+				spec_line(b->line);
+			}else
+			{
+				digest_time(end);
+				digest(b->line, b->line_len);
+			}
+
+			if(cfg.verbose)
+			{
+				printf("%14.6f %-6s %s\n", end / 1e9, b->name, b->line);
+			}
+
+			b->line_len = 0;
+		}else
+		{
+			b->line[b->line_len++] = (char)data[i];
+		}
+	}
+}
+
+
+static void host_pin_out(Sim_Io_t *io, uint64_t t, uint8_t port, uint16_t pins, uint16_t levels)
+{
+	Board_t *b = io->user;
+
+	(void)pins;
+
+	if(b == &boards[DISC] && port == PORT_D)		// LEDs: part of the digest only
+	{
+		uint16_t leds = levels & PIN_DISC_LEDS;
+
+		digest_time(t);
+		digest(&leds, sizeof(leds));
+
+		return;
+	}
+
+	ev_push(t, EV_PINS, b - boards, port, levels, 0, b->epoch);
+	host_yield(b, t);
+}
+
+
+/**
+  * @brief  A controller got a Tx request or changed mode: noted with the time the board
+  * 		did it, since the board may be ahead of the buses
+  */
+
+static void host_can_kick(Sim_Io_t *io, uint64_t t, uint8_t ctrl)
+{
+	Board_t *b = io->user;
+	Sim_Can_t *c = &io->can[ctrl];
+
+	for(uint8_t m = 0; m < 3; m++)
+	{
+		if(c->mb[m].pending && c->mb[m].seq != b->mb_seq[ctrl][m])
+		{
+			b->mb_seq[ctrl][m] = c->mb[m].seq;
+			b->mb_at[ctrl][m] = t;
+		}
+	}
+
+	if(c->mode != b->can_mode[ctrl])
+	{
+		b->can_mode[ctrl] = c->mode;
+		b->can_at[ctrl] = t;
+	}
+
+	if(c->recover_at != SIM_NEVER)
+	{
+		ev_push(c->recover_at, EV_RECOVER, b - boards, ctrl, 0, 0, b->epoch);
+	}
+
+	ev_push(t, EV_KICK, ctrl, 0, 0, 0, 0);
+	host_yield(b, t);
+}
+
+
+/**************************** bxCAN and buses ****************************/
+
+static uint8_t can_on_bus(const Board_t *b, uint8_t bus, uint64_t t)
+{
+	const Sim_Can_t *c = &b->io.can[bus];
+
+	return b->powered && c->mode == SIM_CAN_NORMAL && b->can_at[bus] <= t && !c->boff;
+}
+
+
+static uint8_t can_flags(const Sim_Can_t *c)
+{
+	uint16_t tec = (c->tec > 255) ? 255 : c->tec;
+
+	return ((tec > 95 || c->rec > 95) ? 1 : 0) | ((tec > 127 || c->rec > 127) ? 2 : 0) | ((c->boff) ? 4 : 0);
+}
+
+
+/**
+  * @brief  Error status changed: LEC, and ERRI for each flag newly set whose interrupt
+  * 		is enabled (EWG, EPV, BOF) or for the LEC. The board only needs to run for ERRI:
+  * 		it reads the counters whenever it runs next
+  */
+
+static void can_error(Board_t *b, uint8_t bus, uint8_t before, uint8_t lec, uint64_t t)
+{
+	Sim_Can_t *c = &b->io.can[bus];
+	uint8_t raised = can_flags(c) & ~before;
+
+	c->lec = lec;
+
+	if(((raised & 1) && (c->ier & CAN_IER_EWGIE)) || ((raised & 2) && (c->ier & CAN_IER_EPVIE)) \
+		|| ((raised & 4) && (c->ier & CAN_IER_BOFIE)) || (lec && (c->ier & CAN_IER_LECIE)))
+	{
+		c->erri = 1;
+		board_poke(b, t);
+	}
+}
+
+
+/**
+  * @brief  Runs a frame through the filter banks of a controller (bxCAN rules: 32-bit
+  * 		before 16-bit, list before mask, then the lowest filter number)
+  * @param  f filter banks of the board
+  * @param  bus controller
+  * @param  fr the frame
+  * @param  fifo receives the FIFO
+  * @param  fmi receives the filter match index
+  * @retval 1 if a filter accepts the frame
+  */
+
+static uint8_t can_filter(const Sim_Filters_t *f, uint8_t bus, const Can_Bits_Frame_t *fr, uint8_t *fifo, uint8_t *fmi)
+{
+	uint8_t split = (f->fmr >> 8) & 0x3F;
+	uint8_t first = (bus == 0) ? 0 : split, last = (bus == 0) ? split : 28;
+	uint32_t w32 = (fr->ext) ? ((fr->id << 3) | 4 | (fr->rtr << 1)) : ((fr->id << 21) | (fr->rtr << 1));
+	uint16_t w16 = (fr->ext) ? ((((fr->id >> 18) & 0x7FF) << 5) | (fr->rtr << 4) | 8 | ((fr->id >> 15) & 7)) : ((fr->id << 5) | (fr->rtr << 4));
+	uint8_t n[2] = {0, 0};
+	uint32_t best = UINT32_MAX;
+
+	for(uint8_t bank = first; bank < last && bank < 28; bank++)
+	{
+		uint32_t bit = 1U << bank;
+		uint8_t ff = (f->ffa1r & bit) ? 1 : 0;
+		uint8_t wide = (f->fs1r & bit) != 0, list = (f->fm1r & bit) != 0;
+		uint8_t count = (wide) ? (list ? 2 : 1) : (list ? 4 : 2);
+		uint32_t r0 = f->fr[bank][0], r1 = f->fr[bank][1];
+
+		for(uint8_t k = 0; (f->fa1r & bit) && k < count; k++)
+		{
+			uint8_t match;
+			uint32_t rank;
+
+			if(wide)
+			{
+				match = (list) ? (w32 == ((k == 0) ? r0 : r1)) : (((w32 ^ r0) & r1) == 0);
+			}else if(list)
+			{
+				uint32_t r = (k < 2) ? r0 : r1;
+
+				match = (w16 == ((k & 1) ? (r >> 16) : (r & 0xFFFF)));
+			}else
+			{
+				uint32_t r = (k == 0) ? r0 : r1;
+
+				match = (((w16 ^ r) & (r >> 16) & 0xFFFF) == 0);
+			}
+
+			rank = (((wide) ? 0U : 2U) + ((list) ? 0U : 1U)) << 8 | (uint32_t)(n[ff] + k);
+
+			if(match && rank < best)
+			{
+				best = rank;
+				*fifo = ff;
+				*fmi = n[ff] + k;
+			}
+		}
+
+		n[ff] += count;
+	}
+
+	return best != UINT32_MAX;
+}
+
+
+/**
+  * @brief  Stores a received frame in an Rx FIFO. A full FIFO drops the new frame when
+  * 		locked, or has its last one overwritten
+  */
+
+static void can_fifo_push(Sim_Can_t *c, uint8_t fifo, uint8_t fmi, const Can_Bits_Frame_t *fr, uint64_t sof)
+{
+	uint8_t i;
+
+	if(c->rx_fill[fifo] == 3)
+	{
+		c->rx_fovr[fifo] = 1;
+
+		if(c->rflm)
+		{
+			return;
+		}
+
+		i = (c->rx_head[fifo] + 2) % 3;
+	}else
+	{
+		i = (c->rx_head[fifo] + c->rx_fill[fifo]) % 3;
+
+		if(++c->rx_fill[fifo] == 3)
+		{
+			c->rx_full[fifo] = 1;
+		}
+	}
+
+	c->rx[fifo][i] = *fr;
+	c->rx_fmi[fifo][i] = fmi;
+	c->rx_time[fifo][i] = (c->ttcm) ? (uint16_t)((sof - c->ttcm_t0) / c->bit_ns) : 0;
+}
+
+
+/**
+  * @brief  Starts the next frame on an idle bus: the lowest arbitration key among the
+  * 		mailboxes of both boards (and the background node on bus 0) wins, the others
+  * 		lose arbitration
+  */
+
+static void bus_start(uint8_t n, uint64_t t)
+{
+	Bus_t *bus = &buses[n];
+	Board_t *win = NULL;
+	uint8_t win_mb = 0, ackers = 0, win_bg = 0;
+	uint32_t win_key = UINT32_MAX;
+	uint16_t stuffed, len;
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		Board_t *b = &boards[i];
+		Sim_Can_t *c = &b->io.can[n];
+		int8_t pick = -1;
+		uint32_t key = UINT32_MAX;
+
+		if(!can_on_bus(b, n, t) || c->silent || b->hold[n] > t)
+		{
+			continue;
+		}
+
+		for(uint8_t m = 0; m < 3; m++)		// Mailbox the controller puts up: oldest request or lowest key
+		{
+			const Sim_Mailbox_t *mb = &c->mb[m];
+			uint32_t k = Can_Bits_Key(&mb->frame);
+
+			if(!mb->pending || b->mb_at[n][m] > t)
+			{
+				continue;
+			}
+
+			if(pick < 0 || (c->txfp && mb->seq < c->mb[pick].seq) || (!c->txfp && k < key))
+			{
+				pick = m;
+				key = k;
+			}
+		}
+
+		if(pick < 0)
+		{
+			continue;
+		}
+
+		if(key < win_key)
+		{
+			win = b;
+			win_mb = pick;
+			win_key = key;
+		}
+	}
+
+	if(n == 0 && bg.pending > 0 && Can_Bits_Key(&bg.f) < win_key)
+	{
+		win = NULL;
+		win_bg = 1;
+	}
+
+	if(win == NULL && !win_bg)
+	{
+		return;
+	}
+
+	// Losers: retry after this frame, or give up without automatic retransmission
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		Board_t *b = &boards[i];
+		Sim_Can_t *c = &b->io.can[n];
+
+		if(b == win || !can_on_bus(b, n, t) || c->silent)
+		{
+			continue;
+		}
+
+		ackers++;
+
+		for(uint8_t m = 0; m < 3; m++)
+		{
+			if(c->mb[m].pending && b->mb_at[n][m] <= t && b->hold[n] <= t)
+			{
+				bus->lost_arbitration++;
+
+				if(c->nart)
+				{
+					c->mb[m].pending = 0;
+					c->tsr |= (CAN_TSR_RQCP | CAN_TSR_ALST) << (8 * m);
+					board_poke(b, t);
+				}
+
+				break;
+			}
+		}
+	}
+
+	bus->busy = 1;
+	bus->frame++;
+	bus->tx = win;
+	bus->start = t;
+
+	if(win_bg)
+	{
+		bus->f = bg.f;
+		bus->bit_ns = BG_BIT_NS;
+	}else
+	{
+		bus->tx_epoch = win->epoch;
+		bus->tx_mb = win_mb;
+		Sim_Can_t *c = &win->io.can[n];
+
+		bus->f = c->mb[win_mb].frame;
+		bus->bit_ns = c->bit_ns;
+		c->mb[win_mb].on_bus = 1;
+		c->mb[win_mb].time = (c->ttcm) ? (uint16_t)((t - c->ttcm_t0) / c->bit_ns) : 0;
+	}
+
+	stuffed = Can_Bits_Stuffed(&bus->f, NULL);
+	len = stuffed + CAN_BITS_TAIL;
+
+	if(n == cfg.fault_bus && t >= cfg.fault_from && t < cfg.fault_to)
+	{
+		bus->outcome = CAN_LEC_BIT_DOMINANT;
+		bus->end = t + (FAULT_BIT + CAN_BITS_ERROR_FRAME) * bus->bit_ns;
+	}else if(ackers == 0)
+	{
+		bus->outcome = CAN_LEC_ACK;			// Nobody drives the ACK slot
+		bus->end = t + (stuffed + 2 + CAN_BITS_ERROR_FRAME) * bus->bit_ns;
+	}else
+	{
+		bus->outcome = 0;
+		bus->end = t + len * bus->bit_ns;
+	}
+
+	ev_push(bus->end, EV_FRAME_END, n, 0, 0, bus->frame, 0);
+}
+
+
+/**
+  * @brief  End of the frame on a bus: receivers get it (or see the error), the
+  * 		transmitter's mailbox completes or is retried, error counters move
+  */
+
+static void bus_end(uint8_t n, uint64_t t)
+{
+	Bus_t *bus = &buses[n];
+	Board_t *tx = (bus->tx != NULL && bus->tx->epoch == bus->tx_epoch && bus->tx->powered) ? bus->tx : NULL;
+	uint8_t m = bus->tx_mb;
+
+	bus->busy = 0;
+	bus->busy_ns += t - bus->start;
+	bus->idle_at = t + CAN_BITS_IFS * bus->bit_ns;
+
+	for(uint8_t i = 0; i < BOARDS; i++)		// Receivers, silent ones included
+	{
+		Board_t *b = &boards[i];
+		Sim_Can_t *c = &b->io.can[n];
+		uint8_t fifo = 0, fmi = 0;
+		uint8_t before = can_flags(c);
+
+		if(b == bus->tx || !can_on_bus(b, n, t))
+		{
+			continue;
+		}
+
+		if(bus->outcome == CAN_LEC_ACK)
+		{
+			continue;
+		}
+
+		if(bus->outcome != 0)
+		{
+			c->rec = (c->rec < 255) ? c->rec + 1 : c->rec;
+			can_error(b, n, before, CAN_LEC_STUFF, t);
+
+			continue;
+		}
+
+		c->rec = (c->rec > 127) ? 120 : ((c->rec > 0) ? c->rec - 1 : 0);
+
+		if(can_filter(&b->io.filters, n, &bus->f, &fifo, &fmi))
+		{
+			can_fifo_push(c, fifo, fmi, &bus->f, bus->start);
+			board_poke(b, t);
+		}
+	}
+
+	if(bus->outcome == 0)
+	{
+		bus->frames++;
+		digest_time(t);
+		digest(&n, 1);
+		digest(&bus->f, sizeof(bus->f));
+		round_frame(&bus->f, t);
+
+		if(cfg.tt)
+		{
+			tt_frame(&bus->f, bus->start, t, bus->bit_ns);
+		}
+
+		if(cfg.verbose)
+		{
+			printf("%14.6f bus %u  %s %03X [%u]", t / 1e9, n, (bus->tx != NULL) ? bus->tx->name : "other", bus->f.id, bus->f.dlc);
+
+			for(uint8_t i = 0; !bus->f.rtr && i < bus->f.dlc && i < 8; i++)
+			{
+				printf(" %02X", bus->f.data[i]);
+			}
+
+			printf("%s\n", (bus->f.rtr) ? " RTR" : "");
+		}
+	}else
+	{
+		bus->errors++;
+	}
+
+	if(bus->tx == NULL && bus->outcome == 0)		// Background frame through: next one up
+	{
+		bg.sent++;
+
+		if(--bg.pending > 0)
+		{
+			bg_frame();
+		}
+	}
+
+	if(tx != NULL)
+	{
+		Sim_Can_t *c = &tx->io.can[n];
+		Sim_Mailbox_t *mb = &c->mb[m];
+		uint8_t before = can_flags(c);
+
+		mb->on_bus = 0;
+
+		if(bus->outcome == 0)
+		{
+			c->tec -= (c->tec > 0);
+			mb->pending = 0;
+			c->tsr |= (CAN_TSR_RQCP | CAN_TSR_TXOK) << (8 * m);
+		}else
+		{
+			if(!(bus->outcome == CAN_LEC_ACK && c->tec > 127))		// No ACK while error passive: TEC kept
+			{
+				c->tec += 8;
+			}
+
+			if(c->tec > 255)
+			{
+				c->boff = 1;
+
+				if(c->abom)
+				{
+					c->recover_at = t + 128ULL * 11 * c->bit_ns;
+					ev_push(c->recover_at, EV_RECOVER, tx - boards, n, 0, 0, tx->epoch);
+				}
+			}
+
+			if(c->tec > 127)
+			{
+				tx->hold[n] = bus->idle_at + CAN_BITS_SUSPEND * bus->bit_ns;
+			}
+
+			if(mb->abort)
+			{
+				mb->pending = 0;
+				c->tsr |= CAN_TSR_RQCP << (8 * m);
+			}else if(c->nart)
+			{
+				mb->pending = 0;
+				c->tsr |= (CAN_TSR_RQCP | CAN_TSR_TERR) << (8 * m);
+			}
+
+			can_error(tx, n, before, bus->outcome, t);
+		}
+
+		if(c->tsr & (CAN_TSR_RQCP << (8 * m)))
+		{
+			board_poke(tx, t);
+		}
+	}
+
+	bus_kick(n, bus->idle_at);
+}
+
+
+/**
+  * @brief  Looks for a frame to start on a bus at t, or when it is next idle
+  */
+
+static void bus_kick(uint8_t n, uint64_t t)
+{
+	Bus_t *bus = &buses[n];
+
+	if(bus->busy)
+	{
+		return;
+	}
+
+	if(t < bus->idle_at || t > now)
+	{
+		ev_push((t < bus->idle_at) ? bus->idle_at : t, EV_KICK, n, 0, 0, 0, 0);
+
+		return;
+	}
+
+	bus_start(n, t);
+}
+
+
+/**
+  * @brief  A board left the buses at t: the frame it is transmitting ends there, in an
+  * 		error frame
+  */
+
+static void bus_cut(Board_t *b, uint64_t t)
+{
+	for(uint8_t n = 0; n < BUSES; n++)
+	{
+		Bus_t *bus = &buses[n];
+
+		if(bus->busy && bus->tx == b && t < bus->end)
+		{
+			bus->frame++;
+			bus->outcome = CAN_LEC_BIT_DOMINANT;
+			bus->end = t + CAN_BITS_ERROR_FRAME * bus->bit_ns;
+			ev_push(bus->end, EV_FRAME_END, n, 0, 0, bus->frame, 0);
+		}
+	}
+}
+
+
+/**
+  * @brief  End of a bus-off recovery: the controller is error active again
+  */
+
+static void can_recover(Board_t *b, uint8_t n, uint64_t t)
+{
+	Sim_Can_t *c = &b->io.can[n];
+
+	if(!c->boff || c->recover_at > t)
+	{
+		return;
+	}
+
+	c->boff = 0;
+	c->tec = 0;
+	c->rec = 0;
+	c->recover_at = SIM_NEVER;
+	board_poke(b, t);
+	bus_kick(n, t);
+}
+
+
+/**
+  * @brief  Fills the background frame at the head of the queue: random payload, so its
+  * 		length (stuff bits) varies as real traffic does
+  */
+
+static void bg_frame(void)
+{
+	uint64_t r = bg.rng = bg.rng * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	bg.f = (Can_Bits_Frame_t){.id = ID_BACKGROUND, .dlc = 8};
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		bg.f.data[i] = (uint8_t)(r >> (8 * i)) ^ (uint8_t)(r >> 59);
+	}
+}
+
+
+/**
+  * @brief  A background frame arrives at t. The next one follows after an exponential
+  * 		gap whose mean makes the frames take cfg.bg_load of the bus
+  */
+
+static void bg_arrive(uint64_t t)
+{
+	uint64_t r;
+	double u, gap;
+
+	if(t >= cfg.bg_to)
+	{
+		return;
+	}
+
+	bg.queued++;
+
+	if(bg.pending++ == 0)
+	{
+		bg_frame();
+	}
+
+	r = bg.rng = bg.rng * 6364136223846793005ULL + 1442695040888963407ULL;
+	u = ((r >> 11) + 1) / 9007199254740993.0;		// (0, 1]
+	gap = -log(u) * (Can_Bits_Stuffed(&bg.f, NULL) + CAN_BITS_TAIL + CAN_BITS_IFS) * BG_BIT_NS / cfg.bg_load;
+	ev_push(t + (uint64_t)gap + 1, EV_BACKGROUND, 0, 0, 0, 0, 0);
+	bus_kick(0, t);
+}
+
+
+/**************************** Scenario ****************************/
+
+/**
+  * @brief  Queues the days of play: Nucleo's button a few seconds after the boards are
+  * 		up, Disc's button every two hours, dark in the evening (a few minutes later every
+  * 		day), light again at the end of the day and Nucleo's reset at the start of the next
+  */
+
+static void scenario_plan(uint64_t end)
+{
+	for(uint64_t d = 0; d * DAY < end; d++)
+	{
+		uint64_t day = d * DAY;
+		uint64_t night = day + 14 * HOUR + (d * 617 % 600) * SIM_S;
+
+		if(d == 0)
+		{
+			ev_push(0, EV_BOOT, DISC, 0, SIM_BOOT_COLD, 0, 0);
+			ev_push(0, EV_BOOT, NUCLEO, 0, SIM_BOOT_COLD, 0, 0);
+
+			if(cfg.spectator)
+			{
+				ev_push(0, EV_BOOT, SPECTATOR, 0, SIM_BOOT_COLD, 0, 0);
+			}
+		}else
+		{
+			ev_push(day - 60 * SIM_S, EV_ACT, ACT_LIGHT, 0, 0, 0, 0);
+			ev_push(day, EV_ACT, ACT_NUCLEO_RESET, 0, 0, 0, 0);
+		}
+
+		ev_push(day + 2 * SIM_S, EV_ACT, ACT_NUCLEO_PRESS, 0, 0, 0, 0);
+		ev_push(day + 2 * SIM_S + 200 * SIM_MS, EV_ACT, ACT_NUCLEO_RELEASE, 0, 0, 0, 0);
+
+		for(uint64_t h = day + HOUR; h < night; h += 2 * HOUR)
+		{
+			ev_push(h, EV_ACT, ACT_DISC_PRESS, 0, 0, 0, 0);
+			ev_push(h + 150 * SIM_MS, EV_ACT, ACT_DISC_RELEASE, 0, 0, 0, 0);
+		}
+
+		ev_push(night, EV_ACT, ACT_DARK, 0, 0, 0, 0);
+	}
+
+	if(cfg.bg_load > 0 && cfg.bg_from < end)
+	{
+		ev_push(cfg.bg_from, EV_BACKGROUND, 0, 0, 0, 0, 0);
+	}
+}
+
+
+static void scenario_act(uint8_t act, uint64_t t)
+{
+	Board_t *nucleo = &boards[NUCLEO];
+
+	switch(act)
+	{
+		case ACT_NUCLEO_PRESS:		nucleo_button = 1; break;
+		case ACT_NUCLEO_RELEASE:	nucleo_button = 0; break;
+		case ACT_DISC_PRESS:		disc_button = 1; break;
+		case ACT_DISC_RELEASE:		disc_button = 0; break;
+		case ACT_DARK:				dark = 1; break;
+		case ACT_LIGHT:				dark = 0; break;
+
+		case ACT_NUCLEO_RESET:		// NRST: out of Standby with SBF set, backup SRAM kept if the regulator was on
+			if(nucleo->powered)
+			{
+				nucleo->awake_ns += t - nucleo->up_at;
+				board_release(nucleo, t);
+			}
+
+			if(nucleo->state == BOARD_RUN || nucleo->state == BOARD_HUNG)
+			{
+				nucleo->state = BOARD_OFF;
+			}
+
+			ev_push(t, EV_BOOT, NUCLEO, 0, (nucleo->state == BOARD_STANDBY && !(nucleo->io.pwr_csr & PWR_CSR_BRE)) ? SIM_BOOT_BKPSRAM_LOST : 0, 0, nucleo->epoch);
+			break;
+	}
+
+	pins_update(t);
+}
+
+
+/**************************** Simulation loop ****************************/
+
+/**
+  * @brief  Watchdog: a board that made no progress for HUNG_TICKS seconds of wall time
+  * 		while the simulation waits on it is stuck in a loop: it is made to leave it
+  */
+
+static void watchdog(int sig)
+{
+	static uint64_t last_steps = UINT64_MAX;
+	static uint8_t ticks;
+	Board_t *b = running;
+
+	(void)sig;
+
+	if(b == NULL || steps != last_steps || b->io.progress != b->progress_seen)
+	{
+		last_steps = steps;
+		ticks = 0;
+
+		if(b != NULL)
+		{
+			b->progress_seen = b->io.progress;
+		}
+
+		return;
+	}
+
+	if(++ticks >= HUNG_TICKS)
+	{
+		ticks = 0;
+		b->api->escape();
+	}
+}
+
+
+/**
+  * @brief  Runs a board up to the horizon that keeps the events in time order: the next
+  * 		queued event, and the other board's next event (itself included if that board
+  * 		comes first at equal times)
+  */
+
+static void board_run(Board_t *b, uint64_t end)
+{
+	uint64_t until = (queue_len > 0 && queue[0].t < end) ? queue[0].t : end;
+	int r;
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		Board_t *o = &boards[i];
+		uint64_t t = o->io.next;
+
+		if(o == b || o->state != BOARD_RUN)
+		{
+			continue;
+		}
+
+		t = (o < b || t == SIM_NEVER) ? t : t + 1;
+		until = (t < until) ? t : until;
+	}
+
+	board_map(b);
+	b->run_until = until;
+	running = b;
+	r = b->api->run(until);
+	running = NULL;
+	b->run_until = 0;
+
+	if(r == SIM_STANDBY)
+	{
+		b->state = BOARD_STANDBY;
+		ev_push(b->io.now, EV_STANDBY, b - boards, 0, 0, 0, b->epoch);
+	}else if(r == SIM_HUNG)
+	{
+		b->state = BOARD_HUNG;
+		b->awake_ns += b->io.now - b->up_at;
+		fprintf(stderr, "board_sim: %s hung at %.6f s\n", b->name, b->io.now / 1e9);
+	}
+}
+
+
+static void ev_run(const Event_t *e)
+{
+	Board_t *b = &boards[e->a % BOARDS];
+
+	now = e->t;
+
+	switch(e->type)
+	{
+		case EV_BOOT:
+			if(e->epoch == b->epoch)
+			{
+				board_boot(b, e->t, e->c);
+			}
+
+			break;
+
+		case EV_STANDBY:
+			if(e->epoch == b->epoch)
+			{
+				board_standby(b, e->t);
+			}
+
+			break;
+
+		case EV_PINS:
+			if(e->epoch == b->epoch && b->powered)
+			{
+				b->driven[e->b] = e->c;
+				pins_update(e->t);
+			}
+
+			break;
+
+		case EV_KICK:
+			bus_kick(e->a, e->t);
+			break;
+
+		case EV_FRAME_END:
+			if(e->id == buses[e->a].frame && buses[e->a].busy)
+			{
+				bus_end(e->a, e->t);
+			}
+
+			break;
+
+		case EV_RECOVER:
+			if(e->epoch == b->epoch && b->powered)
+			{
+				can_recover(b, e->b, e->t);
+			}
+
+			break;
+
+		case EV_ACT:
+			scenario_act(e->a, e->t);
+			break;
+
+		case EV_BACKGROUND:
+			bg_arrive(e->t);
+			break;
+	}
+}
+
+
+/**
+  * @brief  Runs the simulation to end: queued events and board events in time order, the
+  * 		queue first at equal times, then Disc, then Nucleo
+  */
+
+static void sim_loop(uint64_t end)
+{
+	while(1)
+	{
+		Board_t *pick = NULL;
+		uint64_t t = (queue_len > 0) ? queue[0].t : SIM_NEVER;
+
+		for(uint8_t i = 0; i < BOARDS; i++)
+		{
+			if(boards[i].state == BOARD_RUN && boards[i].io.next < t)
+			{
+				pick = &boards[i];
+				t = pick->io.next;
+			}
+		}
+
+		if(t >= end)
+		{
+			break;
+		}
+
+		steps++;
+
+		if(pick != NULL)
+		{
+			board_run(pick, end);
+		}else
+		{
+			Event_t e = ev_pop();
+
+			ev_run(&e);
+		}
+	}
+
+	now = end;
+}
+
+
+/**
+  * @brief  Sets up a run: register windows, both board libraries, the scenario
+  * @param  dir directory of the board libraries
+  * @retval 0 on success
+  */
+
+static int sim_init(const char *dir)
+{
+	static uint8_t reserved;
+	Board_t defaults[BOARDS] = {{.name = "Disc", .lib = "sim_disc"}, {.name = "Nucleo", .lib = "sim_nucleo"}, {.name = "Spec", .lib = "sim_nucleo_spec"}};
+
+	if(!reserved)		// The windows must be free in this process: checked once, then kept
+	{
+		for(uint8_t w = 0; w < 2; w++)
+		{
+			if(mmap((void *)window_base[w], window_size[w], PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)window_base[w])
+			{
+				fprintf(stderr, "board_sim: register window at 0x%lX is taken\n", (unsigned long)window_base[w]);
+
+				return -1;
+			}
+		}
+
+		if(mmap((void *)SIM_BITBAND_BASE, SIM_BITBAND_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0) != (void *)SIM_BITBAND_BASE)
+		{
+			fprintf(stderr, "board_sim: bit-band window is taken\n");
+
+			return -1;
+		}
+
+		reserved = 1;
+	}
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		if(boards[i].dl != NULL)
+		{
+			dlclose(boards[i].dl);
+			close(boards[i].fd[0]);
+			close(boards[i].fd[1]);
+		}
+	}
+
+	memcpy(boards, defaults, sizeof(boards));
+	boards[NUCLEO].lib = (cfg.rate_ctl) ? "sim_nucleo_rate" : ((cfg.tt) ? "sim_nucleo_tt" : "sim_nucleo");
+	boards[DISC].lib = (cfg.tt) ? "sim_disc_tt" : "sim_disc";
+	memset(buses, 0, sizeof(buses));
+	memset(&rep, 0, sizeof(rep));
+	memset(&bg, 0, sizeof(bg));
+	bg.rng = 0x9E3779B97F4A7C15ULL;
+	rep.lat_min = UINT64_MAX;
+	rep.tt_ref = SIM_NEVER;
+	rep.tt_period_min = INT64_MAX;
+	rep.tt_period_max = INT64_MIN;
+	rep.tt_result_min = rep.tt_hand_min = UINT64_MAX;
+	rep.digest = 0xCBF29CE484222325ULL;
+	mapped = NULL;
+	queue_len = 0;
+	queue_seq = 0;
+	now = 0;
+	disc_button = nucleo_button = dark = 0;
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		if(i == SPECTATOR && !cfg.spectator)
+		{
+			continue;
+		}
+
+		if(board_load(&boards[i], dir) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Runs the configured days
+  * @param  dir directory of the board libraries
+  * @param  wall receives the wall time in s
+  * @retval 0 on success
+  */
+
+static int sim_days(const char *dir, double *wall)
+{
+	uint64_t end = (uint64_t)(cfg.days * DAY);
+	struct timespec t0, t1;
+
+	if(sim_init(dir) != 0)
+	{
+		return -1;
+	}
+
+	scenario_plan(end);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	sim_loop(end);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	*wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		if(boards[i].state == BOARD_RUN)
+		{
+			boards[i].awake_ns += end - boards[i].up_at;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Returns the hand to result latency (ns, bin top) that q of the rounds of a
+  * 		histogram stay within
+  */
+
+static uint64_t hist_quantile(const uint64_t *hist, uint64_t rounds, double q)
+{
+	uint64_t seen = 0;
+
+	for(uint16_t i = 0; i < LAT_BINS; i++)
+	{
+		seen += hist[i];
+
+		if(seen >= q * rounds)
+		{
+			return (i + 1) * 100000ULL;
+		}
+	}
+
+	return rep.lat_max;
+}
+
+
+static uint64_t lat_quantile(double q)
+{
+	return hist_quantile(rep.lat_hist, rep.rounds, q);
+}
+
+
+/**
+  * @brief  Rounds per second played before, during and after the background window
+  */
+
+static double bg_rate(uint8_t phase)
+{
+	uint64_t end = (uint64_t)(cfg.days * DAY);
+	uint64_t from = (phase == 0) ? 0 : (phase == 1) ? cfg.bg_from : cfg.bg_to;
+	uint64_t to = (phase == 0) ? cfg.bg_from : (phase == 1) ? cfg.bg_to : end;
+
+	to = (to < end) ? to : end;
+
+	return (to > from) ? rep.rounds_bg[phase] * 1e9 / (to - from) : 0;
+}
+
+
+static void report(double wall)
+{
+	static const char *state[] = {"off", "running", "in Standby", "hung"};
+	uint64_t end = (uint64_t)(cfg.days * DAY);
+
+	printf("%.2f days (%s) in %.2f s of wall time: %.0fx real time\n", cfg.days, (*cfg.mode) ? cfg.mode + 1 : "single bus", wall, end / 1e9 / wall);
+	printf("rounds %lu, results lost %lu, hand to result min %.3f avg %.3f max %.3f ms\n", rep.rounds, rep.lost, \
+			(rep.rounds) ? rep.lat_min / 1e6 : 0, (rep.rounds) ? rep.lat_sum / 1e6 / rep.rounds : 0, rep.lat_max / 1e6);
+	printf("hand to result p50 %.1f p99 %.1f ms%s\n", lat_quantile(0.5) / 1e6, lat_quantile(0.99) / 1e6, \
+			(cfg.rate_ctl) ? ", round interval set by Nucleo's rate controller" : "");
+
+	if(cfg.interval_ms)
+	{
+		printf("round interval fixed at %u ms (Nucleo's TIM6 period)\n", cfg.interval_ms);
+	}
+
+	if(cfg.bg_load > 0)
+	{
+		printf("background: %.0f %% of bus 0 from %.0f to %.0f s, frames queued %lu, sent %lu\n", 100 * cfg.bg_load, \
+				cfg.bg_from / 1e9, cfg.bg_to / 1e9, bg.queued, bg.sent);
+		printf("rounds/s before %.2f, during %.2f, after %.2f\n", bg_rate(0), bg_rate(1), bg_rate(2));
+		printf("hand to result during the background p50 %.1f p99 %.1f ms\n", hist_quantile(rep.lat_hist_bg, rep.hands_bg, 0.5) / 1e6, \
+				hist_quantile(rep.lat_hist_bg, rep.hands_bg, 0.99) / 1e6);
+	}
+
+	if(cfg.tt)
+	{
+		printf("ttcan: cycle %u ms, references %lu, cycles without one %lu, period %+.1f/%+.1f us\n", rep.tt.cycle_us / 1000, \
+				rep.tt_refs, rep.tt_gaps, (rep.tt_refs > 1) ? rep.tt_period_min / 1e3 : 0, (rep.tt_refs > 1) ? rep.tt_period_max / 1e3 : 0);
+		printf("ttcan: results at %.1f-%.1f us, hands at %.1f-%.1f us, outside their window %lu, other frames in exclusive windows %lu\n", \
+				(rep.rounds) ? rep.tt_result_min / 1e3 : 0, rep.tt_result_max / 1e3, (rep.rounds) ? rep.tt_hand_min / 1e3 : 0, \
+				rep.tt_hand_max / 1e3, rep.tt_outside, rep.tt_intrusions);
+	}
+
+	printf("results: Nucleo %lu, Disc %lu, tie %lu, error %lu\n", rep.results[1], rep.results[2], rep.results[3], rep.results[4] + rep.results[0]);
+
+	if(cfg.spectator)
+	{
+		printf("spectator: totals %lu, frames %lu of %lu, rounds %lu of %lu, hand to result avg %.3f max %.3f ms, anomalies %lu\n", \
+				rep.spec_reports, rep.spec_frames, rep.spec_frames_seen, rep.spec_rounds, rep.spec_rounds_seen, rep.spec_lat_avg / 1e3, \
+				rep.spec_lat_max / 1e3, rep.spec_anomalies);
+		printf("spectator: %s\n", rep.spec_line);
+	}
+
+	for(uint8_t i = 0; i < BOARDS; i++)
+	{
+		const Board_t *b = &boards[i];
+
+		if(b->dl == NULL)
+		{
+			continue;
+		}
+
+		printf("%-6s boots %u (%u from Standby), Standby %u, awake %.1f h, UART lines %u, interrupts %lu, %s at the end\n", b->name, \
+				b->boots, b->wakes, b->standbys, b->awake_ns / 3.6e12, b->lines, b->io.irqs, state[b->state]);
+	}
+
+	for(uint8_t n = 0; n < BUSES; n++)
+	{
+		const Bus_t *bus = &buses[n];
+
+		printf("bus %u: frames %lu, error frames %lu, arbitration lost %lu, load %.4f %%\n", n, bus->frames, bus->errors, \
+				bus->lost_arbitration, 100.0 * bus->busy_ns / end);
+	}
+
+	printf("digest %016lx\n", rep.digest);
+}
+
+
+/**************************** Check ****************************/
+
+static int check_one(const char *what, int ok)
+{
+	printf("%-60s %s\n", what, (ok) ? "ok" : "FAILED");
+
+	return ok;
+}
+
+
+/**
+  * @brief  Checks the simulation against what the boards must do
+  * @param  dir directory of the board libraries
+  * @retval 0 if every check passes
+  */
+
+static int check(const char *dir)
+{
+	static const uint32_t sweep[] = {12, 13, 14, 15, 17, 20, 25, 30, 40};	// ms, from the fastest Disc keeps up with
+	double wall, aimd_rate, fixed_rate = 0;
+	uint64_t first, aimd_p99;
+	uint32_t fixed_ms = 0;
+	int ok = 1;
+
+	// A day and the next morning on one bus
+	cfg = (Config_t){.days = 1.0 + 2.0 / 24, .mode = "", .fault_bus = -1};
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	ok &= check_one("rounds played all day, every result in", rep.rounds > 12000 && rep.lost == 0);
+	ok &= check_one("hand to result under 10 ms", rep.lat_max < 10 * SIM_MS);
+	ok &= check_one("both boards in Standby at night", boards[DISC].standbys == 1 && boards[NUCLEO].standbys == 1);
+	ok &= check_one("both boards up again in the morning", boards[DISC].wakes == 1 && boards[NUCLEO].wakes == 1 \
+					&& boards[DISC].state == BOARD_RUN && boards[NUCLEO].state == BOARD_RUN);
+	ok &= check_one("no error frame", buses[0].errors == 0);
+	ok &= check_one("random hands: wins, losses and ties a quarter of rounds each", rep.results[1] > rep.rounds / 4 \
+					&& rep.results[2] > rep.rounds / 4 && rep.results[3] > rep.rounds / 4);
+
+	// Same run, same digest
+	cfg.days = 3.0 / 24;
+	sim_days(dir, &wall);
+	first = rep.digest;
+	sim_days(dir, &wall);
+	ok &= check_one("same hours twice, same digest", rep.digest == first && rep.rounds > 2000);
+
+	// Mirror: bus 0 dead for 5 minutes
+	cfg = (Config_t){.days = 20.0 / 1440, .mode = "_mirror", .fault_bus = 0, .fault_from = 600 * SIM_S, .fault_to = 900 * SIM_S};
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	ok &= check_one("mirror: rounds go on over bus 1 while bus 0 is dead", rep.rounds_in_fault > 70 && buses[0].errors > 0);
+	ok &= check_one("mirror: bus 0 carries frames again after the fault", buses[0].frames > 150 && rep.rounds > 290);
+	ok &= check_one("mirror: no board hung", boards[DISC].state == BOARD_RUN && boards[NUCLEO].state == BOARD_RUN);
+
+	// Share: both buses in use
+	cfg = (Config_t){.days = 1.0 / 24, .mode = "_share", .fault_bus = -1};
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	ok &= check_one("share: frames on both buses, every result in", buses[0].frames > 0 && buses[1].frames > 0 && rep.lost == 0 && rep.rounds > 800);
+	ok &= check_one("share: both boards win rounds", rep.results[1] > 0 && rep.results[2] > 0);
+
+	// Round rate controller: a free bus, then 70 % of it taken by a third node for 5 minutes
+	cfg = (Config_t){.days = 15.0 / 1440, .mode = "", .fault_bus = -1, .bg_load = 0.7, .bg_from = 300 * SIM_S, .bg_to = 600 * SIM_S, .rate_ctl = 1};
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	aimd_rate = bg_rate(1);
+	aimd_p99 = hist_quantile(rep.lat_hist_bg, rep.hands_bg, 0.99);
+	ok &= check_one("rate: over 60 rounds/s on a free bus", bg_rate(0) > 60);
+	ok &= check_one("rate: hand to result p99 within 15 ms under background", aimd_p99 <= RTT_TARGET);
+	ok &= check_one("rate: back up after the background", bg_rate(2) > 0.9 * bg_rate(0));
+	ok &= check_one("rate: every result in", rep.lost == 0);
+
+	// Same background at fixed round intervals: the fastest whose p99 (a hand without its result
+	// before the next one counts as late) is within the target is what the controller must find
+	for(uint8_t i = 0; i < sizeof(sweep) / sizeof(sweep[0]) && fixed_ms == 0; i++)
+	{
+		uint64_t p99;
+
+		cfg = (Config_t){.days = 310.0 / 86400, .mode = "", .fault_bus = -1, .bg_load = 0.7, .bg_from = 10 * SIM_S, .bg_to = 310 * SIM_S, .interval_ms = sweep[i]};
+
+		if(sim_days(dir, &wall) != 0)
+		{
+			return 1;
+		}
+
+		p99 = hist_quantile(rep.lat_hist_bg, rep.hands_bg, 0.99);
+		printf("fixed %u ms under background: %.2f rounds/s, hand to result p99 %.1f ms\n", sweep[i], bg_rate(1), p99 / 1e6);
+
+		if(p99 <= RTT_TARGET && boards[NUCLEO].state == BOARD_RUN)
+		{
+			fixed_ms = sweep[i];
+			fixed_rate = bg_rate(1);
+		}
+	}
+
+	printf("rate controller under background: %.2f rounds/s, hand to result p99 %.1f ms\n", aimd_rate, aimd_p99 / 1e6);
+	ok &= check_one("rate: within 20 % of the fastest fixed interval in target", fixed_ms != 0 \
+					&& aimd_rate > 0.8 * fixed_rate && aimd_rate < 1.2 * fixed_rate);
+
+	// Time-triggered CAN over the first stats request of the day
+	cfg = (Config_t){.days = 65.0 / 1440, .mode = "", .fault_bus = -1, .tt = 1};
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	ok &= check_one("ttcan: a round every 4 s, every result in", rep.rounds > 950 && rep.lost == 0);
+	ok &= check_one("ttcan: results and hands within their windows", rep.tt_outside == 0 && rep.tt_hand_min != UINT64_MAX);
+	ok &= check_one("ttcan: no arbitration lost", buses[0].lost_arbitration == 0);
+	ok &= check_one("ttcan: reference period within 50 us", rep.tt_period_min > -50000 && rep.tt_period_max < 50000);
+	ok &= check_one("ttcan: hand to result within 2 cycles", rep.lat_max < 2 * rep.tt.cycle_us * 1000ULL);
+
+	// Spectator over the first hour and its stats request, against the same hour without it
+	cfg = (Config_t){.days = 65.0 / 1440, .mode = "", .fault_bus = -1};
+	sim_days(dir, &wall);
+	first = rep.digest;
+	cfg.spectator = 1;
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+	ok &= check_one("spectator: silent, same digest as without it", boards[SPECTATOR].io.can[0].silent && rep.digest == first);
+	ok &= check_one("spectator: totals every 10 s, every frame and round seen", rep.spec_reports >= 385 \
+					&& rep.spec_frames == rep.spec_frames_seen && rep.spec_rounds + 1 >= rep.spec_rounds_seen \
+					&& rep.spec_rounds <= rep.spec_rounds_seen && rep.spec_rounds > 900);
+	ok &= check_one("spectator: hand to result as the buses had it", rep.spec_lat_max > 0 \
+					&& fabs(rep.spec_lat_avg / 1e3 - rep.lat_sum / 1e6 / rep.rounds) < 0.5);
+	ok &= check_one("spectator: no anomaly", rep.spec_anomalies == 0 && boards[SPECTATOR].state == BOARD_RUN);
+
+	printf("%s\n", (ok) ? "PASS" : "FAIL");
+
+	return !ok;
+}
+
+
+/**************************** Main ****************************/
+
+static int usage(void)
+{
+	fprintf(stderr, "usage: board_sim [-d days] [-m off|mirror|share] [-f bus:from_s:to_s] [-l percent:from_s:to_s] [-i ms] [-a] [-t] [-s] [-v]\n"
+			"       board_sim check\n");
+
+	return 2;
+}
+
+
+int main(int argc, char *argv[])
+{
+	char exe[PATH_MAX];
+	const char *dir = ".";
+	struct sigaction sa = {0};
+	struct itimerval tick = {{1, 0}, {1, 0}};
+	ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	double wall;
+	int opt;
+
+	if(n > 0)
+	{
+		exe[n] = '\0';
+		dir = dirname(exe);
+	}
+
+	sa.sa_handler = watchdog;
+	sigaction(SIGALRM, &sa, NULL);
+	setitimer(ITIMER_REAL, &tick, NULL);
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	if(argc > 1 && strcmp(argv[1], "check") == 0)
+	{
+		return check(dir);
+	}
+
+	cfg = (Config_t){.days = 1.0, .mode = "", .fault_bus = -1};
+
+	while((opt = getopt(argc, argv, "d:m:f:l:i:atsv")) != -1)
+	{
+		double from, to;
+
+		switch(opt)
+		{
+			case 'd':
+				cfg.days = atof(optarg);
+				break;
+
+			case 'm':
+				if(strcmp(optarg, "off") != 0 && strcmp(optarg, "mirror") != 0 && strcmp(optarg, "share") != 0)
+				{
+					return usage();
+				}
+
+				cfg.mode = (strcmp(optarg, "mirror") == 0) ? "_mirror" : (strcmp(optarg, "share") == 0) ? "_share" : "";
+				break;
+
+			case 'f':
+				if(sscanf(optarg, "%d:%lf:%lf", &cfg.fault_bus, &from, &to) != 3 || cfg.fault_bus < 0 || cfg.fault_bus >= BUSES)
+				{
+					return usage();
+				}
+
+				cfg.fault_from = (uint64_t)(from * SIM_S);
+				cfg.fault_to = (uint64_t)(to * SIM_S);
+				break;
+
+			case 'l':
+				if(sscanf(optarg, "%lf:%lf:%lf", &cfg.bg_load, &from, &to) != 3 || cfg.bg_load <= 0 || cfg.bg_load > 100 || to < from)
+				{
+					return usage();
+				}
+
+				cfg.bg_load /= 100;
+				cfg.bg_from = (uint64_t)(from * SIM_S);
+				cfg.bg_to = (uint64_t)(to * SIM_S);
+				break;
+
+			case 'i':
+				cfg.interval_ms = (uint32_t)atoi(optarg);
+
+				if(cfg.interval_ms < 1 || cfg.interval_ms > 6553)
+				{
+					return usage();
+				}
+				break;
+
+			case 'a':
+				cfg.rate_ctl = 1;
+				break;
+
+			case 't':
+				cfg.tt = 1;
+				break;
+
+			case 's':
+				cfg.spectator = 1;
+				break;
+
+			case 'v':
+				cfg.verbose = 1;
+				break;
+
+			default:
+				return usage();
+		}
+	}
+
+	if(cfg.days <= 0 || ((cfg.rate_ctl || cfg.tt || cfg.spectator) && *cfg.mode) || (cfg.rate_ctl && cfg.tt) \
+			|| (cfg.interval_ms && (cfg.rate_ctl || cfg.tt)))	// All built for a single bus
+	{
+		return usage();
+	}
+
+	if(sim_days(dir, &wall) != 0)
+	{
+		return 1;
+	}
+
+	report(wall);
+
+	return 0;
+}
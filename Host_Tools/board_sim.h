@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file           : board_sim.h
+  * @brief          : Header shared by the host simulation of the boards
+  *                   (board_sim.c) and its HAL (sim_hal.c).
+  *                   This file contains the defines, types and entry points
+  *                   through which the simulation drives a board library: the
+  *                   firmware of one board built with sim_hal.c in place of the
+  *                   HAL. Everything a board shares with the outside world (pins,
+  *                   CAN controllers, backup domain) lives in its Sim_Io_t, owned
+  *                   by the simulation, so the library can be reloaded at reset.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __BOARD_SIM_H
+#define __BOARD_SIM_H
+
+
+// Includes
+#include <stdint.h>
+#include "can_bits.h"
+
+
+// Defines
+#define SIM_API_VERSION			3
+#define SIM_BOARD_SYMBOL		"sim_board"		// Sim_Board_t exported by a board library
+#define SIM_NEVER				UINT64_MAX
+#define SIM_MS					1000000ULL		// Times are in ns of virtual time
+#define SIM_S					1000000000ULL
+
+// Register windows a board library runs on. The simulation maps the board's own memory
+// there before calling it
+#define SIM_PERIPH_BASE			0x40000000UL	// APB1, APB2, AHB1 (backup SRAM included)
+#define SIM_PERIPH_SIZE			0x80000UL
+#define SIM_BITBAND_BASE		0x42000000UL	// Peripheral bit-band alias. Writes have no effect
+#define SIM_BITBAND_SIZE		0x2000000UL
+#define SIM_CORE_BASE			0xE0000000UL	// Cortex-M4 private peripherals (SCB, DWT)
+#define SIM_CORE_SIZE			0x100000UL
+
+// Result of Sim_Board_t.run()
+#define SIM_IDLE				0		// Reached the horizon
+#define SIM_YIELD				1		// Stopped early: a pin or a CAN controller changed
+#define SIM_STANDBY				2		// Entered Standby at io->now
+#define SIM_HUNG				3		// Stuck in a loop that never gives the CPU back
+
+// Flags of Sim_Board_t.boot()
+#define SIM_BOOT_COLD			0x01	// Power-on: backup domain (RTC, backup SRAM, PWR CSR) cleared
+#define SIM_BOOT_BKPSRAM_LOST	0x02	// The backup regulator was off in Standby: backup SRAM cleared
+
+// bxCAN operating mode
+#define SIM_CAN_SLEEP			0		// After reset, until HAL_CAN_Init()
+#define SIM_CAN_INIT			1		// Initialization mode: off the bus
+#define SIM_CAN_NORMAL			2		// On the bus (normal, silent or loopback)
+
+#define SIM_PORTS				8		// GPIOA to GPIOH
+
+
+// Typedefs
+// Tx mailbox of a bxCAN controller
+typedef struct
+{
+	Can_Bits_Frame_t frame;
+	uint8_t pending;			// Transmit request not served yet
+	uint8_t on_bus;				// Being transmitted
+	uint8_t abort;				// Abort requested while on the bus
+	uint64_t seq;				// Request order, for TransmitFifoPriority
+	uint16_t time;				// TTCM time stamp of the last SOF sent
+} Sim_Mailbox_t;
+
+// bxCAN controller. Configuration and Tx requests come from the board, the bus side
+// (arbitration, Rx FIFOs, error counters) from the simulation
+typedef struct
+{
+	uint8_t mode;				// SIM_CAN_xxx
+	uint8_t silent, loopback;
+	uint8_t abom, nart, txfp, rflm, ttcm;
+	uint32_t bit_ns;			// Bit time from the prescaler and segments
+	uint32_t ier;				// CAN_IER
+	uint64_t ttcm_t0;			// Time the TTCM bit counter started from
+	Sim_Mailbox_t mb[3];
+	uint32_t tsr;				// RQCPx, TXOKx, ALSTx and TERRx bits of CAN_TSR
+	uint64_t seq;
+	// Rx FIFOs
+	Can_Bits_Frame_t rx[2][3];
+	uint8_t rx_fmi[2][3];		// Filter match index
+	uint16_t rx_time[2][3];		// TTCM time stamp
+	uint8_t rx_head[2], rx_fill[2];
+	uint8_t rx_full[2], rx_fovr[2];
+	// Error state (CAN_ESR)
+	uint16_t tec;				// Above 255: bus-off
+	uint8_t rec;
+	uint8_t boff;
+	uint8_t lec;				// Last error code
+	uint8_t erri;				// MSR ERRI: error with its interrupt enabled in IER
+	uint64_t recover_at;		// End of the bus-off recovery, SIM_NEVER if none under way
+} Sim_Can_t;
+
+// Filter banks (CAN1 registers) as written by HAL_CAN_ConfigFilter()
+typedef struct
+{
+	uint32_t fmr, fm1r, fs1r, ffa1r, fa1r;
+	uint32_t fr[28][2];
+} Sim_Filters_t;
+
+// RTC calendar. Part of the backup domain: kept through Standby and resets
+typedef struct
+{
+	uint8_t inits;				// Calendar set since the last backup domain reset (ISR INITS)
+	int64_t base_sec;			// Calendar seconds since 2000-01-01 00:00:00 at base_t
+	uint64_t base_t;
+	uint64_t hz_num, hz_den;	// RTC seconds per second: LSI / ((AsynchPrediv + 1) * (SynchPrediv + 1))
+} Sim_Rtc_t;
+
+typedef struct Sim_Io Sim_Io_t;
+
+// Calls from a board to the simulation
+typedef struct
+{
+	void (*uart_tx)(Sim_Io_t *io, uint64_t t, const uint8_t *data, uint16_t len, uint64_t char_ps);	// Bytes on a USART Tx line, the first one starting at t
+	void (*pin_out)(Sim_Io_t *io, uint64_t t, uint8_t port, uint16_t pins, uint16_t levels);		// Output pins driven (or released: level 0)
+	void (*can_kick)(Sim_Io_t *io, uint64_t t, uint8_t ctrl);		// A Tx mailbox was filled or the controller changed mode
+} Sim_Host_t;
+
+// A board as seen by the simulation
+struct Sim_Io
+{
+	// Set by the simulation
+	uint8_t index;
+	const Sim_Host_t *host;
+	void *user;
+	Sim_Can_t can[2];				// bxCAN1, bxCAN2
+	Sim_Rtc_t rtc;
+	uint32_t pwr_csr;				// PWR CSR as kept through resets: SBF, WUF, BRE, BRR. EWUP as last written
+	uint8_t wuf_event;				// Wakeup pin edge while EWUP is set: WUF to be set
+	uint16_t idr[SIM_PORTS];		// Levels applied to the pins
+	uint16_t exti_pr;				// EXTI pending lines, set on an enabled edge
+	uint64_t irq_at;				// An input changed at that time: interrupt lines must be looked at
+	uint32_t tim6_arr;				// Nonzero: TIM6 period forced to that ARR, whatever the board sets up
+
+	// Kept by the board
+	uint64_t now;					// Virtual time of the board. Ahead of the simulation while a handler runs
+	uint64_t next;					// Earliest pending local event, SIM_NEVER if none
+	uint8_t yield;					// An output needs the simulation before going on
+	uint16_t exti_imr, exti_rtsr, exti_ftsr;
+	uint8_t exti_port[16];			// Port of each EXTI line (SYSCFG EXTICR)
+	uint16_t odr[SIM_PORTS], out[SIM_PORTS];	// Output levels and output pins
+	Sim_Filters_t filters;
+	uint64_t irqs;					// Interrupt handlers run
+	uint64_t progress;				// Events handled. Still for a second of wall time: the board is hung
+};
+
+// Entry points of a board library
+typedef struct
+{
+	uint32_t version;
+	void (*boot)(Sim_Io_t *io, uint64_t t, uint32_t flags);		// Reset: main() starts at t
+	int (*run)(uint64_t until);									// Handles the events before until. SIM_xxx result
+	void (*escape)(void);										// From a signal handler: leaves the hung code, run() returns SIM_HUNG
+} Sim_Board_t;
+
+
+#endif /* __BOARD_SIM_H */
@@ -0,0 +1,323 @@
+/**
+  ******************************************************************************
+  * @file    can_bits.c
+  * @author  Moe2Code
+  * @brief   Bit level view of classic CAN frames, for the host tools that time the bus.
+  *          The following is conducted in source file:
+  *          + CRC-15 of the frame, computed on its bits as the controllers do
+  *          + Exact number of stuff bits (SOF to CRC) of a given frame
+  *          + Length on the wire and arbitration order of a frame
+  *          + Most stuff bits a frame can get over all its payloads, for its identifier and
+  *            DLC: the longest it can take on the wire
+  * @note    Lengths count the frame from SOF to the end of EOF. The intermission
+  *          (CAN_BITS_IFS) that follows every frame is left to the caller
+  */
+
+// Includes
+#include <string.h>
+#include "can_bits.h"
+
+
+// Defines
+#define CAN_BITS_CRC_POLY		0x4599
+
+
+// Function prototypes
+static uint16_t Can_Bits_Unstuffed(const Can_Bits_Frame_t *f, uint8_t bits[CAN_BITS_MAX]);
+static uint16_t Can_Bits_Payload(const Can_Bits_Frame_t *f);
+
+
+/**
+  * @brief  Computes the CRC-15 of a bit sequence (SOF to the last data bit)
+  * @param  bits bits, one per byte (0 or 1)
+  * @param  n number of bits
+  * @retval CRC, 15 bits
+  */
+
+uint16_t Can_Bits_Crc15(const uint8_t *bits, uint16_t n)
+{
+	uint16_t crc = 0;
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		uint8_t next = bits[i] ^ ((crc >> 14) & 1);
+
+		crc = (crc << 1) & 0x7FFF;
+
+		if(next)
+		{
+			crc ^= CAN_BITS_CRC_POLY;
+		}
+	}
+
+	return crc;
+}
+
+
+/**
+  * @brief  Returns the number of bits from SOF to the end of the CRC once stuffed
+  * @param  f pointer to the frame
+  * @param  stuff receives the number of stuff bits, may be NULL
+  * @retval Bits
+  */
+
+uint16_t Can_Bits_Stuffed(const Can_Bits_Frame_t *f, uint16_t *stuff)
+{
+	uint8_t bits[CAN_BITS_MAX];
+	uint16_t n = Can_Bits_Unstuffed(f, bits);
+	uint16_t added = 0;
+	uint8_t run = 0, last = 2;
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		if(bits[i] == last)
+		{
+			run++;
+		}else
+		{
+			last = bits[i];
+			run = 1;
+		}
+
+		if(run == 5)				// Complement bit, which starts a new run
+		{
+			added++;
+			last ^= 1;
+			run = 1;
+		}
+	}
+
+	if(stuff != 0)
+	{
+		*stuff = added;
+	}
+
+	return n + added;
+}
+
+
+/**
+  * @brief  Returns the length of a frame on the wire, stuff bits included
+  * @param  f pointer to the frame
+  * @retval Bits from SOF to the end of EOF
+  */
+
+uint16_t Can_Bits_Length(const Can_Bits_Frame_t *f)
+{
+	return Can_Bits_Stuffed(f, 0) + CAN_BITS_TAIL;
+}
+
+
+/**
+  * @brief  Returns the most stuff bits a bit sequence can get when some of its bits are free
+  * 		to take either value (dynamic programming over the run the stuffing is in)
+  * @param  bits bits, one per byte. Free bits are not read
+  * @param  free 1 for each free bit
+  * @param  n number of bits
+  * @retval Stuff bits
+  */
+
+uint16_t Can_Bits_StuffMax(const uint8_t *bits, const uint8_t *free, uint16_t n)
+{
+	int16_t best[2][6], next[2][6];		// Most stuff bits so far, per last bit and run length (-1: not reachable)
+	uint16_t most = 0;
+
+	memset(best, 0xFF, sizeof(best));
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		memset(next, 0xFF, sizeof(next));
+
+		for(uint8_t v = 0; v < 2; v++)
+		{
+			if(!free[i] && bits[i] != v)
+			{
+				continue;
+			}
+
+			if(i == 0)
+			{
+				next[v][1] = 0;
+				continue;
+			}
+
+			for(uint8_t last = 0; last < 2; last++)
+			{
+				for(uint8_t run = 1; run < 5; run++)
+				{
+					uint8_t l = v, r = (v == last) ? run + 1 : 1;
+					int16_t s = best[last][run];
+
+					if(s < 0)
+					{
+						continue;
+					}
+
+					if(r == 5)				// Complement bit, which starts a new run
+					{
+						s++;
+						l ^= 1;
+						r = 1;
+					}
+
+					if(s > next[l][r])
+					{
+						next[l][r] = s;
+					}
+				}
+			}
+		}
+
+		memcpy(best, next, sizeof(best));
+	}
+
+	for(uint8_t last = 0; last < 2; last++)
+	{
+		for(uint8_t run = 1; run < 5; run++)
+		{
+			most = (best[last][run] > (int16_t)most) ? best[last][run] : most;
+		}
+	}
+
+	return most;
+}
+
+
+/**
+  * @brief  Returns the most stuff bits a frame with f's identifier, RTR and DLC can get,
+  * 		whatever its payload. Data and CRC bits are taken as free: the CRC follows from the
+  * 		data, so this is a bound, tighter than the classic one as the header is exact.
+  * 		Exact for frames without data (the CRC is then known)
+  * @param  f pointer to the frame (payload not read)
+  * @retval Stuff bits
+  */
+
+uint16_t Can_Bits_StuffBound(const Can_Bits_Frame_t *f)
+{
+	uint8_t bits[CAN_BITS_MAX], free[CAN_BITS_MAX] = {0};
+	uint16_t n = Can_Bits_Unstuffed(f, bits);
+	uint16_t first = n - 15 - 8 * Can_Bits_Payload(f);		// First data bit
+
+	if(first < n - 15)			// CRC bits free only when data bits are
+	{
+		memset(&free[first], 1, n - first);
+	}
+
+	return Can_Bits_StuffMax(bits, free, n);
+}
+
+
+/**
+  * @brief  Returns the longest a frame with f's identifier, RTR and DLC takes on the wire
+  * @param  f pointer to the frame (payload not read)
+  * @retval Bits from SOF to the end of EOF
+  */
+
+uint16_t Can_Bits_Worst(const Can_Bits_Frame_t *f)
+{
+	uint8_t bits[CAN_BITS_MAX];
+
+	return Can_Bits_Unstuffed(f, bits) + Can_Bits_StuffBound(f) + CAN_BITS_TAIL;
+}
+
+
+/**
+  * @brief  Returns the arbitration key of a frame: identifier, RTR, SRR and IDE bits in
+  * 		the order they go on the wire. The lowest key wins the arbitration
+  * @param  f pointer to the frame
+  * @retval Key
+  */
+
+uint32_t Can_Bits_Key(const Can_Bits_Frame_t *f)
+{
+	if(f->ext)		// Base ID, SRR and IDE recessive, extended ID, RTR
+	{
+		return ((f->id >> 18) << 21) | (3 << 19) | ((f->id & 0x3FFFF) << 1) | f->rtr;
+	}
+
+	return ((f->id & 0x7FF) << 21) | ((uint32_t)f->rtr << 20);		// Base ID, RTR, IDE dominant
+}
+
+
+/**
+  * @brief  Lays out the bits from SOF to the end of the CRC, before stuffing
+  * @param  f pointer to the frame
+  * @param  bits receives the bits, one per byte
+  * @retval Number of bits
+  */
+
+static uint16_t Can_Bits_Unstuffed(const Can_Bits_Frame_t *f, uint8_t bits[CAN_BITS_MAX])
+{
+	uint8_t dlc = f->dlc & 0xF;
+	uint8_t bytes = Can_Bits_Payload(f);
+	uint16_t n = 0;
+	uint16_t crc;
+
+	bits[n++] = 0;									// SOF
+
+	if(f->ext)
+	{
+		for(int8_t i = 28; i >= 18; i--)			// Base ID
+		{
+			bits[n++] = (f->id >> i) & 1;
+		}
+
+		bits[n++] = 1;								// SRR
+		bits[n++] = 1;								// IDE
+
+		for(int8_t i = 17; i >= 0; i--)				// Extended ID
+		{
+			bits[n++] = (f->id >> i) & 1;
+		}
+
+		bits[n++] = f->rtr;
+		bits[n++] = 0;								// r1
+		bits[n++] = 0;								// r0
+	}else
+	{
+		for(int8_t i = 10; i >= 0; i--)
+		{
+			bits[n++] = (f->id >> i) & 1;
+		}
+
+		bits[n++] = f->rtr;
+		bits[n++] = 0;								// IDE
+		bits[n++] = 0;								// r0
+	}
+
+	for(int8_t i = 3; i >= 0; i--)					// DLC
+	{
+		bits[n++] = (dlc >> i) & 1;
+	}
+
+	for(uint8_t b = 0; b < bytes; b++)
+	{
+		for(int8_t i = 7; i >= 0; i--)
+		{
+			bits[n++] = (f->data[b] >> i) & 1;
+		}
+	}
+
+	crc = Can_Bits_Crc15(bits, n);
+
+	for(int8_t i = 14; i >= 0; i--)
+	{
+		bits[n++] = (crc >> i) & 1;
+	}
+
+	return n;
+}
+
+
+/**
+  * @brief  Returns the number of data bytes a frame carries
+  * @param  f pointer to the frame
+  * @retval Bytes
+  */
+
+static uint16_t Can_Bits_Payload(const Can_Bits_Frame_t *f)
+{
+	uint8_t dlc = f->dlc & 0xF;
+
+	return (f->rtr) ? 0 : ((dlc > 8) ? 8 : dlc);
+}
@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file           : can_bits.h
+  * @brief          : Header for can_bits.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   bit level view of classic CAN frames: exact length on the
+  *                   wire (stuff bits included), its worst case over the payloads,
+  *                   and arbitration order.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __CAN_BITS_H
+#define __CAN_BITS_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define CAN_BITS_TAIL			10		// CRC delimiter, ACK slot, ACK delimiter and EOF: never stuffed
+#define CAN_BITS_IFS			3		// Intermission between frames
+#define CAN_BITS_ERROR_FRAME	14		// Error flag (6) and error delimiter (8)
+#define CAN_BITS_SUSPEND		8		// Suspend transmission of an error-passive transmitter
+#define CAN_BITS_MAX			160		// Longest frame: extended, 8 data bytes, every stuff bit
+
+
+// Typedefs
+// Frame as carried on the wire
+typedef struct
+{
+	uint32_t id;				// 11-bit or 29-bit identifier
+	uint8_t ext;				// 1 for an extended identifier
+	uint8_t rtr;				// 1 for a remote frame
+	uint8_t dlc;				// 0 to 15. Data frames carry min(dlc, 8) bytes
+	uint8_t data[8];
+} Can_Bits_Frame_t;
+
+
+// Function prototypes
+uint16_t Can_Bits_Crc15(const uint8_t *bits, uint16_t n);
+uint16_t Can_Bits_Stuffed(const Can_Bits_Frame_t *f, uint16_t *stuff);
+uint16_t Can_Bits_Length(const Can_Bits_Frame_t *f);
+uint16_t Can_Bits_StuffMax(const uint8_t *bits, const uint8_t *free, uint16_t n);
+uint16_t Can_Bits_StuffBound(const Can_Bits_Frame_t *f);
+uint16_t Can_Bits_Worst(const Can_Bits_Frame_t *f);
+uint32_t Can_Bits_Key(const Can_Bits_Frame_t *f);
+
+
+#endif /* __CAN_BITS_H */
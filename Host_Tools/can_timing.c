@@ -0,0 +1,726 @@
+/**
+  ******************************************************************************
+  * @file    can_timing.c
+  * @author  Moe2Code
+  * @brief   Bus capacity planner for the game frames. Times every message both main_.c
+  *          files send or answer, bit exact (can_bits.c), and bounds their response times.
+  *          The following is conducted in source file:
+  *          + Per message: shortest, typical and longest frame on the wire. Payloads the
+  *            firmware sends are enumerated (hands, results, the index query), counters and
+  *            MACs are random bytes (typical over 65536 of them) and the longest is the exact
+  *            bound over all payloads for the identifier and DLC (Can_Bits_Worst), next to the
+  *            classic 8s + 47 + (34 + 8s - 1) / 4 bits
+  *          + Response-time analysis of the bus (fixed priorities, non-preemptive frames,
+  *            blocking by one lower priority frame, release jitter): worst time from the
+  *            release of each message to the end of its frame. Messages sent in answer to
+  *            another one inherit its response time as jitter (holistic analysis): the
+  *            result carries the hand's and Disc's UART lines before it
+  *          + Node count: every pair of boards brings its own copy of each message, ranked
+  *            with the other copies of that message (slot order), as fleet_sim lays out the
+  *            hand and result IDs
+  *          + Maximum rounds per second: bus bound with the longest and typical frames, and
+  *            the highest round rate that keeps every message within its period
+  *          Usage: ./can_timing [-b kbit/s] [-n nodes] [-i round_interval_ms] [-q stats_interval_ms] [-s]
+  *                 ./can_timing check
+  *          -s: SECURE_CAN builds (counter and 32-bit tag after the hand, result and sleep
+  *          payloads). -q: shortest time between two stats requests, 100 ms while Disc's
+  *          button is held (default). check: the stuff bound against every frame of a
+  *          random sweep and against the classic bound, and the analysis on known cases.
+  * @note    Frames are never lost or repeated (no bus errors). The time Disc's UART lines
+  *          take before an answer is counted as jitter of the answer, not as bus time
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "can_bits.h"
+#include "fenwick.h"
+
+
+// Defines
+#define MS					1000000ULL		// Times are in ns
+#define UART_CHAR_NS		86806			// 115200 baud, 10 bits per character
+#define ROLLUP_QUERY_ID		0x6A0			// As in rollup.h (not included: it pulls in the HAL)
+#define ROLLUP_REPLY_ID		0x6A1
+#define SECURE_OVERHEAD		5				// As in secure_msg.h: counter low byte and 32-bit tag
+#define TYPICAL_SAMPLES		65536
+#define MSG_MAX				4096
+#define RTA_LIMIT			(3600ULL * 1000 * MS)	// Longer busy period: the bus is overloaded
+#define NONE				0xFFFF
+
+// Payloads of a message
+#define PAY_FIXED			0		// The bytes of the table
+#define PAY_HAND			1		// Byte 0: 0 to 2
+#define PAY_RESULT			2		// Byte 0: 1 to 3 (4 on an error), byte 1: 0
+#define PAY_RANDOM			3		// Counters, totals: any bytes
+
+
+// Typedefs
+// A message of the firmware
+typedef struct
+{
+	uint16_t id;
+	uint8_t rtr, dlc;
+	uint8_t payload;			// PAY_xxx
+	uint8_t data[8];			// PAY_FIXED bytes
+	uint8_t secured;			// Sealed by secure_msg.c in SECURE_CAN builds
+	const char *sender, *name;
+	int8_t follows;				// Sent in answer to this message of the table, -1 if none
+	uint32_t delay_min_us, delay_max_us;	// UART lines printed between the two
+	uint8_t period;				// PERIOD_xxx
+} Message_t;
+
+#define PERIOD_ROUND		0		// Once per round
+#define PERIOD_STATS		1		// Once per stats request
+#define PERIOD_DAY			2		// Once a day
+
+// Frame lengths of a message, in bits with the intermission
+typedef struct
+{
+	uint16_t best, worst, classic;
+	double typical;
+} Length_t;
+
+// A copy of a message on the bus, in priority order
+typedef struct
+{
+	uint16_t msg;				// Index in messages[]
+	uint16_t slot;
+	uint16_t parent;			// Copy it answers, NONE if none
+	uint64_t c, c_best;			// Longest and shortest time on the wire
+	uint64_t t, j, r;			// Period, release jitter, worst response time
+	uint64_t o;					// Earliest release after the round (or stats) started
+} Copy_t;
+
+typedef struct
+{
+	uint32_t kbits, nodes, interval_ms, stats_ms;
+	uint8_t secure;
+} Config_t;
+
+
+// Global variables
+// Every message of both main_.c files, highest priority first
+static const Message_t messages[] =
+{
+	{0x111, 0, 2, PAY_RESULT, {0}, 1, "Disc", "result", 1, 0, 0, PERIOD_ROUND},				// send_game_result(), delays set in main()
+	{0x49F, 0, 1, PAY_HAND, {0}, 1, "Nucleo", "hand", -1, 0, 0, PERIOD_ROUND},				// CAN1_Tx() on TIM6
+	{0x633, 0, 6, PAY_RANDOM, {0}, 0, "Nucleo", "stats", 3, 0, 0, PERIOD_STATS},			// send_game_stats(), answers the remote frame
+	{0x633, 1, 4, PAY_FIXED, {0}, 0, "Disc", "stats request", -1, 0, 0, PERIOD_STATS},		// CAN1_Tx() on the button (remote frame)
+	{ROLLUP_QUERY_ID, 0, 3, PAY_RANDOM, {0}, 0, "any", "rollup query", -1, 0, 0, PERIOD_STATS},	// Answered by send_rollup_reply()
+	{ROLLUP_REPLY_ID, 0, 8, PAY_RANDOM, {0}, 0, "Disc", "rollup reply", 4, 0, 0, PERIOD_STATS},
+	{FENWICK_QUERY_ID, 0, 3, PAY_FIXED, {FENWICK_BY_MINUTES, 60, 0}, 0, "Disc", "index query", 2, 25000, 45000, PERIOD_STATS},	// After the stats printout
+	{FENWICK_REPLY_ID, 0, 8, PAY_RANDOM, {0}, 0, "Nucleo", "index reply", 6, 0, 0, PERIOD_STATS},	// send_index_reply()
+	{0x77B, 0, 1, PAY_FIXED, {0}, 1, "Nucleo", "sleep", -1, 0, 0, PERIOD_DAY},				// send_sleep_msg()
+};
+
+#define MESSAGES			(sizeof(messages) / sizeof(messages[0]))
+
+static Message_t table[MESSAGES];		// messages[] with the UART delays and the SECURE_CAN DLCs
+static Length_t length[MESSAGES];
+static Copy_t copy[MSG_MAX];
+static uint32_t n_copy;
+static uint64_t bit_ns;
+static uint32_t referee_us;			// Disc's UART lines for a round, longest hands and result
+
+
+// Function prototypes
+static uint64_t rng_next(uint64_t *s);
+static void fill_payload(const Message_t *m, Can_Bits_Frame_t *f, uint32_t value, uint64_t *rng);
+static void time_message(uint16_t i);
+static uint64_t div_up(uint64_t a, uint64_t b);
+static uint64_t response_time(uint32_t m);
+static int analyse(const Config_t *cfg, uint8_t quick);
+static uint32_t max_rate(const Config_t *cfg);
+static void report(const Config_t *cfg);
+static int check(void);
+
+
+/**
+  * @brief  Returns the next value of a 64-bit LCG (payload samples)
+  */
+
+static uint64_t rng_next(uint64_t *s)
+{
+	*s = *s * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	return *s >> 16;
+}
+
+
+/**
+  * @brief  Writes a payload of a message into a frame
+  * @param  m message
+  * @param  f frame, identifier and DLC set
+  * @param  value hand or result for PAY_HAND and PAY_RESULT
+  * @param  rng random bytes for PAY_RANDOM and the tag of secured messages
+  * @retval None
+  */
+
+static void fill_payload(const Message_t *m, Can_Bits_Frame_t *f, uint32_t value, uint64_t *rng)
+{
+	uint8_t plain = m->dlc - (m->secured ? SECURE_OVERHEAD : 0);
+
+	memcpy(f->data, m->data, sizeof(f->data));
+
+	if(m->payload == PAY_HAND || m->payload == PAY_RESULT)
+	{
+		f->data[0] = value;
+		f->data[1] = 0;
+	}else if(m->payload == PAY_RANDOM)
+	{
+		for(uint8_t i = 0; i < plain; i++)
+		{
+			f->data[i] = rng_next(rng);
+		}
+	}
+
+	for(uint8_t i = plain; i < m->dlc; i++)		// Counter and tag
+	{
+		f->data[i] = rng_next(rng);
+	}
+}
+
+
+/**
+  * @brief  Times a message of the table: payloads enumerated when the firmware has few of
+  * 		them, sampled otherwise
+  * @param  i index in the table
+  * @retval None
+  */
+
+static void time_message(uint16_t i)
+{
+	const Message_t *m = &table[i];
+	Can_Bits_Frame_t f = {.id = m->id, .rtr = m->rtr, .dlc = m->dlc};
+	uint8_t bytes = m->rtr ? 0 : m->dlc;
+	uint32_t values = (m->payload == PAY_HAND) ? 3 : (m->payload == PAY_RESULT) ? 4 : 1;
+	uint32_t samples = (m->payload == PAY_RANDOM || m->secured) ? TYPICAL_SAMPLES : 1;
+	uint64_t rng = 0x633 + i, sum = 0, n = 0;
+	Length_t *l = &length[i];
+
+	l->best = UINT16_MAX;
+	l->worst = Can_Bits_Worst(&f) + CAN_BITS_IFS;
+	l->classic = 8 * bytes + 47 + (34 + 8 * bytes - 1) / 4;
+
+	for(uint32_t v = 0; v < values; v++)
+	{
+		for(uint32_t s = 0; s < samples; s++)
+		{
+			uint16_t bits;
+
+			fill_payload(m, &f, (m->payload == PAY_RESULT) ? v + 1 : v, &rng);
+			bits = Can_Bits_Length(&f) + CAN_BITS_IFS;
+			l->best = (bits < l->best) ? bits : l->best;
+
+			if(m->payload != PAY_RESULT || v < 3)		// Typical: errors left out
+			{
+				sum += bits;
+				n++;
+			}
+		}
+	}
+
+	l->typical = (double)sum / n;
+}
+
+
+static uint64_t div_up(uint64_t a, uint64_t b)
+{
+	return (a + b - 1) / b;
+}
+
+
+/**
+  * @brief  Worst response time of a copy: longest queuing delay over the instances of its
+  * 		level-m busy period, plus its jitter and its own frame
+  * @param  m copy, in priority order
+  * @retval ns, UINT64_MAX if the busy period does not end (overloaded)
+  */
+
+static uint64_t response_time(uint32_t m)
+{
+	uint64_t b = 0, busy, next, worst = 0, q_max;
+	double load = 0;
+
+	for(uint32_t k = 0; k <= m; k++)			// Level-m load of 1 or more: the busy period never ends
+	{
+		load += (double)copy[k].c / copy[k].t;
+	}
+
+	if(load >= 1)
+	{
+		return UINT64_MAX;
+	}
+
+	for(uint32_t k = m + 1; k < n_copy; k++)		// One lower priority frame already on the wire
+	{
+		b = (copy[k].c > b) ? copy[k].c : b;
+	}
+
+	// Level-m busy period
+	for(busy = b + copy[m].c; ; busy = next)
+	{
+		next = b;
+
+		for(uint32_t k = 0; k <= m; k++)
+		{
+			next += div_up(busy + copy[k].j, copy[k].t) * copy[k].c;
+		}
+
+		if(next == busy)
+		{
+			break;
+		}
+
+		if(next > RTA_LIMIT)
+		{
+			return UINT64_MAX;
+		}
+	}
+
+	q_max = div_up(busy + copy[m].j, copy[m].t);
+
+	for(uint64_t q = 0, w = b; q < q_max; q++)		// Instance q waits for q - 1 and its frame at least
+	{
+		uint64_t r;
+
+		w += (q > 0) ? copy[m].c : 0;
+
+		for(;;)				// Queuing delay of instance q
+		{
+			next = b + q * copy[m].c;
+
+			for(uint32_t k = 0; k < m; k++)
+			{
+				next += div_up(w + copy[k].j + bit_ns, copy[k].t) * copy[k].c;
+			}
+
+			if(next == w)
+			{
+				break;
+			}
+
+			if(next > RTA_LIMIT)
+			{
+				return UINT64_MAX;
+			}
+
+			w = next;
+		}
+
+		r = copy[m].j + w + copy[m].c - q * copy[m].t;
+		worst = (r > worst) ? r : worst;
+	}
+
+	return worst;
+}
+
+
+/**
+  * @brief  Lays out the copies of the messages of every pair, then runs the analysis until
+  * 		the jitters of the answers settle
+  * @param  cfg bus
+  * @param  quick stop at the first late copy: jitters only grow, it stays late
+  * @retval 0 if every message ends within its period, 1 otherwise
+  */
+
+static int analyse(const Config_t *cfg, uint8_t quick)
+{
+	uint32_t pairs = (cfg->nodes + 1) / 2;
+	uint64_t period[3] = {cfg->interval_ms * MS, cfg->stats_ms * MS, 86400000ULL * MS};
+	uint16_t first[MESSAGES];
+	int late = 0;
+
+	bit_ns = 1000000 / cfg->kbits;
+	n_copy = 0;
+
+	for(uint16_t i = 0; i < MESSAGES; i++)		// Table order is priority order, copies of a message side by side
+	{
+		first[i] = n_copy;
+
+		for(uint32_t s = 0; s < pairs; s++)
+		{
+			Copy_t *c = &copy[n_copy++];
+
+			c->msg = i;
+			c->slot = s;
+			c->c = length[i].worst * bit_ns;
+			c->c_best = length[i].best * bit_ns;
+			c->t = period[table[i].period];
+			c->j = 0;
+			c->r = 0;
+			c->o = 0;
+		}
+	}
+
+	for(uint32_t k = 0; k < n_copy; k++)
+	{
+		int8_t p = table[copy[k].msg].follows;
+
+		copy[k].parent = (p < 0) ? NONE : first[p] + copy[k].slot;
+	}
+
+	for(uint16_t depth = 0; depth < MESSAGES; depth++)		// Offsets down the answer chains
+	{
+		for(uint32_t k = 0; k < n_copy; k++)
+		{
+			if(copy[k].parent != NONE)
+			{
+				const Copy_t *p = &copy[copy[k].parent];
+
+				copy[k].o = p->o + p->c_best + table[copy[k].msg].delay_min_us * 1000ULL;
+			}
+		}
+	}
+
+	for(uint8_t pass = 0; pass < 32; pass++)		// Jitters only grow: stop once they hold
+	{
+		uint8_t changed = 0;
+
+		for(uint32_t k = 0; k < n_copy; k++)
+		{
+			copy[k].r = response_time(k);
+
+			if(quick && (copy[k].r == UINT64_MAX || copy[k].o + copy[k].r > copy[k].t))
+			{
+				return 1;
+			}
+		}
+
+		for(uint32_t k = 0; k < n_copy; k++)
+		{
+			const Copy_t *p = (copy[k].parent == NONE) ? NULL : &copy[copy[k].parent];
+			const Message_t *m = &table[copy[k].msg];
+			uint64_t j;
+
+			if(p == NULL)
+			{
+				continue;
+			}
+
+			if(p->r == UINT64_MAX)
+			{
+				j = UINT64_MAX / 4;
+			}else
+			{
+				j = p->r + m->delay_max_us * 1000ULL - p->c_best - m->delay_min_us * 1000ULL;
+			}
+
+			changed |= (j != copy[k].j);
+			copy[k].j = j;
+		}
+
+		if(!changed)
+		{
+			break;
+		}
+	}
+
+	for(uint32_t k = 0; k < n_copy; k++)		// Answers are due before the next round too
+	{
+		late |= (copy[k].r == UINT64_MAX || copy[k].o + copy[k].r > copy[k].t);
+	}
+
+	return late;
+}
+
+
+/**
+  * @brief  Returns the shortest round interval (ms) that keeps every message within its
+  * 		period, 0 if none does (the stats traffic alone overloads the bus)
+  * @param  cfg bus, its interval is not used
+  */
+
+static uint32_t max_rate(const Config_t *cfg)
+{
+	Config_t c = *cfg;
+	uint32_t lo = 1, hi = 86400000;
+
+	c.interval_ms = hi;
+
+	if(analyse(&c, 1) != 0)
+	{
+		return 0;
+	}
+
+	while(lo < hi)			// Shortest interval with every message on time
+	{
+		c.interval_ms = lo + (hi - lo) / 2;
+
+		if(analyse(&c, 1) == 0)
+		{
+			hi = c.interval_ms;
+		}else
+		{
+			lo = c.interval_ms + 1;
+		}
+	}
+
+	return hi;
+}
+
+
+/**
+  * @brief  Prints the frame times, the response times and the round rate bounds
+  * @param  cfg bus
+  * @retval None
+  */
+
+static void report(const Config_t *cfg)
+{
+	uint32_t pairs = (cfg->nodes + 1) / 2, best_ms;
+	int late = analyse(cfg, 0);		// Sets bit_ns
+	double round_worst = (length[0].worst + length[1].worst) * bit_ns / 1e9;
+	double round_typical = (length[0].typical + length[1].typical) * bit_ns / 1e9;
+	double load = 0;
+
+	printf("%u kbit/s (%llu ns per bit), %u nodes (%u pair%s), a round every %u ms, stats every %u ms at most%s\n\n", cfg->kbits, \
+		   (unsigned long long)bit_ns, cfg->nodes, pairs, (pairs > 1) ? "s" : "", cfg->interval_ms, cfg->stats_ms, cfg->secure ? ", SECURE_CAN" : "");
+	printf("%-6s %-4s %-7s %-14s %3s  %6s %7s %6s %7s  %9s %9s %9s %9s\n", "ID", "", "from", "message", "DLC", "best", \
+		   "typical", "worst", "classic", "worst us", "T ms", "J ms", "R ms");
+
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		const Message_t *m = &table[i];
+		uint64_t r = 0, j = 0;
+
+		for(uint32_t k = 0; k < n_copy; k++)		// Worst copy: the lowest priority one
+		{
+			if(copy[k].msg == i)
+			{
+				uint64_t end = (copy[k].r == UINT64_MAX) ? UINT64_MAX : copy[k].o + copy[k].r;
+
+				r = (end > r) ? end : r;
+				j = (copy[k].j > j) ? copy[k].j : j;
+				load += (double)copy[k].c / copy[k].t;
+			}
+		}
+
+		printf("0x%03X  %-4s %-7s %-14s %3u  %6u %7.1f %6u %7u  %9.1f %9.0f %9.3f ", m->id, m->rtr ? "RTR" : "", m->sender, m->name, \
+			   m->dlc, length[i].best, length[i].typical, length[i].worst, length[i].classic, length[i].worst * bit_ns / 1e3, \
+			   copy[i * pairs].t / 1e6, j / 1e6);
+
+		if(r == UINT64_MAX)
+		{
+			printf("%9s\n", "overload");
+		}else
+		{
+			printf("%9.3f%s\n", r / 1e6, (r > copy[i * pairs].t) ? " late" : "");
+		}
+	}
+
+	printf("\nBits with the intermission. R: from the start of the round (or stats exchange) to the end of the frame\n");
+	printf("worst: longest over every payload for the ID and DLC, classic: 8s + 47 + (34 + 8s - 1) / 4\n");
+	printf("Worst case bus load %.2f %%, %s\n", 100 * load, late ? "some messages miss their period" : "every message within its period");
+
+	if(copy[pairs - 1].r != UINT64_MAX)			// Last copy of the result, released once the hand is in and Disc printed
+	{
+		printf("Round (hand to result) bound: %.3f ms\n", (copy[pairs - 1].o + copy[pairs - 1].r) / 1e6);
+	}
+	printf("Rounds/s the bus carries with nothing else: %.0f (longest frames), %.0f (typical), %.1f per pair\n", \
+		   1 / round_worst, 1 / round_typical, 1 / round_worst / pairs);
+
+	best_ms = max_rate(cfg);
+
+	if(best_ms == 0)
+	{
+		printf("Rounds/s with every message within its period: none, the stats traffic alone overloads the bus (see -q)\n");
+	}else
+	{
+		printf("Rounds/s with every message within its period: %.1f (a round every %u ms per pair)\n", 1000.0 * pairs / best_ms, best_ms);
+	}
+
+	printf("Disc's UART lines (up to %.1f ms per round) hold a referee to %.0f rounds/s\n", referee_us / 1e3, 1e6 / referee_us);
+}
+
+
+/**
+  * @brief  Prints a check and its outcome
+  * @retval 1 if it failed
+  */
+
+static int check_one(const char *what, int ok)
+{
+	printf("%-62s %s\n", what, ok ? "ok" : "FAIL");
+
+	return !ok;
+}
+
+
+/**
+  * @brief  Checks the stuff bound and the analysis
+  * @param  None
+  * @retval Exit code
+  */
+
+static int check(void)
+{
+	uint8_t bits[CAN_BITS_MAX] = {0}, free[CAN_BITS_MAX];
+	uint64_t rng = 1, block;
+	int ok = 1, fail = 0;
+	Config_t cfg = {500, 2, 4000, 100, 0};
+
+	// All bits free but the first: (n - 1) / 4, the classic count
+	memset(free, 1, sizeof(free));
+	free[0] = 0;
+
+	for(uint16_t n = 1; n <= CAN_BITS_MAX; n++)
+	{
+		ok &= (Can_Bits_StuffMax(bits, free, n) == (n - 1) / 4);
+	}
+
+	fail |= check_one("stuff bound with every bit free: (n - 1) / 4", ok);
+
+	// Random frames: exact length never above the bound, the bound never above the classic one
+	ok = 1;
+
+	for(uint32_t i = 0; i < 200000; i++)
+	{
+		Can_Bits_Frame_t f = {0};
+		uint64_t r = rng_next(&rng);
+		uint8_t bytes;
+
+		f.ext = (r & 3) == 0;
+		f.id = (r >> 2) & (f.ext ? 0x1FFFFFFF : 0x7FF);
+		f.rtr = (r >> 32) % 8 == 0;
+		f.dlc = (r >> 36) % 9;
+		bytes = f.rtr ? 0 : f.dlc;
+
+		for(uint8_t k = 0; k < 8; k++)
+		{
+			f.data[k] = ((r >> 40) % 4 == 0) ? ((k & 1) ? 0xFF : 0) : rng_next(&rng);		// Long runs as well
+		}
+
+		ok &= Can_Bits_Length(&f) <= Can_Bits_Worst(&f);
+		ok &= Can_Bits_Worst(&f) <= 8 * bytes + (f.ext ? 64 : 44) + ((f.ext ? 54 : 34) + 8 * bytes - 1) / 4;
+
+		if(f.rtr)			// No data: the bound is the frame
+		{
+			ok &= Can_Bits_Length(&f) == Can_Bits_Worst(&f);
+		}
+	}
+
+	fail |= check_one("200000 random frames: exact <= bound <= classic", ok);
+
+	// Frame times of the table, no UART delays
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		table[i] = messages[i];
+		table[i].secured = 0;
+	}
+
+	table[0].delay_min_us = table[0].delay_max_us = 0;
+
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		time_message(i);
+	}
+
+	ok = 1;
+
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		ok &= length[i].best <= length[i].typical && length[i].typical <= length[i].worst && length[i].worst <= length[i].classic;
+	}
+
+	fail |= check_one("every message: best <= typical <= worst <= classic", ok);
+
+	// One pair: the result goes first, blocked by the longest lower priority frame at most
+	analyse(&cfg, 0);
+	block = 0;
+
+	for(uint32_t k = 1; k < n_copy; k++)
+	{
+		block = (copy[k].c > block) ? copy[k].c : block;
+	}
+
+	fail |= check_one("one pair: result within jitter + blocking + own frame", copy[0].r == copy[0].j + block + copy[0].c);
+	fail |= check_one("one pair at 4 s: every message within its period", analyse(&cfg, 0) == 0);
+
+	cfg.nodes = 512;
+	cfg.interval_ms = 10;
+	fail |= check_one("512 nodes, a round every 10 ms: overloaded", analyse(&cfg, 0) != 0 && copy[n_copy - 1].r == UINT64_MAX);
+
+	cfg = (Config_t){500, 64, 4000, 1000, 0};
+	ok = max_rate(&cfg) > 0;
+	cfg.nodes = 128;
+	cfg.interval_ms = max_rate(&cfg);
+	ok &= cfg.interval_ms > 0 && analyse(&cfg, 0) == 0;
+
+	if(cfg.interval_ms > 1)
+	{
+		cfg.interval_ms--;
+		ok &= analyse(&cfg, 0) != 0;
+	}
+	fail |= check_one("max rate: on time at the interval found, late 1 ms below", ok);
+
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Config_t cfg = {500, 2, 4000, 100, 0};
+	char line[100];
+	int opt;
+
+	if(argc > 1 && strcmp(argv[1], "check") == 0)
+	{
+		return check();
+	}
+
+	while((opt = getopt(argc, argv, "b:n:i:q:s")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b': cfg.kbits = strtoul(optarg, NULL, 0); break;
+			case 'n': cfg.nodes = strtoul(optarg, NULL, 0); break;
+			case 'i': cfg.interval_ms = strtoul(optarg, NULL, 0); break;
+			case 'q': cfg.stats_ms = strtoul(optarg, NULL, 0); break;
+			case 's': cfg.secure = 1; break;
+			default:
+				fprintf(stderr, "Usage: %s [-b kbit/s] [-n nodes] [-i round_interval_ms] [-q stats_interval_ms] [-s]\n       %s check\n", argv[0], argv[0]);
+				return 1;
+		}
+	}
+
+	if(cfg.kbits < 10 || cfg.kbits > 1000 || cfg.nodes < 2 || cfg.interval_ms < 1 || cfg.stats_ms < 1 || \
+	   (cfg.nodes + 1) / 2 * MESSAGES > MSG_MAX)
+	{
+		fprintf(stderr, "10 to 1000 kbit/s, 2 to %u nodes\n", (unsigned)(2 * (MSG_MAX / MESSAGES)));
+		return 1;
+	}
+
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		table[i] = messages[i];
+		table[i].secured &= cfg.secure;
+
+		if(table[i].secured)
+		{
+			table[i].dlc += SECURE_OVERHEAD;
+		}
+	}
+
+	// Disc's lines between the hand and the result: process_rx_msg(), shortest and longest hands
+	table[0].delay_min_us = (uint32_t)((uint64_t)(sprintf(line, "Message received. Nucleo's hand is %s\r\n", "Rock") + \
+							sprintf(line, "Disc's hand is %s\r\n", "Rock")) * UART_CHAR_NS / 1000);
+	table[0].delay_max_us = (uint32_t)((uint64_t)(sprintf(line, "Message received. Nucleo's hand is %s\r\n", "Scissors") + \
+							sprintf(line, "Disc's hand is %s\r\n", "Scissors")) * UART_CHAR_NS / 1000);
+	referee_us = table[0].delay_max_us + sprintf(line, "Sent message with game result: %s\r\n", "Error occurred") * UART_CHAR_NS / 1000;
+
+	for(uint16_t i = 0; i < MESSAGES; i++)
+	{
+		time_message(i);
+	}
+
+	report(&cfg);
+
+	return 0;
+}
@@ -0,0 +1,495 @@
+/**
+  ******************************************************************************
+  * @file    evolve.c
+  * @author  Moe2Code
+  * @brief   Offline evolution of the lookup-table player (evolved.c). A population of
+  *          tables is scored against every built-in strategy (strategy.c) and against the
+  *          opponents recorded in Disc UART captures ("Nucleo's hand is X" lines, replayed
+  *          as they were played). Fitness is the mean edge (wins - losses per round) over
+  *          the opponents, evaluated on all CPU cores. The best table is written as a C
+  *          flash table (evolved_table.c) for both boards.
+  *          Usage: ./evolve [-p population] [-g generations] [-r rounds] [-s sessions]
+  *                          [-t threads] [-S seed] [-o evolved_table.c] [capture.log ...]
+  * @note    All tables of a generation face the same opponent seeds, and the seeds change
+  *          every generation so a table cannot fit one lucky draw. The best table is scored
+  *          again on fresh seeds for the report
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "strategy.h"
+
+
+// Defines
+#define MAX_OPPONENTS		64			// Built-in strategies plus captures
+#define ELITES				2			// Best tables copied unchanged into the next generation
+#define TOURNAMENT			3			// Tables drawn per parent selection
+#define MUTATION			64			// One entry in MUTATION is redrawn
+
+
+// Typedefs
+// An opponent: a built-in strategy, or the recorded hands of a capture
+typedef struct
+{
+	const char *name;
+	uint8_t strategy;			// Strategy ID, STRATEGY_NO_HAND for a capture
+	uint8_t *hands;				// Capture hands
+	size_t n_hands;
+} Opponent_t;
+
+typedef struct
+{
+	uint8_t table[EVOLVED_TABLE_BYTES];
+	double fitness;
+	double edge[MAX_OPPONENTS];
+} Individual_t;
+
+
+// Global variables
+// Flash table of the boards, only read by the evolved strategy. The tool never plays it as an opponent
+const uint8_t evolved_table[EVOLVED_TABLE_BYTES] = {0};
+static Opponent_t opponents[MAX_OPPONENTS];
+static uint8_t n_opponents;
+static Individual_t *population, *next_population;
+static uint32_t population_size = 64, rounds = 2000, sessions = 4;
+static uint32_t eval_seed;		// Opponent seeds of the generation being evaluated
+static atomic_uint next_individual;
+
+
+/**
+  * @brief  xorshift32 of the evolution (selection, crossover, mutation)
+  * @param  s pointer to the generator state
+  * @retval Next value
+  */
+
+static uint32_t next_rand(uint32_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+
+	return *s;
+}
+
+
+/**
+  * @brief  Returns one 2-bit table entry
+  * @param  table packed table
+  * @param  i entry index (context)
+  * @retval Entry: hand, or EVOLVED_RANDOM
+  */
+
+static uint8_t get_entry(const uint8_t *table, uint32_t i)
+{
+	return (table[i / 4] >> (2 * (i % 4))) & 3;
+}
+
+
+/**
+  * @brief  Sets one 2-bit table entry
+  * @param  table packed table
+  * @param  i entry index (context)
+  * @param  e entry: hand, or EVOLVED_RANDOM
+  * @retval None
+  */
+
+static void set_entry(uint8_t *table, uint32_t i, uint8_t e)
+{
+	table[i / 4] = (uint8_t)((table[i / 4] & ~(3 << (2 * (i % 4)))) | (e << (2 * (i % 4))));
+}
+
+
+/**
+  * @brief  Plays a table against one opponent
+  * @param  table packed table
+  * @param  op opponent
+  * @param  seed seed of the session (both players)
+  * @retval Edge of the table: (wins - losses) / rounds
+  */
+
+static double play(const uint8_t *table, const Opponent_t *op, uint32_t seed)
+{
+	Evolved_State_t me;
+	Strategy_Player_t them;
+	uint8_t hm, ht;
+	long score = 0;
+	size_t n = (op->strategy == STRATEGY_NO_HAND) ? op->n_hands : rounds;
+
+	Evolved_Init(&me, table, seed);
+	if(op->strategy != STRATEGY_NO_HAND)
+	{
+		Strategy_Init(&them, op->strategy, seed * 2654435761u + 1);
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		hm = Evolved_Pick(&me);
+
+		if(op->strategy == STRATEGY_NO_HAND)
+		{
+			ht = op->hands[i];
+		}else
+		{
+			ht = Strategy_Pick(&them);
+			Strategy_Observe(&them, ht, hm);
+		}
+
+		score += (hm == (ht + 1) % 3) - (ht == (hm + 1) % 3);
+		Evolved_Observe(&me, hm, ht);
+	}
+
+	return (double)score / n;
+}
+
+
+/**
+  * @brief  Scores a table against every opponent with the seeds of the generation
+  * @param  ind pointer to the individual
+  * @param  seed opponent seeds of the generation
+  * @retval None
+  */
+
+static void evaluate(Individual_t *ind, uint32_t seed)
+{
+	ind->fitness = 0;
+
+	for(uint8_t o = 0; o < n_opponents; o++)
+	{
+		uint32_t n = (opponents[o].strategy == STRATEGY_NO_HAND) ? 1 : sessions;	// A capture replays the same way each time
+
+		ind->edge[o] = 0;
+		for(uint32_t s = 0; s < n; s++)
+		{
+			ind->edge[o] += play(ind->table, &opponents[o], seed + (o * sessions + s) * 0x9E3779B9u) / n;
+		}
+
+		ind->fitness += ind->edge[o] / n_opponents;
+	}
+}
+
+
+/**
+  * @brief  Worker thread: evaluates individuals until none is left
+  * @param  arg unused
+  * @retval NULL
+  */
+
+static void* worker(void *arg)
+{
+	uint32_t i;
+
+	(void)arg;
+
+	while((i = atomic_fetch_add(&next_individual, 1)) < population_size)
+	{
+		evaluate(&population[i], eval_seed);
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Evaluates the whole population on all threads
+  * @param  tid thread handles
+  * @param  threads number of threads
+  * @retval None
+  */
+
+static void evaluate_population(pthread_t *tid, long threads)
+{
+	atomic_store(&next_individual, 0);
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_create(&tid[t], NULL, worker, NULL);
+	}
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_join(tid[t], NULL);
+	}
+}
+
+
+/**
+  * @brief  Sorts individuals by decreasing fitness (qsort)
+  * @param  a first individual
+  * @param  b second individual
+  * @retval Order
+  */
+
+static int by_fitness(const void *a, const void *b)
+{
+	double fa = ((const Individual_t*)a)->fitness, fb = ((const Individual_t*)b)->fitness;
+
+	return (fa < fb) - (fa > fb);
+}
+
+
+/**
+  * @brief  Tournament selection on the sorted population: the best of TOURNAMENT draws
+  * @param  rng pointer to the evolution generator
+  * @retval Index of the parent
+  */
+
+static uint32_t select_parent(uint32_t *rng)
+{
+	uint32_t best = population_size, i;
+
+	for(uint8_t k = 0; k < TOURNAMENT; k++)
+	{
+		i = next_rand(rng) % population_size;
+		best = (i < best) ? i : best;		// Sorted: lower index is fitter
+	}
+
+	return best;
+}
+
+
+/**
+  * @brief  Adds the Nucleo hands of a Disc UART capture as a replayed opponent
+  * @param  path capture file
+  * @retval None
+  */
+
+static void load_capture(const char *path)
+{
+	const char *names[3] = {"Rock", "Paper", "Scissors"};
+	const char *marker = "Nucleo's hand is ";
+	Opponent_t *op = &opponents[n_opponents];
+	FILE *f = fopen(path, "r");
+	char line[256], *p;
+	size_t cap = 0;
+
+	if(f == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+
+	op->name = path;
+	op->strategy = STRATEGY_NO_HAND;
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		if((p = strstr(line, marker)) == NULL)
+		{
+			continue;
+		}
+
+		p += strlen(marker);
+
+		for(uint8_t h = 0; h < 3; h++)
+		{
+			if(strncmp(p, names[h], strlen(names[h])) == 0)
+			{
+				if(op->n_hands == cap)
+				{
+					cap = cap ? 2 * cap : 4096;
+					op->hands = realloc(op->hands, cap);
+
+					if(op->hands == NULL)
+					{
+						fprintf(stderr, "Out of memory\n");
+						exit(1);
+					}
+				}
+
+				op->hands[op->n_hands++] = h;
+			}
+		}
+	}
+
+	fclose(f);
+	printf("%s: %zu hands\n", path, op->n_hands);
+
+	if(op->n_hands > 0)
+	{
+		n_opponents++;
+	}
+}
+
+
+/**
+  * @brief  Writes the table as the C flash table of the boards
+  * @param  path output file
+  * @param  best best individual, scored on fresh seeds
+  * @param  generations generations evolved
+  * @retval 0 on success, 1 if the file cannot be written
+  */
+
+static int write_table(const char *path, const Individual_t *best, uint32_t generations)
+{
+	FILE *out = fopen(path, "w");
+
+	if(out == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+
+	fprintf(out, "/**\n");
+	fprintf(out, "  ******************************************************************************\n");
+	fprintf(out, "  * @file    evolved_table.c\n");
+	fprintf(out, "  * @author  Moe2Code\n");
+	fprintf(out, "  * @brief   Lookup table of the evolved player (evolved.c), kept in flash.\n");
+	fprintf(out, "  *          Generated by Host_Tools/evolve (%u tables, %u generations); do not edit.\n", population_size, generations);
+	fprintf(out, "  *          Edge (wins - losses per round) on fresh seeds: mean %+.4f\n", best->fitness);
+
+	for(uint8_t o = 0; o < n_opponents; o++)
+	{
+		fprintf(out, "  *          %-10s %+.4f\n", opponents[o].name, best->edge[o]);
+	}
+
+	fprintf(out, "  */\n\n");
+	fprintf(out, "// Includes\n#include \"evolved.h\"\n\n\n");
+	fprintf(out, "// Global variables\n");
+	fprintf(out, "// Entry of context c: bits 2*(c %% 4) of byte c / 4. 0-2 = hand, 3 = random hand\n");
+	fprintf(out, "const uint8_t evolved_table[EVOLVED_TABLE_BYTES] =\n{\n");
+
+	for(uint32_t i = 0; i < EVOLVED_TABLE_BYTES; i++)
+	{
+		fprintf(out, "%s0x%02X,%s", (i % 16) ? " " : "\t", best->table[i], (i % 16 == 15) ? "\n" : "");
+	}
+
+	fprintf(out, "%s};\n", (EVOLVED_TABLE_BYTES % 16) ? "\n" : "");
+	fclose(out);
+
+	printf("Wrote %s\n", path);
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	uint32_t generations = 100, seed = 1, rng;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *out_path = "evolved_table.c";
+	Individual_t *swap;
+	pthread_t *tid;
+	int opt;
+
+	while((opt = getopt(argc, argv, "p:g:r:s:t:S:o:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'p': population_size = strtoul(optarg, NULL, 0); break;
+			case 'g': generations = strtoul(optarg, NULL, 0); break;
+			case 'r': rounds = strtoul(optarg, NULL, 0); break;
+			case 's': sessions = strtoul(optarg, NULL, 0); break;
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			case 'S': seed = strtoul(optarg, NULL, 0); break;
+			case 'o': out_path = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-p population] [-g generations] [-r rounds] [-s sessions] "
+						"[-t threads] [-S seed] [-o evolved_table.c] [capture.log ...]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(threads < 1 || population_size <= ELITES || rounds < 1 || sessions < 1 || seed == 0)
+	{
+		fprintf(stderr, "Need at least 1 thread, %u tables, 1 round, 1 session and a nonzero seed\n", ELITES + 1);
+		return 1;
+	}
+
+	for(uint8_t id = 0; id < STRATEGY_COUNT; id++)
+	{
+		if(id != STRATEGY_EVOLVED)
+		{
+			opponents[n_opponents].name = Strategy_Name(id);
+			opponents[n_opponents++].strategy = id;
+		}
+	}
+
+	for(int a = optind; a < argc && n_opponents < MAX_OPPONENTS; a++)
+	{
+		load_capture(argv[a]);
+	}
+
+	population = calloc(population_size, sizeof(Individual_t));
+	next_population = calloc(population_size, sizeof(Individual_t));
+	tid = calloc(threads, sizeof(pthread_t));
+
+	if(population == NULL || next_population == NULL || tid == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	// Table 0 plays random hands everywhere (edge 0 against anyone); the rest are random tables
+	rng = seed;
+	memset(population[0].table, 0xFF, EVOLVED_TABLE_BYTES);
+	for(uint32_t i = 1; i < population_size; i++)
+	{
+		for(uint32_t c = 0; c < EVOLVED_CONTEXTS; c++)
+		{
+			set_entry(population[i].table, c, next_rand(&rng) & 3);
+		}
+	}
+
+	for(uint32_t g = 0; g < generations; g++)
+	{
+		eval_seed = seed + g * 0x85EBCA6Bu;
+		evaluate_population(tid, threads);
+		qsort(population, population_size, sizeof(Individual_t), by_fitness);
+
+		if(g % 10 == 0 || g == generations - 1)
+		{
+			printf("generation %4u: best %+.4f, median %+.4f\n", g, population[0].fitness, population[population_size / 2].fitness);
+		}
+
+		if(g == generations - 1)
+		{
+			break;
+		}
+
+		for(uint32_t i = 0; i < population_size; i++)
+		{
+			if(i < ELITES)
+			{
+				next_population[i] = population[i];
+				continue;
+			}
+
+			const uint8_t *pa = population[select_parent(&rng)].table;
+			const uint8_t *pb = population[select_parent(&rng)].table;
+
+			for(uint32_t c = 0; c < EVOLVED_CONTEXTS; c++)		// Uniform crossover, then mutation
+			{
+				uint32_t r = next_rand(&rng);
+				uint8_t e = get_entry((r & 1) ? pa : pb, c);
+
+				if((r >> 1) % MUTATION == 0)
+				{
+					e = (r >> 8) & 3;
+				}
+
+				set_entry(next_population[i].table, c, e);
+			}
+		}
+
+		swap = population;
+		population = next_population;
+		next_population = swap;
+	}
+
+	// Report the best table on seeds it never saw
+	sessions *= 4;
+	evaluate(&population[0], seed ^ 0xA5A5A5A5u);
+
+	printf("\nBest table on fresh seeds: mean edge %+.4f\n", population[0].fitness);
+	for(uint8_t o = 0; o < n_opponents; o++)
+	{
+		printf("%-10s %+.4f\n", opponents[o].name, population[0].edge[o]);
+	}
+
+	return write_table(out_path, &population[0], generations);
+}
@@ -0,0 +1,548 @@
+/**
+  ******************************************************************************
+  * @file    export_rx.c
+  * @author  Moe2Code
+  * @brief   PC receiver of Nucleo's bulk history export (export.c). Asks for an export,
+  *          acknowledges every block, asks again from the first missing or damaged block
+  *          (go-back-N) and resumes by itself when the stream stops. The output is the
+  *          history region of the backup SRAM, ready for ./history_tool decode.
+  *          Usage: ./export_rx /dev/ttyACM0 history.bin [baud]
+  *                 ./export_rx sim [bytes] [error rate] [seed]
+  *          sim runs the board's sender (export.c) against this receiver over a simulated
+  *          full-duplex UART with USB latency, byte corruption and byte loss on both
+  *          directions, checks the result and reports the use of the line rate
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "export.h"
+
+
+// Defines
+#define MAX_TIMEOUTS		20			// Timeouts in a row before giving up
+#define SIM_LATENCY			24			// USB round trip of the ST-LINK virtual COM port, in byte times (2 ms)
+#define SIM_TEXT			"Nucleo initialization successful\r\n"	// Game text the board printed before the export
+
+
+// Typedefs
+// Receiver state
+typedef struct
+{
+	uint8_t *out;				// Export assembled so far
+	uint32_t size;				// Its size, known once the last block is in
+	uint16_t id;				// Export ID, 0 until the first block 0 is in
+	uint16_t blocks;
+	uint16_t expected;			// Next block to store
+	uint16_t naked;				// Block the last NAK asked for, 0xFFFF if none is pending
+	uint16_t last_seq;			// Number of the last valid block
+	uint8_t resync;				// 1 while looking for a block after a damaged one
+	uint8_t frame[EXPORT_FRAME_SIZE];	// Block being received
+	uint16_t len;
+	uint32_t crc_errors, naks, timeouts, restarts;
+} Receiver_t;
+
+
+/**
+  * @brief  Returns a monotonic timestamp in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Acts on a valid block
+  * @param  r pointer to the receiver state
+  * @param  hdr block header
+  * @param  ctrl receives the control frame to send back
+  * @retval 1 if ctrl must be sent, 0 otherwise
+  */
+
+static int rx_block(Receiver_t *r, const Export_Block_t *hdr, uint8_t ctrl[EXPORT_CTRL_SIZE])
+{
+	if(hdr->id != r->id)
+	{
+		if(hdr->seq != 0)		// Tail of an older export: wait for the new one
+		{
+			return 0;
+		}
+
+		free(r->out);
+		r->out = calloc(hdr->blocks, EXPORT_PAYLOAD);
+
+		if(r->out == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+
+		r->restarts += (r->id != 0);
+		r->id = hdr->id;
+		r->blocks = hdr->blocks;
+		r->expected = 0;
+		r->size = 0;
+		r->naked = 0xFFFF;
+		r->last_seq = 0;
+	}
+
+	if(hdr->seq <= r->last_seq)		// The board went back: it acted on the last NAK, another one may follow
+	{
+		r->naked = 0xFFFF;
+	}
+
+	r->last_seq = hdr->seq;
+
+	if(hdr->seq == r->expected)
+	{
+		memcpy(r->out + (uint32_t)hdr->seq * EXPORT_PAYLOAD, &r->frame[EXPORT_HEADER], hdr->used);
+		r->size = (uint32_t)hdr->seq * EXPORT_PAYLOAD + hdr->used;
+		r->expected++;
+		r->naked = 0xFFFF;
+		Export_BuildControl(ctrl, EXPORT_ACK, r->expected, r->id);
+
+		return 1;
+	}
+
+	if(hdr->seq > r->expected && r->naked != r->expected)		// A block went missing: once per gap
+	{
+		r->naked = r->expected;
+		r->naks++;
+		Export_BuildControl(ctrl, EXPORT_NAK, r->expected, r->id);
+
+		return 1;
+	}
+
+	return 0;		// Duplicate, or the rest of the window after a NAK
+}
+
+
+/**
+  * @brief  Feeds a byte from the board. Anything outside a valid block (game text, damaged
+  * 		blocks) is skipped
+  * @param  r pointer to the receiver state
+  * @param  byte byte received
+  * @param  ctrl receives the control frame to send back
+  * @retval 1 if ctrl must be sent, 2 if a block was stored (ctrl must be sent too), 0 otherwise
+  */
+
+static int rx_byte(Receiver_t *r, uint8_t byte, uint8_t ctrl[EXPORT_CTRL_SIZE])
+{
+	Export_Block_t hdr;
+	uint16_t expected = r->expected, id = r->id, i;
+	int send;
+
+	if(r->len == 0 && byte != EXPORT_SOH)
+	{
+		return 0;
+	}
+
+	r->frame[r->len++] = byte;
+
+	if(r->len < EXPORT_FRAME_SIZE)
+	{
+		return 0;
+	}
+
+	if(Export_CheckBlock(r->frame, &hdr))
+	{
+		r->len = 0;
+		r->resync = 0;
+		send = rx_block(r, &hdr, ctrl);
+
+		return (send && (r->expected != expected || r->id != id)) ? 2 : send;
+	}
+
+	r->crc_errors += (r->resync == 0);		// False starts on SOH bytes while resynchronizing are not counted
+	r->resync = 1;
+
+	for(i = 1; i < r->len && r->frame[i] != EXPORT_SOH; i++);		// Resynchronize on the next SOH
+
+	memmove(r->frame, &r->frame[i], r->len - i);
+	r->len -= i;
+
+	if(r->id != 0 && r->naked != r->expected)
+	{
+		r->naked = r->expected;
+		r->naks++;
+		Export_BuildControl(ctrl, EXPORT_NAK, r->expected, r->id);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Builds the control frame sent when the stream stopped: a new export is asked for
+  * 		until one is under way, then the current one is resumed
+  * @param  r pointer to the receiver state
+  * @param  ctrl receives the control frame
+  * @retval None
+  */
+
+static void rx_timeout(Receiver_t *r, uint8_t ctrl[EXPORT_CTRL_SIZE])
+{
+	r->timeouts++;
+	r->naked = 0xFFFF;
+	Export_BuildControl(ctrl, EXPORT_START, r->expected, r->id);
+}
+
+
+/**
+  * @brief  Returns 1 once the whole export is in
+  * @param  r pointer to the receiver state
+  * @retval 1 if done, 0 otherwise
+  */
+
+static int rx_done(const Receiver_t *r)
+{
+	return (r->id != 0 && r->expected == r->blocks);
+}
+
+
+/**
+  * @brief  Prints the transfer counters
+  * @param  r pointer to the receiver state
+  * @param  seconds transfer time
+  * @param  baud line rate (10 bits per byte)
+  * @retval None
+  */
+
+static void report(const Receiver_t *r, double seconds, double baud)
+{
+	printf("%u bytes in %u blocks in %.2f s: %.0f B/s, %.1f%% of the line rate\n", r->size, r->blocks, seconds, \
+		   r->size / seconds, 100.0 * r->size / seconds / (baud / 10));
+	printf("CRC errors %u, NAKs %u, timeouts %u, restarts %u\n", r->crc_errors, r->naks, r->timeouts, r->restarts);
+}
+
+
+/**
+  * @brief  Maps a baud rate to its termios speed
+  * @param  baud baud rate
+  * @retval Speed, B0 if not supported
+  */
+
+static speed_t baud_speed(long baud)
+{
+	switch(baud)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 921600:	return B921600;
+		default:		return B0;
+	}
+}
+
+
+/**
+  * @brief  Receives an export from the board
+  * @param  dev serial device (ST-LINK virtual COM port of the Nucleo)
+  * @param  path output file
+  * @param  baud baud rate of the board's USART2
+  * @retval 0 on success
+  */
+
+static int receive(const char *dev, const char *path, long baud)
+{
+	Receiver_t r = {0};
+	struct termios tio;
+	struct pollfd pfd;
+	uint8_t buf[512], ctrl[EXPORT_CTRL_SIZE];
+	double t0, last, timeout = 0.1 + 3.0 * EXPORT_WINDOW * EXPORT_FRAME_SIZE * 10 / baud;
+	uint32_t timeouts = 0;
+	ssize_t n;
+	FILE *f;
+	int fd = open(dev, O_RDWR | O_NOCTTY);
+
+	if(fd < 0 || tcgetattr(fd, &tio) != 0 || baud_speed(baud) == B0)
+	{
+		(fd < 0 || baud_speed(baud) != B0) ? perror(dev) : (void)fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+		return 1;
+	}
+
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, baud_speed(baud));
+	cfsetospeed(&tio, baud_speed(baud));
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	tcsetattr(fd, TCSANOW, &tio);
+	tcflush(fd, TCIOFLUSH);
+
+	r.naked = 0xFFFF;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	t0 = last = now_s();
+	rx_timeout(&r, ctrl);
+	r.timeouts = 0;
+	write(fd, ctrl, EXPORT_CTRL_SIZE);
+
+	while(!rx_done(&r))
+	{
+		if(poll(&pfd, 1, 10) < 0 && errno != EINTR)
+		{
+			perror("poll");
+			return 1;
+		}
+
+		n = read(fd, buf, sizeof(buf));
+
+		for(ssize_t i = 0; i < n; i++)
+		{
+			int res = rx_byte(&r, buf[i], ctrl);
+
+			if(res != 0)
+			{
+				write(fd, ctrl, EXPORT_CTRL_SIZE);
+			}
+
+			if(res == 2)
+			{
+				last = now_s();
+				timeouts = 0;
+			}
+		}
+
+		if(!rx_done(&r) && now_s() - last > timeout)
+		{
+			if(++timeouts > MAX_TIMEOUTS)
+			{
+				fprintf(stderr, "No answer from the board (%u of %u blocks)\n", r.expected, r.blocks);
+				Export_BuildControl(ctrl, EXPORT_CANCEL, 0, r.id);		// Lets the board print again
+				write(fd, ctrl, EXPORT_CTRL_SIZE);
+				return 1;
+			}
+
+			rx_timeout(&r, ctrl);
+			write(fd, ctrl, EXPORT_CTRL_SIZE);
+			last = now_s();
+		}
+	}
+
+	report(&r, now_s() - t0, baud);
+	close(fd);
+
+	f = fopen(path, "wb");
+	if(f == NULL || fwrite(r.out, 1, r.size, f) != r.size)
+	{
+		perror(path);
+		return 1;
+	}
+
+	fclose(f);
+	free(r.out);
+	printf("Wrote %s\n", path);
+
+	return 0;
+}
+
+
+// Simulated link: bytes reach the other end SIM_LATENCY byte times after they were sent
+typedef struct
+{
+	uint8_t byte[4096];
+	uint32_t due[4096];
+	uint32_t head, tail;
+} Link_t;
+
+
+/**
+  * @brief  Sends a byte over a simulated link, corrupted or lost now and then
+  * @param  l pointer to the link
+  * @param  byte byte to send
+  * @param  now current time in byte times
+  * @param  error_rate probability of a damaged byte (a quarter of them are lost)
+  * @param  rng pointer to the generator state (xorshift32)
+  * @retval None
+  */
+
+static void link_send(Link_t *l, uint8_t byte, uint32_t now, double error_rate, uint32_t *rng)
+{
+	*rng ^= *rng << 13;
+	*rng ^= *rng >> 17;
+	*rng ^= *rng << 5;
+
+	if(*rng < error_rate * 4294967296.0)
+	{
+		if(*rng % 4 == 0)
+		{
+			return;
+		}
+
+		byte ^= 1 << (*rng >> 8) % 8;
+	}
+
+	l->byte[l->head % 4096] = byte;
+	l->due[l->head % 4096] = now + SIM_LATENCY;
+	l->head++;
+}
+
+
+/**
+  * @brief  Runs an export over the simulated link and checks it
+  * @param  size bytes to export
+  * @param  error_rate probability of a damaged byte on each direction
+  * @param  seed seed of the data and of the errors
+  * @retval 0 if the export arrived intact
+  */
+
+static int simulate(uint32_t size, double error_rate, uint32_t seed)
+{
+	static Link_t down, up;
+	static Export_t x;
+	static uint8_t frame[EXPORT_FRAME_SIZE];
+	Receiver_t r = {0};
+	uint8_t ctrl[EXPORT_CTRL_SIZE], pending[16][EXPORT_CTRL_SIZE];
+	uint32_t rng = (seed != 0) ? seed : 1, now, last = 0, tx_len = 0, tx_pos = 0, up_pos = 0, n_pending = 0;
+	uint32_t timeout = 3 * EXPORT_WINDOW * EXPORT_FRAME_SIZE + 2 * SIM_LATENCY, timeouts = 0;
+	uint8_t *data = malloc(size);
+	const char *text = SIM_TEXT;
+
+	if(data == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for(uint32_t i = 0; i < size; i++)
+	{
+		data[i] = (uint8_t)((i * 2654435761u) >> 24);
+	}
+
+	Export_Init(&x);
+	r.naked = 0xFFFF;
+	rx_timeout(&r, pending[n_pending++]);
+	r.timeouts = 0;
+
+	for(now = 0; !rx_done(&r); now++)		// One byte time per step, both directions
+	{
+		if(now > 100u * size + 1000000)
+		{
+			fprintf(stderr, "FAIL: export stuck at block %u of %u\n", r.expected, r.blocks);
+			return 1;
+		}
+
+		// Board: game text, then blocks back to back as the DMA would send them
+		if(*text != '\0')
+		{
+			link_send(&down, (uint8_t)*text++, now, error_rate, &rng);
+		}else if(tx_pos < tx_len)
+		{
+			link_send(&down, frame[tx_pos++], now, error_rate, &rng);
+		}else if((tx_len = Export_NextFrame(&x, frame)) != 0)
+		{
+			Export_Sent(&x);
+			tx_pos = 0;
+			link_send(&down, frame[tx_pos++], now, error_rate, &rng);
+		}
+
+		while(up.tail != up.head && up.due[up.tail % 4096] <= now)
+		{
+			if(Export_RxByte(&x, up.byte[up.tail++ % 4096]) == EXPORT_START)
+			{
+				Export_Begin(&x, data, size, (uint16_t)(rng >> 16));
+			}
+		}
+
+		// PC: control frames go out one byte per byte time
+		if(n_pending > 0)
+		{
+			link_send(&up, pending[0][up_pos++], now, error_rate, &rng);
+
+			if(up_pos == EXPORT_CTRL_SIZE)
+			{
+				up_pos = 0;
+				memmove(pending[0], pending[1], --n_pending * EXPORT_CTRL_SIZE);
+			}
+		}
+
+		while(down.tail != down.head && down.due[down.tail % 4096] <= now)
+		{
+			int res = rx_byte(&r, down.byte[down.tail++ % 4096], ctrl);
+
+			if(res != 0 && n_pending < 16)
+			{
+				memcpy(pending[n_pending++], ctrl, EXPORT_CTRL_SIZE);
+			}
+
+			if(res == 2)
+			{
+				last = now;
+				timeouts = 0;
+			}
+		}
+
+		if(!rx_done(&r) && now - last > timeout)
+		{
+			if(++timeouts > MAX_TIMEOUTS)
+			{
+				fprintf(stderr, "FAIL: no answer from the board (%u of %u blocks)\n", r.expected, r.blocks);
+				return 1;
+			}
+
+			rx_timeout(&r, ctrl);
+
+			if(n_pending < 16)
+			{
+				memcpy(pending[n_pending++], ctrl, EXPORT_CTRL_SIZE);
+			}
+
+			last = now;
+		}
+	}
+
+	if(r.size != size || memcmp(r.out, data, size) != 0)
+	{
+		fprintf(stderr, "FAIL: %u bytes received, %u expected, or content differs\n", r.size, size);
+		return 1;
+	}
+
+	report(&r, now / 11520.0, 115200);
+	printf("Blocks sent again by the board: %u\n", x.resent);
+	printf("PASS\n");
+
+	free(data);
+	free(r.out);
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 2 && strcmp(argv[1], "sim") == 0)
+	{
+		return simulate((argc >= 3) ? strtoul(argv[2], NULL, 0) : 65536, (argc >= 4) ? atof(argv[3]) : 0.0, \
+						(argc >= 5) ? strtoul(argv[4], NULL, 0) : 1);
+	}
+
+	if(argc >= 3)
+	{
+		return receive(argv[1], argv[2], (argc >= 4) ? atol(argv[3]) : 115200);
+	}
+
+	fprintf(stderr, "Usage: %s /dev/ttyACM0 history.bin [baud]\n       %s sim [bytes] [error rate] [seed]\n", argv[0], argv[0]);
+
+	return 1;
+}
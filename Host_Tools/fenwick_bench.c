@@ -0,0 +1,257 @@
+/**
+  ******************************************************************************
+  * @file    fenwick_bench.c
+  * @author  Moe2Code
+  * @brief   Check and benchmark of Nucleo's round index (fenwick.c).
+  *          check: rounds with random results and minute gaps are added to an index that
+  *                 starts mid-slot; every few rounds a random round range and a random
+  *                 "last minutes" range are counted by the index and by a scan of all the
+  *                 rounds, through several laps of the window
+  *          bench: ns per added round and per range query, against the scan a query
+  *                 would take without the index
+  *          Usage: ./fenwick_bench [rounds] [queries] [seed]
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fenwick.h"
+
+
+// Defines
+#define FIRST_ROUND			12345		// Not a multiple of FENWICK_SLOT_ROUNDS: the first slot is partial
+#define CHECK_EVERY			61			// Rounds between checked queries
+#define ROUNDS_PER_MINUTE	15			// One round per 4 s
+
+
+// Global variables
+static Fenwick_Index_t ix;
+static uint8_t *results;				// Game result of round FIRST_ROUND + i
+static uint32_t *minutes;				// Minute it was played in
+static uint32_t rng;
+
+
+/**
+  * @brief  Returns a monotonic timestamp in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Returns the next random number (xorshift32)
+  * @param  None
+  * @retval Random number
+  */
+
+static uint32_t next_rand(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+
+	return rng;
+}
+
+
+/**
+  * @brief  Counts the results of the rounds first to first + count - 1 one by one, clipped
+  * 		like Fenwick_Query() to the rounds still indexed
+  * @param  first number of the first round
+  * @param  count number of rounds
+  * @param  sums receives the count of each result
+  * @retval Rounds counted
+  */
+
+static uint32_t scan(uint32_t first, uint32_t count, uint32_t sums[FENWICK_COUNTERS])
+{
+	uint32_t a = first, b = first + count;
+
+	memset(sums, 0, FENWICK_COUNTERS * sizeof(uint32_t));
+
+	if(b < a || b > ix.next_round)
+	{
+		b = ix.next_round;
+	}
+
+	if(a < ix.first_round)
+	{
+		a = ix.first_round;
+	}
+
+	for(uint32_t r = a; r < b; r++)
+	{
+		sums[results[r - FIRST_ROUND] - 1]++;
+	}
+
+	return (a < b) ? b - a : 0;
+}
+
+
+/**
+  * @brief  Compares the counts of the index with those of the scan and exits on a mismatch
+  * @param  what description of the query
+  * @param  got rounds counted by the index
+  * @param  got_sums counts of the index
+  * @param  want rounds counted by the scan
+  * @param  want_sums counts of the scan
+  * @retval None
+  */
+
+static void compare(const char *what, uint32_t got, const uint32_t got_sums[FENWICK_COUNTERS], uint32_t want, \
+					const uint32_t want_sums[FENWICK_COUNTERS])
+{
+	if(got == want && memcmp(got_sums, want_sums, FENWICK_COUNTERS * sizeof(uint32_t)) == 0)
+	{
+		return;
+	}
+
+	fprintf(stderr, "FAIL %s at round %u: %u rounds N %u D %u T %u E %u, expected %u rounds N %u D %u T %u E %u\n", \
+			what, ix.next_round, got, got_sums[0], got_sums[1], got_sums[2], got_sums[3], \
+			want, want_sums[0], want_sums[1], want_sums[2], want_sums[3]);
+	exit(1);
+}
+
+
+/**
+  * @brief  Adds rounds with random results and minute gaps, checking random queries
+  * @param  rounds rounds to add
+  * @retval Queries checked
+  */
+
+static uint32_t check(uint32_t rounds)
+{
+	uint32_t got[FENWICK_COUNTERS], want[FENWICK_COUNTERS], minute = 1000, first, count, back, start, n, checked = 0;
+
+	Fenwick_Init(&ix, FIRST_ROUND);
+
+	for(uint32_t i = 0; i < rounds; i++)
+	{
+		if(next_rand() % ROUNDS_PER_MINUTE == 0)		// Next minute, now and then after a pause
+		{
+			minute += (next_rand() % 64 == 0) ? 1 + next_rand() % (2 * FENWICK_MINUTES) : 1;
+		}
+
+		Fenwick_Tick(&ix, minute);
+		results[i] = 1 + next_rand() % FENWICK_COUNTERS;
+		minutes[i] = minute;
+		Fenwick_Add(&ix, results[i]);
+
+		if(i % CHECK_EVERY != 0)
+		{
+			continue;
+		}
+
+		// Round range, partly outside the window now and then
+		first = ix.next_round - next_rand() % (FENWICK_ROUNDS + 64);
+		count = next_rand() % (FENWICK_ROUNDS + 64);
+		n = Fenwick_Query(&ix, first, count, got);
+		compare("round range", n, got, scan(first, count, want), want);
+
+		// Last minutes: the rounds played from the first minute kept by the index on
+		back = 1 + next_rand() % (FENWICK_MINUTES + 16);
+		n = Fenwick_QueryMinutes(&ix, back, minute, got);
+		start = (back > minute - ix.first_minute) ? ix.first_minute : minute - back + 1;
+		start = (minute - start >= FENWICK_MINUTES) ? minute - FENWICK_MINUTES + 1 : start;
+		first = ix.next_round;
+
+		while(first > ix.first_round && minutes[first - 1 - FIRST_ROUND] >= start)
+		{
+			first--;
+		}
+
+		compare("last minutes", n, got, scan(first, ix.next_round - first, want), want);
+		checked += 2;
+	}
+
+	return checked;
+}
+
+
+int main(int argc, char *argv[])
+{
+	uint32_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+	uint32_t queries = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1000000;
+	uint32_t seed = (argc > 3) ? strtoul(argv[3], NULL, 0) : 1;
+	uint32_t check_rounds = (rounds < 1000000) ? rounds : 1000000, sums[FENWICK_COUNTERS], *first, *count;
+	volatile uint32_t sink = 0;
+	double t0, add_ns, query_ns, scan_ns;
+
+	rng = (seed != 0) ? seed : 1;
+	results = malloc(rounds);
+	minutes = malloc(rounds * sizeof(uint32_t));
+	first = malloc(queries * sizeof(uint32_t));
+	count = malloc(queries * sizeof(uint32_t));
+
+	if(results == NULL || minutes == NULL || first == NULL || count == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	printf("Checked %u queries over %u rounds (window %u rounds, %zu bytes of RAM)\n", check(check_rounds), \
+		   check_rounds, FENWICK_ROUNDS, sizeof(Fenwick_Index_t));
+
+	// Adds, one round per call as on the board
+	for(uint32_t i = 0; i < rounds; i++)
+	{
+		results[i] = 1 + next_rand() % FENWICK_COUNTERS;
+	}
+
+	Fenwick_Init(&ix, FIRST_ROUND);
+	t0 = now_s();
+
+	for(uint32_t i = 0; i < rounds; i++)
+	{
+		Fenwick_Add(&ix, results[i]);
+	}
+
+	add_ns = (now_s() - t0) * 1e9 / rounds;
+
+	// Queries over random ranges of the window
+	for(uint32_t q = 0; q < queries; q++)
+	{
+		count[q] = 1 + next_rand() % (ix.next_round - ix.first_round);
+		first[q] = ix.next_round - count[q] - next_rand() % (ix.next_round - ix.first_round - count[q] + 1);
+	}
+
+	t0 = now_s();
+
+	for(uint32_t q = 0; q < queries; q++)
+	{
+		sink += Fenwick_Query(&ix, first[q], count[q], sums) + sums[FENWICK_TIES];
+	}
+
+	query_ns = (now_s() - t0) * 1e9 / queries;
+	t0 = now_s();
+
+	for(uint32_t q = 0; q < queries / 100 + 1; q++)		// Slow: a sample is enough
+	{
+		sink += scan(first[q], count[q], sums) + sums[FENWICK_TIES];
+	}
+
+	scan_ns = (now_s() - t0) * 1e9 / (queries / 100 + 1);
+
+	printf("%u rounds added: %.1f ns per round\n", rounds, add_ns);
+	printf("%u queries: %.1f ns per query (scan of the rounds: %.0f ns, %.0fx)\n", queries, query_ns, scan_ns, \
+		   scan_ns / query_ns);
+	printf("PASS\n");
+
+	free(results);
+	free(minutes);
+	free(first);
+	free(count);
+
+	return (int)(sink & 0);
+}
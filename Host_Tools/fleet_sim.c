@@ -0,0 +1,1492 @@
+/**
+  ******************************************************************************
+  * @file    fleet_sim.c
+  * @author  Moe2Code
+  * @brief   Fleet simulation for capacity planning: many players (Nucleo) and referees (Disc)
+  *          on shared CAN buses, in virtual time, spread over all CPU cores.
+  *          The following is conducted in source file:
+  *          + Node logic of the boards: a player sends its hand on its TIM6 tick (4 s by
+  *            default, from a random button press and with its own crystal drift) and counts
+  *            the results it never got; a referee takes hands from its 3-deep Rx FIFO (new
+  *            frames overwrite the last one when full, as RFLM = 0), picks its hand and answers
+  *            once its blocking UART lines are out. Hands come from strategy.c, the code the
+  *            boards run. 3 Tx mailboxes per node; a node with none free stops, as the boards
+  *            do in Error_handler()
+  *          + Bus: arbitration on the identifier, bit exact frame lengths (can_bits.c),
+  *            intermission. Each player of a bus has its own slot: hand ID 0x49F + slot,
+  *            result ID 0x111 + slot, so 256 players at most per bus
+  *          + Work-stealing pool, in two phases per second of virtual time: every worker starts
+  *            on its share of the tasks and takes tasks from the others once it is done.
+  *            Phase 1 runs each bus (wire and node events) in one event loop, which is exact
+  *            and needs no locking. Phase 2 runs the strategy work the buses left behind in
+  *            chunks of JOB_CHUNK nodes, whatever bus they are on: a node's next hand is
+  *            fixed once it has seen the last round (Strategy_Observe() then
+  *            Strategy_Pick()), so it is worked out ahead and a crowded bus spreads over
+  *            all workers. A hand needed before its job ran is worked out in phase 1.
+  *            Results are summed in bus order, so a run gives the same numbers and digest
+  *            whatever the number of threads
+  *          + -o: the frames of all buses merged in time order (bus number, then order on the
+  *            bus, for equal times), one second of virtual time at a time
+  *          Reports per fleet size: nodes, bus load, rounds per second, latency from the tick
+  *          of the hand to the result received (percentiles), lost results, referee Rx
+  *          overruns and stopped nodes.
+  *          Usage: ./fleet_sim [-n players] [-b buses] [-r players_per_referee] [-i interval_ms]
+  *                             [-T seconds] [-t threads] [-S seed] [-o trace.csv]
+  *                 ./fleet_sim bench [same options]
+  *                 ./fleet_sim check
+  *          The fleet doubles from 2 players up to -n, over -b buses (fewer if there are
+  *          fewer players). -o runs the -n fleet alone. bench runs one fleet (8192 players on
+  *          256 buses for an hour unless told otherwise) with 1 thread up to -t and reports
+  *          the speedup. check: one pair against the board timing, the
+  *          same fleet with 1 and 8 threads, a saturated bus, an overloaded referee and the
+  *          merged trace.
+  * @note    A model, not the firmware: only strategy.c is the code the boards run, the rest
+  *          is written again here from both main_.c (board_sim runs the firmware itself, for
+  *          one pair). Its limits:
+  *          + A referee has one 3-deep Rx FIFO and receives only the hands of its players.
+  *            Disc takes every frame of the bus through its catch-all filter bank, drains
+  *            FIFO0 and FIFO1 and moves that bank to FIFO1 in a burst (CAN_Set_Burst_Mode()):
+  *            overruns here are those of a referee with no FIFO1
+  *          + Game frames only: no stats, sleep, session or time-triggered frames
+  *          + Node logic takes no time except the UART lines a referee prints before and
+  *            after its answer (blocking on Disc). Players' own UART lines are left out: they
+  *            do not hold up the next hand
+  *          + No bus errors
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "strategy.h"
+#include "can_bits.h"
+
+
+// Defines
+#define NS_PER_S			1000000000ULL
+#define BIT_NS				2000		// 500 kbit/s: prescaler 5, 1 + 8 + 1 quanta at 25 MHz on both boards
+#define UART_CHAR_NS		86806		// 115200 baud, 10 bits per character
+#define ID_RESULT			0x111		// IDs of slot 0. Slot s uses ID + s
+#define ID_HAND				0x49F
+#define SLOTS				256			// Players per bus: hand IDs stay below 0x633
+#define MAILBOXES			3
+#define FIFO_DEPTH			3
+#define DRIFT_PPM			50			// Crystal tolerance: each player's tick is off by up to this much
+#define LAT_SUB_BITS		6			// Latency histogram: 64 bins per power of two of us (1.6%)
+#define LAT_SUB				(1 << LAT_SUB_BITS)
+#define LAT_BINS			(LAT_SUB * 36)
+#define JOB_EPOCH			NS_PER_S	// Virtual time run between two phases of strategy work and merges of the trace
+#define JOB_CHUNK			64			// Nodes of a task in that phase
+
+// Strategy work of a node (Node_t job)
+#define JOB_NONE			0
+#define JOB_PICK			1			// Next hand from the history as it is
+#define JOB_OBSERVE_PICK	2			// Last round into the history, then the next hand
+
+// Events of a bus
+#define EV_TICK				0			// Player: TIM6 update, the hand goes out
+#define EV_ARB				1			// Bus: start of an arbitration, if idle and a request waits
+#define EV_END				2			// Bus: end of the frame on the wire
+#define EV_ANSWER			3			// Referee: lines before the answer printed, result queued
+#define EV_DONE				4			// Referee: last line printed, next hand of the FIFO
+
+
+// Typedefs
+typedef struct
+{
+	uint64_t t;
+	uint32_t seq;				// Order of events at the same time
+	uint8_t type;
+	uint16_t node;
+} Event_t;
+
+// Tx mailbox waiting for the bus
+typedef struct
+{
+	uint16_t id;
+	uint32_t seq;				// Among equal IDs (one node's own mailboxes): the older first
+	uint16_t node;
+	uint8_t mb;
+} Request_t;
+
+typedef struct
+{
+	uint16_t id;
+	uint8_t data;				// Hand, or result (second byte of the result frame is 0)
+	uint16_t bits;				// On the wire, intermission included
+	uint8_t used;
+} Mailbox_t;
+
+// A board. Players first on a bus, in slot order, then the referees
+typedef struct
+{
+	Strategy_Player_t player;
+	uint8_t job;				// JOB_xxx, waiting for phase 2
+	uint8_t listed;				// In the job list of its bus
+	uint8_t ready;				// next_hand worked out
+	uint8_t next_hand;
+	uint8_t obs_mine, obs_opp;	// Round of JOB_OBSERVE_PICK
+	uint8_t referee;
+	uint8_t hung;				// No free mailbox: stopped in Error_handler()
+	uint16_t slot;				// Player: IDs of the pair
+	uint16_t ref;				// Player: node of its referee
+	Mailbox_t mb[MAILBOXES];
+	// Player
+	uint64_t period;			// Tick period with the drift of the node
+	uint64_t hand_t;			// Tick of the hand waiting for its result
+	uint8_t last_hand, pending;
+	uint16_t hand_bits[3], result_bits[4];	// Frame lengths of the slot, intermission included
+	// Referee
+	uint16_t fifo_slot[FIFO_DEPTH];
+	uint8_t fifo_hand[FIFO_DEPTH];
+	uint8_t head, fill, busy;
+	uint16_t serve_slot;
+	uint8_t serve_winner;
+} Node_t;
+
+// Frame of the trace
+typedef struct
+{
+	uint64_t t;					// End of the frame
+	uint16_t id;
+	uint8_t data;
+} Logged_t;
+
+// A bus, its nodes and its results. Cache line aligned: workers write to their buses only
+typedef struct __attribute__((aligned(64)))
+{
+	uint32_t index;
+	uint16_t players, referees;
+	Node_t *node;
+	Event_t *ev;
+	uint32_t ev_n, ev_cap, seq;
+	Request_t *req;
+	uint32_t req_n, req_cap, req_seq;
+	uint16_t *jobs;				// Nodes with strategy work for phase 2
+	uint32_t jobs_n;
+	// Wire
+	uint8_t busy;
+	uint64_t free_at;			// End of the intermission after the last frame
+	uint16_t tx_node;
+	uint8_t tx_mb;
+	// Results
+	uint64_t busy_ns, frames, rounds, lost, overruns, hung, lat_max;
+	uint32_t lat[LAT_BINS];
+	uint64_t events, digest;
+	uint8_t logging;				// Frames kept for the trace
+	Logged_t *log;
+	uint32_t log_n, log_cap;
+} Bus_t;
+
+// A fleet and how it runs
+typedef struct
+{
+	uint32_t players, buses, per_ref, interval_ms, seconds, seed;
+	long threads;
+	FILE *trace;
+} Config_t;
+
+// Totals of a run, summed in bus order
+typedef struct
+{
+	uint32_t players, referees, buses;
+	uint64_t events, frames, rounds, lost, overruns, hung, lat_max;
+	double load_avg, load_max, wall;
+	uint64_t lat[LAT_BINS];
+	uint64_t digest;
+} Totals_t;
+
+// Work queue of a worker: a range of buses, taken from the front by its owner and thieves
+typedef struct __attribute__((aligned(64)))
+{
+	atomic_uint next;
+	uint32_t end;
+} Queue_t;
+
+
+// Global variables
+static Bus_t *bus;
+static uint32_t n_bus;
+static Queue_t *queue;
+static long n_workers;
+static pthread_t *tid;
+static pthread_barrier_t start_barrier, done_barrier;
+static void (*task_fn)(uint32_t i);		// Task of the phase under way
+static uint32_t *job_first;				// Phase 2: first job of each bus in the jobs of all buses
+static uint64_t run_until;
+static const Config_t *fleet;
+static uint8_t stop_workers;
+static uint64_t print_ns[3][4];		// Referee: [0][hand] first line, [1][hand] second, [2][winner] after the answer
+static const char *hand_name[3] = {"Rock", "Paper", "Scissors"};
+static const char *result_name[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+static const char *limits = "Model of the boards' node logic, not their firmware: a referee has one 3-deep Rx FIFO for the hands of\n"
+							"its players (no FIFO1, no burst remap, no other frames), game frames only, no bus errors\n";
+
+
+// Function prototypes
+static uint64_t mix(uint64_t x);
+static void ev_push(Bus_t *b, uint64_t t, uint8_t type, uint16_t node);
+static Event_t ev_pop(Bus_t *b);
+static uint8_t req_before(const Request_t *a, const Request_t *b);
+static void req_push(Bus_t *b, Request_t r);
+static Request_t req_pop(Bus_t *b);
+static uint16_t frame_bits(uint16_t id, uint8_t dlc, uint8_t data);
+static void bus_init(Bus_t *b, uint32_t index, const Config_t *cfg);
+static void bus_free(Bus_t *b);
+static void job_queue(Bus_t *b, uint16_t n, uint8_t job, uint8_t mine, uint8_t opp);
+static void job_run(Node_t *node);
+static uint8_t next_hand(Node_t *node);
+static void tx_request(Bus_t *b, uint64_t t, uint16_t n, uint16_t id, uint8_t data, uint16_t bits);
+static void referee_serve(Bus_t *b, uint64_t t, uint16_t r);
+static void frame_end(Bus_t *b, uint64_t t);
+static void lat_add(Bus_t *b, uint64_t ns);
+static double lat_ms(uint32_t bin);
+static void bus_run(Bus_t *b, uint64_t until);
+static void bus_task(uint32_t i);
+static void job_task(uint32_t k);
+static void* worker(void *arg);
+static void pool_start(long threads);
+static void pool_stop(void);
+static void pool_run(void (*fn)(uint32_t i), uint32_t n);
+static void fleet_advance(uint64_t until);
+static void trace_merge(FILE *f);
+static int fleet_run(const Config_t *cfg, Totals_t *tot);
+static double lat_percentile(const Totals_t *tot, double p);
+static void print_header(void);
+static void print_row(const Totals_t *tot, const Config_t *cfg);
+static double now_s(void);
+static int bench(Config_t *cfg);
+static int check_one(const char *what, int ok);
+static int check(void);
+static int options(int argc, char *argv[], Config_t *cfg);
+
+
+/**************************** Bus ****************************/
+
+/**
+  * @brief  Mixes a 64-bit value (splitmix64 finalizer): seeds of the nodes
+  */
+
+static uint64_t mix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+
+/**
+  * @brief  Adds an event to the queue of a bus (binary heap on time, then order of arrival)
+  */
+
+static void ev_push(Bus_t *b, uint64_t t, uint8_t type, uint16_t node)
+{
+	Event_t e = {t, b->seq++, type, node};
+	uint32_t i;
+
+	if(b->ev_n == b->ev_cap)
+	{
+		b->ev_cap = b->ev_cap ? 2 * b->ev_cap : 64;
+		b->ev = realloc(b->ev, b->ev_cap * sizeof(Event_t));
+	}
+
+	for(i = b->ev_n++; i > 0; i = (i - 1) / 2)
+	{
+		Event_t *p = &b->ev[(i - 1) / 2];
+
+		if(p->t < t || (p->t == t && p->seq < e.seq))
+		{
+			break;
+		}
+
+		b->ev[i] = *p;
+	}
+
+	b->ev[i] = e;
+}
+
+
+/**
+  * @brief  Removes the earliest event of a bus
+  */
+
+static Event_t ev_pop(Bus_t *b)
+{
+	Event_t top = b->ev[0], last = b->ev[--b->ev_n];
+	uint32_t i = 0, c;
+
+	while((c = 2 * i + 1) < b->ev_n)
+	{
+		if(c + 1 < b->ev_n && (b->ev[c+1].t < b->ev[c].t || (b->ev[c+1].t == b->ev[c].t && b->ev[c+1].seq < b->ev[c].seq)))
+		{
+			c++;
+		}
+
+		if(last.t < b->ev[c].t || (last.t == b->ev[c].t && last.seq < b->ev[c].seq))
+		{
+			break;
+		}
+
+		b->ev[i] = b->ev[c];
+		i = c;
+	}
+
+	b->ev[i] = last;
+
+	return top;
+}
+
+
+/**
+  * @brief  Arbitration order of two requests: lowest ID wins
+  */
+
+static uint8_t req_before(const Request_t *a, const Request_t *b)
+{
+	return a->id < b->id || (a->id == b->id && a->seq < b->seq);
+}
+
+
+/**
+  * @brief  Adds a Tx request to the requests waiting for the bus (binary heap)
+  */
+
+static void req_push(Bus_t *b, Request_t r)
+{
+	uint32_t i;
+
+	if(b->req_n == b->req_cap)
+	{
+		b->req_cap = b->req_cap ? 2 * b->req_cap : 64;
+		b->req = realloc(b->req, b->req_cap * sizeof(Request_t));
+	}
+
+	for(i = b->req_n++; i > 0 && req_before(&r, &b->req[(i - 1) / 2]); i = (i - 1) / 2)
+	{
+		b->req[i] = b->req[(i - 1) / 2];
+	}
+
+	b->req[i] = r;
+}
+
+
+/**
+  * @brief  Removes the request that wins the arbitration
+  */
+
+static Request_t req_pop(Bus_t *b)
+{
+	Request_t top = b->req[0], last = b->req[--b->req_n];
+	uint32_t i = 0, c;
+
+	while((c = 2 * i + 1) < b->req_n)
+	{
+		if(c + 1 < b->req_n && req_before(&b->req[c+1], &b->req[c]))
+		{
+			c++;
+		}
+
+		if(req_before(&last, &b->req[c]))
+		{
+			break;
+		}
+
+		b->req[i] = b->req[c];
+		i = c;
+	}
+
+	b->req[i] = last;
+
+	return top;
+}
+
+
+/**
+  * @brief  Returns the bits a game frame takes on the wire, intermission included
+  * @param  id standard identifier
+  * @param  dlc 1 (hand) or 2 (result)
+  * @param  data first byte, the others are 0
+  */
+
+static uint16_t frame_bits(uint16_t id, uint8_t dlc, uint8_t data)
+{
+	Can_Bits_Frame_t f = {.id = id, .dlc = dlc, .data = {data}};
+
+	return Can_Bits_Length(&f) + CAN_BITS_IFS;
+}
+
+
+/**
+  * @brief  Lays out the nodes of a bus: its share of the players, one referee per per_ref
+  * 		players, and the first tick of each player
+  * @param  b bus
+  * @param  index bus number
+  * @param  cfg fleet
+  * @retval None
+  */
+
+static void bus_init(Bus_t *b, uint32_t index, const Config_t *cfg)
+{
+	uint64_t interval = (uint64_t)cfg->interval_ms * 1000000;
+
+	memset(b, 0, sizeof(Bus_t));
+	b->index = index;
+	b->players = cfg->players / n_bus + (index < cfg->players % n_bus);
+	b->referees = (b->players + cfg->per_ref - 1) / cfg->per_ref;
+	b->node = calloc(b->players + b->referees, sizeof(Node_t));
+	b->jobs = malloc((b->players + b->referees) * sizeof(uint16_t));
+	b->digest = 0xCBF29CE484222325ULL;
+	b->logging = (cfg->trace != NULL);
+
+	if(b->node == NULL || b->jobs == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for(uint16_t i = 0; i < b->players + b->referees; i++)
+	{
+		Node_t *n = &b->node[i];
+		uint64_t r = mix(((uint64_t)cfg->seed << 40) ^ ((uint64_t)index << 16) ^ i);
+		uint32_t seed = (uint32_t)(r >> 32) | 1;
+
+		job_queue(b, i, JOB_PICK, 0, 0);		// First hand
+
+		if(i >= b->players)			// Referee: the Disc strategy of the default build
+		{
+			n->referee = 1;
+			Strategy_Init(&n->player, STRATEGY_RANDOM, seed);
+			continue;
+		}
+
+		// Player: a mix of the strategies across the fleet
+		Strategy_Init(&n->player, (index + i * n_bus) % STRATEGY_COUNT, seed);
+		n->slot = i;
+		n->ref = b->players + i / cfg->per_ref;
+		n->period = interval + (int64_t)interval * ((int64_t)(r % (2 * DRIFT_PPM + 1)) - DRIFT_PPM) / 1000000;
+
+		for(uint8_t h = 0; h < 3; h++)
+		{
+			n->hand_bits[h] = frame_bits(ID_HAND + i, 1, h);
+		}
+
+		for(uint8_t w = 0; w < 4; w++)
+		{
+			n->result_bits[w] = frame_bits(ID_RESULT + i, 2, w + 1);
+		}
+
+		ev_push(b, (r >> 8) % interval, EV_TICK, i);		// Start button pressed at a random time
+	}
+}
+
+
+static void bus_free(Bus_t *b)
+{
+	free(b->node);
+	free(b->jobs);
+	free(b->ev);
+	free(b->req);
+	free(b->log);
+}
+
+
+/**
+  * @brief  Leaves the strategy work of a node to phase 2
+  * @param  b bus
+  * @param  n node
+  * @param  job JOB_PICK or JOB_OBSERVE_PICK
+  * @param  mine, opp hands of the round to observe first (JOB_OBSERVE_PICK)
+  * @retval None
+  */
+
+static void job_queue(Bus_t *b, uint16_t n, uint8_t job, uint8_t mine, uint8_t opp)
+{
+	Node_t *node = &b->node[n];
+
+	node->job = job;
+	node->obs_mine = mine;
+	node->obs_opp = opp;
+
+	if(!node->listed)
+	{
+		node->listed = 1;
+		b->jobs[b->jobs_n++] = n;
+	}
+}
+
+
+/**
+  * @brief  Does the strategy work of a node: the round it waits with, then its next hand
+  */
+
+static void job_run(Node_t *node)
+{
+	if(node->job == JOB_OBSERVE_PICK)
+	{
+		Strategy_Observe(&node->player, node->obs_mine, node->obs_opp);
+	}
+
+	node->next_hand = Strategy_Pick(&node->player);
+	node->ready = 1;
+	node->job = JOB_NONE;
+}
+
+
+/**
+  * @brief  Returns the next hand of a node and uses it up. Worked out now if phase 2 has
+  * 		not run its job yet, or if it had none (a player whose result never came)
+  */
+
+static uint8_t next_hand(Node_t *node)
+{
+	if(!node->ready)
+	{
+		job_run(node);
+	}
+
+	node->ready = 0;
+
+	return node->next_hand;
+}
+
+
+/**
+  * @brief  Fills a free Tx mailbox of a node. None free: the node stops, as in Error_handler()
+  * @param  b bus
+  * @param  t time of the request
+  * @param  n node
+  * @param  id, data, bits frame
+  * @retval None
+  */
+
+static void tx_request(Bus_t *b, uint64_t t, uint16_t n, uint16_t id, uint8_t data, uint16_t bits)
+{
+	Node_t *node = &b->node[n];
+
+	for(uint8_t m = 0; m < MAILBOXES; m++)
+	{
+		if(!node->mb[m].used)
+		{
+			node->mb[m] = (Mailbox_t){id, data, bits, 1};
+			req_push(b, (Request_t){id, b->req_seq++, n, m});
+
+			if(!b->busy)
+			{
+				ev_push(b, (t > b->free_at) ? t : b->free_at, EV_ARB, 0);
+			}
+
+			return;
+		}
+	}
+
+	node->hung = 1;
+	b->hung++;
+}
+
+
+/**
+  * @brief  Referee takes the oldest hand of its FIFO: prints it, picks its own hand, prints
+  * 		it, then answers (EV_ANSWER)
+  * @param  b bus
+  * @param  t time
+  * @param  r referee node
+  * @retval None
+  */
+
+static void referee_serve(Bus_t *b, uint64_t t, uint16_t r)
+{
+	Node_t *ref = &b->node[r];
+	uint16_t slot = ref->fifo_slot[ref->head];
+	uint8_t hand = ref->fifo_hand[ref->head];
+	uint8_t pick = next_hand(ref);
+
+	job_queue(b, r, JOB_OBSERVE_PICK, pick, hand);
+	ref->head = (ref->head + 1) % FIFO_DEPTH;
+	ref->fill--;
+	ref->busy = 1;
+	ref->serve_slot = slot;
+	ref->serve_winner = (hand == pick) ? 3 : (hand == (pick + 1) % 3) ? 1 : 2;
+	ev_push(b, t + print_ns[0][hand] + print_ns[1][pick], EV_ANSWER, r);
+}
+
+
+/**
+  * @brief  A frame went through: frees its mailbox and hands it to the node that filters it in
+  * @param  b bus
+  * @param  t end of the frame
+  * @retval None
+  */
+
+static void frame_end(Bus_t *b, uint64_t t)
+{
+	Mailbox_t *mb = &b->node[b->tx_node].mb[b->tx_mb];
+	uint16_t id = mb->id;
+	uint8_t data = mb->data;
+
+	mb->used = 0;
+	b->busy = 0;
+	b->frames++;
+	b->digest = (b->digest ^ (t ^ ((uint64_t)id << 48) ^ ((uint64_t)data << 40))) * 0x100000001B3ULL;
+
+	if(b->logging)
+	{
+		if(b->log_n == b->log_cap)
+		{
+			b->log_cap = b->log_cap ? 2 * b->log_cap : 1024;
+			b->log = realloc(b->log, b->log_cap * sizeof(Logged_t));
+		}
+
+		b->log[b->log_n++] = (Logged_t){t, id, data};
+	}
+
+	if(b->req_n > 0)
+	{
+		ev_push(b, b->free_at, EV_ARB, 0);
+	}
+
+	if(id >= ID_HAND)				// Hand: to the referee of the slot
+	{
+		Node_t *ref = &b->node[b->node[id - ID_HAND].ref];
+		uint8_t i;
+
+		if(ref->hung)
+		{
+			return;
+		}
+
+		if(ref->fill == FIFO_DEPTH)		// Full: the last message is overwritten (RFLM = 0)
+		{
+			b->overruns++;
+			i = (ref->head + FIFO_DEPTH - 1) % FIFO_DEPTH;
+		}else
+		{
+			i = (ref->head + ref->fill++) % FIFO_DEPTH;
+		}
+
+		ref->fifo_slot[i] = id - ID_HAND;
+		ref->fifo_hand[i] = data;
+
+		if(!ref->busy)
+		{
+			referee_serve(b, t, b->node[id - ID_HAND].ref);
+		}
+	}else							// Result: to the player of the slot
+	{
+		Node_t *p = &b->node[id - ID_RESULT];
+
+		if(p->hung || !p->pending)
+		{
+			return;
+		}
+
+		job_queue(b, id - ID_RESULT, JOB_OBSERVE_PICK, p->last_hand, Strategy_OppHand(p->last_hand, data));
+		p->pending = 0;
+		b->rounds++;
+		lat_add(b, t - p->hand_t);
+	}
+}
+
+
+/**
+  * @brief  Adds a latency to the histogram of a bus: 64 bins per power of two of us
+  */
+
+static void lat_add(Bus_t *b, uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	uint32_t bin = us;
+
+	if(us >= 2 * LAT_SUB)
+	{
+		uint32_t e = 63 - __builtin_clzll(us) - LAT_SUB_BITS;
+
+		bin = (e + 1) * LAT_SUB + (us >> e) - LAT_SUB;
+	}
+
+	b->lat[(bin < LAT_BINS) ? bin : LAT_BINS - 1]++;
+	b->lat_max = (ns > b->lat_max) ? ns : b->lat_max;
+}
+
+
+/**
+  * @brief  Returns the lower bound of a histogram bin in ms
+  */
+
+static double lat_ms(uint32_t bin)
+{
+	if(bin < 2 * LAT_SUB)
+	{
+		return bin / 1000.0;
+	}
+
+	return (double)((uint64_t)(bin % LAT_SUB + LAT_SUB) << (bin / LAT_SUB - 1)) / 1000.0;
+}
+
+
+/**
+  * @brief  Runs a bus up to a time
+  * @param  b bus
+  * @param  until events before this time are handled
+  * @retval None
+  */
+
+static void bus_run(Bus_t *b, uint64_t until)
+{
+	while(b->ev_n > 0 && b->ev[0].t < until)
+	{
+		Event_t e = ev_pop(b);
+		Node_t *n = &b->node[e.node];
+
+		b->events++;
+
+		switch(e.type)
+		{
+			case EV_TICK:
+				if(n->hung)
+				{
+					break;
+				}
+
+				b->lost += n->pending;			// Previous hand never got its result
+				n->last_hand = next_hand(n);
+				n->pending = 1;
+				n->hand_t = e.t;
+				tx_request(b, e.t, e.node, ID_HAND + n->slot, n->last_hand, n->hand_bits[n->last_hand]);
+				ev_push(b, e.t + n->period, EV_TICK, e.node);
+				break;
+
+			case EV_ARB:
+				if(b->busy || b->req_n == 0 || e.t < b->free_at)
+				{
+					break;
+				}
+
+				{
+					Request_t r = req_pop(b);
+					uint64_t len = (uint64_t)b->node[r.node].mb[r.mb].bits * BIT_NS;
+
+					b->busy = 1;
+					b->tx_node = r.node;
+					b->tx_mb = r.mb;
+					b->free_at = e.t + len;
+					b->busy_ns += len - CAN_BITS_IFS * BIT_NS;
+					ev_push(b, e.t + len - CAN_BITS_IFS * BIT_NS, EV_END, 0);
+				}
+				break;
+
+			case EV_END:
+				frame_end(b, e.t);
+				break;
+
+			case EV_ANSWER:
+				{
+					Node_t *p = &b->node[n->serve_slot];
+
+					tx_request(b, e.t, e.node, ID_RESULT + n->serve_slot, n->serve_winner, p->result_bits[n->serve_winner - 1]);
+
+					if(!n->hung)
+					{
+						ev_push(b, e.t + print_ns[2][n->serve_winner - 1], EV_DONE, e.node);
+					}
+				}
+				break;
+
+			case EV_DONE:
+				n->busy = 0;
+
+				if(n->fill > 0)
+				{
+					referee_serve(b, e.t, e.node);
+				}
+				break;
+		}
+	}
+}
+
+
+/**************************** Pool ****************************/
+
+/**
+  * @brief  Phase 1: runs a bus up to the end of the current pool run. Its nodes are laid
+  * 		out on its first run, by the worker that takes it
+  * @param  i bus number
+  * @retval None
+  */
+
+static void bus_task(uint32_t i)
+{
+	if(bus[i].node == NULL)
+	{
+		bus_init(&bus[i], i, fleet);
+	}
+
+	bus_run(&bus[i], run_until);
+}
+
+
+/**
+  * @brief  Phase 2: strategy work of JOB_CHUNK nodes of the jobs of all buses, in bus order
+  * @param  k chunk number
+  * @retval None
+  */
+
+static void job_task(uint32_t k)
+{
+	uint32_t from = k * JOB_CHUNK, to = from + JOB_CHUNK, i = 0, hi = n_bus;
+
+	while(hi - i > 1)				// Last bus whose jobs start at or before the chunk
+	{
+		uint32_t mid = (i + hi) / 2;
+
+		if(job_first[mid] <= from)
+		{
+			i = mid;
+		}else
+		{
+			hi = mid;
+		}
+	}
+
+	for(uint32_t j = from; j < to && i < n_bus; j++)
+	{
+		while(i < n_bus && j >= job_first[i] + bus[i].jobs_n)
+		{
+			i++;
+		}
+
+		if(i < n_bus)
+		{
+			Node_t *node = &bus[i].node[bus[i].jobs[j - job_first[i]]];
+
+			if(node->job != JOB_NONE)		// Not already done in phase 1
+			{
+				job_run(node);
+			}
+		}
+	}
+}
+
+
+/**
+  * @brief  Worker thread: at each start of the pool, runs the tasks of its own queue, then
+  * 		takes tasks from the queues of the others until every queue is empty
+  * @param  arg worker number
+  * @retval NULL
+  */
+
+static void* worker(void *arg)
+{
+	long w = (long)arg;
+
+	while(1)
+	{
+		pthread_barrier_wait(&start_barrier);
+
+		if(stop_workers)
+		{
+			break;
+		}
+
+		for(long k = 0; k < n_workers; k++)		// Own queue first, then the next ones in turn
+		{
+			Queue_t *q = &queue[(w + k) % n_workers];
+			uint32_t i;
+
+			while((i = atomic_fetch_add(&q->next, 1)) < q->end)
+			{
+				task_fn(i);
+			}
+		}
+
+		pthread_barrier_wait(&done_barrier);
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Starts the workers. The calling thread is one of them (worker 0)
+  * @param  threads number of workers
+  * @retval None
+  */
+
+static void pool_start(long threads)
+{
+	n_workers = threads;
+	stop_workers = 0;
+	queue = aligned_alloc(64, threads * sizeof(Queue_t));
+	tid = calloc(threads, sizeof(pthread_t));
+
+	if(queue == NULL || tid == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	pthread_barrier_init(&start_barrier, NULL, threads);
+	pthread_barrier_init(&done_barrier, NULL, threads);
+
+	for(long w = 1; w < threads; w++)
+	{
+		pthread_create(&tid[w], NULL, worker, (void *)w);
+	}
+}
+
+
+static void pool_stop(void)
+{
+	stop_workers = 1;
+	pthread_barrier_wait(&start_barrier);
+
+	for(long w = 1; w < n_workers; w++)
+	{
+		pthread_join(tid[w], NULL);
+	}
+
+	pthread_barrier_destroy(&start_barrier);
+	pthread_barrier_destroy(&done_barrier);
+	free(queue);
+	free(tid);
+}
+
+
+/**
+  * @brief  Runs tasks 0 to n - 1 on the pool: each worker gets an equal range of them
+  * @param  fn task
+  * @param  n number of tasks
+  * @retval None
+  */
+
+static void pool_run(void (*fn)(uint32_t i), uint32_t n)
+{
+	task_fn = fn;
+
+	for(long w = 0; w < n_workers; w++)
+	{
+		atomic_store(&queue[w].next, (uint32_t)((uint64_t)n * w / n_workers));
+		queue[w].end = (uint64_t)n * (w + 1) / n_workers;
+	}
+
+	pthread_barrier_wait(&start_barrier);
+
+	for(long k = 0; k < n_workers; k++)		// Worker 0's share, then stealing
+	{
+		Queue_t *q = &queue[k];
+		uint32_t i;
+
+		while((i = atomic_fetch_add(&q->next, 1)) < q->end)
+		{
+			fn(i);
+		}
+	}
+
+	pthread_barrier_wait(&done_barrier);
+}
+
+
+/**
+  * @brief  Runs every bus up to a time (phase 1), then the strategy work they left (phase 2)
+  * @param  until end of the run
+  * @retval None
+  */
+
+static void fleet_advance(uint64_t until)
+{
+	uint32_t jobs = 0;
+
+	run_until = until;
+	pool_run(bus_task, n_bus);
+
+	for(uint32_t i = 0; i < n_bus; i++)
+	{
+		job_first[i] = jobs;
+		jobs += bus[i].jobs_n;
+	}
+
+	pool_run(job_task, (jobs + JOB_CHUNK - 1) / JOB_CHUNK);
+
+	for(uint32_t i = 0; i < n_bus; i++)
+	{
+		for(uint32_t j = 0; j < bus[i].jobs_n; j++)
+		{
+			bus[i].node[bus[i].jobs[j]].listed = 0;
+		}
+
+		bus[i].jobs_n = 0;
+	}
+}
+
+
+/**
+  * @brief  Writes the frames the buses logged since the last merge, all buses in time order,
+  * 		and empties the logs
+  * @param  f trace file
+  * @retval None
+  */
+
+static void trace_merge(FILE *f)
+{
+	uint32_t *heap = malloc(n_bus * sizeof(uint32_t)), *pos = calloc(n_bus, sizeof(uint32_t));
+	uint32_t n = 0;
+
+	// Min-heap of the buses on their next frame: time, then bus number
+	#define TRACE_BEFORE(a, c)	(bus[a].log[pos[a]].t < bus[c].log[pos[c]].t || \
+								 (bus[a].log[pos[a]].t == bus[c].log[pos[c]].t && (a) < (c)))
+
+	for(uint32_t i = 0; i < n_bus; i++)
+	{
+		if(bus[i].log_n > 0)
+		{
+			uint32_t k = n++;
+
+			for(; k > 0 && TRACE_BEFORE(i, heap[(k - 1) / 2]); k = (k - 1) / 2)
+			{
+				heap[k] = heap[(k - 1) / 2];
+			}
+
+			heap[k] = i;
+		}
+	}
+
+	while(n > 0)
+	{
+		uint32_t top = heap[0], k = 0, c;
+		const Logged_t *l = &bus[top].log[pos[top]];
+
+		fprintf(f, "%llu.%09llu,%u,0x%03X,%u\n", (unsigned long long)(l->t / NS_PER_S), (unsigned long long)(l->t % NS_PER_S), \
+				top, l->id, l->data);
+
+		if(++pos[top] == bus[top].log_n)
+		{
+			top = heap[--n];
+		}
+
+		while((c = 2 * k + 1) < n)		// Sift the bus down
+		{
+			if(c + 1 < n && TRACE_BEFORE(heap[c+1], heap[c]))
+			{
+				c++;
+			}
+
+			if(TRACE_BEFORE(top, heap[c]))
+			{
+				break;
+			}
+
+			heap[k] = heap[c];
+			k = c;
+		}
+
+		if(n > 0)
+		{
+			heap[k] = top;
+		}
+	}
+
+	#undef TRACE_BEFORE
+
+	for(uint32_t i = 0; i < n_bus; i++)
+	{
+		bus[i].log_n = 0;
+	}
+
+	free(heap);
+	free(pos);
+}
+
+
+/**************************** Fleet ****************************/
+
+/**
+  * @brief  Runs a fleet and sums its results in bus order
+  * @param  cfg fleet
+  * @param  tot receives the totals
+  * @retval 0, or 1 if the fleet does not fit on its buses
+  */
+
+static int fleet_run(const Config_t *cfg, Totals_t *tot)
+{
+	uint64_t end = (uint64_t)cfg->seconds * NS_PER_S;
+	double t0 = now_s();
+
+	n_bus = (cfg->players < cfg->buses) ? cfg->players : cfg->buses;
+
+	if(n_bus == 0 || (cfg->players + n_bus - 1) / n_bus > SLOTS)
+	{
+		fprintf(stderr, "%u players do not fit on %u buses (%u at most per bus)\n", cfg->players, cfg->buses, SLOTS);
+		return 1;
+	}
+
+	bus = aligned_alloc(64, n_bus * sizeof(Bus_t));
+	job_first = malloc(n_bus * sizeof(uint32_t));
+
+	if(bus == NULL || job_first == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	memset(bus, 0, n_bus * sizeof(Bus_t));
+	fleet = cfg;
+	pool_start(cfg->threads);
+
+	for(uint64_t t = JOB_EPOCH; t < end + JOB_EPOCH; t += JOB_EPOCH)
+	{
+		fleet_advance((t < end) ? t : end);
+
+		if(cfg->trace != NULL)
+		{
+			trace_merge(cfg->trace);
+		}
+	}
+
+	pool_stop();
+
+	memset(tot, 0, sizeof(Totals_t));
+	tot->wall = now_s() - t0;
+	tot->players = cfg->players;
+	tot->buses = n_bus;
+	tot->digest = 0xCBF29CE484222325ULL;
+
+	for(uint32_t i = 0; i < n_bus; i++)
+	{
+		Bus_t *b = &bus[i];
+		double load = (double)b->busy_ns / end;
+
+		tot->referees += b->referees;
+		tot->events += b->events;
+		tot->frames += b->frames;
+		tot->rounds += b->rounds;
+		tot->lost += b->lost;
+		tot->overruns += b->overruns;
+		tot->hung += b->hung;
+		tot->lat_max = (b->lat_max > tot->lat_max) ? b->lat_max : tot->lat_max;
+		tot->load_avg += load / n_bus;
+		tot->load_max = (load > tot->load_max) ? load : tot->load_max;
+		tot->digest = (tot->digest ^ b->digest) * 0x100000001B3ULL;
+
+		for(uint32_t k = 0; k < LAT_BINS; k++)
+		{
+			tot->lat[k] += b->lat[k];
+		}
+
+		bus_free(b);
+	}
+
+	free(bus);
+	free(job_first);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Returns a latency percentile in ms (lower bound of its bin)
+  */
+
+static double lat_percentile(const Totals_t *tot, double p)
+{
+	uint64_t want = (uint64_t)(p * tot->rounds), seen = 0;
+
+	for(uint32_t k = 0; k < LAT_BINS; k++)
+	{
+		seen += tot->lat[k];
+
+		if(seen > want)
+		{
+			return lat_ms(k);
+		}
+	}
+
+	return 0;
+}
+
+
+static void print_header(void)
+{
+	printf("%7s %6s %5s %8s %8s %10s %8s %8s %8s %9s %9s %5s %8s %9s\n", "players", "refs", "buses", "load%", "max%", \
+		   "rounds/s", "p50 ms", "p99 ms", "max ms", "lost", "overruns", "hung", "wall s", "x real");
+}
+
+
+static void print_row(const Totals_t *tot, const Config_t *cfg)
+{
+	printf("%7u %6u %5u %8.3f %8.3f %10.2f %8.3f %8.3f %8.3f %9llu %9llu %5llu %8.2f %9.0f\n", tot->players, tot->referees, \
+		   tot->buses, 100 * tot->load_avg, 100 * tot->load_max, (double)tot->rounds / cfg->seconds, lat_percentile(tot, 0.5), \
+		   lat_percentile(tot, 0.99), tot->lat_max / 1e6, (unsigned long long)tot->lost, (unsigned long long)tot->overruns, \
+		   (unsigned long long)tot->hung, tot->wall, cfg->seconds / tot->wall);
+}
+
+
+/**
+  * @brief  Returns a monotonic time in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Runs the same fleet with 1 thread up to cfg->threads: speedup, and the same
+  * 		results each time
+  * @param  cfg fleet
+  * @retval Exit code
+  */
+
+static int bench(Config_t *cfg)
+{
+	long threads = cfg->threads;
+	Totals_t tot, ref;
+	int fail = 0;
+
+	printf("%s%u players on %u buses, %u s of play\n", limits, cfg->players, cfg->buses, cfg->seconds);
+
+	for(long n = 1; ; n = (2 * n > threads) ? threads : 2 * n)		// 1, 2, 4... and the number of threads asked
+	{
+		cfg->threads = n;
+
+		if(fleet_run(cfg, &tot) != 0)
+		{
+			return 1;
+		}
+
+		if(n == 1)
+		{
+			ref = tot;
+		}
+
+		fail |= (tot.digest != ref.digest) || (tot.rounds != ref.rounds) || memcmp(tot.lat, ref.lat, sizeof(tot.lat)) != 0;
+		printf("%3ld threads: %.3f s, %.0fx real time, %.2f M events/s, x%.2f, digest %016llx %s\n", n, tot.wall, \
+			   cfg->seconds / tot.wall, tot.events / tot.wall / 1e6, ref.wall / tot.wall, \
+			   (unsigned long long)tot.digest, (tot.digest != ref.digest) ? "FAIL" : "");
+
+		if(n == threads)
+		{
+			break;
+		}
+	}
+
+	cfg->threads = threads;
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+/**
+  * @brief  Prints a check and its outcome
+  * @retval 1 if it failed
+  */
+
+static int check_one(const char *what, int ok)
+{
+	printf("%-60s %s\n", what, ok ? "ok" : "FAIL");
+
+	return !ok;
+}
+
+
+/**
+  * @brief  Checks the simulation on small fleets
+  * @param  None
+  * @retval Exit code
+  */
+
+static int check(void)
+{
+	Config_t cfg = {.players = 1, .buses = 1, .per_ref = 1, .interval_ms = 4000, .seconds = 400, .seed = 1, .threads = 1};
+	Totals_t tot, ref;
+	uint64_t lines = 0, frames;
+	double last = 0, t;
+	char line[64];
+	int fail = 0;
+
+	// One pair: every tick gets its result, as fast as Disc prints its two lines
+	print_header();
+	fleet_run(&cfg, &tot);
+	print_row(&tot, &cfg);
+	fail |= check_one("one pair: a result for every hand", tot.rounds == 100 && tot.lost == 0);
+	fail |= check_one("one pair: tick to result 5.5 to 6.5 ms, as on the boards", \
+					  lat_percentile(&tot, 0) >= 5.5 && tot.lat_max < 6500000);
+
+	// Same fleet, 1 and 8 threads
+	cfg = (Config_t){.players = 512, .buses = 24, .per_ref = 2, .interval_ms = 1000, .seconds = 120, .seed = 7, .threads = 1};
+	fleet_run(&cfg, &ref);
+	print_row(&ref, &cfg);
+	cfg.threads = 8;
+	fleet_run(&cfg, &tot);
+	print_row(&tot, &cfg);
+	fail |= check_one("512 players: same results with 1 and 8 threads", tot.digest == ref.digest && tot.rounds == ref.rounds && \
+					  memcmp(tot.lat, ref.lat, sizeof(tot.lat)) == 0 && tot.overruns == ref.overruns);
+	fail |= check_one("512 players: every round in", ref.lost == 0 && ref.hung == 0 && ref.rounds > 512 * 118);
+
+	// One bus asked for more than it carries
+	cfg = (Config_t){.players = 256, .buses = 1, .per_ref = 1, .interval_ms = 25, .seconds = 10, .seed = 3, .threads = 2};
+	fleet_run(&cfg, &tot);
+	print_row(&tot, &cfg);
+	fail |= check_one("saturated bus: load near 100 %, results lost", tot.load_avg > 0.95 && tot.load_avg <= 1.0 && tot.lost > 0);
+
+	// One referee for 32 players, each hand every 100 ms: 10 ms of UART per hand
+	cfg = (Config_t){.players = 32, .buses = 1, .per_ref = 32, .interval_ms = 100, .seconds = 60, .seed = 5, .threads = 1};
+	fleet_run(&cfg, &tot);
+	print_row(&tot, &cfg);
+	fail |= check_one("overloaded referee: Rx overruns, results lost", tot.overruns > 0 && tot.lost > 0 && tot.load_avg < 0.2);
+
+	// Merged trace: time order across buses, every frame
+	cfg = (Config_t){.players = 64, .buses = 8, .per_ref = 1, .interval_ms = 500, .seconds = 5, .seed = 9, .threads = 4};
+	cfg.trace = tmpfile();
+
+	if(cfg.trace == NULL)
+	{
+		perror("tmpfile");
+		return 1;
+	}
+
+	fleet_run(&cfg, &tot);
+	frames = tot.frames;
+	rewind(cfg.trace);
+
+	while(fgets(line, sizeof(line), cfg.trace) != NULL)
+	{
+		t = atof(line);
+		fail |= (t < last);
+		last = t;
+		lines++;
+	}
+
+	fclose(cfg.trace);
+	fail |= check_one("trace: every frame of the 8 buses, in time order", lines == frames && frames > 0 && !fail);
+
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+/**
+  * @brief  Reads the options shared by the modes
+  * @retval 0, 1 on a bad option
+  */
+
+static int options(int argc, char *argv[], Config_t *cfg)
+{
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:b:r:i:T:t:S:o:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': cfg->players = strtoul(optarg, NULL, 0); break;
+			case 'b': cfg->buses = strtoul(optarg, NULL, 0); break;
+			case 'r': cfg->per_ref = strtoul(optarg, NULL, 0); break;
+			case 'i': cfg->interval_ms = strtoul(optarg, NULL, 0); break;
+			case 'T': cfg->seconds = strtoul(optarg, NULL, 0); break;
+			case 't': cfg->threads = strtol(optarg, NULL, 0); break;
+			case 'S': cfg->seed = strtoul(optarg, NULL, 0); break;
+			case 'o':
+				cfg->trace = fopen(optarg, "w");
+				if(cfg->trace == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				return 1;
+		}
+	}
+
+	return (cfg->players < 1 || cfg->buses < 1 || cfg->per_ref < 1 || cfg->interval_ms < 1 || cfg->seconds < 1 || cfg->threads < 1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	Config_t cfg = {.players = 1024, .buses = 32, .per_ref = 1, .interval_ms = 4000, .seconds = 600, .seed = 1, \
+					.threads = sysconf(_SC_NPROCESSORS_ONLN)};
+	const char *mode = (argc > 1 && argv[1][0] != '-') ? argv[1] : "";
+	Totals_t tot;
+	char line[100];
+
+	// UART time of the referee's lines, as printed by process_rx_msg() and send_game_result()
+	for(uint8_t h = 0; h < 3; h++)
+	{
+		print_ns[0][h] = (uint64_t)sprintf(line, "Message received. Nucleo's hand is %s\r\n", hand_name[h]) * UART_CHAR_NS;
+		print_ns[1][h] = (uint64_t)sprintf(line, "Disc's hand is %s\r\n", hand_name[h]) * UART_CHAR_NS;
+	}
+
+	for(uint8_t w = 0; w < 4; w++)
+	{
+		print_ns[2][w] = (uint64_t)sprintf(line, "Sent message with game result: %s\r\n", result_name[w]) * UART_CHAR_NS;
+	}
+
+	if(strcmp(mode, "check") == 0)
+	{
+		return check();
+	}
+
+	if(strcmp(mode, "bench") == 0)
+	{
+		cfg.players = 8192;
+		cfg.buses = 256;
+		cfg.seconds = 3600;
+		optind = 2;
+	}
+
+	if(options(argc, argv, &cfg) != 0 || (mode[0] != 0 && strcmp(mode, "bench") != 0))
+	{
+		fprintf(stderr, "Usage: %s [-n players] [-b buses] [-r players_per_referee] [-i interval_ms] [-T seconds] [-t threads] [-S seed] [-o trace.csv]\n"
+						"       %s bench [same options]\n       %s check\n", argv[0], argv[0], argv[0]);
+		return 1;
+	}
+
+	if(mode[0] != 0)
+	{
+		return bench(&cfg);
+	}
+
+	printf("%s1 referee per %u players, a hand every %u ms, %u s of play, %ld threads\n\n", limits, cfg.per_ref, cfg.interval_ms, \
+		   cfg.seconds, cfg.threads);
+	print_header();
+
+	for(uint32_t n = (cfg.trace != NULL) ? cfg.players : 2; ; n = (2 * n > cfg.players) ? cfg.players : 2 * n)
+	{
+		Config_t point = cfg;
+
+		point.players = n;
+
+		if(fleet_run(&point, &tot) != 0)
+		{
+			return 1;
+		}
+
+		print_row(&tot, &point);
+
+		if(n == cfg.players)
+		{
+			break;
+		}
+	}
+
+	if(cfg.trace != NULL)
+	{
+		fclose(cfg.trace);
+	}
+
+	return 0;
+}
@@ -0,0 +1,434 @@
+/**
+  ******************************************************************************
+  * @file    history_tool.c
+  * @author  Moe2Code
+  * @brief   Decoder and torn-write check of Nucleo's packed round history (history.c).
+  *          decode: prints the rounds of a backup SRAM dump as CSV (round, hands, winner),
+  *                  oldest first. The dump is the 4 KB backup SRAM, e.g. read with
+  *                  st-flash read bsram.bin 0x40024000 4096
+  *          check:  records rounds with runs, errors and restarts through several laps of
+  *                  the ring. Every write of every update is torn in turn (the board loses
+  *                  power after it), then the history is recovered and checked against the
+  *                  rounds recorded, and recording resumes. Then uniform random rounds, as
+  *                  the game plays them, for several laps: prints the rounds the ring keeps
+  *                  once it has wrapped
+  *          Usage: ./history_tool decode bsram.bin
+  *                 ./history_tool check [rounds] [seed]
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+
+
+// Defines
+#define BSRAM_SIZE			4096
+#define RESTART_EVERY		997			// Rounds between simulated restarts in the check
+#define RESUME_ROUNDS		3			// Rounds recorded after each recovery before checking again
+#define UNIFORM_LAPS		4			// Laps of the ring recorded with uniform random rounds
+
+
+// Global variables
+static uint8_t ram[HISTORY_SIZE];		// History region of the simulated backup SRAM
+static long writes;						// Byte writes since the counter was cleared
+static long tear_at = -1;				// Writes that reach the SRAM before power is lost, -1 for no loss
+static uint8_t *expected;				// Round codes in recording order
+static uint8_t decoded[HISTORY_BLOCKS * HISTORY_NIBBLES * (HISTORY_REPEAT_MAX + 1)];
+
+
+/**
+  * @brief  Byte write hook of history.c. Writes after the tear point are lost
+  * @param  addr address to write
+  * @param  val value
+  * @retval None
+  */
+
+void History_HostWrite(uint8_t *addr, uint8_t val)
+{
+	if(tear_at < 0 || writes < tear_at)
+	{
+		*addr = val;
+	}
+
+	writes++;
+}
+
+
+/**
+  * @brief  Returns the valid blocks of a ring sorted by anchor round (oldest first)
+  * @param  mem start of the ring
+  * @param  order receives the block indexes
+  * @param  anchors receives the anchors, indexed by block
+  * @retval Number of valid blocks
+  */
+
+static uint8_t sorted_blocks(const uint8_t *mem, uint8_t order[HISTORY_BLOCKS], History_Anchor_t anchors[HISTORY_BLOCKS])
+{
+	uint8_t n = 0, t;
+
+	for(uint8_t b = 0; b < HISTORY_BLOCKS; b++)
+	{
+		if(History_ReadAnchor(mem, b, &anchors[b]))
+		{
+			order[n++] = b;
+		}
+	}
+
+	for(uint8_t i = 1; i < n; i++)
+	{
+		for(uint8_t j = i; j > 0 && anchors[order[j]].round < anchors[order[j-1]].round; j--)
+		{
+			t = order[j];
+			order[j] = order[j-1];
+			order[j-1] = t;
+		}
+	}
+
+	return n;
+}
+
+
+/**
+  * @brief  Checks that the ring holds the last recorded rounds, gap free and ending with
+  * 		round total - 1
+  * @param  mem start of the ring
+  * @param  total rounds recorded
+  * @param  what description printed on failure
+  * @retval Rounds kept
+  */
+
+static uint32_t verify(const uint8_t *mem, uint32_t total, const char *what)
+{
+	History_Anchor_t anchors[HISTORY_BLOCKS];
+	History_Cursor_t cur;
+	uint8_t order[HISTORY_BLOCKS], n = sorted_blocks(mem, order, anchors);
+	uint32_t r = 0, first = 0, entries;
+
+	for(uint8_t i = 0; i < n; i++)
+	{
+		const History_Anchor_t *a = &anchors[order[i]];
+
+		if(i == 0)
+		{
+			r = first = a->round;
+		}else if(a->round != r)
+		{
+			fprintf(stderr, "FAIL %s: block %u starts at round %u, expected %u\n", what, order[i], a->round, r);
+			exit(1);
+		}
+
+		entries = History_Scan(mem, order[i], &cur, decoded, sizeof(decoded));
+
+		for(uint32_t k = 0; k < entries; k++)
+		{
+			if(decoded[k] == HISTORY_RESTART)
+			{
+				continue;
+			}
+
+			if(r >= total || decoded[k] != expected[r])
+			{
+				fprintf(stderr, "FAIL %s: round %u decodes as %u, expected %u (of %u rounds)\n", what, r, decoded[k], \
+						(r < total) ? expected[r] : 255, total);
+				exit(1);
+			}
+
+			r++;
+		}
+	}
+
+	if(r != total)
+	{
+		fprintf(stderr, "FAIL %s: history ends at round %u, expected %u\n", what, r, total);
+		exit(1);
+	}
+
+	return r - first;
+}
+
+
+/**
+  * @brief  Prints the rounds of a backup SRAM dump
+  * @param  path dump file (4096 bytes of backup SRAM, or just the history region)
+  * @retval 0 on success
+  */
+
+static int decode(const char *path)
+{
+	static uint8_t dump[BSRAM_SIZE];
+	const char *hand[3] = {"Rock", "Paper", "Scissors"};
+	const char *winner[3] = {"Tie", "Nucleo", "Disc"};		// Indexed by (nucleo - disc + 3) % 3
+	History_Anchor_t anchors[HISTORY_BLOCKS];
+	History_Cursor_t cur;
+	uint8_t order[HISTORY_BLOCKS], n, c;
+	uint32_t r, entries;
+	FILE *f = fopen(path, "rb");
+	size_t size;
+
+	if(f == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+
+	size = fread(dump, 1, sizeof(dump), f);
+	fclose(f);
+
+	if(size != BSRAM_SIZE && size != HISTORY_SIZE)
+	{
+		fprintf(stderr, "%s: %zu bytes, expected %u (backup SRAM) or %u (history only)\n", path, size, BSRAM_SIZE, HISTORY_SIZE);
+		return 1;
+	}
+
+	const uint8_t *mem = dump + ((size == BSRAM_SIZE) ? HISTORY_OFFSET : 0);
+
+	n = sorted_blocks(mem, order, anchors);
+	printf("round,nucleo,disc,winner\n");
+
+	for(uint8_t i = 0; i < n; i++)
+	{
+		r = anchors[order[i]].round;
+		entries = History_Scan(mem, order[i], &cur, decoded, sizeof(decoded));
+		printf("# block %u: anchor round %u, minute %u, %u rounds in %u nibbles\n", order[i], r, \
+			   anchors[order[i]].minute, cur.rounds, cur.pos);
+
+		for(uint32_t k = 0; k < entries; k++, r++)
+		{
+			c = decoded[k];
+
+			if(c == HISTORY_RESTART)
+			{
+				printf("# restart\n");
+				r--;
+			}else if(c == HISTORY_ERROR)
+			{
+				printf("%u,,,Error\n", r);
+			}else
+			{
+				printf("%u,%s,%s,%s\n", r, hand[c / 3], hand[c % 3], winner[(c / 3 - c % 3 + 3) % 3]);
+			}
+		}
+	}
+
+	if(n == 0)
+	{
+		fprintf(stderr, "No valid block anchor: history empty or not formatted\n");
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Returns the next round code of the check: runs of a repeated round, error runs
+  * 		and random rounds
+  * @param  rng pointer to the generator state (xorshift32)
+  * @param  run pointer to the rounds left in the current run
+  * @param  last code of the previous round
+  * @retval Round code
+  */
+
+static uint8_t next_code(uint32_t *rng, uint32_t *run, uint8_t last)
+{
+	*rng ^= *rng << 13;
+	*rng ^= *rng >> 17;
+	*rng ^= *rng << 5;
+
+	if(*run > 0)
+	{
+		(*run)--;
+		return last;
+	}
+
+	if(*rng % 16 == 0)
+	{
+		*run = (*rng >> 8) % 40;		// Crosses the 15-round run limit now and then
+		return ((*rng >> 16) % 4 == 0) ? HISTORY_ERROR : last % 9;
+	}
+
+	return (*rng >> 8) % 9;
+}
+
+
+/**
+  * @brief  Records a round code through History_Record()
+  * @param  h pointer to the writer state
+  * @param  code round code (0 to 8, or HISTORY_ERROR)
+  * @retval None
+  */
+
+static void record(History_t *h, uint8_t code)
+{
+	if(code == HISTORY_ERROR)
+	{
+		History_Record(h, 0xFF, 0xFF, 0);
+	}else
+	{
+		History_Record(h, code / 3, code % 3, 0);
+	}
+}
+
+
+/**
+  * @brief  Runs the torn-write check
+  * @param  rounds rounds to record
+  * @param  seed seed of the rounds
+  * @retval 0 if every check passed
+  */
+
+static int check(uint32_t rounds, uint32_t seed)
+{
+	static uint8_t before[HISTORY_SIZE], after[HISTORY_SIZE];
+	History_t h, h_before, h_torn;
+	uint32_t rng = (seed != 0) ? seed : 1, run = 0, kept = 0, kept_max = 0, torn = 0, restarts = 0;
+	uint32_t lap = HISTORY_BLOCKS * HISTORY_NIBBLES, kept_min = UINT32_MAX;
+	long w;
+
+	expected = malloc((rounds + RESUME_ROUNDS > UNIFORM_LAPS * lap) ? rounds + RESUME_ROUNDS : UNIFORM_LAPS * lap);
+	if(expected == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for(uint32_t i = 0; i < rounds + RESUME_ROUNDS; i++)
+	{
+		expected[i] = next_code(&rng, &run, (i > 0) ? expected[i-1] : 0);
+	}
+
+	for(uint32_t i = 0; i < HISTORY_SIZE; i++)		// Power-on content of the SRAM
+	{
+		ram[i] = (uint8_t)(i * 2654435761u >> 24);
+	}
+
+	History_Init(&h, ram, 0);
+	verify(ram, 0, "format");
+
+	for(uint32_t i = 0; i < rounds; i++)
+	{
+		if(i % RESTART_EVERY == RESTART_EVERY - 1)		// Restart, torn at every write of the recovery too
+		{
+			memcpy(before, ram, HISTORY_SIZE);
+			writes = 0;
+			History_Init(&h_torn, ram, 0);
+			w = writes;
+
+			for(long k = 0; k < w; k++)
+			{
+				memcpy(ram, before, HISTORY_SIZE);
+				writes = 0;
+				tear_at = k;
+				History_Init(&h_torn, ram, 0);
+				tear_at = -1;
+				History_Init(&h_torn, ram, 0);
+				verify(ram, i, "torn restart");
+				torn++;
+			}
+
+			memcpy(ram, before, HISTORY_SIZE);
+			History_Init(&h, ram, 0);
+			restarts++;
+		}
+
+		memcpy(before, ram, HISTORY_SIZE);
+		h_before = h;
+		writes = 0;
+		record(&h, expected[i]);
+		w = writes;
+		memcpy(after, ram, HISTORY_SIZE);
+
+		for(long k = 0; k < w; k++)		// Power lost after k of the w writes of this round
+		{
+			memcpy(ram, before, HISTORY_SIZE);
+			h_torn = h_before;
+			writes = 0;
+			tear_at = k;
+			record(&h_torn, expected[i]);
+			tear_at = -1;
+
+			History_Init(&h_torn, ram, 0);
+			verify(ram, i, "torn round");
+
+			for(uint32_t j = 0; j < RESUME_ROUNDS; j++)
+			{
+				record(&h_torn, expected[i + j]);
+			}
+			verify(ram, i + RESUME_ROUNDS, "resume after torn round");
+			torn++;
+		}
+
+		memcpy(ram, after, HISTORY_SIZE);
+		kept = verify(ram, i + 1, "round");
+		kept_max = (kept > kept_max) ? kept : kept_max;
+	}
+
+	printf("%u rounds, %u restarts, %u torn writes recovered\n", rounds, restarts, torn);
+	printf("Ring of %u x %u bytes, rounds with runs: %u rounds kept now, %u at most\n", HISTORY_BLOCKS, \
+		   HISTORY_BLOCK_SIZE, kept, kept_max);
+
+	// Uniform random rounds, with no runs but those chance makes. Only the oldest block is
+	// lost when the ring wraps, so about HISTORY_BLOCKS - 1 blocks' worth stay at least
+	for(uint32_t i = 0; i < UNIFORM_LAPS * lap; i++)
+	{
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		expected[i] = (rng >> 8) % 9;
+	}
+
+	for(uint32_t i = 0; i < HISTORY_SIZE; i++)
+	{
+		ram[i] = (uint8_t)(i * 2654435761u >> 24);
+	}
+
+	History_Init(&h, ram, 0);
+	kept_max = 0;
+
+	for(uint32_t i = 0; i < UNIFORM_LAPS * lap; i++)
+	{
+		record(&h, expected[i]);
+		kept = verify(ram, i + 1, "uniform round");
+
+		if(i >= lap)				// The ring has wrapped
+		{
+			kept_min = (kept < kept_min) ? kept : kept_min;
+			kept_max = (kept > kept_max) ? kept : kept_max;
+		}
+	}
+
+	printf("Uniform random rounds: %u to %u kept once the ring has wrapped (%.2f to %.2f bits per round)\n", \
+		   kept_min, kept_max, 8.0 * HISTORY_SIZE / kept_max, 8.0 * HISTORY_SIZE / kept_min);
+
+	free(expected);
+
+	if(kept_min < (HISTORY_BLOCKS - 1) * HISTORY_NIBBLES * 98 / 100)
+	{
+		fprintf(stderr, "FAIL uniform rounds: %u kept, under 98 %% of %u blocks\n", kept_min, HISTORY_BLOCKS - 1);
+		return 1;
+	}
+
+	printf("PASS\n");
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && strcmp(argv[1], "decode") == 0)
+	{
+		return decode(argv[2]);
+	}
+
+	if(argc >= 2 && strcmp(argv[1], "check") == 0)
+	{
+		return check((argc >= 3) ? strtoul(argv[2], NULL, 0) : 30000, (argc >= 4) ? strtoul(argv[3], NULL, 0) : 1);
+	}
+
+	fprintf(stderr, "Usage: %s decode bsram.bin\n       %s check [rounds] [seed]\n", argv[0], argv[0]);
+
+	return 1;
+}
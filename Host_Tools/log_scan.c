@@ -0,0 +1,863 @@
+/**
+  ******************************************************************************
+  * @file    log_scan.c
+  * @author  Moe2Code
+  * @brief   Analyzer of the boards' UART captures (Tera Term logs of Disc or Nucleo, one
+  *          board per file). The files are memory-mapped and cut into chunks at line ends;
+  *          threads take the chunks in turn. Lines are told apart by their first byte and a
+  *          compare with the few known texts starting with it (no regex, no copy).
+  *          Prints per file (board): results, hands, restarts, sleeps, CAN errors, the last
+  *          game stats, and the anomalies: garbled lines, stats that moved by a different
+  *          number of rounds than the results logged in between, lost results and Rx
+  *          overruns reported by the stats.
+  *          -s prints every stats snapshot as CSV instead (file, line, RTC time, counters).
+  *          bench: writes a synthetic Disc capture with known counts and anomalies, checks
+  *          the scan and reports its speed with 1 thread up to the number of cores.
+  *          Usage: ./log_scan [-t threads] [-s] capture.log...
+  *                 ./log_scan bench [MB] [-t threads]
+  * @note    Nucleo's counters travel as bytes in the stats frame, so stats deltas are taken
+  *          modulo 256: more than 255 rounds between two snapshots go unchecked
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// Defines
+#define CHUNK_SIZE			(16 << 20)	// Bytes per work item (cut at the next line end)
+#define MAX_LISTED			10			// Anomalies printed per file, the rest are counted
+#define STATS_FIELDS		7			// Nucleo Wins, Disc Wins, Ties, Game Error, Lost Results, Nucleo Rx Overruns, Disc Rx Overruns
+#define STAMP_LEN			25			// "20YY-MM-DD hh:mm:ss AM - " before "STATS: "
+#define BENCH_ROUNDS_PER_STATS	15
+
+// Line counters. Results and hands take 4 and 3 counters, indexed by the value after the text
+#define C_RESULT_SENT		0			// Disc: Nucleo wins, Disc wins, a tie, error
+#define C_RESULT_RECEIVED	4			// Nucleo
+#define C_NUCLEO_HAND		8			// Disc: Rock, Paper, Scissors
+#define C_DISC_HAND			11			// Disc
+#define C_HAND_SENT			14			// Nucleo
+#define C_STATS				17
+#define C_STATS_REQUEST		18
+#define C_STATS_REPLY		19
+#define C_START				20
+#define C_WAKE				21
+#define C_SLEEP				22
+#define C_CAN_ERROR			23
+#define C_OVERRUN			24
+#define C_TX_ERROR			25
+#define C_OTHER				26
+#define C_GARBLED			27
+#define COUNTERS			28
+
+// What follows a known text
+#define VALUE_NONE			0
+#define VALUE_RESULT		1
+#define VALUE_HAND			2
+
+#define EVENT_SNAPSHOT		0
+#define EVENT_RESTART		1
+
+
+// Typedefs
+// Known line start
+typedef struct
+{
+	const char *text;
+	uint8_t len;
+	uint8_t counter;
+	uint8_t value;
+} Pattern_t;
+
+// Stats snapshot or restart, in line order
+typedef struct
+{
+	uint64_t line;				// Line in the chunk
+	uint64_t results;			// Result lines since the previous event of the chunk
+	uint8_t type;
+	uint32_t stats[STATS_FIELDS];
+	char time[STAMP_LEN];
+} Event_t;
+
+// Work item: a chunk of a file and what was found in it
+typedef struct
+{
+	uint32_t file;
+	const char *begin, *end;
+	uint64_t lines;
+	uint64_t count[COUNTERS];
+	uint64_t first_garbled;		// Line in the chunk, UINT64_MAX if none
+	Event_t *event;
+	uint32_t events, max_events;
+	uint64_t results;			// Result lines after the last event
+} Part_t;
+
+// Mapped capture
+typedef struct
+{
+	const char *name;
+	const char *map;
+	size_t size;
+} File_t;
+
+
+// Global variables
+#define P(text, counter, value)		{text, sizeof(text) - 1, counter, value}
+static const Pattern_t patterns[] =	// Sorted by first byte
+{
+	P("CAN Error Occurred", C_CAN_ERROR, VALUE_NONE),
+	P("CAN Rx FIFO overrun", C_OVERRUN, VALUE_NONE),
+	P("Disc's hand is ", C_DISC_HAND, VALUE_HAND),
+	P("Disc initialization successful", C_START, VALUE_NONE),
+	P("Light lost; gone to sleep", C_SLEEP, VALUE_NONE),
+	P("Message received. Nucleo's hand is ", C_NUCLEO_HAND, VALUE_HAND),
+	P("Nucleo initialization successful", C_START, VALUE_NONE),
+	P("Nucleo sent game stats to Disc", C_STATS_REPLY, VALUE_NONE),
+	P("Received message with game result: ", C_RESULT_RECEIVED, VALUE_RESULT),
+	P("Sent message with game result: ", C_RESULT_SENT, VALUE_RESULT),
+	P("Sent message containing Nucleo's hand (", C_HAND_SENT, VALUE_HAND),
+	P("Sent Remote Frame to ask for game stats", C_STATS_REQUEST, VALUE_NONE),
+	P("Woke up from Standby mode", C_WAKE, VALUE_NONE),
+};
+static uint8_t first_pattern[256];		// Index + 1 of the first pattern starting with a byte, 0 if none
+static int8_t value_of[3][256];			// Counter offset from the first byte of the value, -1 if unknown
+static File_t *files;
+static Part_t *parts;
+static uint32_t n_parts;
+static atomic_uint next_part;
+
+
+// Function prototypes
+static void init_tables(void);
+static void add_event(Part_t *part, uint8_t type);
+static void parse_stats(const char *s, const char *end, Event_t *ev);
+static void scan_line(const char *s, const char *end, uint8_t garbled, Part_t *part);
+static void scan_part(Part_t *part);
+static void* worker(void *arg);
+static int map_files(int count, char *names[]);
+static void scan(long threads);
+static uint64_t report(uint32_t file, uint8_t csv, FILE *out);
+static int bench(int argc, char *argv[]);
+static double now_s(void);
+
+
+/**
+  * @brief  Fills the first byte and value lookup tables
+  * @param  None
+  * @retval None
+  */
+
+static void init_tables(void)
+{
+	for(int i = sizeof(patterns) / sizeof(patterns[0]) - 1; i >= 0; i--)
+	{
+		first_pattern[(uint8_t)patterns[i].text[0]] = i + 1;
+	}
+
+	memset(value_of, -1, sizeof(value_of));
+	value_of[VALUE_RESULT]['N'] = 0;		// Nucleo wins
+	value_of[VALUE_RESULT]['D'] = 1;		// Disc wins
+	value_of[VALUE_RESULT]['A'] = 2;		// A tie
+	value_of[VALUE_RESULT]['E'] = 3;		// Error occurred
+	value_of[VALUE_HAND]['R'] = 0;
+	value_of[VALUE_HAND]['P'] = 1;
+	value_of[VALUE_HAND]['S'] = 2;
+}
+
+
+/**
+  * @brief  Appends an event to a chunk
+  * @param  part chunk
+  * @param  type EVENT_xxx
+  * @retval None
+  */
+
+static void add_event(Part_t *part, uint8_t type)
+{
+	if(part->events == part->max_events)
+	{
+		part->max_events = part->max_events ? 2 * part->max_events : 256;
+		part->event = realloc(part->event, part->max_events * sizeof(Event_t));
+
+		if(part->event == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+
+	memset(&part->event[part->events], 0, sizeof(Event_t));
+	part->event[part->events].line = part->lines;
+	part->event[part->events].results = part->results;
+	part->event[part->events].type = type;
+	part->events++;
+	part->results = 0;
+}
+
+
+/**
+  * @brief  Reads the counters of a STATS line (each number follows ": ")
+  * @param  s start of the line, at the RTC stamp
+  * @param  end end of the line
+  * @param  ev receives the stamp and the counters
+  * @retval None
+  */
+
+static void parse_stats(const char *s, const char *end, Event_t *ev)
+{
+	const char *p = s + STAMP_LEN + 6;		// After "STATS:"
+
+	memcpy(ev->time, s, STAMP_LEN - 3);		// Without " - "
+
+	for(uint8_t k = 0; k < STATS_FIELDS && p < end; k++)
+	{
+		while(p < end && *p != ':')
+		{
+			p++;
+		}
+
+		for(p += 2; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			ev->stats[k] = 10 * ev->stats[k] + (*p - '0');
+		}
+	}
+}
+
+
+/**
+  * @brief  Counts a line
+  * @param  s start of the line
+  * @param  end end of the line (its '\n' or the end of the chunk)
+  * @param  garbled 1 if the line holds bytes outside 0x20..0x7E (but its "\r\n")
+  * @param  part chunk
+  * @retval None
+  */
+
+static void scan_line(const char *s, const char *end, uint8_t garbled, Part_t *part)
+{
+	size_t len;
+	int8_t v;
+
+	if(garbled)
+	{
+		part->first_garbled = (part->first_garbled == UINT64_MAX) ? part->lines : part->first_garbled;
+		part->count[C_GARBLED]++;
+		return;
+	}
+
+	if(end > s && end[-1] == '\r')
+	{
+		end--;
+	}
+
+	if(s < end && *s == '[')		// Tera Term timestamp ("[Sun Oct 18 13:30:00.123 2026] ")
+	{
+		const char *close = memchr(s, ']', end - s);
+
+		s = (close != NULL && close + 2 <= end) ? close + 2 : s;
+	}
+
+	len = end - s;
+
+	if(len > STAMP_LEN + 7 && s[0] == '2' && s[4] == '-' && memcmp(s + STAMP_LEN, "STATS: ", 7) == 0)
+	{
+		add_event(part, EVENT_SNAPSHOT);
+		parse_stats(s, end, &part->event[part->events - 1]);
+		part->count[C_STATS]++;
+		return;
+	}
+
+	if(len > 5 && memcmp(s, "send_", 5) == 0 && len >= 8 && memcmp(end - 8, "Tx error", 8) == 0)
+	{
+		part->count[C_TX_ERROR]++;
+		return;
+	}
+
+	for(int i = (len > 0) ? first_pattern[(uint8_t)*s] - 1 : -1; i >= 0 && i < (int)(sizeof(patterns) / sizeof(patterns[0])) && \
+		patterns[i].text[0] == *s; i++)
+	{
+		const Pattern_t *pat = &patterns[i];
+
+		if(len >= pat->len && memcmp(s, pat->text, pat->len) == 0 && \
+		   (pat->value == VALUE_NONE || len > pat->len) && \
+		   (v = (pat->value == VALUE_NONE) ? 0 : value_of[pat->value][(uint8_t)s[pat->len]]) >= 0)
+		{
+			part->count[pat->counter + v]++;
+
+			if(pat->counter == C_START || pat->counter == C_WAKE)
+			{
+				add_event(part, EVENT_RESTART);
+			}else if(pat->value == VALUE_RESULT)
+			{
+				part->results++;
+			}
+
+			return;
+		}
+	}
+
+	part->count[C_OTHER] += (len > 0);
+}
+
+
+/**
+  * @brief  Counts the lines of a chunk. One pass, 8 bytes at a time, stops only at bytes
+  * 		outside 0x20..0x7E: line ends and garbled bytes
+  * @param  part chunk
+  * @retval None
+  */
+
+static void scan_part(Part_t *part)
+{
+	const char *line = part->begin, *p = part->begin, *end = part->end;
+	uint64_t word, stop;
+	uint8_t garbled = 0;
+
+	part->first_garbled = UINT64_MAX;
+
+	while(p < end)
+	{
+		if(p + 8 <= end)
+		{
+			memcpy(&word, p, 8);
+			stop = ((word - 0x2020202020202020ULL) | (word + 0x0101010101010101ULL) | word) & 0x8080808080808080ULL;
+
+			if(stop == 0)
+			{
+				p += 8;
+				continue;
+			}
+
+			p += __builtin_ctzll(stop) / 8;		// First byte below 0x20 or above 0x7E (carries only go upwards)
+		}else if(*p >= 0x20 && *p <= 0x7E)
+		{
+			p++;
+			continue;
+		}
+
+		if(*p == '\n')
+		{
+			scan_line(line, p, garbled, part);
+			part->lines++;
+			line = p + 1;
+			garbled = 0;
+		}else if(*p != '\r' || p + 1 >= end || p[1] != '\n')
+		{
+			garbled = 1;
+		}
+
+		p++;
+	}
+
+	if(line < end)		// Last line of the file without a line end
+	{
+		scan_line(line, end, garbled, part);
+		part->lines++;
+	}
+}
+
+
+/**
+  * @brief  Worker thread: scans chunks until none is left
+  * @param  arg unused
+  * @retval NULL
+  */
+
+static void* worker(void *arg)
+{
+	uint32_t i;
+
+	(void)arg;
+
+	while((i = atomic_fetch_add(&next_part, 1)) < n_parts)
+	{
+		scan_part(&parts[i]);
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Maps the captures and cuts them into chunks at line ends
+  * @param  count number of files
+  * @param  names file names
+  * @retval 0 on success, -1 on error (printed)
+  */
+
+static int map_files(int count, char *names[])
+{
+	uint32_t max = 0;
+
+	files = calloc(count, sizeof(File_t));
+	n_parts = 0;
+
+	for(int f = 0; f < count; f++)
+	{
+		struct stat st;
+		int fd = open(names[f], O_RDONLY);
+		const char *cut;
+
+		if(fd < 0 || fstat(fd, &st) != 0)
+		{
+			perror(names[f]);
+			return -1;
+		}
+
+		files[f].name = names[f];
+		files[f].size = st.st_size;
+		files[f].map = (st.st_size > 0) ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+		close(fd);
+
+		if(files[f].map == MAP_FAILED)
+		{
+			perror(names[f]);
+			return -1;
+		}
+
+		madvise((void *)files[f].map, files[f].size, MADV_SEQUENTIAL);
+
+		for(size_t at = 0; at == 0 || at < files[f].size; )		// An empty file is one empty chunk
+		{
+			if(n_parts == max)
+			{
+				max = max ? 2 * max : 64;
+				parts = realloc(parts, max * sizeof(Part_t));
+			}
+
+			memset(&parts[n_parts], 0, sizeof(Part_t));
+			parts[n_parts].file = f;
+			parts[n_parts].begin = files[f].map + at;
+
+			cut = (files[f].size - at > CHUNK_SIZE) ? memchr(files[f].map + at + CHUNK_SIZE, '\n', files[f].size - at - CHUNK_SIZE) : NULL;
+			at = (cut != NULL) ? (size_t)(cut - files[f].map) + 1 : files[f].size;
+			parts[n_parts++].end = files[f].map + at;
+
+			if(at == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Scans every chunk with a number of threads
+  * @param  threads number of threads
+  * @retval None
+  */
+
+static void scan(long threads)
+{
+	pthread_t *tid = calloc(threads, sizeof(pthread_t));
+
+	atomic_store(&next_part, 0);
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_create(&tid[t], NULL, worker, NULL);
+	}
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_join(tid[t], NULL);
+	}
+
+	free(tid);
+}
+
+
+/**
+  * @brief  Joins the chunks of a file and prints its summary (or its snapshots)
+  * @param  file file index
+  * @param  csv 1 to print the stats snapshots as CSV instead
+  * @param  out where to print
+  * @retval Number of anomalies
+  */
+
+static uint64_t report(uint32_t file, uint8_t csv, FILE *out)
+{
+	uint64_t count[COUNTERS] = {0}, lines = 0, results = 0, garbled = UINT64_MAX, anomalies = 0;
+	const Event_t *prev = NULL;
+	uint8_t restarted = 0;
+	char msg[160];
+
+	if(!csv)
+	{
+		fprintf(out, "%s\n", files[file].name);
+	}
+
+	for(uint32_t i = 0; i < n_parts; i++)
+	{
+		const Part_t *part = &parts[i];
+
+		if(part->file != file)
+		{
+			continue;
+		}
+
+		for(uint8_t k = 0; k < COUNTERS; k++)
+		{
+			count[k] += part->count[k];
+		}
+
+		garbled = (garbled == UINT64_MAX && part->first_garbled != UINT64_MAX) ? lines + part->first_garbled : garbled;
+
+		for(uint32_t e = 0; e < part->events; e++)
+		{
+			const Event_t *ev = &part->event[e];
+
+			results += ev->results;
+
+			if(ev->type == EVENT_RESTART)
+			{
+				restarted = 1;
+				continue;
+			}
+
+			if(csv)
+			{
+				fprintf(out, "%s,%llu,%s", files[file].name, (unsigned long long)(lines + ev->line + 1), ev->time);
+
+				for(uint8_t k = 0; k < STATS_FIELDS; k++)
+				{
+					fprintf(out, ",%u", ev->stats[k]);
+				}
+
+				fprintf(out, "\n");
+			}else if(prev != NULL && !restarted)
+			{
+				uint32_t moved = 0, lost = (ev->stats[4] - prev->stats[4]) & 0xFF, nucleo_ovr = (ev->stats[5] - prev->stats[5]) & 0xFF;
+				uint32_t disc_ovr = (ev->stats[6] > prev->stats[6]) ? ev->stats[6] - prev->stats[6] : 0;
+
+				for(uint8_t k = 0; k < 4; k++)
+				{
+					moved += (ev->stats[k] - prev->stats[k]) & 0xFF;
+				}
+
+				msg[0] = '\0';
+
+				if(moved > results + 1 || moved + 1 < results)		// A round may be in flight at either snapshot
+				{
+					sprintf(msg + strlen(msg), " stats moved by %u rounds, %llu results logged;", moved, (unsigned long long)results);
+				}
+
+				if(lost > 0)
+				{
+					sprintf(msg + strlen(msg), " %u results lost;", lost);
+				}
+
+				if(nucleo_ovr > 0 || disc_ovr > 0)
+				{
+					sprintf(msg + strlen(msg), " Rx overruns +%u Nucleo +%u Disc;", nucleo_ovr, disc_ovr);
+				}
+
+				if(msg[0] != '\0' && anomalies++ < MAX_LISTED)
+				{
+					fprintf(out, "  line %llu:%s\n", (unsigned long long)(lines + ev->line + 1), msg);
+				}
+			}
+
+			prev = ev;
+			restarted = 0;
+			results = 0;
+		}
+
+		results += part->results;
+		lines += part->lines;
+	}
+
+	if(csv)
+	{
+		return 0;
+	}
+
+	anomalies += count[C_GARBLED];
+
+	fprintf(out, "  %s, %llu lines, %.1f MB\n", (count[C_RESULT_SENT] + count[C_NUCLEO_HAND] + count[C_STATS] >= \
+		   count[C_RESULT_RECEIVED] + count[C_HAND_SENT] + count[C_STATS_REPLY]) ? "Disc" : "Nucleo", \
+		   (unsigned long long)lines, files[file].size / 1e6);
+	fprintf(out, "  results: Nucleo wins %llu, Disc wins %llu, ties %llu, errors %llu\n", \
+		   (unsigned long long)(count[C_RESULT_SENT] + count[C_RESULT_RECEIVED]), \
+		   (unsigned long long)(count[C_RESULT_SENT + 1] + count[C_RESULT_RECEIVED + 1]), \
+		   (unsigned long long)(count[C_RESULT_SENT + 2] + count[C_RESULT_RECEIVED + 2]), \
+		   (unsigned long long)(count[C_RESULT_SENT + 3] + count[C_RESULT_RECEIVED + 3]));
+	fprintf(out, "  hands: Nucleo R/P/S %llu/%llu/%llu, Disc R/P/S %llu/%llu/%llu\n", \
+		   (unsigned long long)(count[C_NUCLEO_HAND] + count[C_HAND_SENT]), \
+		   (unsigned long long)(count[C_NUCLEO_HAND + 1] + count[C_HAND_SENT + 1]), \
+		   (unsigned long long)(count[C_NUCLEO_HAND + 2] + count[C_HAND_SENT + 2]), \
+		   (unsigned long long)count[C_DISC_HAND], (unsigned long long)count[C_DISC_HAND + 1], (unsigned long long)count[C_DISC_HAND + 2]);
+	fprintf(out, "  events: %llu starts, %llu wake-ups, %llu sleeps, %llu CAN errors, %llu Rx FIFO overruns, %llu Tx errors, " \
+		   "%llu stats requests, %llu other lines\n", (unsigned long long)count[C_START], (unsigned long long)count[C_WAKE], \
+		   (unsigned long long)count[C_SLEEP], (unsigned long long)count[C_CAN_ERROR], (unsigned long long)count[C_OVERRUN], \
+		   (unsigned long long)count[C_TX_ERROR], (unsigned long long)(count[C_STATS_REQUEST] + count[C_STATS_REPLY]), \
+		   (unsigned long long)count[C_OTHER]);
+
+	if(prev != NULL)
+	{
+		fprintf(out, "  stats: %llu snapshots, last %s: Nucleo Wins %u, Disc Wins %u, Ties %u, Game Error %u, Lost Results %u, " \
+			   "Nucleo Rx Overruns %u, Disc Rx Overruns %u\n", (unsigned long long)count[C_STATS], prev->time, prev->stats[0], \
+			   prev->stats[1], prev->stats[2], prev->stats[3], prev->stats[4], prev->stats[5], prev->stats[6]);
+	}
+
+	if(count[C_GARBLED] > 0)
+	{
+		fprintf(out, "  %llu garbled lines, the first at line %llu\n", (unsigned long long)count[C_GARBLED], (unsigned long long)garbled + 1);
+	}
+
+	fprintf(out, "  %llu anomalies\n", (unsigned long long)anomalies);
+
+	return anomalies;
+}
+
+
+/**
+  * @brief  Returns a monotonic time in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Writes a synthetic Disc capture with known counts and anomalies, checks the scan
+  * 		against them and times it
+  * @param  argc, argv options
+  * @retval Exit code
+  */
+
+static int bench(int argc, char *argv[])
+{
+	const char *names[3] = {"Rock", "Paper", "Scissors"}, *result[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+	char *path = "log_scan_bench.log";
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t size = 256, expect[COUNTERS] = {0}, expect_anomalies = 0, seed = 90, found[COUNTERS], anomalies = 0, written = 0;
+	uint32_t stats[STATS_FIELDS] = {0}, round = 0;
+	uint8_t inject = 0, restarted = 1;
+	double t0, one = 0;
+	FILE *f, *null;
+	int opt, fail = 0;
+
+	if(argc > 1 && argv[1][0] != '-')
+	{
+		size = strtoull(argv[1], NULL, 0);
+		argc--;
+		argv++;
+	}
+
+	while((opt = getopt(argc, argv, "t:")) != -1)
+	{
+		switch(opt)
+		{
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: ./log_scan bench [MB] [-t threads]\n");
+				return 1;
+		}
+	}
+
+	if((f = fopen(path, "w")) == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+
+	fprintf(f, "Disc initialization successful\r\n");
+	expect[C_START]++;
+
+	while(written < size << 20)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint8_t nucleo = (seed >> 33) % 3, disc = (seed >> 40) % 3, winner = (nucleo == disc) ? 3 : (nucleo == (disc + 1) % 3) ? 1 : 2;
+
+		winner = ((seed >> 50) % 500 == 0) ? 4 : winner;
+		written += fprintf(f, "Message received. Nucleo's hand is %s\r\nDisc's hand is %s\r\n", names[nucleo], names[disc]);
+		expect[C_NUCLEO_HAND + nucleo]++;
+		expect[C_DISC_HAND + disc]++;
+		stats[winner - 1]++;
+
+		if(inject == 2 && round % BENCH_ROUNDS_PER_STATS < 3)		// Result lines missing from the capture
+		{
+			written += fprintf(f, "Sent message with game\xFF\r\n");
+			expect[C_GARBLED]++;
+			expect_anomalies++;
+		}else
+		{
+			written += fprintf(f, "Sent message with game result: %s\r\n", result[winner - 1]);
+			expect[C_RESULT_SENT + winner - 1]++;
+		}
+
+		if((seed >> 20) % 20000 == 0)
+		{
+			written += fprintf(f, "CAN Error Occurred\r\n");
+			expect[C_CAN_ERROR]++;
+		}
+
+		if(++round % BENCH_ROUNDS_PER_STATS == 0)
+		{
+			if(inject == 1)
+			{
+				stats[4]++;		// A lost result
+			}
+
+			expect_anomalies += (inject != 0 && !restarted) ? 1 : 0;		// Intervals with a restart are not checked
+			written += fprintf(f, "Sent Remote Frame to ask for game stats\r\n2026-10-18 %02u:%02u:%02u PM - STATS: Nucleo Wins: %u, " \
+							   "Disc Wins: %u, Ties: %u, Game Error: %u, Lost Results: %u, Nucleo Rx Overruns: %u, Disc Rx Overruns: %u\r\n" \
+							   "CAN1 single tx:%u rx:%u txerr:0 busoff:0 failover:0 dup:0 tec:0 rec:0\r\n", \
+							   (round / 900) % 12 + 1, (round / 15) % 60, round % 60, stats[0] & 0xFF, stats[1] & 0xFF, \
+							   stats[2] & 0xFF, stats[3] & 0xFF, stats[4] & 0xFF, stats[5] & 0xFF, stats[6], round, round);
+			expect[C_STATS_REQUEST]++;
+			expect[C_STATS]++;
+			expect[C_OTHER]++;
+			restarted = 0;
+			inject = ((seed >> 8) % 50 == 0) ? 1 + (seed >> 16) % 2 : 0;
+
+			if((seed >> 24) % 400 == 0)
+			{
+				written += fprintf(f, "Light lost; gone to sleep\r\nWoke up from Standby mode\r\n");
+				expect[C_SLEEP]++;
+				expect[C_WAKE]++;
+				restarted = 1;
+			}
+		}
+	}
+
+	fclose(f);
+
+	init_tables();
+
+	if(map_files(1, &path) != 0)
+	{
+		return 1;
+	}
+
+	printf("%.1f MB capture, %u chunks\n", files[0].size / 1e6, n_parts);
+	null = fopen("/dev/null", "w");
+
+	for(long n = 1; ; n = (2 * n > threads) ? threads : 2 * n)		// 1, 2, 4... and the number of cores
+	{
+		for(uint32_t i = 0; i < n_parts; i++)
+		{
+			free(parts[i].event);
+			memset(&parts[i].lines, 0, sizeof(Part_t) - offsetof(Part_t, lines));
+		}
+
+		t0 = now_s();
+		scan(n);
+		t0 = now_s() - t0;
+		one = (n == 1) ? t0 : one;
+
+		memset(found, 0, sizeof(found));
+
+		for(uint32_t i = 0; i < n_parts; i++)
+		{
+			for(uint8_t k = 0; k < COUNTERS; k++)
+			{
+				found[k] += parts[i].count[k];
+			}
+		}
+
+		anomalies = report(0, 0, null);
+
+		fail |= memcmp(found, expect, sizeof(found)) != 0 || anomalies != expect_anomalies;
+		printf("%3ld threads: %.3f s, %6.2f GB/s, x%.2f %s\n", n, t0, files[0].size / t0 / 1e9, one / t0, fail ? "FAIL" : "");
+
+		if(n == threads)
+		{
+			break;
+		}
+	}
+
+	if(fail)
+	{
+		for(uint8_t k = 0; k < COUNTERS; k++)
+		{
+			if(found[k] != expect[k])
+			{
+				printf("counter %u: %llu, expected %llu\n", k, (unsigned long long)found[k], (unsigned long long)expect[k]);
+			}
+		}
+
+		printf("anomalies: %llu, expected %llu\n", (unsigned long long)anomalies, (unsigned long long)expect_anomalies);
+	}
+
+	fclose(null);
+	remove(path);
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	uint8_t csv = 0;
+	int opt;
+
+	if(argc >= 2 && strcmp(argv[1], "bench") == 0)
+	{
+		return bench(argc - 1, &argv[1]);
+	}
+
+	while((opt = getopt(argc, argv, "t:s")) != -1)
+	{
+		switch(opt)
+		{
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			case 's': csv = 1; break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+
+	if(optind >= argc || threads < 1)
+	{
+		fprintf(stderr, "Usage: %s [-t threads] [-s] capture.log...\n"
+						"       %s bench [MB] [-t threads]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	init_tables();
+
+	if(map_files(argc - optind, &argv[optind]) != 0)
+	{
+		return 1;
+	}
+
+	scan(threads);
+
+	if(csv)
+	{
+		printf("file,line,time,nucleo_wins,disc_wins,ties,game_error,lost_results,nucleo_rx_overruns,disc_rx_overruns\n");
+	}
+
+	for(int f = 0; f < argc - optind; f++)
+	{
+		report(f, csv, stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,1548 @@
+/**
+  ******************************************************************************
+  * @file    metrics_exporter.c
+  * @author  Moe2Code
+  * @brief   Daemon exporting the boards' telemetry to Prometheus. Reads the UART text of
+  *          either board from a serial device or pty, and/or the game frames from a
+  *          SocketCAN interface, keeps counters, histograms and health flags per node and
+  *          serves them as Prometheus text exposition on 127.0.0.1.
+  *          A node is a source (serial device or CAN interface). can:any listens on every
+  *          CAN interface and makes a node of each one frames come from.
+  *          Counters come from the game stats (send_game_stats: stats frame 0x633, or the
+  *          STATS line printed by Disc) and from the error callbacks (CAN errors, Tx errors as
+  *          printed, Rx FIFO overrun lines of older firmware, SocketCAN error frames).
+  *          Everything runs in one poll() loop on non-blocking descriptors and all state is
+  *          static: at most MAX_NODES nodes (the one heard from least recently is evicted for
+  *          a new one), fixed line and request buffers, MAX_CLIENTS scrapes at a time.
+  *          check: feeds a synthetic Disc session through a pty and game frames through the
+  *          frame decoder, scrapes /metrics over HTTP and checks the values
+  *          Usage: ./metrics_exporter [-p port] [-b baud] [name=]/dev/ttyACM0... [can:vcan0|can:any]...
+  *                 ./metrics_exporter check
+  * @note    Nucleo's counters travel as bytes in the stats frame. They are unwrapped into
+  *          64-bit counters: a step back by more than 127 is taken as a counter reset
+  */
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/can/error.h>
+
+
+// Defines
+#define MAX_NODES			64			// Nodes kept. A new node evicts the one heard from least recently
+#define MAX_SOURCES			16
+#define MAX_CLIENTS			4			// Scrapes served at a time, more connections are closed at once
+#define NAME_LEN			32
+#define PATH_LEN			128
+#define LINE_LEN			256			// Longer UART lines are counted as garbled
+#define REQUEST_LEN			1024		// HTTP request head
+#define HEADER_LEN			128			// HTTP response head
+#define NODE_TEXT			6144		// Upper bound of the exposition text of a node
+#define EXPO_SIZE			(4096 + MAX_SOURCES * 512 + MAX_NODES * NODE_TEXT)
+#define DEFAULT_PORT		9633
+#define DEFAULT_BAUD		115200
+#define RETRY_S				1.0			// Wait before reopening a source that went away
+#define CLIENT_TIMEOUT_S	5.0
+#define STALE_S				30.0		// A node is down when nothing was heard from it for this long
+#define ERROR_RECENT_S		60.0		// An error keeps a node unhealthy for this long
+#define READS_PER_POLL		16			// Reads per source per loop pass, so one busy source cannot starve the rest
+#define IF_CACHE			8			// Interface names remembered by a can:any source
+#define HIST_BUCKETS		8
+#define RESULTS				4			// Nucleo wins, Disc wins, ties, errors
+#define STATS_BYTES			6			// Nucleo Wins, Disc Wins, Ties, Game Error, Lost Results, Nucleo Rx Overruns
+#define BUSES				2			// CAN1, CAN2 of the board's bus report
+#define ERR_CLASSES			7			// SocketCAN error classes counted
+
+#define SRC_SERIAL			0
+#define SRC_CAN				1
+
+#define RESULT_ID			0x111		// Game frames (main_.c of both boards)
+#define HAND_ID				0x49F
+#define STATS_ID			0x633
+#define SLEEP_ID			0x77B
+
+#define CHECK_ROUNDS		700			// Rounds of the check session: the byte counters of the stats wrap twice
+#define CHECK_STATS_EVERY	10
+
+
+// Typedefs
+// Histogram with fixed bucket bounds
+typedef struct
+{
+	uint64_t bucket[HIST_BUCKETS];		// Observations <= bound[i] (not cumulative)
+	uint64_t count;
+	double sum;
+} Hist_t;
+
+// Telemetry of a node
+typedef struct
+{
+	char name[NAME_LEN];
+	uint8_t used;
+	double last_seen;					// Monotonic time of the last line or frame
+	double last_error;					// Monotonic time of the last error, 0 if none
+	double last_result;					// Monotonic time of the last game result, 0 if none
+	double stats_asked;					// Monotonic time of the pending stats request, 0 if none
+	time_t seen_wall;					// Unix time of the last line or frame
+	uint64_t lines, frames, garbled;
+	uint64_t results[RESULTS];			// Game results seen in the UART text or on the bus
+	uint64_t board[STATS_BYTES];		// Counters of send_game_stats, unwrapped
+	uint8_t board_raw[STATS_BYTES];		// Their last values as sent
+	uint8_t board_seen;
+	uint64_t disc_overruns;				// Disc's Rx FIFO overruns of the last STATS line
+	uint64_t stats_requests, stats_reports;
+	uint64_t can_errors, rx_overruns, tx_errors;	// Error callbacks, as printed
+	uint64_t restarts, sleeps;
+	uint64_t error_frames[ERR_CLASSES];	// SocketCAN error frames
+	uint8_t bus_seen[BUSES], bus_up[BUSES];
+	uint64_t bus_busoff[BUSES], bus_txerr[BUSES];
+	Hist_t interval;					// Seconds between game results
+	Hist_t reply;						// Seconds from the stats request to the stats
+} Node_t;
+
+// Telemetry source
+typedef struct
+{
+	uint8_t kind;						// SRC_SERIAL or SRC_CAN
+	char name[NAME_LEN];				// Node of a serial source or of a CAN interface, empty for can:any
+	char path[PATH_LEN];				// Device, or interface name
+	int fd;								// -1 while closed
+	double retry;						// Monotonic time of the next open attempt
+	uint64_t opens, dropped;			// Times opened, frames dropped by the socket (SO_RXQ_OVFL)
+	char line[LINE_LEN];				// Line being received
+	uint16_t len;
+	uint8_t overflow;					// Line too long: dropped at its end
+	int if_index[IF_CACHE];				// can:any: interface names by index
+	char if_name[IF_CACHE][IFNAMSIZ];
+	uint8_t if_next;
+} Source_t;
+
+// Scrape under way
+typedef struct
+{
+	int fd;								// -1 if free
+	double since;
+	char req[REQUEST_LEN];
+	uint16_t req_len;
+	char *out;							// Response being sent, inside buf
+	size_t out_len, sent;
+} Client_t;
+
+// Text buffer of bounded size
+typedef struct
+{
+	char *p;
+	size_t len, size;
+	uint8_t truncated;
+} Buf_t;
+
+// Plain per-node counter of the exposition
+typedef struct
+{
+	const char *name;
+	const char *help;
+	size_t offset;
+} Counter_t;
+
+
+// Global variables
+static Node_t nodes[MAX_NODES];
+static Source_t sources[MAX_SOURCES];
+static Client_t clients[MAX_CLIENTS];
+static char client_buf[MAX_CLIENTS][EXPO_SIZE + HEADER_LEN];
+static uint32_t source_count;
+static int listener = -1;
+static long baud = DEFAULT_BAUD;
+static uint64_t nodes_evicted, scrapes, refused, truncated;
+static volatile sig_atomic_t stop;
+
+static const char *result_names[RESULTS] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+static const char *result_labels[RESULTS] = {"nucleo", "disc", "tie", "error"};
+static const char *stats_labels[RESULTS] = {"nucleo_wins", "disc_wins", "ties", "game_error"};
+static const char *err_labels[ERR_CLASSES] = {"busoff", "controller", "protocol", "no_ack", "bus_error", "tx_timeout", "restarted"};
+static const uint32_t err_flags[ERR_CLASSES] = {CAN_ERR_BUSOFF, CAN_ERR_CRTL, CAN_ERR_PROT, CAN_ERR_ACK, \
+												CAN_ERR_BUSERROR, CAN_ERR_TX_TIMEOUT, CAN_ERR_RESTARTED};
+static const double interval_bounds[HIST_BUCKETS] = {1, 2, 3, 4, 5, 8, 15, 60};	// A round every 4 s (TIM6)
+static const double reply_bounds[HIST_BUCKETS] = {0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.5};
+
+static const Counter_t counters[] =
+{
+	{"rps_lines_total", "UART lines received", offsetof(Node_t, lines)},
+	{"rps_frames_total", "CAN frames received", offsetof(Node_t, frames)},
+	{"rps_garbled_lines_total", "UART lines with bytes outside printable ASCII, or too long", offsetof(Node_t, garbled)},
+	{"rps_stats_requests_total", "Remote frames asking Nucleo for the game stats", offsetof(Node_t, stats_requests)},
+	{"rps_stats_reports_total", "Game stats received (send_game_stats)", offsetof(Node_t, stats_reports)},
+	{"rps_board_lost_results_total", "Hands Nucleo sent without ever getting a game result (stats byte 4)", \
+			offsetof(Node_t, board[4])},
+	{"rps_board_nucleo_rx_overruns_total", "Rx FIFO overruns of Nucleo (stats byte 5)", offsetof(Node_t, board[5])},
+	{"rps_board_disc_rx_overruns_total", "Rx FIFO overruns of Disc (STATS line)", offsetof(Node_t, disc_overruns)},
+	{"rps_can_errors_total", "CAN errors reported by HAL_CAN_ErrorCallback", offsetof(Node_t, can_errors)},
+	{"rps_rx_overrun_events_total", "Rx FIFO overrun lines of older firmware (now in the STATS line only)", offsetof(Node_t, rx_overruns)},
+	{"rps_tx_errors_total", "Frames HAL_CAN_AddTxMessage refused", offsetof(Node_t, tx_errors)},
+	{"rps_restarts_total", "Board initializations", offsetof(Node_t, restarts)},
+	{"rps_sleeps_total", "Times the game went to sleep", offsetof(Node_t, sleeps)},
+};
+
+
+/**
+  * @brief  Returns a monotonic timestamp in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Stops the main loop (SIGINT, SIGTERM)
+  * @param  sig signal number
+  * @retval None
+  */
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+
+/**
+  * @brief  Adds an observation to a histogram
+  * @param  h pointer to the histogram
+  * @param  bounds upper bounds of its buckets
+  * @param  value observation
+  * @retval None
+  */
+
+static void hist_add(Hist_t *h, const double bounds[HIST_BUCKETS], double value)
+{
+	for(int i = 0; i < HIST_BUCKETS; i++)
+	{
+		if(value <= bounds[i])
+		{
+			h->bucket[i]++;
+			break;
+		}
+	}
+
+	h->count++;
+	h->sum += value;
+}
+
+
+/**
+  * @brief  Finds the node of a name, or makes one. When all MAX_NODES are in use, the node
+  * 		heard from least recently is dropped for it
+  * @param  name node name
+  * @param  now monotonic time
+  * @retval Pointer to the node
+  */
+
+static Node_t *node_get(const char *name, double now)
+{
+	Node_t *n = NULL;
+
+	for(int i = 0; i < MAX_NODES; i++)
+	{
+		if(nodes[i].used && strcmp(nodes[i].name, name) == 0)
+		{
+			n = &nodes[i];
+			break;
+		}
+
+		if(n == NULL || (n->used && (!nodes[i].used || nodes[i].last_seen < n->last_seen)))
+		{
+			n = &nodes[i];				// Free slot, else the oldest, in case the name is new
+		}
+	}
+
+	if(n->used && strcmp(n->name, name) == 0)
+	{
+		n->last_seen = now;
+		n->seen_wall = time(NULL);
+
+		return n;
+	}
+
+	nodes_evicted += n->used;
+	memset(n, 0, sizeof(*n));
+	snprintf(n->name, NAME_LEN, "%s", name);
+	n->used = 1;
+	n->last_seen = now;
+	n->seen_wall = time(NULL);
+
+	return n;
+}
+
+
+/**
+  * @brief  Records a game result
+  * @param  n pointer to the node
+  * @param  result 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void on_result(Node_t *n, uint8_t result, double now)
+{
+	n->results[result - 1]++;
+
+	if(n->last_result > 0)
+	{
+		hist_add(&n->interval, interval_bounds, now - n->last_result);
+	}
+
+	n->last_result = now;
+}
+
+
+/**
+  * @brief  Records the game stats of send_game_stats. The byte counters are unwrapped: a
+  * 		step back by more than 127 is a counter reset, the new value is counted from 0
+  * @param  n pointer to the node
+  * @param  stats bytes 0 to 5 of the stats frame
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void on_stats(Node_t *n, const uint8_t stats[STATS_BYTES], double now)
+{
+	for(int i = 0; i < STATS_BYTES; i++)
+	{
+		uint8_t step = stats[i] - n->board_raw[i];
+
+		n->board[i] += (!n->board_seen || step >= 128) ? stats[i] : step;
+		n->board_raw[i] = stats[i];
+	}
+
+	n->board_seen = 1;
+	n->stats_reports++;
+
+	if(n->stats_asked > 0)
+	{
+		hist_add(&n->reply, reply_bounds, now - n->stats_asked);
+		n->stats_asked = 0;
+	}
+}
+
+
+/**
+  * @brief  Acts on a UART line of either board
+  * @param  n pointer to the node
+  * @param  s line, without its line end
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void ingest_line(Node_t *n, const char *s, double now)
+{
+	unsigned v[STATS_BYTES + 1], bus, busoff, txerr;
+	char state[8];
+	const char *p;
+	size_t len = strlen(s);
+
+	n->lines++;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		if((uint8_t)s[i] < 0x20 || (uint8_t)s[i] > 0x7E)
+		{
+			n->garbled++;
+			return;
+		}
+	}
+
+	if((p = strstr(s, "game result: ")) != NULL)			// Disc: "Sent message with", Nucleo: "Received message with"
+	{
+		for(int r = 0; r < RESULTS; r++)
+		{
+			if(strcmp(p + 13, result_names[r]) == 0)
+			{
+				on_result(n, r + 1, now);
+				return;
+			}
+		}
+
+		n->garbled++;
+	}else if((p = strstr(s, "STATS: ")) != NULL)			// Disc, behind the RTC time
+	{
+		uint8_t stats[STATS_BYTES];
+
+		if(sscanf(p, "STATS: Nucleo Wins: %u, Disc Wins: %u, Ties: %u, Game Error: %u, Lost Results: %u, "
+					 "Nucleo Rx Overruns: %u, Disc Rx Overruns: %u", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+		{
+			n->garbled++;
+			return;
+		}
+
+		for(int i = 0; i < STATS_BYTES; i++)
+		{
+			stats[i] = (uint8_t)v[i];
+		}
+
+		on_stats(n, stats, now);
+		n->disc_overruns = v[6];
+	}else if(strcmp(s, "Sent Remote Frame to ask for game stats") == 0)
+	{
+		n->stats_requests++;
+		n->stats_asked = now;
+	}else if(strcmp(s, "CAN Error Occurred") == 0)
+	{
+		n->can_errors++;
+		n->last_error = now;
+	}else if(strcmp(s, "CAN Rx FIFO overrun; frame lost") == 0)
+	{
+		n->rx_overruns++;
+		n->last_error = now;
+	}else if(len > 29 && strcmp(s + len - 29, "HAL_CAN_AddTxMessage Tx error") == 0)
+	{
+		n->tx_errors++;
+		n->last_error = now;
+	}else if(strcmp(s, "Disc initialization successful") == 0 || strcmp(s, "Nucleo initialization successful") == 0)
+	{
+		n->restarts++;
+		n->last_result = 0;
+		n->stats_asked = 0;
+	}else if(strcmp(s, "Light lost; gone to sleep") == 0)
+	{
+		n->sleeps++;
+		n->last_result = 0;
+	}else if(sscanf(s, "CAN%u %7s tx:%*u rx:%*u txerr:%u busoff:%u", &bus, state, &txerr, &busoff) == 4 \
+			 && bus >= 1 && bus <= BUSES)						// Bus report (CAN_Bus_Report)
+	{
+		n->bus_seen[bus - 1] = 1;
+		n->bus_up[bus - 1] = (strcmp(state, "up") == 0);
+		n->bus_txerr[bus - 1] = txerr;
+		n->bus_busoff[bus - 1] = busoff;
+	}
+}
+
+
+/**
+  * @brief  Acts on a CAN frame: game frames, and SocketCAN error frames
+  * @param  n pointer to the node
+  * @param  f frame
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void ingest_frame(Node_t *n, const struct can_frame *f, double now)
+{
+	uint32_t id = f->can_id & CAN_SFF_MASK;
+
+	n->frames++;
+
+	if(f->can_id & CAN_ERR_FLAG)
+	{
+		for(int i = 0; i < ERR_CLASSES; i++)
+		{
+			n->error_frames[i] += (f->can_id & err_flags[i]) != 0;
+		}
+
+		n->last_error = now;
+
+		return;
+	}
+
+	if(f->can_id & CAN_EFF_FLAG)
+	{
+		return;
+	}
+
+	if(id == STATS_ID && (f->can_id & CAN_RTR_FLAG))		// Disc asks for the stats
+	{
+		n->stats_requests++;
+		n->stats_asked = now;
+	}else if(f->can_id & CAN_RTR_FLAG)
+	{
+		return;
+	}else if(id == STATS_ID && f->can_dlc >= STATS_BYTES)	// send_game_stats
+	{
+		on_stats(n, f->data, now);
+	}else if(id == RESULT_ID && f->can_dlc >= 1 && f->data[0] >= 1 && f->data[0] <= RESULTS)	// Secured or not, the result is byte 0
+	{
+		on_result(n, f->data[0], now);
+	}else if(id == SLEEP_ID)
+	{
+		n->sleeps++;
+		n->last_result = 0;
+	}
+}
+
+
+/**
+  * @brief  Maps a baud rate to its termios speed
+  * @param  baud baud rate
+  * @retval Speed, B0 if not supported
+  */
+
+static speed_t baud_speed(long baud)
+{
+	switch(baud)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 921600:	return B921600;
+		default:		return B0;
+	}
+}
+
+
+/**
+  * @brief  Opens a source, non-blocking. Failures are retried after RETRY_S
+  * @param  src pointer to the source
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void source_open(Source_t *src, double now)
+{
+	src->retry = now + RETRY_S;
+	src->len = 0;
+	src->overflow = 0;
+
+	if(src->kind == SRC_SERIAL)
+	{
+		struct termios tio;
+
+		src->fd = open(src->path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+
+		if(src->fd >= 0 && tcgetattr(src->fd, &tio) == 0)		// A terminal (not a pipe or file): raw, at the board's rate
+		{
+			cfmakeraw(&tio);
+			cfsetispeed(&tio, baud_speed(baud));
+			cfsetospeed(&tio, baud_speed(baud));
+			tcsetattr(src->fd, TCSANOW, &tio);
+		}
+	}else
+	{
+		struct sockaddr_can addr = {0};
+		can_err_mask_t err_mask = CAN_ERR_MASK;
+		int on = 1;
+
+		addr.can_family = AF_CAN;
+		addr.can_ifindex = (strcmp(src->path, "any") == 0) ? 0 : (int)if_nametoindex(src->path);
+		src->fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+
+		if(src->fd >= 0 && ((addr.can_ifindex == 0 && strcmp(src->path, "any") != 0) \
+			|| setsockopt(src->fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) != 0 \
+			|| setsockopt(src->fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) != 0 \
+			|| bind(src->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0))
+		{
+			close(src->fd);
+			src->fd = -1;
+		}
+	}
+
+	if(src->fd >= 0)
+	{
+		src->opens++;
+		fprintf(stderr, "%s: open\n", src->path);
+	}
+}
+
+
+/**
+  * @brief  Closes a source that went away (board unplugged, pty closed, interface down)
+  * @param  src pointer to the source
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void source_close(Source_t *src, double now)
+{
+	fprintf(stderr, "%s: %s, retrying\n", src->path, (errno != 0) ? strerror(errno) : "closed");
+	close(src->fd);
+	src->fd = -1;
+	src->retry = now + RETRY_S;
+}
+
+
+/**
+  * @brief  Reads what a serial source has, without blocking, and acts on complete lines
+  * @param  src pointer to the source
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void read_serial(Source_t *src, double now)
+{
+	char buf[4096];
+	ssize_t got;
+
+	for(int r = 0; r < READS_PER_POLL; r++)
+	{
+		got = read(src->fd, buf, sizeof(buf));
+
+		if(got <= 0)
+		{
+			if(got == 0 || (errno != EAGAIN && errno != EINTR))
+			{
+				errno = (got == 0) ? 0 : errno;
+				source_close(src, now);
+			}
+
+			return;
+		}
+
+		for(ssize_t i = 0; i < got; i++)
+		{
+			if(buf[i] == '\n')
+			{
+				Node_t *n = node_get(src->name, now);
+
+				src->len -= (src->len > 0 && src->line[src->len - 1] == '\r');
+				src->line[src->len] = '\0';
+
+				if(src->overflow)
+				{
+					n->lines++;
+					n->garbled++;
+				}else
+				{
+					ingest_line(n, src->line, now);
+				}
+
+				src->len = 0;
+				src->overflow = 0;
+			}else if(src->len < LINE_LEN - 1)
+			{
+				src->line[src->len++] = buf[i];
+			}else
+			{
+				src->overflow = 1;
+			}
+		}
+	}
+}
+
+
+/**
+  * @brief  Reads the frames a CAN socket has, without blocking
+  * @param  src pointer to the source
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void read_can(Source_t *src, double now)
+{
+	struct can_frame f;
+	struct sockaddr_can addr;
+	char ctrl[CMSG_SPACE(sizeof(uint32_t))];
+	struct iovec iov = {&f, sizeof(f)};
+	struct msghdr msg = {0};
+	struct cmsghdr *c;
+
+	for(int r = 0; r < READS_PER_POLL * 16; r++)
+	{
+		const char *name = src->name;
+
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+
+		if(recvmsg(src->fd, &msg, 0) < (ssize_t)sizeof(f))
+		{
+			if(errno != EAGAIN && errno != EINTR)
+			{
+				source_close(src, now);
+			}
+
+			return;
+		}
+
+		for(c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+		{
+			if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+			{
+				uint32_t dropped;
+
+				memcpy(&dropped, CMSG_DATA(c), sizeof(dropped));
+				src->dropped = dropped;
+			}
+		}
+
+		if(name[0] == '\0')					// can:any: node of the interface
+		{
+			int i;
+
+			for(i = 0; i < IF_CACHE && src->if_index[i] != addr.can_ifindex; i++);
+
+			if(i == IF_CACHE)
+			{
+				i = src->if_next;
+				src->if_next = (src->if_next + 1) % IF_CACHE;
+				src->if_index[i] = addr.can_ifindex;
+
+				if(if_indextoname(addr.can_ifindex, src->if_name[i]) == NULL)
+				{
+					snprintf(src->if_name[i], IFNAMSIZ, "if%d", addr.can_ifindex);
+				}
+			}
+
+			name = src->if_name[i];
+		}
+
+		ingest_frame(node_get(name, now), &f, now);
+	}
+}
+
+
+/**
+  * @brief  Appends formatted text to a buffer, up to its size
+  * @param  b pointer to the buffer
+  * @param  fmt printf format
+  * @retval None
+  */
+
+static void put(Buf_t *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if(b->truncated)
+	{
+		return;
+	}
+
+	va_start(ap, fmt);
+	n = vsnprintf(b->p + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+
+	if(n < 0 || (size_t)n >= b->size - b->len)
+	{
+		b->truncated = 1;
+		b->p[b->len] = '\0';
+		return;
+	}
+
+	b->len += n;
+}
+
+
+/**
+  * @brief  Appends the HELP and TYPE lines of a metric family
+  * @param  b pointer to the buffer
+  * @param  name metric name
+  * @param  type counter, gauge or histogram
+  * @param  help description
+  * @retval None
+  */
+
+static void family(Buf_t *b, const char *name, const char *type, const char *help)
+{
+	put(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+/**
+  * @brief  Appends a histogram of every node
+  * @param  b pointer to the buffer
+  * @param  name metric name
+  * @param  help description
+  * @param  offset offset of the histogram in Node_t
+  * @param  bounds upper bounds of its buckets
+  * @retval None
+  */
+
+static void histogram(Buf_t *b, const char *name, const char *help, size_t offset, const double bounds[HIST_BUCKETS])
+{
+	family(b, name, "histogram", help);
+
+	for(int i = 0; i < MAX_NODES; i++)
+	{
+		const Hist_t *h = (const Hist_t *)((const char *)&nodes[i] + offset);
+		uint64_t sum = 0;
+
+		if(!nodes[i].used)
+		{
+			continue;
+		}
+
+		for(int k = 0; k < HIST_BUCKETS; k++)
+		{
+			sum += h->bucket[k];
+			put(b, "%s_bucket{node=\"%s\",le=\"%g\"} %llu\n", name, nodes[i].name, bounds[k], (unsigned long long)sum);
+		}
+
+		put(b, "%s_bucket{node=\"%s\",le=\"+Inf\"} %llu\n", name, nodes[i].name, (unsigned long long)h->count);
+		put(b, "%s_sum{node=\"%s\"} %.6f\n", name, nodes[i].name, h->sum);
+		put(b, "%s_count{node=\"%s\"} %llu\n", name, nodes[i].name, (unsigned long long)h->count);
+	}
+}
+
+
+/**
+  * @brief  Writes the exposition text of all nodes and sources
+  * @param  b pointer to the buffer
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void render(Buf_t *b, double now)
+{
+	Node_t *n;
+	uint32_t used = 0;
+
+	family(b, "rps_node_up", "gauge", "1 if the node was heard from in the last 30 s");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		if(n->used)
+		{
+			used++;
+			put(b, "rps_node_up{node=\"%s\"} %d\n", n->name, now - n->last_seen < STALE_S);
+		}
+	}
+
+	family(b, "rps_node_healthy", "gauge", "1 if the node is up, reported no error in the last 60 s and has all its CAN buses up");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		if(n->used)
+		{
+			uint8_t healthy = (now - n->last_seen < STALE_S) && (n->last_error == 0 || now - n->last_error >= ERROR_RECENT_S);
+
+			for(int k = 0; k < BUSES; k++)
+			{
+				healthy &= !n->bus_seen[k] || n->bus_up[k];
+			}
+
+			put(b, "rps_node_healthy{node=\"%s\"} %d\n", n->name, healthy);
+		}
+	}
+
+	family(b, "rps_node_last_seen_timestamp_seconds", "gauge", "Unix time of the last line or frame of the node");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		if(n->used)
+		{
+			put(b, "rps_node_last_seen_timestamp_seconds{node=\"%s\"} %lld\n", n->name, (long long)n->seen_wall);
+		}
+	}
+
+	family(b, "rps_rounds_total", "counter", "Game results seen in the UART text or on the bus");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int r = 0; n->used && r < RESULTS; r++)
+		{
+			put(b, "rps_rounds_total{node=\"%s\",result=\"%s\"} %llu\n", n->name, result_labels[r], \
+				(unsigned long long)n->results[r]);
+		}
+	}
+
+	family(b, "rps_board_results_total", "counter", "Game results counted by Nucleo (send_game_stats bytes 0 to 3, unwrapped)");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int r = 0; n->used && n->board_seen && r < RESULTS; r++)
+		{
+			put(b, "rps_board_results_total{node=\"%s\",result=\"%s\"} %llu\n", n->name, stats_labels[r], \
+				(unsigned long long)n->board[r]);
+		}
+	}
+
+	for(size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++)
+	{
+		family(b, counters[c].name, "counter", counters[c].help);
+
+		for(n = nodes; n < &nodes[MAX_NODES]; n++)
+		{
+			if(n->used)
+			{
+				put(b, "%s{node=\"%s\"} %llu\n", counters[c].name, n->name, \
+					(unsigned long long)*(const uint64_t *)((const char *)n + counters[c].offset));
+			}
+		}
+	}
+
+	family(b, "rps_can_error_frames_total", "counter", "SocketCAN error frames, by error class");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int k = 0; n->used && n->frames > 0 && k < ERR_CLASSES; k++)
+		{
+			put(b, "rps_can_error_frames_total{node=\"%s\",class=\"%s\"} %llu\n", n->name, err_labels[k], \
+				(unsigned long long)n->error_frames[k]);
+		}
+	}
+
+	family(b, "rps_bus_up", "gauge", "1 if the board's last bus report had the bus up");
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int k = 0; n->used && k < BUSES; k++)
+		{
+			if(n->bus_seen[k])
+			{
+				put(b, "rps_bus_up{node=\"%s\",bus=\"CAN%d\"} %d\n", n->name, k + 1, n->bus_up[k]);
+			}
+		}
+	}
+
+	family(b, "rps_bus_busoff_events_total", "counter", "Bus-off events of the board's last bus report");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int k = 0; n->used && k < BUSES; k++)
+		{
+			if(n->bus_seen[k])
+			{
+				put(b, "rps_bus_busoff_events_total{node=\"%s\",bus=\"CAN%d\"} %llu\n", n->name, k + 1, \
+					(unsigned long long)n->bus_busoff[k]);
+			}
+		}
+	}
+
+	family(b, "rps_bus_tx_errors_total", "counter", "Tx errors of the board's last bus report");
+
+	for(n = nodes; n < &nodes[MAX_NODES]; n++)
+	{
+		for(int k = 0; n->used && k < BUSES; k++)
+		{
+			if(n->bus_seen[k])
+			{
+				put(b, "rps_bus_tx_errors_total{node=\"%s\",bus=\"CAN%d\"} %llu\n", n->name, k + 1, \
+					(unsigned long long)n->bus_txerr[k]);
+			}
+		}
+	}
+
+	histogram(b, "rps_round_interval_seconds", "Time between game results, as received", offsetof(Node_t, interval), \
+			  interval_bounds);
+	histogram(b, "rps_stats_reply_seconds", "Time from the stats request to the stats, as received", offsetof(Node_t, reply), \
+			  reply_bounds);
+
+	family(b, "rps_exporter_source_up", "gauge", "1 while the source is open");
+
+	for(uint32_t s = 0; s < source_count; s++)
+	{
+		put(b, "rps_exporter_source_up{source=\"%s\"} %d\n", sources[s].path, sources[s].fd >= 0);
+	}
+
+	family(b, "rps_exporter_source_opens_total", "counter", "Times the source was opened");
+
+	for(uint32_t s = 0; s < source_count; s++)
+	{
+		put(b, "rps_exporter_source_opens_total{source=\"%s\"} %llu\n", sources[s].path, (unsigned long long)sources[s].opens);
+	}
+
+	family(b, "rps_exporter_dropped_frames_total", "counter", "Frames the CAN socket dropped because the exporter fell behind");
+
+	for(uint32_t s = 0; s < source_count; s++)
+	{
+		if(sources[s].kind == SRC_CAN)
+		{
+			put(b, "rps_exporter_dropped_frames_total{source=\"%s\"} %llu\n", sources[s].path, \
+				(unsigned long long)sources[s].dropped);
+		}
+	}
+
+	family(b, "rps_exporter_nodes", "gauge", "Nodes kept");
+	put(b, "rps_exporter_nodes %u\n", used);
+	family(b, "rps_exporter_nodes_max", "gauge", "Nodes that can be kept");
+	put(b, "rps_exporter_nodes_max %d\n", MAX_NODES);
+	family(b, "rps_exporter_nodes_evicted_total", "counter", "Nodes dropped to make room for a new one");
+	put(b, "rps_exporter_nodes_evicted_total %llu\n", (unsigned long long)nodes_evicted);
+	family(b, "rps_exporter_scrapes_total", "counter", "Scrapes served");
+	put(b, "rps_exporter_scrapes_total %llu\n", (unsigned long long)scrapes);
+	family(b, "rps_exporter_refused_total", "counter", "Connections closed because MAX_CLIENTS scrapes were under way");
+	put(b, "rps_exporter_refused_total %llu\n", (unsigned long long)refused);
+	family(b, "rps_exporter_truncated_total", "counter", "Scrapes cut short by the size of the exposition buffer");
+	put(b, "rps_exporter_truncated_total %llu\n", (unsigned long long)truncated);
+}
+
+
+/**
+  * @brief  Builds the response of a complete request: /metrics, or 404
+  * @param  c pointer to the client
+  * @param  buf its response buffer (EXPO_SIZE + HEADER_LEN bytes)
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void respond(Client_t *c, char *buf, double now)
+{
+	Buf_t body = {buf + HEADER_LEN, 0, EXPO_SIZE, 0};
+	char head[HEADER_LEN];
+	int h;
+
+	if(strncmp(c->req, "GET /metrics ", 13) == 0 || strncmp(c->req, "GET /metrics?", 13) == 0)
+	{
+		scrapes++;
+		render(&body, now);
+		truncated += body.truncated;
+		h = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+					 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.len);
+	}else
+	{
+		put(&body, "Rock paper scissors exporter: see /metrics\n");
+		h = snprintf(head, sizeof(head), "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+					 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.len);
+	}
+
+	c->out = buf + HEADER_LEN - h;
+	memcpy(c->out, head, h);
+	c->out_len = h + body.len;
+	c->sent = 0;
+}
+
+
+/**
+  * @brief  Closes a client
+  * @param  c pointer to the client
+  * @retval None
+  */
+
+static void client_close(Client_t *c)
+{
+	close(c->fd);
+	c->fd = -1;
+}
+
+
+/**
+  * @brief  Moves a client on without blocking: reads its request, then sends the response
+  * @param  c pointer to the client
+  * @param  buf its response buffer
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void serve_client(Client_t *c, char *buf, double now)
+{
+	ssize_t n;
+
+	if(c->out == NULL)
+	{
+		n = recv(c->fd, c->req + c->req_len, REQUEST_LEN - 1 - c->req_len, 0);
+
+		if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+		{
+			client_close(c);
+			return;
+		}
+
+		c->req_len += (n > 0) ? n : 0;
+		c->req[c->req_len] = '\0';
+
+		if(strstr(c->req, "\r\n\r\n") == NULL && strstr(c->req, "\n\n") == NULL)
+		{
+			if(c->req_len == REQUEST_LEN - 1)		// Request head too long
+			{
+				client_close(c);
+			}
+
+			return;
+		}
+
+		respond(c, buf, now);
+	}
+
+	n = send(c->fd, c->out + c->sent, c->out_len - c->sent, MSG_NOSIGNAL);
+
+	if(n < 0 && errno != EAGAIN && errno != EINTR)
+	{
+		client_close(c);
+		return;
+	}
+
+	c->sent += (n > 0) ? n : 0;
+
+	if(c->sent == c->out_len)
+	{
+		client_close(c);
+	}
+}
+
+
+/**
+  * @brief  Accepts the pending connections
+  * @param  now monotonic time
+  * @retval None
+  */
+
+static void accept_clients(double now)
+{
+	int fd;
+
+	while((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+	{
+		int i;
+
+		for(i = 0; i < MAX_CLIENTS && clients[i].fd >= 0; i++);
+
+		if(i == MAX_CLIENTS)
+		{
+			refused++;
+			close(fd);
+			continue;
+		}
+
+		clients[i].fd = fd;
+		clients[i].since = now;
+		clients[i].req_len = 0;
+		clients[i].out = NULL;
+	}
+}
+
+
+/**
+  * @brief  Opens the HTTP listener on 127.0.0.1
+  * @param  port TCP port, 0 for any
+  * @retval Port listened on, -1 on error
+  */
+
+static int listen_on(int port)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t len = sizeof(addr);
+	int on = 1;
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	if(listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 \
+		|| bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0 \
+		|| getsockname(listener, (struct sockaddr *)&addr, &len) != 0)
+	{
+		perror("listen");
+		return -1;
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		clients[i].fd = -1;
+	}
+
+	return ntohs(addr.sin_port);
+}
+
+
+/**
+  * @brief  Runs one pass of the main loop: waits up to timeout for sources and clients,
+  * 		then serves what is ready. Sources that went away are reopened
+  * @param  timeout_ms longest wait in ms
+  * @retval None
+  */
+
+static void loop_once(int timeout_ms)
+{
+	struct pollfd pfd[1 + MAX_SOURCES + MAX_CLIENTS];
+	int who[1 + MAX_SOURCES + MAX_CLIENTS];			// Source index, MAX_SOURCES + client index, or -1 for the listener
+	int count = 0;
+	double now = now_s();
+
+	for(uint32_t s = 0; s < source_count; s++)
+	{
+		if(sources[s].fd < 0 && now >= sources[s].retry)
+		{
+			source_open(&sources[s], now);
+		}
+
+		if(sources[s].fd >= 0)
+		{
+			pfd[count] = (struct pollfd){sources[s].fd, POLLIN, 0};
+			who[count++] = s;
+		}
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(clients[i].fd >= 0 && now - clients[i].since > CLIENT_TIMEOUT_S)
+		{
+			client_close(&clients[i]);
+		}
+
+		if(clients[i].fd >= 0)
+		{
+			pfd[count] = (struct pollfd){clients[i].fd, (clients[i].out == NULL) ? POLLIN : POLLOUT, 0};
+			who[count++] = MAX_SOURCES + i;
+		}
+	}
+
+	pfd[count] = (struct pollfd){listener, POLLIN, 0};
+	who[count++] = -1;
+
+	if(poll(pfd, count, timeout_ms) <= 0)
+	{
+		return;
+	}
+
+	now = now_s();
+
+	for(int i = 0; i < count; i++)
+	{
+		if(pfd[i].revents == 0)
+		{
+			continue;
+		}
+
+		if(who[i] < 0)
+		{
+			accept_clients(now);
+		}else if(who[i] >= MAX_SOURCES)
+		{
+			serve_client(&clients[who[i] - MAX_SOURCES], client_buf[who[i] - MAX_SOURCES], now);
+		}else if(sources[who[i]].kind == SRC_SERIAL)
+		{
+			read_serial(&sources[who[i]], now);
+		}else
+		{
+			read_can(&sources[who[i]], now);
+		}
+	}
+}
+
+
+/**
+  * @brief  Adds a source from the command line: [name=]device, can:interface or can:any
+  * @param  spec source
+  * @retval 0 on success
+  */
+
+static int add_source(const char *spec)
+{
+	Source_t *src = &sources[source_count];
+	const char *eq = strchr(spec, '=');
+	const char *path = (eq != NULL) ? eq + 1 : spec;
+
+	if(source_count == MAX_SOURCES)
+	{
+		fprintf(stderr, "At most %d sources\n", MAX_SOURCES);
+		return 1;
+	}
+
+	memset(src, 0, sizeof(*src));
+	src->fd = -1;
+	src->kind = (strncmp(path, "can:", 4) == 0) ? SRC_CAN : SRC_SERIAL;
+	path += (src->kind == SRC_CAN) ? 4 : 0;
+	snprintf(src->path, PATH_LEN, "%s", path);
+
+	if(eq != NULL)
+	{
+		snprintf(src->name, NAME_LEN, "%.*s", (int)(eq - spec), spec);
+	}else if(src->kind == SRC_SERIAL || strcmp(path, "any") != 0)
+	{
+		snprintf(src->name, NAME_LEN, "%s", (strrchr(path, '/') != NULL) ? strrchr(path, '/') + 1 : path);
+	}
+
+	for(size_t i = 0; src->name[i] != '\0'; i++)		// Keep label values plain
+	{
+		src->name[i] = (src->name[i] == '"' || src->name[i] == '\\') ? '_' : src->name[i];
+	}
+
+	source_count++;
+
+	return 0;
+}
+
+
+/**
+  * @brief  Checks that a scrape holds a sample with the given value
+  * @param  text scrape
+  * @param  sample metric name with its labels
+  * @param  value expected value
+  * @retval 1 if it does not
+  */
+
+static int expect(const char *text, const char *sample, unsigned long long value)
+{
+	char line[160];
+
+	snprintf(line, sizeof(line), "\n%s %llu\n", sample, value);
+
+	if(strstr(text, line) == NULL)
+	{
+		const char *p = strstr(text, sample);
+		fprintf(stderr, "FAIL: %s is not %llu (%.*s)\n", sample, value, (p != NULL) ? (int)strcspn(p, "\n") : 7, \
+				(p != NULL) ? p : "missing");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+  * @brief  Checks the exporter: a synthetic Disc session through a pty (with lines split
+  * 		across writes, a garbled line and one too long), game frames through the frame
+  * 		decoder (no SocketCAN needed), a scrape over HTTP, then the node limit and the
+  * 		size of the exposition with every node in use
+  * @param  None
+  * @retval 0 on success
+  */
+
+static int check(void)
+{
+	static char session[CHECK_ROUNDS * 160 + 4096], scrape[EXPO_SIZE + HEADER_LEN];
+	static const char *hands[3] = {"Rock", "Paper", "Scissors"};
+	uint32_t results[RESULTS] = {0}, len = 0, sent = 0, got, seed = 7, stats_lines = 0;
+	struct sockaddr_in addr = {0};
+	struct can_frame f = {0};
+	Buf_t b = {scrape, 0, EXPO_SIZE, 0};
+	double t0;
+	char name[NAME_LEN], sample[128];
+	int port, master, fd, fail = 0;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || (port = listen_on(0)) < 0)
+	{
+		perror("pty");
+		return 1;
+	}
+
+	snprintf(sample, sizeof(sample), "disc=%s", ptsname(master));
+	add_source(sample);
+	source_open(&sources[0], now_s());
+	fcntl(master, F_SETFL, O_NONBLOCK);
+
+	len += sprintf(session + len, "Disc initialization successful\r\n");
+
+	for(uint32_t r = 0; r < CHECK_ROUNDS; r++)			// Disc's side of the game
+	{
+		uint8_t nucleo, disc, result;
+
+		seed = seed * 1103515245 + 12345;
+		nucleo = (seed >> 16) % 3;
+		disc = (seed >> 20) % 3;
+		result = (nucleo == disc) ? 3 : ((nucleo + 3 - disc) % 3 == 1) ? 1 : 2;
+		result = ((seed >> 24) % 50 == 0) ? 4 : result;
+		results[result - 1]++;
+
+		len += sprintf(session + len, "Message received. Nucleo's hand is %s\r\nDisc's hand is %s\r\n"
+					   "Sent message with game result: %s\r\n", hands[nucleo], hands[disc], result_names[result - 1]);
+
+		if(r % CHECK_STATS_EVERY == CHECK_STATS_EVERY - 1)
+		{
+			len += sprintf(session + len, "Sent Remote Frame to ask for game stats\r\n2026-10-18 09:%02u:%02u AM - "
+						   "STATS: Nucleo Wins: %u, Disc Wins: %u, Ties: %u, Game Error: %u, Lost Results: %u, "
+						   "Nucleo Rx Overruns: %u, Disc Rx Overruns: %u\r\nCAN1 up tx:%u rx:%u txerr:0 busoff:0 failover:0 "
+						   "dup:0 tec:0 rec:0\r\nCAN2 %s tx:0 rx:0 txerr:%u busoff:1 failover:0 dup:0 tec:0 rec:0\r\n", \
+						   r / 60 % 60, r % 60, results[0] & 255, results[1] & 255, results[2] & 255, results[3] & 255, \
+						   r / 100, 3, 5, r, r, (r == CHECK_ROUNDS - 1) ? "down" : "up", r / 10);
+			stats_lines++;
+		}
+
+		if(r == 100 || r == 300 || r == 500)			// Older firmware printed the overruns too
+		{
+			len += sprintf(session + len, "CAN Error Occurred\r\nCAN Rx FIFO overrun; frame lost\r\n");
+		}
+	}
+
+	len += sprintf(session + len, "send_game_result HAL_CAN_AddTxMessage Tx error\r\nLight lost; gone to sleep\r\n"
+				   "Disc's hand is \xFF\xFE\r\n%0300d\r\n", 0);
+
+	t0 = now_s();
+
+	while(now_s() - t0 < 5.0)							// Odd-sized writes split lines across reads
+	{
+		ssize_t n = write(master, session + sent, (len - sent < 97) ? len - sent : 97);
+
+		sent += (n > 0) ? n : 0;
+		loop_once(1);
+
+		if(sent == len && node_get("disc", now_s())->garbled == 2)		// The two garbled lines end the session
+		{
+			break;
+		}
+	}
+
+	for(uint32_t r = 0; r < 300; r++)					// Game frames of a second board pair, stats wrapping
+	{
+		Node_t *n = node_get("vcan0", now_s());
+
+		f = (struct can_frame){.can_id = RESULT_ID, .can_dlc = 5, .data = {r % 4 + 1}};
+		ingest_frame(n, &f, now_s());
+
+		if(r % 50 == 49)
+		{
+			f = (struct can_frame){.can_id = STATS_ID | CAN_RTR_FLAG, .can_dlc = 4};
+			ingest_frame(n, &f, now_s());
+			f = (struct can_frame){.can_id = STATS_ID, .can_dlc = 6, \
+								   .data = {(r / 4 + 1) & 255, (r / 4 + 1) & 255, (r / 4 + 1) & 255, (r / 4 + 1) & 255, 2, 0}};
+			ingest_frame(n, &f, now_s());
+		}
+	}
+
+	f = (struct can_frame){.can_id = CAN_ERR_FLAG | CAN_ERR_BUSOFF | CAN_ERR_CRTL, .can_dlc = CAN_ERR_DLC};
+	ingest_frame(node_get("vcan0", now_s()), &f, now_s());
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		perror("connect");
+		return 1;
+	}
+
+	send(fd, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", 42, 0);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	got = 0;
+	t0 = now_s();
+
+	for(ssize_t n = 1; n != 0 && now_s() - t0 < 5.0; )		// Until the exporter closes the connection
+	{
+		loop_once(1);
+		n = recv(fd, scrape + got, sizeof(scrape) - 1 - got, 0);
+		got += (n > 0) ? n : 0;
+		n = (n < 0 && errno == EAGAIN) ? 1 : n;
+	}
+
+	scrape[got] = '\0';
+	close(fd);
+	printf("session: %u bytes, %u rounds, scrape: %u bytes\n", len, CHECK_ROUNDS, got);
+
+	fail |= strncmp(scrape, "HTTP/1.1 200 OK", 15) != 0;
+
+	for(int r = 0; r < RESULTS; r++)
+	{
+		snprintf(sample, sizeof(sample), "rps_rounds_total{node=\"disc\",result=\"%s\"}", result_labels[r]);
+		fail |= expect(scrape, sample, results[r]);
+		snprintf(sample, sizeof(sample), "rps_board_results_total{node=\"disc\",result=\"%s\"}", stats_labels[r]);
+		fail |= expect(scrape, sample, results[r]);		// Unwrapped from bytes
+		snprintf(sample, sizeof(sample), "rps_rounds_total{node=\"vcan0\",result=\"%s\"}", result_labels[r]);
+		fail |= expect(scrape, sample, 75);
+		snprintf(sample, sizeof(sample), "rps_board_results_total{node=\"vcan0\",result=\"%s\"}", stats_labels[r]);
+		fail |= expect(scrape, sample, 75);
+	}
+
+	fail |= expect(scrape, "rps_stats_reports_total{node=\"disc\"}", stats_lines);
+	fail |= expect(scrape, "rps_stats_requests_total{node=\"disc\"}", stats_lines);
+	fail |= expect(scrape, "rps_stats_reply_seconds_count{node=\"disc\"}", stats_lines);
+	fail |= expect(scrape, "rps_round_interval_seconds_count{node=\"disc\"}", CHECK_ROUNDS - 1);
+	fail |= expect(scrape, "rps_board_lost_results_total{node=\"disc\"}", (CHECK_ROUNDS - 1) / 100);
+	fail |= expect(scrape, "rps_board_nucleo_rx_overruns_total{node=\"disc\"}", 3);
+	fail |= expect(scrape, "rps_board_disc_rx_overruns_total{node=\"disc\"}", 5);
+	fail |= expect(scrape, "rps_can_errors_total{node=\"disc\"}", 3);
+	fail |= expect(scrape, "rps_rx_overrun_events_total{node=\"disc\"}", 3);
+	fail |= expect(scrape, "rps_tx_errors_total{node=\"disc\"}", 1);
+	fail |= expect(scrape, "rps_restarts_total{node=\"disc\"}", 1);
+	fail |= expect(scrape, "rps_sleeps_total{node=\"disc\"}", 1);
+	fail |= expect(scrape, "rps_garbled_lines_total{node=\"disc\"}", 2);
+	fail |= expect(scrape, "rps_bus_up{node=\"disc\",bus=\"CAN1\"}", 1);
+	fail |= expect(scrape, "rps_bus_up{node=\"disc\",bus=\"CAN2\"}", 0);
+	fail |= expect(scrape, "rps_bus_tx_errors_total{node=\"disc\",bus=\"CAN2\"}", (CHECK_ROUNDS - 1) / 10);
+	fail |= expect(scrape, "rps_node_healthy{node=\"disc\"}", 0);
+	fail |= expect(scrape, "rps_node_up{node=\"disc\"}", 1);
+	fail |= expect(scrape, "rps_stats_reports_total{node=\"vcan0\"}", 6);
+	fail |= expect(scrape, "rps_board_lost_results_total{node=\"vcan0\"}", 2);
+	fail |= expect(scrape, "rps_can_error_frames_total{node=\"vcan0\",class=\"busoff\"}", 1);
+	fail |= expect(scrape, "rps_can_error_frames_total{node=\"vcan0\",class=\"controller\"}", 1);
+	fail |= expect(scrape, "rps_can_error_frames_total{node=\"vcan0\",class=\"no_ack\"}", 0);
+	fail |= expect(scrape, "rps_exporter_scrapes_total", 1);
+
+	for(int i = 0; i < 3 * MAX_NODES; i++)				// Far more nodes than kept, each with every metric
+	{
+		Node_t *n;
+
+		snprintf(name, sizeof(name), "node-with-a-long-name-%04d", i);
+		n = node_get(name, now_s());
+		n->frames = n->board_seen = n->bus_seen[0] = n->bus_seen[1] = 1;
+		n->results[0] = n->board[0] = n->interval.count = n->reply.count = UINT64_MAX;
+		n->interval.sum = n->reply.sum = 1e12;
+	}
+
+	render(&b, now_s());
+	printf("%d nodes: %zu of %d bytes of exposition\n", MAX_NODES, b.len, EXPO_SIZE);
+	fail |= b.truncated;
+	fail |= expect(scrape, "rps_exporter_nodes", MAX_NODES);
+	fail |= expect(scrape, "rps_exporter_nodes_evicted_total", 3 * MAX_NODES - (MAX_NODES - 2));
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int port = DEFAULT_PORT, opt;
+
+	if(argc >= 2 && strcmp(argv[1], "check") == 0)
+	{
+		return check();
+	}
+
+	while((opt = getopt(argc, argv, "p:b:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'p': port = atoi(optarg); break;
+			case 'b': baud = atol(optarg); break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+
+	if(optind >= argc || baud_speed(baud) == B0)
+	{
+		fprintf(stderr, "Usage: %s [-p port] [-b baud] [name=]/dev/ttyACM0... [can:vcan0|can:any]...\n"
+						"       %s check\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	for(int i = optind; i < argc; i++)
+	{
+		if(add_source(argv[i]) != 0)
+		{
+			return 1;
+		}
+	}
+
+	if((port = listen_on(port)) < 0)
+	{
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	fprintf(stderr, "Serving http://127.0.0.1:%d/metrics\n", port);
+
+	while(!stop)
+	{
+		loop_once(250);
+	}
+
+	return 0;
+}
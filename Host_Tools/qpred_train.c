@@ -0,0 +1,387 @@
+/**
+  ******************************************************************************
+  * @file    qpred_train.c
+  * @author  Moe2Code
+  * @brief   Offline trainer of the int8 hand predictor (qpred.c). Fits a softmax regression
+  *          of the opponent's next hand on the qpred features, quantizes the weights to int8
+  *          and writes them as a C flash table (qpred_table.c) for both boards.
+  *          Training rounds come from Disc UART captures (Tera Term logs holding the lines
+  *          "Nucleo's hand is X" and "Disc's hand is Y"; Nucleo is the opponent) and/or from
+  *          sessions generated against the built-in strategies (strategy.c).
+  *          Usage: ./qpred_train [-g rounds_per_strategy] [-e epochs] [-o qpred_table.c] [capture.log ...]
+  * @note    Features and scores are computed with the firmware code (scalar path), so the
+  *          accuracy printed for the quantized table is what the boards get
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "qpred.h"
+#include "strategy.h"
+
+
+// Defines
+#define SESSION_ROUNDS		2000		// Generated rounds per session (fresh players)
+
+
+// Typedefs
+typedef struct
+{
+	float x[QPRED_FEATURES];
+	uint8_t label;				// Opponent's hand
+} Sample_t;
+
+
+// Global variables
+// Flash table of the boards, only read by Qpred_Pick(). The trainer never plays the qpred strategy
+const int8_t qpred_weights[QPRED_OUTPUTS][QPRED_FEATURES] = {{0}};
+static Sample_t *samples;
+static size_t n_samples, cap_samples;
+static float weights[QPRED_OUTPUTS][QPRED_FEATURES];
+static Qpred_State_t feat_state;	// History of the session being converted to samples
+
+
+/**
+  * @brief  Appends the sample of the next round, then adds the round to the history
+  * @param  own hand of the player the predictor runs for
+  * @param  opp opponent's hand (the label)
+  * @retval None
+  */
+
+static void add_round(uint8_t own, uint8_t opp)
+{
+	uint32_t x[QPRED_WORDS];
+
+	if(n_samples == cap_samples)
+	{
+		cap_samples = cap_samples ? 2 * cap_samples : 65536;
+		samples = realloc(samples, cap_samples * sizeof(Sample_t));
+
+		if(samples == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+
+	Qpred_Features(&feat_state, x);
+
+	for(int i = 0; i < QPRED_FEATURES; i++)
+	{
+		samples[n_samples].x[i] = (float)(int8_t)(x[i / 4] >> (8 * (i % 4))) / QPRED_ONE;
+	}
+
+	samples[n_samples].label = opp;
+	n_samples++;
+
+	Qpred_Observe(&feat_state, own, opp);
+}
+
+
+/**
+  * @brief  Returns the hand named in a capture line after the given marker
+  * @param  line capture line
+  * @param  marker text right before the hand name
+  * @retval Hand 0 to 2, QPRED_NO_HAND if the line does not hold the marker
+  */
+
+static uint8_t parse_hand(const char *line, const char *marker)
+{
+	const char *names[3] = {"Rock", "Paper", "Scissors"};
+	const char *p = strstr(line, marker);
+
+	if(p == NULL)
+	{
+		return QPRED_NO_HAND;
+	}
+
+	p += strlen(marker);
+
+	for(uint8_t h = 0; h < 3; h++)
+	{
+		if(strncmp(p, names[h], strlen(names[h])) == 0)
+		{
+			return h;
+		}
+	}
+
+	return QPRED_NO_HAND;
+}
+
+
+/**
+  * @brief  Adds the rounds of a Disc UART capture. Each capture is one session
+  * @param  path capture file
+  * @retval Rounds added
+  */
+
+static size_t load_capture(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	uint8_t nucleo = QPRED_NO_HAND, h;
+	size_t rounds = 0;
+
+	if(f == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+
+	Qpred_Init(&feat_state);
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		if((h = parse_hand(line, "Nucleo's hand is ")) != QPRED_NO_HAND)
+		{
+			nucleo = h;
+		}else if((h = parse_hand(line, "Disc's hand is ")) != QPRED_NO_HAND && nucleo != QPRED_NO_HAND)
+		{
+			add_round(h, nucleo);
+			nucleo = QPRED_NO_HAND;
+			rounds++;
+		}
+	}
+
+	fclose(f);
+
+	return rounds;
+}
+
+
+/**
+  * @brief  Adds generated sessions: a random player (own hands) against each built-in strategy
+  *         except qpred itself
+  * @param  rounds_per_strategy rounds generated against each strategy
+  * @retval None
+  */
+
+static void generate(long rounds_per_strategy)
+{
+	Strategy_Player_t own, opp;
+	uint8_t ho, hp;
+	uint32_t seed = 1;
+
+	for(uint8_t id = 0; id < STRATEGY_COUNT; id++)
+	{
+		if(id == STRATEGY_QPRED)
+		{
+			continue;
+		}
+
+		for(long r = 0; r < rounds_per_strategy; r++)
+		{
+			if(r % SESSION_ROUNDS == 0)
+			{
+				Strategy_Init(&own, STRATEGY_RANDOM, seed++);
+				Strategy_Init(&opp, id, seed++);
+				Qpred_Init(&feat_state);
+			}
+
+			ho = Strategy_Pick(&own);
+			hp = Strategy_Pick(&opp);
+			add_round(ho, hp);
+			Strategy_Observe(&own, ho, hp);
+			Strategy_Observe(&opp, hp, ho);
+		}
+	}
+}
+
+
+/**
+  * @brief  Softmax regression by stochastic gradient descent with a decaying step
+  * @param  epochs passes over the samples
+  * @retval None
+  */
+
+static void train(int epochs)
+{
+	float z[QPRED_OUTPUTS], p[QPRED_OUTPUTS], max, sum, lr;
+	size_t *order = malloc(n_samples * sizeof(size_t));
+	uint32_t rng = 1;
+	size_t i, j, k;
+
+	if(order == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for(i = 0; i < n_samples; i++)
+	{
+		order[i] = i;
+	}
+
+	for(int e = 0; e < epochs; e++)
+	{
+		lr = 0.05f / (1.0f + e);
+
+		for(k = n_samples - 1; k > 0; k--)		// Fresh visiting order each epoch (Fisher-Yates)
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 17;
+			rng ^= rng << 5;
+			j = rng % (k + 1);
+			i = order[k];
+			order[k] = order[j];
+			order[j] = i;
+		}
+
+		for(size_t n = 0; n < n_samples; n++)
+		{
+			i = order[n];
+
+			max = -1e30f;
+			for(int o = 0; o < QPRED_OUTPUTS; o++)
+			{
+				z[o] = 0;
+				for(j = 0; j < QPRED_FEATURES; j++)
+				{
+					z[o] += weights[o][j] * samples[i].x[j];
+				}
+				max = (z[o] > max) ? z[o] : max;
+			}
+
+			sum = 0;
+			for(int o = 0; o < QPRED_OUTPUTS; o++)
+			{
+				p[o] = expf(z[o] - max);
+				sum += p[o];
+			}
+
+			for(int o = 0; o < QPRED_OUTPUTS; o++)
+			{
+				float g = p[o] / sum - (o == samples[i].label);
+
+				for(j = 0; j < QPRED_FEATURES; j++)
+				{
+					weights[o][j] -= lr * (g * samples[i].x[j] + 1e-4f * weights[o][j]);
+				}
+			}
+		}
+	}
+
+	free(order);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static int8_t q[QPRED_OUTPUTS][QPRED_FEATURES];
+	const char *out_path = "qpred_table.c";
+	long gen_rounds = 0;
+	int epochs = 8, opt;
+	float max = 0, scale;
+	size_t hits = 0;
+	FILE *out;
+
+	while((opt = getopt(argc, argv, "g:e:o:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'g': gen_rounds = strtol(optarg, NULL, 0); break;
+			case 'e': epochs = atoi(optarg); break;
+			case 'o': out_path = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-g rounds_per_strategy] [-e epochs] [-o qpred_table.c] [capture.log ...]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	for(int a = optind; a < argc; a++)
+	{
+		printf("%s: %zu rounds\n", argv[a], load_capture(argv[a]));
+	}
+
+	if(gen_rounds > 0)
+	{
+		generate(gen_rounds);
+	}
+
+	if(n_samples == 0)
+	{
+		fprintf(stderr, "No rounds: give capture files and/or -g\n");
+		return 1;
+	}
+
+	train(epochs);
+
+	for(int o = 0; o < QPRED_OUTPUTS; o++)
+	{
+		for(int j = 0; j < QPRED_FEATURES; j++)
+		{
+			max = (fabsf(weights[o][j]) > max) ? fabsf(weights[o][j]) : max;
+		}
+	}
+
+	scale = (max > 0) ? 127.0f / max : 1.0f;
+
+	for(int o = 0; o < QPRED_OUTPUTS; o++)
+	{
+		for(int j = 0; j < QPRED_FEATURES; j++)
+		{
+			q[o][j] = (int8_t)lrintf(weights[o][j] * scale);
+		}
+	}
+
+	// Accuracy of the quantized table, scored like the boards do
+	for(size_t n = 0; n < n_samples; n++)
+	{
+		uint32_t x[QPRED_WORDS] = {0};
+		int32_t s[QPRED_OUTPUTS];
+		uint8_t best;
+
+		for(int j = 0; j < QPRED_FEATURES; j++)
+		{
+			x[j / 4] |= (uint32_t)(uint8_t)(int8_t)lrintf(samples[n].x[j] * QPRED_ONE) << (8 * (j % 4));
+		}
+
+		Qpred_Scores(q, x, s);
+		best = (s[1] > s[0]) ? 1 : 0;
+		best = (s[2] > s[best]) ? 2 : best;
+		hits += (best == samples[n].label);
+	}
+
+	printf("%zu rounds, %d epochs, quantized prediction accuracy %.2f%%\n", n_samples, epochs, 100.0 * hits / n_samples);
+
+	out = fopen(out_path, "w");
+
+	if(out == NULL)
+	{
+		perror(out_path);
+		return 1;
+	}
+
+	fprintf(out, "/**\n");
+	fprintf(out, "  ******************************************************************************\n");
+	fprintf(out, "  * @file    qpred_table.c\n");
+	fprintf(out, "  * @author  Moe2Code\n");
+	fprintf(out, "  * @brief   int8 weights of the hand predictor (qpred.c), kept in flash.\n");
+	fprintf(out, "  *          Generated by Host_Tools/qpred_train from %zu rounds; do not edit.\n", n_samples);
+	fprintf(out, "  *          Quantized prediction accuracy on the training rounds: %.2f%%\n", 100.0 * hits / n_samples);
+	fprintf(out, "  */\n\n");
+	fprintf(out, "// Includes\n#include \"qpred.h\"\n\n\n");
+	fprintf(out, "// Global variables\n");
+	fprintf(out, "// Row o scores the opponent playing hand o next. Word aligned for 32-bit SIMD loads\n");
+	fprintf(out, "const int8_t qpred_weights[QPRED_OUTPUTS][QPRED_FEATURES] __attribute__((aligned(4))) =\n{\n");
+
+	for(int o = 0; o < QPRED_OUTPUTS; o++)
+	{
+		fprintf(out, "\t{");
+		for(int j = 0; j < QPRED_FEATURES; j++)
+		{
+			fprintf(out, "%s%4d", (j == 0) ? "" : ((j % 8) ? "," : ",\n\t "), q[o][j]);
+		}
+		fprintf(out, "},\n");
+	}
+
+	fprintf(out, "};\n");
+	fclose(out);
+
+	printf("Wrote %s\n", out_path);
+
+	return 0;
+}
@@ -0,0 +1,757 @@
+/**
+  ******************************************************************************
+  * @file    round_archive.c
+  * @author  Moe2Code
+  * @brief   Columnar archive of game rounds on the PC (.rpa files, layout in
+  *          round_archive.h). The following is conducted in source file:
+  *          + Encoding of rounds into chunks of 4 compressed columns: time (zigzag varint
+  *            deltas, 1 byte per round at the game pace), hands (4 bits), result (2 bits)
+  *            and node (runs)
+  *          + Appending of chunks and of a new footer index, without rewriting the file
+  *          + Memory-mapped reading: footer and columns are used in place, no copy
+  *          + Aggregate queries (result counts over a time range and a node) answered
+  *            from the footer counts where a chunk is wholly in or out of the query, and
+  *            by a scan of the packed columns (popcount, 32 rounds per 64-bit word) elsewhere
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "round_archive.h"
+
+
+// Defines
+#define ARC_PLAN_SKIP			0		// No round of the chunk matches
+#define ARC_PLAN_FOOTER			1		// Every round matches: the footer counts answer
+#define ARC_PLAN_RUNS			2		// Whole time span in range, some nodes: node runs and results
+#define ARC_PLAN_SCAN			3		// Time range cuts the chunk: times, node runs and results
+
+
+// Function prototypes
+static uint64_t Arc_AlignUp(uint64_t v);
+static uint32_t Arc_Crc32(const uint8_t *data, size_t len);
+static size_t Arc_EncodeChunk(const Arc_Row_t *rows, uint32_t n, uint8_t *buf, Arc_Chunk_t *entry);
+static int Arc_FindTrailer(const uint8_t *map, size_t size, Arc_Trailer_t *t);
+static void Arc_CountRange(const uint64_t *res, uint32_t a, uint32_t b, uint64_t counts[ARC_RESULTS]);
+static void Arc_CountWord(uint64_t word, uint64_t mask, uint64_t counts[ARC_RESULTS]);
+static uint64_t Arc_Spread(uint32_t bits);
+static uint8_t Arc_Plan(const Arc_Chunk_t *e, const Arc_Query_t *q);
+
+
+/**
+  * @brief  Appends rounds to an archive, creating it if needed. The rounds become new chunks,
+  * 		then a new footer (old entries + new ones) is written after them
+  * @param  path archive file
+  * @param  rows rounds to append, in any time order
+  * @param  n number of rounds
+  * @retval 0 on success, -1 on error (printed)
+  */
+
+int Arc_Append(const char *path, const Arc_Row_t *rows, uint64_t n)
+{
+	uint8_t header[ARC_HEADER_SIZE] = {0}, *buf = NULL;
+	Arc_Chunk_t *entries = NULL;
+	Arc_Trailer_t trailer;
+	Arc_Reader_t old = {0};
+	uint32_t count = 0, chunks = (n + ARC_CHUNK_ROWS - 1) / ARC_CHUNK_ROWS;
+	uint64_t pos;
+	struct stat st;
+	int fd = open(path, O_RDWR | O_CREAT, 0644), ret = -1;
+
+	if(fd < 0 || fstat(fd, &st) != 0)
+	{
+		perror(path);
+		goto done;
+	}
+
+	if(st.st_size == 0)
+	{
+		memcpy(header, ARC_MAGIC, 8);
+
+		if(pwrite(fd, header, ARC_HEADER_SIZE, 0) != ARC_HEADER_SIZE)
+		{
+			perror(path);
+			goto done;
+		}
+
+		pos = ARC_HEADER_SIZE;
+	}else
+	{
+		if(Arc_Open(path, &old) != 0)
+		{
+			goto done;
+		}
+
+		count = old.chunks;
+		pos = Arc_AlignUp(old.size);
+	}
+
+	entries = malloc((count + chunks) * sizeof(Arc_Chunk_t));
+	buf = malloc(8 + 10 * (size_t)ARC_CHUNK_ROWS + 8 * (size_t)ARC_CHUNK_ROWS + ARC_CHUNK_ROWS + 4 * ARC_ALIGN);
+
+	if(entries == NULL || buf == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		goto done;
+	}
+
+	if(count > 0)
+	{
+		memcpy(entries, old.chunk, count * sizeof(Arc_Chunk_t));
+	}
+
+	Arc_Close(&old);
+
+	for(uint64_t first = 0; first < n; first += ARC_CHUNK_ROWS)
+	{
+		uint32_t rows_in = (n - first > ARC_CHUNK_ROWS) ? ARC_CHUNK_ROWS : n - first;
+		size_t size = Arc_EncodeChunk(&rows[first], rows_in, buf, &entries[count]);
+
+		entries[count].offset = pos;
+
+		if(pwrite(fd, buf, size, pos) != (ssize_t)size)
+		{
+			perror(path);
+			goto done;
+		}
+
+		pos = Arc_AlignUp(pos + size);
+		count++;
+	}
+
+	fdatasync(fd);		// Chunks first: the new trailer must never point to missing data
+
+	trailer.footer = pos;
+	trailer.chunks = count;
+	trailer.crc = Arc_Crc32((const uint8_t *)entries, count * sizeof(Arc_Chunk_t));
+	memcpy(trailer.magic, ARC_TRAILER_MAGIC, 8);
+
+	if(pwrite(fd, entries, count * sizeof(Arc_Chunk_t), pos) != (ssize_t)(count * sizeof(Arc_Chunk_t)) || \
+	   pwrite(fd, &trailer, sizeof(trailer), pos + count * sizeof(Arc_Chunk_t)) != sizeof(trailer))
+	{
+		perror(path);
+		goto done;
+	}
+
+	fdatasync(fd);
+	ret = 0;
+
+done:
+	if(fd >= 0)
+	{
+		close(fd);
+	}
+
+	free(entries);
+	free(buf);
+
+	return ret;
+}
+
+
+/**
+  * @brief  Maps an archive and finds its footer
+  * @param  path archive file
+  * @param  r receives the reader state
+  * @retval 0 on success, -1 on error (printed)
+  */
+
+int Arc_Open(const char *path, Arc_Reader_t *r)
+{
+	Arc_Trailer_t t;
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	memset(r, 0, sizeof(Arc_Reader_t));
+
+	if(fd < 0 || fstat(fd, &st) != 0)
+	{
+		perror(path);
+		return -1;
+	}
+
+	r->size = st.st_size;
+	r->map = (r->size > 0) ? mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	if(r->map == MAP_FAILED || r->size < ARC_HEADER_SIZE || memcmp(r->map, ARC_MAGIC, 8) != 0)
+	{
+		fprintf(stderr, "%s: not a round archive\n", path);
+		r->map = (r->map == MAP_FAILED) ? NULL : r->map;
+		Arc_Close(r);
+		return -1;
+	}
+
+	if(r->size == ARC_HEADER_SIZE)		// Created, nothing appended yet
+	{
+		return 0;
+	}
+
+	if(Arc_FindTrailer(r->map, r->size, &t) != 0)
+	{
+		fprintf(stderr, "%s: no valid footer\n", path);
+		Arc_Close(r);
+		return -1;
+	}
+
+	r->chunk = (const Arc_Chunk_t *)(r->map + t.footer);
+	r->chunks = t.chunks;
+
+	for(uint32_t c = 0; c < r->chunks; c++)
+	{
+		r->rows += r->chunk[c].rows;
+	}
+
+	madvise((void *)r->map, r->size, MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+
+/**
+  * @brief  Unmaps an archive
+  * @param  r pointer to the reader state
+  * @retval None
+  */
+
+void Arc_Close(Arc_Reader_t *r)
+{
+	if(r->map != NULL)
+	{
+		munmap((void *)r->map, r->size);
+	}
+
+	memset(r, 0, sizeof(Arc_Reader_t));
+}
+
+
+/**
+  * @brief  Returns a column of a chunk, in place in the map
+  * @param  r pointer to the reader state
+  * @param  c chunk index
+  * @param  col ARC_COL_xxx
+  * @retval Start of the column (64-byte aligned)
+  */
+
+const uint8_t *Arc_Column(const Arc_Reader_t *r, uint32_t c, uint8_t col)
+{
+	uint64_t offset = r->chunk[c].offset;
+
+	for(uint8_t k = 0; k < col; k++)
+	{
+		offset = Arc_AlignUp(offset + r->chunk[c].size[k]);
+	}
+
+	return r->map + offset;
+}
+
+
+/**
+  * @brief  Decodes every round of a chunk
+  * @param  r pointer to the reader state
+  * @param  c chunk index
+  * @param  rows receives the rounds (r->chunk[c].rows of them)
+  * @retval Rounds decoded
+  */
+
+uint32_t Arc_ReadChunk(const Arc_Reader_t *r, uint32_t c, Arc_Row_t *rows)
+{
+	const Arc_Chunk_t *e = &r->chunk[c];
+	const uint8_t *p = Arc_Column(r, c, ARC_COL_TIME), *hands = Arc_Column(r, c, ARC_COL_HANDS);
+	const uint64_t *res = (const uint64_t *)Arc_Column(r, c, ARC_COL_RESULT);
+	const uint32_t *runs = (const uint32_t *)Arc_Column(r, c, ARC_COL_NODE);
+	uint64_t z;
+	int64_t t = 0;
+	uint32_t run_end = runs[1], i;
+	uint8_t shift;
+
+	memcpy(&t, p, 8);
+	p += 8;
+
+	for(i = 0; i < e->rows; i++)
+	{
+		if(i > 0)
+		{
+			for(z = 0, shift = 0; *p & 0x80; shift += 7)
+			{
+				z |= (uint64_t)(*p++ & 0x7F) << shift;
+			}
+
+			z |= (uint64_t)*p++ << shift;
+			t += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+		}
+
+		while(i >= run_end)
+		{
+			runs += 2;
+			run_end += runs[1];
+		}
+
+		rows[i].time = t;
+		rows[i].node = runs[0];
+		rows[i].hands = (hands[i / 2] >> (4 * (i % 2))) & 0xF;
+		rows[i].result = 1 + ((res[i / 32] >> (2 * (i % 32))) & 3);
+	}
+
+	return i;
+}
+
+
+/**
+  * @brief  Adds the result counts of the rounds of a chunk that match a query
+  * @param  r pointer to the reader state
+  * @param  c chunk index
+  * @param  q query
+  * @param  counts counts to add to (index: result - 1)
+  * @retval None
+  */
+
+void Arc_CountChunk(const Arc_Reader_t *r, uint32_t c, const Arc_Query_t *q, uint64_t counts[ARC_RESULTS])
+{
+	const Arc_Chunk_t *e = &r->chunk[c];
+	const uint64_t *res;
+	const uint32_t *runs;
+	const uint8_t *p;
+	uint32_t i = 0, run_end, sel, node_ok, start;
+	uint64_t z;
+	int64_t t;
+	uint8_t shift, plan = Arc_Plan(e, q);
+
+	if(plan == ARC_PLAN_SKIP)
+	{
+		return;		// Nothing in the chunk matches
+	}
+
+	if(plan == ARC_PLAN_FOOTER)
+	{
+		for(uint8_t k = 0; k < ARC_RESULTS; k++)	// Everything matches: the footer has the answer
+		{
+			counts[k] += e->results[k];
+		}
+
+		return;
+	}
+
+	res = (const uint64_t *)Arc_Column(r, c, ARC_COL_RESULT);
+	runs = (const uint32_t *)Arc_Column(r, c, ARC_COL_NODE);
+
+	if(plan == ARC_PLAN_RUNS)		// Node only: whole runs
+	{
+		for(start = 0; start < e->rows; start += runs[1], runs += 2)
+		{
+			if(runs[0] == q->node)
+			{
+				Arc_CountRange(res, start, start + runs[1], counts);
+			}
+		}
+
+		return;
+	}
+
+	p = Arc_Column(r, c, ARC_COL_TIME);
+	memcpy(&t, p, 8);
+	p += 8;
+	run_end = runs[1];
+	node_ok = (q->node == ARC_ANY_NODE || runs[0] == q->node);
+
+	while(i < e->rows)		// Time (and node) filter, 32 rounds per result word
+	{
+		sel = 0;
+
+		for(uint32_t k = 0; k < 32 && i < e->rows; k++, i++)
+		{
+			if(k % 8 == 0 && i > 0 && i + 8 <= run_end && i + 8 <= e->rows && \
+			   ((memcpy(&z, p, 8), z) & 0x8181818181818181ULL) == 0)
+			{
+				// 8 one-byte forward deltas in one node run: the 8 times rise from t to t + sum
+				uint64_t half = (z >> 1) & 0x7F7F7F7F7F7F7F7FULL;
+				int64_t end = t + (int64_t)((((half & 0x00FF00FF00FF00FFULL) + ((half >> 8) & 0x00FF00FF00FF00FFULL)) * \
+											 0x0001000100010001ULL) >> 48);
+
+				if(t >= q->from && end < q->to)
+				{
+					sel |= (uint32_t)(node_ok ? 0xFF : 0) << k;
+					t = end;
+				}else if(end < q->from || t >= q->to)
+				{
+					t = end;
+				}else
+				{
+					for(uint32_t j = 0; j < 8; j++, half >>= 8)
+					{
+						t += half & 0xFF;
+						sel |= (uint32_t)(node_ok && t >= q->from && t < q->to) << (k + j);
+					}
+				}
+
+				p += 8;
+				i += 7;
+				k += 7;
+				continue;
+			}
+
+			if(i > 0)
+			{
+				if(*p < 0x80)		// One-byte delta: every round at the game pace
+				{
+					z = *p++;
+				}else
+				{
+					for(z = 0, shift = 0; *p & 0x80; shift += 7)
+					{
+						z |= (uint64_t)(*p++ & 0x7F) << shift;
+					}
+
+					z |= (uint64_t)*p++ << shift;
+				}
+
+				t += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+			}
+
+			while(i >= run_end)
+			{
+				runs += 2;
+				run_end += runs[1];
+				node_ok = (q->node == ARC_ANY_NODE || runs[0] == q->node);
+			}
+
+			sel |= (uint32_t)(node_ok && t >= q->from && t < q->to) << k;
+		}
+
+		Arc_CountWord(res[(i - 1) / 32], Arc_Spread(sel), counts);
+	}
+}
+
+
+/**
+  * @brief  Adds the result counts of consecutive rounds of a chunk
+  * @param  r pointer to the reader state
+  * @param  c chunk index
+  * @param  first first round in the chunk
+  * @param  count number of rounds
+  * @param  counts counts to add to (index: result - 1)
+  * @retval None
+  */
+
+void Arc_CountRows(const Arc_Reader_t *r, uint32_t c, uint32_t first, uint32_t count, uint64_t counts[ARC_RESULTS])
+{
+	Arc_CountRange((const uint64_t *)Arc_Column(r, c, ARC_COL_RESULT), first, first + count, counts);
+}
+
+
+/**
+  * @brief  Counts the results of the rounds of an archive that match a query
+  * @param  r pointer to the reader state
+  * @param  q query
+  * @param  counts receives the counts (index: result - 1)
+  * @retval None
+  */
+
+void Arc_Count(const Arc_Reader_t *r, const Arc_Query_t *q, uint64_t counts[ARC_RESULTS])
+{
+	memset(counts, 0, ARC_RESULTS * sizeof(uint64_t));
+
+	for(uint32_t c = 0; c < r->chunks; c++)
+	{
+		Arc_CountChunk(r, c, q, counts);
+	}
+}
+
+
+/**
+  * @brief  Tells how much of the columns Arc_Count() reads for a query: the rounds of the
+  * 		chunks the footer cannot settle, and the bytes of the columns it reads in them
+  * 		(the node runs and results, plus the times when the time range cuts the chunk)
+  * @param  r pointer to the reader state
+  * @param  q query
+  * @param  rows receives the rounds scanned
+  * @param  bytes receives the column bytes scanned
+  * @retval None
+  */
+
+void Arc_Scanned(const Arc_Reader_t *r, const Arc_Query_t *q, uint64_t *rows, uint64_t *bytes)
+{
+	const Arc_Chunk_t *e;
+	uint8_t plan;
+
+	*rows = *bytes = 0;
+
+	for(uint32_t c = 0; c < r->chunks; c++)
+	{
+		e = &r->chunk[c];
+		plan = Arc_Plan(e, q);
+
+		if(plan == ARC_PLAN_RUNS || plan == ARC_PLAN_SCAN)
+		{
+			*rows += e->rows;
+			*bytes += e->size[ARC_COL_RESULT] + e->size[ARC_COL_NODE] + ((plan == ARC_PLAN_SCAN) ? e->size[ARC_COL_TIME] : 0);
+		}
+	}
+}
+
+
+/**
+  * @brief  Rounds an offset up to the next ARC_ALIGN boundary
+  * @param  v offset
+  * @retval Aligned offset
+  */
+
+static uint64_t Arc_AlignUp(uint64_t v)
+{
+	return (v + ARC_ALIGN - 1) & ~(uint64_t)(ARC_ALIGN - 1);
+}
+
+
+/**
+  * @brief  CRC-32 (IEEE 802.3), 4 bits per step from a 16-entry table
+  * @param  data bytes to check
+  * @param  len number of bytes
+  * @retval CRC
+  */
+
+static uint32_t Arc_Crc32(const uint8_t *data, size_t len)
+{
+	static const uint32_t table[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, \
+									   0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, \
+									   0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ table[crc & 0xF];
+		crc = (crc >> 4) ^ table[crc & 0xF];
+	}
+
+	return ~crc;
+}
+
+
+/**
+  * @brief  Encodes rounds into the 4 columns of a chunk
+  * @param  rows rounds
+  * @param  n number of rounds (1 to ARC_CHUNK_ROWS)
+  * @param  buf receives the columns, each 64-byte aligned from buf
+  * @param  entry receives the footer entry (but the offset)
+  * @retval Bytes used in buf
+  */
+
+static size_t Arc_EncodeChunk(const Arc_Row_t *rows, uint32_t n, uint8_t *buf, Arc_Chunk_t *entry)
+{
+	uint8_t *p = buf, *col;
+	uint64_t z, *res;
+	uint32_t *runs;
+	int64_t d;
+
+	memset(entry, 0, sizeof(Arc_Chunk_t));
+	entry->rows = n;
+	entry->time_min = entry->time_max = rows[0].time;
+	entry->node_min = entry->node_max = rows[0].node;
+
+	// Time
+	memcpy(p, &rows[0].time, 8);
+	p += 8;
+
+	for(uint32_t i = 1; i < n; i++)
+	{
+		d = rows[i].time - rows[i-1].time;
+		z = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+
+		while(z >= 0x80)
+		{
+			*p++ = (uint8_t)(z | 0x80);
+			z >>= 7;
+		}
+
+		*p++ = (uint8_t)z;
+	}
+
+	entry->size[ARC_COL_TIME] = p - buf;
+
+	// Hands
+	col = buf + Arc_AlignUp(p - buf);
+	memset(p, 0, col - p);				// Padding, and the hands themselves, are written as zeros
+	memset(col, 0, Arc_AlignUp((n + 1) / 2));
+
+	for(uint32_t i = 0; i < n; i++)
+	{
+		col[i / 2] |= (rows[i].hands & 0xF) << (4 * (i % 2));
+	}
+
+	entry->size[ARC_COL_HANDS] = (n + 1) / 2;
+
+	// Result, in whole 64-bit words
+	res = (uint64_t *)(col + Arc_AlignUp(entry->size[ARC_COL_HANDS]));
+	memset(res, 0, Arc_AlignUp((n + 31) / 32 * 8));
+
+	for(uint32_t i = 0; i < n; i++)
+	{
+		uint8_t k = (rows[i].result >= 1 && rows[i].result <= ARC_RESULTS) ? rows[i].result - 1 : ARC_RESULTS - 1;
+
+		res[i / 32] |= (uint64_t)k << (2 * (i % 32));
+		entry->results[k]++;
+	}
+
+	entry->size[ARC_COL_RESULT] = (n + 31) / 32 * 8;
+
+	// Node runs
+	runs = (uint32_t *)((uint8_t *)res + Arc_AlignUp(entry->size[ARC_COL_RESULT]));
+	runs[0] = rows[0].node;
+	runs[1] = 0;
+
+	for(uint32_t i = 0; i < n; i++)
+	{
+		if(rows[i].node != runs[0])
+		{
+			runs += 2;
+			runs[0] = rows[i].node;
+			runs[1] = 0;
+		}
+
+		runs[1]++;
+		entry->time_min = (rows[i].time < entry->time_min) ? rows[i].time : entry->time_min;
+		entry->time_max = (rows[i].time > entry->time_max) ? rows[i].time : entry->time_max;
+		entry->node_min = (rows[i].node < entry->node_min) ? rows[i].node : entry->node_min;
+		entry->node_max = (rows[i].node > entry->node_max) ? rows[i].node : entry->node_max;
+	}
+
+	runs += 2;
+	entry->size[ARC_COL_NODE] = (uint8_t *)runs - ((uint8_t *)res + Arc_AlignUp(entry->size[ARC_COL_RESULT]));
+
+	return (uint8_t *)runs - buf;
+}
+
+
+/**
+  * @brief  Finds the last valid trailer. A torn append leaves garbage after it
+  * @param  map mapped file
+  * @param  size file size
+  * @param  t receives the trailer
+  * @retval 0 if found, -1 otherwise
+  */
+
+static int Arc_FindTrailer(const uint8_t *map, size_t size, Arc_Trailer_t *t)
+{
+	for(size_t p = (size - sizeof(Arc_Trailer_t)) & ~(size_t)7; p >= ARC_HEADER_SIZE; p -= 8)
+	{
+		if(memcmp(map + p + 16, ARC_TRAILER_MAGIC, 8) != 0)
+		{
+			continue;
+		}
+
+		memcpy(t, map + p, sizeof(Arc_Trailer_t));
+
+		if(t->footer >= ARC_HEADER_SIZE && t->footer + (uint64_t)t->chunks * sizeof(Arc_Chunk_t) == p && \
+		   Arc_Crc32(map + t->footer, t->chunks * sizeof(Arc_Chunk_t)) == t->crc)
+		{
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+  * @brief  Adds the result counts of rounds a to b - 1 of a result column
+  * @param  res result column
+  * @param  a first round
+  * @param  b round after the last one
+  * @param  counts counts to add to
+  * @retval None
+  */
+
+static void Arc_CountRange(const uint64_t *res, uint32_t a, uint32_t b, uint64_t counts[ARC_RESULTS])
+{
+	uint32_t wa = a / 32, wb = (b - 1) / 32;
+	uint64_t lo = ~0ULL << (2 * (a % 32)), hi = ~0ULL >> (2 * (31 - (b - 1) % 32));
+
+	if(a >= b)
+	{
+		return;
+	}
+
+	if(wa == wb)
+	{
+		Arc_CountWord(res[wa], lo & hi & 0x5555555555555555ULL, counts);
+		return;
+	}
+
+	Arc_CountWord(res[wa], lo & 0x5555555555555555ULL, counts);
+
+	for(uint32_t w = wa + 1; w < wb; w++)
+	{
+		Arc_CountWord(res[w], 0x5555555555555555ULL, counts);
+	}
+
+	Arc_CountWord(res[wb], hi & 0x5555555555555555ULL, counts);
+}
+
+
+/**
+  * @brief  Adds the result counts of the selected rounds of a result word (SWAR)
+  * @param  word 32 results of 2 bits
+  * @param  mask low bit of the 2-bit field of each selected round
+  * @param  counts counts to add to
+  * @retval None
+  */
+
+static void Arc_CountWord(uint64_t word, uint64_t mask, uint64_t counts[ARC_RESULTS])
+{
+	uint64_t x;
+
+	for(uint8_t k = 0; k < ARC_RESULTS; k++)
+	{
+		x = word ^ (0x5555555555555555ULL * k);		// Fields equal to k become 00
+		counts[k] += __builtin_popcountll(~(x | (x >> 1)) & mask);
+	}
+}
+
+
+/**
+  * @brief  Moves bit i of a 32-bit mask to bit 2i
+  * @param  bits mask
+  * @retval Spread mask
+  */
+
+static uint64_t Arc_Spread(uint32_t bits)
+{
+	uint64_t x = bits;
+
+	x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+	x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+	x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+
+	return x;
+}
+
+
+/**
+  * @brief  Tells how a query is answered for a chunk, from its footer entry alone
+  * @param  e footer entry of the chunk
+  * @param  q query
+  * @retval ARC_PLAN_SKIP, ARC_PLAN_FOOTER, ARC_PLAN_RUNS or ARC_PLAN_SCAN
+  */
+
+static uint8_t Arc_Plan(const Arc_Chunk_t *e, const Arc_Query_t *q)
+{
+	if(e->rows == 0 || e->time_max < q->from || e->time_min >= q->to || \
+	   (q->node != ARC_ANY_NODE && (q->node < e->node_min || q->node > e->node_max)))
+	{
+		return ARC_PLAN_SKIP;
+	}
+
+	if(e->time_min >= q->from && e->time_max < q->to)
+	{
+		return (q->node == ARC_ANY_NODE || (e->node_min == q->node && e->node_max == q->node)) ? ARC_PLAN_FOOTER : ARC_PLAN_RUNS;
+	}
+
+	return ARC_PLAN_SCAN;
+}
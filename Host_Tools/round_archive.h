@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file           : round_archive.h
+  * @brief          : Header for round_archive.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   columnar archive of game rounds kept on the PC (.rpa files):
+  *                   rounds of many boards and captures, appended over weeks and
+  *                   scanned in place through a memory map.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __ROUND_ARCHIVE_H
+#define __ROUND_ARCHIVE_H
+
+
+// Includes
+#include <stdint.h>
+#include <stddef.h>
+
+
+// Defines
+// File layout (little-endian): 64-byte header, then chunks, then a footer index with one
+// Arc_Chunk_t per chunk followed by an Arc_Trailer_t. Chunks hold up to ARC_CHUNK_ROWS rounds
+// as 4 columns, each starting on a 64-byte boundary. An append writes its chunks and a new
+// footer after the old footer, so the file only grows and a torn append leaves the previous
+// footer valid: the reader takes the last valid trailer
+#define ARC_MAGIC				"RPSARC\0\1"
+#define ARC_TRAILER_MAGIC		"RPSAEND\1"
+#define ARC_HEADER_SIZE			64
+#define ARC_ALIGN				64
+#define ARC_CHUNK_ROWS			(1 << 20)
+#define ARC_COLUMNS				4
+#define ARC_COL_TIME			0		// First time (int64_t), then zigzag LEB128 deltas, in seconds
+#define ARC_COL_HANDS			1		// 4 bits per round: Nucleo's hand * 3 + Disc's hand, 9 for an error
+#define ARC_COL_RESULT			2		// 2 bits per round: game result - 1 (round i at bits 2*(i % 32) of word i / 32)
+#define ARC_COL_NODE			3		// Runs of the same node: node (uint32_t), rounds (uint32_t)
+#define ARC_RESULTS				4		// Nucleo wins, Disc wins, ties, errors
+#define ARC_ANY_NODE			0xFFFFFFFF
+
+
+// Typedefs
+// A round
+typedef struct
+{
+	int64_t time;				// Unix time in seconds
+	uint32_t node;				// Board or capture the round comes from
+	uint8_t hands;				// Nucleo's hand * 3 + Disc's hand (0 to 8), 9 for an error
+	uint8_t result;				// 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error
+} Arc_Row_t;
+
+// Footer entry of a chunk (72 bytes). The counts and spans let queries skip or settle a chunk
+// without reading its columns
+typedef struct
+{
+	uint64_t offset;					// Offset of the time column. The others follow, 64-byte aligned
+	uint32_t size[ARC_COLUMNS];			// Column sizes in bytes
+	uint32_t rows;
+	uint32_t node_min, node_max;
+	uint32_t results[ARC_RESULTS];		// Rounds of each result
+	uint32_t reserved;
+	int64_t time_min, time_max;
+} Arc_Chunk_t;
+
+// Last 24 bytes of a valid file
+typedef struct
+{
+	uint64_t footer;			// Offset of the first footer entry
+	uint32_t chunks;
+	uint32_t crc;				// CRC-32 of the footer entries
+	char magic[8];
+} Arc_Trailer_t;
+
+// Reader: the file is memory-mapped, the footer and the columns are used in place
+typedef struct
+{
+	const uint8_t *map;
+	size_t size;
+	const Arc_Chunk_t *chunk;
+	uint32_t chunks;
+	uint64_t rows;
+} Arc_Reader_t;
+
+// Aggregate query: rounds with from <= time < to, of one node or of all
+typedef struct
+{
+	int64_t from, to;
+	uint32_t node;				// ARC_ANY_NODE for all
+} Arc_Query_t;
+
+
+// Function prototypes
+int Arc_Append(const char *path, const Arc_Row_t *rows, uint64_t n);
+int Arc_Open(const char *path, Arc_Reader_t *r);
+void Arc_Close(Arc_Reader_t *r);
+const uint8_t *Arc_Column(const Arc_Reader_t *r, uint32_t c, uint8_t col);
+uint32_t Arc_ReadChunk(const Arc_Reader_t *r, uint32_t c, Arc_Row_t *rows);
+void Arc_CountRows(const Arc_Reader_t *r, uint32_t c, uint32_t first, uint32_t count, uint64_t counts[ARC_RESULTS]);
+void Arc_CountChunk(const Arc_Reader_t *r, uint32_t c, const Arc_Query_t *q, uint64_t counts[ARC_RESULTS]);
+void Arc_Count(const Arc_Reader_t *r, const Arc_Query_t *q, uint64_t counts[ARC_RESULTS]);
+void Arc_Scanned(const Arc_Reader_t *r, const Arc_Query_t *q, uint64_t *rows, uint64_t *bytes);
+
+
+#endif /* __ROUND_ARCHIVE_H */
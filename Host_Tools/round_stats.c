@@ -0,0 +1,1040 @@
+/**
+  ******************************************************************************
+  * @file    round_stats.c
+  * @author  Moe2Code
+  * @brief   Analytics over a round archive (round_archive.c), spread over all CPU cores.
+  *          Reports the results of each node, the length distribution of streaks of the same
+  *          result, the frequencies of hands, of pairs and of triples of consecutive rounds,
+  *          and chi-square tests of the hand generators (bias of each side, dependence on the
+  *          previous hand, dependence between the two sides).
+  *          Threads take chunks in turn and work on the packed columns in place: results are
+  *          counted 32 rounds per 64-bit word and hands 16 per word with compare/popcount
+  *          kernels, streak ends are found as changes between neighbouring 2-bit fields.
+  *          Rounds follow each other while the node stays the same, across chunks as well:
+  *          the streaks and n-grams cut by a chunk boundary are joined after the scan.
+  *          bench: builds a scratch archive of synthetic rounds (some nodes with a biased
+  *          generator), checks the parallel scan against a plain sequential one and reports
+  *          the speed with 1 thread up to the number of cores.
+  *          Usage: ./round_stats archive.rpa [-t threads] [-n node]
+  *                 ./round_stats bench [-m millions of rounds] [-t threads]
+  * @note    The scan is memory bound once the archive is cached. A cold archive is read at
+  *          disk speed, whatever the number of threads
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "round_archive.h"
+
+
+// Defines
+#define CODES				16			// Hands codes: Nucleo's hand * 3 + Disc's hand (0 to 8), 9 for an error
+#define ERROR_CODE			9
+#define STREAK_BUCKETS		64			// Streak lengths 1 to 62, then 63 and more
+#define NIBBLE_LOW			0x1111111111111111ULL
+#define BENCH_NODES			48
+#define TOP_TRIPLES			10
+
+
+// Typedefs
+// Results of a node
+typedef struct
+{
+	uint32_t node;				// ARC_ANY_NODE for a free slot
+	uint64_t results[ARC_RESULTS];
+} Node_Stats_t;
+
+// Open-addressing table of nodes
+typedef struct
+{
+	Node_Stats_t *slot;
+	uint32_t size, used;		// size is a power of 2
+} Node_Table_t;
+
+// Everything counted over a set of rounds
+typedef struct
+{
+	Node_Table_t nodes;
+	uint64_t codes[CODES];					// Rounds per hands code
+	uint64_t pairs[CODES * CODES];			// Consecutive rounds of a node: first code * 16 + second
+	uint64_t triples[CODES * CODES * CODES];
+	uint64_t streaks[ARC_RESULTS][STREAK_BUCKETS];
+	uint64_t longest[ARC_RESULTS];			// Of the streaks in the last bucket
+} Stats_t;
+
+// Streak touching a chunk boundary, joined with its neighbour after the scan
+typedef struct
+{
+	uint32_t node;
+	uint8_t result;
+	uint64_t len;				// 0: none (the node at that end is filtered out)
+} Streak_t;
+
+// Ends of a chunk
+typedef struct
+{
+	Streak_t head, tail;		// Streaks starting at the first round and ending with the last one
+	uint8_t whole;				// One streak covers the chunk: head only
+} Chunk_Edge_t;
+
+
+// Global variables
+static Arc_Reader_t archive;
+static uint32_t node_filter = ARC_ANY_NODE;
+static Chunk_Edge_t *edges;
+static atomic_uint next_chunk;
+
+
+// Function prototypes
+static Node_Stats_t *node_slot(Node_Table_t *t, uint32_t node);
+static void add_streak(Stats_t *st, uint8_t result, uint64_t len);
+static void stats_merge(Stats_t *dst, const Stats_t *src);
+static void count_codes(const uint8_t *hands, uint32_t a, uint32_t b, uint64_t codes[CODES]);
+static void run_streaks(const uint64_t *res, uint32_t a, uint32_t b, uint32_t rows, uint32_t node, Stats_t *st, Chunk_Edge_t *edge);
+static uint32_t last_run(uint32_t c, uint32_t *len);
+static uint32_t lookback(uint32_t c, uint32_t node);
+static void run_ngrams(const uint8_t *hands, uint32_t a, uint32_t b, uint32_t win, uint32_t have, Stats_t *st);
+static void scan_chunk(uint32_t c, Stats_t *st);
+static void* worker(void *arg);
+static void scan(long threads, Stats_t *total);
+static void scan_plain(Stats_t *st);
+static int node_order(const void *a, const void *b);
+static double chi2_p(double x, int df);
+static void report(const Stats_t *st);
+static int bench(int argc, char *argv[]);
+static double now_s(void);
+
+
+/**
+  * @brief  Returns the slot of a node, added if new
+  * @param  t node table
+  * @param  node node number
+  * @retval Slot
+  */
+
+static Node_Stats_t *node_slot(Node_Table_t *t, uint32_t node)
+{
+	uint32_t i;
+
+	if(2 * (t->used + 1) > t->size)		// Grow at half full
+	{
+		Node_Table_t old = *t;
+
+		t->size = old.size ? 2 * old.size : 64;
+		t->used = 0;
+		t->slot = malloc(t->size * sizeof(Node_Stats_t));
+
+		if(t->slot == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+
+		for(i = 0; i < t->size; i++)
+		{
+			t->slot[i].node = ARC_ANY_NODE;
+		}
+
+		for(i = 0; i < old.size; i++)
+		{
+			if(old.slot[i].node != ARC_ANY_NODE)
+			{
+				*node_slot(t, old.slot[i].node) = old.slot[i];
+			}
+		}
+
+		free(old.slot);
+	}
+
+	for(i = (node * 0x9E3779B1u) & (t->size - 1); t->slot[i].node != node; i = (i + 1) & (t->size - 1))
+	{
+		if(t->slot[i].node == ARC_ANY_NODE)
+		{
+			memset(&t->slot[i], 0, sizeof(Node_Stats_t));
+			t->slot[i].node = node;
+			t->used++;
+			break;
+		}
+	}
+
+	return &t->slot[i];
+}
+
+
+/**
+  * @brief  Counts a finished streak
+  * @param  st stats
+  * @param  result 0 to 3 (game result - 1)
+  * @param  len rounds
+  * @retval None
+  */
+
+static void add_streak(Stats_t *st, uint8_t result, uint64_t len)
+{
+	if(len == 0)
+	{
+		return;
+	}
+
+	if(len < STREAK_BUCKETS - 1)
+	{
+		st->streaks[result][len]++;
+	}else
+	{
+		st->streaks[result][STREAK_BUCKETS - 1]++;
+		st->longest[result] = (len > st->longest[result]) ? len : st->longest[result];
+	}
+}
+
+
+/**
+  * @brief  Adds the counts of one set of stats to another
+  * @param  dst stats to add to
+  * @param  src stats to add
+  * @retval None
+  */
+
+static void stats_merge(Stats_t *dst, const Stats_t *src)
+{
+	for(uint32_t i = 0; i < src->nodes.size; i++)
+	{
+		if(src->nodes.slot[i].node != ARC_ANY_NODE)
+		{
+			Node_Stats_t *n = node_slot(&dst->nodes, src->nodes.slot[i].node);
+
+			for(uint8_t k = 0; k < ARC_RESULTS; k++)
+			{
+				n->results[k] += src->nodes.slot[i].results[k];
+			}
+		}
+	}
+
+	for(uint32_t i = 0; i < CODES; i++)
+	{
+		dst->codes[i] += src->codes[i];
+	}
+
+	for(uint32_t i = 0; i < CODES * CODES; i++)
+	{
+		dst->pairs[i] += src->pairs[i];
+	}
+
+	for(uint32_t i = 0; i < CODES * CODES * CODES; i++)
+	{
+		dst->triples[i] += src->triples[i];
+	}
+
+	for(uint8_t k = 0; k < ARC_RESULTS; k++)
+	{
+		for(uint32_t i = 0; i < STREAK_BUCKETS; i++)
+		{
+			dst->streaks[k][i] += src->streaks[k][i];
+		}
+
+		dst->longest[k] = (src->longest[k] > dst->longest[k]) ? src->longest[k] : dst->longest[k];
+	}
+}
+
+
+/**
+  * @brief  Adds the hands codes of rounds a to b - 1 (SWAR: 16 codes per 64-bit word, a
+  * 		code is found by a compare to zero after an XOR, then a popcount)
+  * @param  hands hands column
+  * @param  a first round
+  * @param  b round after the last one
+  * @param  codes counts to add to
+  * @retval None
+  */
+
+static void count_codes(const uint8_t *hands, uint32_t a, uint32_t b, uint64_t codes[CODES])
+{
+	uint64_t word, mask, x;
+
+	for(uint32_t w = a / 16; w * 16 < b; w++)
+	{
+		memcpy(&word, hands + 8 * w, 8);		// Columns are padded to 64 bytes: a whole word is mapped
+		mask = NIBBLE_LOW;
+
+		if(w == a / 16)
+		{
+			mask &= ~0ULL << (4 * (a % 16));
+		}
+
+		if(w == (b - 1) / 16)
+		{
+			mask &= ~0ULL >> (4 * (15 - (b - 1) % 16));
+		}
+
+		for(uint8_t v = 0; v <= ERROR_CODE; v++)
+		{
+			x = word ^ (NIBBLE_LOW * v);		// Nibbles equal to v become 0
+			codes[v] += __builtin_popcountll(~(x | (x >> 1) | (x >> 2) | (x >> 3)) & mask);
+		}
+	}
+}
+
+
+/**
+  * @brief  Counts the streaks of rounds a to b - 1 of a node run. A streak ends where a
+  * 		2-bit result differs from the one before, found 32 rounds at a time by XORing
+  * 		the result word with itself shifted by one field. Streaks touching the first or
+  * 		the last round of the chunk are left to the join
+  * @param  res result column
+  * @param  a first round of the run
+  * @param  b round after the last one
+  * @param  rows rounds in the chunk
+  * @param  node node of the run
+  * @param  st stats
+  * @param  edge ends of the chunk
+  * @retval None
+  */
+
+static void run_streaks(const uint64_t *res, uint32_t a, uint32_t b, uint32_t rows, uint32_t node, Stats_t *st, Chunk_Edge_t *edge)
+{
+	uint32_t start = a, j;
+	uint8_t cur = (res[a / 32] >> (2 * (a % 32))) & 3;
+	uint64_t word, diff, ends;
+
+	for(uint32_t w = a / 32; w * 32 < b; w++)
+	{
+		word = res[w];
+		diff = word ^ ((word << 2) | ((w > 0) ? res[w - 1] >> 62 : 0));
+		ends = (diff | (diff >> 1)) & 0x5555555555555555ULL;
+
+		if(w == a / 32)
+		{
+			ends &= ~0ULL << (2 * (a % 32) + 1);		// Not at a itself
+		}
+
+		if(w == (b - 1) / 32)
+		{
+			ends &= ~0ULL >> (2 * (31 - (b - 1) % 32));
+		}
+
+		while(ends != 0)
+		{
+			j = w * 32 + __builtin_ctzll(ends) / 2;
+
+			if(start == 0)
+			{
+				edge->head = (Streak_t){node, cur, j};
+			}else
+			{
+				add_streak(st, cur, j - start);
+			}
+
+			cur = (word >> (2 * (j % 32))) & 3;
+			start = j;
+			ends &= ends - 1;
+		}
+	}
+
+	if(start == 0)
+	{
+		edge->head = (Streak_t){node, cur, b};
+		edge->whole = (b == rows);
+	}else if(b == rows)
+	{
+		edge->tail = (Streak_t){node, cur, b - start};
+	}else
+	{
+		add_streak(st, cur, b - start);
+	}
+}
+
+
+/**
+  * @brief  Returns the node of the last run of a chunk
+  * @param  c chunk index
+  * @param  len receives the length of the run
+  * @retval Node
+  */
+
+static uint32_t last_run(uint32_t c, uint32_t *len)
+{
+	const uint32_t *runs = (const uint32_t *)Arc_Column(&archive, c, ARC_COL_NODE);
+
+	for(uint32_t start = 0; ; runs += 2)
+	{
+		start += runs[1];
+
+		if(start >= archive.chunk[c].rows)
+		{
+			*len = runs[1];
+			return runs[0];
+		}
+	}
+}
+
+
+/**
+  * @brief  Returns the codes of the (up to 2) rounds of a node right before a chunk
+  * @param  c chunk index
+  * @param  node node of the first run of the chunk
+  * @retval Codes (older in bits 4-7) and their number in bits 8-9
+  */
+
+static uint32_t lookback(uint32_t c, uint32_t node)
+{
+	uint32_t win = 0, have = 0, len, shift = 0;
+
+	while(c-- > 0 && have < 2 && last_run(c, &len) == node)
+	{
+		const uint8_t *hands = Arc_Column(&archive, c, ARC_COL_HANDS);
+
+		for(uint32_t i = archive.chunk[c].rows; i > archive.chunk[c].rows - len && have < 2; i--, have++, shift += 4)
+		{
+			win |= ((hands[(i - 1) / 2] >> (4 * ((i - 1) % 2))) & 0xF) << shift;
+		}
+
+		if(len < archive.chunk[c].rows)		// The node started within this chunk
+		{
+			break;
+		}
+	}
+
+	return win | (have << 8);
+}
+
+
+/**
+  * @brief  Counts the triples of consecutive rounds a to b - 1 of a node run, and the pairs
+  * 		that start a node sequence. The other pairs are the ends of triples, added up
+  * 		after the scan
+  * @param  hands hands column
+  * @param  a first round
+  * @param  b round after the last one
+  * @param  win codes of the rounds before, the last one in the low nibble
+  * @param  have number of codes in win (0 to 2)
+  * @param  st stats
+  * @retval None
+  */
+
+static void run_ngrams(const uint8_t *hands, uint32_t a, uint32_t b, uint32_t win, uint32_t have, Stats_t *st)
+{
+	uint32_t i = a;
+
+	for(; i < b && have < 2; i++, have++)
+	{
+		win = ((win << 4) | ((hands[i / 2] >> (4 * (i % 2))) & 0xF)) & 0xFFF;
+
+		if(have == 1)
+		{
+			st->pairs[win & 0xFF]++;
+		}
+	}
+
+	for(; i < b; i++)		// Steady state: the window holds the last 3 codes
+	{
+		win = ((win << 4) | ((hands[i / 2] >> (4 * (i % 2))) & 0xF)) & 0xFFF;
+		st->triples[win]++;
+	}
+}
+
+
+/**
+  * @brief  Counts everything over the rounds of a chunk
+  * @param  c chunk index
+  * @param  st stats of the thread
+  * @retval None
+  */
+
+static void scan_chunk(uint32_t c, Stats_t *st)
+{
+	const Arc_Chunk_t *e = &archive.chunk[c];
+	const uint8_t *hands = Arc_Column(&archive, c, ARC_COL_HANDS);
+	const uint64_t *res = (const uint64_t *)Arc_Column(&archive, c, ARC_COL_RESULT);
+	const uint32_t *runs = (const uint32_t *)Arc_Column(&archive, c, ARC_COL_NODE);
+	Chunk_Edge_t *edge = &edges[c];
+	uint32_t win;
+
+	memset(edge, 0, sizeof(Chunk_Edge_t));
+
+	for(uint32_t start = 0; start < e->rows; start += runs[1], runs += 2)
+	{
+		if(node_filter != ARC_ANY_NODE && runs[0] != node_filter)
+		{
+			continue;
+		}
+
+		Arc_CountRows(&archive, c, start, runs[1], node_slot(&st->nodes, runs[0])->results);
+		count_codes(hands, start, start + runs[1], st->codes);
+		run_streaks(res, start, start + runs[1], e->rows, runs[0], st, edge);
+		win = (start == 0) ? lookback(c, runs[0]) : 0;
+		run_ngrams(hands, start, start + runs[1], win & 0xFF, win >> 8, st);
+	}
+}
+
+
+/**
+  * @brief  Worker thread: scans chunks until none is left
+  * @param  arg stats of the thread
+  * @retval NULL
+  */
+
+static void* worker(void *arg)
+{
+	uint32_t c;
+
+	while((c = atomic_fetch_add(&next_chunk, 1)) < archive.chunks)
+	{
+		scan_chunk(c, (Stats_t *)arg);
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Scans the archive with a number of threads, then joins the streaks cut by chunk
+  * 		boundaries (in chunk order)
+  * @param  threads number of threads
+  * @param  total receives the stats
+  * @retval None
+  */
+
+static void scan(long threads, Stats_t *total)
+{
+	Stats_t *st = calloc(threads, sizeof(Stats_t));
+	pthread_t *tid = calloc(threads, sizeof(pthread_t));
+	Streak_t open = {0};
+
+	edges = calloc(archive.chunks + 1, sizeof(Chunk_Edge_t));
+
+	if(st == NULL || tid == NULL || edges == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	atomic_store(&next_chunk, 0);
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_create(&tid[t], NULL, worker, &st[t]);
+	}
+
+	memset(total, 0, sizeof(Stats_t));
+
+	for(long t = 0; t < threads; t++)
+	{
+		pthread_join(tid[t], NULL);
+		stats_merge(total, &st[t]);
+		free(st[t].nodes.slot);
+	}
+
+	for(uint32_t i = 0; i < CODES * CODES * CODES; i++)
+	{
+		total->pairs[i & 0xFF] += total->triples[i];
+	}
+
+	for(uint32_t c = 0; c < archive.chunks; c++)
+	{
+		const Streak_t *h = &edges[c].head;
+
+		if(open.len > 0 && h->len > 0 && open.node == h->node && open.result == h->result)
+		{
+			open.len += h->len;
+		}else
+		{
+			add_streak(total, open.result, open.len);
+			open = *h;
+		}
+
+		if(!edges[c].whole)
+		{
+			add_streak(total, open.result, open.len);
+			open = edges[c].tail;
+		}
+	}
+
+	add_streak(total, open.result, open.len);
+
+	free(edges);
+	free(tid);
+	free(st);
+}
+
+
+/**
+  * @brief  Counts everything with one plain pass over the decoded rounds (bench reference)
+  * @param  st receives the stats
+  * @retval None
+  */
+
+static void scan_plain(Stats_t *st)
+{
+	Arc_Row_t *rows = malloc(ARC_CHUNK_ROWS * sizeof(Arc_Row_t));
+	uint32_t node = ARC_ANY_NODE, win = 0, have = 0;
+	Streak_t open = {0};
+
+	memset(st, 0, sizeof(Stats_t));
+
+	for(uint32_t c = 0; c < archive.chunks; c++)
+	{
+		uint32_t n = Arc_ReadChunk(&archive, c, rows);
+
+		for(uint32_t i = 0; i < n; i++)
+		{
+			const Arc_Row_t *row = &rows[i];
+
+			if(node_filter != ARC_ANY_NODE && row->node != node_filter)
+			{
+				add_streak(st, open.result, open.len);
+				open.len = 0;
+				node = ARC_ANY_NODE;
+				continue;
+			}
+
+			if(row->node != node)
+			{
+				add_streak(st, open.result, open.len);
+				open.len = 0;
+				have = 0;
+				node = row->node;
+			}
+
+			node_slot(&st->nodes, node)->results[row->result - 1]++;
+			st->codes[row->hands]++;
+			win = ((win << 4) | row->hands) & 0xFFF;
+			have++;
+
+			if(have >= 2)
+			{
+				st->pairs[win & 0xFF]++;
+			}
+
+			if(have >= 3)
+			{
+				st->triples[win]++;
+			}
+
+			if(open.len > 0 && open.result == row->result - 1)
+			{
+				open.len++;
+			}else
+			{
+				add_streak(st, open.result, open.len);
+				open = (Streak_t){node, row->result - 1, 1};
+			}
+		}
+	}
+
+	add_streak(st, open.result, open.len);
+	free(rows);
+}
+
+
+/**
+  * @brief  qsort() order of nodes
+  * @param  a, b node stats
+  * @retval <0, 0 or >0
+  */
+
+static int node_order(const void *a, const void *b)
+{
+	uint32_t x = ((const Node_Stats_t *)a)->node, y = ((const Node_Stats_t *)b)->node;
+
+	return (x > y) - (x < y);
+}
+
+
+/**
+  * @brief  Returns the p-value of a chi-square statistic (even degrees of freedom)
+  * @param  x statistic
+  * @param  df degrees of freedom (2 or 4)
+  * @retval Probability of a statistic at least as large with unbiased generators
+  */
+
+static double chi2_p(double x, int df)
+{
+	double term = 1, sum = 1;
+
+	for(int k = 1; k < df / 2; k++)
+	{
+		term *= x / (2 * k);
+		sum += term;
+	}
+
+	return exp(-x / 2) * sum;
+}
+
+
+/**
+  * @brief  Prints the stats
+  * @param  st stats
+  * @retval None
+  */
+
+static void report(const Stats_t *st)
+{
+	const char *hand[3] = {"Rock", "Paper", "Scissors"};
+	const char *result[ARC_RESULTS] = {"Nucleo wins", "Disc wins", "Ties", "Errors"};
+	uint64_t side[2][3] = {{0}}, trans[2][3][3] = {{{0}}}, played = 0, streaks, triples = 0;
+	Node_Stats_t *nodes = malloc((st->nodes.used + 1) * sizeof(Node_Stats_t));
+	uint32_t n_nodes = 0, top[TOP_TRIPLES], n_top = 0, k;
+	double chi, expect, sum;
+
+	// Nodes, in node order
+	for(uint32_t i = 0; i < st->nodes.size; i++)
+	{
+		if(st->nodes.slot[i].node != ARC_ANY_NODE)
+		{
+			nodes[n_nodes++] = st->nodes.slot[i];
+		}
+	}
+
+	qsort(nodes, n_nodes, sizeof(Node_Stats_t), node_order);
+	printf("%-10s %12s %9s %9s %9s %9s\n", "node", "rounds", "nucleo%", "disc%", "tie%", "error%");
+
+	for(uint32_t i = 0; i < n_nodes; i++)
+	{
+		uint64_t total = nodes[i].results[0] + nodes[i].results[1] + nodes[i].results[2] + nodes[i].results[3];
+
+		printf("%-10u %12llu %9.3f %9.3f %9.3f %9.3f\n", nodes[i].node, (unsigned long long)total, \
+			   100.0 * nodes[i].results[0] / total, 100.0 * nodes[i].results[1] / total, \
+			   100.0 * nodes[i].results[2] / total, 100.0 * nodes[i].results[3] / total);
+	}
+
+	free(nodes);
+
+	// Streaks
+	printf("\n%-12s %10s %8s %8s %8s %8s %8s %8s %8s\n", "streaks", "count", "mean", "1", "2-3", "4-7", "8-15", "16+", "longest");
+
+	for(uint8_t k = 0; k < ARC_RESULTS; k++)
+	{
+		uint64_t b[5] = {0}, longest = st->longest[k];
+
+		streaks = 0;
+		sum = 0;
+
+		for(uint32_t i = 1; i < STREAK_BUCKETS; i++)
+		{
+			streaks += st->streaks[k][i];
+			sum += (double)i * st->streaks[k][i];
+			b[(i >= 16) ? 4 : (i >= 8) ? 3 : (i >= 4) ? 2 : (i >= 2) ? 1 : 0] += st->streaks[k][i];
+			longest = (st->streaks[k][i] > 0 && i < STREAK_BUCKETS - 1 && i > longest) ? i : longest;
+		}
+
+		printf("%-12s %10llu %8.3f %7.3f%% %7.3f%% %7.3f%% %7.3f%% %7.3f%% %8llu\n", result[k], (unsigned long long)streaks, \
+			   streaks ? sum / streaks : 0, 100.0 * b[0] / (streaks ? streaks : 1), 100.0 * b[1] / (streaks ? streaks : 1), \
+			   100.0 * b[2] / (streaks ? streaks : 1), 100.0 * b[3] / (streaks ? streaks : 1), \
+			   100.0 * b[4] / (streaks ? streaks : 1), (unsigned long long)longest);
+	}
+
+	// Hands and transitions of each side
+	for(uint8_t v = 0; v < 9; v++)
+	{
+		side[0][v / 3] += st->codes[v];
+		side[1][v % 3] += st->codes[v];
+		played += st->codes[v];
+	}
+
+	for(uint32_t p = 0; p < CODES * CODES; p++)
+	{
+		uint8_t a = p >> 4, b = p & 0xF;
+
+		if(a < 9 && b < 9)
+		{
+			trans[0][a / 3][b / 3] += st->pairs[p];
+			trans[1][a % 3][b % 3] += st->pairs[p];
+		}
+	}
+
+	printf("\nhands          %10s %10s %10s   chi2 bias p   chi2 prev-hand p\n", hand[0], hand[1], hand[2]);
+
+	for(uint8_t s = 0; s < 2; s++)
+	{
+		uint64_t total = side[s][0] + side[s][1] + side[s][2], from[3], to[3], pairs = 0;
+		double p_bias, p_prev;
+
+		chi = 0;
+		expect = total / 3.0;
+
+		for(uint8_t h = 0; h < 3 && total > 0; h++)
+		{
+			chi += (side[s][h] - expect) * (side[s][h] - expect) / expect;
+		}
+
+		p_bias = (total > 0) ? chi2_p(chi, 2) : 1;
+
+		for(uint8_t h = 0; h < 3; h++)
+		{
+			from[h] = trans[s][h][0] + trans[s][h][1] + trans[s][h][2];
+			to[h] = trans[s][0][h] + trans[s][1][h] + trans[s][2][h];
+			pairs += from[h];
+		}
+
+		chi = 0;
+
+		for(uint8_t a = 0; a < 3 && pairs > 0; a++)
+		{
+			for(uint8_t b = 0; b < 3; b++)
+			{
+				expect = (double)from[a] * to[b] / pairs;
+				chi += (expect > 0) ? (trans[s][a][b] - expect) * (trans[s][a][b] - expect) / expect : 0;
+			}
+		}
+
+		p_prev = (pairs > 0) ? chi2_p(chi, 4) : 1;
+
+		printf("%-14s %9.3f%% %9.3f%% %9.3f%%   %11.3g   %16.3g\n", s ? "Disc" : "Nucleo", 100.0 * side[s][0] / (total ? total : 1), \
+			   100.0 * side[s][1] / (total ? total : 1), 100.0 * side[s][2] / (total ? total : 1), p_bias, p_prev);
+	}
+
+	chi = 0;
+
+	for(uint8_t v = 0; v < 9 && played > 0; v++)
+	{
+		expect = (double)side[0][v / 3] * side[1][v % 3] / played;
+		chi += (expect > 0) ? (st->codes[v] - expect) * (st->codes[v] - expect) / expect : 0;
+	}
+
+	printf("Nucleo vs Disc hands independence: p = %.3g\n", (played > 0) ? chi2_p(chi, 4) : 1);
+
+	// Most frequent triples of rounds, against their frequency if rounds were independent
+	printf("\n%-40s %12s %8s\n", "most frequent 3 rounds (Nucleo-Disc)", "count", "x indep");
+
+	for(uint32_t i = 0; i < CODES * CODES * CODES; i++)
+	{
+		triples += st->triples[i];
+
+		if(st->triples[i] == 0 || (n_top == TOP_TRIPLES && st->triples[i] <= st->triples[top[n_top - 1]]))
+		{
+			continue;
+		}
+
+		for(k = (n_top < TOP_TRIPLES) ? n_top++ : n_top - 1; k > 0 && st->triples[top[k - 1]] < st->triples[i]; k--)
+		{
+			top[k] = top[k - 1];		// Insertion into the sorted list
+		}
+
+		top[k] = i;
+	}
+
+	for(k = 0; k < n_top; k++)
+	{
+		char name[64] = "", *p = name;
+
+		expect = triples;
+
+		for(int shift = 8; shift >= 0; shift -= 4)
+		{
+			uint8_t v = (top[k] >> shift) & 0xF;
+
+			p += (v == ERROR_CODE) ? sprintf(p, "error ") : sprintf(p, "%c-%c ", hand[v / 3][0], hand[v % 3][0]);
+			expect *= (double)st->codes[v] / (played + st->codes[ERROR_CODE]);
+		}
+
+		printf("%-40s %12llu %8.3f\n", name, (unsigned long long)st->triples[top[k]], st->triples[top[k]] / expect);
+	}
+}
+
+
+/**
+  * @brief  Returns a monotonic time in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Builds a scratch archive, checks the threaded scan against the plain one and
+  * 		times it with 1 thread up to the number of cores
+  * @param  argc, argv options
+  * @retval Exit code
+  */
+
+static int bench(int argc, char *argv[])
+{
+	const char *path = "round_stats_bench.rpa";
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t total = 64000000, seed = 89, bytes = 0;
+	Arc_Row_t *rows = malloc(ARC_CHUNK_ROWS * sizeof(Arc_Row_t));
+	Stats_t *st = malloc(sizeof(Stats_t)), *ref = malloc(sizeof(Stats_t));
+	uint32_t node = 0, left = 0;
+	int64_t t = 1767225600;		// 2026-01-01
+	double t0, one = 0;
+	int opt, fail = 0;
+
+	while((opt = getopt(argc, argv, "m:t:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'm': total = (uint64_t)(atof(optarg) * 1e6); break;
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: ./round_stats bench [-m millions of rounds] [-t threads]\n");
+				return 1;
+		}
+	}
+
+	if(rows == NULL || st == NULL || ref == NULL || threads < 1)
+	{
+		fprintf(stderr, "Out of memory or no thread\n");
+		return 1;
+	}
+
+	remove(path);
+
+	for(uint64_t done = 0; done < total; )
+	{
+		uint32_t n = (total - done > ARC_CHUNK_ROWS) ? ARC_CHUNK_ROWS : total - done;
+
+		for(uint32_t i = 0; i < n; i++)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+			if(left == 0)		// Next capture: a node, from a few rounds to a few days of them
+			{
+				node = (seed >> 40) % BENCH_NODES;
+				left = 1 + ((seed >> 20) % 4 == 0 ? (seed >> 24) % 8 : (seed >> 24) % 100000);
+			}
+
+			uint32_t r = seed >> 33;
+			uint8_t nucleo = (node % 8 == 3 && r % 10 == 0) ? 0 : (r >> 4) % 3;		// Some nodes favour Rock
+
+			t += 4;
+			rows[i].time = t;
+			rows[i].node = node;
+			rows[i].hands = (r % 200 == 7) ? ERROR_CODE : nucleo * 3 + (r >> 12) % 3;
+			rows[i].result = (rows[i].hands == ERROR_CODE) ? 4 : \
+							 (nucleo == (rows[i].hands % 3 + 1) % 3) ? 1 : (nucleo == rows[i].hands % 3) ? 3 : 2;
+			left--;
+		}
+
+		if(Arc_Append(path, rows, n) != 0)
+		{
+			return 1;
+		}
+
+		done += n;
+	}
+
+	if(Arc_Open(path, &archive) != 0)
+	{
+		return 1;
+	}
+
+	for(uint32_t c = 0; c < archive.chunks; c++)
+	{
+		bytes += archive.chunk[c].size[ARC_COL_HANDS] + archive.chunk[c].size[ARC_COL_RESULT] + archive.chunk[c].size[ARC_COL_NODE];
+	}
+
+	t0 = now_s();
+	scan_plain(ref);
+	printf("%llu rounds in %u chunks, plain scan %.3f s\n", (unsigned long long)archive.rows, archive.chunks, now_s() - t0);
+
+	for(long n = 1; ; n = (2 * n > threads) ? threads : 2 * n)		// 1, 2, 4... and the number of cores
+	{
+		t0 = now_s();
+		scan(n, st);
+		t0 = now_s() - t0;
+		one = (n == 1) ? t0 : one;
+
+		for(uint32_t i = 0; i < ref->nodes.size; i++)
+		{
+			if(ref->nodes.slot[i].node != ARC_ANY_NODE && \
+			   memcmp(node_slot(&st->nodes, ref->nodes.slot[i].node), &ref->nodes.slot[i], sizeof(Node_Stats_t)) != 0)
+			{
+				fail = 1;
+			}
+		}
+
+		fail |= (st->nodes.used != ref->nodes.used) || memcmp(st->codes, ref->codes, sizeof(st->codes)) != 0 || \
+				memcmp(st->pairs, ref->pairs, sizeof(st->pairs)) != 0 || memcmp(st->triples, ref->triples, sizeof(st->triples)) != 0 || \
+				memcmp(st->streaks, ref->streaks, sizeof(st->streaks)) != 0 || memcmp(st->longest, ref->longest, sizeof(st->longest)) != 0;
+		printf("%3ld threads: %.3f s, %6.0f M rounds/s, %5.2f GB/s of columns, x%.2f %s\n", n, t0, archive.rows / t0 / 1e6, \
+			   bytes / t0 / 1e9, one / t0, fail ? "FAIL" : "");
+		free(st->nodes.slot);
+
+		if(n == threads)
+		{
+			break;
+		}
+	}
+
+	if(node_filter == ARC_ANY_NODE)
+	{
+		node_filter = 3;		// Same check on one node: its streaks and n-grams stop at the others
+		free(ref->nodes.slot);
+		scan_plain(ref);
+		scan(threads, st);
+		fail |= memcmp(st->streaks, ref->streaks, sizeof(st->streaks)) != 0 || memcmp(st->triples, ref->triples, sizeof(st->triples)) != 0;
+		printf("node 3 only: %s\n", fail ? "FAIL" : "ok");
+		free(st->nodes.slot);
+		node_filter = ARC_ANY_NODE;
+	}
+
+	free(ref->nodes.slot);
+	Arc_Close(&archive);
+	remove(path);
+	free(rows);
+	free(st);
+	free(ref);
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	Stats_t *st;
+	int opt;
+
+	if(argc >= 2 && strcmp(argv[1], "bench") == 0)
+	{
+		return bench(argc - 1, &argv[1]);
+	}
+
+	while((opt = getopt(argc, argv, "t:n:")) != -1)
+	{
+		switch(opt)
+		{
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			case 'n': node_filter = strtoul(optarg, NULL, 0); break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+
+	if(optind != argc - 1 || threads < 1)
+	{
+		fprintf(stderr, "Usage: %s archive.rpa [-t threads] [-n node]\n"
+						"       %s bench [-m millions of rounds] [-t threads]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	st = malloc(sizeof(Stats_t));
+
+	if(st == NULL || Arc_Open(argv[optind], &archive) != 0)
+	{
+		return 1;
+	}
+
+	scan(threads, st);
+	report(st);
+	free(st->nodes.slot);
+	free(st);
+	Arc_Close(&archive);
+
+	return 0;
+}
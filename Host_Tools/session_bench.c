@@ -0,0 +1,497 @@
+/**
+  ******************************************************************************
+  * @file    session_bench.c
+  * @author  Moe2Code
+  * @brief   Check and benchmark of Disc's referee session table (session.c).
+  *          check: random opens, lookups, closes and expiries against a plain node to
+  *                 player map, through many generations of players, with the hash index
+  *                 walked after every change (every node found from its home slot,
+  *                 no stray slot); a full table refusing a new node; the index of 256
+  *                 players of consecutive node IDs
+  *          bench: 256 players (node IDs 0 to 255, as on the bus, then random 16-bit
+  *                 IDs): ns per lookup hit and miss against a linear search of the node
+  *                 IDs, probes per lookup, and an idle scan of the structure of arrays
+  *                 against the same fields as an array of structures
+  *          Usage: ./session_bench [lookups] [seed]
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "session.h"
+
+
+// Defines
+#define CHECK_STEPS			2000000		// Random operations of the check
+#define CHECK_NODES			700			// Node IDs the check draws from: more than the table holds
+#define SCANS				20000		// Idle scans timed
+
+
+// Typedefs
+// Player as an array of structures would keep it
+typedef struct
+{
+	uint16_t node;
+	uint16_t seq;
+	uint8_t hand;
+	uint8_t pending;
+	uint32_t last_tick;
+	uint16_t results[SESSION_RESULTS];
+	Strategy_Player_t strategy;
+} Player_t;
+
+
+// Global variables
+static Session_Table_t table;
+static uint16_t ref_player[CHECK_NODES];	// Player index of each node, SESSION_NONE if none
+static uint32_t rng;
+
+
+/**
+  * @brief  Returns a monotonic timestamp in seconds
+  * @param  None
+  * @retval Seconds
+  */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+  * @brief  Returns the next random number (xorshift32)
+  * @param  None
+  * @retval Random number
+  */
+
+static uint32_t next_rand(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+
+	return rng;
+}
+
+
+static uint16_t home(uint16_t node)
+{
+	return (uint16_t)(node * 40503U) >> (16 - SESSION_SLOT_BITS);
+}
+
+
+/**
+  * @brief  Probes a lookup of a node takes: slots read up to its own or a free one
+  */
+
+static uint32_t probes(uint16_t node)
+{
+	uint32_t n = 1;
+
+	for(uint16_t s = home(node); table.slot_node[s] != node && table.slot_node[s] != SESSION_NONE; s = (s + 1) & (SESSION_SLOTS - 1))
+	{
+		n++;
+	}
+
+	return n;
+}
+
+
+/**
+  * @brief  Walks the whole table: every used slot is reached from its home slot with no
+  * 		free slot in between and points at the player of its node, every player is in
+  * 		the index once. Exits on a mismatch
+  */
+
+static void walk(const char *what, uint32_t step)
+{
+	uint16_t used = 0;
+
+	for(uint16_t s = 0; s < SESSION_SLOTS; s++)
+	{
+		uint16_t node = table.slot_node[s];
+
+		if(node == SESSION_NONE)
+		{
+			continue;
+		}
+
+		used++;
+
+		for(uint16_t h = home(node); h != s; h = (h + 1) & (SESSION_SLOTS - 1))
+		{
+			if(table.slot_node[h] == SESSION_NONE)
+			{
+				fprintf(stderr, "FAIL %s at step %u: node %u in slot %u is cut off from its home slot\n", what, step, node, s);
+				exit(1);
+			}
+		}
+
+		if(table.slot_player[s] >= table.count || table.node[table.slot_player[s]] != node)
+		{
+			fprintf(stderr, "FAIL %s at step %u: slot %u points at the wrong player\n", what, step, s);
+			exit(1);
+		}
+	}
+
+	if(used != table.count)
+	{
+		fprintf(stderr, "FAIL %s at step %u: %u slots used for %u players\n", what, step, used, table.count);
+		exit(1);
+	}
+}
+
+
+/**
+  * @brief  Compares every node's lookup with the map and exits on a mismatch
+  */
+
+static void compare(const char *what, uint32_t step)
+{
+	for(uint16_t node = 0; node < CHECK_NODES; node++)
+	{
+		uint16_t p = Session_Find(&table, node);
+
+		if((ref_player[node] == SESSION_NONE) != (p == SESSION_NONE) || (p != SESSION_NONE && table.node[p] != node))
+		{
+			fprintf(stderr, "FAIL %s at step %u: node %u found as player %u\n", what, step, node, p);
+			exit(1);
+		}
+	}
+}
+
+
+/**
+  * @brief  Random operations against the node to player map
+  * @param  None
+  * @retval Operations checked
+  */
+
+static uint32_t check(void)
+{
+	uint32_t tick = 0, sum = 0, opened;
+
+	Session_Init(&table);
+	memset(ref_player, 0xFF, sizeof(ref_player));
+
+	for(uint32_t i = 0; i < CHECK_STEPS; i++)
+	{
+		uint32_t r = next_rand();
+		uint16_t node = r % CHECK_NODES, p;
+
+		tick += r >> 30;
+
+		switch((r >> 12) % 8)
+		{
+			case 0: case 1: case 2: case 3:		// Hand from a node: opened if new, round recorded
+				p = Session_Open(&table, node, tick, STRATEGY_CYCLE, 1);
+
+				if(p == SESSION_NONE && (ref_player[node] != SESSION_NONE || table.count < SESSION_MAX))
+				{
+					fprintf(stderr, "FAIL open at step %u: node %u refused with %u players\n", i, node, table.count);
+					exit(1);
+				}
+
+				if(p != SESSION_NONE)
+				{
+					ref_player[node] = p;
+					Session_Result(&table, p, r % 3, 1 + (r >> 4) % 4, tick);
+				}
+
+				break;
+
+			case 4:								// Result sent
+				p = Session_NextPending(&table);
+
+				if(p != SESSION_NONE)
+				{
+					Session_Sent(&table, p);
+				}
+
+				break;
+
+			case 5:								// Session closed
+				p = Session_Find(&table, node);
+
+				if(p != SESSION_NONE)
+				{
+					ref_player[table.node[table.count - 1]] = p;		// The last player moves to p
+					ref_player[node] = SESSION_NONE;
+					Session_Close(&table, p);
+				}
+
+				break;
+
+			case 6:								// Idle sessions closed now and then
+				if((r >> 20) % 64 == 0)
+				{
+					Session_Expire(&table, tick, 300);
+					memset(ref_player, 0xFF, sizeof(ref_player));
+
+					for(uint16_t q = 0; q < table.count; q++)
+					{
+						ref_player[table.node[q]] = q;
+					}
+				}
+
+				break;
+
+			default:							// Lookup
+				p = Session_Find(&table, node);
+
+				if(p != ref_player[node])
+				{
+					fprintf(stderr, "FAIL find at step %u: node %u is player %u, not %u\n", i, node, p, ref_player[node]);
+					exit(1);
+				}
+
+				break;
+		}
+
+		if(i % 997 == 0)
+		{
+			uint16_t pending = 0;
+
+			walk("index", i);
+			compare("lookup", i);
+
+			for(uint16_t q = 0; q < table.count; q++)
+			{
+				pending += (table.pending[q] != 0);
+			}
+
+			if(pending != table.pending_count)
+			{
+				fprintf(stderr, "FAIL pending at step %u: %u results pending, counted %u\n", i, pending, table.pending_count);
+				exit(1);
+			}
+		}
+
+		sum += table.count;
+	}
+
+	opened = table.opened;
+
+	// Full: a new node is refused, a known one still found
+	Session_Init(&table);
+
+	for(uint16_t node = 0; node < SESSION_MAX; node++)
+	{
+		Session_Open(&table, node * 7 + 3, 0, STRATEGY_RANDOM, node + 1);
+	}
+
+	if(Session_Open(&table, 9999, 0, STRATEGY_RANDOM, 1) != SESSION_NONE || table.refused != 1 || \
+	   Session_Open(&table, 7 * 100 + 3, 0, STRATEGY_RANDOM, 1) != 100 || Session_Open(&table, SESSION_NONE, 0, STRATEGY_RANDOM, 1) != SESSION_NONE)
+	{
+		fprintf(stderr, "FAIL full table\n");
+		exit(1);
+	}
+
+	walk("full table", 0);
+	printf("Checked %u operations, %.1f players on average, %u sessions opened\n", CHECK_STEPS, (double)sum / CHECK_STEPS, opened);
+
+	return CHECK_STEPS;
+}
+
+
+/**
+  * @brief  Times lookups of 256 players whose node IDs are given
+  * @param  what name of the ID set
+  * @param  nodes the IDs
+  * @param  lookups lookups timed
+  * @retval None
+  */
+
+static void bench(const char *what, const uint16_t nodes[SESSION_MAX], uint32_t lookups)
+{
+	uint16_t *order = malloc(lookups * sizeof(uint16_t));
+	uint32_t probe_sum = 0, probe_max = 0, miss_probes = 0;
+	volatile uint32_t sink = 0;
+	double t0, hit_ns, miss_ns, linear_ns;
+
+	if(order == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	Session_Init(&table);
+
+	for(uint16_t i = 0; i < SESSION_MAX; i++)
+	{
+		Session_Open(&table, nodes[i], 0, STRATEGY_RANDOM, i + 1);
+		probe_sum += probes(nodes[i]);
+		probe_max = (probes(nodes[i]) > probe_max) ? probes(nodes[i]) : probe_max;
+	}
+
+	for(uint32_t i = 0; i < lookups; i++)		// Hands from random players, as they come off the bus
+	{
+		order[i] = nodes[next_rand() % SESSION_MAX];
+	}
+
+	t0 = now_s();
+
+	for(uint32_t i = 0; i < lookups; i++)
+	{
+		sink += Session_Find(&table, order[i]);
+	}
+
+	hit_ns = (now_s() - t0) * 1e9 / lookups;
+
+	for(uint32_t i = 0; i < lookups; i++)		// IDs with no session
+	{
+		order[i] = (uint16_t)next_rand();
+
+		while(Session_Find(&table, order[i]) != SESSION_NONE || order[i] == SESSION_NONE)
+		{
+			order[i]++;
+		}
+
+		miss_probes += (i < 65536) ? probes(order[i]) : 0;
+	}
+
+	t0 = now_s();
+
+	for(uint32_t i = 0; i < lookups; i++)
+	{
+		sink += Session_Find(&table, order[i]);
+	}
+
+	miss_ns = (now_s() - t0) * 1e9 / lookups;
+
+	for(uint32_t i = 0; i < lookups; i++)
+	{
+		order[i] = nodes[next_rand() % SESSION_MAX];
+	}
+
+	t0 = now_s();
+
+	for(uint32_t i = 0; i < lookups; i++)		// No index: the node IDs searched one by one
+	{
+		uint16_t p = 0;
+
+		while(p < table.count && table.node[p] != order[i])
+		{
+			p++;
+		}
+
+		sink += p;
+	}
+
+	linear_ns = (now_s() - t0) * 1e9 / lookups;
+
+	printf("%s: %u players, probes per hit %.2f (longest %u), per miss %.2f\n", what, table.count, (double)probe_sum / SESSION_MAX, \
+		   probe_max, (double)miss_probes / ((lookups < 65536) ? lookups : 65536));
+	printf("%s: lookup hit %.1f ns, miss %.1f ns, linear search %.1f ns (%.0fx)\n", what, hit_ns, miss_ns, linear_ns, linear_ns / hit_ns);
+
+	free(order);
+	(void)sink;
+}
+
+
+/**
+  * @brief  Times the idle scan (last tick and pending of every player) over the table's
+  * 		arrays and over the same players as an array of structures
+  */
+
+static void bench_scan(void)
+{
+	static Player_t players[SESSION_MAX];
+	const uint32_t *last_tick = table.last_tick;
+	const uint8_t *pending = table.pending;
+	uint16_t count = table.count;
+	volatile uint32_t sink = 0;
+	double t0, soa_ns, aos_ns;
+
+	for(uint16_t p = 0; p < table.count; p++)
+	{
+		table.last_tick[p] = next_rand() % 1000;
+		players[p].last_tick = table.last_tick[p];
+		players[p].pending = table.pending[p];
+	}
+
+	t0 = now_s();
+
+	for(uint32_t n = 0; n < SCANS; n++)
+	{
+		uint32_t idle = 0;
+
+		for(uint16_t p = 0; p < count; p++)
+		{
+			idle += (n + 1000 - last_tick[p] >= 1000) & (pending[p] == 0);
+		}
+
+		sink += idle;
+	}
+
+	soa_ns = (now_s() - t0) * 1e9 / SCANS;
+	t0 = now_s();
+
+	for(uint32_t n = 0; n < SCANS; n++)
+	{
+		uint32_t idle = 0;
+
+		for(uint16_t p = 0; p < count; p++)
+		{
+			idle += (n + 1000 - players[p].last_tick >= 1000) & (players[p].pending == 0);
+		}
+
+		sink += idle;
+	}
+
+	aos_ns = (now_s() - t0) * 1e9 / SCANS;
+
+	printf("idle scan of %u players: %.0f ns over %zu bytes (array of structures, %zu bytes each: %.0f ns over %zu bytes of cache lines)\n", \
+		   count, soa_ns, count * (sizeof(table.last_tick[0]) + sizeof(table.pending[0])), sizeof(Player_t), aos_ns, (size_t)count * 64);
+	(void)sink;
+}
+
+
+int main(int argc, char *argv[])
+{
+	uint32_t lookups = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+	uint32_t seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+	uint16_t nodes[SESSION_MAX];
+
+	rng = (seed != 0) ? seed : 1;
+	lookups = (lookups > 0) ? lookups : 1;
+	check();
+	printf("Table: %zu bytes of RAM (index %zu, strategy states %zu)\n", sizeof(Session_Table_t), \
+		   2 * SESSION_SLOTS * sizeof(uint16_t), sizeof(table.strategy));
+
+	for(uint16_t i = 0; i < SESSION_MAX; i++)
+	{
+		nodes[i] = i;
+	}
+
+	bench("node IDs 0-255", nodes, lookups);
+	bench_scan();
+
+	for(uint16_t i = 0; i < SESSION_MAX; i++)		// Distinct random IDs
+	{
+		uint8_t again;
+
+		do
+		{
+			nodes[i] = (uint16_t)next_rand();
+			again = (nodes[i] == SESSION_NONE);
+
+			for(uint16_t j = 0; j < i; j++)
+			{
+				again |= (nodes[j] == nodes[i]);
+			}
+		}while(again);
+	}
+
+	bench("random IDs", nodes, lookups);
+	printf("PASS\n");
+
+	return 0;
+}
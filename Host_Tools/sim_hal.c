@@ -0,0 +1,2397 @@
+/**
+  ******************************************************************************
+  * @file    sim_hal.c
+  * @author  Moe2Code
+  * @brief   HAL of a board library for the host simulation (board_sim.c). The firmware of
+  *          one board (its Src/ minus the startup and system files) is linked with this
+  *          file in place of the STM32 HAL. The following is conducted in source file:
+  *          + The HAL entry points the firmware calls, on the Sim_Io_t of the board
+  *          + Peripheral registers in the memory the simulation maps at their addresses
+  *          + Virtual time: timers, DMA requests, UART lines and HAL_Delay() are events at
+  *            exact times, computed from the prescalers and the clock tree
+  *          + Interrupt lines looked at between events, lowest IRQn first
+  *          + main() on its own stack, suspended while it waits or sleeps
+  * @note    Every line of both boards is at priority 15, so handlers never nest. They run
+  *          in no virtual time except for what they wait (blocking UART, HAL_Delay()).
+  *          Cycles spent computing are not counted: the board is infinitely fast between
+  *          two waits. The DMA1 Stream 6 step of UART DMA transfers is folded into the
+  *          USART interrupt
+  */
+
+// Includes
+#define _GNU_SOURCE
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include "stm32f4xx_hal.h"
+#include "board_sim.h"
+
+
+// Defines
+#define SIM_EXPORT				__attribute__((visibility("default")))
+#define SIM_STACK				(256 * 1024)
+#define SIM_ESCAPE				16				// siglongjmp() value of Sim_Escape()
+#define SIM_BUSY_MAX			(10 * SIM_S)	// Longest a handler may wait
+#define SIM_STORM_MAX			1000000			// Handlers in a row without time going on
+#define SIM_TIMERS				4
+#define SIM_DMAS				4
+
+// Thread (main()) states
+#define SIM_THREAD_RUN			0
+#define SIM_THREAD_WAIT			1		// Until wake
+#define SIM_THREAD_WFI			2		// Until the next handler
+#define SIM_THREAD_SLEEP		3		// Sleep on exit: only handlers run from now on
+#define SIM_THREAD_SPIN			4		// Loops without ever giving the CPU back: only handlers run
+#define SIM_THREAD_DONE			5		// main() returned
+
+// Private bits of the HAL GPIO modes
+#define SIM_GPIO_OUTPUT			0x00000001U
+#define SIM_GPIO_ALTERNATE		0x00000002U
+#define SIM_GPIO_EXTI			0x10000000U
+#define SIM_GPIO_IT				0x00010000U
+#define SIM_GPIO_RISING			0x00100000U
+#define SIM_GPIO_FALLING		0x00200000U
+
+// PWR CSR bits kept through resets
+#define SIM_PWR_KEPT			(PWR_CSR_SBF | PWR_CSR_WUF | PWR_CSR_BRE | PWR_CSR_BRR)
+#ifdef PWR_WAKEUP_PIN2
+#define SIM_PWR_EWUP			(PWR_WAKEUP_PIN1 | PWR_WAKEUP_PIN2)
+#else
+#define SIM_PWR_EWUP			PWR_WAKEUP_PIN1
+#endif
+
+#define SIM_RTC_REGS			0x40002800UL	// RTC and backup registers, backup domain
+#define SIM_RTC_SIZE			0x400UL
+
+
+// Typedefs
+// Basic or advanced timer counting up
+typedef struct
+{
+	TIM_HandleTypeDef *h;
+	uint64_t at;				// Next update event, SIM_NEVER if none scheduled
+	uint64_t t0;				// Counter at c0 at t0
+	uint64_t k;					// Index of the next update since t0
+	uint32_t c0, psc, arr;
+} Sim_Timer_t;
+
+// DMA stream, memory to peripheral on the requests of a timer
+typedef struct
+{
+	DMA_HandleTypeDef *h;
+	uint32_t *mem;				// Host address of the memory side
+	uint16_t n, idx;
+	uint8_t tcif;
+} Sim_Dma_t;
+
+// Interrupt line
+typedef struct
+{
+	IRQn_Type irqn;
+	void (*handler)(void);
+	uint8_t (*level)(uint8_t arg);
+	uint8_t arg;
+} Sim_Line_t;
+
+
+// Function prototypes
+int main(void);
+void CAN1_TX_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN1_RX0_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN1_RX1_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN1_SCE_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN2_TX_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN2_RX0_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN2_RX1_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void CAN2_SCE_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI0_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI1_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI2_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI3_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI4_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI9_5_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void EXTI15_10_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void DMA1_Stream5_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void DMA1_Stream6_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void DMA2_Stream5_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void USART2_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+void TIM6_DAC_IRQHandler(void) __attribute__((weak, visibility("hidden")));
+
+static uint8_t sim_level_can_tx(uint8_t ctrl);
+static uint8_t sim_level_can_rx(uint8_t ctrl_fifo);
+static uint8_t sim_level_can_sce(uint8_t ctrl);
+static uint8_t sim_level_exti(uint8_t first);
+static uint8_t sim_level_dma(uint8_t stream);
+static uint8_t sim_level_usart2(uint8_t unused);
+static uint8_t sim_level_tim6(uint8_t unused);
+
+
+// Global variables
+static const Sim_Line_t sim_lines[] =		// IRQn order: the lowest pending one runs first
+{
+	{EXTI0_IRQn, EXTI0_IRQHandler, sim_level_exti, 0},
+	{EXTI1_IRQn, EXTI1_IRQHandler, sim_level_exti, 1},
+	{EXTI2_IRQn, EXTI2_IRQHandler, sim_level_exti, 2},
+	{EXTI3_IRQn, EXTI3_IRQHandler, sim_level_exti, 3},
+	{EXTI4_IRQn, EXTI4_IRQHandler, sim_level_exti, 4},
+	{DMA1_Stream5_IRQn, DMA1_Stream5_IRQHandler, sim_level_dma, 0x15},
+	{DMA1_Stream6_IRQn, DMA1_Stream6_IRQHandler, sim_level_dma, 0x16},
+	{CAN1_TX_IRQn, CAN1_TX_IRQHandler, sim_level_can_tx, 0},
+	{CAN1_RX0_IRQn, CAN1_RX0_IRQHandler, sim_level_can_rx, 0x00},
+	{CAN1_RX1_IRQn, CAN1_RX1_IRQHandler, sim_level_can_rx, 0x01},
+	{CAN1_SCE_IRQn, CAN1_SCE_IRQHandler, sim_level_can_sce, 0},
+	{EXTI9_5_IRQn, EXTI9_5_IRQHandler, sim_level_exti, 5},
+	{USART2_IRQn, USART2_IRQHandler, sim_level_usart2, 0},
+	{EXTI15_10_IRQn, EXTI15_10_IRQHandler, sim_level_exti, 10},
+	{TIM6_DAC_IRQn, TIM6_DAC_IRQHandler, sim_level_tim6, 0},
+	{CAN2_TX_IRQn, CAN2_TX_IRQHandler, sim_level_can_tx, 1},
+	{CAN2_RX0_IRQn, CAN2_RX0_IRQHandler, sim_level_can_rx, 0x10},
+	{CAN2_RX1_IRQn, CAN2_RX1_IRQHandler, sim_level_can_rx, 0x11},
+	{CAN2_SCE_IRQn, CAN2_SCE_IRQHandler, sim_level_can_sce, 1},
+	{DMA2_Stream5_IRQn, DMA2_Stream5_IRQHandler, sim_level_dma, 0x25},
+};
+
+#define SIM_LINES				(sizeof(sim_lines) / sizeof(sim_lines[0]))
+
+static struct
+{
+	Sim_Io_t *io;
+	uint64_t until;
+	uint64_t tick_t0;					// uwTick was 0 at that time
+	sigjmp_buf jmp;
+	ucontext_t sched, thread;
+	uint8_t thread_state;
+	uint64_t wake;
+	uint8_t in_handler;
+	uint64_t handler_start;
+	int dead;							// SIM_STANDBY or SIM_HUNG once stopped
+	uint64_t storm_t;
+	uint32_t storm;
+	const Sim_Line_t *enabled[SIM_LINES];	// Lines enabled in the NVIC, IRQn order
+	uint8_t n_enabled;
+	uint8_t nvic[128];
+	// Clock tree
+	uint32_t pll_in, pll_m, pll_n, pll_p;
+	uint32_t sysclk, ahb_div, apb1_div, apb2_div;
+	uint32_t rtc_src;
+	// Peripherals
+	Sim_Timer_t timers[SIM_TIMERS];
+	Sim_Dma_t dmas[SIM_DMAS];
+	UART_HandleTypeDef *uart;
+	uint64_t uart_char_ps;
+	uint64_t uart_end;					// End of the DMA transfer on the line
+	unsigned long long rand_next;
+} sim;
+
+static uint8_t sim_stack[SIM_STACK] __attribute__((aligned(16)));
+
+
+/**
+  * @brief  Applies the BSRR writes of the firmware and the DMA, and reports the output
+  * 		pins that changed. Both happen between two calls to the HAL, so one sync per
+  * 		entry point keeps the writes in order
+  * @param  None
+  * @retval None
+  */
+
+static void sim_gpio_sync(void)
+{
+	Sim_Io_t *io = sim.io;
+
+	for(uint8_t p = 0; p < SIM_PORTS; p++)
+	{
+		GPIO_TypeDef *g = (GPIO_TypeDef *)(GPIOA_BASE + p * 0x400UL);
+		uint32_t bsrr = g->BSRR;
+
+		if(bsrr != 0)
+		{
+			g->ODR = (g->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFF);
+			g->BSRR = 0;
+		}
+
+		if((g->ODR & 0xFFFF) != io->odr[p])
+		{
+			io->odr[p] = g->ODR & 0xFFFF;
+			io->host->pin_out(io, io->now, p, io->out[p], io->odr[p] & io->out[p]);
+		}
+	}
+}
+
+
+/**
+  * @brief  Brings the registers the firmware reads in line with the simulation: GPIO
+  * 		outputs, PWR flags (cleared through CR, wakeup pin), CAN error counters
+  * @param  None
+  * @retval None
+  */
+
+static void sim_sync(void)
+{
+	Sim_Io_t *io = sim.io;
+
+	sim_gpio_sync();
+
+	if(PWR->CR & (PWR_CR_CSBF | PWR_CR_CWUF))
+	{
+		PWR->CSR &= ~(((PWR->CR & PWR_CR_CSBF) ? PWR_CSR_SBF : 0) | ((PWR->CR & PWR_CR_CWUF) ? PWR_CSR_WUF : 0));
+		PWR->CR &= ~(PWR_CR_CSBF | PWR_CR_CWUF);
+	}
+
+	if(io->wuf_event)
+	{
+		PWR->CSR |= PWR_CSR_WUF;
+		io->wuf_event = 0;
+	}
+
+	io->pwr_csr = PWR->CSR & (SIM_PWR_KEPT | SIM_PWR_EWUP);
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		Sim_Can_t *c = &io->can[i];
+		CAN_TypeDef *r = (i == 0) ? CAN1 : CAN2;
+		uint32_t tec = (c->tec > 255) ? 255 : c->tec;
+
+		r->ESR = (tec << CAN_ESR_TEC_Pos) | ((uint32_t)c->rec << CAN_ESR_REC_Pos) | ((uint32_t)c->lec << CAN_ESR_LEC_Pos) \
+				| ((c->boff) ? CAN_ESR_BOFF : 0) | ((tec > 127 || c->rec > 127) ? CAN_ESR_EPVF : 0) \
+				| ((tec > 95 || c->rec > 95) ? CAN_ESR_EWGF : 0);
+	}
+}
+
+
+/**
+  * @brief  Leaves the board for good: Standby entered or code that never returns. Valid
+  * 		from the thread, a handler or the signal handler of the watchdog
+  * @param  result SIM_STANDBY, SIM_HUNG or SIM_ESCAPE
+  * @retval None
+  */
+
+static void sim_stop(int result)
+{
+	siglongjmp(sim.jmp, result);
+}
+
+
+/**
+  * @brief  Waits until t: the thread is suspended, a handler moves the board's time on
+  * @param  t virtual time, SIM_NEVER to wait forever
+  * @retval None
+  */
+
+static void sim_wait(uint64_t t)
+{
+	Sim_Io_t *io = sim.io;
+
+	if(t <= io->now)
+	{
+		return;
+	}
+
+	if(sim.in_handler)
+	{
+		if(t == SIM_NEVER || t - sim.handler_start > SIM_BUSY_MAX)
+		{
+			sim_stop(SIM_HUNG);
+		}
+
+		io->now = t;
+	}else
+	{
+		sim.thread_state = SIM_THREAD_WAIT;
+		sim.wake = t;
+		swapcontext(&sim.thread, &sim.sched);
+	}
+
+	sim_sync();
+}
+
+
+/**
+  * @brief  Gives the CPU back to the simulation when an output needs it now (a pin the
+  * 		other board is waiting for). Handlers are left to finish
+  * @param  None
+  * @retval None
+  */
+
+static void sim_yield(void)
+{
+	if(sim.io->yield && !sim.in_handler && sim.thread_state == SIM_THREAD_RUN)
+	{
+		swapcontext(&sim.thread, &sim.sched);
+	}
+}
+
+
+/**
+  * @brief  Returns the host address of a 32-bit address of the library's data, as the
+  * 		firmware casts buffer addresses to uint32_t for the DMA
+  * @param  addr truncated address
+  * @retval Host pointer
+  */
+
+static void *sim_host_pointer(uint32_t addr)
+{
+	uintptr_t here = (uintptr_t)&sim;
+	uintptr_t p = (here & ~(uintptr_t)0xFFFFFFFFU) | addr;
+
+	if(p > here + 0x80000000UL)
+	{
+		p -= 0x100000000UL;
+	}else if(p + 0x80000000UL < here)
+	{
+		p += 0x100000000UL;
+	}
+
+	return (void *)p;
+}
+
+
+/**************************** Clock tree ****************************/
+
+static uint32_t sim_hclk(void)
+{
+	return sim.sysclk / sim.ahb_div;
+}
+
+
+static uint32_t sim_pclk(uint8_t apb2)
+{
+	return sim_hclk() / ((apb2) ? sim.apb2_div : sim.apb1_div);
+}
+
+
+/**
+  * @brief  Returns the clock of a timer: twice its APB clock when that is divided
+  * @param  instance timer registers
+  * @retval Hz
+  */
+
+static uint32_t sim_timclk(const void *instance)
+{
+	uint8_t apb2 = (uintptr_t)instance >= APB2PERIPH_BASE;
+	uint32_t div = (apb2) ? sim.apb2_div : sim.apb1_div;
+
+	return (div == 1) ? sim_hclk() : 2 * sim_pclk(apb2);
+}
+
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+	sim_sync();
+
+	if(RCC_OscInitStruct->PLL.PLLState == RCC_PLL_ON)
+	{
+		sim.pll_in = (RCC_OscInitStruct->PLL.PLLSource == RCC_PLLSOURCE_HSE) ? HSE_VALUE : HSI_VALUE;
+		sim.pll_m = RCC_OscInitStruct->PLL.PLLM;
+		sim.pll_n = RCC_OscInitStruct->PLL.PLLN;
+		sim.pll_p = RCC_OscInitStruct->PLL.PLLP;
+	}
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+	static const uint16_t ahb[8] = {2, 4, 8, 16, 64, 128, 256, 512};
+	uint32_t v;
+
+	(void)FLatency;
+	sim_sync();
+
+	if(RCC_ClkInitStruct->ClockType & RCC_CLOCKTYPE_SYSCLK)
+	{
+		switch(RCC_ClkInitStruct->SYSCLKSource)
+		{
+			case RCC_SYSCLKSOURCE_PLLCLK:
+				if(sim.pll_m == 0 || sim.pll_p == 0)
+				{
+					return HAL_ERROR;
+				}
+
+				sim.sysclk = (uint32_t)((uint64_t)sim.pll_in / sim.pll_m * sim.pll_n / sim.pll_p);
+				break;
+			case RCC_SYSCLKSOURCE_HSE:
+				sim.sysclk = HSE_VALUE;
+				break;
+			default:
+				sim.sysclk = HSI_VALUE;
+				break;
+		}
+	}
+
+	if(RCC_ClkInitStruct->ClockType & RCC_CLOCKTYPE_HCLK)
+	{
+		v = RCC_ClkInitStruct->AHBCLKDivider;
+		sim.ahb_div = (v & 0x80) ? ahb[(v >> 4) & 7] : 1;
+	}
+
+	if(RCC_ClkInitStruct->ClockType & RCC_CLOCKTYPE_PCLK1)
+	{
+		v = RCC_ClkInitStruct->APB1CLKDivider;
+		sim.apb1_div = (v & 0x1000) ? (2U << ((v >> 10) & 3)) : 1;
+	}
+
+	if(RCC_ClkInitStruct->ClockType & RCC_CLOCKTYPE_PCLK2)
+	{
+		v = RCC_ClkInitStruct->APB2CLKDivider;
+		sim.apb2_div = (v & 0x1000) ? (2U << ((v >> 10) & 3)) : 1;
+	}
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit)
+{
+	sim_sync();
+
+	if(PeriphClkInit->PeriphClockSelection & RCC_PERIPHCLK_RTC)
+	{
+		sim.rtc_src = (PeriphClkInit->RTCClockSelection == RCC_RTCCLKSOURCE_LSE) ? LSE_VALUE : \
+				(PeriphClkInit->RTCClockSelection == RCC_RTCCLKSOURCE_LSI) ? LSI_VALUE : 0;
+	}
+
+	return HAL_OK;
+}
+
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+	return sim_hclk();
+}
+
+
+/**************************** Core, tick and power ****************************/
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+	sim.tick_t0 = sim.io->now;
+	HAL_MspInit();
+
+	return HAL_OK;
+}
+
+
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)((sim.io->now - sim.tick_t0) / SIM_MS);
+}
+
+
+void HAL_IncTick(void)
+{
+}
+
+
+// Unique device ID: a different one for each board of the simulation, as for real chips
+uint32_t HAL_GetUIDw0(void)
+{
+	return 0x00200041U + 0x00010003U * sim.io->index;
+}
+
+
+uint32_t HAL_GetUIDw1(void)
+{
+	return 0x31385107U ^ ((uint32_t)sim.io->index << 24);
+}
+
+
+uint32_t HAL_GetUIDw2(void)
+{
+	return 0x33353832U + sim.io->index;
+}
+
+
+void HAL_Delay(uint32_t Delay)
+{
+	uint32_t tickstart = HAL_GetTick();
+
+	sim_sync();
+
+	if(Delay == HAL_MAX_DELAY)
+	{
+		sim_wait(SIM_NEVER);
+	}
+
+	sim_wait(sim.tick_t0 + ((uint64_t)tickstart + Delay + 1) * SIM_MS);
+}
+
+
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup)
+{
+	(void)PriorityGroup;
+}
+
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	(void)IRQn;
+	(void)PreemptPriority;
+	(void)SubPriority;
+}
+
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	if(IRQn < 0 || sim.nvic[IRQn])
+	{
+		return;
+	}
+
+	sim.nvic[IRQn] = 1;
+	sim.n_enabled = 0;
+
+	for(uint8_t i = 0; i < SIM_LINES; i++)
+	{
+		if(sim.nvic[sim_lines[i].irqn])
+		{
+			sim.enabled[sim.n_enabled++] = &sim_lines[i];
+		}
+	}
+}
+
+
+uint32_t HAL_SYSTICK_Config(uint32_t TicksNumb)
+{
+	(void)TicksNumb;
+
+	return 0;
+}
+
+
+void HAL_SYSTICK_CLKSourceConfig(uint32_t CLKSource)
+{
+	(void)CLKSource;
+}
+
+
+void HAL_SYSTICK_IRQHandler(void)
+{
+	HAL_SYSTICK_Callback();
+}
+
+
+void HAL_PWR_EnableBkUpAccess(void)
+{
+	PWR->CR |= PWR_CR_DBP;
+}
+
+
+HAL_StatusTypeDef HAL_PWREx_EnableBkUpReg(void)
+{
+	PWR->CSR |= PWR_CSR_BRE | PWR_CSR_BRR;		// The regulator is ready at once
+	sim_sync();
+
+	return HAL_OK;
+}
+
+
+void HAL_PWR_EnableWakeUpPin(uint32_t WakeUpPinx)
+{
+	PWR->CSR |= WakeUpPinx;
+	sim_sync();
+}
+
+
+void HAL_DBGMCU_EnableDBGSleepMode(void)
+{
+}
+
+
+void HAL_PWR_EnableSleepOnExit(void)
+{
+	SCB->SCR |= SCB_SCR_SLEEPONEXIT_Msk;
+}
+
+
+void HAL_PWR_DisableSleepOnExit(void)
+{
+	SCB->SCR &= ~SCB_SCR_SLEEPONEXIT_Msk;
+}
+
+
+/**
+  * @brief  WFI. In thread mode the thread resumes after the next handler, or never with
+  * 		sleep on exit. A handler cannot be woken by a line of its own priority: WFI
+  * 		returns at once
+  */
+
+void HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry)
+{
+	(void)Regulator;
+	(void)SLEEPEntry;
+
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+	sim_sync();
+
+	if(sim.in_handler || sim.thread_state != SIM_THREAD_RUN)
+	{
+		return;
+	}
+
+	sim.thread_state = (SCB->SCR & SCB_SCR_SLEEPONEXIT_Msk) ? SIM_THREAD_SLEEP : SIM_THREAD_WFI;
+	swapcontext(&sim.thread, &sim.sched);
+	sim_sync();
+}
+
+
+void HAL_PWR_EnterSTANDBYMode(void)
+{
+	PWR->CR |= PWR_CR_PDDS;
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	PWR->CSR |= PWR_CSR_SBF;
+	sim_sync();
+	sim_stop(SIM_STANDBY);
+}
+
+
+/**************************** GPIO and EXTI ****************************/
+
+static uint8_t sim_port(const GPIO_TypeDef *GPIOx)
+{
+	return (uint8_t)(((uintptr_t)GPIOx - GPIOA_BASE) / 0x400UL);
+}
+
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	Sim_Io_t *io = sim.io;
+	uint8_t p = sim_port(GPIOx);
+	uint32_t mode = GPIO_Init->Mode;
+	uint16_t old = io->out[p];
+
+	sim_sync();
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		uint16_t bit = 1U << pin;
+
+		if(!(GPIO_Init->Pin & bit))
+		{
+			continue;
+		}
+
+		if((mode & 3) == SIM_GPIO_OUTPUT)
+		{
+			io->out[p] |= bit;
+		}else
+		{
+			io->out[p] &= ~bit;
+		}
+
+		if(mode & SIM_GPIO_EXTI)
+		{
+			io->exti_port[pin] = p;
+			io->exti_imr = (mode & SIM_GPIO_IT) ? (io->exti_imr | bit) : (io->exti_imr & ~bit);
+			io->exti_rtsr = (mode & SIM_GPIO_RISING) ? (io->exti_rtsr | bit) : (io->exti_rtsr & ~bit);
+			io->exti_ftsr = (mode & SIM_GPIO_FALLING) ? (io->exti_ftsr | bit) : (io->exti_ftsr & ~bit);
+		}
+	}
+
+	if(io->out[p] != old)
+	{
+		io->host->pin_out(io, io->now, p, io->out[p] | old, io->odr[p] & io->out[p]);
+	}
+
+	sim_yield();
+}
+
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+	Sim_Io_t *io = sim.io;
+	uint8_t p = sim_port(GPIOx);
+	uint16_t old = io->out[p];
+
+	sim_sync();
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		uint16_t bit = 1U << pin;
+
+		if((GPIO_Pin & bit) && io->exti_port[pin] == p)
+		{
+			io->exti_imr &= ~bit;
+			io->exti_rtsr &= ~bit;
+			io->exti_ftsr &= ~bit;
+		}
+	}
+
+	io->out[p] &= ~GPIO_Pin;
+
+	if(io->out[p] != old)
+	{
+		io->host->pin_out(io, io->now, p, old, io->odr[p] & io->out[p]);
+	}
+
+	sim_yield();
+}
+
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	Sim_Io_t *io = sim.io;
+	uint8_t p = sim_port(GPIOx);
+	uint16_t level = (io->odr[p] & io->out[p]) | (io->idr[p] & ~io->out[p]);
+
+	return (level & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	sim_sync();
+	GPIOx->ODR = (PinState != GPIO_PIN_RESET) ? (GPIOx->ODR | GPIO_Pin) : (GPIOx->ODR & ~(uint32_t)GPIO_Pin);
+	sim_sync();
+	sim_yield();
+}
+
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	sim_sync();
+	GPIOx->ODR ^= GPIO_Pin;
+	sim_sync();
+	sim_yield();
+}
+
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin)
+{
+	if(sim.io->exti_pr & GPIO_Pin)
+	{
+		sim.io->exti_pr &= ~GPIO_Pin;
+		HAL_GPIO_EXTI_Callback(GPIO_Pin);
+	}
+}
+
+
+/**************************** Timers ****************************/
+
+static Sim_Timer_t *sim_timer(TIM_HandleTypeDef *htim)
+{
+	for(uint8_t i = 0; i < SIM_TIMERS; i++)
+	{
+		if(sim.timers[i].h == htim || sim.timers[i].h == NULL)
+		{
+			sim.timers[i].h = htim;
+
+			return &sim.timers[i];
+		}
+	}
+
+	sim_stop(SIM_HUNG);		// More timers than the boards use
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Returns the time of update event k since t0, exactly: the counter runs at
+  * 		timclk / (PSC + 1) from c0 and wraps after ARR
+  */
+
+static uint64_t sim_timer_at(const Sim_Timer_t *tm)
+{
+	unsigned __int128 ticks = ((unsigned __int128)tm->k * (tm->arr + 1U) - tm->c0) * (tm->psc + 1U);
+
+	return tm->t0 + (uint64_t)(ticks * SIM_S / sim_timclk(tm->h->Instance));
+}
+
+
+/**
+  * @brief  Schedules the next update of a running timer from its counter. Updates are
+  * 		events only while something (interrupt or DMA request) is enabled on them
+  */
+
+static void sim_timer_schedule(Sim_Timer_t *tm)
+{
+	TIM_TypeDef *r = tm->h->Instance;
+
+	tm->at = SIM_NEVER;
+
+	if(!(r->CR1 & TIM_CR1_CEN) || !(r->DIER & (TIM_DIER_UIE | TIM_DIER_UDE)))
+	{
+		return;
+	}
+
+	tm->t0 = sim.io->now;
+	tm->arr = r->ARR & 0xFFFF;
+	tm->psc = r->PSC & 0xFFFF;
+	tm->c0 = (r->CNT > tm->arr) ? 0 : r->CNT;
+	tm->k = 1;
+	tm->at = sim_timer_at(tm);
+}
+
+
+static void sim_dma_request(DMA_HandleTypeDef *hdma);
+
+static void sim_timer_fire(Sim_Timer_t *tm)
+{
+	TIM_TypeDef *r = tm->h->Instance;
+	DMA_HandleTypeDef *hdma = tm->h->hdma[TIM_DMA_ID_UPDATE];
+	uint64_t t = tm->at;
+
+	if(!(r->CR1 & TIM_CR1_CEN) || !(r->DIER & (TIM_DIER_UIE | TIM_DIER_UDE)))
+	{
+		tm->at = SIM_NEVER;
+
+		return;
+	}
+
+	r->SR |= TIM_SR_UIF;
+
+	if((r->DIER & TIM_DIER_UDE) && hdma != NULL)
+	{
+		sim_dma_request(hdma);
+	}
+
+	if((r->ARR & 0xFFFF) != tm->arr || (r->PSC & 0xFFFF) != tm->psc)	// Changed on the fly: new period from this update
+	{
+		tm->t0 = t;
+		tm->arr = r->ARR & 0xFFFF;
+		tm->psc = r->PSC & 0xFFFF;
+		tm->c0 = 0;
+		tm->k = 0;
+	}
+
+	tm->k++;
+	tm->at = sim_timer_at(tm);
+}
+
+
+/**
+  * @brief  ARR written by a handler while ARPE is clear: the running period ends at the new
+  * 		value at once, as the counter compares against it. A counter already past the
+  * 		new value would count up to 0xFFFF first: that case keeps the old update
+  */
+
+static void sim_timer_reload(void)
+{
+	for(uint8_t i = 0; i < SIM_TIMERS; i++)
+	{
+		Sim_Timer_t *tm = &sim.timers[i], next;
+
+		if(tm->h == NULL || tm->at == SIM_NEVER || (tm->h->Instance->ARR & 0xFFFF) == tm->arr || (tm->h->Instance->CR1 & TIM_CR1_ARPE))
+		{
+			continue;
+		}
+
+		next = *tm;
+
+		if(tm->k > 1)			// The period under way started at update k - 1
+		{
+			next.k = tm->k - 1;
+			next.t0 = sim_timer_at(&next);
+			next.c0 = 0;
+		}
+
+		next.k = 1;
+		next.arr = tm->h->Instance->ARR & 0xFFFF;
+		next.at = sim_timer_at(&next);
+
+		if(next.at > sim.io->now)
+		{
+			*tm = next;
+		}
+	}
+}
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+	if(htim == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	sim_sync();
+
+	if(htim->State == HAL_TIM_STATE_RESET)
+	{
+		htim->Lock = HAL_UNLOCKED;
+		HAL_TIM_Base_MspInit(htim);
+	}
+
+	htim->State = HAL_TIM_STATE_BUSY;
+	htim->Instance->ARR = (htim->Instance == TIM6 && sim.io->tim6_arr != 0) ? sim.io->tim6_arr : htim->Init.Period;
+	htim->Instance->PSC = htim->Init.Prescaler;
+	htim->Instance->CNT = 0;
+	htim->Instance->SR |= TIM_SR_UIF;			// EGR UG: the update flag is set at once
+	sim_timer_schedule(sim_timer(htim));
+	htim->State = HAL_TIM_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+static HAL_StatusTypeDef sim_timer_start(TIM_HandleTypeDef *htim, uint32_t dier)
+{
+	Sim_Timer_t *tm = sim_timer(htim);
+	uint8_t was_running = (htim->Instance->CR1 & TIM_CR1_CEN) && tm->at != SIM_NEVER;
+
+	sim_sync();
+	htim->Instance->DIER |= dier;
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+
+	if(!was_running)
+	{
+		sim_timer_schedule(tm);
+	}
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_BUSY;
+	sim_timer_start(htim, 0);
+	htim->State = HAL_TIM_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+	return sim_timer_start(htim, TIM_DIER_UIE);
+}
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim)
+{
+	sim_sync();
+	htim->State = HAL_TIM_STATE_BUSY;
+	htim->Instance->CR1 &= ~TIM_CR1_CEN;
+	htim->Instance->CNT = 0;
+	sim_timer(htim)->at = SIM_NEVER;
+	htim->State = HAL_TIM_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim)
+{
+	htim->Instance->DIER &= ~TIM_DIER_UIE;
+
+	return HAL_TIM_Base_Stop(htim);
+}
+
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim)
+{
+	if((htim->Instance->SR & TIM_SR_UIF) && (htim->Instance->DIER & TIM_DIER_UIE))
+	{
+		htim->Instance->SR &= ~TIM_SR_UIF;
+		HAL_TIM_PeriodElapsedCallback(htim);
+	}
+}
+
+
+/**************************** DMA ****************************/
+
+static Sim_Dma_t *sim_dma(DMA_HandleTypeDef *hdma)
+{
+	for(uint8_t i = 0; i < SIM_DMAS; i++)
+	{
+		if(sim.dmas[i].h == hdma || sim.dmas[i].h == NULL)
+		{
+			sim.dmas[i].h = hdma;
+
+			return &sim.dmas[i];
+		}
+	}
+
+	sim_stop(SIM_HUNG);
+
+	return NULL;
+}
+
+
+/**
+  * @brief  One request of the peripheral: a word from memory to the peripheral register
+  */
+
+static void sim_dma_request(DMA_HandleTypeDef *hdma)
+{
+	Sim_Dma_t *d = sim_dma(hdma);
+	DMA_Stream_TypeDef *s = hdma->Instance;
+
+	if(!(s->CR & DMA_SxCR_EN) || s->NDTR == 0 || d->mem == NULL)
+	{
+		return;
+	}
+
+	*(volatile uint32_t *)(uintptr_t)s->PAR = d->mem[d->idx];
+	d->idx += (s->CR & DMA_SxCR_MINC) ? 1 : 0;
+
+	if(--s->NDTR == 0)
+	{
+		d->tcif = 1;
+
+		if(s->CR & DMA_SxCR_CIRC)
+		{
+			s->NDTR = d->n;
+			d->idx = 0;
+		}else
+		{
+			s->CR &= ~DMA_SxCR_EN;
+		}
+	}
+
+	sim_gpio_sync();
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	if(hdma == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	sim_sync();
+	hdma->Instance->CR = hdma->Init.Channel | hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc \
+			| hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment | hdma->Init.Mode | hdma->Init.Priority;
+	hdma->Instance->NDTR = 0;
+	sim_dma(hdma)->tcif = 0;
+	hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+	hdma->State = HAL_DMA_STATE_READY;
+	hdma->Lock = HAL_UNLOCKED;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	Sim_Dma_t *d = sim_dma(hdma);
+	uint8_t to_mem = (hdma->Init.Direction == DMA_PERIPH_TO_MEMORY);
+
+	sim_sync();
+
+	if(hdma->State != HAL_DMA_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	hdma->State = HAL_DMA_STATE_BUSY;
+	hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+	hdma->Instance->PAR = (to_mem) ? SrcAddress : DstAddress;
+	hdma->Instance->M0AR = (to_mem) ? DstAddress : SrcAddress;
+	hdma->Instance->NDTR = DataLength;
+	hdma->Instance->CR |= DMA_SxCR_EN;
+	d->mem = (to_mem) ? NULL : (uint32_t *)sim_host_pointer(SrcAddress);	// Peripheral to memory: nothing feeds it
+	d->n = (uint16_t)DataLength;
+	d->idx = 0;
+	d->tcif = 0;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	HAL_StatusTypeDef status = HAL_DMA_Start(hdma, SrcAddress, DstAddress, DataLength);
+
+	if(status == HAL_OK)
+	{
+		hdma->Instance->CR |= DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE | ((hdma->XferHalfCpltCallback != NULL) ? DMA_SxCR_HTIE : 0);
+	}
+
+	return status;
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	sim_sync();
+
+	if(hdma->State != HAL_DMA_STATE_BUSY)
+	{
+		hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+
+		return HAL_ERROR;
+	}
+
+	hdma->Instance->CR &= ~(DMA_SxCR_EN | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE | DMA_SxCR_HTIE);
+	sim_dma(hdma)->tcif = 0;
+	hdma->State = HAL_DMA_STATE_READY;
+	hdma->Lock = HAL_UNLOCKED;
+
+	return HAL_OK;
+}
+
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+	Sim_Dma_t *d = sim_dma(hdma);
+
+	if(d->tcif && (hdma->Instance->CR & DMA_SxCR_TCIE))
+	{
+		d->tcif = 0;
+
+		if(!(hdma->Instance->CR & DMA_SxCR_CIRC))
+		{
+			hdma->Instance->CR &= ~DMA_SxCR_TCIE;
+			hdma->State = HAL_DMA_STATE_READY;
+			hdma->Lock = HAL_UNLOCKED;
+		}
+
+		if(hdma->XferCpltCallback != NULL)
+		{
+			hdma->XferCpltCallback(hdma);
+		}
+	}
+}
+
+
+/**************************** UART ****************************/
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	uint8_t apb2;
+	uint32_t brr, bits;
+
+	if(huart == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	sim_sync();
+
+	if(huart->gState == HAL_UART_STATE_RESET)
+	{
+		huart->Lock = HAL_UNLOCKED;
+		HAL_UART_MspInit(huart);
+	}
+
+	apb2 = (uintptr_t)huart->Instance >= APB2PERIPH_BASE;
+	brr = UART_BRR_SAMPLING16(sim_pclk(apb2), huart->Init.BaudRate);
+	bits = 10 + ((huart->Init.WordLength == UART_WORDLENGTH_9B) ? 1 : 0) + ((huart->Init.StopBits == UART_STOPBITS_2) ? 1 : 0);
+	huart->Instance->BRR = brr;
+	huart->Instance->CR1 = huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode | huart->Init.OverSampling | USART_CR1_UE;
+	huart->Instance->SR = USART_SR_TXE | USART_SR_TC;
+	sim.uart = huart;
+	sim.uart_char_ps = (uint64_t)bits * brr * 1000000000000ULL / sim_pclk(apb2);
+	sim.uart_end = SIM_NEVER;
+	huart->ErrorCode = HAL_UART_ERROR_NONE;
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	Sim_Io_t *io = sim.io;
+
+	(void)Timeout;
+	sim_sync();
+
+	if(huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	if(pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	huart->Instance->SR &= ~USART_SR_TC;
+	io->host->uart_tx(io, io->now, pData, Size, sim.uart_char_ps);
+	sim_wait(io->now + Size * sim.uart_char_ps / 1000);
+	huart->Instance->SR |= USART_SR_TC;
+	huart->TxXferCount = 0;
+	huart->gState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	Sim_Io_t *io = sim.io;
+
+	sim_sync();
+
+	if(huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	if(pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	huart->pTxBuffPtr = pData;
+	huart->TxXferSize = Size;
+	huart->TxXferCount = Size;
+	huart->ErrorCode = HAL_UART_ERROR_NONE;
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+
+	if(huart->hdmatx != NULL)
+	{
+		huart->hdmatx->State = HAL_DMA_STATE_BUSY;
+	}
+
+	huart->Instance->SR &= ~USART_SR_TC;
+	huart->Instance->CR3 |= USART_CR3_DMAT;
+	io->host->uart_tx(io, io->now, pData, Size, sim.uart_char_ps);
+	sim.uart_end = io->now + Size * sim.uart_char_ps / 1000;
+
+	return HAL_OK;
+}
+
+
+/**
+  * @brief  Last byte of a DMA transfer out of the shift register: the DMA stream is done
+  * 		and TC raises the USART interrupt
+  */
+
+static void sim_uart_end(void)
+{
+	UART_HandleTypeDef *huart = sim.uart;
+
+	sim.uart_end = SIM_NEVER;
+	huart->TxXferCount = 0;
+	huart->Instance->CR3 &= ~USART_CR3_DMAT;
+	huart->Instance->CR1 |= USART_CR1_TCIE;
+	huart->Instance->SR |= USART_SR_TC;
+
+	if(huart->hdmatx != NULL)
+	{
+		huart->hdmatx->State = HAL_DMA_STATE_READY;
+		huart->hdmatx->Lock = HAL_UNLOCKED;
+	}
+}
+
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if(huart->RxState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	if(pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	huart->pRxBuffPtr = pData;
+	huart->RxXferSize = Size;
+	huart->RxXferCount = Size;
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	huart->Instance->CR1 |= USART_CR1_RXNEIE | USART_CR1_PEIE;
+	huart->Instance->CR3 |= USART_CR3_EIE;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if(huart->RxState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	if(pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	huart->pRxBuffPtr = pData;
+	huart->RxXferSize = Size;
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+	if(huart->hdmarx != NULL)
+	{
+		HAL_DMA_Start_IT(huart->hdmarx, (uint32_t)(uintptr_t)&huart->Instance->DR, (uint32_t)(uintptr_t)pData, Size);
+	}
+
+	huart->Instance->CR1 |= USART_CR1_PEIE;
+	huart->Instance->CR3 |= USART_CR3_EIE | USART_CR3_DMAR;
+
+	return HAL_OK;
+}
+
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
+{
+	if((huart->Instance->SR & USART_SR_TC) && (huart->Instance->CR1 & USART_CR1_TCIE))
+	{
+		huart->Instance->CR1 &= ~USART_CR1_TCIE;
+		huart->gState = HAL_UART_STATE_READY;
+		HAL_UART_TxCpltCallback(huart);
+	}
+}
+
+
+/**************************** RTC ****************************/
+
+static int64_t sim_days(int y, int m, int d)		// Days since 2000-01-01
+{
+	y -= (m <= 2);
+	int64_t era = y / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 730425;
+}
+
+
+static void sim_civil(int64_t days, int *y, int *m, int *d)
+{
+	int64_t z = days + 730425;
+	int64_t era = ((z >= 0) ? z : z - 146096) / 146097;
+	int64_t doe = z - era * 146097;
+	int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int64_t mp = (5 * doy + 2) / 153;
+
+	*d = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*m = (int)((mp < 10) ? mp + 3 : mp - 9);
+	*y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+
+static uint8_t sim_bcd(uint8_t v)
+{
+	return (uint8_t)(((v / 10) << 4) | (v % 10));
+}
+
+
+static uint8_t sim_bin(uint8_t v)
+{
+	return (uint8_t)((v >> 4) * 10 + (v & 0xF));
+}
+
+
+/**
+  * @brief  Calendar seconds now, and the part of the current second gone (0 to 1 << 16)
+  */
+
+static int64_t sim_rtc_seconds(uint32_t *frac)
+{
+	Sim_Rtc_t *rtc = &sim.io->rtc;
+	unsigned __int128 x;
+
+	*frac = 0;
+
+	if(rtc->hz_den == 0)
+	{
+		return rtc->base_sec;
+	}
+
+	x = (unsigned __int128)(sim.io->now - rtc->base_t) * rtc->hz_num * 65536 / ((unsigned __int128)rtc->hz_den * SIM_S);
+	*frac = (uint32_t)(x & 0xFFFF);
+
+	return rtc->base_sec + (int64_t)(x >> 16);
+}
+
+
+static void sim_rtc_set(int64_t sec)
+{
+	sim.io->rtc.base_sec = sec;
+	sim.io->rtc.base_t = sim.io->now;
+}
+
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc)
+{
+	Sim_Rtc_t *rtc = &sim.io->rtc;
+	uint64_t den;
+	uint32_t frac;
+
+	if(hrtc == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	sim_sync();
+
+	if(hrtc->State == HAL_RTC_STATE_RESET)
+	{
+		hrtc->Lock = HAL_UNLOCKED;
+		HAL_RTC_MspInit(hrtc);
+	}
+
+	hrtc->State = HAL_RTC_STATE_BUSY;
+	hrtc->Instance->CR = (hrtc->Instance->CR & ~RTC_CR_FMT) | hrtc->Init.HourFormat | hrtc->Init.OutPut | hrtc->Init.OutPutPolarity;
+	hrtc->Instance->PRER = (hrtc->Init.AsynchPrediv << 16) | hrtc->Init.SynchPrediv;
+	den = (uint64_t)(hrtc->Init.AsynchPrediv + 1) * (hrtc->Init.SynchPrediv + 1);
+
+	if(rtc->hz_num != sim.rtc_src || rtc->hz_den != den)		// New clock: the calendar goes on from now
+	{
+		sim_rtc_set(sim_rtc_seconds(&frac));
+		rtc->hz_num = sim.rtc_src;
+		rtc->hz_den = den;
+	}
+
+	hrtc->State = HAL_RTC_STATE_READY;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	uint32_t frac;
+	int64_t day = sim_rtc_seconds(&frac) / 86400;
+	uint8_t h = (Format == RTC_FORMAT_BIN) ? sTime->Hours : sim_bin(sTime->Hours);
+	uint8_t m = (Format == RTC_FORMAT_BIN) ? sTime->Minutes : sim_bin(sTime->Minutes);
+	uint8_t s = (Format == RTC_FORMAT_BIN) ? sTime->Seconds : sim_bin(sTime->Seconds);
+
+	sim_sync();
+
+	if(hrtc->Instance->CR & RTC_CR_FMT)
+	{
+		h = (h % 12) + ((sTime->TimeFormat == RTC_HOURFORMAT12_PM) ? 12 : 0);
+	}
+
+	sim_rtc_set(day * 86400 + h * 3600 + m * 60 + s);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	uint32_t frac;
+	int64_t tod = sim_rtc_seconds(&frac) % 86400;
+	uint8_t y = sDate->Year, m = sDate->Month, d = sDate->Date;
+
+	sim_sync();
+
+	if(Format == RTC_FORMAT_BIN)
+	{
+		m = (m & 0x10) ? (m & ~0x10) + 10 : m;
+	}else
+	{
+		y = sim_bin(y);
+		m = sim_bin(m);
+		d = sim_bin(d);
+	}
+
+	sim_rtc_set(sim_days(2000 + y, m, d) * 86400 + tod);
+	sim.io->rtc.inits = (y != 0);
+	hrtc->Instance->ISR = (sim.io->rtc.inits) ? (hrtc->Instance->ISR | RTC_ISR_INITS) : (hrtc->Instance->ISR & ~RTC_ISR_INITS);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	uint32_t frac;
+	int64_t tod = sim_rtc_seconds(&frac) % 86400;
+	uint8_t h = (uint8_t)(tod / 3600);
+	uint32_t synch = hrtc->Instance->PRER & 0x7FFF;
+
+	sim_sync();
+	sTime->TimeFormat = 0;
+
+	if(hrtc->Instance->CR & RTC_CR_FMT)
+	{
+		sTime->TimeFormat = (h >= 12) ? RTC_HOURFORMAT12_PM : RTC_HOURFORMAT12_AM;
+		h = (h % 12 == 0) ? 12 : h % 12;
+	}
+
+	sTime->Hours = h;
+	sTime->Minutes = (uint8_t)(tod / 60 % 60);
+	sTime->Seconds = (uint8_t)(tod % 60);
+	sTime->SubSeconds = synch - (uint32_t)(((uint64_t)frac * (synch + 1)) >> 16);
+	sTime->SecondFraction = synch;
+
+	if(Format != RTC_FORMAT_BIN)
+	{
+		sTime->Hours = sim_bcd(sTime->Hours);
+		sTime->Minutes = sim_bcd(sTime->Minutes);
+		sTime->Seconds = sim_bcd(sTime->Seconds);
+	}
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	uint32_t frac;
+	int64_t day = sim_rtc_seconds(&frac) / 86400;
+	int y, m, d;
+
+	(void)hrtc;
+	sim_civil(day, &y, &m, &d);
+	sDate->Year = (uint8_t)(y % 100);
+	sDate->Month = (uint8_t)m;
+	sDate->Date = (uint8_t)d;
+	sDate->WeekDay = (uint8_t)((day + 5) % 7 + 1);		// 2000-01-01 was a Saturday
+
+	if(Format != RTC_FORMAT_BIN)
+	{
+		sDate->Year = sim_bcd(sDate->Year);
+		sDate->Month = sim_bcd(sDate->Month);
+		sDate->Date = sim_bcd(sDate->Date);
+	}
+
+	return HAL_OK;
+}
+
+
+/**************************** bxCAN ****************************/
+
+static Sim_Can_t *sim_can(const CAN_HandleTypeDef *hcan)
+{
+	return &sim.io->can[(hcan->Instance == CAN2) ? 1 : 0];
+}
+
+
+static uint8_t sim_can_ready(CAN_HandleTypeDef *hcan)
+{
+	if(hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING)
+	{
+		return 1;
+	}
+
+	hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+
+	return 0;
+}
+
+
+static void sim_can_kick(const CAN_HandleTypeDef *hcan)
+{
+	sim.io->host->can_kick(sim.io, sim.io->now, (hcan->Instance == CAN2) ? 1 : 0);
+}
+
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan)
+{
+	Sim_Can_t *c;
+	uint32_t bs1, bs2;
+
+	if(hcan == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	sim_sync();
+
+	if(hcan->State == HAL_CAN_STATE_RESET)
+	{
+		HAL_CAN_MspInit(hcan);
+	}
+
+	c = sim_can(hcan);
+	bs1 = ((hcan->Init.TimeSeg1 >> CAN_BTR_TS1_Pos) & 0xF) + 1;
+	bs2 = ((hcan->Init.TimeSeg2 >> CAN_BTR_TS2_Pos) & 0x7) + 1;
+	hcan->Instance->BTR = hcan->Init.Mode | hcan->Init.SyncJumpWidth | hcan->Init.TimeSeg1 | hcan->Init.TimeSeg2 | (hcan->Init.Prescaler - 1);
+	c->mode = SIM_CAN_INIT;
+	c->silent = (hcan->Init.Mode & CAN_BTR_SILM) != 0;
+	c->loopback = (hcan->Init.Mode & CAN_BTR_LBKM) != 0;
+	c->ttcm = (hcan->Init.TimeTriggeredMode == ENABLE);
+	c->abom = (hcan->Init.AutoBusOff == ENABLE);
+	c->nart = (hcan->Init.AutoRetransmission != ENABLE);
+	c->rflm = (hcan->Init.ReceiveFifoLocked == ENABLE);
+	c->txfp = (hcan->Init.TransmitFifoPriority == ENABLE);
+	c->bit_ns = (uint32_t)(((uint64_t)hcan->Init.Prescaler * (1 + bs1 + bs2) * SIM_S + sim_pclk(0) / 2) / sim_pclk(0));
+	hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+	hcan->State = HAL_CAN_STATE_READY;
+	sim_can_kick(hcan);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig)
+{
+	Sim_Filters_t *f = &sim.io->filters;
+	uint32_t bank = sFilterConfig->FilterBank;
+	uint32_t bit = 1U << (bank & 0x1F);
+
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	// Banks are shared by both controllers, in CAN1's registers
+	f->fmr = (f->fmr & ~CAN_FMR_CAN2SB) | (sFilterConfig->SlaveStartFilterBank << CAN_FMR_CAN2SB_Pos);
+	f->fa1r &= ~bit;
+
+	if(sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT)
+	{
+		f->fs1r &= ~bit;
+		f->fr[bank][0] = ((0xFFFF & sFilterConfig->FilterMaskIdLow) << 16) | (0xFFFF & sFilterConfig->FilterIdLow);
+		f->fr[bank][1] = ((0xFFFF & sFilterConfig->FilterMaskIdHigh) << 16) | (0xFFFF & sFilterConfig->FilterIdHigh);
+	}else
+	{
+		f->fs1r |= bit;
+		f->fr[bank][0] = ((0xFFFF & sFilterConfig->FilterIdHigh) << 16) | (0xFFFF & sFilterConfig->FilterIdLow);
+		f->fr[bank][1] = ((0xFFFF & sFilterConfig->FilterMaskIdHigh) << 16) | (0xFFFF & sFilterConfig->FilterMaskIdLow);
+	}
+
+	f->fm1r = (sFilterConfig->FilterMode == CAN_FILTERMODE_IDMASK) ? (f->fm1r & ~bit) : (f->fm1r | bit);
+	f->ffa1r = (sFilterConfig->FilterFIFOAssignment == CAN_RX_FIFO0) ? (f->ffa1r & ~bit) : (f->ffa1r | bit);
+	f->fa1r |= (sFilterConfig->FilterActivation == ENABLE) ? bit : 0;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan)
+{
+	Sim_Can_t *c = sim_can(hcan);
+
+	sim_sync();
+
+	if(hcan->State != HAL_CAN_STATE_READY)
+	{
+		hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+
+		return HAL_ERROR;
+	}
+
+	hcan->State = HAL_CAN_STATE_LISTENING;
+	hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+	c->mode = SIM_CAN_NORMAL;
+	c->ttcm_t0 = sim.io->now;
+
+	if(c->boff && c->recover_at == SIM_NEVER)		// Leaving Init starts the recovery: 128 x 11 recessive bits
+	{
+		c->recover_at = sim.io->now + 128ULL * 11 * c->bit_ns;
+	}
+
+	sim_can_kick(hcan);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan)
+{
+	sim_sync();
+
+	if(hcan->State != HAL_CAN_STATE_LISTENING)
+	{
+		hcan->ErrorCode |= HAL_CAN_ERROR_NOT_STARTED;
+
+		return HAL_ERROR;
+	}
+
+	sim_can(hcan)->mode = SIM_CAN_INIT;
+	hcan->State = HAL_CAN_STATE_READY;
+	sim_can_kick(hcan);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs)
+{
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	sim_can(hcan)->ier |= ActiveITs;
+	hcan->Instance->IER = sim_can(hcan)->ier;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[], uint32_t *pTxMailbox)
+{
+	Sim_Can_t *c = sim_can(hcan);
+	Sim_Mailbox_t *mb;
+	uint8_t m;
+
+	sim_sync();
+
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	for(m = 0; m < 3 && c->mb[m].pending; m++);
+
+	if(m == 3)
+	{
+		hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+
+		return HAL_ERROR;
+	}
+
+	mb = &c->mb[m];
+	memset(&mb->frame, 0, sizeof(mb->frame));		// Unsent bytes stay 0: the same frames give the same runs
+	mb->frame.ext = (pHeader->IDE == CAN_ID_EXT);
+	mb->frame.id = (mb->frame.ext) ? (pHeader->ExtId & 0x1FFFFFFF) : (pHeader->StdId & 0x7FF);
+	mb->frame.rtr = (pHeader->RTR == CAN_RTR_REMOTE);
+	mb->frame.dlc = pHeader->DLC & 0xF;
+
+	for(uint8_t i = 0; !mb->frame.rtr && i < mb->frame.dlc && i < 8; i++)
+	{
+		mb->frame.data[i] = aData[i];
+	}
+
+	mb->pending = 1;
+	mb->on_bus = 0;
+	mb->abort = 0;
+	mb->seq = ++c->seq;
+	hcan->Instance->sTxMailBox[m].TIR = (mb->frame.ext) ? (mb->frame.id << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE \
+										: (mb->frame.id << CAN_TI0R_STID_Pos);		// Read back by the Tx complete callbacks
+	c->tsr &= ~(0xFU << (8 * m));
+	*pTxMailbox = 1U << m;
+	sim_can_kick(hcan);
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes)
+{
+	Sim_Can_t *c = sim_can(hcan);
+
+	sim_sync();
+
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	for(uint8_t m = 0; m < 3; m++)
+	{
+		if(!(TxMailboxes & (1U << m)) || !c->mb[m].pending)
+		{
+			continue;
+		}
+
+		if(c->mb[m].on_bus)			// Ends with the frame: done if it goes through, aborted otherwise
+		{
+			c->mb[m].abort = 1;
+		}else
+		{
+			c->mb[m].pending = 0;
+			c->tsr = (c->tsr & ~(0xFU << (8 * m))) | (CAN_TSR_RQCP0 << (8 * m));
+		}
+	}
+
+	sim_can_kick(hcan);
+
+	return HAL_OK;
+}
+
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan)
+{
+	Sim_Can_t *c = sim_can(hcan);
+
+	return (hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING) ? \
+			(uint32_t)(!c->mb[0].pending + !c->mb[1].pending + !c->mb[2].pending) : 0;
+}
+
+
+uint32_t HAL_CAN_GetTxTimestamp(CAN_HandleTypeDef *hcan, uint32_t TxMailbox)
+{
+	uint8_t m = (TxMailbox & CAN_TX_MAILBOX0) ? 0 : ((TxMailbox & CAN_TX_MAILBOX1) ? 1 : 2);
+
+	return (hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING) ? sim_can(hcan)->mb[m].time : 0;
+}
+
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef *hcan, uint32_t RxFifo)
+{
+	return (hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING) ? sim_can(hcan)->rx_fill[RxFifo & 1] : 0;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader, uint8_t aData[])
+{
+	Sim_Can_t *c = sim_can(hcan);
+	uint8_t fifo = RxFifo & 1;
+	uint8_t i;
+	const Can_Bits_Frame_t *f;
+
+	sim_sync();
+
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	if(c->rx_fill[fifo] == 0)
+	{
+		hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+
+		return HAL_ERROR;
+	}
+
+	i = c->rx_head[fifo];
+	f = &c->rx[fifo][i];
+	pHeader->IDE = (f->ext) ? CAN_ID_EXT : CAN_ID_STD;
+
+	if(f->ext)
+	{
+		pHeader->ExtId = f->id;
+	}else
+	{
+		pHeader->StdId = f->id;
+	}
+
+	pHeader->RTR = (f->rtr) ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+	pHeader->DLC = f->dlc;
+	pHeader->FilterMatchIndex = c->rx_fmi[fifo][i];
+	pHeader->Timestamp = c->rx_time[fifo][i];
+	memcpy(aData, f->data, 8);
+	c->rx_head[fifo] = (i + 1) % 3;
+	c->rx_fill[fifo]--;
+
+	return HAL_OK;
+}
+
+
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *hcan)
+{
+	return hcan->ErrorCode;
+}
+
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan)
+{
+	if(!sim_can_ready(hcan))
+	{
+		return HAL_ERROR;
+	}
+
+	hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+
+	return HAL_OK;
+}
+
+
+/**
+  * @brief  Same order as the HAL: Tx mailboxes, then each FIFO (overrun, full, pending),
+  * 		then the error interrupt, and the error callback last with the codes gathered
+  */
+
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan)
+{
+	static void (* const complete[3])(CAN_HandleTypeDef *) = {HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback, HAL_CAN_TxMailbox2CompleteCallback};
+	static void (* const aborted[3])(CAN_HandleTypeDef *) = {HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback, HAL_CAN_TxMailbox2AbortCallback};
+	static void (* const full[2])(CAN_HandleTypeDef *) = {HAL_CAN_RxFifo0FullCallback, HAL_CAN_RxFifo1FullCallback};
+	static void (* const pending[2])(CAN_HandleTypeDef *) = {HAL_CAN_RxFifo0MsgPendingCallback, HAL_CAN_RxFifo1MsgPendingCallback};
+	static const uint32_t lec_code[8] = {0, HAL_CAN_ERROR_STF, HAL_CAN_ERROR_FOR, HAL_CAN_ERROR_ACK, HAL_CAN_ERROR_BR, HAL_CAN_ERROR_BD, HAL_CAN_ERROR_CRC, 0};
+	Sim_Can_t *c = sim_can(hcan);
+	uint32_t errorcode = HAL_CAN_ERROR_NONE;
+	uint32_t ier = c->ier, tsr = c->tsr, esr;
+
+	sim_sync();
+	esr = hcan->Instance->ESR;
+
+	if(ier & CAN_IT_TX_MAILBOX_EMPTY)
+	{
+		for(uint8_t m = 0; m < 3; m++)
+		{
+			if(!(tsr & (CAN_TSR_RQCP0 << (8 * m))))
+			{
+				continue;
+			}
+
+			c->tsr &= ~(0xFU << (8 * m));
+
+			if(tsr & (CAN_TSR_TXOK0 << (8 * m)))
+			{
+				complete[m](hcan);
+			}else if(tsr & (CAN_TSR_ALST0 << (8 * m)))
+			{
+				errorcode |= HAL_CAN_ERROR_TX_ALST0 << (2 * m);
+			}else if(tsr & (CAN_TSR_TERR0 << (8 * m)))
+			{
+				errorcode |= HAL_CAN_ERROR_TX_TERR0 << (2 * m);
+			}else
+			{
+				aborted[m](hcan);
+			}
+		}
+	}
+
+	for(uint8_t f = 0; f < 2; f++)
+	{
+		if((ier & (CAN_IT_RX_FIFO0_OVERRUN << (3 * f))) && c->rx_fovr[f])
+		{
+			errorcode |= HAL_CAN_ERROR_RX_FOV0 << f;
+			c->rx_fovr[f] = 0;
+		}
+
+		if((ier & (CAN_IT_RX_FIFO0_FULL << (3 * f))) && c->rx_full[f])
+		{
+			c->rx_full[f] = 0;
+			full[f](hcan);
+		}
+
+		if((ier & (CAN_IT_RX_FIFO0_MSG_PENDING << (3 * f))) && c->rx_fill[f])
+		{
+			pending[f](hcan);
+		}
+	}
+
+	if((ier & CAN_IT_ERROR) && c->erri)
+	{
+		errorcode |= ((ier & CAN_IT_ERROR_WARNING) && (esr & CAN_ESR_EWGF)) ? HAL_CAN_ERROR_EWG : 0;
+		errorcode |= ((ier & CAN_IT_ERROR_PASSIVE) && (esr & CAN_ESR_EPVF)) ? HAL_CAN_ERROR_EPV : 0;
+		errorcode |= ((ier & CAN_IT_BUSOFF) && (esr & CAN_ESR_BOFF)) ? HAL_CAN_ERROR_BOF : 0;
+
+		if((ier & CAN_IT_LAST_ERROR_CODE) && c->lec != 0)
+		{
+			errorcode |= lec_code[c->lec & 7];
+			c->lec = 0;
+		}
+
+		c->erri = 0;
+	}
+
+	if(errorcode != HAL_CAN_ERROR_NONE)
+	{
+		hcan->ErrorCode |= errorcode;
+		HAL_CAN_ErrorCallback(hcan);
+	}
+
+	sim_sync();
+}
+
+
+/**************************** Interrupt lines ****************************/
+
+static uint8_t sim_level_can_tx(uint8_t ctrl)
+{
+	const Sim_Can_t *c = &sim.io->can[ctrl];
+
+	return (c->ier & CAN_IER_TMEIE) && (c->tsr & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2));
+}
+
+
+static uint8_t sim_level_can_rx(uint8_t ctrl_fifo)
+{
+	const Sim_Can_t *c = &sim.io->can[ctrl_fifo >> 4];
+	uint8_t f = ctrl_fifo & 1;
+
+	return ((c->ier & (CAN_IER_FMPIE0 << (3 * f))) && c->rx_fill[f]) || ((c->ier & (CAN_IER_FFIE0 << (3 * f))) && c->rx_full[f]) \
+			|| ((c->ier & (CAN_IER_FOVIE0 << (3 * f))) && c->rx_fovr[f]);
+}
+
+
+static uint8_t sim_level_can_sce(uint8_t ctrl)
+{
+	const Sim_Can_t *c = &sim.io->can[ctrl];
+
+	return (c->ier & CAN_IER_ERRIE) && c->erri;
+}
+
+
+static uint8_t sim_level_exti(uint8_t first)
+{
+	uint16_t group = (first < 5) ? (1U << first) : (first == 5) ? 0x03E0 : 0xFC00;
+
+	return (sim.io->exti_pr & sim.io->exti_imr & group) != 0;
+}
+
+
+static uint8_t sim_level_dma(uint8_t stream)
+{
+	DMA_Stream_TypeDef *s = (DMA_Stream_TypeDef *)(((stream >> 4) == 1 ? DMA1_BASE : DMA2_BASE) + 0x10 + 0x18 * (stream & 0xF));
+
+	for(uint8_t i = 0; i < SIM_DMAS; i++)
+	{
+		if(sim.dmas[i].h != NULL && sim.dmas[i].h->Instance == s)
+		{
+			return sim.dmas[i].tcif && (s->CR & DMA_SxCR_TCIE);
+		}
+	}
+
+	return 0;
+}
+
+
+static uint8_t sim_level_usart2(uint8_t unused)
+{
+	uint32_t sr = USART2->SR, cr1 = USART2->CR1;
+
+	(void)unused;
+
+	return ((sr & USART_SR_TC) && (cr1 & USART_CR1_TCIE)) || ((sr & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE)) \
+			|| ((sr & USART_SR_RXNE) && (cr1 & USART_CR1_RXNEIE));
+}
+
+
+static uint8_t sim_level_tim6(uint8_t unused)
+{
+	(void)unused;
+
+	return (TIM6->SR & TIM_SR_UIF) && (TIM6->DIER & TIM_DIER_UIE);
+}
+
+
+/**
+  * @brief  Returns the lowest enabled line that is pending
+  * @param  None
+  * @retval Line, NULL if none
+  */
+
+static const Sim_Line_t *sim_pending(void)
+{
+	for(uint8_t i = 0; i < sim.n_enabled; i++)
+	{
+		const Sim_Line_t *line = sim.enabled[i];
+
+		if(line->level(line->arg))
+		{
+			return line;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Runs the handler of a line to completion. A line with no handler would end in
+  * 		the default handler's endless loop
+  */
+
+static void sim_dispatch(const Sim_Line_t *line)
+{
+	Sim_Io_t *io = sim.io;
+
+	if(io->now != sim.storm_t)
+	{
+		sim.storm_t = io->now;
+		sim.storm = 0;
+	}
+
+	if(line->handler == NULL || ++sim.storm > SIM_STORM_MAX)
+	{
+		sim_stop(SIM_HUNG);
+	}
+
+	sim.in_handler = 1;
+	sim.handler_start = io->now;
+	io->irqs++;
+	line->handler();
+	sim.in_handler = 0;
+	sim_timer_reload();
+	sim_sync();
+
+	if(sim.thread_state == SIM_THREAD_WFI || (sim.thread_state == SIM_THREAD_SLEEP && !(SCB->SCR & SCB_SCR_SLEEPONEXIT_Msk)))
+	{
+		sim.thread_state = SIM_THREAD_RUN;		// Sleep on exit cleared by the handler: back to the thread
+	}
+}
+
+
+/**************************** Scheduler ****************************/
+
+static uint8_t sim_thread_ready(void)
+{
+	return sim.thread_state == SIM_THREAD_RUN || (sim.thread_state == SIM_THREAD_WAIT && sim.wake <= sim.io->now);
+}
+
+
+/**
+  * @brief  Returns the earliest local event: timer update, end of a UART transfer, end of
+  * 		a wait of the thread
+  */
+
+static uint64_t sim_local_next(void)
+{
+	uint64_t t = sim.uart_end;
+
+	for(uint8_t i = 0; i < SIM_TIMERS && sim.timers[i].h != NULL; i++)
+	{
+		t = (sim.timers[i].at < t) ? sim.timers[i].at : t;
+	}
+
+	if(sim.thread_state == SIM_THREAD_WAIT && sim.wake < t)
+	{
+		t = sim.wake;
+	}
+
+	return t;
+}
+
+
+/**
+  * @brief  Handles the local events due at the board's time
+  */
+
+static void sim_fire(void)
+{
+	uint64_t now = sim.io->now;
+
+	for(uint8_t i = 0; i < SIM_TIMERS && sim.timers[i].h != NULL; i++)
+	{
+		while(sim.timers[i].at <= now)
+		{
+			sim_timer_fire(&sim.timers[i]);
+		}
+	}
+
+	if(sim.uart_end <= now)
+	{
+		sim_uart_end();
+	}
+
+	if(sim.thread_state == SIM_THREAD_WAIT && sim.wake <= now)
+	{
+		sim.thread_state = SIM_THREAD_RUN;
+	}
+}
+
+
+static void sim_thread(void)
+{
+	main();
+	sim.thread_state = SIM_THREAD_DONE;
+}
+
+
+/**
+  * @brief  Resets the board: registers out of the backup domain cleared, main() ready to
+  * 		start at t
+  * @param  io the board
+  * @param  t virtual time of the reset
+  * @param  flags SIM_BOOT_xxx
+  * @retval None
+  */
+
+static void sim_boot(Sim_Io_t *io, uint64_t t, uint32_t flags)
+{
+	uint32_t bdcr = RCC->BDCR;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.io = io;
+	sim.dead = SIM_IDLE;
+	sim.rand_next = 1;
+	sim.sysclk = HSI_VALUE;
+	sim.ahb_div = sim.apb1_div = sim.apb2_div = 1;
+	sim.uart_end = SIM_NEVER;
+	sim.storm_t = SIM_NEVER;
+	sim.tick_t0 = t;
+
+	if(flags & SIM_BOOT_COLD)
+	{
+		memset(&io->rtc, 0, sizeof(io->rtc));
+		io->pwr_csr = 0;
+		bdcr = 0;
+	}
+
+	// Peripheral registers: the RTC and backup SRAM are in the backup domain
+	memset((void *)SIM_PERIPH_BASE, 0, SIM_RTC_REGS - SIM_PERIPH_BASE);
+	memset((void *)(SIM_RTC_REGS + SIM_RTC_SIZE), 0, BKPSRAM_BASE - (SIM_RTC_REGS + SIM_RTC_SIZE));
+	memset((void *)(BKPSRAM_BASE + 0x1000), 0, SIM_PERIPH_BASE + SIM_PERIPH_SIZE - (BKPSRAM_BASE + 0x1000));
+	memset((void *)SIM_CORE_BASE, 0, SIM_CORE_SIZE);
+
+	if(flags & (SIM_BOOT_COLD | SIM_BOOT_BKPSRAM_LOST))
+	{
+		memset((void *)BKPSRAM_BASE, 0, 0x1000);
+	}
+
+	if(flags & SIM_BOOT_COLD)
+	{
+		memset((void *)SIM_RTC_REGS, 0, SIM_RTC_SIZE);
+	}
+
+	RCC->BDCR = bdcr;
+	PWR->CSR = io->pwr_csr & SIM_PWR_KEPT;
+	RTC->ISR = 0x7 | ((io->rtc.inits) ? RTC_ISR_INITS : 0);
+	USART2->SR = USART_SR_TXE | USART_SR_TC;
+	CAN1->FMR = 0x2A1C0E01;
+
+	// Board side of the io
+	io->now = t;
+	io->next = t;
+	io->yield = 0;
+	io->exti_pr = 0;
+	io->exti_imr = io->exti_rtsr = io->exti_ftsr = 0;
+	memset(io->exti_port, 0, sizeof(io->exti_port));
+	memset(io->odr, 0, sizeof(io->odr));
+	memset(io->out, 0, sizeof(io->out));
+	memset(&io->filters, 0, sizeof(io->filters));
+	io->filters.fmr = 14 << CAN_FMR_CAN2SB_Pos;
+	io->irq_at = SIM_NEVER;
+	io->wuf_event = 0;
+	io->pwr_csr = PWR->CSR;
+
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		memset(&io->can[i], 0, sizeof(io->can[i]));
+		io->can[i].mode = SIM_CAN_SLEEP;
+		io->can[i].recover_at = SIM_NEVER;
+	}
+
+	getcontext(&sim.thread);
+	sim.thread.uc_stack.ss_sp = sim_stack;
+	sim.thread.uc_stack.ss_size = sizeof(sim_stack);
+	sim.thread.uc_link = &sim.sched;
+	makecontext(&sim.thread, sim_thread, 0);
+	sim.thread_state = SIM_THREAD_RUN;
+}
+
+
+/**
+  * @brief  Handles the board's events before until: pending lines first, then the thread,
+  * 		then time moves on to the next local event. Stops early when an output needs the
+  * 		simulation (io->yield) or when a handler waits past until
+  * @param  until horizon, exclusive
+  * @retval SIM_xxx
+  */
+
+static int sim_run(uint64_t until)
+{
+	Sim_Io_t *io = sim.io;
+	int r;
+
+	if(sim.dead != SIM_IDLE)
+	{
+		return sim.dead;
+	}
+
+	sim.until = until;
+	r = sigsetjmp(sim.jmp, 1);
+
+	if(r == SIM_ESCAPE && !sim.in_handler && sim.thread_state == SIM_THREAD_RUN)
+	{
+		sim.thread_state = SIM_THREAD_SPIN;		// main() loops for good, handlers still run
+	}else if(r != 0)
+	{
+		sim.in_handler = 0;
+		sim.dead = (r == SIM_ESCAPE) ? SIM_HUNG : r;
+		io->next = SIM_NEVER;
+
+		return sim.dead;
+	}
+
+	io->yield = 0;
+
+	while(io->now < until && !io->yield)
+	{
+		const Sim_Line_t *line;
+		uint64_t t;
+
+		if(io->irq_at != SIM_NEVER && io->irq_at <= sim_local_next())
+		{
+			io->now = (io->irq_at > io->now) ? io->irq_at : io->now;
+			io->irq_at = SIM_NEVER;
+		}
+
+		sim_sync();
+		line = sim_pending();
+
+		if(line != NULL)
+		{
+			sim_dispatch(line);
+		}else if(sim_thread_ready())
+		{
+			sim.thread_state = SIM_THREAD_RUN;
+			swapcontext(&sim.sched, &sim.thread);
+		}else
+		{
+			t = sim_local_next();
+			t = (io->irq_at < t) ? io->irq_at : t;
+
+			if(t >= until)
+			{
+				break;
+			}
+
+			io->now = (t > io->now) ? t : io->now;
+			sim_fire();
+		}
+
+		io->progress++;
+	}
+
+	if(sim_pending() != NULL || sim_thread_ready())
+	{
+		io->next = io->now;
+	}else
+	{
+		uint64_t t = sim_local_next();
+
+		t = (io->irq_at < t) ? io->irq_at : t;
+		io->next = (t < io->now) ? io->now : t;
+	}
+
+	return (io->yield) ? SIM_YIELD : SIM_IDLE;
+}
+
+
+static void sim_escape(void)
+{
+	sim_stop(SIM_ESCAPE);
+}
+
+
+SIM_EXPORT const Sim_Board_t sim_board = {SIM_API_VERSION, sim_boot, sim_run, sim_escape};
+
+
+/**************************** C library ****************************/
+
+// newlib's generator, so the boards draw the same numbers as on target
+void srand(unsigned int seed)
+{
+	sim.rand_next = seed;
+}
+
+
+int rand(void)
+{
+	sim.rand_next = sim.rand_next * 6364136223846793005ULL + 1;
+
+	return (int)((sim.rand_next >> 32) & 0x7FFFFFFF);
+}
+
+
+time_t time(time_t *t)		// No clock on target
+{
+	if(t != NULL)
+	{
+		*t = (time_t)-1;
+	}
+
+	return (time_t)-1;
+}
+
+
+/**************************** Default callbacks and MSP ****************************/
+
+__weak void HAL_MspInit(void) {}
+__weak void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim) { (void)htim; }
+__weak void HAL_UART_MspInit(UART_HandleTypeDef *huart) { (void)huart; }
+__weak void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_RTC_MspInit(RTC_HandleTypeDef *hrtc) { (void)hrtc; }
+__weak void HAL_SYSTICK_Callback(void) {}
+__weak void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) { (void)GPIO_Pin; }
+__weak void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) { (void)htim; }
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) { (void)huart; }
+__weak void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
@@ -0,0 +1,488 @@
+/**
+  ******************************************************************************
+  * @file    slcan_pty.c
+  * @author  Moe2Code
+  * @brief   PC stand-in for Disc in slcan bridge mode (SLCAN_BRIDGE), built on the board's
+  *          protocol module (slcan.c). Offers a pty for slcand and bridges it to a SocketCAN
+  *          interface (vcan0), so the PC side can be tried without the board:
+  *              ./slcan_pty -i vcan0
+  *              slcand -o -s6 -S1000000 /dev/pts/N slcan0 && ip link set slcan0 up
+  *              cansend slcan0 123#1122 (seen by candump vcan0) and the other way round
+  *          Without -i, the frames the PC sends are printed.
+  *          check: protocol checks (commands, replies, frame lines both ways), then the
+  *          bridge buffers at 100% bus load in virtual time: CAN frames back to back at
+  *          500 kbit/s, lines drained by USART2 at SLCAN_BAUD, for several frame mixes
+  *          Usage: ./slcan_pty [-i interface]
+  *                 ./slcan_pty check
+  * @note    Frame lengths are taken without stuff bits: the shortest frames, hence the most
+  *          lines per second, are the worst case for the UART
+  */
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "slcan.h"
+
+
+// Defines
+#define BUS_RATE			500000		// bit/s of the game bus (S6)
+#define UART_RATE			1000000		// SLCAN_BAUD of main.h
+#define SIM_SECONDS			10.0		// Bus time simulated per frame mix
+#define CODEC_FRAMES		200000
+
+#define MIX_STD				0			// Frame mixes of the load test
+#define MIX_EXT				1
+#define MIX_RANDOM			2
+
+
+// Typedefs
+// Result of a load test
+typedef struct
+{
+	uint64_t frames, dropped;
+	uint32_t max_fill;			// Most bytes waiting in the Tx ring
+	double uart_use;			// Share of the UART time used
+} Load_t;
+
+
+/**
+  * @brief  Feeds a command line to the protocol and collects the replies
+  * @param  s pointer to the protocol state
+  * @param  line command line, CR included
+  * @param  frame receives the frame to send
+  * @param  reply receives the replies (NUL terminated)
+  * @retval Action of the last line
+  */
+
+static uint8_t feed(Slcan_t *s, const char *line, Slcan_Frame_t *frame, char *reply)
+{
+	char r[SLCAN_REPLY_MAX];
+	uint8_t len, action = SLCAN_NONE, a;
+
+	reply[0] = '\0';
+
+	for(; *line != '\0'; line++)
+	{
+		a = Slcan_RxByte(s, (uint8_t)*line, frame, r, &len);
+		action = (len > 0) ? a : action;
+		strncat(reply, r, len);
+	}
+
+	return action;
+}
+
+
+/**
+  * @brief  Returns a random frame
+  * @param  seed pointer to the generator state
+  * @param  mix MIX_xxx
+  * @param  dlc data length, or -1 for a random one
+  * @retval Frame
+  */
+
+static Slcan_Frame_t random_frame(uint32_t *seed, int mix, int dlc)
+{
+	Slcan_Frame_t f = {0};
+
+	*seed = *seed * 1103515245 + 12345;
+	f.ext = (mix == MIX_EXT) || (mix == MIX_RANDOM && (*seed >> 28) < 4);
+	f.id = (*seed >> 3) & ((f.ext) ? 0x1FFFFFFF : 0x7FF);
+	f.rtr = (mix == MIX_RANDOM && (*seed & 7) == 0);
+	f.dlc = (dlc >= 0) ? (uint8_t)dlc : (*seed >> 12) % 9;
+
+	for(int i = 0; i < 8; i++)
+	{
+		*seed = *seed * 1103515245 + 12345;
+		f.data[i] = (f.rtr || i >= f.dlc) ? 0 : (uint8_t)(*seed >> 16);
+	}
+
+	return f;
+}
+
+
+/**
+  * @brief  Returns the length of a frame on the bus without stuff bits, interframe space
+  * 		included: 47 bits plus the data for a standard frame, 67 for an extended one
+  * @param  f pointer to the frame
+  * @retval Bits
+  */
+
+static uint32_t frame_bits(const Slcan_Frame_t *f)
+{
+	return ((f->ext) ? 67 : 47) + ((f->rtr) ? 0 : 8 * f->dlc);
+}
+
+
+/**
+  * @brief  Checks the command set, the replies and the frame lines in both directions
+  * @param  None
+  * @retval Number of failures
+  */
+
+static int check_protocol(void)
+{
+	static const struct
+	{
+		const char *line, *reply;
+		uint8_t action;
+	} steps[] =
+	{
+		{"C\r", "\a", SLCAN_NONE},				// Already closed
+		{"t1230\r", "\a", SLCAN_NONE},			// Bus closed
+		{"S9\r", "\a", SLCAN_NONE},
+		{"S4\r", "\r", SLCAN_BITRATE},
+		{"S6\r", "\r", SLCAN_BITRATE},
+		{"Z1\r", "\r", SLCAN_NONE},
+		{"V\r", "V1013\r", SLCAN_NONE},
+		{"N\r", "NRPS1\r", SLCAN_NONE},
+		{"M00000000\r", "\r", SLCAN_NONE},
+		{"mFFFFFFFF\r", "\r", SLCAN_NONE},
+		{"\n\r", "\r", SLCAN_NONE},				// LF ignored, empty line acknowledged
+		{"L\r", "\r", SLCAN_LISTEN},
+		{"t1230\r", "\a", SLCAN_NONE},			// Listen only
+		{"C\r", "\r", SLCAN_CLOSE},
+		{"O\r", "\r", SLCAN_OPEN},
+		{"O\r", "\a", SLCAN_NONE},
+		{"S4\r", "\a", SLCAN_NONE},				// Bit rate only while closed
+		{"Z0\r", "\a", SLCAN_NONE},
+		{"t1230\r", "z\r", SLCAN_SEND},
+		{"t7FF81122334455667788\r", "z\r", SLCAN_SEND},
+		{"t8000\r", "\a", SLCAN_NONE},			// 11-bit ID out of range
+		{"t1239\r", "\a", SLCAN_NONE},			// DLC out of range
+		{"t123211\r", "\a", SLCAN_NONE},		// Data shorter than the DLC
+		{"t1231112\r", "\a", SLCAN_NONE},		// Longer
+		{"t12311G\r", "\a", SLCAN_NONE},		// Not hex
+		{"T1FFFFFFF1aa\r", "Z\r", SLCAN_SEND},
+		{"T200000000\r", "\a", SLCAN_NONE},		// 29-bit ID out of range
+		{"r1238\r", "z\r", SLCAN_SEND},			// Remote frame: DLC, no data
+		{"R000000018\r", "Z\r", SLCAN_SEND},
+		{"r123811\r", "\a", SLCAN_NONE},
+		{"t1230t1230t1230t1230t1230t1230t1230\r", "\a", SLCAN_NONE},	// Too long
+		{"F\r", "F00\r", SLCAN_NONE},
+		{"X\r", "\a", SLCAN_NONE},
+		{"C\r", "\r", SLCAN_CLOSE},
+	};
+	Slcan_t board, pc;
+	Slcan_Frame_t f, got;
+	char reply[64], line[SLCAN_FRAME_MAX + 1], expect[64];
+	uint32_t seed = 1;
+	uint8_t len;
+	uint32_t refused = 0;
+	int fail = 0;
+
+	Slcan_Init(&board);
+
+	for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+	{
+		uint8_t action = feed(&board, steps[i].line, &got, reply);
+
+		if(action != steps[i].action || strcmp(reply, steps[i].reply) != 0)
+		{
+			fprintf(stderr, "FAIL: %.*s: action %u reply %02X, expected %u %02X\n", (int)strcspn(steps[i].line, "\r"), \
+					steps[i].line, action, (uint8_t)reply[0], steps[i].action, (uint8_t)steps[i].reply[0]);
+			fail++;
+		}
+
+		refused += (steps[i].reply[0] == '\a');
+	}
+
+	fail += (board.refused != refused);
+
+	// Every frame the board forwards must read back the same on the PC side, with and without timestamp
+	Slcan_Init(&pc);
+	feed(&pc, "O\r", &got, reply);
+
+	for(uint32_t i = 0; i < CODEC_FRAMES; i++)
+	{
+		f = random_frame(&seed, MIX_RANDOM, -1);
+		len = Slcan_Encode(&f, 0, 0, line);
+		line[len] = '\0';
+
+		if(feed(&pc, line, &got, reply) != SLCAN_SEND || memcmp(&got, &f, sizeof(f)) != 0)
+		{
+			fprintf(stderr, "FAIL: %s does not read back\n", line);
+			fail++;
+			break;
+		}
+
+		len = Slcan_Encode(&f, 1, i % 60000, line);
+		line[len] = '\0';
+		snprintf(expect, sizeof(expect), "%c%0*X%u", (f.rtr) ? ((f.ext) ? 'R' : 'r') : ((f.ext) ? 'T' : 't'), \
+				 (f.ext) ? 8 : 3, f.id, f.dlc);
+
+		for(int k = 0; !f.rtr && k < f.dlc; k++)
+		{
+			sprintf(expect + strlen(expect), "%02X", f.data[k]);
+		}
+
+		sprintf(expect + strlen(expect), "%04X\r", i % 60000);
+
+		if(strcmp(line, expect) != 0)
+		{
+			fprintf(stderr, "FAIL: %s, expected %s\n", line, expect);
+			fail++;
+			break;
+		}
+	}
+
+	printf("protocol: %zu command steps, %u frames read back: %s\n", sizeof(steps) / sizeof(steps[0]), CODEC_FRAMES, \
+		   fail ? "FAIL" : "ok");
+
+	return fail;
+}
+
+
+/**
+  * @brief  Runs the board-to-PC path at 100% bus load: frames back to back on the bus, each
+  * 		one encoded into the Tx ring as it is received, the ring drained at the UART rate
+  * @param  mix MIX_xxx
+  * @param  dlc data length, or -1 for random ones
+  * @param  timestamps 1 to append timestamps
+  * @retval Result
+  */
+
+static Load_t run_load(int mix, int dlc, uint8_t timestamps)
+{
+	Load_t r = {0};
+	Slcan_Frame_t f;
+	char line[SLCAN_FRAME_MAX];
+	double t = 0, fill = 0, bytes = 0, drain = UART_RATE / 10.0;
+	uint32_t seed = 99;
+
+	while(t < SIM_SECONDS)
+	{
+		f = random_frame(&seed, mix, dlc);
+		t += (double)frame_bits(&f) / BUS_RATE;
+		fill -= (fill < drain * frame_bits(&f) / BUS_RATE) ? fill : drain * frame_bits(&f) / BUS_RATE;
+
+		uint8_t len = Slcan_Encode(&f, timestamps, (uint16_t)((uint64_t)(t * 1000) % 60000), line);
+
+		r.frames++;
+
+		if(fill + len > SLCAN_TX_RING - 1)		// slcan_put(): no room
+		{
+			r.dropped++;
+			continue;
+		}
+
+		fill += len;
+		bytes += len;
+		r.max_fill = (fill > r.max_fill) ? (uint32_t)fill : r.max_fill;
+	}
+
+	r.uart_use = bytes / (drain * t);
+
+	return r;
+}
+
+
+/**
+  * @brief  Checks the bridge buffers at full bus load for several frame mixes
+  * @param  None
+  * @retval Number of failures
+  */
+
+static int check_load(void)
+{
+	static const struct
+	{
+		const char *name;
+		int mix, dlc;
+		uint8_t timestamps, must_hold;	// must_hold: no frame may be dropped
+	} mixes[] =
+	{
+		{"standard, 0 bytes", MIX_STD, 0, 0, 1},
+		{"standard, 8 bytes", MIX_STD, 8, 0, 1},
+		{"standard, random DLC", MIX_STD, -1, 0, 1},
+		{"mixed (1/4 extended, remote)", MIX_RANDOM, -1, 0, 1},
+		{"extended, 6 bytes", MIX_EXT, 6, 0, 1},
+		{"extended, 8 bytes", MIX_EXT, 8, 0, 0},
+		{"standard, 8 bytes, timestamps", MIX_STD, 8, 1, 0},
+		{"mixed, timestamps", MIX_RANDOM, -1, 1, 0},
+	};
+	int fail = 0;
+
+	printf("board to PC at 100%% load, %d kbit/s bus, %d baud UART, %d-byte Tx ring, %.0f s each:\n", BUS_RATE / 1000, \
+		   UART_RATE, SLCAN_TX_RING, SIM_SECONDS);
+
+	for(size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++)
+	{
+		Load_t r = run_load(mixes[i].mix, mixes[i].dlc, mixes[i].timestamps);
+		int bad = mixes[i].must_hold && r.dropped > 0;
+
+		printf("  %-32s %6.0f frames/s, UART %5.1f%%, ring max %4u B, dropped %5.2f%%%s\n", mixes[i].name, \
+			   r.frames / SIM_SECONDS, 100.0 * r.uart_use, r.max_fill, 100.0 * r.dropped / r.frames, bad ? " FAIL" : "");
+		fail += bad;
+	}
+
+	return fail;
+}
+
+
+/**
+  * @brief  Opens a raw SocketCAN socket on an interface
+  * @param  name interface name
+  * @retval Socket, -1 on error
+  */
+
+static int open_can(const char *name)
+{
+	struct sockaddr_can addr = {0};
+	int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = if_nametoindex(name);
+
+	if(fd < 0 || addr.can_ifindex == 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		perror(name);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+/**
+  * @brief  Stands in for the board: slcan on a pty, frames to and from a CAN interface
+  * @param  ifname CAN interface, NULL to print the frames instead
+  * @retval 0 on success
+  */
+
+static int bridge(const char *ifname)
+{
+	Slcan_t s;
+	Slcan_Frame_t frame;
+	struct can_frame cf;
+	struct pollfd pfd[2];
+	char reply[SLCAN_REPLY_MAX], line[SLCAN_FRAME_MAX], buf[4096];
+	uint8_t reply_len, action;
+	int can = -1, master = posix_openpt(O_RDWR | O_NOCTTY);
+	ssize_t n;
+
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		perror("pty");
+		return 1;
+	}
+
+	if(ifname != NULL && (can = open_can(ifname)) < 0)
+	{
+		return 1;
+	}
+
+	Slcan_Init(&s);
+	printf("slcan device: %s\n", ptsname(master));
+	fflush(stdout);
+
+	pfd[0] = (struct pollfd){master, POLLIN, 0};
+	pfd[1] = (struct pollfd){can, POLLIN, 0};
+
+	while(poll(pfd, (can >= 0) ? 2 : 1, -1) >= 0)
+	{
+		if(pfd[0].revents & POLLIN)
+		{
+			n = read(master, buf, sizeof(buf));
+
+			for(ssize_t i = 0; i < n; i++)
+			{
+				action = Slcan_RxByte(&s, (uint8_t)buf[i], &frame, reply, &reply_len);
+
+				if(action == SLCAN_SEND)
+				{
+					cf = (struct can_frame){0};
+					cf.can_id = frame.id | ((frame.ext) ? CAN_EFF_FLAG : 0) | ((frame.rtr) ? CAN_RTR_FLAG : 0);
+					cf.can_dlc = frame.dlc;
+					memcpy(cf.data, frame.data, 8);
+
+					if(can >= 0 && write(can, &cf, sizeof(cf)) != sizeof(cf))
+					{
+						s.flags |= SLCAN_FLAG_TX_FULL;
+						reply_len = Slcan_Refuse(&s, reply);
+					}else if(can < 0)
+					{
+						printf("PC sent %s %X [%u]%s\n", (frame.ext) ? "ext" : "std", frame.id, frame.dlc, (frame.rtr) ? " remote" : "");
+						fflush(stdout);
+					}
+				}else if(action != SLCAN_NONE)
+				{
+					fprintf(stderr, "%s\n", (action == SLCAN_OPEN) ? "bus open" : (action == SLCAN_LISTEN) ? "bus open, listen only" : \
+							(action == SLCAN_CLOSE) ? "bus closed" : "bit rate set");
+				}
+
+				if(reply_len > 0 && write(master, reply, reply_len) != reply_len)
+				{
+					return 1;
+				}
+			}
+
+			if(n < 0 && errno != EAGAIN && errno != EIO)	// EIO: no process has the pty open yet, or slcand left
+			{
+				perror("pty");
+				return 1;
+			}
+
+			if(n <= 0)
+			{
+				usleep(100000);
+			}
+		}
+
+		if(can >= 0 && (pfd[1].revents & POLLIN) && read(can, &cf, sizeof(cf)) == sizeof(cf) && s.open)
+		{
+			frame.ext = (cf.can_id & CAN_EFF_FLAG) != 0;
+			frame.rtr = (cf.can_id & CAN_RTR_FLAG) != 0;
+			frame.id = cf.can_id & ((frame.ext) ? CAN_EFF_MASK : CAN_SFF_MASK);
+			frame.dlc = cf.can_dlc;
+			memcpy(frame.data, cf.data, 8);
+
+			if(!(cf.can_id & CAN_ERR_FLAG) && write(master, line, Slcan_Encode(&frame, s.timestamps, 0, line)) < 0)
+			{
+				s.dropped++;
+			}
+		}
+	}
+
+	perror("poll");
+
+	return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	const char *ifname = NULL;
+
+	if(argc >= 2 && strcmp(argv[1], "check") == 0)
+	{
+		int fail = check_protocol() + check_load();
+
+		printf("%s\n", fail ? "FAIL" : "PASS");
+
+		return fail != 0;
+	}
+
+	while((opt = getopt(argc, argv, "i:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i': ifname = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-i interface]\n       %s check\n", argv[0], argv[0]);
+				return 1;
+		}
+	}
+
+	return bridge(ifname);
+}
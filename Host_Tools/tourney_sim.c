@@ -0,0 +1,836 @@
+/**
+  ******************************************************************************
+  * @file    tourney_sim.c
+  * @author  Moe2Code
+  * @brief   Tournament simulation: Disc's scheduler (tourney.c) refereeing player nodes on
+  *          one CAN bus, in virtual time, to see how long a tournament takes and how
+  *          busy it keeps the bus. The following is conducted in source file:
+  *          + Referee: hands go to Tourney_Hand() as their frame ends, pairings and
+  *            results fill the 3 Tx mailboxes, sent in request order (TXFP) as the board
+  *            sets them. TIM6 scan for quiet matches every 50 ms
+  *          + Players (Nucleo with TOURNAMENT): a hand for each pairing or result that
+  *            leaves games to play, picked by strategy.c, then the blocking UART lines of
+  *            the board; frames that come in meanwhile wait in the 3-deep Rx FIFO
+  *          + Bus: arbitration on the identifier, bit exact frame lengths (can_bits.c),
+  *            intermission
+  *          + Schedules compared: one match at a time, a round at a time, and round robin
+  *            matches overlapped across rounds, for round robin and Swiss
+  *          Usage: ./tourney_sim [-n players] [-g games] [-S seed]
+  *                 ./tourney_sim check
+  *          check: the circle method for 2 to 64 players, every pair once in round robin,
+  *          no rematch in Swiss (even and odd numbers of players), the overlapped
+  *          schedules ahead of the others, lost frames recovered by the pairings sent
+  *          again, and a referee reset half way through resumed from the standings.
+  * @note    Node logic takes no time except the players' UART lines (the referee prints
+  *          nothing while matches are under way). Player Rx FIFOs hold the frames of
+  *          their own ID list filter only. No bus errors
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "strategy.h"
+#include "tourney.h"
+#include "can_bits.h"
+
+
+// Defines
+#define NS_PER_MS			1000000ULL
+#define BIT_NS				2000		// 500 kbit/s, as both boards
+#define UART_CHAR_NS		86806		// 115200 baud, 10 bits per character
+#define MAILBOXES			3
+#define FIFO_DEPTH			3
+#define SCAN_NS				(50 * NS_PER_MS)	// Disc's scan for quiet matches (TIM6)
+#define RETRY_MS			250			// TOURNEY_RETRY_MS of Disc's main.h
+#define REFEREE				TOURNEY_MAX	// Node index of the referee
+
+// Events
+#define EV_ARB				0			// Bus: start of an arbitration, if idle and a request waits
+#define EV_END				1			// Bus: end of the frame on the wire
+#define EV_RX				2			// Player: done printing, next frame of its Rx FIFO
+#define EV_SCAN				3			// Referee: TIM6 scan
+#define EV_RESET			4			// Referee: reset, tournament resumed from the standings
+
+
+// Typedefs
+typedef struct
+{
+	uint64_t t;
+	uint32_t seq;
+	uint8_t type;
+	uint8_t node;
+} Event_t;
+
+typedef struct
+{
+	uint16_t id;
+	uint8_t dlc;
+	uint8_t data[4];
+	uint16_t bits;				// On the wire, intermission included
+} Frame_t;
+
+// Tx request: a player's mailbox, or the oldest mailbox of the referee
+typedef struct
+{
+	uint16_t id;
+	uint32_t seq;
+	uint8_t node;
+	uint32_t gen;				// Referee: reset count when queued, stale after a reset
+	uint64_t t;					// Time of the request
+	Frame_t f;
+} Request_t;
+
+typedef struct
+{
+	Strategy_Player_t player;
+	uint8_t last_hand;
+	uint8_t mailboxes;			// Hands waiting for the bus
+	uint64_t busy_until;		// End of its UART lines
+	Frame_t fifo[FIFO_DEPTH];
+	uint8_t head, fill, waiting;	// waiting: an EV_RX is queued
+} Player_t;
+
+// A tournament and how it runs
+typedef struct
+{
+	uint8_t mode, players, games, max_open, overlap;
+	uint32_t seed;
+	uint32_t drop_every;		// Every that many frames to the players one is lost, 0 for none
+	uint64_t reset_at;			// Referee reset at that time, 0 for none
+} Config_t;
+
+typedef struct
+{
+	uint64_t done_ns, busy_ns, frames;
+	uint64_t hand_wait_ns;		// Longest a hand waited for the bus
+	uint32_t matches, games, retries, strays, rematches, overruns, hung, dropped, resets;
+	uint32_t met;				// Distinct pairs paired on the bus
+	uint32_t met_twice;			// Pairs paired on the bus in two rounds
+	uint32_t points, byes;		// Half points of the standings, Swiss byes
+	uint8_t played_min, played_max, rounds, done;
+} Result_t;
+
+typedef struct
+{
+	Config_t cfg;
+	Tourney_t t;
+	Tourney_Store_t store;		// The board's backup SRAM: kept through a reset
+	Player_t p[TOURNEY_MAX];
+	Event_t *ev;
+	uint32_t ev_n, ev_cap, seq;
+	Request_t *req;
+	uint32_t req_n, req_cap, req_seq;
+	Frame_t ref_mb[MAILBOXES];	// Referee's mailboxes, oldest at ref_first
+	uint8_t ref_first, ref_fill, ref_queued;	// ref_queued: the oldest is a request
+	uint32_t gen;
+	uint8_t busy;
+	uint64_t free_at;
+	Request_t tx;				// Frame on the wire
+	uint8_t met_round[TOURNEY_MAX][TOURNEY_MAX];	// Round + 1 each pair was paired in, 0 if never
+	uint32_t to_players;
+	Result_t r;
+} Sim_t;
+
+
+// Global variables
+static const char *hand_name[3] = {"Rock", "Paper", "Scissors"};
+
+
+// Function prototypes
+static uint64_t mix(uint64_t x);
+static void ev_push(Sim_t *s, uint64_t t, uint8_t type, uint8_t node);
+static Event_t ev_pop(Sim_t *s);
+static uint8_t req_before(const Request_t *a, const Request_t *b);
+static void req_push(Sim_t *s, uint64_t t, Request_t r);
+static Request_t req_pop(Sim_t *s);
+static void frame_fill(Frame_t *f);
+static void ref_pump(Sim_t *s, uint64_t t);
+static void player_hand(Sim_t *s, uint64_t t, uint8_t n);
+static void player_rx(Sim_t *s, uint64_t t, uint8_t n);
+static void frame_end(Sim_t *s, uint64_t t);
+static void sim_run(const Config_t *cfg, Result_t *res);
+static void print_header(void);
+static void print_row(const char *schedule, const Config_t *cfg, const Result_t *r);
+static int check_one(const char *what, int ok);
+static int check(void);
+
+
+/**************************** Simulation ****************************/
+
+/**
+  * @brief  Mixes a 64-bit value (splitmix64 finalizer): seeds of the players
+  */
+
+static uint64_t mix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+
+/**
+  * @brief  Adds an event (binary heap on time, then order of arrival)
+  */
+
+static void ev_push(Sim_t *s, uint64_t t, uint8_t type, uint8_t node)
+{
+	Event_t e = {t, s->seq++, type, node};
+	uint32_t i;
+
+	if(s->ev_n == s->ev_cap)
+	{
+		s->ev_cap = s->ev_cap ? 2 * s->ev_cap : 256;
+		s->ev = realloc(s->ev, s->ev_cap * sizeof(Event_t));
+	}
+
+	for(i = s->ev_n++; i > 0; i = (i - 1) / 2)
+	{
+		Event_t *p = &s->ev[(i - 1) / 2];
+
+		if(p->t < t || (p->t == t && p->seq < e.seq))
+		{
+			break;
+		}
+
+		s->ev[i] = *p;
+	}
+
+	s->ev[i] = e;
+}
+
+
+/**
+  * @brief  Removes the earliest event
+  */
+
+static Event_t ev_pop(Sim_t *s)
+{
+	Event_t top = s->ev[0], last = s->ev[--s->ev_n];
+	uint32_t i = 0, c;
+
+	while((c = 2 * i + 1) < s->ev_n)
+	{
+		if(c + 1 < s->ev_n && (s->ev[c+1].t < s->ev[c].t || (s->ev[c+1].t == s->ev[c].t && s->ev[c+1].seq < s->ev[c].seq)))
+		{
+			c++;
+		}
+
+		if(last.t < s->ev[c].t || (last.t == s->ev[c].t && last.seq < s->ev[c].seq))
+		{
+			break;
+		}
+
+		s->ev[i] = s->ev[c];
+		i = c;
+	}
+
+	s->ev[i] = last;
+
+	return top;
+}
+
+
+/**
+  * @brief  Arbitration order of two requests: lowest ID wins
+  */
+
+static uint8_t req_before(const Request_t *a, const Request_t *b)
+{
+	return a->id < b->id || (a->id == b->id && a->seq < b->seq);
+}
+
+
+/**
+  * @brief  Adds a Tx request (binary heap) and starts an arbitration if the bus is idle
+  */
+
+static void req_push(Sim_t *s, uint64_t t, Request_t r)
+{
+	uint32_t i;
+
+	if(s->req_n == s->req_cap)
+	{
+		s->req_cap = s->req_cap ? 2 * s->req_cap : 256;
+		s->req = realloc(s->req, s->req_cap * sizeof(Request_t));
+	}
+
+	r.seq = s->req_seq++;
+	r.t = t;
+
+	for(i = s->req_n++; i > 0 && req_before(&r, &s->req[(i - 1) / 2]); i = (i - 1) / 2)
+	{
+		s->req[i] = s->req[(i - 1) / 2];
+	}
+
+	s->req[i] = r;
+
+	if(!s->busy)
+	{
+		ev_push(s, (t > s->free_at) ? t : s->free_at, EV_ARB, 0);
+	}
+}
+
+
+/**
+  * @brief  Removes the request that wins the arbitration
+  */
+
+static Request_t req_pop(Sim_t *s)
+{
+	Request_t top = s->req[0], last = s->req[--s->req_n];
+	uint32_t i = 0, c;
+
+	while((c = 2 * i + 1) < s->req_n)
+	{
+		if(c + 1 < s->req_n && req_before(&s->req[c+1], &s->req[c]))
+		{
+			c++;
+		}
+
+		if(req_before(&last, &s->req[c]))
+		{
+			break;
+		}
+
+		s->req[i] = s->req[c];
+		i = c;
+	}
+
+	s->req[i] = last;
+
+	return top;
+}
+
+
+/**
+  * @brief  Sets the bits a frame takes on the wire, intermission included
+  */
+
+static void frame_fill(Frame_t *f)
+{
+	Can_Bits_Frame_t b = {.id = f->id, .dlc = f->dlc};
+
+	memcpy(b.data, f->data, f->dlc);
+	f->bits = Can_Bits_Length(&b) + CAN_BITS_IFS;
+}
+
+
+/**
+  * @brief  Referee: pairings and results into the free mailboxes (tourney_tx_pending()),
+  * 		the oldest mailbox up for arbitration
+  * @param  s simulation
+  * @param  t time
+  * @retval None
+  */
+
+static void ref_pump(Sim_t *s, uint64_t t)
+{
+	Tourney_Frame_t tf;
+
+	while(s->ref_fill < MAILBOXES && Tourney_NextTx(&s->t, &tf))
+	{
+		Frame_t *f = &s->ref_mb[(s->ref_first + s->ref_fill++) % MAILBOXES];
+
+		f->id = tf.id;
+		f->dlc = tf.dlc;
+		memcpy(f->data, tf.data, sizeof(f->data));
+		frame_fill(f);
+		Tourney_Sent(&s->t, &tf);
+	}
+
+	if(s->ref_fill > 0 && !s->ref_queued)		// TXFP: the mailboxes go out in request order
+	{
+		req_push(s, t, (Request_t){.id = s->ref_mb[s->ref_first].id, .node = REFEREE, .gen = s->gen, .f = s->ref_mb[s->ref_first]});
+		s->ref_queued = 1;
+	}
+}
+
+
+/**
+  * @brief  Player: CAN1_Tx(). The hand is queued, then its UART line printed
+  */
+
+static void player_hand(Sim_t *s, uint64_t t, uint8_t n)
+{
+	Player_t *p = &s->p[n];
+	Frame_t f = {.id = SESSION_HAND_ID + n, .dlc = 1};
+	char line[80];
+
+	if(p->mailboxes == MAILBOXES)		// Error_handler() on the board
+	{
+		s->r.hung++;
+		return;
+	}
+
+	p->last_hand = Strategy_Pick(&p->player);
+	f.data[0] = p->last_hand;
+	frame_fill(&f);
+	p->mailboxes++;
+	req_push(s, t, (Request_t){.id = f.id, .node = n, .f = f});
+	p->busy_until += sprintf(line, "Sent message containing Nucleo's hand (%s)\r\n", hand_name[p->last_hand]) * UART_CHAR_NS;
+}
+
+
+/**
+  * @brief  Player: the oldest frame of its Rx FIFO, as process_rx_msg() with TOURNAMENT
+  * @param  s simulation
+  * @param  t time, the player is done with its UART lines
+  * @param  n player
+  * @retval None
+  */
+
+static void player_rx(Sim_t *s, uint64_t t, uint8_t n)
+{
+	Player_t *p = &s->p[n];
+	Frame_t *f = &p->fifo[p->head];
+	char line[80];
+
+	p->head = (p->head + 1) % FIFO_DEPTH;
+	p->fill--;
+	p->busy_until = t;
+
+	if(f->data[0] == TOURNEY_PAIRING)
+	{
+		if(f->data[3] > 0 && p->mailboxes == 0)		// Sent again: a hand waiting for the bus answers it
+		{
+			player_hand(s, t, n);
+		}
+
+		p->busy_until += sprintf(line, "Round %u against node %u, %u games left\r\n", f->data[1] + 1, f->data[2], \
+								 f->data[3]) * UART_CHAR_NS;
+	}else
+	{
+		if(f->data[0] <= 3)
+		{
+			Strategy_Observe(&p->player, p->last_hand, Strategy_OppHand(p->last_hand, f->data[0]));
+		}
+
+		if(f->data[1] > 0)
+		{
+			player_hand(s, t, n);
+		}
+	}
+
+	if(p->fill > 0)
+	{
+		ev_push(s, p->busy_until, EV_RX, n);
+	}else
+	{
+		p->waiting = 0;
+	}
+}
+
+
+/**
+  * @brief  A frame went through: hands to the referee, pairings and results to the
+  * 		player whose ID it is
+  * @param  s simulation
+  * @param  t end of the frame
+  * @retval None
+  */
+
+static void frame_end(Sim_t *s, uint64_t t)
+{
+	Request_t *r = &s->tx;
+
+	s->busy = 0;
+	s->r.frames++;
+
+	if(s->req_n > 0)
+	{
+		ev_push(s, s->free_at, EV_ARB, 0);
+	}
+
+	if(r->node != REFEREE)				// Hand
+	{
+		uint8_t done = s->store.done;
+		uint64_t wait = t - (uint64_t)(r->f.bits - CAN_BITS_IFS) * BIT_NS - r->t;
+
+		s->r.hand_wait_ns = (wait > s->r.hand_wait_ns) ? wait : s->r.hand_wait_ns;
+		s->p[r->node].mailboxes--;
+		Tourney_Hand(&s->t, r->f.id - SESSION_HAND_ID, r->f.data[0], t / NS_PER_MS);
+		ref_pump(s, t);
+
+		if(s->store.done && !done)
+		{
+			s->r.done_ns = t;
+		}
+
+		return;
+	}
+
+	if(r->gen == s->gen)				// Not the mailbox of a referee reset since
+	{
+		s->ref_first = (s->ref_first + 1) % MAILBOXES;
+		s->ref_fill--;
+		s->ref_queued = 0;
+		ref_pump(s, t);					// Tx mailbox complete callback
+	}
+
+	{
+		uint8_t n = r->f.id - SESSION_RESULT_ID;
+		Player_t *p = &s->p[n];
+
+		if(r->f.data[0] == TOURNEY_PAIRING && r->f.data[2] < TOURNEY_MAX)
+		{
+			uint8_t *m = &s->met_round[n][r->f.data[2]];
+
+			s->r.met += (*m == 0);
+			s->r.met_twice += (*m != 0 && *m != r->f.data[1] + 1);
+			*m = r->f.data[1] + 1;
+		}
+
+		if(s->cfg.drop_every && ++s->to_players % s->cfg.drop_every == 0)
+		{
+			s->r.dropped++;
+			return;
+		}
+
+		if(p->fill == FIFO_DEPTH)		// Full: the last message is overwritten (RFLM = 0)
+		{
+			s->r.overruns++;
+			p->fifo[(p->head + FIFO_DEPTH - 1) % FIFO_DEPTH] = r->f;
+		}else
+		{
+			p->fifo[(p->head + p->fill++) % FIFO_DEPTH] = r->f;
+		}
+
+		if(!p->waiting)
+		{
+			p->waiting = 1;
+			ev_push(s, (t > p->busy_until) ? t : p->busy_until, EV_RX, n);
+		}
+	}
+}
+
+
+/**
+  * @brief  Runs a tournament until it is over and the bus is quiet
+  * @param  cfg tournament
+  * @param  res receives the outcome
+  * @retval None
+  */
+
+static void sim_run(const Config_t *cfg, Result_t *res)
+{
+	Sim_t *s = calloc(1, sizeof(Sim_t));
+	uint8_t node[TOURNEY_MAX];
+
+	if(s == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	s->cfg = *cfg;
+
+	for(uint8_t n = 0; n < cfg->players; n++)
+	{
+		uint64_t r = mix(((uint64_t)cfg->seed << 32) ^ n);
+
+		node[n] = n;
+		Strategy_Init(&s->p[n].player, n % STRATEGY_COUNT, (uint32_t)(r >> 32) | 1);
+	}
+
+	Tourney_Start(&s->t, &s->store, cfg->mode, node, cfg->players, cfg->games, cfg->max_open, cfg->overlap, 0);
+	ev_push(s, SCAN_NS, EV_SCAN, REFEREE);
+
+	if(cfg->reset_at)
+	{
+		ev_push(s, cfg->reset_at, EV_RESET, REFEREE);
+	}
+
+	while(s->ev_n > 0)
+	{
+		Event_t e = ev_pop(s);
+
+		switch(e.type)
+		{
+			case EV_ARB:
+				while(!s->busy && s->req_n > 0 && e.t >= s->free_at)
+				{
+					Request_t r = req_pop(s);
+					uint64_t len = (uint64_t)r.f.bits * BIT_NS;
+
+					if(r.node == REFEREE && r.gen != s->gen)	// Mailbox aborted by the reset
+					{
+						continue;
+					}
+
+					s->busy = 1;
+					s->tx = r;
+					s->free_at = e.t + len;
+					s->r.busy_ns += len - CAN_BITS_IFS * BIT_NS;
+					ev_push(s, e.t + len - CAN_BITS_IFS * BIT_NS, EV_END, 0);
+				}
+				break;
+
+			case EV_END:
+				frame_end(s, e.t);
+				break;
+
+			case EV_RX:
+				player_rx(s, e.t, e.node);
+				break;
+
+			case EV_SCAN:
+				if(!s->store.done)
+				{
+					Tourney_Tick(&s->t, e.t / NS_PER_MS, RETRY_MS);
+					ref_pump(s, e.t);
+					ev_push(s, e.t + SCAN_NS, EV_SCAN, REFEREE);
+				}
+				break;
+
+			case EV_RESET:				// Mailboxes aborted, RAM lost, backup SRAM kept
+				if(!s->store.done)
+				{
+					s->r.resets++;
+					s->gen++;
+					s->ref_fill = 0;
+					s->ref_queued = 0;
+					Tourney_Resume(&s->t, &s->store, e.t / NS_PER_MS);	// Sends again at the next scan
+				}
+				break;
+		}
+	}
+
+	*res = s->r;
+	res->matches = s->t.matches;
+	res->games = s->t.games;
+	res->retries = s->t.retries;
+	res->strays = s->t.strays;
+	res->rematches = s->t.rematches;
+	res->rounds = s->store.rounds;
+	res->done = s->store.done;
+	res->played_min = 255;
+
+	for(uint8_t n = 0; n < cfg->players; n++)
+	{
+		res->points += s->store.points[n];
+		res->played_min = (s->store.played[n] < res->played_min) ? s->store.played[n] : res->played_min;
+		res->played_max = (s->store.played[n] > res->played_max) ? s->store.played[n] : res->played_max;
+
+		for(uint8_t r = 0; cfg->mode == TOURNEY_SWISS && r < s->store.rounds; r++)
+		{
+			res->byes += (s->store.opp[n][r] == TOURNEY_BYE);
+		}
+	}
+
+	if(res->done_ns == 0)		// Never over: the time the bus went quiet
+	{
+		res->done_ns = s->free_at;
+	}
+
+	free(s->ev);
+	free(s->req);
+	free(s);
+}
+
+
+/**************************** Modes ****************************/
+
+static void print_header(void)
+{
+	printf("%-12s %-16s %8s %7s %9s %10s %9s %13s %8s %7s\n", "tournament", "schedule", "matches", "games", "time s", \
+		   "bus load %", "games/s", "hand wait ms", "retries", "strays");
+}
+
+
+static void print_row(const char *schedule, const Config_t *cfg, const Result_t *r)
+{
+	printf("%-12s %-16s %8u %7u %9.3f %10.1f %9.0f %13.1f %8u %7u\n", (cfg->mode == TOURNEY_SWISS) ? "swiss" : "round robin", \
+		   schedule, r->matches, r->games, r->done_ns / 1e9, 100.0 * r->busy_ns / r->done_ns, r->games / (r->done_ns / 1e9), \
+		   r->hand_wait_ns / 1e6, r->retries, r->strays);
+}
+
+
+/**
+  * @brief  Prints a check and its outcome
+  * @retval 1 if it failed
+  */
+
+static int check_one(const char *what, int ok)
+{
+	printf("%-62s %s\n", what, ok ? "ok" : "FAIL");
+
+	return !ok;
+}
+
+
+/**
+  * @brief  Checks the pairings and the schedules
+  * @param  None
+  * @retval Exit code
+  */
+
+static int check(void)
+{
+	Config_t cfg = {.mode = TOURNEY_ROUND_ROBIN, .players = 64, .games = 5, .max_open = 32, .overlap = 1, .seed = 1};
+	Result_t serial, barrier, overlap, r;
+	int fail = 0, ok = 1;
+
+	// Circle method: each player once a round, every pair once
+	for(uint8_t n = 2; n <= TOURNEY_MAX; n++)
+	{
+		uint8_t rounds = n - 1 + (n & 1);
+		uint8_t seen[TOURNEY_MAX][TOURNEY_MAX] = {{0}};
+
+		for(uint8_t round = 0; round < rounds; round++)
+		{
+			uint8_t byes = 0;
+
+			for(uint8_t p = 0; p < n; p++)
+			{
+				uint8_t o = Tourney_Opponent(n, round, p);
+
+				if(o == TOURNEY_BYE)
+				{
+					byes++;
+					continue;
+				}
+
+				ok &= (o < n && o != p && Tourney_Opponent(n, round, o) == p);
+				ok &= (o < n && seen[p][o]++ == 0);
+			}
+
+			ok &= (byes == (n & 1));
+		}
+
+		for(uint8_t p = 0; p < n; p++)
+		{
+			for(uint8_t o = 0; o < n; o++)
+			{
+				ok &= (seen[p][o] == (p != o));
+			}
+		}
+	}
+
+	fail |= check_one("circle method, 2 to 64 players: every pair once, one bye a round", ok);
+
+	print_header();
+	cfg.max_open = 1;
+	sim_run(&cfg, &serial);
+	print_row("one at a time", &cfg, &serial);
+	cfg.max_open = 32;
+	cfg.overlap = 0;
+	sim_run(&cfg, &barrier);
+	print_row("round at a time", &cfg, &barrier);
+	cfg.overlap = 1;
+	sim_run(&cfg, &overlap);
+	print_row("overlapped", &cfg, &overlap);
+
+	fail |= check_one("round robin 64: 2016 matches, every pair paired once", overlap.done && overlap.matches == 2016 && \
+					  overlap.met == 2 * 2016 && overlap.met_twice == 0 && overlap.games == 2016 * 5);
+	fail |= check_one("round robin 64: 2 half points a match, no strays or retries", overlap.points == 2 * 2016 && \
+					  overlap.strays == 0 && overlap.retries == 0 && overlap.overruns == 0 && overlap.hung == 0);
+	fail |= check_one("round robin 64: same matches whatever the schedule", serial.done && barrier.done && \
+					  serial.met == overlap.met && barrier.met == overlap.met && serial.games == overlap.games && \
+					  barrier.games == overlap.games && serial.met_twice == 0 && barrier.met_twice == 0);
+	fail |= check_one("round robin 64: overlapped ahead of round at a time, 5x serial", overlap.done_ns < barrier.done_ns && \
+					  5 * overlap.done_ns < serial.done_ns);
+	fail |= check_one("round robin 64: overlapped keeps the bus over 85 % busy", overlap.busy_ns > 0.85 * overlap.done_ns);
+	fail |= check_one("round robin 64: no hand kept off the bus until its match is retried", \
+					  overlap.hand_wait_ns < RETRY_MS * NS_PER_MS && barrier.hand_wait_ns < RETRY_MS * NS_PER_MS);
+
+	cfg.players = 9;
+	sim_run(&cfg, &r);
+	fail |= check_one("round robin 9: every pair once, each sits one round out", r.done && r.matches == 36 && \
+					  r.met == 72 && r.met_twice == 0 && r.played_min == 9 && r.played_max == 9);
+
+	cfg = (Config_t){.mode = TOURNEY_SWISS, .players = 64, .games = 5, .max_open = 1, .overlap = 1, .seed = 1};
+	sim_run(&cfg, &serial);
+	print_row("one at a time", &cfg, &serial);
+	cfg.max_open = 32;
+	sim_run(&cfg, &overlap);
+	print_row("round at a time", &cfg, &overlap);
+	fail |= check_one("swiss 64: 6 rounds, 192 matches, no rematch", overlap.done && overlap.rounds == 6 && \
+					  overlap.matches == 192 && overlap.rematches == 0 && overlap.met_twice == 0 && overlap.met == 384 && \
+					  overlap.played_min == 6 && overlap.played_max == 6);
+	fail |= check_one("swiss 64: a round at a time 5x faster than one match at a time", \
+					  serial.done && serial.matches == 192 && 5 * overlap.done_ns < serial.done_ns);
+
+	cfg.players = 63;
+	sim_run(&cfg, &r);
+	fail |= check_one("swiss 63: a bye a round, nobody twice, no rematch", r.done && r.byes == 6 && \
+					  r.matches == 6 * 31 && r.rematches == 0 && r.met_twice == 0 && r.points == 2 * 6 * 31 + 2 * 6);
+
+	// Every 97th frame to the players lost: matches stall until their pairing goes again
+	cfg = (Config_t){.mode = TOURNEY_ROUND_ROBIN, .players = 16, .games = 5, .max_open = 8, .overlap = 1, .seed = 3, .drop_every = 97};
+	sim_run(&cfg, &r);
+	fail |= check_one("lost frames: pairings sent again, round robin 16 completes", r.done && r.dropped > 0 && \
+					  r.retries > 0 && r.matches == 120 && r.met == 240 && r.met_twice == 0 && r.hung == 0);
+
+	// Referee reset half way through a Swiss tournament: standings kept, matches under way played again
+	cfg = (Config_t){.mode = TOURNEY_SWISS, .players = 64, .games = 5, .max_open = 32, .overlap = 1, .seed = 5};
+	sim_run(&cfg, &r);
+	cfg.reset_at = r.done_ns / 2;
+	sim_run(&cfg, &r);
+	fail |= check_one("referee reset: Swiss 64 resumed from the standings", r.done && r.resets == 1 && \
+					  r.rematches == 0 && r.met_twice == 0 && r.played_min == 6 && r.played_max == 6 && \
+					  r.points == 2 * 192 && r.hung == 0);
+
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Config_t cfg = {.players = 64, .games = 5, .seed = 1};
+	const char *mode = (argc > 1 && argv[1][0] != '-') ? argv[1] : "";
+	Result_t r;
+	int opt;
+
+	if(strcmp(mode, "check") == 0)
+	{
+		return check();
+	}
+
+	while((opt = getopt(argc, argv, "n:g:S:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': cfg.players = strtoul(optarg, NULL, 0); break;
+			case 'g': cfg.games = strtoul(optarg, NULL, 0); break;
+			case 'S': cfg.seed = strtoul(optarg, NULL, 0); break;
+			default: mode = "?"; break;
+		}
+	}
+
+	if(mode[0] != 0 || cfg.players < 2 || cfg.players > TOURNEY_MAX || cfg.games < 1)
+	{
+		fprintf(stderr, "Usage: %s [-n players (2 to %u)] [-g games] [-S seed]\n       %s check\n", argv[0], TOURNEY_MAX, argv[0]);
+		return 1;
+	}
+
+	printf("%u players, %u games a match, 500 kbit/s\n\n", cfg.players, cfg.games);
+	print_header();
+
+	for(uint8_t m = TOURNEY_ROUND_ROBIN; m <= TOURNEY_SWISS; m++)
+	{
+		const char *schedule[3] = {"one at a time", "round at a time", "overlapped"};
+
+		for(uint8_t k = 0; k < 3; k++)
+		{
+			if(m == TOURNEY_SWISS && k == 2)	// Swiss rounds wait for the standings anyway
+			{
+				break;
+			}
+
+			cfg.mode = m;
+			cfg.max_open = (k == 0) ? 1 : cfg.players / 2;
+			cfg.overlap = (k == 2);
+			sim_run(&cfg, &r);
+			print_row(schedule[k], &cfg, &r);
+		}
+	}
+
+	return 0;
+}
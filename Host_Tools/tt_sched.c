@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * @file    tt_sched.c
+  * @author  Moe2Code
+  * @brief   Schedule generator of time-triggered CAN (TT_CAN). Lays out the basic cycle
+  *          for N players with the firmware's tt_sched.c. The following is conducted in
+  *          source file:
+  *          + Windows of the cycle: referee window (reference and results), a hand window
+  *            per player, arbitrating window, with their start and length in us and in
+  *            bit times (TTCM time stamps)
+  *          + Delay each player arms its TIM6 with on the reference's Rx interrupt
+  *          + Share of the bus the schedule leaves to event frames, rounds per second
+  *          Usage: ./tt_sched [-n players] [-b kbit/s] [-c cycle_ms]
+  *                 ./tt_sched check
+  *          -c 0 (default) takes the shortest cycle. check: the frame bounds of tt_sched.h
+  *          against every frame can_bits.c builds, the schedule for 1 to TT_MAX_PLAYERS
+  *          players at 125 to 1000 kbit/s (windows back to back, every window holds a
+  *          worst-case frame, hands armed within their window), and the jitter figures on
+  *          made up time stamps
+  * @note    TT_CYCLE_MS in Disc's main.h must be a cycle the generator accepts for
+  *          TT_PLAYERS, and TT_HAND_MS in Nucleo's main.h a multiple of it
+  */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "can_bits.h"
+#include "tt_sched.h"
+
+
+// Function prototypes
+static void print_sched(const Tt_Sched_t *s);
+static int check_one(const char *what, int ok);
+static int check(void);
+
+
+/**
+  * @brief  Prints the windows of a schedule
+  * @param  s pointer to the schedule
+  * @retval None
+  */
+
+static void print_sched(const Tt_Sched_t *s)
+{
+	static const char *kinds[] = {"referee", "hand", "free"};
+	const Tt_Window_t *free_win = Tt_Window(s, TT_WIN_FREE, 0);
+
+	printf("cycle %lu us (%lu bit times), %u players, worst-case frame %lu us\n", (unsigned long)s->cycle_us, \
+			(unsigned long)((uint64_t)s->cycle_us * 1000 / s->bit_ns), s->players, (unsigned long)s->frame_us);
+	printf("%-8s %-7s %9s %9s %11s %9s\n", "window", "player", "start_us", "len_us", "start_bits", "arm_us");
+
+	for(uint8_t i = 0; i < s->windows; i++)
+	{
+		const Tt_Window_t *w = &s->win[i];
+		char player[8] = "-", arm[12] = "-";
+
+		if(w->kind == TT_WIN_HAND)
+		{
+			sprintf(player, "%u", w->player);
+			sprintf(arm, "%lu", (unsigned long)Tt_Arm_Us(s, w->player));
+		}
+
+		printf("%-8s %-7s %9lu %9lu %11lu %9s\n", kinds[w->kind], player, (unsigned long)w->start_us, \
+				(unsigned long)w->len_us, (unsigned long)((uint64_t)w->start_us * 1000 / s->bit_ns), arm);
+	}
+
+	printf("event frames: %.1f %% of the bus, %lu frames per cycle at most\n", 100.0 * free_win->len_us / s->cycle_us, \
+			(unsigned long)(free_win->len_us / s->frame_us));
+	printf("rounds: %.1f per second per player at most\n", 1e6 / s->cycle_us);
+}
+
+
+/**
+  * @brief  Prints a check and its outcome
+  * @retval 1 if it failed
+  */
+
+static int check_one(const char *what, int ok)
+{
+	printf("%-62s %s\n", what, ok ? "ok" : "FAIL");
+
+	return !ok;
+}
+
+
+/**
+  * @brief  Checks the frame bounds, the schedules and the jitter figures
+  * @param  None
+  * @retval Exit code
+  */
+
+static int check(void)
+{
+	static const uint32_t rates[] = {125, 250, 500, 1000};
+	Tt_Sched_t s;
+	Tt_Jitter_t j;
+	uint64_t rng = 0x9E3779B97F4A7C15ULL;
+	int ok = 1, fail = 0;
+	char buf[300];
+
+	// Every standard data frame of up to 8 bytes fits TT_FRAME_BITS, no reference is shorter than TT_REF_BITS_MIN
+	for(uint32_t i = 0; i < 100000; i++)
+	{
+		Can_Bits_Frame_t f = {0};
+
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		f.id = rng & 0x7FF;
+		f.dlc = (rng >> 11) % 9;
+		memcpy(f.data, &rng, sizeof(f.data));
+		ok &= Can_Bits_Worst(&f) + CAN_BITS_IFS <= TT_FRAME_BITS;
+
+		f.id = TT_REF_ID;
+		f.dlc = TT_REF_DLC;
+		ok &= Can_Bits_Length(&f) >= TT_REF_BITS_MIN;
+	}
+
+	fail |= check_one("100000 frames: within TT_FRAME_BITS, reference >= TT_REF_BITS_MIN", ok);
+
+	// Schedules for every player count and bit rate
+	ok = 1;
+
+	for(uint8_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+	{
+		uint32_t bit_ns = 1000000 / rates[r];
+
+		for(uint8_t n = 1; n <= TT_MAX_PLAYERS; n++)
+		{
+			uint32_t at = 0;
+
+			if(Tt_Build(&s, n, bit_ns, 0) == 0)		// The shortest cycle
+			{
+				ok = 0;
+				continue;
+			}
+
+			ok &= (s.windows == n + 2 && s.cycle_us % TT_CYCLE_GRAIN_US == 0);
+
+			for(uint8_t i = 0; i < s.windows; i++)
+			{
+				const Tt_Window_t *w = &s.win[i];
+
+				ok &= (w->start_us == at && w->len_us >= s.frame_us);
+				at += w->len_us;
+			}
+
+			ok &= (at == s.cycle_us);
+			ok &= (Tt_Window(&s, TT_WIN_REF, 0)->len_us >= (1 + n) * s.frame_us);
+
+			for(uint8_t p = 0; p < n; p++)		// Armed on the earliest Rx interrupt, late by less than the guard
+			{
+				const Tt_Window_t *w = Tt_Window(&s, TT_WIN_HAND, p);
+				uint32_t sof = Tt_Arm_Us(&s, p) + TT_REF_BITS_MIN * bit_ns / 1000;
+
+				ok &= (sof >= w->start_us && sof + TT_TICK_US + s.frame_us <= w->start_us + w->len_us);
+			}
+
+			ok &= (Tt_Build(&s, n, bit_ns, s.cycle_us - TT_CYCLE_GRAIN_US) == 0);		// No room left for an event frame
+		}
+	}
+
+	ok &= (Tt_Build(&s, 0, 2000, 0) == 0 && Tt_Build(&s, TT_MAX_PLAYERS + 1, 2000, 0) == 0);
+	ok &= (Tt_Build(&s, 1, 2000, 200000) == 0);			// Over the 16-bit time stamps
+	fail |= check_one("1 to 32 players, 125 to 1000 kbit/s: windows and arming", ok);
+
+	// Jitter on made up time stamps at 500 kbit/s, cycle 20 ms (10000 bit times), across the 16-bit wrap
+	ok = (Tt_Build(&s, 2, 2000, 20000) == 20000);
+	Tt_Jitter_Init(&j);
+	Tt_Jitter_Result(&j, &s, 100);				// Before the first reference: ignored
+	Tt_Jitter_Ref(&j, &s, 60000, 0);
+	Tt_Jitter_Result(&j, &s, 60000 + 135);
+	Tt_Jitter_Hand(&j, &s, 1, 60000 + Tt_Window(&s, TT_WIN_HAND, 1)->start_us / 2 + 10);
+	Tt_Jitter_Ref(&j, &s, (uint16_t)(60000 + 10003), 0);
+	Tt_Jitter_Hand(&j, &s, 0, (uint16_t)(60000 + 10003 + 5));			// In the referee window
+	Tt_Jitter_Ref(&j, &s, (uint16_t)(60000 + 30001), 1);				// One missed: no period
+	ok &= (j.cycles == 3 && j.late == 1 && j.period_min == 3 && j.period_max == 3);
+	ok &= (j.results == 1 && j.result_min == 135 && j.hands == 2 && j.outside == 1);
+	Tt_Report(&j, &s, buf);
+	ok &= (strstr(buf, "period +6/+6 us") != NULL && strlen(buf) < 250);
+	fail |= check_one("jitter: period, offsets, late and outside counts", ok);
+
+	printf("%s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Tt_Sched_t s;
+	uint32_t players = 1, kbits = 500, cycle_ms = 0;
+	int opt;
+
+	if(argc > 1 && strcmp(argv[1], "check") == 0)
+	{
+		return check();
+	}
+
+	while((opt = getopt(argc, argv, "n:b:c:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': players = strtoul(optarg, NULL, 0); break;
+			case 'b': kbits = strtoul(optarg, NULL, 0); break;
+			case 'c': cycle_ms = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n players] [-b kbit/s] [-c cycle_ms]\n       %s check\n", argv[0], argv[0]);
+				return 1;
+		}
+	}
+
+	if(players < 1 || players > TT_MAX_PLAYERS || kbits < 10 || kbits > 1000 || cycle_ms > 255)
+	{
+		fprintf(stderr, "1 to %u players, 10 to 1000 kbit/s, cycle up to 255 ms\n", TT_MAX_PLAYERS);
+		return 1;
+	}
+
+	if(Tt_Build(&s, players, 1000000 / kbits, cycle_ms * 1000) == 0)
+	{
+		fprintf(stderr, "%lu players do not fit a %lu ms cycle at %lu kbit/s (16-bit time stamps: %lu ms at most)\n", \
+				(unsigned long)players, (unsigned long)cycle_ms, (unsigned long)kbits, (unsigned long)(0xFFFFULL * 1000000 / kbits / 1000000));
+		return 1;
+	}
+
+	print_sched(&s);
+
+	return 0;
+}
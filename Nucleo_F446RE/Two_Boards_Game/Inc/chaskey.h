@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : chaskey.h
+  * @brief          : Header for chaskey.c file.
+  *                   This file contains the types and prototypes of the Chaskey-12
+  *                   MAC used to authenticate CAN frames.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __CHASKEY_H
+#define __CHASKEY_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define CHASKEY_BLOCK_LEN		16		// Messages up to one block (16 bytes) are supported
+#define CHASKEY_ROUNDS			12
+
+
+// Typedefs
+// 128-bit key and the two subkeys derived from it
+typedef struct
+{
+	uint32_t k[4];
+	uint32_t k1[4];				// Used when the last block is complete
+	uint32_t k2[4];				// Used when the last block is padded
+} Chaskey_Key_t;
+
+
+// Function prototypes
+void Chaskey_KeySchedule(Chaskey_Key_t *key, const uint32_t k[4]);
+uint32_t Chaskey_Mac32(const Chaskey_Key_t *key, const uint8_t *msg, uint8_t len);
+
+
+#endif /* __CHASKEY_H */
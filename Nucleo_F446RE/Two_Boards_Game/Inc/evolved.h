@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file           : evolved.h
+  * @brief          : Header for evolved.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   lookup-table player evolved offline by Host_Tools/evolve.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __EVOLVED_H
+#define __EVOLVED_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define EVOLVED_ROUNDS			2		// Rounds of memory, 4 bits each (own hand, opponent's hand). At most 2: the context is a byte
+#define EVOLVED_CONTEXTS		(1 << (4 * EVOLVED_ROUNDS))		// Table entries, one per context
+#define EVOLVED_TABLE_BYTES		(EVOLVED_CONTEXTS / 4)			// Entries are 2 bits, 4 per byte
+#define EVOLVED_UNKNOWN			3		// Hand code of a round not played yet or of an unknown hand
+#define EVOLVED_RANDOM			3		// Entry code: play a random hand
+
+
+// Typedefs
+// Player state. The table is not copied: boards point it at evolved_table in flash
+typedef struct
+{
+	const uint8_t *table;		// EVOLVED_TABLE_BYTES packed entries
+	uint32_t rng;				// xorshift32 state for EVOLVED_RANDOM entries
+	uint8_t context;			// Last rounds, newest in the low nibble: (own << 2) | opp
+} Evolved_State_t;
+
+
+// Global variables
+extern const uint8_t evolved_table[EVOLVED_TABLE_BYTES];	// Generated by Host_Tools/evolve (evolved_table.c)
+
+
+// Function prototypes
+void Evolved_Init(Evolved_State_t *st, const uint8_t *table, uint32_t seed);
+uint8_t Evolved_Pick(Evolved_State_t *st);
+void Evolved_Observe(Evolved_State_t *st, uint8_t own, uint8_t opp);
+
+
+#endif /* __EVOLVED_H */
@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file           : export.h
+  * @brief          : Header for export.c file.
+  *                   This file contains the defines, types and prototypes of the bulk
+  *                   export of the round history over UART: CRC-checked blocks sent
+  *                   under a sliding acknowledgement window.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __EXPORT_H
+#define __EXPORT_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+// Data block, board to PC: SOH, export ID, block number, block count, payload bytes used (uint16_t
+// each, LSB first), payload (zero padded), CRC-32 of everything after SOH (LSB first)
+#define EXPORT_SOH				0x01
+#define EXPORT_PAYLOAD			256
+#define EXPORT_HEADER			9
+#define EXPORT_FRAME_SIZE		(EXPORT_HEADER + EXPORT_PAYLOAD + 4)
+#define EXPORT_WINDOW			4		// Blocks sent ahead of the last acknowledgement
+
+// Control frame, PC to board: sync, type, block number, export ID (uint16_t each, LSB first),
+// low half of the CRC-32 of type to ID (LSB first)
+#define EXPORT_SYNC				0xA5
+#define EXPORT_CTRL_SIZE		8
+#define EXPORT_START			'S'		// Resume export ID from the block if it is still held, else start a new one
+#define EXPORT_ACK				'A'		// Every block before this one was received
+#define EXPORT_NAK				'N'		// Send again from this block on (go-back-N)
+#define EXPORT_CANCEL			'C'
+
+
+// Typedefs
+// Sender state
+typedef struct
+{
+	const uint8_t *data;		// Snapshot being exported
+	uint32_t size;				// Its size in bytes
+	uint16_t id;				// Export ID, carried by every block. 0 while no snapshot is held
+	uint16_t blocks;			// Block count
+	uint16_t next;				// Next block to send
+	uint16_t acked;				// Every block before this one was acknowledged
+	uint16_t resent;			// Blocks sent more than once
+	uint8_t active;				// 1 while blocks are left to acknowledge
+	uint8_t ctrl[EXPORT_CTRL_SIZE];		// Control frame being received
+	uint8_t ctrl_len;
+} Export_t;
+
+// Header of a received data block
+typedef struct
+{
+	uint16_t id;
+	uint16_t seq;				// Block number
+	uint16_t blocks;
+	uint16_t used;				// Payload bytes used
+} Export_Block_t;
+
+
+// Function prototypes
+void Export_Init(Export_t *x);
+uint8_t Export_RxByte(Export_t *x, uint8_t byte);
+void Export_Begin(Export_t *x, const uint8_t *data, uint32_t size, uint16_t id);
+uint16_t Export_NextFrame(const Export_t *x, uint8_t frame[EXPORT_FRAME_SIZE]);
+void Export_Sent(Export_t *x);
+void Export_BuildControl(uint8_t frame[EXPORT_CTRL_SIZE], uint8_t type, uint16_t seq, uint16_t id);
+uint8_t Export_CheckBlock(const uint8_t frame[EXPORT_FRAME_SIZE], Export_Block_t *hdr);
+uint32_t Export_Crc32(const uint8_t *data, uint32_t len);
+
+
+#endif /* __EXPORT_H */
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file           : history.h
+  * @brief          : Header for history.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   round-by-round game history packed 4 bits per round in backup
+  *                   SRAM.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define HISTORY_OFFSET			64		// The score text (store_score_in_bSRAM(), at most 63 bytes) sits below the history
+#define HISTORY_BLOCKS			24		// Blocks of the ring. The oldest block is erased when the newest is full:
+												// many short blocks lose few rounds at a time
+#define HISTORY_BLOCK_SIZE		168		// Anchor + nibbles. 24 blocks fill the backup SRAM above HISTORY_OFFSET
+#define HISTORY_SIZE			(HISTORY_BLOCKS * HISTORY_BLOCK_SIZE)
+#define HISTORY_ANCHOR_SIZE		8		// Round number (4 bytes), minute (2 bytes), CRC-16 (2 bytes)
+#define HISTORY_NIBBLES			(2 * (HISTORY_BLOCK_SIZE - HISTORY_ANCHOR_SIZE))	// 320 per block
+
+// Nibble codes. 0 to 8: round played, Nucleo's hand * 3 + Disc's hand (result implied)
+#define HISTORY_ERROR			9		// Round whose result was an error (hands unknown)
+#define HISTORY_RESTART			10		// Board restarted: the anchor minute no longer applies
+#define HISTORY_REPEAT			14		// Followed by a count nibble n (0 to 14): last round played n + 1 more times
+#define HISTORY_EMPTY			15		// Never written. The first one ends the block
+#define HISTORY_REPEAT_MAX		14		// A count of 15 would read as HISTORY_EMPTY
+
+#ifdef HISTORY_HOST_WRITES				// Host checks route every byte write through a hook to tear them
+void History_HostWrite(uint8_t *addr, uint8_t val);
+#define HISTORY_WRITE(addr, val)	History_HostWrite((addr), (val))
+#else
+#define HISTORY_WRITE(addr, val)	(*(addr) = (val))
+#endif
+
+
+// Typedefs
+// Anchor at the start of each block
+typedef struct
+{
+	uint32_t round;				// Number of the first round of the block (rounds since the history was formatted)
+	uint16_t minute;			// Uptime in minutes when the block was opened
+} History_Anchor_t;
+
+// Position in a block and the state the next round is appended against
+typedef struct
+{
+	uint16_t pos;				// First free nibble
+	uint32_t rounds;			// Rounds decoded so far in the block
+	uint8_t last;				// Code of the last round, HISTORY_EMPTY after the anchor or a restart
+	uint8_t literals;			// Literal rounds in a row equal to last
+	uint16_t repeat_pos;		// Count nibble of a trailing HISTORY_REPEAT, 0 if the last item is not one
+} History_Cursor_t;
+
+// Writer state. The history itself is only the HISTORY_SIZE bytes it points to
+typedef struct
+{
+	uint8_t *mem;				// Start of the ring
+	uint8_t block;				// Block being filled
+	History_Anchor_t anchor;	// Its anchor
+	History_Cursor_t cur;
+} History_t;
+
+
+// Function prototypes
+void History_Init(History_t *h, uint8_t *mem, uint16_t minute);
+void History_Record(History_t *h, uint8_t nucleo, uint8_t disc, uint16_t minute);
+uint8_t History_ReadAnchor(const uint8_t *mem, uint8_t block, History_Anchor_t *anchor);
+uint32_t History_Scan(const uint8_t *mem, uint8_t block, History_Cursor_t *cur, uint8_t *codes, uint32_t max_codes);
+uint8_t History_Result(uint8_t code);
+uint32_t History_Replay(const History_t *h, void (*fn)(uint8_t code));
+uint32_t History_Rounds(const History_t *h, uint32_t *first);
+void History_Report(const History_t *h, char *buf);
+
+
+#endif /* __HISTORY_H */
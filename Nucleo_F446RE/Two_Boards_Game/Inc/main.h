@@ -27,6 +27,70 @@
 #define SYSCLK_FREQ_84MHZ		84
 #define SYSCLK_FREQ_120MHZ		120
 #define SYSCLK_FREQ_180MHZ		180
+// CAN Rx FIFO management
+#define CAN_QUIET_DRAINS		32		// IRQ entries in a row with no backlog before leaving burst mode
+#define SLEEP_MSG_WAIT_MS		5		// Light lost: longest wait for the sleep frame to leave its mailbox
+// Dual CAN (CAN1 + CAN2) operation
+#define DUAL_CAN_OFF			0		// CAN1 only
+#define DUAL_CAN_SHARE			1		// Frames alternate between the healthy buses (load sharing)
+#define DUAL_CAN_MIRROR			2		// Every frame is sent on both healthy buses (redundancy)
+#ifndef DUAL_CAN_MODE
+#define DUAL_CAN_MODE			DUAL_CAN_OFF
+#endif
+// CAN frame authentication. Must be the same on both boards
+#define SECURE_CAN				FALSE	// TRUE: hand, result and sleep frames carry a counter and a truncated MAC
+// Nucleo's hand selection: one of the STRATEGY_xxx IDs of strategy.h
+#define NUCLEO_STRATEGY			STRATEGY_RANDOM
+// Player node ID, for a Disc with REFEREE_SESSIONS: hand on 0x49F + PLAYER_NODE, result on 0x111 + PLAYER_NODE
+#define PLAYER_NODE				0		// 0 to 255. 0 is the two board game
+#if PLAYER_NODE != 0 && SECURE_CAN == TRUE
+#error "Only node 0's game frames are secured"
+#endif
+// Round interval. Host_Tools builds a simulation board with it TRUE
+#ifndef ROUND_RATE_CTL
+#define ROUND_RATE_CTL			FALSE	// TRUE: TIM6 period set round by round by rate_ctl.c, FALSE: a round every 4 s
+#endif
+// Time-triggered CAN (tt_sched.c): the cycle and the windows come with Disc's reference frames. Host_Tools
+// builds simulation boards with it TRUE
+#ifndef TT_CAN
+#define TT_CAN					FALSE	// TRUE: the hand goes in Nucleo's window of a cycle, every TT_HAND_MS
+#endif
+#define TT_SLOT					0		// Nucleo's hand window in the schedule
+#define TT_HAND_MS				4000	// A hand every 4 s, as without TT_CAN
+#define TT_BIT_NS				2000	// CAN1 bit time, see CAN1_Init()
+#if TT_CAN == TRUE && (DUAL_CAN_MODE != DUAL_CAN_OFF || ROUND_RATE_CTL == TRUE)
+#error "TT_CAN runs the game on CAN1 alone, at the pace of the cycle"
+#endif
+// Passive spectator (spectator.c): Nucleo stops playing and watches the game bus from CAN silent mode.
+// Host_Tools builds a simulation board with it TRUE
+#ifndef SPECTATOR
+#define SPECTATOR				FALSE	// TRUE: nothing goes on CAN1, rounds, latency and anomalies stream out of USART2 by DMA
+#endif
+#define SPEC_BIT_NS				2000	// CAN1 bit time, see CAN1_Init()
+#if SPECTATOR == TRUE && (DUAL_CAN_MODE != DUAL_CAN_OFF || ROUND_RATE_CTL == TRUE || TT_CAN == TRUE)
+#error "The spectator watches CAN1 and sends nothing"
+#endif
+// Tournament: Disc (TOURNAMENT in its main.h) pairs the player nodes. Nucleo plays node PLAYER_NODE's matches,
+// a hand for each pairing or result that leaves games to play, and no button or TIM6 hands
+#ifndef TOURNAMENT
+#define TOURNAMENT				FALSE	// TRUE: hands follow Disc's pairings and results
+#endif
+#define TOURNEY_PAIRING			0		// First byte of a pairing on the result ID, as in Disc's tourney.h
+#if TOURNAMENT == TRUE && (SECURE_CAN == TRUE || ROUND_RATE_CTL == TRUE || TT_CAN == TRUE || SPECTATOR == TRUE)
+#error "Tournament hands go out as soon as the pairing or the last result is in"
+#endif
+
+
+// Typedefs
+// Counters kept by the CAN Rx path. Index 0/1 of the arrays is FIFO0/FIFO1
+typedef struct
+{
+	uint32_t rx_frames;			// Frames released from both Rx FIFOs
+	uint16_t fifo_full[2];		// FIFO full events (3 frames waiting)
+	uint16_t fifo_overrun[2];	// FIFO overrun events. Each one is a lost frame
+	uint16_t burst_switches;	// Times the catch-all filter was moved to FIFO1 because of a burst
+	uint8_t max_backlog;		// Most frames drained in a single IRQ entry
+} CAN_RxStats_t;
 
 
 #endif /* __MAIN_H */
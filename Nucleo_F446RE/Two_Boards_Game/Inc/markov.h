@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file           : markov.h
+  * @brief          : Header for markov.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   order-k Markov hand predictor.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __MARKOV_H
+#define __MARKOV_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define MARKOV_ORDER			3		// Longest context: opponent's last 3 hands. Tables in markov.c are sized for it
+#define MARKOV_CONTEXTS			40		// (3^(MARKOV_ORDER+1) - 1) / 2 rows of counts, one per context of every order
+#define MARKOV_MIN_SAMPLES		3		// Times a context must have been seen before it is trusted
+#define MARKOV_COUNT_MAX		255		// A row is halved once a count reaches this (recent hands weigh more)
+#define MARKOV_NO_PREDICTION	0xFF
+
+
+// Typedefs
+// Predictor state. Fixed size (about 130 bytes), no dynamic memory
+typedef struct
+{
+	uint8_t counts[MARKOV_CONTEXTS][3];	// Times each hand followed each context
+	uint8_t history;					// Opponent's last MARKOV_ORDER hands as a base-3 number
+	uint8_t seen;						// Opponent hands observed, saturated at MARKOV_ORDER
+	uint8_t predicted;					// Hand predicted by the last pick, MARKOV_NO_PREDICTION if none
+	uint32_t rng;						// xorshift32 state used when no context is trusted yet
+	uint32_t predictions;				// Rounds played on a prediction
+	uint32_t hits;						// Predictions that matched the opponent's hand
+} Markov_State_t;
+
+
+// Function prototypes
+void Markov_Init(Markov_State_t *st, uint32_t seed);
+uint8_t Markov_Pick(Markov_State_t *st);
+void Markov_Observe(Markov_State_t *st, uint8_t opp_hand);
+
+
+#endif /* __MARKOV_H */
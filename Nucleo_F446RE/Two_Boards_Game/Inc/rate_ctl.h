@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file           : rate_ctl.h
+  * @brief          : Header for rate_ctl.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   AIMD controller of the round interval (TIM6 period).
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __RATE_CTL_H
+#define __RATE_CTL_H
+
+
+// Includes
+#include <stdint.h>
+
+
+// Defines
+#define RATE_TICK_HZ			10000	// TIM6 counter clock: SYSCLK / (Prescaler + 1)
+#define RATE_MIN_MHZ			250		// Rounds per 1000 s: never slower than the fixed 4 s period
+#define RATE_MAX_MHZ			200000	// Never faster than a round every 5 ms
+#define RATE_STEP_MHZ			100		// Additive increase per round on time: 10 rounds/s per window
+#define RATE_BACKOFF_NUM		3		// Multiplicative decrease on congestion: rate * 3 / 4
+#define RATE_BACKOFF_DEN		4
+#define RATE_HOLD_ROUNDS		2		// Rounds after a decrease whose signals predate it: ignored
+#define RATE_RTT_TARGET_MS		15		// Hand to result, Disc's UART lines included
+#define RATE_WINDOW				100		// Rounds the target is judged over
+#define RATE_LATE_MAX			1		// Rounds of a window allowed above the target: its p99
+#define RATE_RTT_LOST			0xFFFF	// No result before the next hand
+
+
+// Typedefs
+typedef struct
+{
+	uint32_t rate;				// Rounds per 1000 s
+	uint32_t ssthresh;			// Slow start (rate doubled every round) below it
+	uint8_t tec;				// Transmit error counter at the last round
+	uint8_t hold;				// Rounds left to ignore after a decrease
+	uint8_t started;			// A hand went out: the next call has a round to judge
+	uint8_t window;				// Rounds of the window under way
+	uint8_t late;				// Those above RATE_RTT_TARGET_MS
+	// Counters
+	uint32_t rounds;			// Rounds judged
+	uint32_t decreases;			// Congestion signals acted on
+	uint16_t rtt_max;			// Longest hand to result seen, ms
+} Rate_Ctl_t;
+
+
+// Function prototypes
+void Rate_Init(Rate_Ctl_t *rc);
+uint32_t Rate_Round(Rate_Ctl_t *rc, uint16_t rtt_ms, uint8_t tx_busy, uint8_t tec);
+uint32_t Rate_Period(const Rate_Ctl_t *rc);
+
+
+#endif /* __RATE_CTL_H */
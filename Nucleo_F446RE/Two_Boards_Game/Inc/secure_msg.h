@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file           : secure_msg.h
+  * @brief          : Header for secure_msg.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   secured-message layer (authenticated CAN game frames).
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __SECURE_MSG_H
+#define __SECURE_MSG_H
+
+
+// Includes
+#include "main.h"
+#include "chaskey.h"
+
+
+// Defines
+#define SECURE_TAG_LEN			4		// Bytes of the Chaskey tag kept in the frame (32-bit truncated MAC)
+#define SECURE_OVERHEAD			(1 + SECURE_TAG_LEN)	// Counter low byte + tag appended to the payload
+#define SECURE_MAX_PAYLOAD		(8 - SECURE_OVERHEAD)	// Largest payload that can still be secured
+#define SECURE_ID_COUNT			3		// Secured IDs: 0x49F (hand), 0x111 (result), 0x77B (sleep)
+#define SECURE_BKP_FIRST		0		// First RTC backup register holding a frame counter (one per secured ID)
+
+
+// Typedefs
+// Counters kept by the secured-message layer
+typedef struct
+{
+	uint32_t sealed;			// Frames sent with counter and tag
+	uint32_t accepted;			// Secured frames whose tag and counter checked out
+	uint16_t bad_mac;			// Frames dropped because the tag did not match (forged or corrupted)
+	uint16_t replayed;			// Frames dropped because their counter was not newer than the last one accepted
+	uint16_t too_short;			// Frames of a secured ID dropped because they carried no counter/tag
+} Secure_Stats_t;
+
+
+// Function prototypes
+void Secure_Init(void);
+uint8_t Secure_Seal(CAN_TxHeaderTypeDef *pHeader, uint8_t aData[8]);
+uint8_t Secure_Open(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[8]);
+void Secure_Report(char *buf);
+
+
+#endif /* __SECURE_MSG_H */
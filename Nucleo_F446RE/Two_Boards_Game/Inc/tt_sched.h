@@ -0,0 +1,85 @@
+/**
+  ******************************************************************************
+  * @file           : tt_sched.h
+  * @brief          : Header for tt_sched.c file.
+  *                   This file contains the defines, types and prototypes of the
+  *                   time-triggered CAN schedule (TT_CAN): the windows of a basic
+  *                   cycle for N players and the jitter kept against them.
+  */
+
+/* Define to prevent recursive inclusion */
+#ifndef __TT_SCHED_H
+#define __TT_SCHED_H
+
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Defines
+#define TT_REF_ID				0x010	// Reference message. Bytes 0-1: cycle count, byte 2: cycle in ms, byte 3: players
+#define TT_REF_DLC				4
+#define TT_MAX_PLAYERS			32
+#define TT_MAX_WINDOWS			(TT_MAX_PLAYERS + 2)
+#define TT_TICK_US				100		// Window grain: Nucleo's TIM6 tick
+#define TT_CYCLE_GRAIN_US		1000	// Cycle grain: Disc's TIM6 tick
+#define TT_GUARD_US				200		// Late start a window absorbs: Rx interrupt, timer tick, reference stuffing
+#define TT_FRAME_BITS			135		// 8 byte standard frame, worst stuffing, intermission. Every window fits one
+#define TT_REF_BITS_MIN			76		// Reference frame up to its Rx interrupt (end of EOF), no stuff bit
+
+// Window kinds
+#define TT_WIN_REF				0		// Referee: the reference, then the results of the last cycle's hands back to back
+#define TT_WIN_HAND				1		// Hand of one player
+#define TT_WIN_FREE				2		// Arbitrating window: event frames (stats, queries, sleep)
+
+
+// Typedefs
+typedef struct
+{
+	uint32_t start_us;			// From the SOF of the reference
+	uint32_t len_us;
+	uint8_t kind;				// TT_WIN_xxx
+	uint8_t player;				// Player of a hand window
+} Tt_Window_t;
+
+// Basic cycle: referee window, one hand window per player, arbitrating window up to the end
+// of the cycle
+typedef struct
+{
+	uint32_t cycle_us;
+	uint32_t bit_ns;
+	uint32_t frame_us;			// Worst-case frame time: a frame that starts at t is off the bus by t + frame_us
+	uint8_t players;
+	uint8_t windows;
+	Tt_Window_t win[TT_MAX_WINDOWS];
+} Tt_Sched_t;
+
+// Offsets from the SOF of the reference, in CAN bit times (TTCM time stamps)
+typedef struct
+{
+	uint32_t cycles;			// Cycles measured: reference time stamped
+	uint32_t late;				// Cycles whose reference did not go out (referee busy)
+	int32_t period_min;			// Reference to reference, minus the cycle
+	int32_t period_max;
+	uint16_t result_min, result_max;
+	uint16_t hand_min, hand_max;
+	uint32_t results, hands;
+	uint32_t outside;			// Results and hands not wholly within their window
+	uint16_t ref;				// Time stamp of the last reference
+	uint8_t ref_valid;			// The last cycle's reference was stamped
+} Tt_Jitter_t;
+
+
+// Function prototypes
+uint32_t Tt_Build(Tt_Sched_t *s, uint8_t players, uint32_t bit_ns, uint32_t cycle_us);
+const Tt_Window_t* Tt_Window(const Tt_Sched_t *s, uint8_t kind, uint8_t player);
+uint32_t Tt_Arm_Us(const Tt_Sched_t *s, uint8_t player);
+void Tt_Jitter_Init(Tt_Jitter_t *j);
+void Tt_Jitter_Ref(Tt_Jitter_t *j, const Tt_Sched_t *s, uint16_t stamp, uint32_t missed);
+void Tt_Jitter_Result(Tt_Jitter_t *j, const Tt_Sched_t *s, uint16_t stamp);
+void Tt_Jitter_Hand(Tt_Jitter_t *j, const Tt_Sched_t *s, uint8_t player, uint16_t stamp);
+void Tt_Report(const Tt_Jitter_t *j, const Tt_Sched_t *s, char *buf);
+
+
+#endif /* __TT_SCHED_H */
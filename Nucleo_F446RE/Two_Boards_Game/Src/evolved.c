@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    evolved.c
+  * @author  Moe2Code
+  * @brief   Lookup-table player. The hands of the last EVOLVED_ROUNDS rounds index a table
+  *          of 2-bit entries (hand to play, or EVOLVED_RANDOM), so a pick is one table read.
+  *          The table is evolved offline against the built-in strategies and recorded
+  *          opponents by Host_Tools/evolve, which writes it to evolved_table.c.
+  *          The following is conducted in source file:
+  *          + Walking the packed table from the round context
+  *          + Tracking of the round context
+  */
+
+// Includes
+#include "evolved.h"
+
+
+/**
+  * @brief  Binds the player to a table and clears its history
+  * @param  st pointer to the player state
+  * @param  table EVOLVED_TABLE_BYTES packed entries (evolved_table on the boards)
+  * @param  seed seed of the EVOLVED_RANDOM entries
+  * @retval None
+  */
+
+void Evolved_Init(Evolved_State_t *st, const uint8_t *table, uint32_t seed)
+{
+	st->table = table;
+	st->rng = (seed != 0) ? seed : 0x2545F491;
+	st->context = (uint8_t)(EVOLVED_CONTEXTS - 1);		// Every round unknown
+}
+
+
+/**
+  * @brief  Returns the hand of the table entry of the current context
+  * @param  st pointer to the player state
+  * @retval Hand: 0 = Rock, 1 = Paper, 2 = Scissors
+  */
+
+uint8_t Evolved_Pick(Evolved_State_t *st)
+{
+	uint8_t entry = (st->table[st->context >> 2] >> (2 * (st->context & 3))) & 3;
+
+	if(entry != EVOLVED_RANDOM)
+	{
+		return entry;
+	}
+
+	st->rng ^= st->rng << 13;
+	st->rng ^= st->rng >> 17;
+	st->rng ^= st->rng << 5;
+
+	return st->rng % 3;
+}
+
+
+/**
+  * @brief  Shifts the round just played into the context
+  * @param  st pointer to the player state
+  * @param  own hand played
+  * @param  opp opponent's hand. Unknown hands (> 2) are kept as EVOLVED_UNKNOWN
+  * @retval None
+  */
+
+void Evolved_Observe(Evolved_State_t *st, uint8_t own, uint8_t opp)
+{
+	own = (own > 2) ? EVOLVED_UNKNOWN : own;
+	opp = (opp > 2) ? EVOLVED_UNKNOWN : opp;
+
+	st->context = (uint8_t)(((st->context << 4) | (own << 2) | opp) & (EVOLVED_CONTEXTS - 1));
+}
@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file    evolved_table.c
+  * @author  Moe2Code
+  * @brief   Lookup table of the evolved player (evolved.c), kept in flash.
+  *          Generated by Host_Tools/evolve (64 tables, 100 generations); do not edit.
+  *          Edge (wins - losses per round) on fresh seeds: mean +0.5923
+  *          random     -0.0005
+  *          cycle      +0.9921
+  *          frequency  +0.6574
+  *          wsls       +0.9986
+  *          markov     -0.0929
+  *          qpred      +0.9990
+  */
+
+// Includes
+#include "evolved.h"
+
+
+// Global variables
+// Entry of context c: bits 2*(c % 4) of byte c / 4. 0-2 = hand, 3 = random hand
+const uint8_t evolved_table[EVOLVED_TABLE_BYTES] =
+{
+	0x49, 0xB5, 0x84, 0x81, 0xBC, 0xF8, 0x2F, 0xEC, 0xBE, 0x12, 0x46, 0x5E, 0x20, 0x53, 0x81, 0x5E,
+	0xA2, 0x3C, 0xF0, 0xE1, 0x0D, 0xFD, 0x1F, 0x07, 0xB7, 0x7B, 0x0B, 0xAD, 0x01, 0x25, 0x25, 0x74,
+	0xCD, 0xB9, 0xFC, 0x1A, 0x1F, 0xFC, 0x7B, 0x63, 0x6E, 0x8F, 0xE5, 0x76, 0x24, 0x28, 0xAB, 0x47,
+	0x86, 0x5D, 0x0A, 0xBF, 0xFD, 0xB4, 0x57, 0x0A, 0x8C, 0x63, 0x33, 0x2E, 0xE6, 0xA7, 0x9C, 0x0A,
+};
@@ -0,0 +1,280 @@
+/**
+  ******************************************************************************
+  * @file    export.c
+  * @author  Moe2Code
+  * @brief   Bulk export of the round history over UART in the spirit of YMODEM-G and
+  *          ZMODEM: fixed-size CRC-32 blocks stream back to back (by DMA on the board)
+  *          while the PC acknowledges them, and a lost or damaged block makes the sender
+  *          go back to it. The following is conducted in source file:
+  *          + Parsing of the PC's control frames (start/resume, ack, nak, cancel)
+  *          + Sliding window of EXPORT_WINDOW blocks ahead of the last acknowledgement
+  *          + Building and checking of data blocks (shared with Host_Tools/export_rx)
+  * @note    The board has no timer in the loop: the PC drives recovery. It resends its
+  *          last acknowledgement, or resumes, whenever the stream stops
+  */
+
+// Includes
+#include <string.h>
+#include "export.h"
+
+
+// Function prototypes
+static void Export_Control(Export_t *x, uint8_t type, uint16_t seq, uint16_t id);
+
+
+/**
+  * @brief  Clears the sender state. No snapshot is held
+  * @param  x pointer to the sender state
+  * @retval None
+  */
+
+void Export_Init(Export_t *x)
+{
+	memset(x, 0, sizeof(Export_t));
+}
+
+
+/**
+  * @brief  Feeds a byte received from the PC. A complete, valid control frame is acted on
+  * @param  x pointer to the sender state
+  * @param  byte byte received
+  * @retval EXPORT_START if a new export was asked for: the caller takes a snapshot and calls
+  * 		Export_Begin(). 0 otherwise
+  */
+
+uint8_t Export_RxByte(Export_t *x, uint8_t byte)
+{
+	uint16_t crc;
+
+	if(x->ctrl_len == 0 && byte != EXPORT_SYNC)		// Out of sync: wait for the next frame
+	{
+		return 0;
+	}
+
+	x->ctrl[x->ctrl_len++] = byte;
+
+	if(x->ctrl_len < EXPORT_CTRL_SIZE)
+	{
+		return 0;
+	}
+
+	x->ctrl_len = 0;
+	crc = (uint16_t)Export_Crc32(&x->ctrl[1], 5);
+
+	if(x->ctrl[6] != (crc & 0xFF) || x->ctrl[7] != (crc >> 8))
+	{
+		return 0;
+	}
+
+	if(x->ctrl[1] == EXPORT_START && (x->id == 0 || (x->ctrl[4] | (x->ctrl[5] << 8)) != x->id))
+	{
+		return EXPORT_START;
+	}
+
+	Export_Control(x, x->ctrl[1], x->ctrl[2] | (x->ctrl[3] << 8), x->ctrl[4] | (x->ctrl[5] << 8));
+
+	return 0;
+}
+
+
+/**
+  * @brief  Starts a new export from block 0
+  * @param  x pointer to the sender state
+  * @param  data snapshot to export. Must stay unchanged until the next Export_Begin()
+  * @param  size its size in bytes
+  * @param  id export ID. Should differ from the previous one, also across resets (0 is not used)
+  * @retval None
+  */
+
+void Export_Begin(Export_t *x, const uint8_t *data, uint32_t size, uint16_t id)
+{
+	x->data = data;
+	x->size = size;
+	x->id = (id != 0) ? id : 1;
+	x->blocks = (size + EXPORT_PAYLOAD - 1) / EXPORT_PAYLOAD;
+	x->next = 0;
+	x->acked = 0;
+	x->resent = 0;
+	x->active = (x->blocks > 0);
+}
+
+
+/**
+  * @brief  Builds the next block to send, if the window allows it
+  * @param  x pointer to the sender state
+  * @param  frame receives the block
+  * @retval Frame length, 0 if nothing is to be sent now. Call Export_Sent() once it is on its way
+  */
+
+uint16_t Export_NextFrame(const Export_t *x, uint8_t frame[EXPORT_FRAME_SIZE])
+{
+	uint32_t offset = (uint32_t)x->next * EXPORT_PAYLOAD, crc;
+	uint16_t used;
+
+	if(x->active == 0 || x->next >= x->blocks || x->next >= x->acked + EXPORT_WINDOW)
+	{
+		return 0;
+	}
+
+	used = (x->size - offset > EXPORT_PAYLOAD) ? EXPORT_PAYLOAD : x->size - offset;
+
+	frame[0] = EXPORT_SOH;
+	frame[1] = (uint8_t)x->id;
+	frame[2] = (uint8_t)(x->id >> 8);
+	frame[3] = (uint8_t)x->next;
+	frame[4] = (uint8_t)(x->next >> 8);
+	frame[5] = (uint8_t)x->blocks;
+	frame[6] = (uint8_t)(x->blocks >> 8);
+	frame[7] = (uint8_t)used;
+	frame[8] = (uint8_t)(used >> 8);
+	memcpy(&frame[EXPORT_HEADER], x->data + offset, used);
+	memset(&frame[EXPORT_HEADER + used], 0, EXPORT_PAYLOAD - used);
+
+	crc = Export_Crc32(&frame[1], EXPORT_HEADER - 1 + EXPORT_PAYLOAD);
+
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		frame[EXPORT_HEADER + EXPORT_PAYLOAD + i] = (uint8_t)(crc >> (8 * i));
+	}
+
+	return EXPORT_FRAME_SIZE;
+}
+
+
+/**
+  * @brief  Moves past the block built by Export_NextFrame()
+  * @param  x pointer to the sender state
+  * @retval None
+  */
+
+void Export_Sent(Export_t *x)
+{
+	x->next++;
+}
+
+
+/**
+  * @brief  Builds a control frame (PC side)
+  * @param  frame receives the frame
+  * @param  type EXPORT_START, EXPORT_ACK, EXPORT_NAK or EXPORT_CANCEL
+  * @param  seq block number
+  * @param  id export ID (0 to ask for a new export)
+  * @retval None
+  */
+
+void Export_BuildControl(uint8_t frame[EXPORT_CTRL_SIZE], uint8_t type, uint16_t seq, uint16_t id)
+{
+	uint16_t crc;
+
+	frame[0] = EXPORT_SYNC;
+	frame[1] = type;
+	frame[2] = (uint8_t)seq;
+	frame[3] = (uint8_t)(seq >> 8);
+	frame[4] = (uint8_t)id;
+	frame[5] = (uint8_t)(id >> 8);
+
+	crc = (uint16_t)Export_Crc32(&frame[1], 5);
+	frame[6] = (uint8_t)crc;
+	frame[7] = (uint8_t)(crc >> 8);
+}
+
+
+/**
+  * @brief  Checks a received data block (PC side)
+  * @param  frame EXPORT_FRAME_SIZE bytes starting with EXPORT_SOH
+  * @param  hdr receives the block header
+  * @retval 1 if the block is valid, 0 otherwise
+  */
+
+uint8_t Export_CheckBlock(const uint8_t frame[EXPORT_FRAME_SIZE], Export_Block_t *hdr)
+{
+	const uint8_t *c = &frame[EXPORT_HEADER + EXPORT_PAYLOAD];
+	uint32_t crc = c[0] | (c[1] << 8) | ((uint32_t)c[2] << 16) | ((uint32_t)c[3] << 24);
+
+	if(frame[0] != EXPORT_SOH || Export_Crc32(&frame[1], EXPORT_HEADER - 1 + EXPORT_PAYLOAD) != crc)
+	{
+		return 0;
+	}
+
+	hdr->id = frame[1] | (frame[2] << 8);
+	hdr->seq = frame[3] | (frame[4] << 8);
+	hdr->blocks = frame[5] | (frame[6] << 8);
+	hdr->used = frame[7] | (frame[8] << 8);
+
+	return (hdr->seq < hdr->blocks && hdr->used <= EXPORT_PAYLOAD);
+}
+
+
+/**
+  * @brief  CRC-32 (IEEE 802.3, as in ZMODEM and zip), 4 bits per step from a 16-entry table
+  * @param  data bytes to check
+  * @param  len number of bytes
+  * @retval CRC
+  */
+
+uint32_t Export_Crc32(const uint8_t *data, uint32_t len)
+{
+	static const uint32_t table[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, \
+									   0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, \
+									   0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(uint32_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ table[crc & 0xF];
+		crc = (crc >> 4) ^ table[crc & 0xF];
+	}
+
+	return ~crc;
+}
+
+
+/**
+  * @brief  Acts on a control frame of the current export
+  * @param  x pointer to the sender state
+  * @param  type control frame type
+  * @param  seq block number
+  * @param  id export ID
+  * @retval None
+  */
+
+static void Export_Control(Export_t *x, uint8_t type, uint16_t seq, uint16_t id)
+{
+	if(type == EXPORT_CANCEL)
+	{
+		x->active = 0;
+		return;
+	}
+
+	if(id != x->id || seq > x->blocks)		// Other (older) export, or not a block of this one
+	{
+		return;
+	}
+
+	if(seq > x->acked)
+	{
+		x->acked = seq;
+	}
+
+	if(type == EXPORT_NAK || type == EXPORT_START)		// Go back. Resuming also reopens a finished export
+	{
+		if(seq < x->next)
+		{
+			x->resent += x->next - seq;
+		}
+
+		x->next = seq;
+		x->active = (seq < x->blocks);
+	}
+
+	if(x->next < x->acked)
+	{
+		x->next = x->acked;
+	}
+
+	if(x->acked >= x->blocks)
+	{
+		x->active = 0;
+	}
+}
@@ -0,0 +1,454 @@
+/**
+  ******************************************************************************
+  * @file    history.c
+  * @author  Moe2Code
+  * @brief   Round-by-round game history in Nucleo's backup SRAM, one nibble per round
+  *          (Nucleo's hand * 3 + Disc's hand; the result follows from the hands). Runs of
+  *          the same round are run-length coded. The ring of blocks keeps 7280 to 7620 of
+  *          the random rounds the game plays once it has wrapped, more with runs. The
+  *          following is conducted in source file:
+  *          + Recovery of the write position from the block anchors after a reset
+  *          + Appending of rounds, restarts and runs
+  *          + Opening of a new block (sequence/time anchor) over the oldest one
+  *          + Decoding of a block (shared with Host_Tools/history_tool)
+  *          + Replay of the rounds kept, oldest first (rebuilds the range index, fenwick.c)
+  * @note    Every round is committed by a single byte write, and a block anchor is valid
+  *          only once its CRC is written last. A reset in the middle of an update can only
+  *          lose the round being recorded: History_Init() ends the block at the first
+  *          free nibble and clears anything a torn write left after it
+  */
+
+// Includes
+#include <stdio.h>
+#include "history.h"
+
+
+// Function prototypes
+static uint8_t History_Nibble(const uint8_t *blk, uint16_t i);
+static void History_SetNibble(uint8_t *blk, uint16_t i, uint8_t v);
+static uint16_t History_Crc16(const uint8_t *data, uint8_t len);
+static void History_Open(History_t *h, uint8_t block, uint32_t round, uint16_t minute);
+static uint32_t History_Walk(const uint8_t *mem, uint8_t block, History_Cursor_t *cur, uint8_t *codes, uint32_t max_codes, \
+							 void (*fn)(uint8_t code));
+
+
+/**
+  * @brief  Finds the newest block and the end of its rounds, then marks the restart.
+  * 		Formats the ring if no block anchor is valid (first run, or power was lost)
+  * @param  h pointer to the writer state
+  * @param  mem start of the ring (HISTORY_SIZE bytes)
+  * @param  minute current uptime in minutes
+  * @retval None
+  */
+
+void History_Init(History_t *h, uint8_t *mem, uint16_t minute)
+{
+	History_Anchor_t anchor;
+	uint8_t found = 0, *blk;
+
+	h->mem = mem;
+
+	for(uint8_t b = 0; b < HISTORY_BLOCKS; b++)
+	{
+		if(History_ReadAnchor(mem, b, &anchor) && (found == 0 || anchor.round > h->anchor.round))
+		{
+			h->block = b;
+			h->anchor = anchor;
+			found = 1;
+		}
+	}
+
+	if(found == 0)
+	{
+		History_Open(h, 0, 0, minute);
+		return;
+	}
+
+	History_Scan(mem, h->block, &h->cur, NULL, 0);
+
+	blk = mem + h->block * HISTORY_BLOCK_SIZE;
+
+	for(uint16_t i = h->cur.pos; i < HISTORY_NIBBLES; i++)		// Leftovers of a torn write
+	{
+		if(History_Nibble(blk, i) != HISTORY_EMPTY)
+		{
+			History_SetNibble(blk, i, HISTORY_EMPTY);
+		}
+	}
+
+	if(h->cur.pos < HISTORY_NIBBLES)		// A full block gets a fresh anchor with the next round instead
+	{
+		History_SetNibble(blk, h->cur.pos, HISTORY_RESTART);
+		h->cur.pos++;
+		h->cur.last = HISTORY_EMPTY;
+		h->cur.literals = 0;
+		h->cur.repeat_pos = 0;
+	}
+}
+
+
+/**
+  * @brief  Appends a round. The third identical round in a row starts a run, which later
+  * 		identical rounds extend in place
+  * @param  h pointer to the writer state
+  * @param  nucleo Nucleo's hand
+  * @param  disc Disc's hand. Either hand > 2 records an error round
+  * @param  minute current uptime in minutes, stored if the round opens a new block
+  * @retval None
+  */
+
+void History_Record(History_t *h, uint8_t nucleo, uint8_t disc, uint16_t minute)
+{
+	History_Cursor_t *c = &h->cur;
+	uint8_t *blk = h->mem + h->block * HISTORY_BLOCK_SIZE;
+	uint8_t code = (nucleo > 2 || disc > 2) ? HISTORY_ERROR : nucleo * 3 + disc;
+	uint8_t count = 0;
+
+	if(code == c->last && c->repeat_pos != 0 && (count = History_Nibble(blk, c->repeat_pos)) < HISTORY_REPEAT_MAX)
+	{
+		History_SetNibble(blk, c->repeat_pos, count + 1);
+
+	}else if(code == c->last && (c->literals >= 2 || c->repeat_pos != 0) && c->pos + 2 <= HISTORY_NIBBLES)
+	{
+		History_SetNibble(blk, c->pos + 1, 0);				// Count first: a torn run leaves a free nibble at pos
+		History_SetNibble(blk, c->pos, HISTORY_REPEAT);
+		c->repeat_pos = c->pos + 1;
+		c->literals = 0;
+		c->pos += 2;
+
+	}else
+	{
+		if(c->pos >= HISTORY_NIBBLES)
+		{
+			History_Open(h, (h->block + 1) % HISTORY_BLOCKS, h->anchor.round + c->rounds, minute);
+			blk = h->mem + h->block * HISTORY_BLOCK_SIZE;
+		}
+
+		History_SetNibble(blk, c->pos, code);
+		c->literals = (code == c->last) ? c->literals + 1 : 1;
+		c->last = code;
+		c->repeat_pos = 0;
+		c->pos++;
+	}
+
+	c->rounds++;
+}
+
+
+/**
+  * @brief  Reads and checks the anchor of a block
+  * @param  mem start of the ring
+  * @param  block block index
+  * @param  anchor receives the anchor
+  * @retval 1 if the anchor is valid, 0 otherwise
+  */
+
+uint8_t History_ReadAnchor(const uint8_t *mem, uint8_t block, History_Anchor_t *anchor)
+{
+	const uint8_t *blk = mem + block * HISTORY_BLOCK_SIZE;
+
+	if(History_Crc16(blk, 6) != (blk[6] | (blk[7] << 8)))
+	{
+		return 0;
+	}
+
+	anchor->round = blk[0] | (blk[1] << 8) | ((uint32_t)blk[2] << 16) | ((uint32_t)blk[3] << 24);
+	anchor->minute = blk[4] | (blk[5] << 8);
+
+	return 1;
+}
+
+
+/**
+  * @brief  Decodes a block from its first nibble up to the first free, torn or unknown one
+  * @param  mem start of the ring
+  * @param  block block index
+  * @param  cur receives the end of the block and the state to append against
+  * @param  codes receives the decoded entries: round codes (runs expanded) and HISTORY_RESTART.
+  * 		May be NULL
+  * @param  max_codes size of codes
+  * @retval Number of entries in the block (more than max_codes if codes was too small)
+  */
+
+uint32_t History_Scan(const uint8_t *mem, uint8_t block, History_Cursor_t *cur, uint8_t *codes, uint32_t max_codes)
+{
+	return History_Walk(mem, block, cur, codes, max_codes, NULL);
+}
+
+
+/**
+  * @brief  Passes every round kept to a function, oldest first. Rounds follow each other
+  * 		without gaps from the oldest round kept (History_Rounds()); restarts are skipped
+  * @param  h pointer to the writer state
+  * @param  fn function called with the code of each round (0 to 8, or HISTORY_ERROR)
+  * @retval Rounds replayed
+  */
+
+uint32_t History_Replay(const History_t *h, void (*fn)(uint8_t code))
+{
+	History_Anchor_t anchor;
+	History_Cursor_t cur;
+	uint32_t rounds = 0;
+	uint8_t b;
+
+	for(uint8_t i = 1; i <= HISTORY_BLOCKS; i++)		// Blocks are opened in ring order: the oldest follows the newest
+	{
+		b = (h->block + i) % HISTORY_BLOCKS;
+
+		if(History_ReadAnchor(h->mem, b, &anchor))
+		{
+			History_Walk(h->mem, b, &cur, NULL, 0, fn);
+			rounds += cur.rounds;
+		}
+	}
+
+	return rounds;
+}
+
+
+/**
+  * @brief  Returns the game result of a round code
+  * @param  code round code (0 to 8, or HISTORY_ERROR)
+  * @retval 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error
+  */
+
+uint8_t History_Result(uint8_t code)
+{
+	static const uint8_t result[3] = {3, 1, 2};		// Indexed by (nucleo - disc + 3) % 3
+
+	if(code > 8)
+	{
+		return 4;
+	}
+
+	return result[(code / 3 - code % 3 + 3) % 3];
+}
+
+
+/**
+  * @brief  Returns the number of rounds kept, from the oldest valid block to now
+  * @param  h pointer to the writer state
+  * @param  first receives the number of the oldest round kept. May be NULL
+  * @retval Rounds kept
+  */
+
+uint32_t History_Rounds(const History_t *h, uint32_t *first)
+{
+	History_Anchor_t anchor;
+	uint32_t oldest = h->anchor.round;
+
+	for(uint8_t b = 0; b < HISTORY_BLOCKS; b++)
+	{
+		if(History_ReadAnchor(h->mem, b, &anchor) && anchor.round < oldest)
+		{
+			oldest = anchor.round;
+		}
+	}
+
+	if(first != NULL)
+	{
+		*first = oldest;
+	}
+
+	return h->anchor.round + h->cur.rounds - oldest;
+}
+
+
+/**
+  * @brief  Prints the fill state of the history into a buffer
+  * @param  h pointer to the writer state
+  * @param  buf buffer of at least 100 bytes
+  * @retval None
+  */
+
+void History_Report(const History_t *h, char *buf)
+{
+	uint32_t first, kept = History_Rounds(h, &first);
+
+	sprintf(buf, "HISTORY %lu rounds kept from round %lu, block %u: %u/%u nibbles\r\n", (unsigned long)kept, \
+			(unsigned long)first, h->block, h->cur.pos, HISTORY_NIBBLES);
+}
+
+
+/**
+  * @brief  Returns nibble i of a block (low nibble of a byte first)
+  * @param  blk start of the block
+  * @param  i nibble index
+  * @retval Nibble
+  */
+
+static uint8_t History_Nibble(const uint8_t *blk, uint16_t i)
+{
+	return (blk[HISTORY_ANCHOR_SIZE + i / 2] >> (4 * (i % 2))) & 0xF;
+}
+
+
+/**
+  * @brief  Writes nibble i of a block with a single byte write
+  * @param  blk start of the block
+  * @param  i nibble index
+  * @param  v nibble value
+  * @retval None
+  */
+
+static void History_SetNibble(uint8_t *blk, uint16_t i, uint8_t v)
+{
+	uint8_t *p = &blk[HISTORY_ANCHOR_SIZE + i / 2];
+
+	HISTORY_WRITE(p, (uint8_t)((*p & (0xF0 >> (4 * (i % 2)))) | (v << (4 * (i % 2)))));
+}
+
+
+/**
+  * @brief  CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF)
+  * @param  data bytes to check
+  * @param  len number of bytes
+  * @retval CRC
+  */
+
+static uint16_t History_Crc16(const uint8_t *data, uint8_t len)
+{
+	uint16_t crc = 0xFFFF;
+
+	for(uint8_t i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+
+		for(uint8_t b = 0; b < 8; b++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+
+/**
+  * @brief  Erases a block and writes its anchor. The old anchor is invalidated before its
+  * 		rounds are erased, and the new one becomes valid with its CRC, written last
+  * @param  h pointer to the writer state
+  * @param  block block to open
+  * @param  round number of the next round
+  * @param  minute current uptime in minutes
+  * @retval None
+  */
+
+static void History_Open(History_t *h, uint8_t block, uint32_t round, uint16_t minute)
+{
+	uint8_t *blk = h->mem + block * HISTORY_BLOCK_SIZE;
+	uint8_t fields[6] = {round, round >> 8, round >> 16, round >> 24, minute, minute >> 8};
+	uint16_t crc = History_Crc16(fields, 6);
+
+	for(uint16_t i = 0; i < HISTORY_BLOCK_SIZE; i++)	// All ones is never a valid anchor
+	{
+		if(blk[i] != 0xFF)
+		{
+			HISTORY_WRITE(&blk[i], 0xFF);
+		}
+	}
+
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		HISTORY_WRITE(&blk[i], fields[i]);
+	}
+
+	HISTORY_WRITE(&blk[6], crc & 0xFF);
+	HISTORY_WRITE(&blk[7], crc >> 8);
+
+	h->block = block;
+	h->anchor.round = round;
+	h->anchor.minute = minute;
+	h->cur.pos = 0;
+	h->cur.rounds = 0;
+	h->cur.last = HISTORY_EMPTY;
+	h->cur.literals = 0;
+	h->cur.repeat_pos = 0;
+}
+
+
+/**
+  * @brief  Decodes a block from its first nibble up to the first free, torn or unknown one
+  * @param  mem start of the ring
+  * @param  block block index
+  * @param  cur receives the end of the block and the state to append against
+  * @param  codes receives the decoded entries: round codes (runs expanded) and HISTORY_RESTART.
+  * 		May be NULL
+  * @param  max_codes size of codes
+  * @param  fn function called with the code of each round, runs expanded. May be NULL
+  * @retval Number of entries in the block (more than max_codes if codes was too small)
+  */
+
+static uint32_t History_Walk(const uint8_t *mem, uint8_t block, History_Cursor_t *cur, uint8_t *codes, uint32_t max_codes, \
+							 void (*fn)(uint8_t code))
+{
+	const uint8_t *blk = mem + block * HISTORY_BLOCK_SIZE;
+	uint32_t n = 0;
+	uint8_t v, count;
+
+	cur->pos = 0;
+	cur->rounds = 0;
+	cur->last = HISTORY_EMPTY;
+	cur->literals = 0;
+	cur->repeat_pos = 0;
+
+	while(cur->pos < HISTORY_NIBBLES)
+	{
+		v = History_Nibble(blk, cur->pos);
+
+		if(v <= HISTORY_ERROR)
+		{
+			cur->literals = (v == cur->last) ? cur->literals + 1 : 1;
+			cur->last = v;
+			cur->repeat_pos = 0;
+			cur->rounds++;
+			cur->pos++;
+
+			if(codes != NULL && n < max_codes)
+			{
+				codes[n] = v;
+			}
+			if(fn != NULL)
+			{
+				fn(v);
+			}
+			n++;
+		}else if(v == HISTORY_RESTART)
+		{
+			cur->last = HISTORY_EMPTY;
+			cur->literals = 0;
+			cur->repeat_pos = 0;
+			cur->pos++;
+
+			if(codes != NULL && n < max_codes)
+			{
+				codes[n] = v;
+			}
+			n++;
+		}else if(v == HISTORY_REPEAT && cur->last != HISTORY_EMPTY && cur->pos + 1 < HISTORY_NIBBLES && \
+				 (count = History_Nibble(blk, cur->pos + 1)) <= HISTORY_REPEAT_MAX)
+		{
+			for(uint8_t k = 0; k <= count; k++, n++)
+			{
+				if(codes != NULL && n < max_codes)
+				{
+					codes[n] = cur->last;
+				}
+				if(fn != NULL)
+				{
+					fn(cur->last);
+				}
+			}
+
+			cur->rounds += count + 1;
+			cur->literals = 0;
+			cur->repeat_pos = cur->pos + 1;
+			cur->pos += 2;
+		}else
+		{
+			break;
+		}
+	}
+
+	return n;
+}
@@ -12,7 +12,10 @@
 
 // Global variables shared with other modules
 extern CAN_HandleTypeDef hcan1;
+extern CAN_HandleTypeDef hcan2;
 extern TIM_HandleTypeDef htimer6;
+extern UART_HandleTypeDef huart2;
+extern DMA_HandleTypeDef hdma_usart2_tx;
 
 
 /**
@@ -70,6 +73,50 @@ void CAN1_SCE_IRQHandler(void)
 }
 
 
+/**
+  * @brief This function handles interrupt request specifically for
+  * message transmission via CAN2 peripheral (dual-bus mode)
+  */
+
+void CAN2_TX_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * messages received in CAN2 FIFO0 (dual-bus mode)
+  */
+
+void CAN2_RX0_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * messages received in CAN2 FIFO1 (dual-bus mode)
+  */
+
+void CAN2_RX1_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * status changes and errors (SCE) on CAN2 (dual-bus mode)
+  */
+
+void CAN2_SCE_IRQHandler(void)
+{
+	HAL_CAN_IRQHandler(&hcan2);
+}
+
+
 /**
   * @brief This function handles interrupt request specifically for
   * the basic timer, TIM6
@@ -81,6 +128,28 @@ void TIM6_DAC_IRQHandler(void)
 }
 
 
+/**
+  * @brief This function handles interrupt request specifically for
+  * USART2: bytes received from the PC and the end of each DMA transmission
+  */
+
+void USART2_IRQHandler(void)
+{
+	HAL_UART_IRQHandler(&huart2);
+}
+
+
+/**
+  * @brief This function handles interrupt request specifically for
+  * DMA1 Stream 6, which feeds the history export blocks to USART2
+  */
+
+void DMA1_Stream6_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
+
+
 /**
   * @brief This function handles interrupt request specifically for
   * EXTI Line 4 which GPIO PC4 is connected to. PC4 is used to detect
@@ -12,10 +12,27 @@
   *          + Transmission of the rolling game score to Discovery via CAN when requested
   *          + Low power management of both boards
   *          + Preservation of rolling game score in backup SRAM
+  *          + Round-by-round game history in backup SRAM (history.c)
+  *          + Round interval following the bus and Disc (rate_ctl.c, ROUND_RATE_CTL)
+  *          + Time-triggered CAN (TT_CAN): the hand goes in Nucleo's window of the cycle
+  *            Disc's reference frame starts
+  *          + Passive spectator mode (SPECTATOR): CAN1 silent, the game frames go to
+  *            spectator.c and its lines out of USART2 by DMA, no game
+  *          + Tournament (TOURNAMENT): matches against other player nodes, paired and
+  *            refereed by Disc, a hand as soon as the pairing or the last result is in
   */
 
 // Includes
 #include "main.h"
+#include "can_bus.h"
+#include "secure_msg.h"
+#include "strategy.h"
+#include "history.h"
+#include "fenwick.h"
+#include "export.h"
+#include "rate_ctl.h"
+#include "tt_sched.h"
+#include "spectator.h"
 
 
 // Global variables
@@ -28,6 +45,30 @@ uint8_t disc_wins = 0;					// To store the number of wins for Discovery so far
 uint8_t tie_count = 0;					// To store the number of tie games occurred so far
 uint8_t game_err= 0;					// To store the number of errors occurred for game result
 uint8_t *pBKPSRAMbase = (uint8_t*)BKPSRAM_BASE;	  // Pointing to the base address of the backup SRAM
+uint8_t result_pending = FALSE;			// Set when a hand is sent and cleared once its game result is received
+uint8_t lost_results = 0;				// Hands sent for which no game result was ever received
+uint8_t last_hand = 0;					// Hand of the last frame sent. Tells Disc's hand once the result is in
+Strategy_Player_t nucleo_player = {0};	// Picks Nucleo's hands with the strategy set by NUCLEO_STRATEGY
+History_t round_history;				// Writer of the round history kept in backup SRAM above the score text
+Fenwick_Index_t round_index;			// Range counts over the recent rounds, rebuilt from the history at boot
+DMA_HandleTypeDef hdma_usart2_tx = {0};	// DMA1 Stream 6 handle. Streams the history export blocks to USART2
+Export_t history_export;				// Bulk export of the round history to the PC (Host_Tools/export_rx)
+uint8_t export_snapshot[HISTORY_SIZE];	// History as it was when the export started
+uint8_t export_frame[EXPORT_FRAME_SIZE];	// Block being sent by DMA
+uint8_t uart_rx_byte;					// Byte received from the PC
+CAN_RxStats_t can_rx_stats = {0};		// Counters kept by the CAN Rx path (FIFO full/overrun, backlog)
+uint8_t can_burst_mode = FALSE;			// TRUE while the catch-all filter feeds FIFO1 to absorb a burst
+uint8_t can_quiet_drains = 0;			// IRQ entries in a row that found no backlog
+uint8_t standby_pending = FALSE;		// Light lost: Standby is entered once the sleep message is on the bus
+Rate_Ctl_t round_rate;					// Sets the TIM6 period when ROUND_RATE_CTL is TRUE
+uint32_t hand_tick = 0;					// HAL tick the last hand was queued at
+uint16_t round_rtt = RATE_RTT_LOST;		// Hand to result of the last round, ms
+Tt_Sched_t tt_sched = {0};				// Schedule of the cycle the last reference described (TT_CAN)
+uint8_t tt_playing = FALSE;				// User button pressed: hands follow the reference frames
+Spectator_t spectator;					// Game seen from CAN silent mode (SPECTATOR)
+uint16_t spec_tx_busy = 0;				// Length of the spectator's DMA transfer under way, 0 if none
+
+extern CAN_HandleTypeDef hcan2;		// CAN2 peripheral handle (can_bus.c). Used in dual-bus mode only
 
 
 // Function prototypes
@@ -38,13 +79,25 @@ void CAN1_Init(void);
 void GPIO_Init(void);
 void CAN1_Tx(void);
 void CAN_Filter_Config(void);
+void CAN_Set_Burst_Mode(uint8_t burst);
+void drain_rx_fifos(CAN_HandleTypeDef *hcan);
+void process_rx_msg(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[]);
 void Timer6_Init(void);
 void send_game_stats(uint32_t StdId);
+void send_index_reply(uint8_t query[]);
+void index_round(uint8_t code);
+void export_next_block(void);
 uint8_t UART_Msg_Tx(char msg[]);
 void store_score_in_bSRAM(uint8_t p1_wins, uint8_t p2_wins, uint8_t game_ties, uint8_t game_err);
 void load_bSRAM_score(void);
 void send_sleep_msg(void);
+void enter_standby(void);
+uint8_t sleep_msg_sent(CAN_HandleTypeDef *hcan);
+void wait_sleep_msg(void);
 void wakeup_disc(void);
+void round_rate_update(void);
+void tt_reference(uint8_t ref[]);
+void spec_tx_next(void);
 
 
 /**
@@ -77,11 +130,41 @@ int main(void)
 	// Wake up Disc board if woke up from standby mode
 	wakeup_disc();
 
+	// Round history: picks up where it stopped if the backup SRAM kept it, otherwise starts over
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+	__HAL_RCC_BKPSRAM_CLK_ENABLE();
+	History_Init(&round_history, pBKPSRAMbase + HISTORY_OFFSET, HAL_GetTick() / 60000);
+
+	uint32_t first_round;		// The round index starts with the rounds the history kept
+
+	History_Rounds(&round_history, &first_round);
+	Fenwick_Init(&round_index, first_round);
+	History_Replay(&round_history, index_round);
+	Fenwick_Tick(&round_index, HAL_GetTick() / 60000);
+
+	Export_Init(&history_export);	// The PC starts a history export with a control frame on USART2 Rx
+
+	if(SPECTATOR == FALSE)			// The spectator's lines have USART2 Tx to themselves
+	{
+		HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
+	}
+
 	CAN1_Init();	// Moves CAN peripheral from sleep to initialization state
 
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+	CAN2_Init();			// Second bus. Must be initialized before its filter banks are configured
+#endif
+
 	CAN_Filter_Config();	// Filter config for CAN Rx must be done in initialization state
 
-	uint32_t active_IT = CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_BUSOFF;	  // Interrupts to activate for CAN
+	Secure_Init();			// MAC subkeys and access to the frame counters (used when SECURE_CAN is TRUE)
+
+	Spec_Init(&spectator, SPEC_BIT_NS);	// Follows the frames from the start of the bus (used when SPECTATOR is TRUE)
+
+	uint32_t active_IT = CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING | \
+						 CAN_IT_RX_FIFO0_FULL | CAN_IT_RX_FIFO1_FULL | CAN_IT_RX_FIFO0_OVERRUN | \
+						 CAN_IT_RX_FIFO1_OVERRUN | CAN_IT_ERROR | CAN_IT_BUSOFF;	  // Interrupts to activate for CAN
 
 	if(HAL_CAN_ActivateNotification(&hcan1, active_IT) != HAL_OK)   // Activates the CAN interrupts needed
 	{
@@ -97,11 +180,43 @@ int main(void)
 		Error_handler();  // Go to error handler if the transfer to normal state was not successful
 	}
 
-	srand(time(NULL));   // Initialize random seed into rand(); should be called once only
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+	if(HAL_CAN_ActivateNotification(&hcan2, active_IT) != HAL_OK || HAL_CAN_Start(&hcan2) != HAL_OK)
+	{
+		UART_Msg_Tx("CAN2 start error\r\n");
+
+		Error_handler();
+	}
+#endif
+
+	// Initialize random seed into rand() from the 96-bit unique device ID; should be called once only.
+	// No clock on target (time() returns -1): both boards would draw the same hands and always tie
+	srand(HAL_GetUIDw0() ^ (HAL_GetUIDw1() * 0x9E3779B1U) ^ (HAL_GetUIDw2() * 0x85EBCA6BU));
+
+	Strategy_Init(&nucleo_player, NUCLEO_STRATEGY, rand() + 1);
+
+	Rate_Init(&round_rate);
 
 	UART_Msg_Tx("Nucleo initialization successful\r\n");
 
-	while(1);
+	if(SPECTATOR == TRUE)
+	{
+		HAL_TIM_Base_Start_IT(&htimer6);		// Timeouts and totals of the spectator, no button needed
+	}
+
+	HAL_DBGMCU_EnableDBGSleepMode();	// Keeps the debug clocks, so SWD stays connected while the core sleeps
+
+	HAL_PWR_EnableSleepOnExit();	// Everything runs in interrupts: the core goes back to sleep after each one
+
+	while(1)
+	{
+		if(standby_pending == TRUE)		// Light lost: sleep-on-exit was cleared to get here
+		{
+			wait_sleep_msg();
+		}
+
+		HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+	}
 
 	return 0;
 }
@@ -122,12 +237,12 @@ void CAN1_Init(void)
 	// Check CAN timing calc table to see if a certain CAN bit rate can be achieved
 
 	hcan1.Instance = CAN1;
-	hcan1.Init.Mode = CAN_MODE_NORMAL;
-	hcan1.Init.AutoBusOff = DISABLE;
-	hcan1.Init.AutoRetransmission = ENABLE;		// Retransmit message until it is successfully received
+	hcan1.Init.Mode = (SPECTATOR == TRUE) ? CAN_MODE_SILENT : CAN_MODE_NORMAL;	// Silent: receives without driving a single bit, ACK included
+	hcan1.Init.AutoBusOff = (DUAL_CAN_MODE == DUAL_CAN_OFF) ? DISABLE : ENABLE;	// In dual-bus mode a bus-off bus recovers by hardware
+	hcan1.Init.AutoRetransmission = (TT_CAN == TRUE) ? DISABLE : ENABLE;	// Retransmit message until it is successfully received. A retry would miss its window in TT_CAN
 	hcan1.Init.AutoWakeUp = DISABLE;			// During message reception, sleep mode is left on software request
-	hcan1.Init.ReceiveFifoLocked = DISABLE;  	// Allow message overwrite if receive FIFO is full
-	hcan1.Init.TimeTriggeredMode = DISABLE;
+	hcan1.Init.ReceiveFifoLocked = DISABLE;  	// Allow message overwrite if receive FIFO is full. Overruns are counted in HAL_CAN_ErrorCallback()
+	hcan1.Init.TimeTriggeredMode = (TT_CAN == TRUE || SPECTATOR == TRUE) ? ENABLE : DISABLE;	// Frames time stamped at their SOF, in bit times
 	hcan1.Init.TransmitFifoPriority = DISABLE;	// Priority configured to be driven by the identifier of the message
 
 	// Settings related to CAN bit timing
@@ -147,18 +262,63 @@ void CAN1_Init(void)
 
 
 /**
-  * @brief	Selects a filter bank (FB0) for hcan1 (CAN1) and sets its properties
+  * @brief	Configures two filter banks per bus in use (FB0/FB1 for CAN1, FB14/FB15 for CAN2). FB0 is an ID list holding the game
+  * 		frames this board acts on and always feeds FIFO0. FB1 accepts everything else
+  * 		(no mask) and feeds FIFO0 until a burst is detected, see CAN_Set_Burst_Mode()
   * @param	None
-  * @note	No filter mask applied
+  * @note	An ID list filter has priority over a mask filter of the same scale, so game
+  * 		frames always land in FB0
   * @retval None
   */
 
 void CAN_Filter_Config(void)
 {
-	CAN_FilterTypeDef can1_filter_init;
+	CAN_FilterTypeDef can1_filter_init = {0};
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
+
 	can1_filter_init.FilterActivation = ENABLE;
-	can1_filter_init.FilterBank = 0;
+	can1_filter_init.SlaveStartFilterBank = CAN2_FILTER_BANK_START;	// Banks 0-13 for CAN1, 14-27 for CAN2
 	can1_filter_init.FilterFIFOAssignment = CAN_RX_FIFO0;
+	// Game traffic Nucleo acts on: game result (0x111, of node PLAYER_NODE) and the stats remote frame (0x633)
+	can1_filter_init.FilterIdHigh = (0x111 + PLAYER_NODE) << 5;			// STDID sits in bits 31:21 of a 32-bit filter
+	can1_filter_init.FilterIdLow = 0x0000;				// IDE = 0, RTR = 0 (data frame)
+	can1_filter_init.FilterMaskIdHigh = 0x633 << 5;		// Second ID of the list
+	can1_filter_init.FilterMaskIdLow = CAN_RTR_REMOTE;	// RTR = 1 (remote frame)
+	can1_filter_init.FilterMode = CAN_FILTERMODE_IDLIST;
+	can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
+
+	for(uint8_t bus = 0; bus < CAN_BUS_IN_USE; bus++)
+	{
+		can1_filter_init.FilterBank = bus * CAN2_FILTER_BANK_START;
+
+		if(HAL_CAN_ConfigFilter(hcan[bus], &can1_filter_init) != HAL_OK)
+		{
+			UART_Msg_Tx("HAL_CAN_ConfigFilter error\r\n");
+			Error_handler();
+		}
+	}
+
+	CAN_Set_Burst_Mode(FALSE);	// FB1 (catch-all) starts on FIFO0
+}
+
+
+/**
+  * @brief	Moves the catch-all filter bank (FB1, and FB15 in dual-bus mode) between the Rx FIFOs. In burst mode the
+  * 		other bus traffic goes to FIFO1 so the game frames have FIFO0 (3 frames deep) to
+  * 		themselves
+  * @param	burst TRUE to feed FB1 into FIFO1, FALSE to feed it into FIFO0
+  * @note	Reception is briefly halted by the filter init mode while FB1 is rewritten
+  * @retval None
+  */
+
+void CAN_Set_Burst_Mode(uint8_t burst)
+{
+	CAN_FilterTypeDef can1_filter_init = {0};
+	CAN_HandleTypeDef *hcan[CAN_BUS_COUNT] = {&hcan1, &hcan2};
+
+	can1_filter_init.FilterActivation = ENABLE;
+	can1_filter_init.SlaveStartFilterBank = CAN2_FILTER_BANK_START;
+	can1_filter_init.FilterFIFOAssignment = (burst == TRUE) ? CAN_RX_FIFO1 : CAN_RX_FIFO0;
 	can1_filter_init.FilterIdHigh = 0x0000;
 	can1_filter_init.FilterIdLow = 0x0000;
 	can1_filter_init.FilterMaskIdHigh = 0x0000;
@@ -166,11 +326,24 @@ void CAN_Filter_Config(void)
 	can1_filter_init.FilterMode = CAN_FILTERMODE_IDMASK;
 	can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
 
-	if(HAL_CAN_ConfigFilter(&hcan1, &can1_filter_init) != HAL_OK)
+	for(uint8_t bus = 0; bus < CAN_BUS_IN_USE; bus++)
 	{
-		UART_Msg_Tx("HAL_CAN_ConfigFilter error\r\n");
-		Error_handler();
+		can1_filter_init.FilterBank = bus * CAN2_FILTER_BANK_START + 1;
+
+		if(HAL_CAN_ConfigFilter(hcan[bus], &can1_filter_init) != HAL_OK)
+		{
+			UART_Msg_Tx("HAL_CAN_ConfigFilter error\r\n");
+			Error_handler();
+		}
+	}
+
+	if(burst == TRUE && can_burst_mode == FALSE)
+	{
+		can_rx_stats.burst_switches++;
 	}
+
+	can_burst_mode = burst;
+	can_quiet_drains = 0;
 }
 
 
@@ -183,23 +356,33 @@ void CAN_Filter_Config(void)
 void CAN1_Tx(void)
 {
 	CAN_TxHeaderTypeDef TxHeader;
-	uint32_t TxMailbox;						// ID for the selected Tx mailbox will be stored in this variable.
 	uint8_t can_msg;
 	char *playerspick[3] = {"Rock", "Paper", "Scissors"};
 	char uart_msg[75];
 
-	can_msg = rand() % 3;					// To generate a random integer between 0 to 2 and act as Nucleo's pick of rock, paper, scissors
+	can_msg = Strategy_Pick(&nucleo_player);	// Nucleo's pick of rock, paper, scissors (0 to 2)
+	last_hand = can_msg;
+
+	if(result_pending == TRUE && lost_results < 255)	// Previous hand never got its game result
+	{
+		lost_results++;
+	}
+
+	hand_tick = HAL_GetTick();
+	round_rtt = RATE_RTT_LOST;
 
 	TxHeader.DLC = 1; 						// Length of message to transmit in bytes
-	TxHeader.StdId = 0x49F; 				// Random ID for message is selected
+	TxHeader.StdId = 0x49F + PLAYER_NODE; 	// Random ID for message is selected, one per player node
 	TxHeader.IDE = CAN_ID_STD;				// Is ID for standard or extended CAN?
 	TxHeader.RTR = CAN_RTR_DATA;  			// Request to transmit data frame or remote frame?
 
-	if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, &can_msg, &TxMailbox) != HAL_OK)	 // Add a message to the first free Tx mailbox and activate the corresponding transmission request
+	if(CAN_Bus_Tx(&TxHeader, &can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
 		Error_handler();
 	}
 
+	result_pending = TRUE;
+
 	sprintf(uart_msg, "Sent message containing Nucleo's hand (%s)\r\n", playerspick[can_msg]);
 	UART_Msg_Tx(uart_msg);
 }
@@ -215,28 +398,106 @@ void CAN1_Tx(void)
 void send_game_stats(uint32_t StdId)
 {
 	CAN_TxHeaderTypeDef TxHeader;
-	uint32_t TxMailbox;						// ID for selected mailbox will be stored in this variable.
+	char bus_report[200];
+
+	uint16_t overruns = can_rx_stats.fifo_overrun[0] + can_rx_stats.fifo_overrun[1];
 
 	// increase to uint16_t later
-	uint8_t can_msg[4] = {nucleo_wins, disc_wins, tie_count, game_err};  	// Random values
+	// Bytes 4 and 5: results never received for a sent hand, and Rx FIFO overruns (saturated at 255)
+	uint8_t can_msg[6] = {nucleo_wins, disc_wins, tie_count, game_err, lost_results, (overruns > 255) ? 255 : overruns};
 
-	TxHeader.DLC = 4; 						// Length of message to transmit in bytes
+	TxHeader.DLC = 6; 						// Length of message to transmit in bytes
 	TxHeader.StdId = StdId;
 	TxHeader.IDE = CAN_ID_STD;				// Is ID for standard or extended CAN?
 	TxHeader.RTR = CAN_RTR_DATA;  			// Request to transmit data frame or remote frame?
 
-	if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, can_msg, &TxMailbox) != HAL_OK)	// Add a message to the first free Tx mailbox and activate the corresponding transmission request
+	if(CAN_Bus_Tx(&TxHeader, can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
 		UART_Msg_Tx("send_response HAL_CAN_AddTxMessage Tx error\r\n");
 		Error_handler();
 	}
 
 	UART_Msg_Tx("Nucleo sent game stats to Disc\r\n");
+
+	CAN_Bus_Report(bus_report);				// Health of the CAN bus(es) in use
+	UART_Msg_Tx(bus_report);
+
+#if SECURE_CAN == TRUE
+	Secure_Report(bus_report);				// Forged/replayed frames dropped so far
+	UART_Msg_Tx(bus_report);
+#endif
+
+	History_Report(&round_history, bus_report);	// Rounds kept in backup SRAM
+	UART_Msg_Tx(bus_report);
 }
 
 
 /**
-  * @brief	Rx FIFO 0 message pending callback.
+  * @brief	Answers a range query on the round index with a data frame (FENWICK_REPLY_ID)
+  * 		and prints the counts via UART
+  * @param	query payload of the FENWICK_QUERY_ID frame: FENWICK_BY_ROUNDS with the first round
+  * 		and a round count, or FENWICK_BY_MINUTES with a number of minutes
+  * @retval None
+  */
+
+void send_index_reply(uint8_t query[])
+{
+	CAN_TxHeaderTypeDef TxHeader = {0};
+	uint32_t sums[FENWICK_COUNTERS], rounds;
+	uint32_t first = query[1] | (query[2] << 8) | ((uint32_t)query[3] << 16) | ((uint32_t)query[4] << 24);
+	uint8_t can_msg[8];
+	char uart_msg[120];
+
+	if(query[0] == FENWICK_BY_MINUTES)
+	{
+		rounds = Fenwick_QueryMinutes(&round_index, query[1] | (query[2] << 8), HAL_GetTick() / 60000, sums);
+		sprintf(uart_msg, "INDEX last %d min: ", query[1] | (query[2] << 8));
+	}else
+	{
+		rounds = Fenwick_Query(&round_index, first, query[5] | (query[6] << 8), sums);
+		sprintf(uart_msg, "INDEX rounds %lu+%d: ", (unsigned long)first, query[5] | (query[6] << 8));
+	}
+
+	for(uint8_t i = 0; i < FENWICK_COUNTERS; i++)	// Saturated to 16 bits, LSB first
+	{
+		uint16_t val = (sums[i] > 0xFFFF) ? 0xFFFF : sums[i];
+
+		can_msg[2*i] = (uint8_t)val;
+		can_msg[2*i+1] = (uint8_t)(val >> 8);
+	}
+
+	TxHeader.DLC = 8;
+	TxHeader.StdId = FENWICK_REPLY_ID;
+	TxHeader.IDE = CAN_ID_STD;
+	TxHeader.RTR = CAN_RTR_DATA;
+
+	if(CAN_Bus_Tx(&TxHeader, can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
+	{
+		UART_Msg_Tx("send_index_reply HAL_CAN_AddTxMessage Tx error\r\n");
+		Error_handler();
+	}
+
+	sprintf(uart_msg + strlen(uart_msg), "%lu rounds, N %lu D %lu T %lu E %lu\r\n", (unsigned long)rounds, \
+			(unsigned long)sums[FENWICK_NUCLEO_WINS], (unsigned long)sums[FENWICK_DISC_WINS], \
+			(unsigned long)sums[FENWICK_TIES], (unsigned long)sums[FENWICK_ERRORS]);
+	UART_Msg_Tx(uart_msg);
+}
+
+
+/**
+  * @brief	Adds a round replayed from the history to the round index
+  * @param	code round code of the history (history.h)
+  * @retval None
+  */
+
+void index_round(uint8_t code)
+{
+	Fenwick_Add(&round_index, History_Result(code));
+}
+
+
+/**
+  * @brief	Rx FIFO 0 message pending callback. Both FIFOs are drained on every IRQ entry
   * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
   *         the configuration information for the specified CAN
   * @retval None
@@ -244,21 +505,172 @@ void send_game_stats(uint32_t StdId)
 
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 {
-	uint8_t rcvd_msg[8] = {0};				// CAN frame can contain 8 bytes
-	char uart_msg[75] = {0};
-	char *game_result[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+	drain_rx_fifos(hcan);
+}
+
+
+/**
+  * @brief	Rx FIFO 1 message pending callback. Both FIFOs are drained on every IRQ entry
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval None
+  */
 
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+	drain_rx_fifos(hcan);
+}
+
+
+/**
+  * @brief	Rx FIFO 0 full callback. FIFO0 holds 3 frames; the next one would overwrite
+  * 		the oldest. Moves the other bus traffic to FIFO1
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval None
+  */
 
-	// Release a message from Rx FIFO0
-	if(HAL_CAN_GetRxMessage(&hcan1, CAN_RX_FIFO0, &RxHeader, rcvd_msg) != HAL_OK)
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan)
+{
+	can_rx_stats.fifo_full[0]++;
+
+	if(can_burst_mode == FALSE)
 	{
-		Error_handler();
+		CAN_Set_Burst_Mode(TRUE);
 	}
+}
+
+
+/**
+  * @brief	Rx FIFO 1 full callback
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval None
+  */
+
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan)
+{
+	can_rx_stats.fifo_full[1]++;
+}
+
 
-	if(RxHeader.StdId == 0x111 && RxHeader.RTR == CAN_RTR_DATA)				// Disc sent game result to Nucleo
+/**
+  * @brief	Releases every frame waiting in FIFO0 and FIFO1, FIFO0 (game traffic) first.
+  * 		Leaves burst mode once CAN_QUIET_DRAINS entries in a row found at most one frame
+  * @param	hcan pointer to the CAN handle (CAN1 or CAN2) whose FIFOs are drained
+  * @retval None
+  */
+
+void drain_rx_fifos(CAN_HandleTypeDef *hcan)
+{
+	uint8_t rcvd_msg[8];					// CAN frame can contain 8 bytes
+	uint32_t fifo;
+	uint8_t drained = 0;
+
+	while(1)
+	{
+		if(HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0)
+		{
+			fifo = CAN_RX_FIFO0;
+		}else if(HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO1) > 0)
+		{
+			fifo = CAN_RX_FIFO1;
+		}else
+		{
+			break;
+		}
+
+		memset(rcvd_msg, 0, sizeof(rcvd_msg));
+
+		// Release a message from the Rx FIFO
+		if(HAL_CAN_GetRxMessage(hcan, fifo, &RxHeader, rcvd_msg) != HAL_OK)
+		{
+			Error_handler();
+		}
+
+		drained++;
+		CAN_Bus_RxCount(hcan);
+
+		if(SPECTATOR == TRUE)				// Watched, never answered. Extended frames are no game frames
+		{
+			Spec_Frame(&spectator, HAL_GetTick(), RxHeader.Timestamp, (RxHeader.IDE == CAN_ID_STD) ? RxHeader.StdId : 0xFFFF, \
+					   RxHeader.RTR == CAN_RTR_REMOTE, RxHeader.DLC, rcvd_msg);
+			continue;
+		}
+
+		// Mirrored copy from the other bus is dropped, so are forged or replayed secured frames
+		if(CAN_Bus_IsDuplicate(hcan, &RxHeader, rcvd_msg) == FALSE && \
+		   (SECURE_CAN == FALSE || Secure_Open(&RxHeader, rcvd_msg) == TRUE))
+		{
+			process_rx_msg(&RxHeader, rcvd_msg);
+		}
+	}
+
+	can_rx_stats.rx_frames += drained;
+
+	if(SPECTATOR == TRUE)
+	{
+		spec_tx_next();
+	}
+
+	if(drained > can_rx_stats.max_backlog)
+	{
+		can_rx_stats.max_backlog = drained;
+	}
+
+	if(drained > 1)
+	{
+		can_quiet_drains = 0;
+	}else if(can_burst_mode == TRUE && ++can_quiet_drains >= CAN_QUIET_DRAINS)
+	{
+		CAN_Set_Burst_Mode(FALSE);
+	}
+}
+
+
+/**
+  * @brief	Acts on a single received CAN frame
+  * @param	pHeader pointer to the header of the received frame
+  * @param	rcvd_msg payload of the received frame (8 bytes, zero padded)
+  * @retval None
+  */
+
+void process_rx_msg(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[])
+{
+	char uart_msg[75] = {0};
+	char *game_result[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+
+	if(pHeader->StdId == 0x111 + PLAYER_NODE && pHeader->RTR == CAN_RTR_DATA && TOURNAMENT == TRUE && \
+	   rcvd_msg[0] == TOURNEY_PAIRING)		// Disc paired Nucleo for a match: round, opponent's node, games left
+	{
+		// Sent again to a match gone quiet: the hand of the game being played, unless one still waits for
+		// the bus (hands lose the arbitration to Disc's frames and to lower nodes' hands on a busy bus)
+		if(rcvd_msg[3] > 0 && HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) == 3)
+		{
+			CAN1_Tx();
+		}
+
+		sprintf(uart_msg, "Round %u against node %u, %u games left\r\n", rcvd_msg[1] + 1, rcvd_msg[2], rcvd_msg[3]);
+		UART_Msg_Tx(uart_msg);
+
+	}else if(pHeader->StdId == 0x111 + PLAYER_NODE && pHeader->RTR == CAN_RTR_DATA)	// Disc sent game result to Nucleo
 	{
 		sprintf(uart_msg, "Received message with game result: %s\r\n", game_result[rcvd_msg[0]-1]);
 
+		if(result_pending == TRUE)			// Disc's hand follows from Nucleo's hand and the result
+		{
+			round_rtt = (uint16_t)(HAL_GetTick() - hand_tick);
+
+			uint8_t disc_hand = Strategy_OppHand(last_hand, rcvd_msg[0]);
+
+			Strategy_Observe(&nucleo_player, last_hand, disc_hand);
+			History_Record(&round_history, last_hand, disc_hand, HAL_GetTick() / 60000);	// Error results are kept as such
+			Fenwick_Tick(&round_index, HAL_GetTick() / 60000);
+			Fenwick_Add(&round_index, rcvd_msg[0]);
+		}
+
+		result_pending = FALSE;
+
 		// Increment score counter
 		switch(rcvd_msg[0])
 		{
@@ -279,16 +691,72 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 		// Store score in the backup SRAM
 		store_score_in_bSRAM(nucleo_wins, disc_wins, tie_count, game_err);
 
+		if(TOURNAMENT == TRUE && rcvd_msg[1] > 0)	// Games left in the match: the next hand goes now
+		{
+			CAN1_Tx();
+		}
+
 		// StdId cannot be a value beyond 0x7FF
-	}else if(RxHeader.StdId == 0x633 && RxHeader.RTR == CAN_RTR_REMOTE) 	// Disc requests game stats from Nucleo
+	}else if(pHeader->StdId == 0x633 && pHeader->RTR == CAN_RTR_REMOTE) 	// Disc requests game stats from Nucleo
+	{
+		send_game_stats(pHeader->StdId);
+
+	}else if(pHeader->StdId == FENWICK_QUERY_ID && pHeader->RTR == CAN_RTR_DATA)	// Range query on the round index
 	{
-		send_game_stats(RxHeader.StdId);
+		send_index_reply(rcvd_msg);
+
+	}else if(pHeader->StdId == TT_REF_ID && pHeader->RTR == CAN_RTR_DATA && TT_CAN == TRUE)	// Disc's reference: a cycle starts
+	{
+		tt_reference(rcvd_msg);
 	}
 }
 
 
 /**
-  * @brief  CAN error callback. Error message will be sent via UART to be printed on PC terminal
+  * @brief	Follows the cycle Disc's reference frame starts (TT_CAN). Every TT_HAND_MS, once
+  * 		the game is on, TIM6 is armed as a one-shot to the start of Nucleo's hand window
+  * @param	ref payload of the reference: cycle count (LSB first), cycle in ms, players
+  * @note	Called on the reference's Rx interrupt, at the end of the frame
+  * @retval None
+  */
+
+void tt_reference(uint8_t ref[])
+{
+	uint16_t cycle = ref[0] | (ref[1] << 8);
+	uint32_t ticks;
+
+	if(ref[2] * 1000U != tt_sched.cycle_us || ref[3] != tt_sched.players)		// First reference, or Disc's schedule changed
+	{
+		if(Tt_Build(&tt_sched, ref[3], TT_BIT_NS, ref[2] * 1000U) == 0)
+		{
+			return;
+		}
+	}
+
+	if(tt_playing == FALSE || cycle % (TT_HAND_MS / ref[2]) != 0)
+	{
+		return;
+	}
+
+	ticks = Tt_Arm_Us(&tt_sched, TT_SLOT) / TT_TICK_US;
+
+	if(ticks == 0)			// Nucleo has no window in this schedule
+	{
+		return;
+	}
+
+	__HAL_TIM_SET_COUNTER(&htimer6, 0);
+	__HAL_TIM_SET_AUTORELOAD(&htimer6, ticks - 1);
+	htimer6.Instance->EGR = TIM_EGR_UG;					// Prescaler restarts with the counter
+	htimer6.Instance->SR &= ~TIM_SR_UIF;				// Set by UG: no update right away
+	HAL_TIM_Base_Start_IT(&htimer6);
+}
+
+
+/**
+  * @brief  CAN error callback. Error message will be sent via UART to be printed on PC terminal.
+  * 		Rx FIFO overruns are counted and trigger burst mode, with no UART line that would
+  * 		hold back the draining of the FIFOs: the count goes out with the game stats
   * @param  hcan pointer to a CAN_HandleTypeDef structure that contains
   *         the configuration information for the specified CAN.
   * @retval None
@@ -296,7 +764,48 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 
 void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
 {
-	UART_Msg_Tx("CAN Error Occurred\r\n");
+	uint32_t err = HAL_CAN_GetError(hcan);
+
+	HAL_CAN_ResetError(hcan);		// Error code accumulates; clear it so each event is counted once
+
+	CAN_Bus_Error(hcan, err);		// Bus-off takes the bus out of use until it recovers
+
+	if(err & HAL_CAN_ERROR_RX_FOV0)
+	{
+		can_rx_stats.fifo_overrun[0]++;
+
+		if(can_burst_mode == FALSE)
+		{
+			CAN_Set_Burst_Mode(TRUE);
+		}
+	}
+
+	if(err & HAL_CAN_ERROR_RX_FOV1)
+	{
+		can_rx_stats.fifo_overrun[1]++;
+	}
+
+	if(SPECTATOR == TRUE)			// Streamed with the other lines: a blocking line would hold the Rx path back
+	{
+		if(err & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1))
+		{
+			Spec_Anomaly(&spectator, SPEC_ANOM_OVERRUN, HAL_GetTick());
+		}
+
+		if(err & (HAL_CAN_ERROR_BOF | HAL_CAN_ERROR_STF | HAL_CAN_ERROR_FOR | HAL_CAN_ERROR_BR | HAL_CAN_ERROR_BD | HAL_CAN_ERROR_CRC))
+		{
+			Spec_Anomaly(&spectator, SPEC_ANOM_BUS_ERROR, HAL_GetTick());
+		}
+
+		spec_tx_next();
+
+		return;
+	}
+
+	if(err & ~(HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1))
+	{
+		UART_Msg_Tx("CAN Error Occurred\r\n");
+	}
 }
 
 
@@ -446,10 +955,10 @@ void Timer6_Init(void)
 {
 	// Timer period will change if SYSCLK changes
 	// TIM6_CLK =  PCLK1 * 2 = SYSCLK
-	// To select TIM6 and configure its period for 4 seconds
+	// To select TIM6 and configure its period for 4 seconds (100 ms for the spectator)
 	htimer6.Instance = TIM6;
 	htimer6.Init.Prescaler = 4999;
-	htimer6.Init.Period = 40000-1;  // Subtract one to ensure an update event is generated at exactly the time base needed
+	htimer6.Init.Period = (SPECTATOR == TRUE) ? 1000-1 : 40000-1;  // Subtract one to ensure an update event is generated at exactly the time base needed
 
 	// CounterMode is not configured b/c TIM6 (basic timer) can only count up which is the default mode
 
@@ -461,7 +970,9 @@ void Timer6_Init(void)
 
 
 /**
-  * @brief  Transmits Nucleo's hand to Disc once every 4 seconds
+  * @brief  Transmits Nucleo's hand to Disc once every 4 seconds, or at the period rate_ctl.c
+  * 		sets (ROUND_RATE_CTL), or in Nucleo's window of the cycle (TT_CAN). The spectator
+  * 		checks its timeouts instead, every 100 ms
   * @param  htim pointer to a TIM_HandleTypeDef structure that contains
   *         the configuration information for the specified TIM (TIM6)
   * @retval None
@@ -469,10 +980,45 @@ void Timer6_Init(void)
 
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
+	if(SPECTATOR == TRUE)
+	{
+		Spec_Tick(&spectator, HAL_GetTick());
+		spec_tx_next();
+
+		return;
+	}
+
+	if(TT_CAN == TRUE)
+	{
+		HAL_TIM_Base_Stop_IT(&htimer6);		// One-shot: armed again by a later reference
+	}
+
+#if ROUND_RATE_CTL == TRUE
+	round_rate_update();
+#endif
+
 	CAN1_Tx();
 }
 
 
+/**
+  * @brief  Judges the round that just ended (rate_ctl.c) and sets the TIM6 period until
+  * 		the next hand. Called from the update interrupt, the counter has just wrapped
+  * @param  None
+  * @note	Mailboxes and TEC are those of CAN1, the bus the game is tuned for
+  * @retval None
+  */
+
+void round_rate_update(void)
+{
+	uint8_t tx_busy = 3 - HAL_CAN_GetTxMailboxesFreeLevel(&hcan1);
+	uint8_t tec = (hcan1.Instance->ESR & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+	uint32_t period = Rate_Round(&round_rate, round_rtt, tx_busy, tec);
+
+	__HAL_TIM_SET_AUTORELOAD(&htimer6, period - 1);
+}
+
+
 /**
   * @brief  Configures and initializes GPIOs for Nucleo's user button, sleep pin, and
   * 		wakeup pin (to wake up Disc).
@@ -534,7 +1080,22 @@ void GPIO_Init(void)
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
-	if(GPIO_Pin == GPIO_PIN_13)
+	if(SPECTATOR == TRUE)				// No game, no sleep message: the button shows the totals now
+	{
+		if(GPIO_Pin == GPIO_PIN_13)
+		{
+			Spec_Report(&spectator, HAL_GetTick());
+			spec_tx_next();
+		}
+	}else if(GPIO_Pin == GPIO_PIN_13 && TT_CAN == TRUE)
+	{
+		UART_Msg_Tx("User button pressed; hands follow the reference frames\r\n");
+
+		tt_playing = TRUE;				// TIM6 is armed by the references, see tt_reference()
+	}else if(GPIO_Pin == GPIO_PIN_13 && TOURNAMENT == TRUE)
+	{
+		UART_Msg_Tx("User button pressed; hands follow Disc's pairings\r\n");
+	}else if(GPIO_Pin == GPIO_PIN_13)
 	{
 		UART_Msg_Tx("User button pressed; timer started\r\n");
 
@@ -546,16 +1107,76 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 	{
 		UART_Msg_Tx("Light lost; gone to sleep\r\n");
 
+		standby_pending = TRUE;			// Standby would cut the frame off: the main loop waits until it is sent
+
 		send_sleep_msg();				// Send Disc a CAN message to go to sleep
 
-		__HAL_RCC_PWR_CLK_ENABLE();   	// Enable the power controller in order to configure the backup regulator
+		HAL_PWR_DisableSleepOnExit();	// Back to the main loop once this handler returns
+	}
+}
 
-		HAL_PWREx_EnableBkUpReg();		// Enables the backup regulator so that the SRAM won't lose power when the processor enters Standby mode
 
-		HAL_PWR_EnterSTANDBYMode();		// Enters Standby mode using WFI
+/**
+  * @brief	Puts Nucleo in Standby mode, keeping the backup SRAM powered
+  * @param	None
+  * @retval None
+  */
+
+void enter_standby(void)
+{
+	__HAL_RCC_PWR_CLK_ENABLE();   	// Enable the power controller in order to configure the backup regulator
+
+	HAL_PWREx_EnableBkUpReg();		// Enables the backup regulator so that the SRAM won't lose power when the processor enters Standby mode
+
+	HAL_PWR_EnterSTANDBYMode();		// Enters Standby mode using WFI
 
-		// MCU will not resume here when waking up. Rather a reset will occur. The code resumes back from the start of main function
+	// MCU will not resume here when waking up. Rather a reset will occur. The code resumes back from the start of main function
+}
+
+
+/**
+  * @brief	Tells whether the sleep message went out: every Tx mailbox of the bus is empty
+  * @param	hcan pointer to a CAN_HandleTypeDef structure that contains
+  *         the configuration information for the specified CAN
+  * @retval TRUE once sent, FALSE while a mailbox still holds it
+  */
+
+uint8_t sleep_msg_sent(CAN_HandleTypeDef *hcan)
+{
+	return (HAL_CAN_GetTxMailboxesFreeLevel(hcan) == 3) ? TRUE : FALSE;
+}
+
+
+/**
+  * @brief	Enters Standby once the sleep message went out, or after SLEEP_MSG_WAIT_MS. Without
+  * 		an ACK (Disc off, bus-off) the frame would be sent again for ever: it is aborted,
+  * 		and Nucleo sleeps anyway. In dual-bus mode the first bus to carry it is enough.
+  * 		Runs in thread mode, so the CAN interrupts are still served while it waits
+  * @param	None
+  * @retval None
+  */
+
+void wait_sleep_msg(void)
+{
+	uint32_t tickstart = HAL_GetTick();
+
+	while(sleep_msg_sent(&hcan1) == FALSE && HAL_GetTick() - tickstart < SLEEP_MSG_WAIT_MS)
+	{
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+		if(sleep_msg_sent(&hcan2) == TRUE)
+		{
+			break;
+		}
+#endif
+		HAL_Delay(1);
 	}
+
+	HAL_CAN_AbortTxRequest(&hcan1, CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2);
+#if DUAL_CAN_MODE != DUAL_CAN_OFF
+	HAL_CAN_AbortTxRequest(&hcan2, CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2);
+#endif
+
+	enter_standby();
 }
 
 
@@ -568,7 +1189,6 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 void send_sleep_msg(void)
 {
 	CAN_TxHeaderTypeDef TxHeader;
-	uint32_t TxMailbox;						// ID for selected mailbox will be stored in this variable.
 	uint8_t can_msg = 0;					// Message content is irrelevant
 
 	TxHeader.DLC = 1; 						// Length of message to transmit in bytes
@@ -576,7 +1196,7 @@ void send_sleep_msg(void)
 	TxHeader.IDE = CAN_ID_STD;				// Is ID for standard or extended CAN?
 	TxHeader.RTR = CAN_RTR_DATA;  			// Request to transmit data frame or remote frame?
 
-	if(HAL_CAN_AddTxMessage(&hcan1, &TxHeader, &can_msg, &TxMailbox) != HAL_OK)	// Add a message to the first free Tx mailbox and activate the corresponding transmission request
+	if(CAN_Bus_Tx(&TxHeader, &can_msg) != HAL_OK)	// Add the message to a free Tx mailbox of the bus(es) in use
 	{
 		UART_Msg_Tx("send_response HAL_CAN_AddTxMessage Tx error\r\n");
 		Error_handler();
@@ -610,9 +1230,126 @@ void UART2_Init(void)
 }
 
 
+/**
+  * @brief	UART Rx complete callback. Feeds the byte from the PC to the history export and
+  * 		waits for the next one
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if(Export_RxByte(&history_export, uart_rx_byte) == EXPORT_START)	// New export of the history as it is now
+	{
+		memcpy(export_snapshot, round_history.mem, HISTORY_SIZE);
+		Export_Begin(&history_export, export_snapshot, HISTORY_SIZE, \
+					 (uint16_t)((round_history.anchor.round + round_history.cur.rounds) * 31 + HAL_GetTick()));
+	}
+
+	HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
+
+	export_next_block();		// An acknowledgement may have opened the window
+}
+
+
+/**
+  * @brief	UART Tx complete callback. The DMA is done with a block: the next one follows
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if(SPECTATOR == TRUE)
+	{
+		Spec_TxDone(&spectator, spec_tx_busy);
+		spec_tx_busy = 0;
+		spec_tx_next();
+
+		return;
+	}
+
+	export_next_block();
+}
+
+
+/**
+  * @brief	UART error callback. Reception stops on an overrun and is restarted here
+  * @param	huart pointer to the UART handle
+  * @retval None
+  */
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if(huart->RxState == HAL_UART_STATE_READY)
+	{
+		HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
+	}
+
+	if(SPECTATOR == TRUE && huart->gState == HAL_UART_STATE_READY && spec_tx_busy != 0)	// The stretch is given up
+	{
+		HAL_UART_TxCpltCallback(huart);
+	}
+
+	export_next_block();
+}
+
+
+/**
+  * @brief	Starts the DMA transmission of the next history export block if USART2 is free
+  * 		and the window allows one. Called from the USART2 interrupt only
+  * @param	None
+  * @retval None
+  */
+
+void export_next_block(void)
+{
+	uint16_t len;
+
+	if(huart2.gState != HAL_UART_STATE_READY)
+	{
+		return;
+	}
+
+	len = Export_NextFrame(&history_export, export_frame);
+
+	if(len != 0 && HAL_UART_Transmit_DMA(&huart2, export_frame, len) == HAL_OK)
+	{
+		Export_Sent(&history_export);
+	}
+}
+
+
+/**
+  * @brief	Starts the DMA transmission of the spectator's lines, up to the end of its ring
+  * 		or to its head, if USART2 is free
+  * @param	None
+  * @retval None
+  */
+
+void spec_tx_next(void)
+{
+	const char *chunk;
+	uint16_t len;
+
+	if(spec_tx_busy != 0 || huart2.gState != HAL_UART_STATE_READY)
+	{
+		return;
+	}
+
+	len = Spec_TxChunk(&spectator, &chunk);
+
+	if(len != 0 && HAL_UART_Transmit_DMA(&huart2, (uint8_t*)chunk, len) == HAL_OK)
+	{
+		spec_tx_busy = len;
+	}
+}
+
+
 /**
   * @brief  Sending UART message in blocking mode
   * @param  msg[] message string
+  * @note	Nothing is sent while a history export is in progress, so its blocks stay back to back
   * @retval HAL status
   */
 
@@ -620,6 +1357,11 @@ uint8_t UART_Msg_Tx(char msg[])
 {
 	uint8_t Tx_Status = 0;
 
+	if(history_export.active)
+	{
+		return HAL_BUSY;
+	}
+
 	Tx_Status = HAL_UART_Transmit(&huart2, (uint8_t*)msg, (uint16_t)(strlen(msg)), HAL_MAX_DELAY);
 	return Tx_Status;
 }
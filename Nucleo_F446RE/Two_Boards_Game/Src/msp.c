@@ -10,6 +10,10 @@
 #include "main.h"
 
 
+extern void Error_handler(void);
+extern DMA_HandleTypeDef hdma_usart2_tx;
+
+
 /**
   * @brief  Initializes the HAL MSP. Low level processor specific initializations done here.
   * @param	None
@@ -34,7 +38,7 @@ void HAL_MspInit(void)
 
 
 /**
-  * @brief  Initializes the CAN MSP. Low level inits of CAN1 peripheral are done here.
+  * @brief  Initializes the CAN MSP. Low level inits of CAN1 and CAN2 peripherals are done here.
   * @param  hcan pointer to a CAN_HandleTypeDef structure that contains
   *         the configuration information for the specified CAN.
   * @retval None
@@ -42,31 +46,61 @@ void HAL_MspInit(void)
 
 void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan)
 {
-	GPIO_InitTypeDef gpios_can1;
-
-	// Enable the clock for CAN1 and GPIOA peripherals
-	__HAL_RCC_CAN1_CLK_ENABLE();
-	__HAL_RCC_GPIOA_CLK_ENABLE();
-
-	// Configure GPIO pins to act as CAN1 Tx and Rx
-	gpios_can1.Pin = GPIO_PIN_11 | GPIO_PIN_12;  // PA11 --> CAN1_RX and PA12 --> CAN1_TX
-	gpios_can1.Mode = GPIO_MODE_AF_PP;
-	gpios_can1.Pull = GPIO_NOPULL;
-	gpios_can1.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	gpios_can1.Alternate = GPIO_AF9_CAN1;
-
-	HAL_GPIO_Init(GPIOA, &gpios_can1);
-
-	// Enable the IRQ and set the priority (NVIC settings)
-	HAL_NVIC_SetPriority(CAN1_TX_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 15, 0);
-	HAL_NVIC_SetPriority(CAN1_SCE_IRQn, 15, 0);
-
-	HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
-	HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
+	GPIO_InitTypeDef gpios_can;
+
+	if(hcan->Instance == CAN1)
+	{
+		// Enable the clock for CAN1 and GPIOA peripherals
+		__HAL_RCC_CAN1_CLK_ENABLE();
+		__HAL_RCC_GPIOA_CLK_ENABLE();
+
+		// Configure GPIO pins to act as CAN1 Tx and Rx
+		gpios_can.Pin = GPIO_PIN_11 | GPIO_PIN_12;  // PA11 --> CAN1_RX and PA12 --> CAN1_TX
+		gpios_can.Mode = GPIO_MODE_AF_PP;
+		gpios_can.Pull = GPIO_NOPULL;
+		gpios_can.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		gpios_can.Alternate = GPIO_AF9_CAN1;
+
+		HAL_GPIO_Init(GPIOA, &gpios_can);
+
+		// Enable the IRQ and set the priority (NVIC settings)
+		HAL_NVIC_SetPriority(CAN1_TX_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN1_SCE_IRQn, 15, 0);
+
+		HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
+		HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
+	}
+	else if(hcan->Instance == CAN2)
+	{
+		// CAN2 is a slave of CAN1. CAN1 clock must be on to reach the shared filter banks
+		__HAL_RCC_CAN1_CLK_ENABLE();
+		__HAL_RCC_CAN2_CLK_ENABLE();
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+
+		// Configure GPIO pins to act as CAN2 Tx and Rx
+		gpios_can.Pin = GPIO_PIN_12 | GPIO_PIN_13;  // PB12 --> CAN2_RX and PB13 --> CAN2_TX
+		gpios_can.Mode = GPIO_MODE_AF_PP;
+		gpios_can.Pull = GPIO_NOPULL;
+		gpios_can.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		gpios_can.Alternate = GPIO_AF9_CAN2;
+
+		HAL_GPIO_Init(GPIOB, &gpios_can);
+
+		// Enable the IRQ and set the priority (NVIC settings)
+		HAL_NVIC_SetPriority(CAN2_TX_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_RX0_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_RX1_IRQn, 15, 0);
+		HAL_NVIC_SetPriority(CAN2_SCE_IRQn, 15, 0);
+
+		HAL_NVIC_EnableIRQ(CAN2_TX_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_RX0_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_RX1_IRQn);
+		HAL_NVIC_EnableIRQ(CAN2_SCE_IRQn);
+	}
 }
 
 
@@ -120,7 +154,31 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
 	gpios_uart2.Pin = GPIO_PIN_3;
 	HAL_GPIO_Init(GPIOA, &gpios_uart2);		// PA3 --> UART2_RX
 
-	// 3. Enable the IRQ and set the priority (NVIC settings)
+	// 3. USART2 Tx requests DMA1 Stream 6 Channel 4, which streams the history export blocks (the spectator's lines when SPECTATOR is TRUE)
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	hdma_usart2_tx.Instance = DMA1_Stream6;
+	hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+	hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;			// Always USART2->DR
+	hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+	hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+	if(HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+	{
+		Error_handler();
+	}
+
+	__HAL_LINKDMA(huart, hdmatx, hdma_usart2_tx);
+
+	// 4. Enable the IRQs and set the priority (NVIC settings)
 	HAL_NVIC_EnableIRQ(USART2_IRQn);
 	HAL_NVIC_SetPriority(USART2_IRQn, 15, 0);   // Interrupt priority set to 15
+
+	HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 15, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
 }
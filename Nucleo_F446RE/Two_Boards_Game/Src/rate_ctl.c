@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * @file    rate_ctl.c
+  * @author  Moe2Code
+  * @brief   AIMD controller of the round interval. Nucleo judges each round when the
+  *          next hand is due and sets the TIM6 period from the outcome. The following is
+  *          conducted in source file:
+  *          + Congestion signals: no result before the next hand, a Tx mailbox still
+  *            pending, a transmit error since the last round, more than RATE_LATE_MAX
+  *            rounds of a RATE_WINDOW window above RATE_RTT_TARGET_MS
+  *          + Slow start from the fixed 4 s period (rate doubled every round on time)
+  *            up to the first congestion, then additive increase and multiplicative
+  *            decrease of the rate
+  *          + Period in TIM6 ticks from the rate
+  * @note    The rate climbs until the game frames queue behind other traffic or Disc's
+  *          UART lines hold the results back, then saws just under that point. Other
+  *          senders on the bus take their share first. A late round on its own is no
+  *          signal: under background traffic some are late at any rate, and backing off
+  *          on each of them left the game far below what the bus could carry
+  */
+
+// Includes
+#include "rate_ctl.h"
+
+
+/**
+  * @brief  Starts at the fixed 4 s period, in slow start
+  * @param  rc pointer to the controller
+  * @retval None
+  */
+
+void Rate_Init(Rate_Ctl_t *rc)
+{
+	rc->rate = RATE_MIN_MHZ;
+	rc->ssthresh = RATE_MAX_MHZ;
+	rc->tec = 0;
+	rc->hold = 0;
+	rc->started = 0;
+	rc->window = 0;
+	rc->late = 0;
+	rc->rounds = 0;
+	rc->decreases = 0;
+	rc->rtt_max = 0;
+}
+
+
+/**
+  * @brief  Judges the round that just ended and moves the rate
+  * @param  rc pointer to the controller
+  * @param  rtt_ms hand to result of the round, RATE_RTT_LOST if no result came
+  * @param  tx_busy Tx mailboxes still pending when the next hand is due
+  * @param  tec transmit error counter (CAN_ESR TEC)
+  * @retval Period until the next hand, TIM6 ticks
+  */
+
+uint32_t Rate_Round(Rate_Ctl_t *rc, uint16_t rtt_ms, uint8_t tx_busy, uint8_t tec)
+{
+	uint8_t congested = (rtt_ms == RATE_RTT_LOST || tx_busy > 0 || tec > rc->tec);
+
+	rc->tec = tec;
+
+	if(rc->started == 0)		// First hand: nothing to judge yet
+	{
+		rc->started = 1;
+
+		return Rate_Period(rc);
+	}
+
+	rc->rounds++;
+
+	if(rtt_ms != RATE_RTT_LOST && rtt_ms > rc->rtt_max)
+	{
+		rc->rtt_max = rtt_ms;
+	}
+
+	if(rc->hold > 0)
+	{
+		rc->hold--;
+
+		return Rate_Period(rc);
+	}
+
+	rc->late += (rtt_ms > RATE_RTT_TARGET_MS);
+
+	if(++rc->window == RATE_WINDOW)
+	{
+		congested |= (rc->late > RATE_LATE_MAX);
+		rc->window = 0;
+		rc->late = 0;
+	}
+
+	if(congested)
+	{
+		rc->rate = rc->rate * RATE_BACKOFF_NUM / RATE_BACKOFF_DEN;
+		rc->ssthresh = rc->rate;
+		rc->hold = RATE_HOLD_ROUNDS;
+		rc->window = 0;			// The next window starts at the new rate
+		rc->late = 0;
+		rc->decreases++;
+	}else if(rc->rate < rc->ssthresh)
+	{
+		rc->rate *= 2;
+		rc->rate = (rc->rate > rc->ssthresh) ? rc->ssthresh : rc->rate;
+	}else
+	{
+		rc->rate += RATE_STEP_MHZ;
+	}
+
+	if(rc->rate < RATE_MIN_MHZ)
+	{
+		rc->rate = RATE_MIN_MHZ;
+	}else if(rc->rate > RATE_MAX_MHZ)
+	{
+		rc->rate = RATE_MAX_MHZ;
+	}
+
+	return Rate_Period(rc);
+}
+
+
+/**
+  * @brief  Returns the period of the current rate
+  * @param  rc pointer to the controller
+  * @retval TIM6 ticks
+  */
+
+uint32_t Rate_Period(const Rate_Ctl_t *rc)
+{
+	return (uint32_t)((uint64_t)RATE_TICK_HZ * 1000 / rc->rate);
+}
@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * @file    secure_msg.c
+  * @author  Moe2Code
+  * @brief   Secured-message layer. With SECURE_CAN set to TRUE, the game frames that change
+  *          the state of a board (hand 0x49F, result 0x111, sleep 0x77B) carry a rolling
+  *          counter and a 32-bit truncated Chaskey-12 MAC computed over the ID, the counter
+  *          and the payload. Frames with a wrong tag or an old counter are dropped, so a node
+  *          on the shared bus can neither forge nor replay them. The following is conducted
+  *          in source file:
+  *          + Appending of the counter low byte and the tag to outgoing frames
+  *          + Verification, replay rejection and stripping of incoming frames
+  *          + Persistence of the counters in the RTC backup registers (kept through Standby)
+  * @note    Frame layout: payload (up to 3 bytes) | counter bits 7:0 | tag (4 bytes, LSB first).
+  *          The receiver rebuilds the 32-bit counter from its last accepted value, so up to 255
+  *          lost frames in a row are tolerated
+  * @note    Stats (0x633) stay unsecured: a 6-byte payload cannot fit the overhead and the
+  *          frame only feeds the UART printout
+  * @note    Counters survive resets and Standby but not a power loss. Power both boards
+  *          off and on together, otherwise frames are dropped as bad_mac
+  */
+
+// Includes
+#include "secure_msg.h"
+
+
+// Global variables
+// Pre-shared 128-bit key. Must be the same on both boards; change it for your own setup
+static const uint32_t secure_key[4] = {0x5A1C0E37, 0x9B42D6F1, 0x0C7E83A5, 0xE4D12B68};
+static const uint16_t secure_ids[SECURE_ID_COUNT] = {0x49F, 0x111, 0x77B};
+Chaskey_Key_t secure_key_sched = {0};			// Key and subkeys, derived once in Secure_Init()
+Secure_Stats_t secure_stats = {0};
+
+
+// Function prototypes
+static int8_t Secure_IdIndex(uint32_t StdId);
+static uint32_t Secure_Tag(uint32_t StdId, uint32_t counter, uint8_t aData[], uint8_t len);
+static volatile uint32_t* Secure_Counter(int8_t idx);
+
+
+/**
+  * @brief	Derives the MAC subkeys and opens write access to the RTC backup registers
+  * 		which hold the frame counters
+  * @param	None
+  * @retval None
+  */
+
+void Secure_Init(void)
+{
+	Chaskey_KeySchedule(&secure_key_sched, secure_key);
+
+	__HAL_RCC_PWR_CLK_ENABLE();		// Power controller configures the write access of the backup domain
+	HAL_PWR_EnableBkUpAccess();
+}
+
+
+/**
+  * @brief	Appends the counter low byte and the tag to a frame of a secured ID and
+  * 		updates its DLC. Frames of other IDs are left untouched
+  * @param	pHeader pointer to the header of the frame to send
+  * @param	aData payload of the frame. Must have room for 8 bytes
+  * @retval TRUE if the frame can be sent, FALSE if its payload is too long to be secured
+  */
+
+uint8_t Secure_Seal(CAN_TxHeaderTypeDef *pHeader, uint8_t aData[8])
+{
+	int8_t idx = Secure_IdIndex(pHeader->StdId);
+	uint8_t len = pHeader->DLC;
+	volatile uint32_t *counter;
+	uint32_t tag;
+
+	if(idx < 0 || pHeader->RTR == CAN_RTR_REMOTE)
+	{
+		return TRUE;
+	}
+
+	if(len > SECURE_MAX_PAYLOAD)
+	{
+		return FALSE;
+	}
+
+	counter = Secure_Counter(idx);
+	(*counter)++;							// A counter value is never used twice, even across Standby
+
+	tag = Secure_Tag(pHeader->StdId, *counter, aData, len);
+
+	aData[len] = (uint8_t)*counter;
+	for(uint8_t i = 0; i < SECURE_TAG_LEN; i++)
+	{
+		aData[len + 1 + i] = (uint8_t)(tag >> (8*i));
+	}
+
+	pHeader->DLC = len + SECURE_OVERHEAD;
+	secure_stats.sealed++;
+
+	return TRUE;
+}
+
+
+/**
+  * @brief	Checks the tag and the counter of a received frame of a secured ID. An accepted
+  * 		frame has its counter and tag cleared and its DLC set back to the payload length.
+  * 		Frames of other IDs are accepted untouched
+  * @param	pHeader pointer to the header of the received frame
+  * @param	rcvd_msg payload of the received frame (8 bytes)
+  * @retval TRUE if the frame can be processed, FALSE if it must be dropped
+  */
+
+uint8_t Secure_Open(CAN_RxHeaderTypeDef *pHeader, uint8_t rcvd_msg[8])
+{
+	int8_t idx = Secure_IdIndex(pHeader->StdId);
+	volatile uint32_t *last;
+	uint32_t counter, tag = 0;
+	uint8_t len;
+
+	if(idx < 0 || pHeader->RTR == CAN_RTR_REMOTE)
+	{
+		return TRUE;
+	}
+
+	if(pHeader->DLC < SECURE_OVERHEAD)
+	{
+		secure_stats.too_short++;
+		return FALSE;
+	}
+
+	len = pHeader->DLC - SECURE_OVERHEAD;
+	last = Secure_Counter(idx);
+
+	// Smallest counter above the last accepted one that ends with the received low byte
+	counter = *last + (uint8_t)(rcvd_msg[len] - (uint8_t)*last);
+
+	if(counter == *last)		// Same low byte: replay of the last frame (or 256 frames lost)
+	{
+		secure_stats.replayed++;
+		return FALSE;
+	}
+
+	for(uint8_t i = 0; i < SECURE_TAG_LEN; i++)
+	{
+		tag |= (uint32_t)rcvd_msg[len + 1 + i] << (8*i);
+	}
+
+	if(tag != Secure_Tag(pHeader->StdId, counter, rcvd_msg, len))
+	{
+		secure_stats.bad_mac++;
+		return FALSE;
+	}
+
+	*last = counter;
+	memset(&rcvd_msg[len], 0, SECURE_OVERHEAD);
+	pHeader->DLC = len;
+	secure_stats.accepted++;
+
+	return TRUE;
+}
+
+
+/**
+  * @brief	Prints the counters of the secured-message layer into buf
+  * @param	buf destination string. Must hold at least 100 characters
+  * @retval None
+  */
+
+void Secure_Report(char *buf)
+{
+	sprintf(buf, "SECURE sealed:%lu accepted:%lu bad_mac:%u replayed:%u too_short:%u\r\n", \
+			(unsigned long)secure_stats.sealed, (unsigned long)secure_stats.accepted, \
+			secure_stats.bad_mac, secure_stats.replayed, secure_stats.too_short);
+}
+
+
+/**
+  * @brief	Returns the index of a secured ID
+  * @param	StdId standard ID of a frame
+  * @retval Index in secure_ids[], or -1 if the ID is not secured
+  */
+
+static int8_t Secure_IdIndex(uint32_t StdId)
+{
+	for(int8_t i = 0; i < SECURE_ID_COUNT; i++)
+	{
+		if(secure_ids[i] == StdId)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+  * @brief	Computes the truncated MAC of a frame. Input is StdId (2 bytes), counter (4 bytes),
+  * 		payload length (1 byte) and payload, all within a single Chaskey block
+  * @param	StdId standard ID of the frame
+  * @param	counter full 32-bit frame counter
+  * @param	aData payload of the frame
+  * @param	len payload length, at most SECURE_MAX_PAYLOAD
+  * @retval 32-bit tag
+  */
+
+static uint32_t Secure_Tag(uint32_t StdId, uint32_t counter, uint8_t aData[], uint8_t len)
+{
+	uint8_t block[7 + SECURE_MAX_PAYLOAD];
+
+	block[0] = (uint8_t)StdId;
+	block[1] = (uint8_t)(StdId >> 8);
+	block[2] = (uint8_t)counter;
+	block[3] = (uint8_t)(counter >> 8);
+	block[4] = (uint8_t)(counter >> 16);
+	block[5] = (uint8_t)(counter >> 24);
+	block[6] = len;
+	memcpy(&block[7], aData, len);
+
+	return Chaskey_Mac32(&secure_key_sched, block, 7 + len);
+}
+
+
+/**
+  * @brief	Returns the RTC backup register holding the counter of a secured ID. A board
+  * 		uses it as its Tx counter for the IDs it sends and as the last accepted counter
+  * 		for the IDs it receives
+  * @param	idx index of the secured ID
+  * @retval Pointer to the backup register
+  */
+
+static volatile uint32_t* Secure_Counter(int8_t idx)
+{
+	return &RTC->BKP0R + SECURE_BKP_FIRST + idx;
+}
@@ -0,0 +1,394 @@
+/**
+  ******************************************************************************
+  * @file    spectator.c
+  * @author  Moe2Code
+  * @brief   Passive spectator (SPECTATOR). Follows the game from the frames a silent CAN
+  *          node receives: it never acknowledges nor sends, so the bus carries the same
+  *          bits with or without it. The following is conducted in source file:
+  *          + Time base: the 16-bit TTCM time stamps (bit times at the SOF) unwrapped with
+  *            the HAL tick, so frames are timed to the bit over any span
+  *          + Decoding of the game frames: hands, results, stats requests and replies,
+  *            index and rollup queries, sleep and reference frames
+  *          + Rounds, results, hands, and the hand to result latency (min, average, max,
+  *            histogram)
+  *          + Anomalies: lost and orphan results, malformed frames, slow results,
+  *            unanswered queries, Nucleo's counters drifting from the results seen,
+  *            unknown identifiers, and what the controller reports (error frames, overruns)
+  *          + Lines for the UART in a ring the DMA sends from: a line per round and per
+  *            anomaly, and the totals every SPEC_REPORT_MS
+  * @note    The spectator cannot tell Disc's hand: it never goes on the bus
+  */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "spectator.h"
+#include "fenwick.h"
+#include "tt_sched.h"
+
+
+// Global variables
+static const char *spec_anomaly_names[SPEC_ANOMALIES] = {"lost result", "orphan result", "bad frame", "slow result", \
+		"query unanswered", "stats drift", "unknown id", "bus error", "rx overrun", "bus quiet"};
+
+
+// Function prototypes
+static uint64_t Spec_Time(Spectator_t *s, uint32_t tick, uint16_t stamp);
+static void Spec_Result(Spectator_t *s, uint32_t tick, uint64_t at, uint8_t result);
+static void Spec_Stats(Spectator_t *s, uint32_t tick, const uint8_t data[]);
+static uint32_t Spec_Percentile(const Spectator_t *s, uint32_t rounds, uint8_t percent);
+static void Spec_Put(Spectator_t *s, const char *line, uint16_t len);
+
+
+/**
+  * @brief  Clears the spectator
+  * @param  s pointer to the spectator
+  * @param  bit_ns CAN bit time
+  * @retval None
+  */
+
+void Spec_Init(Spectator_t *s, uint32_t bit_ns)
+{
+	memset(s, 0, sizeof(*s));
+	s->bit_ns = bit_ns;
+	s->lat_min = UINT32_MAX;
+}
+
+
+/**
+  * @brief  Returns the time of a frame: its TTCM time stamp placed where the HAL tick
+  * 		says it is, within half a wrap (65536 bit times) of it
+  * @param  s pointer to the spectator
+  * @param  tick HAL tick at reception
+  * @param  stamp TTCM time stamp of the frame's SOF
+  * @retval Bit times since the first frame
+  */
+
+static uint64_t Spec_Time(Spectator_t *s, uint32_t tick, uint16_t stamp)
+{
+	uint64_t elapsed;
+
+	if(s->started == 0)
+	{
+		s->started = 1;
+		s->now_bits = 0;
+	}else					// The tick is off by the Rx interrupt latency at most: a few ms, far below half a wrap
+	{
+		elapsed = (uint64_t)(tick - s->tick) * 1000000 / s->bit_ns;
+		s->now_bits += elapsed + (int16_t)(uint16_t)(stamp - (uint16_t)(s->stamp + elapsed));
+	}
+
+	s->stamp = stamp;
+	s->tick = tick;
+
+	return s->now_bits;
+}
+
+
+/**
+  * @brief  Follows a frame off the bus
+  * @param  s pointer to the spectator
+  * @param  tick HAL tick at reception
+  * @param  stamp TTCM time stamp of the frame's SOF
+  * @param  id standard identifier
+  * @param  rtr 1 for a remote frame
+  * @param  dlc data length code
+  * @param  data payload
+  * @retval None
+  */
+
+void Spec_Frame(Spectator_t *s, uint32_t tick, uint16_t stamp, uint16_t id, uint8_t rtr, uint8_t dlc, const uint8_t data[])
+{
+	uint64_t at = Spec_Time(s, tick, stamp);
+
+	s->frames++;
+	s->quiet = 0;
+
+	if(id == SPEC_ID_HAND && rtr == 0)
+	{
+		if(dlc < 1 || data[0] > 2)
+		{
+			Spec_Anomaly(s, SPEC_ANOM_BAD_FRAME, tick);
+			return;
+		}
+
+		if(s->hand_open == SPEC_HANDS_IN_FLIGHT)	// The oldest hand never got its result
+		{
+			s->hand_first = (s->hand_first + 1) % SPEC_HANDS_IN_FLIGHT;
+			s->hand_open--;
+			Spec_Anomaly(s, SPEC_ANOM_LOST_RESULT, tick);
+		}
+
+		s->hands[data[0]]++;
+		s->hand_at[(s->hand_first + s->hand_open) % SPEC_HANDS_IN_FLIGHT] = at;
+		s->hand_tick[(s->hand_first + s->hand_open) % SPEC_HANDS_IN_FLIGHT] = tick;
+		s->hand_open++;
+	}else if(id == SPEC_ID_RESULT && rtr == 0)
+	{
+		if(dlc < 2 || data[0] < 1 || data[0] > 4 || data[1] != 0)
+		{
+			Spec_Anomaly(s, SPEC_ANOM_BAD_FRAME, tick);
+			return;
+		}
+
+		Spec_Result(s, tick, at, data[0]);
+	}else if(id == SPEC_ID_STATS)
+	{
+		if(rtr)								// Disc asks
+		{
+			s->query_open = 1;
+			s->query_tick = tick;
+		}else if(dlc < 6)
+		{
+			Spec_Anomaly(s, SPEC_ANOM_BAD_FRAME, tick);
+		}else								// Nucleo answers
+		{
+			s->query_open = 0;
+			Spec_Stats(s, tick, data);
+		}
+
+		s->events++;
+	}else if(id == FENWICK_QUERY_ID || id == SPEC_ID_ROLLUP_QUERY)
+	{
+		s->query_open = 1;
+		s->query_tick = tick;
+		s->events++;
+	}else if(id == FENWICK_REPLY_ID || id == SPEC_ID_ROLLUP_REPLY)
+	{
+		s->query_open = 0;
+		s->events++;
+	}else if(id == TT_REF_ID)
+	{
+		s->refs++;
+	}else if(id == SPEC_ID_SLEEP)
+	{
+		s->events++;
+	}else
+	{
+		Spec_Anomaly(s, SPEC_ANOM_UNKNOWN_ID, tick);
+	}
+}
+
+
+/**
+  * @brief  Counts a result and closes the round of the oldest hand in flight
+  */
+
+static void Spec_Result(Spectator_t *s, uint32_t tick, uint64_t at, uint8_t result)
+{
+	static const char *names[4] = {"Nucleo wins", "Disc wins", "A tie", "Error occurred"};
+	char line[SPEC_LINE_MAX];
+	uint32_t lat;
+
+	s->results[result - 1]++;
+	s->stats_results[result - 1]++;
+
+	if(s->hand_open == 0)
+	{
+		Spec_Anomaly(s, SPEC_ANOM_ORPHAN_RESULT, tick);
+		return;
+	}
+
+	lat = (uint32_t)((at - s->hand_at[s->hand_first]) * s->bit_ns / 1000);
+	s->hand_first = (s->hand_first + 1) % SPEC_HANDS_IN_FLIGHT;
+	s->hand_open--;
+	s->rounds++;
+
+	s->lat_min = (lat < s->lat_min) ? lat : s->lat_min;
+	s->lat_max = (lat > s->lat_max) ? lat : s->lat_max;
+	s->lat_sum += lat;
+	s->lat_hist[(lat / SPEC_LAT_BIN_US < SPEC_LAT_BINS) ? lat / SPEC_LAT_BIN_US : SPEC_LAT_BINS - 1]++;
+
+	Spec_Put(s, line, sprintf(line, "SPEC %lu.%03lu ROUND %lu: %s, hand to result %lu us\r\n", (unsigned long)(tick / 1000), \
+			(unsigned long)(tick % 1000), (unsigned long)s->rounds, names[result - 1], (unsigned long)lat));
+
+	if(lat > SPEC_SLOW_US)
+	{
+		Spec_Anomaly(s, SPEC_ANOM_SLOW_RESULT, tick);
+	}
+}
+
+
+/**
+  * @brief  Checks Nucleo's counters against the results seen since its last stats reply.
+  * 		They are 8-bit and wrap, so are the differences
+  */
+
+static void Spec_Stats(Spectator_t *s, uint32_t tick, const uint8_t data[])
+{
+	uint8_t drift = 0;
+
+	for(uint8_t i = 0; s->stats_valid && i < 4; i++)
+	{
+		drift |= ((uint8_t)(data[i] - s->stats[i]) != (uint8_t)s->stats_results[i]);
+	}
+
+	if(drift)
+	{
+		Spec_Anomaly(s, SPEC_ANOM_STATS_DRIFT, tick);
+	}
+
+	memcpy(s->stats, data, sizeof(s->stats));
+	memset(s->stats_results, 0, sizeof(s->stats_results));
+	s->stats_valid = 1;
+}
+
+
+/**
+  * @brief  Checks the timeouts and sends the totals every SPEC_REPORT_MS. Called
+  * 		periodically, well within the shortest timeout
+  * @param  s pointer to the spectator
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+void Spec_Tick(Spectator_t *s, uint32_t tick)
+{
+	while(s->hand_open && tick - s->hand_tick[s->hand_first] >= SPEC_RESULT_TIMEOUT_MS)
+	{
+		s->hand_first = (s->hand_first + 1) % SPEC_HANDS_IN_FLIGHT;
+		s->hand_open--;
+		Spec_Anomaly(s, SPEC_ANOM_LOST_RESULT, tick);
+	}
+
+	if(s->query_open && tick - s->query_tick >= SPEC_REPLY_TIMEOUT_MS)
+	{
+		s->query_open = 0;
+		Spec_Anomaly(s, SPEC_ANOM_NO_REPLY, tick);
+	}
+
+	if(s->started && s->quiet == 0 && tick - s->tick >= SPEC_QUIET_MS)
+	{
+		s->quiet = 1;
+		Spec_Anomaly(s, SPEC_ANOM_QUIET, tick);
+	}
+
+	if(tick - s->report_tick >= SPEC_REPORT_MS)
+	{
+		s->report_tick = tick;
+		Spec_Report(s, tick);
+	}
+}
+
+
+/**
+  * @brief  Counts an anomaly and queues its line
+  * @param  s pointer to the spectator
+  * @param  kind SPEC_ANOM_xxx
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+void Spec_Anomaly(Spectator_t *s, uint8_t kind, uint32_t tick)
+{
+	char line[SPEC_LINE_MAX];
+
+	s->anomalies[kind]++;
+
+	Spec_Put(s, line, sprintf(line, "SPEC %lu.%03lu ANOMALY %s (%lu so far)\r\n", (unsigned long)(tick / 1000), \
+			(unsigned long)(tick % 1000), spec_anomaly_names[kind], (unsigned long)s->anomalies[kind]));
+}
+
+
+/**
+  * @brief  Returns the upper edge of the histogram bin a percentile of the rounds falls in
+  */
+
+static uint32_t Spec_Percentile(const Spectator_t *s, uint32_t rounds, uint8_t percent)
+{
+	uint64_t want = ((uint64_t)rounds * percent + 99) / 100, seen = 0;
+
+	for(uint8_t i = 0; i < SPEC_LAT_BINS - 1; i++)
+	{
+		seen += s->lat_hist[i];
+
+		if(seen >= want)
+		{
+			return (i + 1) * SPEC_LAT_BIN_US;
+		}
+	}
+
+	return s->lat_max;
+}
+
+
+/**
+  * @brief  Queues the totals: frames and rounds, latency, anomalies
+  * @param  s pointer to the spectator
+  * @param  tick HAL tick
+  * @retval None
+  */
+
+void Spec_Report(Spectator_t *s, uint32_t tick)
+{
+	char line[SPEC_LINE_MAX];
+	unsigned long sec = tick / 1000, ms = tick % 1000;
+	uint32_t rounds = s->rounds;
+
+	Spec_Put(s, line, sprintf(line, "SPEC %lu.%03lu STATS frames %lu, rounds %lu (N %lu D %lu T %lu E %lu), hands R %lu P %lu S %lu, " \
+			"events %lu, references %lu, lines dropped %lu\r\n", sec, ms, (unsigned long)s->frames, (unsigned long)rounds, \
+			(unsigned long)s->results[0], (unsigned long)s->results[1], (unsigned long)s->results[2], (unsigned long)s->results[3], \
+			(unsigned long)s->hands[0], (unsigned long)s->hands[1], (unsigned long)s->hands[2], (unsigned long)s->events, \
+			(unsigned long)s->refs, (unsigned long)s->dropped));
+
+	Spec_Put(s, line, sprintf(line, "SPEC %lu.%03lu LATENCY min %lu avg %lu p50 %lu p99 %lu max %lu us\r\n", sec, ms, \
+			(unsigned long)((rounds) ? s->lat_min : 0), (unsigned long)((rounds) ? s->lat_sum / rounds : 0), \
+			(unsigned long)((rounds) ? Spec_Percentile(s, rounds, 50) : 0), (unsigned long)((rounds) ? Spec_Percentile(s, rounds, 99) : 0), \
+			(unsigned long)s->lat_max));
+
+	Spec_Put(s, line, sprintf(line, "SPEC %lu.%03lu ANOMALIES lost %lu orphan %lu bad %lu slow %lu unanswered %lu drift %lu " \
+			"unknown %lu buserr %lu overrun %lu quiet %lu\r\n", sec, ms, (unsigned long)s->anomalies[0], (unsigned long)s->anomalies[1], \
+			(unsigned long)s->anomalies[2], (unsigned long)s->anomalies[3], (unsigned long)s->anomalies[4], (unsigned long)s->anomalies[5], \
+			(unsigned long)s->anomalies[6], (unsigned long)s->anomalies[7], (unsigned long)s->anomalies[8], (unsigned long)s->anomalies[9]));
+}
+
+
+/**
+  * @brief  Adds a line to the Tx ring, whole or not at all
+  */
+
+static void Spec_Put(Spectator_t *s, const char *line, uint16_t len)
+{
+	uint16_t room = (s->tail + SPEC_TX_RING - s->head - 1) % SPEC_TX_RING;
+
+	if(len > room)
+	{
+		s->dropped++;
+		return;
+	}
+
+	for(uint16_t i = 0; i < len; i++)
+	{
+		s->ring[s->head] = line[i];
+		s->head = (s->head + 1) % SPEC_TX_RING;
+	}
+}
+
+
+/**
+  * @brief  Returns the next stretch of the Tx ring for the DMA: from its tail up to its
+  * 		head or to its end
+  * @param  s pointer to the spectator
+  * @param  chunk set to the start of the stretch
+  * @retval Bytes in the stretch, 0 if the ring is empty
+  */
+
+uint16_t Spec_TxChunk(const Spectator_t *s, const char **chunk)
+{
+	*chunk = &s->ring[s->tail];
+
+	return (s->head >= s->tail) ? s->head - s->tail : SPEC_TX_RING - s->tail;
+}
+
+
+/**
+  * @brief  Frees a stretch the DMA sent
+  * @param  s pointer to the spectator
+  * @param  len bytes sent
+  * @retval None
+  */
+
+void Spec_TxDone(Spectator_t *s, uint16_t len)
+{
+	s->tail = (s->tail + len) % SPEC_TX_RING;
+}
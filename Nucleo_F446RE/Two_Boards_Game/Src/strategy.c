@@ -0,0 +1,389 @@
+/**
+  ******************************************************************************
+  * @file    strategy.c
+  * @author  Moe2Code
+  * @brief   Player strategies. Every strategy is a set of init/pick/observe functions over a
+  *          fixed-size state, registered in strategy_table[]. Both boards and the host arena
+  *          pick their hands through this interface. The following is conducted in source file:
+  *          + Dispatch of init/pick/observe to the selected strategy
+  *          + Random, cycle, frequency, win-stay/lose-shift, Markov, qpred and evolved strategies
+  *          + Recovery of the opponent's hand from a game result
+  * @note    Hands: 0 = Rock, 1 = Paper, 2 = Scissors. Hand (h + 1) % 3 beats hand h
+  */
+
+// Includes
+#include "strategy.h"
+
+
+// Function prototypes
+static void Strategy_BasicInit(Strategy_State_t *st, uint32_t seed);
+static void Strategy_BasicObserve(Strategy_State_t *st, uint8_t own, uint8_t opp);
+static uint8_t Strategy_RandomHand(Strategy_Basic_t *b);
+static uint8_t Strategy_RandomPick(Strategy_State_t *st);
+static uint8_t Strategy_CyclePick(Strategy_State_t *st);
+static uint8_t Strategy_FrequencyPick(Strategy_State_t *st);
+static uint8_t Strategy_WslsPick(Strategy_State_t *st);
+static void Strategy_MarkovInit(Strategy_State_t *st, uint32_t seed);
+static uint8_t Strategy_MarkovPick(Strategy_State_t *st);
+static void Strategy_MarkovObserve(Strategy_State_t *st, uint8_t own, uint8_t opp);
+static void Strategy_QpredInit(Strategy_State_t *st, uint32_t seed);
+static uint8_t Strategy_QpredPick(Strategy_State_t *st);
+static void Strategy_QpredObserve(Strategy_State_t *st, uint8_t own, uint8_t opp);
+static void Strategy_EvolvedInit(Strategy_State_t *st, uint32_t seed);
+static uint8_t Strategy_EvolvedPick(Strategy_State_t *st);
+static void Strategy_EvolvedObserve(Strategy_State_t *st, uint8_t own, uint8_t opp);
+
+
+// Global variables
+// Indexed by the STRATEGY_xxx IDs
+static const Strategy_t strategy_table[STRATEGY_COUNT] =
+{
+	{"random",    Strategy_BasicInit,  Strategy_RandomPick,    Strategy_BasicObserve},
+	{"cycle",     Strategy_BasicInit,  Strategy_CyclePick,     Strategy_BasicObserve},
+	{"frequency", Strategy_BasicInit,  Strategy_FrequencyPick, Strategy_BasicObserve},
+	{"wsls",      Strategy_BasicInit,  Strategy_WslsPick,      Strategy_BasicObserve},
+	{"markov",    Strategy_MarkovInit, Strategy_MarkovPick,    Strategy_MarkovObserve},
+	{"qpred",     Strategy_QpredInit,  Strategy_QpredPick,     Strategy_QpredObserve},
+	{"evolved",   Strategy_EvolvedInit, Strategy_EvolvedPick,  Strategy_EvolvedObserve},
+};
+
+
+/**
+  * @brief  Binds a player to a strategy and initializes its state
+  * @param  player pointer to the player
+  * @param  id strategy ID (STRATEGY_xxx). Unknown IDs fall back to STRATEGY_RANDOM
+  * @param  seed seed of the random picks of the strategy
+  * @retval None
+  */
+
+void Strategy_Init(Strategy_Player_t *player, uint8_t id, uint32_t seed)
+{
+	player->strategy = &strategy_table[(id < STRATEGY_COUNT) ? id : STRATEGY_RANDOM];
+	player->strategy->init(&player->state, seed);
+}
+
+
+/**
+  * @brief  Returns the hand the player plays this round
+  * @param  player pointer to the player
+  * @retval Hand: 0 = Rock, 1 = Paper, 2 = Scissors
+  */
+
+uint8_t Strategy_Pick(Strategy_Player_t *player)
+{
+	return player->strategy->pick(&player->state);
+}
+
+
+/**
+  * @brief  Tells the player the hands of the round just played
+  * @param  player pointer to the player
+  * @param  own hand the player played
+  * @param  opp hand the opponent played, STRATEGY_NO_HAND if unknown
+  * @retval None
+  */
+
+void Strategy_Observe(Strategy_Player_t *player, uint8_t own, uint8_t opp)
+{
+	player->strategy->observe(&player->state, own, opp);
+}
+
+
+/**
+  * @brief  Recovers Disc's hand on Nucleo from Nucleo's hand and the game result it received
+  * @param  own Nucleo's hand
+  * @param  result game result: 1 = Nucleo wins, 2 = Disc wins, 3 = tie, 4 = error
+  * @retval Disc's hand, STRATEGY_NO_HAND if the result does not tell
+  */
+
+uint8_t Strategy_OppHand(uint8_t own, uint8_t result)
+{
+	if(own > 2)
+	{
+		return STRATEGY_NO_HAND;
+	}
+
+	switch(result)
+	{
+		case 1:
+			return (own + 2) % 3;		// Own hand beats the hand just below it
+		case 2:
+			return (own + 1) % 3;
+		case 3:
+			return own;
+		default:
+			return STRATEGY_NO_HAND;
+	}
+}
+
+
+/**
+  * @brief  Returns the name of a strategy
+  * @param  id strategy ID (STRATEGY_xxx)
+  * @retval Name, "?" for unknown IDs
+  */
+
+const char* Strategy_Name(uint8_t id)
+{
+	return (id < STRATEGY_COUNT) ? strategy_table[id].name : "?";
+}
+
+
+/**
+  * @brief  Initializes the state of the simple strategies
+  * @param  st pointer to the strategy state
+  * @param  seed seed of the random picks
+  * @retval None
+  */
+
+static void Strategy_BasicInit(Strategy_State_t *st, uint32_t seed)
+{
+	Strategy_Basic_t *b = &st->basic;
+
+	b->rng = (seed != 0) ? seed : 0x2545F491;
+	b->opp_counts[0] = b->opp_counts[1] = b->opp_counts[2] = 0;
+	b->step = 0;
+	b->last_own = 0;
+	b->last_opp = STRATEGY_NO_HAND;
+}
+
+
+/**
+  * @brief  Records the hands of the round for the simple strategies
+  * @param  st pointer to the strategy state
+  * @param  own hand played
+  * @param  opp opponent's hand, STRATEGY_NO_HAND if unknown
+  * @retval None
+  */
+
+static void Strategy_BasicObserve(Strategy_State_t *st, uint8_t own, uint8_t opp)
+{
+	Strategy_Basic_t *b = &st->basic;
+
+	b->last_own = own;
+	b->last_opp = opp;
+
+	if(opp > 2)
+	{
+		return;
+	}
+
+	if(++b->opp_counts[opp] == 0xFFFF)	// Halve so the counts keep their ratio
+	{
+		b->opp_counts[0] >>= 1;
+		b->opp_counts[1] >>= 1;
+		b->opp_counts[2] >>= 1;
+	}
+}
+
+
+/**
+  * @brief  Returns a random hand (xorshift32)
+  * @param  b pointer to the state of the simple strategies
+  * @retval Hand
+  */
+
+static uint8_t Strategy_RandomHand(Strategy_Basic_t *b)
+{
+	b->rng ^= b->rng << 13;
+	b->rng ^= b->rng >> 17;
+	b->rng ^= b->rng << 5;
+
+	return b->rng % 3;
+}
+
+
+/**
+  * @brief  Random strategy: uniform hand
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_RandomPick(Strategy_State_t *st)
+{
+	return Strategy_RandomHand(&st->basic);
+}
+
+
+/**
+  * @brief  Cycle strategy: Rock, Paper, Scissors, Rock, ...
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_CyclePick(Strategy_State_t *st)
+{
+	uint8_t hand = st->basic.step;
+
+	st->basic.step = (hand + 1) % 3;
+
+	return hand;
+}
+
+
+/**
+  * @brief  Frequency strategy: beats the opponent's most played hand
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_FrequencyPick(Strategy_State_t *st)
+{
+	const uint16_t *c = st->basic.opp_counts;
+	uint8_t most;
+
+	if(c[0] == c[1] && c[1] == c[2])	// Nothing to go on yet
+	{
+		return Strategy_RandomHand(&st->basic);
+	}
+
+	most = (c[1] > c[0]) ? 1 : 0;
+	most = (c[2] > c[most]) ? 2 : most;
+
+	return (most + 1) % 3;
+}
+
+
+/**
+  * @brief  Win-stay, lose-shift: repeats a winning hand, otherwise beats the opponent's last hand
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_WslsPick(Strategy_State_t *st)
+{
+	const Strategy_Basic_t *b = &st->basic;
+
+	if(b->last_opp > 2)					// First round or unknown result
+	{
+		return Strategy_RandomHand(&st->basic);
+	}
+
+	if(b->last_own == (b->last_opp + 1) % 3)	// Won: stay
+	{
+		return b->last_own;
+	}
+
+	return (b->last_opp + 1) % 3;		// Lost or tied: play what would have beaten the last hand
+}
+
+
+/**
+  * @brief  Markov strategy: initializes the predictor
+  * @param  st pointer to the strategy state
+  * @param  seed seed of the fallback random picks
+  * @retval None
+  */
+
+static void Strategy_MarkovInit(Strategy_State_t *st, uint32_t seed)
+{
+	Markov_Init(&st->markov, seed);
+}
+
+
+/**
+  * @brief  Markov strategy: beats the predicted hand
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_MarkovPick(Strategy_State_t *st)
+{
+	return Markov_Pick(&st->markov);
+}
+
+
+/**
+  * @brief  Markov strategy: adds the opponent's hand to the predictor
+  * @param  st pointer to the strategy state
+  * @param  own hand played (unused)
+  * @param  opp opponent's hand, STRATEGY_NO_HAND if unknown
+  * @retval None
+  */
+
+static void Strategy_MarkovObserve(Strategy_State_t *st, uint8_t own, uint8_t opp)
+{
+	(void)own;
+
+	Markov_Observe(&st->markov, opp);	// Unknown hands (> 2) are ignored
+}
+
+
+/**
+  * @brief  qpred strategy: clears the predictor history
+  * @param  st pointer to the strategy state
+  * @param  seed unused, the model is deterministic
+  * @retval None
+  */
+
+static void Strategy_QpredInit(Strategy_State_t *st, uint32_t seed)
+{
+	(void)seed;
+
+	Qpred_Init(&st->qpred);
+}
+
+
+/**
+  * @brief  qpred strategy: beats the hand the int8 model predicts
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_QpredPick(Strategy_State_t *st)
+{
+	return Qpred_Pick(&st->qpred);
+}
+
+
+/**
+  * @brief  qpred strategy: adds the round to the predictor history
+  * @param  st pointer to the strategy state
+  * @param  own hand played
+  * @param  opp opponent's hand, STRATEGY_NO_HAND if unknown
+  * @retval None
+  */
+
+static void Strategy_QpredObserve(Strategy_State_t *st, uint8_t own, uint8_t opp)
+{
+	Qpred_Observe(&st->qpred, own, opp);	// Unknown hands (> 2) are ignored
+}
+
+
+/**
+  * @brief  Evolved strategy: binds the player to the flash table
+  * @param  st pointer to the strategy state
+  * @param  seed seed of the random entries
+  * @retval None
+  */
+
+static void Strategy_EvolvedInit(Strategy_State_t *st, uint32_t seed)
+{
+	Evolved_Init(&st->evolved, evolved_table, seed);
+}
+
+
+/**
+  * @brief  Evolved strategy: plays the table entry of the last rounds
+  * @param  st pointer to the strategy state
+  * @retval Hand
+  */
+
+static uint8_t Strategy_EvolvedPick(Strategy_State_t *st)
+{
+	return Evolved_Pick(&st->evolved);
+}
+
+
+/**
+  * @brief  Evolved strategy: adds the round to the table context
+  * @param  st pointer to the strategy state
+  * @param  own hand played
+  * @param  opp opponent's hand, STRATEGY_NO_HAND if unknown
+  * @retval None
+  */
+
+static void Strategy_EvolvedObserve(Strategy_State_t *st, uint8_t own, uint8_t opp)
+{
+	Evolved_Observe(&st->evolved, own, opp);
+}
@@ -0,0 +1,274 @@
+/**
+  ******************************************************************************
+  * @file    tt_sched.c
+  * @author  Moe2Code
+  * @brief   Time-triggered CAN schedule (TT_CAN). The referee's reference message starts
+  *          every basic cycle and each node sends its game frames in its own window only,
+  *          so they never meet in arbitration. The following is conducted in source file:
+  *          + Schedule of a basic cycle for N players: referee window (reference, then the
+  *            results of the last cycle's hands back to back), one hand window per player,
+  *            arbitrating window
+  *          + Window length from the worst-case frame time at the bit rate plus a guard,
+  *            cycle length rounded up to the referee's timer tick
+  *          + Delay from the reference's Rx interrupt to a player's hand window
+  *          + Jitter against the schedule from the TTCM time stamps: reference period,
+  *            start of the results and hands in their windows, and its report line
+  * @note    Windows are sized for an 8 byte frame whatever the payload, so SECURE_CAN
+  *          frames fit the same schedule
+  */
+
+// Includes
+#include <stdio.h>
+#include "tt_sched.h"
+
+
+// Function prototypes
+static void Tt_Add(Tt_Sched_t *s, uint32_t *at, uint32_t len_us, uint8_t kind, uint8_t player);
+static uint8_t Tt_Within(const Tt_Sched_t *s, const Tt_Window_t *w, uint16_t offset);
+
+
+/**
+  * @brief  Lays out the basic cycle for a number of players
+  * @param  s pointer to the schedule
+  * @param  players players in the game, 1 to TT_MAX_PLAYERS
+  * @param  bit_ns CAN bit time
+  * @param  cycle_us cycle wanted, 0 for the shortest one
+  * @retval Cycle in us, 0 if the players or the windows do not fit (or the cycle does
+  * 		not fit the 16-bit time stamps)
+  */
+
+uint32_t Tt_Build(Tt_Sched_t *s, uint8_t players, uint32_t bit_ns, uint32_t cycle_us)
+{
+	uint32_t frame_us = (TT_FRAME_BITS * bit_ns + 999) / 1000;
+	uint32_t len_us = (frame_us + TT_GUARD_US + TT_TICK_US - 1) / TT_TICK_US * TT_TICK_US;
+	uint32_t at = 0;
+
+	s->players = 0;
+	s->windows = 0;
+	s->bit_ns = bit_ns;
+	s->frame_us = frame_us;
+	s->cycle_us = 0;
+
+	if(players == 0 || players > TT_MAX_PLAYERS || bit_ns == 0)
+	{
+		return 0;
+	}
+
+	// The referee queues its frames together at the start of the cycle: one guard for all
+	Tt_Add(s, &at, ((1 + players) * frame_us + TT_GUARD_US + TT_TICK_US - 1) / TT_TICK_US * TT_TICK_US, TT_WIN_REF, 0);
+
+	for(uint8_t p = 0; p < players; p++)
+	{
+		Tt_Add(s, &at, len_us, TT_WIN_HAND, p);
+	}
+
+	if(cycle_us == 0)			// Room for one event frame at least
+	{
+		cycle_us = (at + len_us + TT_CYCLE_GRAIN_US - 1) / TT_CYCLE_GRAIN_US * TT_CYCLE_GRAIN_US;
+	}
+
+	if(cycle_us < at + len_us || (uint64_t)cycle_us * 1000 / bit_ns > 0xFFFF)
+	{
+		return 0;
+	}
+
+	Tt_Add(s, &at, cycle_us - at, TT_WIN_FREE, 0);
+	s->players = players;
+	s->cycle_us = cycle_us;
+
+	return cycle_us;
+}
+
+
+/**
+  * @brief  Appends a window at *at and moves *at past it
+  */
+
+static void Tt_Add(Tt_Sched_t *s, uint32_t *at, uint32_t len_us, uint8_t kind, uint8_t player)
+{
+	Tt_Window_t *w = &s->win[s->windows++];
+
+	w->start_us = *at;
+	w->len_us = len_us;
+	w->kind = kind;
+	w->player = player;
+	*at += len_us;
+}
+
+
+/**
+  * @brief  Returns a window of the schedule
+  * @param  s pointer to the schedule
+  * @param  kind TT_WIN_xxx
+  * @param  player player of a hand window, 0 otherwise
+  * @retval Pointer to the window, NULL if the schedule has none
+  */
+
+const Tt_Window_t* Tt_Window(const Tt_Sched_t *s, uint8_t kind, uint8_t player)
+{
+	for(uint8_t i = 0; i < s->windows; i++)
+	{
+		if(s->win[i].kind == kind && s->win[i].player == player)
+		{
+			return &s->win[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+  * @brief  Returns the delay from the reference's Rx interrupt to the start of a player's
+  * 		hand window, rounded up to TT_TICK_US so the hand never starts early
+  * @param  s pointer to the schedule
+  * @param  player the player
+  * @retval Delay in us, 0 if the player has no window
+  */
+
+uint32_t Tt_Arm_Us(const Tt_Sched_t *s, uint8_t player)
+{
+	const Tt_Window_t *w = Tt_Window(s, TT_WIN_HAND, player);
+	uint32_t ref_us = TT_REF_BITS_MIN * s->bit_ns / 1000;
+
+	if(w == NULL || w->start_us <= ref_us)
+	{
+		return 0;
+	}
+
+	return (w->start_us - ref_us + TT_TICK_US - 1) / TT_TICK_US * TT_TICK_US;
+}
+
+
+/**
+  * @brief  Clears the jitter figures
+  * @param  j pointer to the figures
+  * @retval None
+  */
+
+void Tt_Jitter_Init(Tt_Jitter_t *j)
+{
+	j->cycles = 0;
+	j->late = 0;
+	j->period_min = INT32_MAX;
+	j->period_max = INT32_MIN;
+	j->result_min = UINT16_MAX;
+	j->result_max = 0;
+	j->hand_min = UINT16_MAX;
+	j->hand_max = 0;
+	j->results = 0;
+	j->hands = 0;
+	j->outside = 0;
+	j->ref = 0;
+	j->ref_valid = 0;
+}
+
+
+/**
+  * @brief  Records the time stamp of a reference
+  * @param  j pointer to the figures
+  * @param  s pointer to the schedule
+  * @param  stamp TTCM time stamp of the reference's SOF
+  * @param  missed references that did not go out since the last one
+  * @retval None
+  */
+
+void Tt_Jitter_Ref(Tt_Jitter_t *j, const Tt_Sched_t *s, uint16_t stamp, uint32_t missed)
+{
+	int32_t period = (int32_t)(uint16_t)(stamp - j->ref) - (int32_t)((uint64_t)s->cycle_us * 1000 / s->bit_ns);
+
+	if(j->ref_valid && missed == 0)			// Period only between references one cycle apart
+	{
+		j->period_min = (period < j->period_min) ? period : j->period_min;
+		j->period_max = (period > j->period_max) ? period : j->period_max;
+	}
+
+	j->cycles++;
+	j->late += missed;
+	j->ref = stamp;
+	j->ref_valid = 1;
+}
+
+
+/**
+  * @brief  Records the time stamp of a result of the cycle of the last reference
+  * @param  j pointer to the figures
+  * @param  s pointer to the schedule
+  * @param  stamp TTCM time stamp of the frame's SOF
+  * @retval None
+  */
+
+void Tt_Jitter_Result(Tt_Jitter_t *j, const Tt_Sched_t *s, uint16_t stamp)
+{
+	uint16_t offset = stamp - j->ref;
+
+	if(j->ref_valid == 0)
+	{
+		return;
+	}
+
+	j->results++;
+	j->result_min = (offset < j->result_min) ? offset : j->result_min;
+	j->result_max = (offset > j->result_max) ? offset : j->result_max;
+	j->outside += (Tt_Within(s, Tt_Window(s, TT_WIN_REF, 0), offset) == 0);
+}
+
+
+/**
+  * @brief  Records the time stamp of a hand of the cycle of the last reference
+  * @param  j pointer to the figures
+  * @param  s pointer to the schedule
+  * @param  player the player
+  * @param  stamp TTCM time stamp of the frame's SOF
+  * @retval None
+  */
+
+void Tt_Jitter_Hand(Tt_Jitter_t *j, const Tt_Sched_t *s, uint8_t player, uint16_t stamp)
+{
+	uint16_t offset = stamp - j->ref;
+
+	if(j->ref_valid == 0)
+	{
+		return;
+	}
+
+	j->hands++;
+	j->hand_min = (offset < j->hand_min) ? offset : j->hand_min;
+	j->hand_max = (offset > j->hand_max) ? offset : j->hand_max;
+	j->outside += (Tt_Within(s, Tt_Window(s, TT_WIN_HAND, player), offset) == 0);
+}
+
+
+/**
+  * @brief  Returns 1 if a worst-case frame starting offset bit times after the reference
+  * 		is wholly within the window, 0 otherwise
+  */
+
+static uint8_t Tt_Within(const Tt_Sched_t *s, const Tt_Window_t *w, uint16_t offset)
+{
+	uint32_t us = (uint32_t)offset * s->bit_ns / 1000;
+
+	return (w != NULL && us >= w->start_us && us + s->frame_us <= w->start_us + w->len_us);
+}
+
+
+/**
+  * @brief	Prints the jitter figures into buf, in us
+  * @param	j pointer to the figures
+  * @param	s pointer to the schedule
+  * @param	buf destination string. Must hold at least 250 characters
+  * @retval None
+  */
+
+void Tt_Report(const Tt_Jitter_t *j, const Tt_Sched_t *s, char *buf)
+{
+	int32_t period_min = (j->period_min <= j->period_max) ? j->period_min * (int32_t)s->bit_ns / 1000 : 0;
+	int32_t period_max = (j->period_min <= j->period_max) ? j->period_max * (int32_t)s->bit_ns / 1000 : 0;
+
+	sprintf(buf, "TTCAN cycle %lu ms: references %lu, late %lu, period %+ld/%+ld us, results %lu at %lu-%lu us, " \
+			"hands %lu at %lu-%lu us, outside windows %lu\r\n", (unsigned long)(s->cycle_us / 1000), (unsigned long)j->cycles, \
+			(unsigned long)j->late, (long)period_min, (long)period_max, (unsigned long)j->results, \
+			(unsigned long)((j->results) ? j->result_min * s->bit_ns / 1000 : 0), (unsigned long)(j->result_max * s->bit_ns / 1000), \
+			(unsigned long)j->hands, (unsigned long)((j->hands) ? j->hand_min * s->bit_ns / 1000 : 0), \
+			(unsigned long)(j->hand_max * s->bit_ns / 1000), (unsigned long)j->outside);
+}